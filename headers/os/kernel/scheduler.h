@@ -66,6 +66,19 @@ bigtime_t estimate_max_scheduling_latency(thread_id th = -1);
 status_t set_scheduler_mode(int32 mode);
 int32 get_scheduler_mode(void);
 
+/*!
+	A thread can also ask for a guaranteed share of the CPU instead of a
+	priority by calling set_thread_deadline(). It will then be given
+	\a runtime microseconds of CPU time within \a deadline microseconds after
+	the start of every \a period, ahead of all threads scheduled by priority.
+	B_BUSY is returned if the system cannot make that guarantee anymore. Once
+	the runtime of a period is used up, the thread is scheduled by its
+	priority until the next period starts. A runtime of 0 returns the thread
+	to priority based scheduling.
+*/
+status_t set_thread_deadline(thread_id thread, bigtime_t runtime,
+	bigtime_t deadline, bigtime_t period);
+
 }
 #else
 
@@ -78,6 +91,9 @@ bigtime_t estimate_max_scheduling_latency(thread_id th);
 status_t set_scheduler_mode(int32 mode);
 int32 get_scheduler_mode(void);
 
+status_t set_thread_deadline(thread_id thread, bigtime_t runtime,
+	bigtime_t deadline, bigtime_t period);
+
 #endif
 
 #endif // SCHEDULER_H
@@ -84,6 +84,12 @@ protected:
 	// from scheduler.h. The passed priority will be clamped to be in range 5
 	// to 120.
 			status_t			SetPriority(int32 priority);
+	// NOTE: Asks for the given runtime of CPU time in every period for the
+	// control thread, which is then scheduled by its deadline rather than its
+	// priority. Returns B_BUSY if the system cannot guarantee that. A runtime
+	// of 0 switches back to the priority set above.
+			status_t			SetDeadline(bigtime_t runtime,
+									bigtime_t period);
 			void				SetRunState(run_state state);
 			void				SetEventLatency(bigtime_t latency);
 			void				SetBufferDuration(bigtime_t duration);
@@ -107,6 +113,7 @@ private:
 									void* context);
 			void				_DispatchCleanUp(
 									const media_timed_event* event);
+			status_t			_UpdateDeadline();
 
 private:
 			BTimedEventQueue	fEventQueue;
@@ -155,7 +162,9 @@ private:
 	virtual	status_t 			_Reserved_BMediaEventLooper_23(int32 arg, ...);
 
 	bool						_reserved_bool_[4];
-	uint32						_reserved_BMediaEventLooper_[12];
+	uint32						fDeadlineRuntime;
+	uint32						fDeadlinePeriod;
+	uint32						_reserved_BMediaEventLooper_[10];
 };
 
 #endif // _MEDIA_EVENT_LOOPER_H
@@ -22,8 +22,22 @@ extern void *valloc(size_t numBytes);
 
 #ifdef _GNU_SOURCE
 size_t malloc_usable_size(void *ptr);
+int malloc_trim(size_t pad);
 #endif
 
+/* Haiku extension */
+struct malloc_statistics {
+	size_t	heap_size;				/* address space used by the heap */
+	size_t	allocated_size;			/* handed out to the application */
+	size_t	cached_size;			/* kept free in the per-thread caches */
+	size_t	free_size;				/* in free heap pages */
+	size_t	released_size;			/* free, and returned to the system */
+	size_t	large_allocation_count;	/* allocations backed by whole pages */
+	size_t	thread_cache_count;
+};
+
+extern int malloc_get_statistics(struct malloc_statistics *statistics);
+
 #ifdef __cplusplus
 }
 #endif
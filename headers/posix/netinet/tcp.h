@@ -79,5 +79,52 @@ struct tcphdr {
 	/* don't use TH_PUSH */
 #define TCP_NOOPT				0x08
 	/* don't use any TCP options */
+#define TCP_INFO				0x20
+	/* retrieve the connection state as struct tcp_info (read-only) */
+#define TCP_CONGESTION			0x40
+	/* get/set the congestion control algorithm by name */
+
+#define TCP_CA_NAME_MAX			16
+	/* maximum length of a congestion control algorithm name */
+
+/* values of tcp_info::tcpi_state */
+#define TCPS_CLOSED				0
+#define TCPS_LISTEN				1
+#define TCPS_SYN_SENT			2
+#define TCPS_SYN_RECEIVED		3
+#define TCPS_ESTABLISHED		4
+#define TCPS_CLOSE_WAIT			5
+#define TCPS_LAST_ACK			6
+#define TCPS_FIN_WAIT_1			7
+#define TCPS_FIN_WAIT_2			8
+#define TCPS_CLOSING			9
+#define TCPS_TIME_WAIT			10
+
+/* flags of tcp_info::tcpi_options */
+#define TCPI_OPT_TIMESTAMPS		0x01
+#define TCPI_OPT_SACK			0x02
+#define TCPI_OPT_WSCALE			0x04
+
+struct tcp_info {
+	uint8_t		tcpi_state;
+	uint8_t		tcpi_options;
+	uint8_t		tcpi_snd_wscale;
+	uint8_t		tcpi_rcv_wscale;
+	uint32_t	tcpi_rto;			/* retransmit timeout (usecs) */
+	uint32_t	tcpi_rtt;			/* smoothed round trip time (usecs) */
+	uint32_t	tcpi_rttvar;		/* round trip time variation (usecs) */
+	uint32_t	tcpi_min_rtt;		/* lowest round trip time seen (usecs) */
+	uint32_t	tcpi_snd_mss;
+	uint32_t	tcpi_rcv_mss;
+	uint32_t	tcpi_snd_cwnd;		/* congestion window (bytes) */
+	uint32_t	tcpi_snd_ssthresh;	/* slow start threshold (bytes) */
+	uint32_t	tcpi_snd_wnd;		/* peer's receive window (bytes) */
+	uint32_t	tcpi_rcv_wnd;		/* our receive window (bytes) */
+	uint32_t	tcpi_unacked;		/* unacknowledged data (bytes) */
+	uint32_t	tcpi_total_retrans;	/* retransmitted segments */
+	uint32_t	__tcpi_pad;
+	uint64_t	tcpi_pacing_rate;	/* bytes per second, 0 if not paced */
+	char		tcpi_congestion[TCP_CA_NAME_MAX];
+};
 
 #endif	/* NETINET_TCP_H */
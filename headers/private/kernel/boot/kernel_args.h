@@ -21,8 +21,10 @@
 #include <util/FixedWidthPointer.h>
 
 
-#define CURRENT_KERNEL_ARGS_VERSION	1
+#define CURRENT_KERNEL_ARGS_VERSION	2
 #define MAX_KERNEL_ARGS_RANGE		20
+#define MAX_NUMA_NODES				8
+#define MAX_NUMA_MEMORY_RANGE		32
 
 // names of common boot_volume fields
 #define BOOT_METHOD						"boot method"
@@ -62,6 +64,13 @@ typedef struct kernel_args {
 	uint32		num_cpus;
 	addr_range	cpu_kstack[SMP_MAX_CPUS];
 
+	// NUMA topology; num_numa_nodes is 0 if it is unknown
+	uint32		num_numa_nodes;
+	uint8		cpu_numa_node[SMP_MAX_CPUS];
+	uint32		num_numa_memory_ranges;
+	addr_range	numa_memory_range[MAX_NUMA_MEMORY_RANGE];
+	uint8		numa_memory_range_node[MAX_NUMA_MEMORY_RANGE];
+
 	// boot volume KMessage data
 	FixedWidthPointer<void> boot_volume;
 	int32		boot_volume_size;
@@ -0,0 +1,29 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _KERNEL_ASYNC_IO_H
+#define _KERNEL_ASYNC_IO_H
+
+
+#include <async_io_defs.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// user-space exported calls
+extern int		_user_create_async_io_context(uint32 maxRequests, uint32 flags);
+extern ssize_t	_user_submit_async_io(int context,
+					const struct async_io_request *requests, size_t count);
+extern ssize_t	_user_reap_async_io(int context,
+					struct async_io_completion *completions, size_t count,
+					size_t minCount, uint32 flags, bigtime_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif	/* _KERNEL_ASYNC_IO_H */
@@ -12,6 +12,9 @@
 #include <Drivers.h>
 
 
+struct vnode;
+
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -31,6 +34,7 @@ status_t devfs_rescan_driver(const char* driverName);
 
 void devfs_compute_geometry_size(device_geometry* geometry, uint64 blockCount,
 	uint32 blockSize);
+bool devfs_device_has_io(struct vnode* vnode);
 
 #ifdef __cplusplus
 }
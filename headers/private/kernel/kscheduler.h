@@ -44,6 +44,13 @@ void scheduler_reschedule(int32 next_state);
 */
 int32 scheduler_set_thread_priority(Thread* thread, int32 priority);
 
+/*!	Puts the given thread into the deadline class, or removes it from there,
+	if \a runtime is 0.
+	Interrupts must be enabled.
+*/
+status_t scheduler_set_thread_deadline(Thread* thread, bigtime_t runtime,
+	bigtime_t deadline, bigtime_t period);
+
 /*!	Called when the Thread structure is first created.
 	Per-thread housekeeping resources can be allocated.
 	Interrupts must be enabled.
@@ -93,6 +100,8 @@ status_t _user_analyze_scheduling(bigtime_t from, bigtime_t until, void* buffer,
 
 status_t _user_set_scheduler_mode(int32 mode);
 int32 _user_get_scheduler_mode(void);
+status_t _user_set_thread_deadline(thread_id thread, bigtime_t runtime,
+	bigtime_t deadline, bigtime_t period);
 
 #ifdef __cplusplus
 }
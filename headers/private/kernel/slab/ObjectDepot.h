@@ -14,7 +14,6 @@
 struct DepotMagazine;
 
 typedef struct object_depot {
-	rw_lock					outer_lock;
 	spinlock				inner_lock;
 	DepotMagazine*			full;
 	DepotMagazine*			empty;
@@ -22,6 +21,10 @@ typedef struct object_depot {
 	size_t					empty_count;
 	size_t					max_count;
 	size_t					magazine_capacity;
+	size_t					max_magazine_capacity;
+	size_t					contention_count;
+	size_t					obtain_miss_count;
+	size_t					store_miss_count;
 	struct depot_cpu_store*	stores;
 	void*					cookie;
 
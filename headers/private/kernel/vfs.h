@@ -98,6 +98,7 @@ void		vfs_put_vnode(struct vnode *vnode);
 void		vfs_acquire_vnode(struct vnode *vnode);
 status_t	vfs_get_cookie_from_fd(int fd, void **_cookie);
 bool		vfs_can_page(struct vnode *vnode, void *cookie);
+bool		vfs_can_do_direct_io(struct vnode *vnode);
 status_t	vfs_read_pages(struct vnode *vnode, void *cookie, off_t pos,
 				const struct generic_io_vec *vecs, size_t count, uint32 flags,
 				generic_size_t *_numBytes);
@@ -146,9 +147,10 @@ status_t	vfs_create_special_node(const char *path, fs_vnode *subVnode,
 				mode_t mode, uint32 flags, bool kernel, fs_vnode *_superVnode,
 				struct vnode **_createdVnode);
 
-/* service call for the node monitor */
+/* service calls for the node monitor */
 status_t	vfs_resolve_vnode_to_covering_vnode(dev_t mountID, ino_t nodeID,
 				dev_t *resolvedMountID, ino_t *resolvedNodeID);
+void		vfs_path_cache_node_changed(dev_t device, ino_t node);
 
 /* service calls for private file systems */
 status_t	vfs_get_mount_point(dev_t mountID, dev_t* _mountPointMountID,
@@ -166,6 +168,8 @@ status_t	_user_write_fs_info(dev_t device, const struct fs_info *info,
 				int mask);
 dev_t		_user_next_device(int32 *_cookie);
 status_t	_user_sync(void);
+status_t	_user_get_vfs_cache_statistics(
+				struct vfs_cache_statistics *statistics, size_t size);
 status_t	_user_get_next_fd_info(team_id team, uint32 *cookie,
 				struct fd_info *info, size_t infoSize);
 status_t	_user_entry_ref_to_path(dev_t device, ino_t inode, const char *leaf,
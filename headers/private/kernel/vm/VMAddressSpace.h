@@ -58,6 +58,16 @@ public:
 
 			void				IncrementFaultCount()
 									{ atomic_add(&fFaultCount, 1); }
+			void				IncrementPageInCount()
+									{ atomic_add(&fPageInCount, 1); }
+			void				AddFaultAroundCount(int32 count)
+									{ atomic_add(&fFaultAroundCount, count); }
+			int32				FaultCount() const
+									{ return fFaultCount; }
+			int32				PageInCount() const
+									{ return fPageInCount; }
+			int32				FaultAroundCount() const
+									{ return fFaultAroundCount; }
 			void				IncrementChangeCount()
 									{ fChangeCount++; }
 
@@ -146,6 +156,8 @@ protected:
 			team_id				fID;
 			int32				fRefCount;
 			int32				fFaultCount;
+			int32				fPageInCount;
+			int32				fFaultAroundCount;
 			int32				fChangeCount;
 			VMTranslationMap*	fTranslationMap;
 			bool				fRandomizingEnabled;
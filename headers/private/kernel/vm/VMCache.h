@@ -130,6 +130,7 @@ public:
 			status_t			SetMinimalCommitment(off_t commitment,
 									int priority);
 	virtual	status_t			Resize(off_t newSize, int priority);
+	virtual	status_t			Discard(off_t offset, off_t size);
 
 			status_t			FlushAndRemoveAllPages();
 
@@ -75,6 +75,11 @@ public:
 
 	virtual	void				Flush() = 0;
 
+	// large pages -- map locked
+	virtual	size_t				LargePageSize() const;
+	virtual	void				CollapseLargePages(addr_t start, addr_t end);
+	virtual	size_t				CountLargePages(addr_t start, addr_t end);
+
 	// backends for KDL commands
 	virtual	void				DebugPrintMappingInfo(addr_t virtualAddress);
 	virtual	bool				DebugGetReverseMappingInfo(
@@ -174,6 +174,8 @@ status_t _user_sync_memory(void *address, size_t size, uint32 flags);
 status_t _user_memory_advice(void* address, size_t size, uint32 advice);
 status_t _user_get_memory_properties(team_id teamID, const void *address,
 			uint32 *_protected, uint32 *_lock);
+status_t _user_get_compressed_swap_info(compressed_swap_info *info,
+			size_t size);
 
 area_id _user_area_for(void *address);
 area_id _user_find_area(const char *name);
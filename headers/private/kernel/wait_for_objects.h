@@ -11,9 +11,19 @@
 #include <lock.h>
 
 
+struct select_info;
 struct select_sync;
 
 
+typedef struct select_sync_ops {
+	void		(*notify)(struct select_sync* sync, struct select_info* info,
+					uint16 events);
+		// called instead of releasing the semaphore; may be called with
+		// interrupts disabled and spinlocks held, so it must not block
+	void		(*free)(struct select_sync* sync);
+		// called when the last reference to the sync object is released
+} select_sync_ops;
+
 typedef struct select_info {
 	struct select_info*	next;				// next in the object's list
 	struct select_sync*	sync;
@@ -26,6 +36,8 @@ typedef struct select_sync {
 	sem_id				sem;
 	uint32				count;
 	struct select_info*	set;
+	const select_sync_ops* ops;
+		// NULL for the semaphore based select()/poll()/wait_for_objects()
 } select_sync;
 
 #define SELECT_FLAG(type) (1L << (type - 1))
@@ -40,6 +52,11 @@ extern void		put_select_sync(select_sync* sync);
 extern status_t	notify_select_events(select_info* info, uint16 events);
 extern void		notify_select_events_list(select_info* list, uint16 events);
 
+extern status_t	select_object(uint32 type, int32 object, select_info* info,
+					bool kernel);
+extern status_t	deselect_object(uint32 type, int32 object, select_info* info,
+					bool kernel);
+
 extern ssize_t	_user_wait_for_objects(object_wait_info* userInfos,
 					int numInfos, uint32 flags, bigtime_t timeout);
 
@@ -12,6 +12,7 @@
 
 
 typedef struct net_buffer net_buffer;
+struct list;
 
 
 struct net_hardware_address {
@@ -61,6 +62,13 @@ struct net_device_module_info {
 					const struct sockaddr* address);
 	status_t	(*remove_multicast)(net_device* device,
 					const struct sockaddr* address);
+
+	// optional: devices with more than one receive queue; each queue is
+	// served by its own reader thread, which is handed all buffers that
+	// are available at once
+	uint32		(*receive_queue_count)(net_device* device);
+	status_t	(*receive_queue_data)(net_device* device, uint32 queue,
+					struct list* buffers);
 };
 
 
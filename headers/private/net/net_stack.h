@@ -182,6 +182,10 @@ struct net_stack_module_info {
 					ancillary_data_container* to);
 	void*		(*next_ancillary_data)(ancillary_data_container* container,
 					void* previousData, ancillary_data_header* _header);
+
+	// appended to keep the layout of the existing members
+	status_t	(*device_enqueue_buffers)(net_device* device,
+					struct list* buffers);
 };
 
 
@@ -107,6 +107,7 @@ typedef struct image_t {
 
 	// pointer to symbol participation data structures
 	uint32				*symhash;
+	uint32				*gnu_hash;		// DT_GNU_HASH table, if any
 	elf_sym				*syms;
 	char				*strtab;
 	elf_rel				*rel;
@@ -174,6 +175,18 @@ typedef struct image_queue_t {
 #define HASHBUCKETS(image) ((unsigned int*)&(image)->symhash[2])
 #define HASHCHAINS(image) ((unsigned int*)&(image)->symhash[2+HASHTABSIZE(image)])
 
+// DT_GNU_HASH table layout: header, bloom filter, buckets, chains
+#define GNU_HASH_BUCKET_COUNT(image)	((image)->gnu_hash[0])
+#define GNU_HASH_SYMBOL_OFFSET(image)	((image)->gnu_hash[1])
+#define GNU_HASH_BLOOM_SIZE(image)		((image)->gnu_hash[2])
+#define GNU_HASH_BLOOM_SHIFT(image)		((image)->gnu_hash[3])
+#define GNU_HASH_BLOOM(image)			((addr_t*)&(image)->gnu_hash[4])
+#define GNU_HASH_BUCKETS(image) \
+	((uint32*)(GNU_HASH_BLOOM(image) + GNU_HASH_BLOOM_SIZE(image)))
+#define GNU_HASH_CHAINS(image) \
+	(GNU_HASH_BUCKETS(image) + GNU_HASH_BUCKET_COUNT(image) \
+		- GNU_HASH_SYMBOL_OFFSET(image))
+
 
 // The name of the area the runtime loader creates for debugging purposes.
 #define RUNTIME_LOADER_DEBUG_AREA_NAME	"_rld_debug_"
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _SYSTEM_ASYNC_IO_DEFS_H
+#define _SYSTEM_ASYNC_IO_DEFS_H
+
+
+#include <SupportDefs.h>
+
+
+// limits
+#define ASYNC_IO_MAX_REQUESTS			4096
+	// maximum number of requests a context can have in flight
+#define ASYNC_IO_DEFAULT_REQUESTS		256
+	// used when _kern_create_async_io_context() is passed 0
+
+// async_io_request::operation
+enum {
+	ASYNC_IO_READ	= 1,
+	ASYNC_IO_WRITE	= 2
+};
+
+
+struct async_io_request {
+	int32		fd;
+	uint32		operation;
+	off_t		offset;
+		// must be >= 0, the file position is neither used nor changed
+	void*		buffer;
+	size_t		length;
+	void*		cookie;
+		// passed back unchanged in the completion
+};
+
+struct async_io_completion {
+	void*		cookie;
+	status_t	status;
+	size_t		transferred;
+};
+
+
+#endif	/* _SYSTEM_ASYNC_IO_DEFS_H */
@@ -0,0 +1,35 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _SYSTEM_EVENT_QUEUE_DEFS_H
+#define _SYSTEM_EVENT_QUEUE_DEFS_H
+
+
+#include <OS.h>
+
+
+// event_wait_info::events flags for _kern_event_queue_select(), in addition
+// to the B_EVENT_* flags from <OS.h>
+#define B_EVENT_LEVEL_TRIGGERED		(1 << 26)
+	// report the events as long as they persist, instead of only when they
+	// occur
+#define B_EVENT_ONE_SHOT			(1 << 27)
+	// remove the selection once its events have been reported
+	// A negative events value removes the selection of the object.
+
+#define EVENT_QUEUE_MAX_INFOS		1024
+	// maximum number of infos per _kern_event_queue_{select,wait}() call
+
+
+typedef struct event_wait_info {
+	int32		object;
+	uint16		type;
+		// B_OBJECT_TYPE_*, as for wait_for_objects()
+	int32		events;
+	void*		user_data;
+		// passed back unchanged by _kern_event_queue_wait()
+} event_wait_info;
+
+
+#endif	/* _SYSTEM_EVENT_QUEUE_DEFS_H */
@@ -21,8 +21,12 @@
 extern "C" {
 #endif
 
+struct async_io_completion;
+struct async_io_request;
 struct attr_info;
+struct compressed_swap_info;
 struct dirent;
+struct event_wait_info;
 struct fd_info;
 struct fd_set;
 struct fs_info;
@@ -40,6 +44,7 @@ struct signal_frame_data;
 struct stat;
 struct system_profiler_parameters;
 struct user_timer_info;
+struct vfs_cache_statistics;
 
 struct disk_device_job_progress_info;
 struct partitionable_space_data;
@@ -74,6 +79,13 @@ extern status_t		_kern_get_safemode_option(const char *parameter,
 extern ssize_t		_kern_wait_for_objects(object_wait_info* infos, int numInfos,
 						uint32 flags, bigtime_t timeout);
 
+extern int			_kern_event_queue_create(int openFlags);
+extern ssize_t		_kern_event_queue_select(int queue,
+						struct event_wait_info* infos, int numInfos);
+extern ssize_t		_kern_event_queue_wait(int queue,
+						struct event_wait_info* infos, int numInfos,
+						uint32 flags, bigtime_t timeout);
+
 /* user mutex functions */
 extern status_t		_kern_mutex_lock(int32* mutex, const char* name,
 						uint32 flags, bigtime_t timeout);
@@ -198,6 +210,9 @@ extern bigtime_t	_kern_estimate_max_scheduling_latency(thread_id thread);
 
 extern status_t		_kern_set_scheduler_mode(int32 mode);
 extern int32		_kern_get_scheduler_mode(void);
+extern status_t		_kern_set_thread_deadline(thread_id thread,
+						bigtime_t runtime, bigtime_t deadline,
+						bigtime_t period);
 
 // user/group functions
 extern gid_t		_kern_getgid(bool effective);
@@ -248,6 +263,8 @@ extern status_t		_kern_write_fs_info(dev_t device, const struct fs_info *info,
 						int mask);
 extern dev_t		_kern_next_device(int32 *_cookie);
 extern status_t		_kern_sync(void);
+extern status_t		_kern_get_vfs_cache_statistics(
+						struct vfs_cache_statistics *statistics, size_t size);
 extern status_t		_kern_entry_ref_to_path(dev_t device, ino_t inode,
 						const char *leaf, char *userPath, size_t pathLength);
 extern status_t		_kern_normalize_path(const char* userPath,
@@ -339,6 +356,17 @@ extern status_t		_kern_unlock_node(int fd);
 extern status_t		_kern_get_next_fd_info(team_id team, uint32 *_cookie,
 						struct fd_info *info, size_t infoSize);
 
+// asynchronous I/O functions
+extern int			_kern_create_async_io_context(uint32 maxRequests,
+						uint32 flags);
+extern ssize_t		_kern_submit_async_io(int context,
+						const struct async_io_request *requests,
+						size_t count);
+extern ssize_t		_kern_reap_async_io(int context,
+						struct async_io_completion *completions,
+						size_t count, size_t minCount, uint32 flags,
+						bigtime_t timeout);
+
 // socket functions
 extern int			_kern_socket(int family, int type, int protocol);
 extern status_t		_kern_bind(int socket, const struct sockaddr *address,
@@ -446,6 +474,8 @@ extern status_t		_kern_memory_advice(void *address, size_t size,
 
 extern status_t		_kern_get_memory_properties(team_id teamID,
 						const void *address, uint32* _protected, uint32* _lock);
+extern status_t		_kern_get_compressed_swap_info(
+						struct compressed_swap_info *info, size_t size);
 
 /* kernel port functions */
 extern port_id		_kern_create_port(int32 queue_length, const char *name);
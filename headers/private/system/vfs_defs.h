@@ -24,6 +24,21 @@ struct fd_info {
 };
 
 
+/* statistics of the VFS lookup caches, summed up over all mounted volumes */
+struct vfs_cache_statistics {
+	uint64	entry_cache_hits;
+	uint64	entry_cache_missing_hits;
+		/* lookups answered by an entry for a missing node */
+	uint64	entry_cache_misses;
+	uint32	entry_cache_entries;
+	uint32	entry_cache_missing_entries;
+	uint64	path_cache_hits;
+	uint64	path_cache_misses;
+	uint64	path_cache_invalidations;
+	uint32	path_cache_entries;
+};
+
+
 /* maximum write size to a pipe/FIFO that is guaranteed not to be interleaved
    with other writes (aka {PIPE_BUF}; must be >= _POSIX_PIPE_BUF) */
 #define VFS_FIFO_ATOMIC_WRITE_SIZE	PIPE_BUF
@@ -34,6 +34,9 @@
 #define B_KERNEL_AREA			0x4000
 	// Usable from userland according to its protection flags, but the area
 	// itself is not deletable, resizable, etc from userland.
+#define B_LARGE_PAGE_AREA		0x8000
+	// Only reported by get_area_info(): at least part of the area is mapped
+	// using large pages.
 
 #define B_USER_AREA_FLAGS		(B_USER_PROTECTION | B_OVERCOMMITTING_AREA)
 #define B_KERNEL_AREA_FLAGS \
@@ -53,5 +56,17 @@ enum {
 
 #define MEMORY_TYPE_SHIFT		28
 
+// statistics of the compressed swap tier, see _kern_get_compressed_swap_info()
+struct compressed_swap_info {
+	uint64	stored_pages;		// pages held compressed in memory
+	uint64	written_back_pages;	// pages that went on to a swap file
+	uint64	compressed_size;	// memory used by the stored pages
+	uint64	stores;
+	uint64	rejected;			// pages that didn't compress well enough
+	uint64	write_backs;
+	uint64	hits;				// reads served from memory
+	uint64	misses;				// reads that had to go to a swap file
+};
+
 
 #endif	/* _SYSTEM_VM_DEFS_H */
@@ -230,6 +230,22 @@ private:
 };
 
 
+//! The position of a key in the tree, as determined by _FindPosition().
+struct tree_position {
+	off_t	leaf;
+	uint16	index;
+	uint16	keyCount;
+		// the number of keys in the leaf
+	uint64	fraction;
+		// the position relative to the whole tree, in units of 1 / 2^32
+};
+
+
+// When counting the duplicates of a key, at most this many duplicate nodes are
+// read; any further duplicates are ignored.
+static const uint32 kMaxCountedDuplicateNodes = 8;
+
+
 // #pragma mark -
 
 
@@ -825,10 +841,19 @@ BPlusTree::Validate(bool repair, bool& _errorsFound)
 			fHeader.MaxNumberOfLevels());
 	}
 
-	if ((off_t)check.VisitedCount() != fHeader.MaximumSize() / fNodeSize) {
+	off_t nodeCount = fHeader.MaximumSize() / fNodeSize;
+	if ((off_t)check.VisitedCount() != nodeCount) {
 		dprintf("inode %" B_PRIdOFF ": visited %" B_PRIuSIZE " from %" B_PRIdOFF
-			" nodes.\n", fStream->ID(), check.VisitedCount(),
-			fHeader.MaximumSize() / fNodeSize);
+			" nodes.\n", fStream->ID(), check.VisitedCount(), nodeCount);
+
+		// Only if the whole tree could be walked, the nodes that were not
+		// visited are known to be unused
+		bool canRepair = repair && !check.ErrorsFound()
+			&& (off_t)check.VisitedCount() < nodeCount;
+		_errorsFound = true;
+
+		if (canRepair)
+			return _FreeUnreferencedNodes(check);
 	}
 
 	return B_OK;
@@ -2326,6 +2351,176 @@ BPlusTree::Find(const uint8* key, uint16 keyLength, off_t* _value)
 
 
 #if !_BOOT_MODE
+/*!	Estimates the number of values stored under the keys from \a from to
+	\a to. Either of the keys may be \c NULL to leave that end of the range
+	open; \a includeFrom and \a includeTo decide if the values of keys equal
+	to the limits are counted.
+
+	If the range lies within a single leaf node, its keys and their duplicates
+	are counted (of very long duplicate lists, only the start is counted).
+	Otherwise, the count is extrapolated from the positions of both ends of
+	the range in the tree, and the number of keys in their leaves; it is at
+	least 1 then, so that a count of zero is always reliable.
+	This only needs to read a few nodes, but the result is only a snapshot,
+	of course.
+*/
+status_t
+BPlusTree::EstimateRange(const uint8* from, uint16 fromLength,
+	bool includeFrom, const uint8* to, uint16 toLength, bool includeTo,
+	off_t& _count)
+{
+	if ((from != NULL && (fromLength < BPLUSTREE_MIN_KEY_LENGTH
+			|| fromLength > BPLUSTREE_MAX_KEY_LENGTH))
+		|| (to != NULL && (toLength < BPLUSTREE_MIN_KEY_LENGTH
+			|| toLength > BPLUSTREE_MAX_KEY_LENGTH)))
+		RETURN_ERROR(B_BAD_VALUE);
+
+	InodeReadLocker locker(fStream);
+
+	tree_position start;
+	tree_position end;
+	status_t status = _FindPosition(from, fromLength, !includeFrom, start);
+	if (status == B_OK)
+		status = _FindPosition(to, toLength, to == NULL || includeTo, end);
+	if (status != B_OK)
+		return status;
+
+	if (start.leaf == end.leaf) {
+		if (end.index <= start.index) {
+			_count = 0;
+			return B_OK;
+		}
+		return _CountValues(start.leaf, start.index, end.index, _count);
+	}
+
+	// The header, and the index nodes are counted as leaves, too, but that
+	// doesn't really matter for an estimate
+	off_t nodeCount = fHeader.MaximumSize() / fNodeSize;
+	uint64 keysPerNode = (start.keyCount + end.keyCount) / 2 + 1;
+	uint64 range = end.fraction > start.fraction
+		? end.fraction - start.fraction : 0;
+
+	_count = (((range * keysPerNode) >> 16) * nodeCount) >> 16;
+	if (_count < 1)
+		_count = 1;
+
+	return B_OK;
+}
+
+
+/*!	Determines the leaf and the index within it, where \a key is, or would be
+	stored in the tree, as well as its relative position in the whole tree.
+	\a after decides if the position before or after a key equal to \a key is
+	returned. If \a key is \c NULL, the position before the first or after the
+	last key is returned.
+	You need to have the inode read or write locked.
+*/
+status_t
+BPlusTree::_FindPosition(const uint8* key, uint16 keyLength, bool after,
+	tree_position& _position)
+{
+	off_t nodeOffset = fHeader.RootNode();
+	uint64 fraction = 0;
+	uint64 scale = 1ULL << 32;
+	uint32 levels = 0;
+
+	CachedNode cached(this);
+	const bplustree_node* node;
+	while ((node = cached.SetTo(nodeOffset)) != NULL) {
+		uint16 keyCount = node->NumKeys();
+		uint16 index = after ? keyCount : 0;
+		off_t nextOffset;
+
+		if (key != NULL) {
+			status_t status = _FindKey(node, key, keyLength, &index,
+				&nextOffset);
+			if (status == B_OK && after && node->IsLeaf())
+				index++;
+			else if (status != B_OK && status != B_ENTRY_NOT_FOUND)
+				return status;
+		} else if (index == keyCount)
+			nextOffset = node->OverflowLink();
+		else
+			nextOffset = BFS_ENDIAN_TO_HOST_INT64(node->Values()[index]);
+
+		if (node->IsLeaf()) {
+			if (keyCount > 0)
+				fraction += scale * index / keyCount;
+
+			_position.leaf = nodeOffset;
+			_position.index = index;
+			_position.keyCount = keyCount;
+			_position.fraction = fraction;
+			return B_OK;
+		}
+
+		// the child at "index" covers that part of its parent's range
+		fraction += scale * index / (keyCount + 1);
+		scale /= keyCount + 1;
+
+		if (nextOffset == nodeOffset
+			|| ++levels >= fHeader.MaxNumberOfLevels())
+			RETURN_ERROR(B_BAD_DATA);
+
+		nodeOffset = nextOffset;
+	}
+
+	FATAL(("b+tree node at %" B_PRIdOFF " could not be loaded, inode %"
+		B_PRIdOFF "\n", nodeOffset, fStream->ID()));
+	RETURN_ERROR(B_ERROR);
+}
+
+
+/*!	Counts the values of the keys from index \a from up to, but not including
+	\a to in the specified leaf node, including their duplicates.
+*/
+status_t
+BPlusTree::_CountValues(off_t leafOffset, uint16 from, uint16 to,
+	off_t& _count)
+{
+	CachedNode cached(this);
+	const bplustree_node* node = cached.SetTo(leafOffset);
+	if (node == NULL)
+		RETURN_ERROR(B_IO_ERROR);
+
+	if (to > node->NumKeys())
+		to = node->NumKeys();
+
+	CachedNode cachedDuplicate(this);
+	off_t count = 0;
+
+	for (uint16 i = from; i < to; i++) {
+		off_t value = BFS_ENDIAN_TO_HOST_INT64(node->Values()[i]);
+		uint8 type = bplustree_node::LinkType(value);
+
+		if (type == BPLUSTREE_DUPLICATE_FRAGMENT) {
+			const bplustree_node* fragment = cachedDuplicate.SetTo(
+				bplustree_node::FragmentOffset(value), false);
+			if (fragment == NULL)
+				RETURN_ERROR(B_IO_ERROR);
+
+			count += fragment->CountDuplicates(value, true);
+		} else if (type == BPLUSTREE_DUPLICATE_NODE) {
+			off_t duplicateOffset = bplustree_node::FragmentOffset(value);
+			for (uint32 j = 0; j < kMaxCountedDuplicateNodes
+					&& duplicateOffset != BPLUSTREE_NULL; j++) {
+				const bplustree_node* duplicate = cachedDuplicate.SetTo(
+					duplicateOffset, false);
+				if (duplicate == NULL)
+					RETURN_ERROR(B_IO_ERROR);
+
+				count += duplicate->CountDuplicates(duplicateOffset, false);
+				duplicateOffset = duplicate->RightLink();
+			}
+		} else
+			count++;
+	}
+
+	_count = count;
+	return B_OK;
+}
+
+
 status_t
 BPlusTree::_ValidateChildren(TreeCheck& check, uint32 level, off_t offset,
 	const uint8* largestKey, uint16 largestKeyLength,
@@ -2549,6 +2744,56 @@ BPlusTree::_ValidateChild(TreeCheck& check, CachedNode& cached, uint32 level,
 
 	return _ValidateChildren(check, level + 1, offset, key, keyLength, node);
 }
+
+
+/*!	Adds the nodes that are neither part of the tree nor of the free list to
+	the free list. Such nodes are left behind when a TreeBuilder is
+	interrupted, for example.
+*/
+status_t
+BPlusTree::_FreeUnreferencedNodes(TreeCheck& check)
+{
+	Transaction transaction(fStream->GetVolume(), fStream->BlockNumber());
+	fStream->WriteLockInTransaction(transaction);
+
+	CachedNode cached(this);
+	uint32 count = 0;
+
+	for (off_t offset = fNodeSize; offset < fHeader.MaximumSize();
+			offset += fNodeSize) {
+		if (check.Visited(offset))
+			continue;
+
+		dprintf("inode %" B_PRIdOFF ": freeing unreferenced node at %"
+			B_PRIdOFF "\n", fStream->ID(), offset);
+
+		if (cached.SetToWritable(transaction, offset, false) == NULL)
+			return B_IO_ERROR;
+
+		status_t status = cached.Free(transaction, offset);
+		if (status != B_OK)
+			return status;
+
+		// Don't let the transaction grow too large
+		if (++count % 256 == 0) {
+			cached.Unset();
+
+			status = transaction.Done();
+			if (status != B_OK)
+				return status;
+
+			status = transaction.Start(fStream->GetVolume(),
+				fStream->BlockNumber());
+			if (status != B_OK)
+				return status;
+
+			fStream->WriteLockInTransaction(transaction);
+		}
+	}
+
+	cached.Unset();
+	return transaction.Done();
+}
 #endif // !_BOOT_MODE
 
 
@@ -2900,6 +3145,763 @@ TreeIterator::Dump()
 #endif
 
 
+//	#pragma mark -
+
+
+#if !_BOOT_MODE
+static const size_t kBuilderChunkSize = 65536;
+static const uint32 kBuilderNodesPerTransaction = 256;
+static const uint32 kMaxBuilderNodeKeys = BPLUSTREE_NODE_SIZE
+	/ (sizeof(uint16) + sizeof(off_t) + BPLUSTREE_MIN_KEY_LENGTH) + 1;
+
+
+struct tree_builder_entry {
+	off_t	value;
+	uint16	keyLength;
+	uint8	key[0];
+};
+
+
+/*!	The in-memory copy of the node that is currently being filled on one
+	level of the tree. The key lengths are stored as in the on-disk node, as
+	the end offset of each key.
+*/
+struct tree_builder_node {
+	off_t	offset;
+	off_t	leftLink;
+	uint16	keyCount;
+	uint16	allKeyLength;
+	uint8	keys[BPLUSTREE_NODE_SIZE];
+	uint16	keyLengths[kMaxBuilderNodeKeys];
+	off_t	values[kMaxBuilderNodeKeys];
+};
+
+
+static inline size_t
+builder_entry_size(uint16 keyLength)
+{
+	return key_align(sizeof(tree_builder_entry) + keyLength);
+}
+
+
+/*!	Builds the contents of an empty tree from an unsorted set of entries.
+
+	The entries are collected in memory first, and are only written when
+	Finish() is called: they are then sorted, and the tree is written
+	bottom-up in a single pass, with every node filled completely. This is
+	much faster than inserting the entries one by one, and results in a
+	smaller tree.
+	The nodes are written in several transactions, but the tree is only
+	switched to the new root in the last one, so that an interrupted run
+	leaves an empty tree behind, not a damaged one. The nodes allocated up to
+	that point stay allocated, though; Validate() frees them again when
+	repairing the tree, and reports the tree as damaged, so that checkfs
+	rebuilds the index.
+
+	The builder is used by checkfs to rebuild indices. Creating an index on
+	a volume that already contains files does not need it, as only files
+	that are changed afterwards are added to a new index.
+
+	The memory for the entries is taken from \a memoryBudget, which can be
+	shared by several builders; without one, a builder may use up to
+	kMaxMemory bytes.
+*/
+TreeBuilder::TreeBuilder(BPlusTree* tree, size_t* memoryBudget)
+	:
+	fTree(tree),
+	fStatus(tree->InitCheck()),
+	fChunkUsed(0),
+	fEntryCount(0),
+	fMemoryUsed(0),
+	fOwnMemoryBudget(kMaxMemory),
+	fMemoryBudget(memoryBudget != NULL ? memoryBudget : &fOwnMemoryBudget),
+	fLevelCount(0),
+	fNodesWritten(0),
+	fCommittedNodes(0),
+	fKeyLength(0),
+	fHasKey(false),
+	fValueCount(0),
+	fFirstDuplicate(BPLUSTREE_NULL),
+	fDuplicateOffset(BPLUSTREE_NULL),
+	fPreviousDuplicate(BPLUSTREE_NULL),
+	fFragmentOffset(BPLUSTREE_NULL),
+	fFragmentIndex(0)
+{
+	memset(fLevels, 0, sizeof(fLevels));
+
+	if (fStatus != B_OK)
+		return;
+	if (fTree->fNodeSize > BPLUSTREE_NODE_SIZE) {
+		fStatus = B_BAD_VALUE;
+		return;
+	}
+
+	InodeReadLocker locker(fTree->fStream);
+
+	// We can only build trees that are empty
+	CachedNode cached(fTree);
+	const bplustree_node* root = cached.SetTo(fTree->fHeader.RootNode());
+	if (root == NULL)
+		fStatus = B_IO_ERROR;
+	else if (!root->IsLeaf() || root->NumKeys() != 0)
+		fStatus = B_BAD_VALUE;
+}
+
+
+TreeBuilder::~TreeBuilder()
+{
+	uint8* chunk;
+	while (fChunks.Pop(&chunk))
+		free(chunk);
+
+	for (int32 i = 0; i < kMaxLevels; i++)
+		free(fLevels[i]);
+
+	*fMemoryBudget += fMemoryUsed;
+}
+
+
+status_t
+TreeBuilder::InitCheck() const
+{
+	return fStatus;
+}
+
+
+/*!	Adds an entry to the tree. If there is no memory left to hold the entry,
+	or the memory budget is exhausted, B_NO_MEMORY is returned; the entries
+	added so far can still be written by calling Finish().
+*/
+status_t
+TreeBuilder::Add(const uint8* key, uint16 keyLength, off_t value)
+{
+	if (fStatus != B_OK)
+		return fStatus;
+	if (keyLength < BPLUSTREE_MIN_KEY_LENGTH
+		|| keyLength > BPLUSTREE_MAX_KEY_LENGTH)
+		RETURN_ERROR(B_BAD_VALUE);
+
+	size_t size = builder_entry_size(keyLength);
+	bool needsChunk = fChunks.IsEmpty()
+		|| fChunkUsed + size > kBuilderChunkSize;
+
+	// Finish() needs an additional pointer to each entry to sort them
+	size_t needed = (needsChunk ? kBuilderChunkSize : 0)
+		+ sizeof(tree_builder_entry*);
+	if (needed > *fMemoryBudget)
+		return B_NO_MEMORY;
+
+	if (needsChunk) {
+		uint8* chunk = (uint8*)malloc(kBuilderChunkSize);
+		if (chunk == NULL)
+			return B_NO_MEMORY;
+		if (fChunks.Push(chunk) != B_OK) {
+			free(chunk);
+			return B_NO_MEMORY;
+		}
+
+		// each chunk starts with the number of bytes used in it
+		fChunkUsed = sizeof(uint64);
+	}
+
+	*fMemoryBudget -= needed;
+	fMemoryUsed += needed;
+
+	uint8* chunk = fChunks.Array()[fChunks.CountItems() - 1];
+	tree_builder_entry* entry = (tree_builder_entry*)(chunk + fChunkUsed);
+	entry->value = value;
+	entry->keyLength = keyLength;
+	memcpy(entry->key, key, keyLength);
+
+	fChunkUsed += size;
+	*(uint64*)chunk = fChunkUsed;
+	fEntryCount++;
+
+	return B_OK;
+}
+
+
+/*!	Sorts the entries, and writes the tree. The tree inode must not be locked
+	by the caller. After this method has been called, the builder cannot be
+	used anymore.
+	If the tree cannot be built that way, the nodes written so far are freed
+	again, and the entries are inserted one by one instead.
+*/
+status_t
+TreeBuilder::Finish()
+{
+	if (fStatus != B_OK)
+		return fStatus;
+
+	fStatus = B_NOT_ALLOWED;
+
+	status_t status = _Build();
+	if (status == B_OK)
+		return B_OK;
+
+	FATAL(("TreeBuilder: could not build tree: %s, inserting entries one by "
+		"one\n", strerror(status)));
+
+	// Forget about the nodes of the current transaction
+	fTransaction.Abort();
+
+	status = _FreeNodes();
+	if (status != B_OK)
+		return status;
+
+	return _InsertEntries();
+}
+
+
+status_t
+TreeBuilder::_Build()
+{
+	tree_builder_entry** entries = NULL;
+	if (fEntryCount > 0) {
+		entries = _SortedEntries();
+		if (entries == NULL)
+			return B_NO_MEMORY;
+	}
+	MemoryDeleter entriesDeleter(entries);
+
+	Inode* stream = fTree->fStream;
+	status_t status = fTransaction.Start(stream->GetVolume(),
+		stream->BlockNumber());
+	if (status != B_OK)
+		return status;
+
+	stream->WriteLockInTransaction(fTransaction);
+
+	for (uint32 i = 0; i < fEntryCount; i++) {
+		status = _AddSorted(entries[i]->key, entries[i]->keyLength,
+			entries[i]->value);
+		if (status != B_OK)
+			return status;
+	}
+
+	if (fHasKey) {
+		status = _FlushKey();
+		if (status != B_OK)
+			return status;
+	}
+
+	// Write the last node of each level, and add it to its parent (this
+	// might add another level to the tree)
+	for (int32 level = 0; level < fLevelCount; level++) {
+		const uint8* lastKey;
+		uint16 lastKeyLength;
+		status = _WriteNode(level, BPLUSTREE_NULL, &lastKey, &lastKeyLength);
+		if (status == B_OK && level + 1 < fLevelCount) {
+			status = _AddToLevel(level + 1, lastKey, lastKeyLength,
+				fLevels[level]->offset);
+		}
+		if (status != B_OK)
+			return status;
+	}
+
+	if (fLevelCount > 0) {
+		// Switch to the new root, and free the empty old one
+		off_t oldRoot = fTree->fHeader.RootNode();
+
+		CachedNode cached(fTree);
+		bplustree_header* header = cached.SetToWritableHeader(fTransaction);
+		if (header == NULL)
+			return B_IO_ERROR;
+
+		header->root_node_pointer = HOST_ENDIAN_TO_BFS_INT64(
+			fLevels[fLevelCount - 1]->offset);
+		header->max_number_of_levels = HOST_ENDIAN_TO_BFS_INT32(fLevelCount);
+
+		if (cached.SetToWritable(fTransaction, oldRoot, false) == NULL)
+			return B_IO_ERROR;
+
+		status = cached.Free(fTransaction, oldRoot);
+		if (status != B_OK)
+			return status;
+	}
+
+	return fTransaction.Done();
+}
+
+
+/*!	Frees all nodes that have been allocated in already committed
+	transactions. The current transaction must have been aborted.
+*/
+status_t
+TreeBuilder::_FreeNodes()
+{
+	Inode* stream = fTree->fStream;
+	int32 index = 0;
+
+	while (index < fCommittedNodes) {
+		Transaction transaction(stream->GetVolume(), stream->BlockNumber());
+		stream->WriteLockInTransaction(transaction);
+
+		for (uint32 count = 0; count < kBuilderNodesPerTransaction
+				&& index < fCommittedNodes; count++, index++) {
+			off_t offset = fNodes.Array()[index];
+
+			CachedNode cached(fTree);
+			if (cached.SetToWritable(transaction, offset, false) == NULL)
+				return B_IO_ERROR;
+
+			status_t status = cached.Free(transaction, offset);
+			if (status != B_OK)
+				return status;
+		}
+
+		status_t status = transaction.Done();
+		if (status != B_OK)
+			return status;
+	}
+
+	fCommittedNodes = 0;
+	return B_OK;
+}
+
+
+/*!	Inserts the collected entries into the tree one at a time. Entries that
+	cannot be inserted are skipped, the first error is reported.
+*/
+status_t
+TreeBuilder::_InsertEntries()
+{
+	Inode* stream = fTree->fStream;
+	status_t status = B_OK;
+
+	for (int32 i = 0; i < fChunks.CountItems(); i++) {
+		uint8* chunk = fChunks.Array()[i];
+		uint64 used = *(uint64*)chunk;
+
+		for (uint64 offset = sizeof(uint64); offset < used;) {
+			tree_builder_entry* entry = (tree_builder_entry*)(chunk + offset);
+			offset += builder_entry_size(entry->keyLength);
+
+			Transaction transaction(stream->GetVolume(),
+				stream->BlockNumber());
+			stream->WriteLockInTransaction(transaction);
+
+			status_t entryStatus = fTree->Insert(transaction, entry->key,
+				entry->keyLength, entry->value);
+			if (entryStatus == B_OK)
+				entryStatus = transaction.Done();
+			if (entryStatus != B_OK && status == B_OK)
+				status = entryStatus;
+		}
+	}
+
+	return status;
+}
+
+
+tree_builder_entry**
+TreeBuilder::_SortedEntries()
+{
+	tree_builder_entry** entries = (tree_builder_entry**)malloc(
+		fEntryCount * sizeof(tree_builder_entry*));
+	if (entries == NULL)
+		return NULL;
+
+	uint32 count = 0;
+	for (int32 i = 0; i < fChunks.CountItems(); i++) {
+		uint8* chunk = fChunks.Array()[i];
+		uint64 used = *(uint64*)chunk;
+
+		for (uint64 offset = sizeof(uint64); offset < used;) {
+			tree_builder_entry* entry = (tree_builder_entry*)(chunk + offset);
+			entries[count++] = entry;
+			offset += builder_entry_size(entry->keyLength);
+		}
+	}
+
+	// Heap sort: it doesn't need any additional memory, and doesn't have a
+	// worst case to worry about
+	for (uint32 i = count / 2; i-- > 0;)
+		_SiftDown(entries, i, count);
+
+	while (count > 1) {
+		count--;
+		tree_builder_entry* entry = entries[0];
+		entries[0] = entries[count];
+		entries[count] = entry;
+		_SiftDown(entries, 0, count);
+	}
+
+	return entries;
+}
+
+
+void
+TreeBuilder::_SiftDown(tree_builder_entry** entries, uint32 index,
+	uint32 count)
+{
+	tree_builder_entry* entry = entries[index];
+
+	while (true) {
+		uint32 child = 2 * index + 1;
+		if (child >= count)
+			break;
+		if (child + 1 < count
+			&& _Compare(entries[child], entries[child + 1]) < 0)
+			child++;
+		if (_Compare(entry, entries[child]) >= 0)
+			break;
+
+		entries[index] = entries[child];
+		index = child;
+	}
+
+	entries[index] = entry;
+}
+
+
+int32
+TreeBuilder::_Compare(const tree_builder_entry* a,
+	const tree_builder_entry* b)
+{
+	int32 result = fTree->_CompareKeys(a->key, a->keyLength, b->key,
+		b->keyLength);
+	if (result != 0)
+		return result;
+
+	// duplicates are ordered by their value, as in the duplicate arrays
+	if (a->value < b->value)
+		return -1;
+	return a->value > b->value ? 1 : 0;
+}
+
+
+status_t
+TreeBuilder::_AddSorted(const uint8* key, uint16 keyLength, off_t value)
+{
+	if (fHasKey) {
+		if (fTree->_CompareKeys(fKey, fKeyLength, key, keyLength) == 0) {
+			if (!fTree->fAllowDuplicates)
+				RETURN_ERROR(B_NAME_IN_USE);
+			if (fValueCount > 0 && fValues[fValueCount - 1] == value)
+				return B_OK;
+
+			return _AddValue(value);
+		}
+
+		status_t status = _FlushKey();
+		if (status != B_OK)
+			return status;
+	}
+
+	memcpy(fKey, key, keyLength);
+	fKeyLength = keyLength;
+	fHasKey = true;
+	fValueCount = 0;
+	fFirstDuplicate = BPLUSTREE_NULL;
+	fDuplicateOffset = BPLUSTREE_NULL;
+	fPreviousDuplicate = BPLUSTREE_NULL;
+
+	return _AddValue(value);
+}
+
+
+status_t
+TreeBuilder::_AddValue(off_t value)
+{
+	if (fValueCount == NUM_DUPLICATE_VALUES) {
+		// The current duplicate node is full; the next one needs to be
+		// known before it can be written
+		status_t status;
+		if (fDuplicateOffset == BPLUSTREE_NULL) {
+			status = _AllocateNode(&fDuplicateOffset);
+			if (status != B_OK)
+				return status;
+
+			fFirstDuplicate = fDuplicateOffset;
+		}
+
+		off_t nextOffset;
+		status = _AllocateNode(&nextOffset);
+		if (status == B_OK)
+			status = _WriteDuplicates(nextOffset);
+		if (status != B_OK)
+			return status;
+
+		fPreviousDuplicate = fDuplicateOffset;
+		fDuplicateOffset = nextOffset;
+		fValueCount = 0;
+	}
+
+	fValues[fValueCount++] = value;
+	return B_OK;
+}
+
+
+/*!	Writes the values of the current key, and adds the key to the leaf
+	level.
+*/
+status_t
+TreeBuilder::_FlushKey()
+{
+	off_t value;
+	if (fDuplicateOffset != BPLUSTREE_NULL
+		|| fValueCount > NUM_FRAGMENT_VALUES) {
+		status_t status = B_OK;
+		if (fDuplicateOffset == BPLUSTREE_NULL) {
+			status = _AllocateNode(&fDuplicateOffset);
+			fFirstDuplicate = fDuplicateOffset;
+		}
+		if (status == B_OK)
+			status = _WriteDuplicates(BPLUSTREE_NULL);
+		if (status != B_OK)
+			return status;
+
+		value = bplustree_node::MakeLink(BPLUSTREE_DUPLICATE_NODE,
+			fFirstDuplicate);
+	} else if (fValueCount > 1) {
+		status_t status = _WriteFragment(&value);
+		if (status != B_OK)
+			return status;
+	} else
+		value = fValues[0];
+
+	fHasKey = false;
+	return _AddToLevel(0, fKey, fKeyLength, value);
+}
+
+
+/*!	Appends the key/value pair to the node currently being filled on the
+	given level. If it doesn't fit anymore, that node is written, and added
+	to the next level first.
+	In index nodes, the value of the last pair will become the overflow link
+	of the node once it is written.
+*/
+status_t
+TreeBuilder::_AddToLevel(int32 level, const uint8* key, uint16 keyLength,
+	off_t value)
+{
+	if (level >= kMaxLevels)
+		RETURN_ERROR(B_BAD_DATA);
+
+	tree_builder_node* node = fLevels[level];
+	if (node == NULL) {
+		node = (tree_builder_node*)malloc(sizeof(tree_builder_node));
+		if (node == NULL)
+			return B_NO_MEMORY;
+
+		status_t status = _AllocateNode(&node->offset);
+		if (status != B_OK) {
+			free(node);
+			return status;
+		}
+
+		node->leftLink = BPLUSTREE_NULL;
+		node->keyCount = 0;
+		node->allKeyLength = 0;
+
+		fLevels[level] = node;
+		fLevelCount = level + 1;
+	} else if (int32(key_align(sizeof(bplustree_node) + node->allKeyLength
+			+ keyLength) + (node->keyCount + 1) * (sizeof(uint16)
+			+ sizeof(off_t))) >= fTree->fNodeSize) {
+		// The node is full, write it, and continue with the next one
+		off_t nextOffset;
+		status_t status = _AllocateNode(&nextOffset);
+		if (status != B_OK)
+			return status;
+
+		const uint8* lastKey;
+		uint16 lastKeyLength;
+		status = _WriteNode(level, nextOffset, &lastKey, &lastKeyLength);
+		if (status == B_OK) {
+			status = _AddToLevel(level + 1, lastKey, lastKeyLength,
+				node->offset);
+		}
+		if (status != B_OK)
+			return status;
+
+		node->leftLink = node->offset;
+		node->offset = nextOffset;
+		node->keyCount = 0;
+		node->allKeyLength = 0;
+	}
+
+	memcpy(node->keys + node->allKeyLength, key, keyLength);
+	node->allKeyLength += keyLength;
+	node->keyLengths[node->keyCount] = node->allKeyLength;
+	node->values[node->keyCount] = value;
+	node->keyCount++;
+
+	return B_OK;
+}
+
+
+/*!	Writes the node of the given level to disk. Its last key is returned, as
+	that is the key its parent needs to reference it by.
+*/
+status_t
+TreeBuilder::_WriteNode(int32 level, off_t rightLink, const uint8** _lastKey,
+	uint16* _lastKeyLength)
+{
+	tree_builder_node* builderNode = fLevels[level];
+	uint16 keyCount = builderNode->keyCount;
+
+	uint16 lastKeyStart = keyCount > 1
+		? builderNode->keyLengths[keyCount - 2] : 0;
+	*_lastKey = builderNode->keys + lastKeyStart;
+	*_lastKeyLength = builderNode->keyLengths[keyCount - 1] - lastKeyStart;
+
+	off_t overflowLink = BPLUSTREE_NULL;
+	if (level > 0) {
+		// the last child of an index node is referenced by its overflow link
+		keyCount--;
+		overflowLink = builderNode->values[keyCount];
+	}
+	uint16 allKeyLength = keyCount > 0
+		? builderNode->keyLengths[keyCount - 1] : 0;
+
+	CachedNode cached(fTree);
+	bplustree_node* node = cached.SetToWritable(fTransaction,
+		builderNode->offset, false);
+	if (node == NULL)
+		return B_IO_ERROR;
+
+	memset(node, 0, fTree->fNodeSize);
+	node->left_link = HOST_ENDIAN_TO_BFS_INT64(builderNode->leftLink);
+	node->right_link = HOST_ENDIAN_TO_BFS_INT64(rightLink);
+	node->overflow_link = HOST_ENDIAN_TO_BFS_INT64(overflowLink);
+	node->all_key_count = HOST_ENDIAN_TO_BFS_INT16(keyCount);
+	node->all_key_length = HOST_ENDIAN_TO_BFS_INT16(allKeyLength);
+
+	memcpy(node->Keys(), builderNode->keys, allKeyLength);
+
+	uint16* keyLengths = node->KeyLengths();
+	off_t* values = node->Values();
+	for (uint16 i = 0; i < keyCount; i++) {
+		keyLengths[i] = HOST_ENDIAN_TO_BFS_INT16(builderNode->keyLengths[i]);
+		values[i] = HOST_ENDIAN_TO_BFS_INT64(builderNode->values[i]);
+	}
+
+	cached.Unset();
+	return _NodeWritten();
+}
+
+
+status_t
+TreeBuilder::_WriteDuplicates(off_t rightLink)
+{
+	CachedNode cached(fTree);
+	bplustree_node* node = cached.SetToWritable(fTransaction,
+		fDuplicateOffset, false);
+	if (node == NULL)
+		return B_IO_ERROR;
+
+	memset(node, 0, fTree->fNodeSize);
+	node->left_link = HOST_ENDIAN_TO_BFS_INT64(fPreviousDuplicate);
+	node->right_link = HOST_ENDIAN_TO_BFS_INT64(rightLink);
+
+	duplicate_array* array = node->DuplicateArray();
+	array->count = HOST_ENDIAN_TO_BFS_INT64(fValueCount);
+	for (uint32 i = 0; i < fValueCount; i++)
+		array->SetValueAt(i, fValues[i]);
+
+	cached.Unset();
+	return _NodeWritten();
+}
+
+
+/*!	Writes the values of the current key into the next free array of the
+	current fragment node, and returns the link to it.
+*/
+status_t
+TreeBuilder::_WriteFragment(off_t* _link)
+{
+	CachedNode cached(fTree);
+	bplustree_node* fragment;
+	bool isNew = false;
+
+	if (fFragmentOffset == BPLUSTREE_NULL
+		|| fFragmentIndex >= bplustree_node::MaxFragments(fTree->fNodeSize)) {
+		status_t status = cached.Allocate(fTransaction, &fragment,
+			&fFragmentOffset);
+		if (status == B_OK)
+			status = _NodeAllocated(cached, fFragmentOffset);
+		if (status != B_OK)
+			return status;
+
+		memset(fragment, 0, fTree->fNodeSize);
+		fFragmentIndex = 0;
+		isNew = true;
+	} else {
+		fragment = cached.SetToWritable(fTransaction, fFragmentOffset, false);
+		if (fragment == NULL)
+			return B_IO_ERROR;
+	}
+
+	duplicate_array* array = fragment->FragmentAt(fFragmentIndex);
+	array->count = HOST_ENDIAN_TO_BFS_INT64(fValueCount);
+	for (uint32 i = 0; i < fValueCount; i++)
+		array->SetValueAt(i, fValues[i]);
+
+	*_link = bplustree_node::MakeLink(BPLUSTREE_DUPLICATE_FRAGMENT,
+		fFragmentOffset, fFragmentIndex++);
+
+	cached.Unset();
+	return isNew ? _NodeWritten() : B_OK;
+}
+
+
+status_t
+TreeBuilder::_AllocateNode(off_t* _offset)
+{
+	CachedNode cached(fTree);
+	bplustree_node* node;
+	status_t status = cached.Allocate(fTransaction, &node, _offset);
+	if (status != B_OK)
+		return status;
+
+	return _NodeAllocated(cached, *_offset);
+}
+
+
+/*!	Remembers the node, so that it can be freed again in case the tree
+	cannot be completed.
+*/
+status_t
+TreeBuilder::_NodeAllocated(CachedNode& cached, off_t offset)
+{
+	if (fNodes.Push(offset) == B_OK)
+		return B_OK;
+
+	cached.Free(fTransaction, offset);
+	return B_NO_MEMORY;
+}
+
+
+/*!	Like MakeEmpty(), this splits up the work into several transactions, so
+	that they don't grow too large. The new nodes are not referenced by the
+	tree until Finish() is done, so the committed transactions only leave
+	unused nodes behind, should the rest not get written anymore.
+*/
+status_t
+TreeBuilder::_NodeWritten()
+{
+	if (++fNodesWritten % kBuilderNodesPerTransaction != 0)
+		return B_OK;
+
+	Inode* stream = fTree->fStream;
+	status_t status = fTransaction.Done();
+	if (status != B_OK)
+		return status;
+
+	fCommittedNodes = fNodes.CountItems();
+
+	status = fTransaction.Start(stream->GetVolume(), stream->BlockNumber());
+	if (status != B_OK)
+		return status;
+
+	stream->WriteLockInTransaction(fTransaction);
+	return B_OK;
+}
+#endif // !_BOOT_MODE
+
+
 // #pragma mark -
 
 
@@ -148,6 +148,8 @@ enum bplustree_traversing {
 
 class BPlusTree;
 struct TreeCheck;
+struct tree_position;
+class TreeBuilder;
 class TreeIterator;
 
 
@@ -296,6 +298,11 @@ public:
 									off_t* value);
 
 #if !_BOOT_MODE
+			status_t			EstimateRange(const uint8* from,
+									uint16 fromLength, bool includeFrom,
+									const uint8* to, uint16 toLength,
+									bool includeTo, off_t& _count);
+
 	static	int32				TypeCodeToKeyType(type_code code);
 	static	int32				ModeToKeyType(mode_t mode);
 
@@ -317,6 +324,11 @@ private:
 #if !_BOOT_MODE
 			status_t			_SeekDown(Stack<node_and_key>& stack,
 									const uint8* key, uint16 keyLength);
+			status_t			_FindPosition(const uint8* key,
+									uint16 keyLength, bool after,
+									tree_position& _position);
+			status_t			_CountValues(off_t leafOffset, uint16 from,
+									uint16 to, off_t& _count);
 
 			status_t			_FindFreeDuplicateFragment(
 									Transaction& transaction,
@@ -356,10 +368,12 @@ private:
 									off_t offset, off_t lastOffset,
 									off_t nextOffset, const uint8* key,
 									uint16 keyLength);
+			status_t			_FreeUnreferencedNodes(TreeCheck& check);
 #endif // !_BOOT_MODE
 
 private:
 			friend class TreeIterator;
+			friend class TreeBuilder;
 			friend class CachedNode;
 			friend struct TreeCheck;
 
@@ -427,6 +441,94 @@ private:
 };
 
 
+#if !_BOOT_MODE
+struct tree_builder_entry;
+struct tree_builder_node;
+
+
+class TreeBuilder {
+public:
+	static	const size_t		kMaxMemory = 64 * 1024 * 1024;
+
+								TreeBuilder(BPlusTree* tree,
+									size_t* memoryBudget = NULL);
+								~TreeBuilder();
+
+			status_t			InitCheck() const;
+
+			status_t			Add(const uint8* key, uint16 keyLength,
+									off_t value);
+			status_t			Add(const char* key, off_t value);
+			status_t			Add(int64 key, off_t value);
+			status_t			Finish();
+
+private:
+	static	const int32			kMaxLevels = 16;
+
+private:
+			tree_builder_entry** _SortedEntries();
+			void				_SiftDown(tree_builder_entry** entries,
+									uint32 index, uint32 count);
+			int32				_Compare(const tree_builder_entry* a,
+									const tree_builder_entry* b);
+
+			status_t			_Build();
+			status_t			_FreeNodes();
+			status_t			_InsertEntries();
+
+			status_t			_AddSorted(const uint8* key, uint16 keyLength,
+									off_t value);
+			status_t			_AddValue(off_t value);
+			status_t			_FlushKey();
+			status_t			_AddToLevel(int32 level, const uint8* key,
+									uint16 keyLength, off_t value);
+			status_t			_WriteNode(int32 level, off_t rightLink,
+									const uint8** _lastKey,
+									uint16* _lastKeyLength);
+			status_t			_WriteDuplicates(off_t rightLink);
+			status_t			_WriteFragment(off_t* _link);
+			status_t			_AllocateNode(off_t* _offset);
+			status_t			_NodeAllocated(CachedNode& cached,
+									off_t offset);
+			status_t			_NodeWritten();
+
+private:
+			BPlusTree*			fTree;
+			Transaction			fTransaction;
+			status_t			fStatus;
+
+			// the unsorted entries
+			Stack<uint8*>		fChunks;
+			size_t				fChunkUsed;
+			uint32				fEntryCount;
+			size_t				fMemoryUsed;
+			size_t				fOwnMemoryBudget;
+			size_t*				fMemoryBudget;
+
+			// the nodes currently being filled, one per level
+			tree_builder_node*	fLevels[kMaxLevels];
+			int32				fLevelCount;
+			uint32				fNodesWritten;
+
+			// all nodes allocated, and how many of them have been committed
+			Stack<off_t>		fNodes;
+			int32				fCommittedNodes;
+
+			// the key being added, and its values
+			uint8				fKey[BPLUSTREE_MAX_KEY_LENGTH];
+			uint16				fKeyLength;
+			bool				fHasKey;
+			off_t				fValues[NUM_DUPLICATE_VALUES];
+			uint32				fValueCount;
+			off_t				fFirstDuplicate;
+			off_t				fDuplicateOffset;
+			off_t				fPreviousDuplicate;
+			off_t				fFragmentOffset;
+			uint32				fFragmentIndex;
+};
+#endif // !_BOOT_MODE
+
+
 //	#pragma mark - BPlusTree's inline functions
 //	(most of them may not be needed)
 
@@ -533,6 +635,29 @@ TreeIterator::GetPreviousEntry(void* key, uint16* keyLength, uint16 maxLength,
 }
 
 
+#if !_BOOT_MODE
+//	#pragma mark - TreeBuilder inline functions
+
+
+inline status_t
+TreeBuilder::Add(const char* key, off_t value)
+{
+	if (fTree->fHeader.DataType() != BPLUSTREE_STRING_TYPE)
+		return B_BAD_TYPE;
+	return Add((uint8*)key, strlen(key), value);
+}
+
+
+inline status_t
+TreeBuilder::Add(int64 key, off_t value)
+{
+	if (fTree->fHeader.DataType() != BPLUSTREE_INT64_TYPE)
+		return B_BAD_TYPE;
+	return Add((uint8*)&key, sizeof(key), value);
+}
+#endif // !_BOOT_MODE
+
+
 //	#pragma mark - bplustree_header inline functions
 
 
@@ -172,18 +172,22 @@ private:
 struct check_index {
 	check_index()
 		:
-		inode(NULL)
+		inode(NULL),
+		builder(NULL)
 	{
 	}
 
 	char				name[B_FILE_NAME_LENGTH];
 	block_run			run;
 	Inode*				inode;
+	TreeBuilder*		builder;
 };
 
 
 struct check_cookie {
 	check_cookie()
+		:
+		builder_memory(TreeBuilder::kMaxMemory)
 	{
 	}
 
@@ -195,6 +199,8 @@ struct check_cookie {
 	TreeIterator*		iterator;
 	check_control		control;
 	Stack<check_index*>	indices;
+	size_t				builder_memory;
+		// shared by the builders of all indices
 };
 
 
@@ -211,6 +217,7 @@ public:
 		uint16 block);
 
 	uint32 NumBlockBits() const { return fNumBits; }
+	uint32 BitsPerBlock() const { return fVolume->BlockSize() << 3; }
 	uint32& Block(int32 index) { return ((uint32*)fBlock)[index]; }
 	uint8* Block() const { return (uint8*)fBlock; }
 
@@ -222,12 +229,50 @@ private:
 };
 
 
+/*!	Summarizes the free blocks in a range of an allocation group. The
+	summaries of an allocation group form a tree: the leaves cover a fixed
+	number of bits of the block bitmap each, and every other node combines
+	the summaries of its two children. This allows to find a free range of
+	a certain size without scanning the bitmap.
+*/
+struct free_extent_summary {
+	uint32	head;
+		// number of free blocks at the start of the range
+	uint32	tail;
+		// number of free blocks at the end of the range
+	uint32	largest;
+		// length of the largest free range within the range
+};
+
+
+// The number of bitmap bits a leaf of the summary tree covers; it must divide
+// the number of bits in a bitmap block.
+static const uint32 kSummaryLeafBits = 4096;
+
+
+struct free_extent_search {
+	uint32	from;
+	uint32	length;
+	uint32	run;
+		// length of the free range that ends at the current position
+	int32	start;
+	int32	bestStart;
+	int32	bestLength;
+};
+
+
 class AllocationGroup {
 public:
 	AllocationGroup();
+	~AllocationGroup();
+
+	status_t InitializeFromBitmap(const uint32* bitmap);
+	bool IsFull() const { return fFreeBits == 0 || fSummary == NULL; }
+	uint32 LargestLength() const
+		{ return fSummary != NULL ? fSummary[1].largest : 0; }
 
-	void AddFreeRange(int32 start, int32 blocks);
-	bool IsFull() const { return fFreeBits == 0; }
+	status_t FindFree(AllocationBlock& cached, uint32 from, uint32 length,
+		int32& _start, int32& _length);
 
 	status_t Allocate(Transaction& transaction, uint16 start, int32 length);
 	status_t Free(Transaction& transaction, uint16 start, int32 length);
@@ -235,19 +280,30 @@ public:
 	uint32 NumBits() const { return fNumBits; }
 	uint32 NumBlocks() const { return fNumBlocks; }
 	int32 Start() const { return fStart; }
+	mutex& Lock() { return fLock; }
+
+private:
+	uint32 _Size(uint32 begin, uint32 span) const;
+	uint32 _NodeSize(uint32 index) const;
+	void _UpdateNode(uint32 index);
+	void _UpdateSummary(AllocationBlock& cached, uint32 block, uint32 start,
+		uint32 length);
+	status_t _FindFree(AllocationBlock& cached, uint32 index, uint32 begin,
+		uint32 span, free_extent_search& search);
+	status_t _ScanLeaf(AllocationBlock& cached, uint32 begin, uint32 size,
+		free_extent_search& search);
 
 private:
 	friend class BlockAllocator;
 
+	mutex	fLock;
 	uint32	fNumBits;
 	uint32	fNumBlocks;
 	int32	fStart;
-	int32	fFirstFree;
 	int32	fFreeBits;
 
-	int32	fLargestStart;
-	int32	fLargestLength;
-	bool	fLargestValid;
+	free_extent_summary* fSummary;
+	uint32	fLeafCount;
 };
 
 
@@ -369,77 +425,202 @@ AllocationBlock::Free(uint16 start, uint16 numBlocks)
 //	#pragma mark -
 
 
+/*!	Combines the summaries of two adjacent ranges of \a leftSize, and
+	\a rightSize blocks into \a summary.
+*/
+static inline void
+combine_summaries(free_extent_summary& summary,
+	const free_extent_summary& left, uint32 leftSize,
+	const free_extent_summary& right, uint32 rightSize)
+{
+	summary.head = left.head == leftSize ? leftSize + right.head : left.head;
+	summary.tail = right.tail == rightSize
+		? rightSize + left.tail : right.tail;
+	summary.largest = max_c(max_c(left.largest, right.largest),
+		left.tail + right.head);
+}
+
+
+/*!	Computes the summary of the first \a numBits bits of \a bitmap, and
+	returns the number of free blocks in it.
+*/
+static uint32
+summarize_bits(const uint32* bitmap, uint32 numBits,
+	free_extent_summary& summary)
+{
+	uint32 freeBits = 0;
+	uint32 run = 0;
+	bool head = true;
+
+	summary.head = 0;
+	summary.largest = 0;
+
+	for (uint32 bit = 0; bit < numBits; bit += 32) {
+		uint32 bits = BFS_ENDIAN_TO_HOST_INT32(bitmap[bit >> 5]);
+		uint32 count = min_c(numBits - bit, 32U);
+
+		if (bits == 0) {
+			// all blocks are free
+			run += count;
+			freeBits += count;
+			continue;
+		}
+
+		for (uint32 i = 0; i < count; i++) {
+			if ((bits & (1UL << i)) == 0) {
+				run++;
+				freeBits++;
+				continue;
+			}
+
+			if (head) {
+				summary.head = run;
+				head = false;
+			}
+			if (run > summary.largest)
+				summary.largest = run;
+			run = 0;
+		}
+	}
+
+	if (head)
+		summary.head = run;
+	summary.tail = run;
+	if (run > summary.largest)
+		summary.largest = run;
+
+	return freeBits;
+}
+
+
 /*!	The allocation groups are created and initialized in
 	BlockAllocator::Initialize() and BlockAllocator::InitializeAndClearBitmap()
 	respectively.
 */
 AllocationGroup::AllocationGroup()
 	:
-	fFirstFree(-1),
+	fNumBits(0),
+	fNumBlocks(0),
+	fStart(0),
 	fFreeBits(0),
-	fLargestValid(false)
+	fSummary(NULL),
+	fLeafCount(0)
 {
+	mutex_init(&fLock, "bfs allocation group");
 }
 
 
-void
-AllocationGroup::AddFreeRange(int32 start, int32 blocks)
+AllocationGroup::~AllocationGroup()
 {
-	//D(if (blocks > 512)
-	//	PRINT(("range of %ld blocks starting at %ld\n",blocks,start)));
+	mutex_destroy(&fLock);
+	delete[] fSummary;
+}
+
 
-	if (fFirstFree == -1)
-		fFirstFree = start;
+/*!	Sets the free block count and summaries of the group from its part of the
+	block bitmap, which must be completely in memory.
+	The size of the group must already be known.
+*/
+status_t
+AllocationGroup::InitializeFromBitmap(const uint32* bitmap)
+{
+	if (fSummary == NULL) {
+		uint32 leaves = (fNumBits + kSummaryLeafBits - 1) / kSummaryLeafBits;
+		fLeafCount = 1;
+		while (fLeafCount < leaves)
+			fLeafCount <<= 1;
 
-	if (!fLargestValid || fLargestLength < blocks) {
-		fLargestStart = start;
-		fLargestLength = blocks;
-		fLargestValid = true;
+		fSummary = new(std::nothrow) free_extent_summary[2 * fLeafCount];
+		if (fSummary == NULL)
+			return B_NO_MEMORY;
 	}
 
-	fFreeBits += blocks;
+	memset(fSummary, 0, 2 * fLeafCount * sizeof(free_extent_summary));
+	fFreeBits = 0;
+
+	for (uint32 leaf = 0; leaf < fLeafCount; leaf++) {
+		uint32 begin = leaf * kSummaryLeafBits;
+		uint32 size = _Size(begin, kSummaryLeafBits);
+		if (size == 0)
+			break;
+
+		fFreeBits += summarize_bits(bitmap + begin / 32, size,
+			fSummary[fLeafCount + leaf]);
+	}
+
+	for (uint32 index = fLeafCount; index-- > 1;)
+		_UpdateNode(index);
+
+	return B_OK;
+}
+
+
+/*!	Searches the group for a range of at least \a length free blocks that
+	starts at or after \a from, and returns its start in \a _start.
+	If there is no such range, \c B_ENTRY_NOT_FOUND is returned, and the
+	first of the largest free ranges after \a from is put into \a _start and
+	\a _length instead - but only if it is longer than the \a _length passed
+	in.
+	Only the bitmap blocks that contain candidates are read; all others are
+	skipped by means of the summaries. Assumes that the group's lock is held.
+*/
+status_t
+AllocationGroup::FindFree(AllocationBlock& cached, uint32 from, uint32 length,
+	int32& _start, int32& _length)
+{
+	ASSERT_LOCKED_MUTEX(&fLock);
+
+	if (fSummary == NULL || from >= fNumBits)
+		return B_ENTRY_NOT_FOUND;
+
+	free_extent_search search;
+	search.from = from;
+	search.length = length;
+	search.run = 0;
+	search.start = -1;
+	search.bestStart = -1;
+	search.bestLength = _length;
+
+	status_t status = _FindFree(cached, 1, 0, fLeafCount * kSummaryLeafBits,
+		search);
+	if (status == B_OK) {
+		_start = search.start;
+		return B_OK;
+	}
+	if (status != B_ENTRY_NOT_FOUND)
+		return status;
+
+	// the free range at the end of the group
+	if ((int32)search.run > search.bestLength) {
+		search.bestStart = fNumBits - search.run;
+		search.bestLength = search.run;
+	}
+
+	if (search.bestLength > _length) {
+		_start = search.bestStart;
+		_length = search.bestLength;
+	}
+	return B_ENTRY_NOT_FOUND;
 }
 
 
 /*!	Allocates the specified run in the allocation group.
 	Doesn't check if the run is valid or already allocated partially, nor
-	does it maintain the free ranges hints or the volume's used blocks count.
-	It only does the low-level work of allocating some bits in the block bitmap.
-	Assumes that the block bitmap lock is hold.
+	does it maintain the volume's used blocks count.
+	It only does the low-level work of allocating some bits in the block bitmap,
+	and updates the summaries accordingly.
+	Assumes that the group's lock is held.
 */
 status_t
 AllocationGroup::Allocate(Transaction& transaction, uint16 start, int32 length)
 {
 	ASSERT(start + length <= (int32)fNumBits);
+	ASSERT_LOCKED_MUTEX(&fLock);
 
 	// Update the allocation group info
 	// TODO: this info will be incorrect if something goes wrong later
-	// Note, the fFirstFree block doesn't have to be really free
-	if (start == fFirstFree)
-		fFirstFree = start + length;
 	fFreeBits -= length;
 
-	if (fLargestValid) {
-		bool cut = false;
-		if (fLargestStart == start) {
-			// cut from start
-			fLargestStart += length;
-			fLargestLength -= length;
-			cut = true;
-		} else if (start > fLargestStart
-			&& start < fLargestStart + fLargestLength) {
-			// cut from end
-			fLargestLength = start - fLargestStart;
-			cut = true;
-		}
-		if (cut && (fLargestLength < fLargestStart
-				|| fLargestLength
-						< (int32)fNumBits - (fLargestStart + fLargestLength))) {
-			// might not be the largest block anymore
-			fLargestValid = false;
-		}
-	}
-
 	Volume* volume = transaction.GetVolume();
 
 	// calculate block in the block bitmap and position within
@@ -450,16 +631,15 @@ AllocationGroup::Allocate(Transaction& transaction, uint16 start, int32 length)
 	AllocationBlock cached(volume);
 
 	while (length > 0) {
-		if (cached.SetToWritable(transaction, *this, block) < B_OK) {
-			fLargestValid = false;
+		if (cached.SetToWritable(transaction, *this, block) < B_OK)
 			RETURN_ERROR(B_IO_ERROR);
-		}
 
 		uint32 numBlocks = length;
 		if (start + numBlocks > cached.NumBlockBits())
 			numBlocks = cached.NumBlockBits() - start;
 
 		cached.Allocate(start, numBlocks);
+		_UpdateSummary(cached, block * bitsPerBlock, start, numBlocks);
 
 		length -= numBlocks;
 		start = 0;
@@ -472,35 +652,21 @@ AllocationGroup::Allocate(Transaction& transaction, uint16 start, int32 length)
 
 /*!	Frees the specified run in the allocation group.
 	Doesn't check if the run is valid or was not completely allocated, nor
-	does it maintain the free ranges hints or the volume's used blocks count.
-	It only does the low-level work of freeing some bits in the block bitmap.
-	Assumes that the block bitmap lock is hold.
+	does it maintain the volume's used blocks count.
+	It only does the low-level work of freeing some bits in the block bitmap,
+	and updates the summaries accordingly.
+	Assumes that the group's lock is held.
 */
 status_t
 AllocationGroup::Free(Transaction& transaction, uint16 start, int32 length)
 {
 	ASSERT(start + length <= (int32)fNumBits);
+	ASSERT_LOCKED_MUTEX(&fLock);
 
 	// Update the allocation group info
 	// TODO: this info will be incorrect if something goes wrong later
-	if (fFirstFree > start)
-		fFirstFree = start;
 	fFreeBits += length;
 
-	// The range to be freed cannot be part of the valid largest range
-	ASSERT(!fLargestValid || start + length <= fLargestStart
-		|| start > fLargestStart);
-
-	if (fLargestValid
-		&& (start + length == fLargestStart
-			|| fLargestStart + fLargestLength == start
-			|| (start < fLargestStart && fLargestStart > fLargestLength)
-			|| (start > fLargestStart
-				&& (int32)fNumBits - (fLargestStart + fLargestLength)
-						> fLargestLength))) {
-		fLargestValid = false;
-	}
-
 	Volume* volume = transaction.GetVolume();
 
 	// calculate block in the block bitmap and position within
@@ -520,6 +686,7 @@ AllocationGroup::Free(Transaction& transaction, uint16 start, int32 length)
 			freeLength = cached.NumBlockBits() - start;
 
 		cached.Free(start, freeLength);
+		_UpdateSummary(cached, block * bitsPerBlock, start, freeLength);
 
 		length -= freeLength;
 		start = 0;
@@ -530,6 +697,142 @@ AllocationGroup::Free(Transaction& transaction, uint16 start, int32 length)
 }
 
 
+/*!	Returns the number of blocks of the range at \a begin with a length of
+	\a span that are actually part of the group.
+*/
+uint32
+AllocationGroup::_Size(uint32 begin, uint32 span) const
+{
+	if (begin >= fNumBits)
+		return 0;
+
+	return min_c(span, fNumBits - begin);
+}
+
+
+uint32
+AllocationGroup::_NodeSize(uint32 index) const
+{
+	uint32 span = kSummaryLeafBits;
+	while (index < fLeafCount) {
+		index <<= 1;
+		span <<= 1;
+	}
+
+	return _Size((index - fLeafCount) * kSummaryLeafBits, span);
+}
+
+
+void
+AllocationGroup::_UpdateNode(uint32 index)
+{
+	combine_summaries(fSummary[index], fSummary[2 * index],
+		_NodeSize(2 * index), fSummary[2 * index + 1],
+		_NodeSize(2 * index + 1));
+}
+
+
+/*!	Updates the summaries after \a length bits starting at \a start of the
+	bitmap block \a cached is set to have been changed. \a blockStart is the
+	number of the first block in the group that this bitmap block covers.
+*/
+void
+AllocationGroup::_UpdateSummary(AllocationBlock& cached, uint32 blockStart,
+	uint32 start, uint32 length)
+{
+	if (fSummary == NULL || length == 0)
+		return;
+
+	uint32 first = (blockStart + start) / kSummaryLeafBits;
+	uint32 last = (blockStart + start + length - 1) / kSummaryLeafBits;
+
+	for (uint32 leaf = first; leaf <= last; leaf++) {
+		uint32 begin = leaf * kSummaryLeafBits;
+		summarize_bits(&cached.Block((begin - blockStart) / 32),
+			_Size(begin, kSummaryLeafBits), fSummary[fLeafCount + leaf]);
+
+		for (uint32 index = (fLeafCount + leaf) / 2; index > 0; index /= 2)
+			_UpdateNode(index);
+	}
+}
+
+
+status_t
+AllocationGroup::_FindFree(AllocationBlock& cached, uint32 index,
+	uint32 begin, uint32 span, free_extent_search& search)
+{
+	uint32 size = _Size(begin, span);
+	if (size == 0 || begin + size <= search.from)
+		return B_ENTRY_NOT_FOUND;
+
+	const free_extent_summary& summary = fSummary[index];
+
+	if (begin >= search.from) {
+		// the whole range is part of the search
+		if (search.run + summary.head >= search.length) {
+			search.start = begin - search.run;
+			return B_OK;
+		}
+		if (summary.head == size) {
+			search.run += size;
+			return B_ENTRY_NOT_FOUND;
+		}
+		if (summary.largest < search.length
+			&& (int32)summary.largest <= search.bestLength) {
+			// only the free range at its start may be of interest
+			if ((int32)(search.run + summary.head) > search.bestLength) {
+				search.bestStart = begin - search.run;
+				search.bestLength = search.run + summary.head;
+			}
+			search.run = summary.tail;
+			return B_ENTRY_NOT_FOUND;
+		}
+	}
+
+	if (index >= fLeafCount)
+		return _ScanLeaf(cached, begin, size, search);
+
+	span /= 2;
+	status_t status = _FindFree(cached, 2 * index, begin, span, search);
+	if (status != B_ENTRY_NOT_FOUND)
+		return status;
+
+	return _FindFree(cached, 2 * index + 1, begin + span, span, search);
+}
+
+
+status_t
+AllocationGroup::_ScanLeaf(AllocationBlock& cached, uint32 begin, uint32 size,
+	free_extent_search& search)
+{
+	uint32 bitsPerBlock = cached.BitsPerBlock();
+	uint32 block = begin / bitsPerBlock;
+	if (cached.SetTo(*this, block) != B_OK)
+		RETURN_ERROR(B_IO_ERROR);
+
+	uint32 offset = block * bitsPerBlock;
+	uint32 end = begin + size;
+
+	for (uint32 bit = max_c(begin, search.from); bit < end; bit++) {
+		if (!cached.IsUsed(bit - offset)) {
+			if (++search.run >= search.length) {
+				search.start = bit + 1 - search.run;
+				return B_OK;
+			}
+			continue;
+		}
+
+		if ((int32)search.run > search.bestLength) {
+			search.bestStart = bit - search.run;
+			search.bestLength = search.run;
+		}
+		search.run = 0;
+	}
+
+	return B_ENTRY_NOT_FOUND;
+}
+
+
 //	#pragma mark -
 
 
@@ -537,6 +840,7 @@ BlockAllocator::BlockAllocator(Volume* volume)
 	:
 	fVolume(volume),
 	fGroups(NULL),
+	fInitializerRunning(0),
 	fCheckBitmap(NULL),
 	fCheckCookie(NULL)
 {
@@ -568,6 +872,7 @@ BlockAllocator::Initialize(bool full)
 
 	recursive_lock_lock(&fLock);
 		// the lock will be released by the _Initialize() method
+	atomic_set(&fInitializerRunning, 1);
 
 	thread_id id = spawn_kernel_thread((thread_func)BlockAllocator::_Initialize,
 		"bfs block allocator", B_LOW_PRIORITY, this);
@@ -618,9 +923,12 @@ BlockAllocator::InitializeAndClearBitmap(Transaction& transaction)
 			fGroups[i].fNumBlocks = fBlocksPerGroup;
 		}
 		fGroups[i].fStart = offset;
-		fGroups[i].fFirstFree = fGroups[i].fLargestStart = 0;
-		fGroups[i].fFreeBits = fGroups[i].fLargestLength = fGroups[i].fNumBits;
-		fGroups[i].fLargestValid = true;
+
+		status = fGroups[i].InitializeFromBitmap(buffer);
+		if (status != B_OK) {
+			free(buffer);
+			return status;
+		}
 
 		offset += fBlocksPerGroup;
 	}
@@ -629,10 +937,13 @@ BlockAllocator::InitializeAndClearBitmap(Transaction& transaction)
 	// reserve the boot block, the log area, and the block bitmap itself
 	uint32 reservedBlocks = fVolume->Log().Start() + fVolume->Log().Length();
 
+	MutexLocker groupLocker(fGroups[0].Lock());
 	if (fGroups[0].Allocate(transaction, 0, reservedBlocks) < B_OK) {
 		FATAL(("could not allocate reserved space for block bitmap/log!\n"));
 		return B_ERROR;
 	}
+	groupLocker.Unlock();
+
 	fVolume->SuperBlock().used_blocks
 		= HOST_ENDIAN_TO_BFS_INT64(reservedBlocks);
 
@@ -652,8 +963,10 @@ BlockAllocator::_Initialize(BlockAllocator* allocator)
 	off_t freeBlocks = 0;
 
 	uint32* buffer = (uint32*)malloc(blocks << blockShift);
-	if (buffer == NULL)
+	if (buffer == NULL) {
+		atomic_set(&allocator->fInitializerRunning, 0);
 		RETURN_ERROR(B_NO_MEMORY);
+	}
 
 	AllocationGroup* groups = allocator->fGroups;
 	off_t offset = 1;
@@ -676,27 +989,12 @@ BlockAllocator::_Initialize(BlockAllocator* allocator)
 		}
 		groups[i].fStart = offset;
 
-		// finds all free ranges in this allocation group
-		int32 start = -1, range = 0;
-		int32 numBits = groups[i].fNumBits, bit = 0;
-		int32 count = (numBits + 31) / 32;
-
-		for (int32 k = 0; k < count; k++) {
-			for (int32 j = 0; j < 32 && bit < numBits; j++, bit++) {
-				if (buffer[k] & (1UL << j)) {
-					// block is in use
-					if (range > 0) {
-						groups[i].AddFreeRange(start, range);
-						range = 0;
-					}
-				} else if (range++ == 0) {
-					// block is free, start new free range
-					start = bit;
-				}
-			}
+		// summarize all free ranges in this allocation group
+		if (groups[i].InitializeFromBitmap(buffer) != B_OK) {
+			FATAL(("could not allocate the summary of group %" B_PRId32 "\n",
+				i));
+			break;
 		}
-		if (range)
-			groups[i].AddFreeRange(start, range);
 
 		freeBlocks += groups[i].fFreeBits;
 
@@ -713,11 +1011,13 @@ BlockAllocator::_Initialize(BlockAllocator* allocator)
 				"(volume is mounted read-only)!\n"));
 		} else {
 			Transaction transaction(volume, 0);
+			MutexLocker groupLocker(groups[0].Lock());
 			if (groups[0].Allocate(transaction, 0, reservedBlocks) != B_OK) {
 				FATAL(("Could not allocate reserved space for block "
 					"bitmap/log!\n"));
 				volume->Panic();
 			} else {
+				groupLocker.Unlock();
 				transaction.Done();
 				FATAL(("Space for block bitmap or log area was not "
 					"reserved!\n"));
@@ -734,6 +1034,7 @@ BlockAllocator::_Initialize(BlockAllocator* allocator)
 		volume->SuperBlock().used_blocks = HOST_ENDIAN_TO_BFS_INT64(usedBlocks);
 	}
 
+	atomic_set(&allocator->fInitializerRunning, 0);
 	return B_OK;
 }
 
@@ -753,10 +1054,19 @@ BlockAllocator::Uninitialize()
 
 	The number of allocated blocks is always a multiple of \a minimum which
 	has to be a power of two value.
+
+	Blocks that are reserved for delayed data are not handed out, except for
+	the \a reserved ones that have been reserved for this allocation. Since
+	all allocations are done by the owner of the journal, the free block
+	count cannot change while this method runs.
+
+	Only the lock of the group that is currently looked at is held, so that
+	allocations in different groups don't have to wait for each other.
 */
 status_t
 BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
-	uint16 start, uint16 maximum, uint16 minimum, block_run& run)
+	uint16 start, uint16 maximum, uint16 minimum, block_run& run,
+	off_t reserved)
 {
 	if (maximum == 0)
 		return B_BAD_VALUE;
@@ -764,181 +1074,82 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 	FUNCTION_START(("group = %ld, start = %u, maximum = %u, minimum = %u\n",
 		groupIndex, start, maximum, minimum));
 
-	AllocationBlock cached(fVolume);
-	RecursiveLocker lock(fLock);
-
-	uint32 bitsPerFullBlock = fVolume->BlockSize() << 3;
+	_WaitForInitializer();
 
-	// Find the block_run that can fulfill the request best
-	int32 bestGroup = -1;
-	int32 bestStart = -1;
-	int32 bestLength = -1;
+	off_t available = fVolume->FreeBlocks() + reserved;
+	if (available < minimum)
+		return B_DEVICE_FULL;
+	if (available < maximum)
+		maximum = round_down(available, minimum);
 
-	for (int32 i = 0; i < fNumGroups + 1; i++, groupIndex++, start = 0) {
-		groupIndex = groupIndex % fNumGroups;
-		AllocationGroup& group = fGroups[groupIndex];
+	AllocationBlock cached(fVolume);
+	int32 firstGroup = groupIndex;
+	uint16 firstStart = start;
 
-		CHECK_ALLOCATION_GROUP(groupIndex);
+	while (true) {
+		// Find the block_run that can fulfill the request best
+		int32 bestGroup = -1;
+		int32 bestStart = -1;
+		int32 bestLength = -1;
 
-		if (start >= group.NumBits() || group.IsFull())
-			continue;
+		groupIndex = firstGroup;
+		start = firstStart;
 
-		// The wanted maximum is smaller than the largest free block in the
-		// group or already smaller than the minimum
+		for (int32 i = 0; i < fNumGroups + 1; i++, groupIndex++, start = 0) {
+			groupIndex = groupIndex % fNumGroups;
+			AllocationGroup& group = fGroups[groupIndex];
 
-		if (start < group.fFirstFree)
-			start = group.fFirstFree;
+			MutexLocker groupLocker(group.Lock());
+			CHECK_ALLOCATION_GROUP(groupIndex);
 
-		if (group.fLargestValid) {
-			if (group.fLargestLength < bestLength)
+			// The summary tells us right away if the group has a range
+			// that is large enough, or at least larger than what we have
+			if (start >= group.NumBits() || group.IsFull()
+				|| (int32)group.LargestLength() <= bestLength)
 				continue;
 
-			if (group.fLargestStart >= start) {
-				if (group.fLargestLength >= bestLength) {
-					bestGroup = groupIndex;
-					bestStart = group.fLargestStart;
-					bestLength = group.fLargestLength;
-
-					if (bestLength >= maximum)
-						break;
-				}
-
-				// We know everything about this group we have to, let's skip
-				// to the next
-				continue;
+			int32 rangeStart = -1;
+			int32 rangeLength = bestLength;
+			status_t status = group.FindFree(cached, start, maximum,
+				rangeStart, rangeLength);
+			if (status == B_OK) {
+				return _AllocateRun(transaction, groupIndex, rangeStart,
+					maximum, run);
 			}
-		}
+			if (status != B_ENTRY_NOT_FOUND)
+				RETURN_ERROR(status);
 
-		// There may be more than one block per allocation group - and
-		// we iterate through it to find a place for the allocation.
-		// (one allocation can't exceed one allocation group)
-
-		uint32 block = start / (fVolume->BlockSize() << 3);
-		int32 currentStart = 0, currentLength = 0;
-		int32 groupLargestStart = -1;
-		int32 groupLargestLength = -1;
-		int32 currentBit = start;
-		bool canFindGroupLargest = start == 0;
-
-		for (; block < group.NumBlocks(); block++) {
-			if (cached.SetTo(group, block) < B_OK)
-				RETURN_ERROR(B_ERROR);
-
-			T(Block("alloc-in", group.Start() + block, cached.Block(),
-				fVolume->BlockSize(), groupIndex, currentStart));
-
-			// find a block large enough to hold the allocation
-			for (uint32 bit = start % bitsPerFullBlock;
-					bit < cached.NumBlockBits(); bit++) {
-				if (!cached.IsUsed(bit)) {
-					if (currentLength == 0) {
-						// start new range
-						currentStart = currentBit;
-					}
-
-					// have we found a range large enough to hold numBlocks?
-					if (++currentLength >= maximum) {
-						bestGroup = groupIndex;
-						bestStart = currentStart;
-						bestLength = currentLength;
-						break;
-					}
-				} else {
-					if (currentLength) {
-						// end of a range
-						if (currentLength > bestLength) {
-							bestGroup = groupIndex;
-							bestStart = currentStart;
-							bestLength = currentLength;
-						}
-						if (currentLength > groupLargestLength) {
-							groupLargestStart = currentStart;
-							groupLargestLength = currentLength;
-						}
-						currentLength = 0;
-					}
-					if ((int32)group.NumBits() - currentBit
-							<= groupLargestLength) {
-						// We can't find a bigger block in this group anymore,
-						// let's skip the rest.
-						block = group.NumBlocks();
-						break;
-					}
-				}
-				currentBit++;
-			}
-
-			T(Block("alloc-out", block, cached.Block(),
-				fVolume->BlockSize(), groupIndex, currentStart));
-
-			if (bestLength >= maximum) {
-				canFindGroupLargest = false;
-				break;
-			}
-
-			// start from the beginning of the next block
-			start = 0;
-		}
-
-		if (currentBit == (int32)group.NumBits()) {
-			if (currentLength > bestLength) {
+			if (rangeLength > bestLength) {
 				bestGroup = groupIndex;
-				bestStart = currentStart;
-				bestLength = currentLength;
-			}
-			if (canFindGroupLargest && currentLength > groupLargestLength) {
-				groupLargestStart = currentStart;
-				groupLargestLength = currentLength;
+				bestStart = rangeStart;
+				bestLength = rangeLength;
 			}
 		}
 
-		if (canFindGroupLargest && !group.fLargestValid
-			&& groupLargestLength >= 0) {
-			group.fLargestStart = groupLargestStart;
-			group.fLargestLength = groupLargestLength;
-			group.fLargestValid = true;
-		}
-
-		if (bestLength >= maximum)
-			break;
-	}
+		if (bestLength < minimum)
+			return B_DEVICE_FULL;
 
-	// If we found a suitable range, mark the blocks as in use, and
-	// write the updated block bitmap back to disk
-	if (bestLength < minimum)
-		return B_DEVICE_FULL;
+		if (minimum > 1) {
+			// make sure bestLength is a multiple of minimum
+			bestLength = round_down(bestLength, minimum);
+		}
 
-	if (bestLength > maximum)
-		bestLength = maximum;
-	else if (minimum > 1) {
-		// make sure bestLength is a multiple of minimum
-		bestLength = round_down(bestLength, minimum);
+		// The group was unlocked in the mean time, make sure the range is
+		// still free before using it
+		AllocationGroup& group = fGroups[bestGroup];
+		MutexLocker groupLocker(group.Lock());
+
+		int32 rangeStart = -1;
+		int32 rangeLength = 0;
+		status_t status = group.FindFree(cached, bestStart, bestLength,
+			rangeStart, rangeLength);
+		if (status == B_OK && rangeStart == bestStart) {
+			return _AllocateRun(transaction, bestGroup, bestStart, bestLength,
+				run);
+		}
+		if (status != B_OK && status != B_ENTRY_NOT_FOUND)
+			RETURN_ERROR(status);
 	}
-
-	if (fGroups[bestGroup].Allocate(transaction, bestStart, bestLength) != B_OK)
-		RETURN_ERROR(B_IO_ERROR);
-
-	CHECK_ALLOCATION_GROUP(bestGroup);
-
-	run.allocation_group = HOST_ENDIAN_TO_BFS_INT32(bestGroup);
-	run.start = HOST_ENDIAN_TO_BFS_INT16(bestStart);
-	run.length = HOST_ENDIAN_TO_BFS_INT16(bestLength);
-
-	fVolume->SuperBlock().used_blocks
-		= HOST_ENDIAN_TO_BFS_INT64(fVolume->UsedBlocks() + bestLength);
-		// We are not writing back the disk's superblock - it's
-		// either done by the journaling code, or when the disk
-		// is unmounted.
-		// If the value is not correct at mount time, it will be
-		// fixed anyway.
-
-	// We need to flush any remaining blocks in the new allocation to make sure
-	// they won't interfere with the file cache.
-	block_cache_discard(fVolume->BlockCache(), fVolume->ToBlock(run),
-		run.Length());
-
-	T(Allocate(run));
-	return B_OK;
 }
 
 
@@ -961,6 +1172,51 @@ BlockAllocator::AllocateForInode(Transaction& transaction,
 }
 
 
+/*!	Retrieves the last run of the data stream \a data, so that new blocks can
+	be allocated right after it.
+	Returns \c false if there is no such run, or if the stream has already
+	grown into the double indirect range, which is not worth searching.
+*/
+static bool
+last_stream_run(Volume* volume, const data_stream& data, block_run& run)
+{
+	if (data.MaxDoubleIndirectRange() != 0)
+		return false;
+
+	if (data.MaxIndirectRange() == 0) {
+		int32 last = 0;
+		for (; last < NUM_DIRECT_BLOCKS - 1; last++) {
+			if (data.direct[last + 1].IsZero())
+				break;
+		}
+
+		run = data.direct[last];
+		return !run.IsZero();
+	}
+
+	CachedBlock cached(volume);
+	off_t block = volume->ToBlock(data.indirect);
+	int32 runsPerBlock = volume->BlockSize() / sizeof(block_run);
+	bool found = false;
+
+	for (int32 i = 0; i < data.indirect.Length(); i++) {
+		const block_run* runs = (const block_run*)cached.SetTo(block + i);
+		if (runs == NULL)
+			return false;
+
+		for (int32 j = 0; j < runsPerBlock; j++) {
+			if (runs[j].IsZero())
+				return found;
+
+			run = runs[j];
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+
 status_t
 BlockAllocator::Allocate(Transaction& transaction, Inode* inode,
 	off_t numBlocks, block_run& run, uint16 minimum)
@@ -992,20 +1248,11 @@ BlockAllocator::Allocate(Transaction& transaction, Inode* inode,
 
 	// Are there already allocated blocks? (then just try to allocate near the
 	// last one)
-	if (inode->Size() > 0) {
-		const data_stream& data = inode->Node().data;
-		// TODO: we currently don't care for when the data stream
-		// is already grown into the indirect ranges
-		if (data.max_double_indirect_range == 0
-			&& data.max_indirect_range == 0) {
-			// Since size > 0, there must be a valid block run in this stream
-			int32 last = 0;
-			for (; last < NUM_DIRECT_BLOCKS - 1; last++)
-				if (data.direct[last + 1].IsZero())
-					break;
-
-			group = data.direct[last].AllocationGroup();
-			start = data.direct[last].Start() + data.direct[last].Length();
+	if (inode->Node().data.Size() > 0) {
+		block_run last;
+		if (last_stream_run(fVolume, inode->Node().data, last)) {
+			group = last.AllocationGroup();
+			start = last.Start() + last.Length();
 		}
 	} else if (inode->IsContainer() || inode->IsSymLink()) {
 		// directory and symbolic link data will go in the same allocation
@@ -1016,14 +1263,16 @@ BlockAllocator::Allocate(Transaction& transaction, Inode* inode,
 		group = inode->BlockRun().AllocationGroup() + 1;
 	}
 
-	return AllocateBlocks(transaction, group, start, numBlocks, minimum, run);
+	// The inode's own reservation is what it grows into
+	return AllocateBlocks(transaction, group, start, numBlocks, minimum, run,
+		inode->DelayedBlocks());
 }
 
 
 status_t
 BlockAllocator::Free(Transaction& transaction, block_run run)
 {
-	RecursiveLocker lock(fLock);
+	_WaitForInitializer();
 
 	int32 group = run.AllocationGroup();
 	uint16 start = run.Start();
@@ -1053,6 +1302,9 @@ BlockAllocator::Free(Transaction& transaction, block_run run)
 		DEBUGGER(("tried to free reserved block"));
 		return B_BAD_VALUE;
 	}
+
+	MutexLocker groupLocker(fGroups[group].Lock());
+
 #ifdef DEBUG
 	if (CheckBlockRun(run) != B_OK)
 		return B_BAD_DATA;
@@ -1072,12 +1324,69 @@ BlockAllocator::Free(Transaction& transaction, block_run run)
 	}
 #endif
 
-	fVolume->SuperBlock().used_blocks =
-		HOST_ENDIAN_TO_BFS_INT64(fVolume->UsedBlocks() - run.Length());
+	groupLocker.Unlock();
+
+	_UpdateUsedBlocks(-(off_t)run.Length());
 	return B_OK;
 }
 
 
+/*!	Waits until the initializer thread has read in the block bitmap, if it's
+	still running.
+*/
+void
+BlockAllocator::_WaitForInitializer()
+{
+	if (atomic_get(&fInitializerRunning) != 0) {
+		// the initializer holds the lock until it's done
+		RecursiveLocker locker(fLock);
+	}
+}
+
+
+/*!	Marks the given range as used, and fills in \a run accordingly.
+	Assumes that the lock of the group is held.
+*/
+status_t
+BlockAllocator::_AllocateRun(Transaction& transaction, int32 groupIndex,
+	int32 start, int32 length, block_run& run)
+{
+	if (fGroups[groupIndex].Allocate(transaction, start, length) != B_OK)
+		RETURN_ERROR(B_IO_ERROR);
+
+	CHECK_ALLOCATION_GROUP(groupIndex);
+
+	run.allocation_group = HOST_ENDIAN_TO_BFS_INT32(groupIndex);
+	run.start = HOST_ENDIAN_TO_BFS_INT16(start);
+	run.length = HOST_ENDIAN_TO_BFS_INT16(length);
+
+	_UpdateUsedBlocks(length);
+		// We are not writing back the disk's superblock - it's
+		// either done by the journaling code, or when the disk
+		// is unmounted.
+		// If the value is not correct at mount time, it will be
+		// fixed anyway.
+
+	// We need to flush any remaining blocks in the new allocation to make sure
+	// they won't interfere with the file cache.
+	block_cache_discard(fVolume->BlockCache(), fVolume->ToBlock(run),
+		run.Length());
+
+	T(Allocate(run));
+	return B_OK;
+}
+
+
+void
+BlockAllocator::_UpdateUsedBlocks(off_t delta)
+{
+	MutexLocker locker(fVolume->Lock());
+
+	fVolume->SuperBlock().used_blocks
+		= HOST_ENDIAN_TO_BFS_INT64(fVolume->UsedBlocks() + delta);
+}
+
+
 size_t
 BlockAllocator::BitmapSize() const
 {
@@ -1101,6 +1410,7 @@ BlockAllocator::Fragment()
 
 		for (uint32 block = 0; block < group.NumBlocks(); block++) {
 			Transaction transaction(fVolume, 0);
+			MutexLocker groupLocker(group.Lock());
 
 			if (cached.SetToWritable(transaction, group, block) != B_OK)
 				return;
@@ -1109,6 +1419,10 @@ BlockAllocator::Fragment()
 				cached.Block(index) |= HOST_ENDIAN_TO_BFS_INT32(kMask);
 			}
 
+			group._UpdateSummary(cached, block * cached.BitsPerBlock(), 0,
+				cached.NumBlockBits());
+			groupLocker.Unlock();
+
 			transaction.Done();
 		}
 	}
@@ -1121,70 +1435,45 @@ void
 BlockAllocator::_CheckGroup(int32 groupIndex) const
 {
 	AllocationBlock cached(fVolume);
-	ASSERT_LOCKED_RECURSIVE(&fLock);
-
 	AllocationGroup& group = fGroups[groupIndex];
+	ASSERT_LOCKED_MUTEX(&group.fLock);
+
+	if (group.fSummary == NULL)
+		return;
+
+	uint32 bitsPerBlock = fVolume->BlockSize() << 3;
+	int32 freeBits = 0;
 
-	int32 currentStart = 0, currentLength = 0;
-	int32 firstFree = -1;
-	int32 largestStart = -1;
-	int32 largestLength = 0;
-	int32 currentBit = 0;
+	for (uint32 leaf = 0; leaf < group.fLeafCount; leaf++) {
+		uint32 begin = leaf * kSummaryLeafBits;
+		uint32 size = group._Size(begin, kSummaryLeafBits);
+		if (size == 0)
+			break;
 
-	for (uint32 block = 0; block < group.NumBlocks(); block++) {
+		uint32 block = begin / bitsPerBlock;
 		if (cached.SetTo(group, block) < B_OK) {
 			panic("setting group block %d failed\n", (int)block);
 			return;
 		}
 
-		for (uint32 bit = 0; bit < cached.NumBlockBits(); bit++) {
-			if (!cached.IsUsed(bit)) {
-				if (firstFree < 0) {
-					firstFree = currentBit;
-					if (!group.fLargestValid) {
-						if (firstFree >= 0 && firstFree < group.fFirstFree) {
-							// mostly harmless but noteworthy
-							dprintf("group %d first free too late: should be "
-								"%d, is %d\n", (int)groupIndex, (int)firstFree,
-								(int)group.fFirstFree);
-						}
-						return;
-					}
-				}
-
-				if (currentLength == 0) {
-					// start new range
-					currentStart = currentBit;
-				}
-				currentLength++;
-			} else if (currentLength) {
-				// end of a range
-				if (currentLength > largestLength) {
-					largestStart = currentStart;
-					largestLength = currentLength;
-				}
-				currentLength = 0;
-			}
-			currentBit++;
+		free_extent_summary summary;
+		freeBits += summarize_bits(
+			&cached.Block((begin - block * bitsPerBlock) / 32), size, summary);
+
+		const free_extent_summary& stored
+			= group.fSummary[group.fLeafCount + leaf];
+		if (summary.head != stored.head || summary.tail != stored.tail
+			|| summary.largest != stored.largest) {
+			panic("bfs %p: group %d leaf %d differs: %d/%d/%d, checked "
+				"%d/%d/%d.\n", fVolume, (int)groupIndex, (int)leaf,
+				(int)stored.head, (int)stored.tail, (int)stored.largest,
+				(int)summary.head, (int)summary.tail, (int)summary.largest);
 		}
 	}
 
-	if (currentLength > largestLength) {
-		largestStart = currentStart;
-		largestLength = currentLength;
-	}
-
-	if (firstFree >= 0 && firstFree < group.fFirstFree) {
-		// mostly harmless but noteworthy
-		dprintf("group %d first free too late: should be %d, is %d\n",
-			(int)groupIndex, (int)firstFree, (int)group.fFirstFree);
-	}
-	if (group.fLargestValid
-		&& (largestStart != group.fLargestStart
-			|| largestLength != group.fLargestLength)) {
-		panic("bfs %p: group %d largest differs: %d.%d, checked %d.%d.\n",
-			fVolume, (int)groupIndex, (int)group.fLargestStart,
-			(int)group.fLargestLength, (int)largestStart, (int)largestLength);
+	if (freeBits != group.fFreeBits) {
+		panic("bfs %p: group %d free bits differ: %d, checked %d.\n",
+			fVolume, (int)groupIndex, (int)group.fFreeBits, (int)freeBits);
 	}
 }
 #endif	// DEBUG_ALLOCATION_GROUPS
@@ -1219,6 +1508,10 @@ BlockAllocator::Trim(uint64 offset, uint64 size, uint64& trimmedSize)
 	for (int32 groupIndex = 0; groupIndex <= lastGroup; groupIndex++) {
 		AllocationGroup& group = fGroups[groupIndex];
 
+		// Only this group is locked while it's being trimmed, allocations
+		// may continue in all others
+		MutexLocker groupLocker(group.Lock());
+
 		for (uint32 block = firstBlock; block < group.NumBlocks(); block++) {
 			cached.SetTo(group, block);
 
@@ -1243,12 +1536,22 @@ BlockAllocator::Trim(uint64 offset, uint64 size, uint64& trimmedSize)
 			}
 		}
 
+		// The free ranges must be trimmed before they can be allocated again
+		if (freeLength > 0 || trimData->range_count > 0) {
+			status_t status = _TrimNext(*trimData, kTrimRanges,
+				firstFree << blockShift, freeLength << blockShift, true,
+				trimmedSize);
+			if (status != B_OK)
+				return status;
+
+			freeLength = 0;
+		}
+
 		firstBlock = 0;
 		firstBit = 0;
 	}
 
-	return _TrimNext(*trimData, kTrimRanges, firstFree << blockShift,
-		freeLength << blockShift, true, trimmedSize);
+	return B_OK;
 }
 
 
@@ -1362,6 +1665,8 @@ BlockAllocator::StopChecking(check_control* control)
 			break;
 
 		case BFS_CHECK_PASS_INDEX:
+			// write what has been collected, even if we didn't run through
+			_WriteIndices();
 			_FreeIndices();
 			break;
 	}
@@ -1433,6 +1738,14 @@ BlockAllocator::CheckNextNode(check_control* control)
 					continue;
 				}
 
+				if (fCheckCookie->pass == BFS_CHECK_PASS_INDEX) {
+					status_t status = _WriteIndices();
+					if (status != B_OK) {
+						fCheckCookie->control.status = status;
+						return status;
+					}
+				}
+
 				fCheckCookie->control.status = B_ENTRY_NOT_FOUND;
 				return B_ENTRY_NOT_FOUND;
 			}
@@ -1690,7 +2003,6 @@ BlockAllocator::_WriteBackCheckBitmap()
 	size_t size = BitmapSize();
 	off_t usedBlocks = 0LL;
 
-	// TODO: update the allocation groups used blocks info
 	for (uint32 i = size >> 2; i-- > 0;) {
 		uint32 compare = 1;
 		// Count the number of bits set
@@ -1751,6 +2063,16 @@ BlockAllocator::_WriteBackCheckBitmap()
 			}
 			transaction.Done();
 		}
+
+		// The summaries of the groups have to follow the new bitmap
+		uint32 wordsPerGroup = (fBlocksPerGroup * blockSize) >> 2;
+		for (int32 i = 0; i < fNumGroups; i++) {
+			MutexLocker groupLocker(fGroups[i].Lock());
+			status_t status = fGroups[i].InitializeFromBitmap(
+				fCheckBitmap + i * wordsPerGroup);
+			if (status != B_OK)
+				return status;
+		}
 	}
 
 	return B_OK;
@@ -2117,6 +2439,15 @@ BlockAllocator::_PrepareIndices()
 		if (status != B_OK)
 			return status;
 
+		// Collect the entries, and build the tree at once when the pass is
+		// done; if that is not possible, they are inserted one by one
+		index->builder = new(std::nothrow) TreeBuilder(tree,
+			&fCheckCookie->builder_memory);
+		if (index->builder != NULL && index->builder->InitCheck() != B_OK) {
+			delete index->builder;
+			index->builder = NULL;
+		}
+
 		index->inode = inode;
 		vnode.Keep();
 		count++;
@@ -2131,6 +2462,9 @@ BlockAllocator::_FreeIndices()
 {
 	for (int32 i = 0; i < fCheckCookie->indices.CountItems(); i++) {
 		check_index* index = fCheckCookie->indices.Array()[i];
+		delete index->builder;
+		index->builder = NULL;
+
 		if (index->inode != NULL) {
 			put_vnode(fVolume->FSVolume(),
 				fVolume->ToVnode(index->inode->BlockRun()));
@@ -2140,21 +2474,40 @@ BlockAllocator::_FreeIndices()
 }
 
 
+/*!	Writes out the indices that have been collected by the index pass. */
 status_t
-BlockAllocator::_AddInodeToIndex(Inode* inode)
+BlockAllocator::_WriteIndices()
 {
-	Transaction transaction(fVolume, inode->BlockNumber());
+	status_t status = B_OK;
 
 	for (int32 i = 0; i < fCheckCookie->indices.CountItems(); i++) {
 		check_index* index = fCheckCookie->indices.Array()[i];
-		if (index->inode == NULL)
+		if (index->builder == NULL)
 			continue;
 
-		index->inode->WriteLockInTransaction(transaction);
+		status_t indexStatus = index->builder->Finish();
+		if (indexStatus != B_OK) {
+			FATAL(("check: Could not write index \"%s\": %s\n", index->name,
+				strerror(indexStatus)));
+			if (status == B_OK)
+				status = indexStatus;
+		}
+
+		delete index->builder;
+		index->builder = NULL;
+	}
+
+	return status;
+}
 
-		BPlusTree* tree = index->inode->Tree();
-		if (tree == NULL)
-			return B_ERROR;
+
+status_t
+BlockAllocator::_AddInodeToIndex(Inode* inode)
+{
+	for (int32 i = 0; i < fCheckCookie->indices.CountItems(); i++) {
+		check_index* index = fCheckCookie->indices.Array()[i];
+		if (index->inode == NULL)
+			continue;
 
 		status_t status = B_OK;
 
@@ -2164,22 +2517,27 @@ BlockAllocator::_AddInodeToIndex(Inode* inode)
 				if (inode->GetName(name, B_FILE_NAME_LENGTH) != B_OK)
 					return B_ERROR;
 
-				status = tree->Insert(transaction, name, inode->ID());
+				status = _AddToIndex(index, (uint8*)name, strlen(name),
+					inode->ID());
 			}
 		} else if (!strcmp(index->name, "last_modified")) {
 			if (inode->InLastModifiedIndex()) {
-				status = tree->Insert(transaction, inode->OldLastModified(),
-					inode->ID());
+				off_t modified = inode->OldLastModified();
+				status = _AddToIndex(index, (uint8*)&modified,
+					sizeof(modified), inode->ID());
 			}
 		} else if (!strcmp(index->name, "size")) {
-			if (inode->InSizeIndex())
-				status = tree->Insert(transaction, inode->Size(), inode->ID());
+			if (inode->InSizeIndex()) {
+				off_t size = inode->Size();
+				status = _AddToIndex(index, (uint8*)&size, sizeof(size),
+					inode->ID());
+			}
 		} else {
 			uint8 key[MAX_INDEX_KEY_LENGTH];
 			size_t keyLength = MAX_INDEX_KEY_LENGTH;
 			if (inode->ReadAttribute(index->name, B_ANY_TYPE, 0, key,
 					&keyLength) == B_OK) {
-				status = tree->Insert(transaction, key, keyLength, inode->ID());
+				status = _AddToIndex(index, key, keyLength, inode->ID());
 			}
 		}
 
@@ -2187,6 +2545,42 @@ BlockAllocator::_AddInodeToIndex(Inode* inode)
 			return status;
 	}
 
+	return B_OK;
+}
+
+
+/*!	Adds the entry to the index' builder. If the builder runs out of memory,
+	the entries collected so far are written, and this and all following
+	entries are inserted into the tree directly.
+*/
+status_t
+BlockAllocator::_AddToIndex(check_index* index, const uint8* key,
+	uint16 keyLength, ino_t id)
+{
+	if (index->builder != NULL) {
+		status_t status = index->builder->Add(key, keyLength, id);
+		if (status != B_NO_MEMORY)
+			return status;
+
+		status = index->builder->Finish();
+		delete index->builder;
+		index->builder = NULL;
+
+		if (status != B_OK)
+			return status;
+	}
+
+	BPlusTree* tree = index->inode->Tree();
+	if (tree == NULL)
+		return B_ERROR;
+
+	Transaction transaction(fVolume, index->inode->BlockNumber());
+	index->inode->WriteLockInTransaction(transaction);
+
+	status_t status = tree->Insert(transaction, key, keyLength, id);
+	if (status != B_OK)
+		return status;
+
 	return transaction.Done();
 }
 
@@ -2260,11 +2654,11 @@ BlockAllocator::Dump(int32 index)
 			group.NumBits(), &group);
 		kprintf("      num blocks:     %" B_PRIu32 "\n", group.NumBlocks());
 		kprintf("      start:          %" B_PRId32 "\n", group.Start());
-		kprintf("      first free:     %" B_PRId32 "\n", group.fFirstFree);
-		kprintf("      largest start:  %" B_PRId32 "%s\n", group.fLargestStart,
-			group.fLargestValid ? "" : "  (invalid)");
-		kprintf("      largest length: %" B_PRId32 "\n", group.fLargestLength);
+		kprintf("      largest length: %" B_PRIu32 "\n",
+			group.LargestLength());
 		kprintf("      free bits:      %" B_PRId32 "\n", group.fFreeBits);
+		kprintf("      summary leaves: %" B_PRIu32 "  (%p)\n",
+			group.fLeafCount, group.fSummary);
 	}
 }
 
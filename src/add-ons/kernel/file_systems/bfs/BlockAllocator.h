@@ -18,6 +18,7 @@ struct disk_super_block;
 struct block_run;
 struct check_control;
 struct check_cookie;
+struct check_index;
 
 
 //#define DEBUG_ALLOCATION_GROUPS
@@ -44,7 +45,8 @@ public:
 
 			status_t		AllocateBlocks(Transaction& transaction,
 								int32 group, uint16 start, uint16 numBlocks,
-								uint16 minimum, block_run& run);
+								uint16 minimum, block_run& run,
+								off_t reserved = 0);
 
 			status_t		Trim(uint64 offset, uint64 size,
 								uint64& trimmedSize);
@@ -70,6 +72,11 @@ public:
 #endif
 
 private:
+			void			_WaitForInitializer();
+			status_t		_AllocateRun(Transaction& transaction,
+								int32 group, int32 start, int32 length,
+								block_run& run);
+			void			_UpdateUsedBlocks(off_t delta);
 			status_t		_RemoveInvalidNode(Inode* parent, BPlusTree* tree,
 								Inode* inode, const char* name);
 #ifdef DEBUG_ALLOCATION_GROUPS
@@ -82,7 +89,11 @@ private:
 			status_t		_FinishBitmapPass();
 			status_t		_PrepareIndices();
 			void			_FreeIndices();
+			status_t		_WriteIndices();
 			status_t		_AddInodeToIndex(Inode* inode);
+			status_t		_AddToIndex(check_index* index,
+								const uint8* key, uint16 keyLength,
+								ino_t id);
 			status_t		_WriteBackCheckBitmap();
 			status_t		_AddTrim(fs_trim_data& trimData, uint32 maxRanges,
 								uint64 offset, uint64 size);
@@ -95,10 +106,13 @@ private:
 private:
 			Volume*			fVolume;
 			recursive_lock	fLock;
+				// held by the initializer, and while checking or trimming;
+				// allocations only lock the groups they touch
 			AllocationGroup* fGroups;
 			int32			fNumGroups;
 			uint32			fBlocksPerGroup;
 			uint32			fNumBlocks;
+			int32			fInitializerRunning;
 
 			uint32*			fCheckBitmap;
 			check_cookie*	fCheckCookie;
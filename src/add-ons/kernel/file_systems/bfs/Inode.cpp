@@ -134,6 +134,27 @@ private:
 #endif
 
 
+// The maximum amount of data that may be written to a file before its blocks
+// have to be placed on disk, and the number of blocks that must stay free
+// besides the reserved ones for the allocation to be delayed at all.
+static const off_t kMaxDelayedSize = 32 * 1024 * 1024;
+static const off_t kMinFreeBlocksForDelay = 1024;
+
+
+/*!	Returns the end of the range that is covered by the blocks of the stream,
+	including any preallocated blocks.
+*/
+static off_t
+stream_range_end(const data_stream& data)
+{
+	if (data.MaxDoubleIndirectRange() != 0)
+		return data.MaxDoubleIndirectRange();
+	if (data.MaxIndirectRange() != 0)
+		return data.MaxIndirectRange();
+	return data.MaxDirectRange();
+}
+
+
 /*!	A helper class used by Inode::Create() to keep track of the belongings
 	of an inode creation in progress.
 	This class will make sure everything is cleaned up properly.
@@ -344,7 +365,9 @@ Inode::Inode(Volume* volume, ino_t id)
 	fTree(NULL),
 	fAttributes(NULL),
 	fCache(NULL),
-	fMap(NULL)
+	fMap(NULL),
+	fDelayedSize(0),
+	fDelayedBlocks(0)
 {
 	PRINT(("Inode::Inode(volume = %p, id = %Ld) @ %p\n", volume, id, this));
 
@@ -377,7 +400,9 @@ Inode::Inode(Volume* volume, Transaction& transaction, ino_t id, mode_t mode,
 	fTree(NULL),
 	fAttributes(NULL),
 	fCache(NULL),
-	fMap(NULL)
+	fMap(NULL),
+	fDelayedSize(0),
+	fDelayedBlocks(0)
 {
 	PRINT(("Inode::Inode(volume = %p, transaction = %p, id = %Ld) @ %p\n",
 		volume, &transaction, id, this));
@@ -417,6 +442,11 @@ Inode::~Inode()
 {
 	PRINT(("Inode::~Inode() @ %p\n", this));
 
+	// Delayed blocks are normally placed when the vnode is put, or released
+	// when the inode is removed; we don't want to lose the reservation anyway
+	if (fDelayedBlocks != 0)
+		fVolume->UnreserveBlocks(this);
+
 	file_cache_delete(FileCache());
 	file_map_delete(Map());
 	delete fTree;
@@ -1434,7 +1464,7 @@ Inode::AllocatedSize() const
 			// 2 blocks, one for the attributes inode, one for its B+tree
 	}
 
-	return size;
+	return size + fDelayedBlocks * blockSize;
 }
 
 
@@ -1609,8 +1639,12 @@ Inode::WriteAt(Transaction& transaction, off_t pos, const uint8* buffer,
 	off_t oldSize = Size();
 
 	if ((uint64)pos + (uint64)length > (uint64)oldSize) {
-		// let's grow the data stream to the size needed
-		status_t status = SetFileSize(transaction, pos + length);
+		// let's grow the data stream to the size needed - if possible, the
+		// new blocks are only reserved for now, and placed once we know
+		// better how large the file is going to be
+		status_t status = _DelayGrowth(pos + length);
+		if (status != B_OK)
+			status = SetFileSize(transaction, pos + length);
 		if (status != B_OK) {
 			*_length = 0;
 			WriteLockInTransaction(transaction);
@@ -1708,10 +1742,11 @@ Inode::_AllocateBlockArray(Transaction& transaction, block_run& run,
 
 /*!	Grows the stream to \a size, and fills the direct/indirect/double indirect
 	ranges with the runs.
-	This method will also determine the size of the preallocation, if any.
+	This method will also determine the size of the preallocation, if any,
+	unless \a preallocate is \c false.
 */
 status_t
-Inode::_GrowStream(Transaction& transaction, off_t size)
+Inode::_GrowStream(Transaction& transaction, off_t size, bool preallocate)
 {
 	data_stream* data = &Node().data;
 
@@ -1746,7 +1781,7 @@ Inode::_GrowStream(Transaction& transaction, off_t size)
 	// do we have enough free blocks on the disk?
 	off_t blocksNeeded = (bytes + fVolume->BlockSize() - 1)
 		>> fVolume->BlockShift();
-	if (blocksNeeded > fVolume->FreeBlocks())
+	if (blocksNeeded > fVolume->FreeBlocks() + fDelayedBlocks)
 		return B_DEVICE_FULL;
 
 	off_t blocksRequested = blocksNeeded;
@@ -1759,7 +1794,7 @@ Inode::_GrowStream(Transaction& transaction, off_t size)
 	// that big, and should stay close to the inode - preallocating could be
 	// counterproductive.
 	// Also, if free disk space is tight, don't preallocate.
-	if (!IsAttribute() && !IsAttributeDirectory() && !IsSymLink()
+	if (preallocate && !IsAttribute() && !IsAttributeDirectory() && !IsSymLink()
 		&& fVolume->FreeBlocks() > 128) {
 		off_t roundTo = 0;
 		if (IsFile()) {
@@ -2257,17 +2292,26 @@ Inode::SetFileSize(Transaction& transaction, off_t size)
 
 	T(Resize(this, oldSize, size, false));
 
+	off_t streamSize = Node().data.Size();
+
 	// should the data stream grow or shrink?
-	status_t status;
-	if (size > oldSize) {
+	status_t status = B_OK;
+	if (size > streamSize) {
+		// Any delayed data is allocated together with the new size, out of
+		// its reservation
 		status = _GrowStream(transaction, size);
 		if (status < B_OK) {
 			// if the growing of the stream fails, the whole operation
 			// fails, so we should shrink the stream to its former size
-			_ShrinkStream(transaction, oldSize);
-		}
-	} else
-		status = _ShrinkStream(transaction, size);
+			_ShrinkStream(transaction, streamSize);
+		} else
+			_ReleaseDelayedBlocks();
+	} else {
+		// the delayed data is cut off
+		_ReleaseDelayedBlocks();
+		if (size < streamSize)
+			status = _ShrinkStream(transaction, size);
+	}
 
 	if (status < B_OK)
 		return status;
@@ -2323,6 +2367,141 @@ Inode::TrimPreallocation(Transaction& transaction)
 }
 
 
+/*!	Allocates the blocks for the data that has been written to the file, but
+	has not been placed on disk yet. Since this is usually done when the file
+	has been written completely, the stream can be grown with as few runs as
+	possible.
+	If \a preallocate is \c false, the file is not expected to grow any
+	further, and no blocks are preallocated for it.
+	The inode must be write locked.
+*/
+status_t
+Inode::AllocateDelayedBlocks(Transaction& transaction, bool preallocate)
+{
+	if (fDelayedBlocks == 0)
+		return B_OK;
+
+	off_t size = fDelayedSize;
+	off_t oldSize = Node().data.Size();
+
+	// The blocks have been reserved for exactly this allocation, the
+	// reservation is only dropped once they are in place
+	status_t status = _GrowStream(transaction, size, preallocate);
+	if (status != B_OK) {
+		_ShrinkStream(transaction, oldSize);
+		return status;
+	}
+
+	_ReleaseDelayedBlocks();
+	return WriteBack(transaction);
+}
+
+
+/*!	Lets the file grow to \a size without allocating the blocks for the new
+	data; they are only reserved, and will be allocated in one go later on,
+	by AllocateDelayedBlocks().
+	Returns an error if the stream should better be grown right away instead,
+	for example because free space is getting tight, or because there is
+	already a lot of delayed data.
+	The inode must be write locked, and the caller must own the journal.
+*/
+status_t
+Inode::_DelayGrowth(off_t size)
+{
+	// Only files are written in small pieces that are worth collecting
+	if (!IsFile() || IsDeleted() || FileCache() == NULL)
+		return B_NOT_ALLOWED;
+
+	off_t rangeEnd = stream_range_end(Node().data);
+	if (size <= rangeEnd) {
+		// the preallocated blocks will do
+		return B_NOT_ALLOWED;
+	}
+	if (size - rangeEnd > kMaxDelayedSize)
+		return B_NOT_ALLOWED;
+
+	off_t blocks = _DelayedBlocksNeeded(size);
+	if (blocks - fDelayedBlocks + kMinFreeBlocksForDelay
+			> fVolume->FreeBlocks()) {
+		return B_DEVICE_FULL;
+	}
+
+	T(Resize(this, Size(), size, false));
+
+	_ReserveDelayedBlocks(size);
+
+	file_cache_set_size(FileCache(), size);
+	file_map_set_size(Map(), size);
+	return B_OK;
+}
+
+
+/*!	Returns the number of blocks the stream needs to grow to \a size: the
+	data blocks, and, in the worst case, the indirect and double indirect
+	array blocks that are needed to reference them.
+*/
+off_t
+Inode::_DelayedBlocksNeeded(off_t size) const
+{
+	const data_stream& data = Node().data;
+	off_t bytes = size - stream_range_end(data);
+	if (bytes <= 0)
+		return 0;
+
+	off_t blocks = (bytes + fVolume->BlockSize() - 1) >> fVolume->BlockShift();
+
+	if (data.indirect.IsZero())
+		blocks += NUM_ARRAY_BLOCKS;
+
+	uint32 arrayLength = data.double_indirect.Length();
+	if (data.double_indirect.IsZero()) {
+		arrayLength = _DoubleIndirectBlockLength();
+		blocks += arrayLength;
+	}
+
+	// Each array of the double indirect range references a fixed amount of
+	// data. The range may start in the middle of an array, and the data is
+	// allocated in multiples of the array length, too.
+	int32 runsPerBlock;
+	int32 directSize;
+	int32 indirectSize;
+	get_double_indirect_sizes(arrayLength, fVolume->BlockSize(), runsPerBlock,
+		directSize, indirectSize);
+	if (indirectSize > 0)
+		blocks += (bytes / indirectSize + 3) * arrayLength;
+
+	return blocks;
+}
+
+
+/*!	Reserves the blocks that are needed for the stream to cover \a size, and
+	lets the file appear to be of that size.
+*/
+void
+Inode::_ReserveDelayedBlocks(off_t size)
+{
+	off_t blocks = _DelayedBlocksNeeded(size);
+	if (blocks <= 0)
+		return;
+
+	fVolume->ReserveBlocks(this, blocks - fDelayedBlocks);
+	fDelayedBlocks = blocks;
+	fDelayedSize = size;
+}
+
+
+//!	Drops the reservation; the file is back to the size of its stream.
+void
+Inode::_ReleaseDelayedBlocks()
+{
+	if (fDelayedBlocks == 0)
+		return;
+
+	fVolume->UnreserveBlocks(this);
+	fDelayedBlocks = 0;
+}
+
+
 //!	Frees the file's data stream and removes all attributes
 status_t
 Inode::Free(Transaction& transaction)
@@ -2364,6 +2543,18 @@ Inode::Free(Transaction& transaction)
 status_t
 Inode::Sync()
 {
+	if (HasDelayedBlocks() && !fVolume->IsReadOnly()) {
+		// The data must be placed before it can be written back
+		Transaction transaction(fVolume, BlockNumber());
+		WriteLocker locker(fLock);
+
+		status_t status = AllocateDelayedBlocks(transaction, true);
+		if (status == B_OK)
+			status = transaction.Done();
+		if (status != B_OK)
+			return status;
+	}
+
 	if (FileCache())
 		return file_cache_sync(FileCache());
 
@@ -91,7 +91,9 @@ public:
 			uint32				Type() const { return fNode.Type(); }
 			int32				Flags() const { return fNode.Flags(); }
 
-			off_t				Size() const { return fNode.data.Size(); }
+			off_t				Size() const
+									{ return fDelayedBlocks != 0
+										? fDelayedSize : fNode.data.Size(); }
 			off_t				AllocatedSize() const;
 			off_t				LastModified() const
 									{ return fNode.LastModifiedTime(); }
@@ -155,6 +157,16 @@ public:
 			status_t			Append(Transaction& transaction, off_t bytes);
 			status_t			TrimPreallocation(Transaction& transaction);
 			bool				NeedsTrimming() const;
+			status_t			AllocateDelayedBlocks(
+									Transaction& transaction,
+									bool preallocate);
+			bool				HasDelayedBlocks() const
+									{ return fDelayedBlocks != 0; }
+			off_t				DelayedBlocks() const
+									{ return fDelayedBlocks; }
+			Link*				DelayedLink() { return &fDelayedLink; }
+			const Link*			DelayedLink() const
+									{ return &fDelayedLink; }
 
 			status_t			Free(Transaction& transaction);
 			status_t			Sync();
@@ -250,9 +262,13 @@ private:
 									block_run& run, size_t length,
 									bool variableSize = false);
 			status_t			_GrowStream(Transaction& transaction,
-									off_t size);
+									off_t size, bool preallocate = true);
 			status_t			_ShrinkStream(Transaction& transaction,
 									off_t size);
+			status_t			_DelayGrowth(off_t size);
+			off_t				_DelayedBlocksNeeded(off_t size) const;
+			void				_ReserveDelayedBlocks(off_t size);
+			void				_ReleaseDelayedBlocks();
 
 private:
 			rw_lock				fLock;
@@ -269,6 +285,13 @@ private:
 				// we need those values to ensure we will remove
 				// the correct keys from the indices
 
+			off_t				fDelayedSize;
+			off_t				fDelayedBlocks;
+				// the size of the file including the data that has not
+				// been placed on disk yet, and the number of blocks that
+				// are reserved for it
+			Link				fDelayedLink;
+
 			mutable recursive_lock fSmallDataLock;
 			SinglyLinkedList<AttributeIterator> fIterators;
 };
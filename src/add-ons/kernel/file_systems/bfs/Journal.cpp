@@ -954,9 +954,10 @@ Journal::FlushLogAndBlocks()
 
 
 status_t
-Journal::Lock(Transaction* owner, bool separateSubTransactions)
+Journal::Lock(Transaction* owner, bool separateSubTransactions, bool wait)
 {
-	status_t status = recursive_lock_lock(&fLock);
+	status_t status = wait
+		? recursive_lock_lock(&fLock) : recursive_lock_trylock(&fLock);
 	if (status != B_OK)
 		return status;
 
@@ -1170,6 +1171,25 @@ Transaction::Start(Volume* volume, off_t refBlock)
 }
 
 
+/*!	Like Start(), but doesn't wait for the journal if another thread owns it.
+	In this case, \c B_WOULD_BLOCK is returned.
+*/
+status_t
+Transaction::TryStart(Volume* volume, off_t refBlock)
+{
+	// has it already been started?
+	if (fJournal != NULL)
+		return B_OK;
+
+	fJournal = volume->GetJournal(refBlock);
+	if (fJournal != NULL && fJournal->Lock(this, false, false) == B_OK)
+		return B_OK;
+
+	fJournal = NULL;
+	return B_WOULD_BLOCK;
+}
+
+
 void
 Transaction::AddListener(TransactionListener* listener)
 {
@@ -26,7 +26,8 @@ public:
 			status_t		InitCheck();
 
 			status_t		Lock(Transaction* owner,
-								bool separateSubTransactions);
+								bool separateSubTransactions,
+								bool wait = true);
 			status_t		Unlock(Transaction* owner, bool success);
 
 			status_t		ReplayLog();
@@ -133,6 +134,7 @@ public:
 	}
 
 	status_t Start(Volume* volume, off_t refBlock);
+	status_t TryStart(Volume* volume, off_t refBlock);
 	bool IsStarted() const { return fJournal != NULL; }
 
 	status_t Done()
@@ -146,6 +148,14 @@ public:
 		return status;
 	}
 
+	void Abort()
+	{
+		if (fJournal != NULL) {
+			fJournal->Unlock(this, false);
+			fJournal = NULL;
+		}
+	}
+
 	bool HasParent() const
 	{
 		return fParent != NULL;
@@ -70,6 +70,49 @@ union value {
 };
 
 
+// The estimate of terms that cannot be iterated through their own index
+static const off_t kUnknownEstimate = 1LL << 62;
+
+// An AND partner of the equation that is iterated is only used to filter its
+// entries if it is expected to match at most this many entries.
+static const int32 kMaxFilterSize = 4096;
+// Smaller estimates aren't worth building a filter for.
+static const off_t kMinFilteredEntries = 32;
+// How many returned entries are remembered for queries with OR operators.
+// Beyond that, duplicates are found by matching the entries against the
+// equations that have already been iterated.
+static const int32 kMaxReturnedEntries = 16384;
+
+
+/*!	A set of inode IDs, used to sort out the entries of an index before their
+	inodes have to be loaded.
+	If it is initialized without a maximum count, it grows as needed.
+*/
+class InodeFilter {
+public:
+								InodeFilter();
+								~InodeFilter();
+
+			status_t			Init(int32 maxCount = -1);
+
+			status_t			Add(off_t id);
+			bool				Contains(off_t id) const;
+			bool				IsFull() const
+									{ return fMaxCount >= 0
+										&& fCount >= fMaxCount; }
+
+private:
+	inline	uint32				_Hash(off_t id) const;
+			status_t			_Resize(uint32 size);
+
+private:
+			off_t*				fTable;
+			uint32				fSize;
+			int32				fCount;
+			int32				fMaxCount;
+};
+
+
 /*!	Abstract base class for the operator/equation classes.
 */
 class Term {
@@ -88,8 +131,8 @@ public:
 									size_t size = 0) = 0;
 	virtual	void				Complement() = 0;
 
-	virtual	void				CalculateScore(Index& index) = 0;
-	virtual	int32				Score() const = 0;
+	virtual	void				CalculateEstimate(Index& index) = 0;
+	virtual	off_t				Estimate() const = 0;
 
 	virtual	status_t			InitCheck() = 0;
 
@@ -108,7 +151,7 @@ protected:
 	Although an Equation object is quite independent from the volume on which
 	the query is run, there are some dependencies that are produced while
 	querying:
-	The type/size of the value, the score, and if it has an index or not.
+	The type/size of the value, the estimate, and if it has an index or not.
 	So you could run more than one query on the same volume, but it might return
 	wrong values when it runs concurrently on another volume.
 	That's not an issue right now, because we run single-threaded and don't use
@@ -132,10 +175,16 @@ public:
 									bool queryNonIndexed);
 			status_t			GetNextMatching(Volume* volume,
 									TreeIterator* iterator,
-									struct dirent* dirent, size_t bufferSize);
+									struct dirent* dirent, size_t bufferSize,
+									const InodeFilter* filter,
+									InodeFilter* returned,
+									Equation* const* iterated,
+									int32 iteratedCount);
+			status_t			CollectMatching(Volume* volume,
+									InodeFilter& filter);
 
-	virtual	void				CalculateScore(Index &index);
-	virtual	int32				Score() const { return fScore; }
+	virtual	void				CalculateEstimate(Index& index);
+	virtual	off_t				Estimate() const { return fEstimate; }
 
 #ifdef DEBUG
 	virtual	void				PrintToStream();
@@ -146,6 +195,10 @@ private:
 								Equation& operator=(const Equation& other);
 									// no implementation
 
+			status_t			_NextEntry(TreeIterator* iterator,
+									off_t& _offset);
+			status_t			_MatchParents(Inode* inode);
+
 			status_t			_ParseQuotedString(char** _start, char** _end);
 			char*				_CopyString(char* start, char* end);
 	inline	bool				_IsEquationChar(char c) const;
@@ -163,7 +216,7 @@ private:
 			bool				fIsPattern;
 			bool				fIsSpecialTime;
 
-			int32				fScore;
+			off_t				fEstimate;
 			bool				fHasIndex;
 };
 
@@ -185,8 +238,8 @@ public:
 									size_t size = 0);
 	virtual	void				Complement();
 
-	virtual	void				CalculateScore(Index& index);
-	virtual	int32				Score() const;
+	virtual	void				CalculateEstimate(Index& index);
+	virtual	off_t				Estimate() const;
 
 	virtual	status_t			InitCheck();
 
@@ -208,13 +261,124 @@ private:
 //	#pragma mark -
 
 
+InodeFilter::InodeFilter()
+	:
+	fTable(NULL),
+	fSize(0),
+	fCount(0),
+	fMaxCount(0)
+{
+}
+
+
+InodeFilter::~InodeFilter()
+{
+	free(fTable);
+}
+
+
+status_t
+InodeFilter::Init(int32 maxCount)
+{
+	// keep the table at most half full
+	uint32 size = 16;
+	while (maxCount > 0 && size < 2 * (uint32)maxCount)
+		size <<= 1;
+
+	fMaxCount = maxCount;
+	return _Resize(size);
+}
+
+
+status_t
+InodeFilter::Add(off_t id)
+{
+	uint32 index = _Hash(id);
+	while (fTable[index] != 0) {
+		if (fTable[index] == id)
+			return B_OK;
+		index = (index + 1) & (fSize - 1);
+	}
+
+	if (fMaxCount >= 0 && fCount >= fMaxCount)
+		return B_BUFFER_OVERFLOW;
+
+	if (2 * (uint32)(fCount + 1) > fSize) {
+		status_t status = _Resize(2 * fSize);
+		if (status != B_OK)
+			return status;
+
+		index = _Hash(id);
+		while (fTable[index] != 0)
+			index = (index + 1) & (fSize - 1);
+	}
+
+	fTable[index] = id;
+	fCount++;
+	return B_OK;
+}
+
+
+bool
+InodeFilter::Contains(off_t id) const
+{
+	uint32 index = _Hash(id);
+	while (fTable[index] != 0) {
+		if (fTable[index] == id)
+			return true;
+		index = (index + 1) & (fSize - 1);
+	}
+
+	return false;
+}
+
+
+inline uint32
+InodeFilter::_Hash(off_t id) const
+{
+	return ((uint32)id ^ (uint32)(id >> 32)) * 2654435761U & (fSize - 1);
+}
+
+
+status_t
+InodeFilter::_Resize(uint32 size)
+{
+	// an ID of 0 marks an empty slot, it's the super block's location
+	off_t* table = (off_t*)calloc(size, sizeof(off_t));
+	if (table == NULL)
+		return B_NO_MEMORY;
+
+	off_t* oldTable = fTable;
+	uint32 oldSize = fSize;
+	fTable = table;
+	fSize = size;
+
+	for (uint32 i = 0; i < oldSize; i++) {
+		if (oldTable[i] == 0)
+			continue;
+
+		uint32 index = _Hash(oldTable[i]);
+		while (fTable[index] != 0)
+			index = (index + 1) & (fSize - 1);
+		fTable[index] = oldTable[i];
+	}
+
+	free(oldTable);
+	return B_OK;
+}
+
+
+//	#pragma mark -
+
+
 Equation::Equation(char** _expression)
 	:
 	Term(OP_EQUATION),
 	fAttribute(NULL),
 	fString(NULL),
 	fType(0),
-	fIsPattern(false)
+	fIsPattern(false),
+	fEstimate(kUnknownEstimate)
 {
 	char* string = *_expression;
 	char* start = string;
@@ -576,38 +740,31 @@ Equation::PrepareQuery(Volume* /*volume*/, Index& index,
 }
 
 
+/*!	Returns the next entry of the iterator that matches the equation, and
+	that passes the \a filter, if any. Entries that are already in the
+	\a returned set are skipped, and the returned entry is added to it.
+	Once that set is full, entries that match one of the \a iterated
+	equations are skipped instead, as they have been returned by them.
+*/
 status_t
 Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
-	struct dirent* dirent, size_t bufferSize)
+	struct dirent* dirent, size_t bufferSize, const InodeFilter* filter,
+	InodeFilter* returned, Equation* const* iterated, int32 iteratedCount)
 {
 	while (true) {
-		union value indexValue;
-		uint16 keyLength;
-		uint16 duplicate;
 		off_t offset;
-
-		status_t status = iterator->GetNextEntry(&indexValue, &keyLength,
-			(uint16)sizeof(indexValue), &offset, &duplicate);
+		status_t status = _NextEntry(iterator, offset);
 		if (status != B_OK)
 			return status;
 
-		// only compare against the index entry when this is the correct
-		// index for the equation
-		if (fHasIndex && duplicate < 2
-			&& !_CompareTo((uint8*)&indexValue, keyLength)) {
-			// They aren't equal? Let the operation decide what to do. Since
-			// we always start at the beginning of the index (or the correct
-			// position), only some needs to be stopped if the entry doesn't
-			// fit.
-			if (fOp == OP_LESS_THAN
-				|| fOp == OP_LESS_THAN_OR_EQUAL
-				|| (fOp == OP_EQUAL && !fIsPattern))
-				return B_ENTRY_NOT_FOUND;
+		// sort out the entries that can't match before loading their inodes
+		if (filter != NULL && !filter->Contains(offset))
+			continue;
 
-			if (duplicate > 0)
-				iterator->SkipDuplicates();
+		// with OR operators, an entry may match more than one of the
+		// equations that are iterated
+		if (returned != NULL && returned->Contains(offset))
 			continue;
-		}
 
 		Vnode vnode(volume, offset);
 		Inode* inode;
@@ -628,38 +785,28 @@ Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
 		// query will do something similar (and we don't have
 		// to do it for root, either).
 
-		// go up in the tree until a &&-operator is found, and check if the
-		// inode matches with the rest of the expression - we don't have to
-		// check ||-operators for that
-		Term* term = this;
 		status = MATCH_OK;
-
 		if (!fHasIndex)
 			status = Match(inode);
+		if (status == MATCH_OK)
+			status = _MatchParents(inode);
 
-		while (term != NULL && status == MATCH_OK) {
-			Operator* parent = (Operator*)term->Parent();
-			if (parent == NULL)
-				break;
-
-			if (parent->Op() == OP_AND) {
-				// choose the other child of the parent
-				Term* other = parent->Right();
-				if (other == term)
-					other = parent->Left();
-
-				if (other == NULL) {
-					FATAL(("&&-operator has only one child... (parent = %p)\n",
-						parent));
-					break;
-				}
-				status = other->Match(inode);
-				if (status < 0) {
-					REPORT_ERROR(status);
+		if (status == MATCH_OK && returned != NULL && returned->IsFull()) {
+			for (int32 i = 0; i < iteratedCount; i++) {
+				if (iterated[i]->Match(inode) == MATCH_OK
+					&& iterated[i]->_MatchParents(inode) == MATCH_OK) {
 					status = NO_MATCH;
+					break;
 				}
 			}
-			term = (Term*)parent;
+		}
+
+		if (status == MATCH_OK && returned != NULL) {
+			status = returned->Add(offset);
+			if (status != B_OK && status != B_BUFFER_OVERFLOW)
+				return status;
+
+			status = MATCH_OK;
 		}
 
 		if (status == MATCH_OK) {
@@ -674,46 +821,231 @@ Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
 			}
 
 			dirent->d_reclen = sizeof(struct dirent) + strlen(dirent->d_name);
+			return B_OK;
 		}
+	}
+	RETURN_ERROR(B_ERROR);
+}
 
-		if (status == MATCH_OK)
+
+/*!	Adds the IDs of all entries of the equation's own index that match it to
+	the \a filter. Fails if there are more of them than the filter can hold.
+*/
+status_t
+Equation::CollectMatching(Volume* volume, InodeFilter& filter)
+{
+	Index index(volume);
+	TreeIterator* iterator = NULL;
+	status_t status = PrepareQuery(volume, index, &iterator, false);
+	ObjectDeleter<TreeIterator> iteratorDeleter(iterator);
+	if (iterator == NULL)
+		return status != B_OK ? status : B_ERROR;
+	if (!fHasIndex)
+		return B_BAD_TYPE;
+
+	// PrepareQuery() fails if there is no entry equal to our value
+	if (status == B_ENTRY_NOT_FOUND && fOp == OP_EQUAL && !fIsPattern)
+		return B_OK;
+	if (status != B_OK)
+		return status;
+
+	while (true) {
+		off_t offset;
+		status = _NextEntry(iterator, offset);
+		if (status == B_ENTRY_NOT_FOUND)
 			return B_OK;
+		if (status != B_OK)
+			return status;
+
+		status = filter.Add(offset);
+		if (status != B_OK)
+			return status;
 	}
-	RETURN_ERROR(B_ERROR);
 }
 
 
 void
-Equation::CalculateScore(Index &index)
+Equation::CalculateEstimate(Index& index)
 {
-	// As always, these values could be tuned and refined.
-	// And the code could also need some real world testing :-)
+	fEstimate = kUnknownEstimate;
 
-	// do we have to operate on a "foreign" index?
-	if (fOp == OP_UNEQUAL || index.SetTo(fAttribute) < B_OK) {
-		fScore = 0;
+	// only equations that can be iterated through their own index have an
+	// estimate
+	if (fOp == OP_UNEQUAL || index.SetTo(fAttribute) != B_OK
+		|| _ConvertValue(index.Type()) != B_OK)
 		return;
+
+	BPlusTree* tree = index.Node()->Tree();
+	if (tree == NULL)
+		return;
+
+	// Determine the range of keys the equation covers; "low" and "high" are
+	// the same key, unless it's a pattern or a time value of the
+	// last_modified index (a NULL key stands for an open range).
+	union value low;
+	union value high;
+	const uint8* lowKey = NULL;
+	const uint8* highKey = NULL;
+	uint16 lowLength = 0;
+	uint16 highLength = 0;
+	bool includeHigh = true;
+
+	if (fIsPattern) {
+		// all keys that start with the part before the first pattern symbol
+		int32 prefixLength = getFirstPatternSymbol(fString);
+		for (int32 i = 0; i < prefixLength; i++) {
+			if (fValue.String[i] == '\\') {
+				prefixLength = i;
+				break;
+			}
+		}
+
+		if (prefixLength > 0) {
+			memcpy(low.String, fValue.String, prefixLength);
+			lowKey = (uint8*)&low;
+			lowLength = prefixLength;
+
+			// the first key after them has the last byte incremented
+			memcpy(high.String, fValue.String, prefixLength);
+			while (prefixLength > 0
+				&& (uint8)high.String[prefixLength - 1] == 0xff)
+				prefixLength--;
+			if (prefixLength > 0) {
+				high.String[prefixLength - 1]++;
+				highKey = (uint8*)&high;
+				highLength = prefixLength;
+				includeHigh = false;
+			}
+		}
+	} else if (fIsSpecialTime) {
+		low.Int64 = fValue.Int64 << INODE_TIME_SHIFT;
+		high.Int64 = low.Int64 | ((1LL << INODE_TIME_SHIFT) - 1);
+		lowKey = (uint8*)&low;
+		highKey = (uint8*)&high;
+		lowLength = highLength = sizeof(int64);
+	} else if (fSize > 0) {
+		// the empty string can't be used as key, see PrepareQuery()
+		lowKey = highKey = _Value();
+		lowLength = highLength = fSize;
 	}
 
-	// if we have a pattern, how much does it help our search?
-	if (fIsPattern)
-		fScore = getFirstPatternSymbol(fString) << 3;
-	else {
-		// Score by operator
-		if (fOp == OP_EQUAL)
-			// higher than pattern="255 chars+*"
-			fScore = 2048;
-		else
-			// the pattern search is regarded cheaper when you have at
-			// least one character to set your index to
-			fScore = 5;
+	const uint8* from = NULL;
+	const uint8* to = NULL;
+	uint16 fromLength = 0;
+	uint16 toLength = 0;
+	bool includeFrom = true;
+	bool includeTo = true;
+
+	switch (fOp) {
+		case OP_EQUAL:
+			from = lowKey;
+			fromLength = lowLength;
+			to = highKey;
+			toLength = highLength;
+			includeTo = includeHigh;
+			break;
+		case OP_GREATER_THAN:
+			from = highKey;
+			fromLength = highLength;
+			includeFrom = false;
+			break;
+		case OP_GREATER_THAN_OR_EQUAL:
+			from = lowKey;
+			fromLength = lowLength;
+			break;
+		case OP_LESS_THAN:
+			to = lowKey;
+			toLength = lowLength;
+			includeTo = false;
+			break;
+		case OP_LESS_THAN_OR_EQUAL:
+			to = highKey;
+			toLength = highLength;
+			break;
 	}
 
-	// take index size into account (1024 is the current node size
-	// in our B+trees)
-	// 2048 * 2048 == 4194304 is the maximum score (for an empty
-	// tree, since the header + 1 node are already 2048 bytes)
-	fScore = fScore * ((2048 * 1024LL) / index.Node()->Size());
+	off_t estimate;
+	if (tree->EstimateRange(from, fromLength, includeFrom, to, toLength,
+			includeTo, estimate) == B_OK)
+		fEstimate = estimate;
+}
+
+
+/*!	Returns the next entry of the iterator. If the equation is iterated
+	through its own index, only entries that match it are returned.
+*/
+status_t
+Equation::_NextEntry(TreeIterator* iterator, off_t& _offset)
+{
+	while (true) {
+		union value indexValue;
+		uint16 keyLength;
+		uint16 duplicate;
+
+		status_t status = iterator->GetNextEntry(&indexValue, &keyLength,
+			(uint16)sizeof(indexValue), &_offset, &duplicate);
+		if (status != B_OK)
+			return status;
+
+		// only compare against the index entry when this is the correct
+		// index for the equation
+		if (fHasIndex && duplicate < 2
+			&& !_CompareTo((uint8*)&indexValue, keyLength)) {
+			// They aren't equal? Let the operation decide what to do. Since
+			// we always start at the beginning of the index (or the correct
+			// position), only some needs to be stopped if the entry doesn't
+			// fit.
+			if (fOp == OP_LESS_THAN
+				|| fOp == OP_LESS_THAN_OR_EQUAL
+				|| (fOp == OP_EQUAL && !fIsPattern))
+				return B_ENTRY_NOT_FOUND;
+
+			if (duplicate > 0)
+				iterator->SkipDuplicates();
+			continue;
+		}
+
+		return B_OK;
+	}
+}
+
+
+/*!	Goes up in the tree until an AND operator is found, and checks if the
+	inode matches with the rest of the expression - we don't have to check
+	OR operators for that.
+*/
+status_t
+Equation::_MatchParents(Inode* inode)
+{
+	Term* term = this;
+	status_t status = MATCH_OK;
+
+	while (term != NULL && status == MATCH_OK) {
+		Operator* parent = (Operator*)term->Parent();
+		if (parent == NULL)
+			break;
+
+		if (parent->Op() == OP_AND) {
+			// choose the other child of the parent
+			Term* other = parent->Right();
+			if (other == term)
+				other = parent->Left();
+
+			if (other == NULL) {
+				FATAL(("&&-operator has only one child... (parent = %p)\n",
+					parent));
+				break;
+			}
+			status = other->Match(inode);
+			if (status < 0) {
+				REPORT_ERROR(status);
+				status = NO_MATCH;
+			}
+		}
+		term = (Term*)parent;
+	}
+
+	return status;
 }
 
 
@@ -915,19 +1247,24 @@ Operator::Match(Inode* inode, const char* attribute, int32 type,
 	const uint8* key, size_t size)
 {
 	if (fOp == OP_AND) {
-		status_t status = fLeft->Match(inode, attribute, type, key, size);
+		// start with the term that is less likely to match
+		Term* first = fLeft;
+		Term* second = fRight;
+		if (fRight->Estimate() < fLeft->Estimate()) {
+			first = fRight;
+			second = fLeft;
+		}
+
+		status_t status = first->Match(inode, attribute, type, key, size);
 		if (status != MATCH_OK)
 			return status;
 
-		return fRight->Match(inode, attribute, type, key, size);
+		return second->Match(inode, attribute, type, key, size);
 	} else {
-		// choose the term with the better score for OP_OR
-		Term* first;
-		Term* second;
-		if (fRight->Score() > fLeft->Score()) {
-			first = fLeft;
-			second = fRight;
-		} else {
+		// start with the term that is more likely to match for OP_OR
+		Term* first = fLeft;
+		Term* second = fRight;
+		if (fRight->Estimate() > fLeft->Estimate()) {
 			first = fRight;
 			second = fLeft;
 		}
@@ -955,29 +1292,29 @@ Operator::Complement()
 
 
 void
-Operator::CalculateScore(Index &index)
+Operator::CalculateEstimate(Index& index)
 {
-	fLeft->CalculateScore(index);
-	fRight->CalculateScore(index);
+	fLeft->CalculateEstimate(index);
+	fRight->CalculateEstimate(index);
 }
 
 
-int32
-Operator::Score() const
+off_t
+Operator::Estimate() const
 {
-	if (fOp == OP_AND) {
-		// return the one with the better score
-		if (fRight->Score() > fLeft->Score())
-			return fRight->Score();
+	off_t left = fLeft->Estimate();
+	off_t right = fRight->Estimate();
 
-		return fLeft->Score();
+	if (fOp == OP_AND) {
+		// can't match more than the more selective term
+		return left < right ? left : right;
 	}
 
-	// for OP_OR, be honest, and return the one with the worse score
-	if (fRight->Score() < fLeft->Score())
-		return fRight->Score();
+	// for OP_OR, both sides have to be iterated
+	if (left >= kUnknownEstimate - right)
+		return kUnknownEstimate;
 
-	return fLeft->Score();
+	return left + right;
 }
 
 
@@ -1234,6 +1571,8 @@ Query::Query(Volume* volume, Expression* expression, uint32 flags)
 	fCurrent(NULL),
 	fIterator(NULL),
 	fIndex(volume),
+	fFilter(NULL),
+	fReturned(NULL),
 	fFlags(flags),
 	fPort(-1)
 {
@@ -1243,10 +1582,6 @@ Query::Query(Volume* volume, Expression* expression, uint32 flags)
 	if (volume == NULL || expression == NULL || expression->Root() == NULL)
 		return;
 
-	// create index on the stack and delete it afterwards
-	fExpression->Root()->CalculateScore(fIndex);
-	fIndex.Unset();
-
 	Rewind();
 
 	if ((fFlags & B_LIVE_QUERY) != 0)
@@ -1258,6 +1593,10 @@ Query::~Query()
 {
 	if ((fFlags & B_LIVE_QUERY) != 0)
 		fVolume->RemoveQuery(this);
+
+	delete fIterator;
+	delete fFilter;
+	delete fReturned;
 }
 
 
@@ -1267,11 +1606,23 @@ Query::Rewind()
 	// free previous stuff
 
 	fStack.MakeEmpty();
+	fIterated.MakeEmpty();
+
+	delete fReturned;
+	fReturned = NULL;
 
 	delete fIterator;
 	fIterator = NULL;
 	fCurrent = NULL;
 
+	delete fFilter;
+	fFilter = NULL;
+
+	// estimate how many entries each term will match, using the index on the
+	// stack, and delete it afterwards
+	fExpression->Root()->CalculateEstimate(fIndex);
+	fIndex.Unset();
+
 	// put the whole expression on the stack
 
 	Stack<Term*> stack;
@@ -1279,6 +1630,10 @@ Query::Rewind()
 
 	Term* term;
 	while (stack.Pop(&term)) {
+		// skip the terms that can't match anything
+		if (term->Estimate() == 0)
+			continue;
+
 		if (term->Op() < OP_EQUATION) {
 			Operator* op = (Operator*)term;
 
@@ -1286,9 +1641,9 @@ Query::Rewind()
 				stack.Push(op->Left());
 				stack.Push(op->Right());
 			} else {
-				// For OP_AND, we can use the scoring system to decide which
-				// path to add
-				if (op->Right()->Score() > op->Left()->Score())
+				// For OP_AND, it's enough to iterate the term that is
+				// expected to match the fewest entries
+				if (op->Right()->Estimate() < op->Left()->Estimate())
 					stack.Push(op->Right());
 				else
 					stack.Push(op->Left());
@@ -1298,6 +1653,21 @@ Query::Rewind()
 			FATAL(("Unknown term on stack or stack error"));
 	}
 
+	if (fStack.CountItems() > 1) {
+		// Remember the entries that have been returned, so that entries
+		// matching more than one equation are only returned once
+		fReturned = new(std::nothrow) InodeFilter;
+		if (fReturned == NULL)
+			return B_NO_MEMORY;
+
+		status_t status = fReturned->Init(kMaxReturnedEntries);
+		if (status != B_OK) {
+			delete fReturned;
+			fReturned = NULL;
+			return status;
+		}
+	}
+
 	return B_OK;
 }
 
@@ -1322,16 +1692,29 @@ Query::GetNextEntry(struct dirent* dirent, size_t size)
 
 			if (status != B_OK)
 				return status;
+
+			_PrepareFilter();
 		}
 		if (fCurrent == NULL)
 			RETURN_ERROR(B_ERROR);
 
 		status_t status = fCurrent->GetNextMatching(fVolume, fIterator, dirent,
-			size);
+			size, fFilter, fReturned, fIterated.Array(),
+			fIterated.CountItems());
+		if (status == B_NO_MEMORY) {
+			// the entry could not be recorded as returned
+			return status;
+		}
 		if (status != B_OK) {
+			if (fReturned != NULL && fIterated.Push(fCurrent) != B_OK)
+				return B_NO_MEMORY;
+
 			delete fIterator;
 			fIterator = NULL;
 			fCurrent = NULL;
+
+			delete fFilter;
+			fFilter = NULL;
 		} else {
 			// only return if we have another entry
 			return B_OK;
@@ -1340,6 +1723,48 @@ Query::GetNextEntry(struct dirent* dirent, size_t size)
 }
 
 
+/*!	If the current equation is combined by AND with another one that is
+	expected to match only a few entries, the IDs of those are collected
+	first. Reading an index is much cheaper than loading the inodes it refers
+	to, and only those inodes that are in both sets have to be loaded then.
+*/
+void
+Query::_PrepareFilter()
+{
+	Equation* partner = NULL;
+	for (Term* term = fCurrent; term->Parent() != NULL;
+			term = term->Parent()) {
+		Operator* parent = (Operator*)term->Parent();
+		if (parent->Op() != OP_AND)
+			continue;
+
+		Term* other = parent->Right();
+		if (other == term)
+			other = parent->Left();
+
+		if (other->Op() > OP_EQUATION
+			&& (partner == NULL || other->Estimate() < partner->Estimate()))
+			partner = (Equation*)other;
+	}
+
+	if (partner == NULL || partner->Estimate() > kMaxFilterSize
+		|| fCurrent->Estimate() < kMinFilteredEntries)
+		return;
+
+	fFilter = new(std::nothrow) InodeFilter;
+	if (fFilter == NULL)
+		return;
+
+	// The estimate might be a bit off, but it's not worth to go on if it's
+	// completely wrong
+	if (fFilter->Init(2 * partner->Estimate()) != B_OK
+		|| partner->CollectMatching(fVolume, *fFilter) != B_OK) {
+		delete fFilter;
+		fFilter = NULL;
+	}
+}
+
+
 void
 Query::SetLiveMode(port_id port, int32 token)
 {
@@ -13,6 +13,7 @@
 class Volume;
 class Term;
 class Equation;
+class InodeFilter;
 class TreeIterator;
 class Query;
 
@@ -63,13 +64,22 @@ public:
 
 			Expression*		GetExpression() const { return fExpression; }
 
+private:
+			void			_PrepareFilter();
+
 private:
 			Volume*			fVolume;
 			Expression*		fExpression;
 			Equation*		fCurrent;
 			TreeIterator*	fIterator;
 			Index			fIndex;
+			InodeFilter*	fFilter;
+			InodeFilter*	fReturned;
+				// the entries returned so far, if there is more than one
+				// equation to iterate
 			Stack<Equation*> fStack;
+			Stack<Equation*> fIterated;
+				// the equations whose entries have all been returned
 
 			uint32			fFlags;
 			port_id			fPort;
@@ -281,6 +281,8 @@ Volume::Volume(fs_volume* volume)
 	fRootNode(NULL),
 	fIndicesNode(NULL),
 	fDirtyCachedBlocks(0),
+	fReservedBlocks(0),
+	fDelayedInodeCount(0),
 	fFlags(0),
 	fCheckingThread(-1)
 {
@@ -462,7 +464,36 @@ Volume::Unmount()
 status_t
 Volume::Sync()
 {
-	return fJournal->FlushLogAndBlocks();
+	// The page writer must not wait for the journal, so it cannot write back
+	// data whose blocks have not been allocated yet. We can, so place that
+	// data first, and write it back. Every inode is only looked at once,
+	// no matter how often it is written to in the mean time.
+	status_t result = B_OK;
+
+	MutexLocker locker(fLock);
+	for (int32 count = fDelayedInodeCount; count > 0; count--) {
+		Inode* inode = fDelayedInodes.RemoveHead();
+		if (inode == NULL)
+			break;
+		fDelayedInodes.Add(inode);
+
+		ino_t id = inode->ID();
+		locker.Unlock();
+
+		// the inode is only safe to use with a reference to its vnode
+		if (get_vnode(fVolume, id, (void**)&inode) == B_OK) {
+			status_t status = inode->Sync();
+			if (status != B_OK && result == B_OK)
+				result = status;
+			put_vnode(fVolume, id);
+		}
+
+		locker.Lock();
+	}
+	locker.Unlock();
+
+	status_t status = fJournal->FlushLogAndBlocks();
+	return result != B_OK ? result : status;
 }
 
 
@@ -545,6 +576,50 @@ Volume::AllocateForInode(Transaction& transaction, const Inode* parent,
 }
 
 
+/*!	Reserves another \a count blocks for data of \a inode that has already
+	been written, but not been placed on disk yet. Reserved blocks are no
+	longer reported as free, so that other allocations cannot take them away.
+	The inode is remembered, so that Sync() can place its data.
+	The caller is responsible for making sure that there are enough free
+	blocks left; it must own the journal.
+*/
+void
+Volume::ReserveBlocks(Inode* inode, off_t count)
+{
+	MutexLocker _(fLock);
+	if (!inode->HasDelayedBlocks()) {
+		fDelayedInodes.Add(inode);
+		fDelayedInodeCount++;
+	}
+	fReservedBlocks += count;
+}
+
+
+//!	Drops all blocks that are reserved for \a inode.
+void
+Volume::UnreserveBlocks(Inode* inode)
+{
+	MutexLocker _(fLock);
+	fDelayedInodes.Remove(inode);
+	fDelayedInodeCount--;
+	fReservedBlocks -= inode->DelayedBlocks();
+}
+
+
+DoublyLinkedListLink<Inode>*
+DelayedInodeGetLink::operator()(Inode* inode) const
+{
+	return inode->DelayedLink();
+}
+
+
+const DoublyLinkedListLink<Inode>*
+DelayedInodeGetLink::operator()(const Inode* inode) const
+{
+	return inode->DelayedLink();
+}
+
+
 status_t
 Volume::WriteSuperBlock()
 {
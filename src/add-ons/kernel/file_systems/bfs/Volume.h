@@ -27,6 +27,12 @@ enum volume_initialize_flags {
 
 typedef DoublyLinkedList<Inode> InodeList;
 
+struct DelayedInodeGetLink {
+	DoublyLinkedListLink<Inode>* operator()(Inode* inode) const;
+	const DoublyLinkedListLink<Inode>* operator()(const Inode* inode) const;
+};
+typedef DoublyLinkedList<Inode, DelayedInodeGetLink> DelayedInodeList;
+
 
 class Volume {
 public:
@@ -64,7 +70,12 @@ public:
 			off_t			UsedBlocks() const
 								{ return fSuperBlock.UsedBlocks(); }
 			off_t			FreeBlocks() const
-								{ return NumBlocks() - UsedBlocks(); }
+								{ return NumBlocks() - UsedBlocks()
+									- fReservedBlocks; }
+			off_t			ReservedBlocks() const
+								{ return fReservedBlocks; }
+			void			ReserveBlocks(Inode* inode, off_t count);
+			void			UnreserveBlocks(Inode* inode);
 
 			uint32			DeviceBlockSize() const { return fDeviceBlockSize; }
 			uint32			BlockSize() const { return fBlockSize; }
@@ -164,6 +175,11 @@ protected:
 			Inode*			fIndicesNode;
 
 			vint32			fDirtyCachedBlocks;
+			off_t			fReservedBlocks;
+				// blocks of delayed allocations, see Inode::WriteAt()
+			DelayedInodeList fDelayedInodes;
+			int32			fDelayedInodeCount;
+				// the inodes these blocks are reserved for
 
 			mutex			fQueryLock;
 			SinglyLinkedList<Query> fQueries;
@@ -107,6 +107,30 @@ iterative_io_finished_hook(void* cookie, io_request* request, status_t status,
 }
 
 
+/*!	Allocates the delayed blocks of \a inode before its pages are written
+	back. This must not wait for the journal, as its owner might itself be
+	waiting for the pages that are about to be written; in this case,
+	\c B_WOULD_BLOCK is returned, and the pages will be written later, at the
+	latest by Volume::Sync().
+*/
+static status_t
+allocate_delayed_blocks(Volume* volume, Inode* inode)
+{
+	Transaction transaction;
+	status_t status = transaction.TryStart(volume, inode->BlockNumber());
+	if (status != B_OK)
+		return status;
+
+	WriteLocker locker(inode->Lock());
+
+	status = inode->AllocateDelayedBlocks(transaction, true);
+	if (status == B_OK)
+		status = transaction.Done();
+
+	return status;
+}
+
+
 //	#pragma mark - Scanning
 
 
@@ -329,11 +353,15 @@ bfs_put_vnode(fs_volume* _volume, fs_vnode* _node, bool reenter)
 
 	// since a directory's size can be changed without having it opened,
 	// we need to take care about their preallocated blocks here
-	if (!volume->IsReadOnly() && !volume->IsCheckingThread()
-		&& inode->NeedsTrimming()) {
+	if (!volume->IsReadOnly() && (inode->HasDelayedBlocks()
+			|| (!volume->IsCheckingThread() && inode->NeedsTrimming()))) {
 		Transaction transaction(volume, inode->BlockNumber());
 
-		if (inode->TrimPreallocation(transaction) == B_OK)
+		status_t status = inode->AllocateDelayedBlocks(transaction, false);
+		if (status == B_OK && inode->NeedsTrimming())
+			status = inode->TrimPreallocation(transaction);
+
+		if (status == B_OK)
 			transaction.Done();
 		else if (transaction.HasParent()) {
 			// TODO: for now, we don't let sub-transactions fail
@@ -450,6 +478,13 @@ bfs_write_pages(fs_volume* _volume, fs_vnode* _node, void* _cookie,
 	if (inode->FileCache() == NULL)
 		RETURN_ERROR(B_BAD_VALUE);
 
+	if (inode->HasDelayedBlocks()
+		&& pos + (off_t)*_numBytes > inode->Node().data.Size()) {
+		status_t status = allocate_delayed_blocks(volume, inode);
+		if (status != B_OK)
+			return status;
+	}
+
 	InodeReadLocker _(inode);
 
 	uint32 vecIndex = 0;
@@ -493,6 +528,16 @@ bfs_io(fs_volume* _volume, fs_vnode* _node, void* _cookie, io_request* request)
 		notify_io_request(request, B_READ_ONLY_DEVICE);
 		return B_READ_ONLY_DEVICE;
 	}
+
+	if (io_request_is_write(request) && inode->HasDelayedBlocks()
+		&& io_request_offset(request) + io_request_length(request)
+			> inode->Node().data.Size()) {
+		status_t status = allocate_delayed_blocks(volume, inode);
+		if (status != B_OK) {
+			notify_io_request(request, status);
+			return status;
+		}
+	}
 #endif
 
 	if (inode->FileCache() == NULL) {
@@ -525,6 +570,15 @@ bfs_get_file_map(fs_volume* _volume, fs_vnode* _node, off_t offset, size_t size,
 	//FUNCTION_START(("offset = %Ld, size = %lu\n", offset, size));
 
 	while (true) {
+		if (inode->HasDelayedBlocks() && offset >= inode->Node().data.Size()) {
+			// The rest of the file has not been placed on disk yet
+			if (index == 0)
+				return B_BUSY;
+
+			*_count = index;
+			return B_OK;
+		}
+
 		status_t status = inode->FindBlockRun(offset, run, fileOffset);
 		if (status != B_OK)
 			return status;
@@ -1436,7 +1490,7 @@ bfs_free_cookie(fs_volume* _volume, fs_vnode* _node, void* _cookie)
 
 	if (!volume->IsReadOnly() && !volume->IsCheckingThread()) {
 		InodeReadLocker locker(inode);
-		needsTrimming = inode->NeedsTrimming();
+		needsTrimming = inode->NeedsTrimming() || inode->HasDelayedBlocks();
 
 		if ((cookie->open_mode & O_RWMASK) != 0
 			&& !inode->IsDeleted()
@@ -1461,8 +1515,12 @@ bfs_free_cookie(fs_volume* _volume, fs_vnode* _node, void* _cookie)
 		bool changedSize = false, changedTime = false;
 		Index index(volume);
 
-		if (needsTrimming) {
-			status = inode->TrimPreallocation(transaction);
+		if (needsTrimming && !inode->IsDeleted()) {
+			// the file has been written completely for now, so its delayed
+			// blocks can be allocated with its final size
+			status = inode->AllocateDelayedBlocks(transaction, false);
+			if (status == B_OK && inode->NeedsTrimming())
+				status = inode->TrimPreallocation(transaction);
 			if (status < B_OK) {
 				FATAL(("Could not trim preallocated blocks: inode %" B_PRIdINO
 					", transaction %d: %s!\n", inode->ID(),
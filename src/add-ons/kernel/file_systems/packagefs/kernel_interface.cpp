@@ -19,6 +19,7 @@
 
 #include "AttributeCookie.h"
 #include "AttributeDirectoryCookie.h"
+#include "ChunkCache.h"
 #include "DebugSupport.h"
 #include "Directory.h"
 #include "GlobalFactory.h"
@@ -1085,9 +1086,20 @@ packagefs_std_ops(int32 op, ...)
 				return error;
 			}
 
+			error = ChunkCache::CreateDefault();
+			if (error != B_OK) {
+				ERROR("Failed to init ChunkCache\n");
+				GlobalFactory::DeleteDefault();
+				StringConstants::Cleanup();
+				StringPool::Cleanup();
+				exit_debugging();
+				return error;
+			}
+
 			error = PackageFSRoot::GlobalInit();
 			if (error != B_OK) {
 				ERROR("Failed to init PackageFSRoot\n");
+				ChunkCache::DeleteDefault();
 				GlobalFactory::DeleteDefault();
 				StringConstants::Cleanup();
 				StringPool::Cleanup();
@@ -1102,6 +1114,7 @@ packagefs_std_ops(int32 op, ...)
 		{
 			PRINT("package_std_ops(): B_MODULE_UNINIT\n");
 			PackageFSRoot::GlobalUninit();
+			ChunkCache::DeleteDefault();
 			GlobalFactory::DeleteDefault();
 			StringConstants::Cleanup();
 			StringPool::Cleanup();
@@ -6,6 +6,8 @@
 
 #include "CachedDataReader.h"
 
+#include <string.h>
+
 #include <algorithm>
 
 #include <DataIO.h>
@@ -75,6 +77,33 @@ private:
 };
 
 
+// #pragma mark - ChunkDataOutput
+
+
+struct CachedDataReader::ChunkDataOutput : public BDataIO {
+	ChunkDataOutput(CachedChunk* chunk)
+		:
+		fChunk(chunk),
+		fOffset(0)
+	{
+	}
+
+	virtual ssize_t Write(const void* buffer, size_t size)
+	{
+		if (size > fChunk->size - fOffset)
+			return B_BAD_VALUE;
+
+		memcpy(fChunk->data + fOffset, buffer, size);
+		fOffset += size;
+		return size;
+	}
+
+private:
+	CachedChunk*	fChunk;
+	size_t			fOffset;
+};
+
+
 // #pragma mark - CachedDataReader
 
 
@@ -82,7 +111,9 @@ CachedDataReader::CachedDataReader()
 	:
 	fReader(NULL),
 	fCache(NULL),
-	fCacheLineLockers()
+	fCacheLineLockers(),
+	fChunkCacheRegistered(false),
+	fLastReadLine(-1)
 {
 	mutex_init(&fLock, "packagefs cached reader");
 }
@@ -90,6 +121,9 @@ CachedDataReader::CachedDataReader()
 
 CachedDataReader::~CachedDataReader()
 {
+	if (fChunkCacheRegistered)
+		ChunkCache::Default()->UnregisterOwner(&fChunkCacheOwner);
+
 	if (fCache != NULL) {
 		fCache->Lock();
 		fCache->ReleaseRefAndUnlock();
@@ -119,6 +153,13 @@ CachedDataReader::Init(BAbstractBufferedDataReader* reader, off_t size)
 	if (error != B_OK)
 		RETURN_ERROR(error);
 
+	locker.Unlock();
+
+	if (ChunkCache* chunkCache = ChunkCache::Default()) {
+		chunkCache->RegisterOwner(&fChunkCacheOwner);
+		fChunkCacheRegistered = true;
+	}
+
 	return B_OK;
 }
 
@@ -411,7 +452,94 @@ CachedDataReader::_ReadIntoPages(vm_page** pages, size_t firstPage,
 			fCache->virtual_end)
 		- firstPageOffset;
 
-	return fReader->ReadDataToOutput(firstPageOffset, requestLength, &output);
+	if (!fChunkCacheRegistered) {
+		return fReader->ReadDataToOutput(firstPageOffset, requestLength,
+			&output);
+	}
+
+	// The pages are all part of the same cache line, which corresponds to a
+	// heap chunk. Get the chunk from the chunk cache, or read it in as a
+	// whole.
+	ChunkCache* chunkCache = ChunkCache::Default();
+	off_t lineOffset = firstPageOffset / kCacheLineSize * kCacheLineSize;
+
+	CachedChunk* chunk = chunkCache->Get(&fChunkCacheOwner, lineOffset);
+	if (chunk == NULL) {
+		status_t error = _ReadChunk(chunkCache, lineOffset, false, chunk);
+		if (error != B_OK) {
+			return fReader->ReadDataToOutput(firstPageOffset, requestLength,
+				&output);
+		}
+	}
+
+	status_t error = output.WriteExactly(
+		chunk->data + (firstPageOffset - lineOffset), requestLength);
+	chunkCache->Put(chunk);
+
+	// read ahead, if the lines are read sequentially
+	off_t lastReadLine = atomic_get64(&fLastReadLine);
+	atomic_set64(&fLastReadLine, lineOffset);
+	if (error == B_OK && lastReadLine >= 0
+		&& lineOffset == lastReadLine + (off_t)kCacheLineSize) {
+		_PrefetchChunks(chunkCache, lineOffset);
+	}
+
+	return error;
+}
+
+
+/*!	Reads the cache line at \a lineOffset into a new chunk, and adds it to
+	the chunk cache. On success the returned chunk is referenced.
+	If \a prefetch is \c true, the chunk hasn't been asked for yet, and its
+	first use is not counted as reuse by the cache.
+*/
+status_t
+CachedDataReader::_ReadChunk(ChunkCache* chunkCache, off_t lineOffset,
+	bool prefetch, CachedChunk*& _chunk)
+{
+	size_t lineSize = std::min(lineOffset + (off_t)kCacheLineSize,
+		fCache->virtual_end) - lineOffset;
+
+	CachedChunk* chunk = chunkCache->Allocate(&fChunkCacheOwner, lineOffset,
+		lineSize, prefetch);
+	if (chunk == NULL)
+		return B_NO_MEMORY;
+
+	ChunkDataOutput output(chunk);
+	status_t error = fReader->ReadDataToOutput(lineOffset, lineSize, &output);
+	if (error != B_OK) {
+		chunkCache->Put(chunk);
+		return error;
+	}
+
+	_chunk = chunkCache->Publish(chunk);
+	return B_OK;
+}
+
+
+/*!	Reads the chunks following the cache line at \a lineOffset into the
+	chunk cache, unless they are already cached.
+	This is done by the reading thread itself, since only it is guaranteed to
+	have the package file open.
+*/
+void
+CachedDataReader::_PrefetchChunks(ChunkCache* chunkCache, off_t lineOffset)
+{
+	for (size_t i = 1; i <= kPrefetchChunks; i++) {
+		off_t offset = lineOffset + (off_t)(i * kCacheLineSize);
+		if (offset >= fCache->virtual_end)
+			break;
+
+		if (chunkCache->Contains(&fChunkCacheOwner, offset))
+			continue;
+
+		CachedChunk* chunk;
+		if (_ReadChunk(chunkCache, offset, true, chunk) != B_OK)
+			break;
+
+		chunkCache->Put(chunk);
+		atomic_add64(&fChunkCacheOwner.prefetches, 1);
+	}
 }
 
 
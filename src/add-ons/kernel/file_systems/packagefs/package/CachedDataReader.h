@@ -13,6 +13,8 @@
 #include <util/OpenHashTable.h>
 #include <vm/vm_types.h>
 
+#include "ChunkCache.h"
+
 
 using BPackageKit::BHPKG::BAbstractBufferedDataReader;
 using BPackageKit::BHPKG::BDataReader;
@@ -29,6 +31,9 @@ public:
 	virtual	status_t			ReadDataToOutput(off_t offset, size_t size,
 									BDataIO* output);
 
+			void				SetName(const char* name)
+									{ fChunkCacheOwner.name = name; }
+
 private:
 			class CacheLineLocker
 				: public DoublyLinkedListLinkImpl<CacheLineLocker> {
@@ -114,6 +119,7 @@ private:
 			typedef BOpenHashTable<LockerHashDefinition> LockerTable;
 
 			struct PagesDataOutput;
+			struct ChunkDataOutput;
 
 private:
 			status_t			_ReadCacheLine(off_t lineOffset,
@@ -129,6 +135,11 @@ private:
 									size_t requestLength, BDataIO* output);
 			status_t			_ReadIntoPages(vm_page** pages,
 									size_t firstPage, size_t pageCount);
+			status_t			_ReadChunk(ChunkCache* chunkCache,
+									off_t lineOffset, bool prefetch,
+									CachedChunk*& _chunk);
+			void				_PrefetchChunks(ChunkCache* chunkCache,
+									off_t lineOffset);
 
 			void				_LockCacheLine(CacheLineLocker* lineLocker);
 			void				_UnlockCacheLine(CacheLineLocker* lineLocker);
@@ -137,12 +148,16 @@ private:
 			static const size_t kCacheLineSize = 64 * 1024;
 			static const size_t kPagesPerCacheLine
 				= kCacheLineSize / B_PAGE_SIZE;
+			static const size_t kPrefetchChunks = 2;
 
 private:
 			mutex				fLock;
 			BAbstractBufferedDataReader* fReader;
 			VMCache*			fCache;
 			LockerTable			fCacheLineLockers;
+			ChunkCacheOwner		fChunkCacheOwner;
+			bool				fChunkCacheRegistered;
+			int64				fLastReadLine;
 };
 
 
@@ -0,0 +1,436 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "ChunkCache.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <new>
+
+#include <debug.h>
+#include <low_resource_manager.h>
+#include <util/AutoLock.h>
+#include <vm/vm_page.h>
+
+#include "DebugSupport.h"
+
+
+// upper limit of the memory budget; it is further limited to a fraction of
+// the physical memory
+static const size_t kMaxBudget = 32 * 1024 * 1024;
+static const uint32 kPhysicalMemoryFraction = 64;
+
+static const uint32 kLowResources = B_KERNEL_RESOURCE_PAGES
+	| B_KERNEL_RESOURCE_MEMORY | B_KERNEL_RESOURCE_ADDRESS_SPACE;
+
+/*static*/ ChunkCache* ChunkCache::sDefaultInstance = NULL;
+
+
+ChunkCache::ChunkCache()
+	:
+	fChunkDataCache(NULL),
+	fBudget(0),
+	fMaxBudget(0),
+	fUsed(0),
+	fProtectedUsed(0),
+	fHits(0),
+	fMisses(0),
+	fEvictions(0)
+{
+	mutex_init(&fLock, "packagefs chunk cache");
+}
+
+
+ChunkCache::~ChunkCache()
+{
+	unregister_low_resource_handler(&_LowMemoryHandler, this);
+	remove_debugger_command("packagefs_chunk_cache", &_DumpCommand);
+
+	_Evict(0);
+
+	if (fChunkDataCache != NULL)
+		delete_object_cache(fChunkDataCache);
+
+	mutex_destroy(&fLock);
+}
+
+
+/*static*/ status_t
+ChunkCache::CreateDefault()
+{
+	if (sDefaultInstance != NULL)
+		return B_OK;
+
+	ChunkCache* cache = new(std::nothrow) ChunkCache;
+	if (cache == NULL)
+		return B_NO_MEMORY;
+
+	status_t error = cache->_Init();
+	if (error != B_OK) {
+		delete cache;
+		return error;
+	}
+
+	sDefaultInstance = cache;
+	return B_OK;
+}
+
+
+/*static*/ void
+ChunkCache::DeleteDefault()
+{
+	delete sDefaultInstance;
+	sDefaultInstance = NULL;
+}
+
+
+/*static*/ ChunkCache*
+ChunkCache::Default()
+{
+	return sDefaultInstance;
+}
+
+
+void
+ChunkCache::RegisterOwner(ChunkCacheOwner* owner)
+{
+	MutexLocker locker(fLock);
+	fOwners.Add(owner);
+}
+
+
+/*!	Removes all chunks of \a owner from the cache. None of them may be in use
+	anymore.
+*/
+void
+ChunkCache::UnregisterOwner(ChunkCacheOwner* owner)
+{
+	MutexLocker locker(fLock);
+
+	ChunkList* lists[] = { &fProbationList, &fProtectedList };
+	for (size_t i = 0; i < B_COUNT_OF(lists); i++) {
+		for (ChunkList::Iterator it = lists[i]->GetIterator();
+				CachedChunk* chunk = it.Next();) {
+			if (chunk->owner != owner)
+				continue;
+
+			ASSERT(chunk->refCount == 0);
+			_Remove(chunk);
+		}
+	}
+
+	fOwners.Remove(owner);
+}
+
+
+/*!	Returns the chunk of \a owner at \a offset, or \c NULL, if it isn't
+	cached. The lookup is accounted as hit or miss.
+*/
+CachedChunk*
+ChunkCache::Get(ChunkCacheOwner* owner, off_t offset)
+{
+	MutexLocker locker(fLock);
+
+	ChunkKey key = { owner, offset };
+	CachedChunk* chunk = fChunks.Lookup(key);
+	if (chunk == NULL) {
+		owner->misses++;
+		fMisses++;
+		return NULL;
+	}
+
+	owner->hits++;
+	fHits++;
+	chunk->refCount++;
+
+	if (chunk->prefetched) {
+		// this is the first actual use of the chunk
+		chunk->prefetched = false;
+		fProbationList.Remove(chunk);
+		fProbationList.Add(chunk);
+		return chunk;
+	}
+
+	// a chunk used a second time gets protected
+	if (chunk->isProtected) {
+		fProtectedList.Remove(chunk);
+	} else {
+		fProbationList.Remove(chunk);
+		chunk->isProtected = true;
+		fProtectedUsed += kChunkSize;
+	}
+	fProtectedList.Add(chunk);
+
+	_BalanceProtected();
+
+	return chunk;
+}
+
+
+bool
+ChunkCache::Contains(ChunkCacheOwner* owner, off_t offset)
+{
+	MutexLocker locker(fLock);
+
+	ChunkKey key = { owner, offset };
+	return fChunks.Lookup(key) != NULL;
+}
+
+
+/*!	Allocates a new chunk, to be filled in by the caller and added via
+	Publish(). Returns \c NULL, if there is no memory for it.
+	A \a prefetched chunk is not promoted on its first hit.
+*/
+CachedChunk*
+ChunkCache::Allocate(ChunkCacheOwner* owner, off_t offset, size_t size,
+	bool prefetched)
+{
+	if (size > kChunkSize)
+		return NULL;
+
+	MutexLocker locker(fLock);
+	_UpdateBudget();
+	if (fBudget == 0)
+		return NULL;
+	locker.Unlock();
+
+	CachedChunk* chunk = new(std::nothrow) CachedChunk;
+	if (chunk == NULL)
+		return NULL;
+
+	chunk->data = (uint8*)object_cache_alloc(fChunkDataCache,
+		CACHE_DONT_WAIT_FOR_MEMORY);
+	if (chunk->data == NULL) {
+		delete chunk;
+		return NULL;
+	}
+
+	chunk->hashNext = NULL;
+	chunk->owner = owner;
+	chunk->offset = offset;
+	chunk->size = size;
+	chunk->refCount = 1;
+	chunk->isProtected = false;
+	chunk->inCache = false;
+	chunk->prefetched = prefetched;
+
+	return chunk;
+}
+
+
+/*!	Adds a chunk returned by Allocate() to the cache. If the cache already
+	contains the chunk, \a chunk is put, and the cached one is returned
+	instead. The caller keeps its reference to the returned chunk in either
+	case.
+*/
+CachedChunk*
+ChunkCache::Publish(CachedChunk* chunk)
+{
+	MutexLocker locker(fLock);
+
+	ChunkKey key = { chunk->owner, chunk->offset };
+	CachedChunk* existing = fChunks.Lookup(key);
+	if (existing != NULL) {
+		existing->refCount++;
+		if (--chunk->refCount == 0)
+			_Free(chunk);
+		return existing;
+	}
+
+	fChunks.InsertUnchecked(chunk);
+	fProbationList.Add(chunk);
+	chunk->inCache = true;
+	chunk->owner->chunkCount++;
+	fUsed += kChunkSize;
+
+	_Evict(fBudget);
+
+	return chunk;
+}
+
+
+void
+ChunkCache::Put(CachedChunk* chunk)
+{
+	MutexLocker locker(fLock);
+
+	if (--chunk->refCount == 0 && !chunk->inCache)
+		_Free(chunk);
+}
+
+
+status_t
+ChunkCache::_Init()
+{
+	status_t error = fChunks.Init();
+	if (error != B_OK)
+		RETURN_ERROR(error);
+
+	fChunkDataCache = create_object_cache("packagefs chunks", kChunkSize, 0,
+		NULL, NULL, NULL);
+	if (fChunkDataCache == NULL)
+		RETURN_ERROR(B_NO_MEMORY);
+
+	fMaxBudget = std::min(kMaxBudget,
+		(size_t)vm_page_num_pages() * B_PAGE_SIZE / kPhysicalMemoryFraction);
+	fBudget = fMaxBudget;
+
+	register_low_resource_handler(&_LowMemoryHandler, this, kLowResources,
+		0);
+
+	add_debugger_command_etc("packagefs_chunk_cache", &_DumpCommand,
+		"Dumps the packagefs chunk cache statistics",
+		"\n"
+		"Prints the statistics of the packagefs chunk cache, and the hits and\n"
+		"misses of each package.\n", 0);
+
+	return B_OK;
+}
+
+
+/*!	Removes \a chunk from the cache. It is freed right away, unless it is
+	still in use.
+*/
+void
+ChunkCache::_Remove(CachedChunk* chunk)
+{
+	fChunks.RemoveUnchecked(chunk);
+
+	if (chunk->isProtected) {
+		fProtectedList.Remove(chunk);
+		fProtectedUsed -= kChunkSize;
+	} else
+		fProbationList.Remove(chunk);
+
+	chunk->inCache = false;
+	chunk->owner->chunkCount--;
+	fUsed -= kChunkSize;
+
+	if (chunk->refCount == 0)
+		_Free(chunk);
+}
+
+
+void
+ChunkCache::_Free(CachedChunk* chunk)
+{
+	object_cache_free(fChunkDataCache, chunk->data, 0);
+	delete chunk;
+}
+
+
+/*!	Evicts chunks until no more than \a budget bytes are used, the least
+	recently used probationary ones first.
+*/
+void
+ChunkCache::_Evict(size_t budget)
+{
+	while (fUsed > budget) {
+		CachedChunk* chunk = fProbationList.Head();
+		if (chunk == NULL)
+			chunk = fProtectedList.Head();
+		if (chunk == NULL)
+			break;
+
+		_Remove(chunk);
+		fEvictions++;
+	}
+}
+
+
+/*!	Keeps the protected chunks to three quarters of the budget, so that new
+	chunks get a chance to prove themselves.
+*/
+void
+ChunkCache::_BalanceProtected()
+{
+	size_t maxProtected = fBudget / 4 * 3;
+	while (fProtectedUsed > maxProtected) {
+		CachedChunk* chunk = fProtectedList.RemoveHead();
+		if (chunk == NULL)
+			break;
+
+		chunk->isProtected = false;
+		fProtectedUsed -= kChunkSize;
+		fProbationList.Add(chunk);
+	}
+}
+
+
+/*!	Grows the budget again, if the memory shortage that made the low
+	resource handler shrink it has eased. The low resource manager does not
+	call its handlers for that, so this is done lazily when a chunk is
+	allocated.
+	The cache must be locked.
+*/
+void
+ChunkCache::_UpdateBudget()
+{
+	if (fBudget == fMaxBudget)
+		return;
+
+	fBudget = std::max(fBudget,
+		_BudgetFor(fMaxBudget, low_resource_state(kLowResources)));
+}
+
+
+/*static*/ size_t
+ChunkCache::_BudgetFor(size_t maxBudget, int32 level)
+{
+	switch (level) {
+		case B_NO_LOW_RESOURCE:
+			return maxBudget;
+		case B_LOW_RESOURCE_NOTE:
+			return maxBudget / 2;
+		case B_LOW_RESOURCE_WARNING:
+			return maxBudget / 8;
+		case B_LOW_RESOURCE_CRITICAL:
+		default:
+			return 0;
+	}
+}
+
+
+/*static*/ void
+ChunkCache::_LowMemoryHandler(void* data, uint32 resources, int32 level)
+{
+	ChunkCache* cache = (ChunkCache*)data;
+
+	MutexLocker locker(cache->fLock);
+
+	cache->fBudget = _BudgetFor(cache->fMaxBudget, level);
+	cache->_Evict(cache->fBudget);
+	cache->_BalanceProtected();
+}
+
+
+/*static*/ int
+ChunkCache::_DumpCommand(int argc, char** argv)
+{
+	ChunkCache* cache = sDefaultInstance;
+	if (cache == NULL)
+		return 0;
+
+	kprintf("budget:     %" B_PRIuSIZE " / %" B_PRIuSIZE "\n", cache->fBudget,
+		cache->fMaxBudget);
+	kprintf("used:       %" B_PRIuSIZE " (protected: %" B_PRIuSIZE ")\n",
+		cache->fUsed, cache->fProtectedUsed);
+	kprintf("hits:       %" B_PRId64 "\n", cache->fHits);
+	kprintf("misses:     %" B_PRId64 "\n", cache->fMisses);
+	kprintf("evictions:  %" B_PRId64 "\n", cache->fEvictions);
+
+	kprintf("\n%-40s %10s %10s %10s %7s\n", "package", "hits", "misses",
+		"prefetches", "chunks");
+	for (OwnerList::Iterator it = cache->fOwners.GetIterator();
+			ChunkCacheOwner* owner = it.Next();) {
+		kprintf("%-40s %10" B_PRId64 " %10" B_PRId64 " %10" B_PRId64 " %7"
+			B_PRIu32 "\n", owner->name != NULL ? owner->name : "<unnamed>",
+			owner->hits, owner->misses, owner->prefetches, owner->chunkCount);
+	}
+
+	return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef CHUNK_CACHE_H
+#define CHUNK_CACHE_H
+
+
+#include <lock.h>
+#include <slab/Slab.h>
+#include <util/DoublyLinkedList.h>
+#include <util/OpenHashTable.h>
+
+
+/*!	Per reader state of the chunk cache. Embedded in the reader, which must
+	register it with the cache before using it.
+*/
+struct ChunkCacheOwner : DoublyLinkedListLinkImpl<ChunkCacheOwner> {
+	ChunkCacheOwner()
+		:
+		name(NULL),
+		hits(0),
+		misses(0),
+		prefetches(0),
+		chunkCount(0)
+	{
+	}
+
+	const char*		name;
+	int64			hits;
+	int64			misses;
+	int64			prefetches;
+	uint32			chunkCount;
+};
+
+
+/*!	A decompressed heap chunk of a package.
+	A chunk returned by ChunkCache::Get() or ChunkCache::Allocate() is
+	referenced, and must be returned via ChunkCache::Put().
+*/
+struct CachedChunk : DoublyLinkedListLinkImpl<CachedChunk> {
+	CachedChunk*	hashNext;
+	ChunkCacheOwner* owner;
+	off_t			offset;
+	size_t			size;
+	int32			refCount;
+	bool			isProtected;
+	bool			inCache;
+	bool			prefetched;
+	uint8*			data;
+};
+
+
+/*!	A packagefs-wide cache of decompressed package heap chunks, shared by all
+	packages of all volumes, with an explicit memory budget.
+
+	The cache sits behind the page cache of the package heap readers: it is
+	consulted when pages of a chunk are missing there, so that the chunk does
+	not have to be decompressed again, just because the page daemon stole
+	its pages.
+
+	Replacement is a segmented LRU: new chunks enter a probationary list, and
+	are only promoted to the protected list when they are used again. Thus a
+	single sequential scan through a large package cannot push the chunks out
+	that are actually used repeatedly. Prefetched chunks are not considered
+	used before their first hit.
+*/
+class ChunkCache {
+private:
+								ChunkCache();
+								~ChunkCache();
+
+public:
+	static	status_t			CreateDefault();
+	static	void				DeleteDefault();
+	static	ChunkCache*			Default();
+
+			void				RegisterOwner(ChunkCacheOwner* owner);
+			void				UnregisterOwner(ChunkCacheOwner* owner);
+
+			CachedChunk*		Get(ChunkCacheOwner* owner, off_t offset);
+			bool				Contains(ChunkCacheOwner* owner,
+									off_t offset);
+			CachedChunk*		Allocate(ChunkCacheOwner* owner, off_t offset,
+									size_t size, bool prefetched = false);
+			CachedChunk*		Publish(CachedChunk* chunk);
+			void				Put(CachedChunk* chunk);
+
+	static	const size_t		kChunkSize = 64 * 1024;
+
+private:
+			struct ChunkKey {
+				ChunkCacheOwner*	owner;
+				off_t				offset;
+			};
+
+			struct ChunkHashDefinition {
+				typedef ChunkKey		KeyType;
+				typedef CachedChunk		ValueType;
+
+				size_t HashKey(const ChunkKey& key) const
+				{
+					return (size_t)key.owner / sizeof(void*)
+						^ (size_t)(key.offset / kChunkSize);
+				}
+
+				size_t Hash(const CachedChunk* value) const
+				{
+					ChunkKey key = { value->owner, value->offset };
+					return HashKey(key);
+				}
+
+				bool Compare(const ChunkKey& key,
+					const CachedChunk* value) const
+				{
+					return value->owner == key.owner
+						&& value->offset == key.offset;
+				}
+
+				CachedChunk*& GetLink(CachedChunk* value) const
+				{
+					return value->hashNext;
+				}
+			};
+
+			typedef BOpenHashTable<ChunkHashDefinition> ChunkTable;
+			typedef DoublyLinkedList<CachedChunk> ChunkList;
+			typedef DoublyLinkedList<ChunkCacheOwner> OwnerList;
+
+private:
+			status_t			_Init();
+
+			void				_Remove(CachedChunk* chunk);
+			void				_Free(CachedChunk* chunk);
+			void				_Evict(size_t budget);
+			void				_BalanceProtected();
+			void				_UpdateBudget();
+
+	static	size_t				_BudgetFor(size_t maxBudget, int32 level);
+
+	static	void				_LowMemoryHandler(void* data,
+									uint32 resources, int32 level);
+	static	int					_DumpCommand(int argc, char** argv);
+
+private:
+	static	ChunkCache*			sDefaultInstance;
+
+			mutex				fLock;
+			object_cache*		fChunkDataCache;
+			ChunkTable			fChunks;
+			ChunkList			fProbationList;
+			ChunkList			fProtectedList;
+			OwnerList			fOwners;
+			size_t				fBudget;
+			size_t				fMaxBudget;
+			size_t				fUsed;
+			size_t				fProtectedUsed;
+			int64				fHits;
+			int64				fMisses;
+			int64				fEvictions;
+};
+
+
+#endif	// CHUNK_CACHE_H
@@ -33,6 +33,7 @@
 #include "PackageFile.h"
 #include "PackagesDirectory.h"
 #include "PackageSettings.h"
+#include "PackageSnapshot.h"
 #include "PackageSymlink.h"
 #include "Version.h"
 #include "Volume.h"
@@ -749,11 +750,12 @@ private:
 
 
 struct Package::CachingPackageReader : public PackageReaderImpl {
-	CachingPackageReader(BErrorOutput* errorOutput)
+	CachingPackageReader(BErrorOutput* errorOutput, const char* name)
 		:
 		PackageReaderImpl(errorOutput),
 		fCachedHeapReader(NULL),
-		fFD(-1)
+		fFD(-1),
+		fName(name)
 	{
 	}
 
@@ -779,6 +781,8 @@ struct Package::CachingPackageReader : public PackageReaderImpl {
 		if (error != B_OK)
 			RETURN_ERROR(error);
 
+		fCachedHeapReader->SetName(fName);
+
 		_cachedReader = fCachedHeapReader;
 		return B_OK;
 	}
@@ -800,6 +804,7 @@ struct Package::CachingPackageReader : public PackageReaderImpl {
 private:
 	HeapReaderV2*	fCachedHeapReader;
 	int				fFD;
+	const char*		fName;
 };
 
 
@@ -834,14 +839,7 @@ Package::~Package()
 {
 	delete fHeapReader;
 
-	while (PackageNode* node = fNodes.RemoveHead())
-		node->ReleaseReference();
-
-	while (Resolvable* resolvable = fResolvables.RemoveHead())
-		delete resolvable;
-
-	while (Dependency* dependency = fDependencies.RemoveHead())
-		delete dependency;
+	_ClearContent();
 
 	delete fVersion;
 
@@ -862,9 +860,9 @@ Package::Init(const char* fileName)
 
 
 status_t
-Package::Load(const PackageSettings& settings)
+Package::Load(const PackageSettings& settings, PackageSnapshot* snapshot)
 {
-	status_t error = _Load(settings);
+	status_t error = _Load(settings, snapshot);
 	if (error != B_OK)
 		return error;
 
@@ -1006,7 +1004,7 @@ Package::CreateDataReader(const PackageData& data,
 
 
 status_t
-Package::_Load(const PackageSettings& settings)
+Package::_Load(const PackageSettings& settings, PackageSnapshot* snapshot)
 {
 	// open package file
 	int fd = Open();
@@ -1019,20 +1017,47 @@ Package::_Load(const PackageSettings& settings)
 
 	// try current package file format version
 	{
-		CachingPackageReader packageReader(&errorOutput);
+		CachingPackageReader packageReader(&errorOutput, fFileName);
 		status_t error = packageReader.Init(fd, false,
 			BHPKG::B_HPKG_READER_DONT_PRINT_VERSION_MISMATCH_MESSAGE);
 		if (error == B_OK) {
+			struct stat st;
+			if (snapshot != NULL && fstat(fd, &st) != 0)
+				snapshot = NULL;
+
+			// try to replay the content recorded in the snapshot
+			if (snapshot != NULL) {
+				LoaderContentHandler handler(this, settings);
+				error = handler.Init();
+				if (error != B_OK)
+					RETURN_ERROR(error);
+
+				error = snapshot->Replay(st, &handler);
+				if (error == B_OK) {
+					fHeapReader = packageReader.DetachCachedHeapReader();
+					return B_OK;
+				}
+
+				// drop what has been replayed so far, if anything
+				if (error != B_ENTRY_NOT_FOUND)
+					_ClearContent();
+			}
+
 			// parse content
 			LoaderContentHandler handler(this, settings);
 			error = handler.Init();
 			if (error != B_OK)
 				RETURN_ERROR(error);
 
-			error = packageReader.ParseContent(&handler);
+			PackageSnapshot::Recorder recorder(&handler);
+			error = packageReader.ParseContent(snapshot != NULL
+				? (BPackageContentHandler*)&recorder : &handler);
 			if (error != B_OK)
 				RETURN_ERROR(error);
 
+			if (snapshot != NULL)
+				snapshot->AddRecord(st, recorder);
+
 			// get the heap reader
 			fHeapReader = packageReader.DetachCachedHeapReader();
 			return B_OK;
@@ -1067,6 +1092,20 @@ Package::_Load(const PackageSettings& settings)
 }
 
 
+void
+Package::_ClearContent()
+{
+	while (PackageNode* node = fNodes.RemoveHead())
+		node->ReleaseReference();
+
+	while (Resolvable* resolvable = fResolvables.RemoveHead())
+		delete resolvable;
+
+	while (Dependency* dependency = fDependencies.RemoveHead())
+		delete dependency;
+}
+
+
 bool
 Package::_InitVersionedName()
 {
@@ -30,6 +30,7 @@ using BPackageKit::BHPKG::BAbstractBufferedDataReader;
 class PackageLinkDirectory;
 class PackagesDirectory;
 class PackageSettings;
+class PackageSnapshot;
 class Volume;
 class Version;
 
@@ -43,7 +44,8 @@ public:
 								~Package();
 
 			status_t			Init(const char* fileName);
-			status_t			Load(const PackageSettings& settings);
+			status_t			Load(const PackageSettings& settings,
+									PackageSnapshot* snapshot = NULL);
 
 			::Volume*			Volume() const		{ return fVolume; }
 			const String&		FileName() const	{ return fFileName; }
@@ -111,7 +113,9 @@ private:
 			struct CachingPackageReader;
 
 private:
-			status_t			_Load(const PackageSettings& settings);
+			status_t			_Load(const PackageSettings& settings,
+									PackageSnapshot* snapshot);
+			void				_ClearContent();
 			bool				_InitVersionedName();
 
 private:
@@ -0,0 +1,1017 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "PackageSnapshot.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <new>
+
+#include <package/hpkg/PackageEntry.h>
+#include <package/hpkg/PackageEntryAttribute.h>
+
+#include <AutoDeleter.h>
+
+#include "DebugSupport.h"
+
+
+using namespace BPackageKit;
+
+using BPackageKit::BHPKG::B_HPKG_MAX_INLINE_DATA_SIZE;
+using BPackageKit::BHPKG::BPackageResolvableData;
+using BPackageKit::BHPKG::BPackageResolvableExpressionData;
+
+
+static const uint32 kSnapshotMagic = 'PkSn';
+static const uint32 kSnapshotVersion = 1;
+
+// sanity limit for the snapshot file size
+static const size_t kMaxSnapshotSize = 64 * 1024 * 1024;
+
+static const uint32 kNullString = 0xffffffff;
+
+// FNV-1a offset basis
+static const uint32 kChecksumSeed = 2166136261U;
+
+enum {
+	SNAPSHOT_ENTRY				= 1,
+	SNAPSHOT_ENTRY_ATTRIBUTE	= 2,
+	SNAPSHOT_ENTRY_DONE			= 3,
+	SNAPSHOT_PACKAGE_ATTRIBUTE	= 4
+};
+
+
+struct packagefs_snapshot_header {
+	uint32	magic;
+	uint32	version;
+	uint32	record_count;
+	uint32	checksum;
+		// of everything following the header
+	uint64	size;
+		// of the whole file
+};
+
+
+struct packagefs_snapshot_record {
+	int64	node_id;
+	int64	file_size;
+	int64	modified_time;
+	int32	modified_time_nsecs;
+	uint32	content_size;
+};
+
+
+// #pragma mark - Record
+
+
+struct PackageSnapshot::Record {
+	Record*			hashNext;
+	ino_t			nodeID;
+	off_t			fileSize;
+	timespec		modifiedTime;
+	const uint8*	content;
+	size_t			contentSize;
+	uint8*			ownedContent;
+		// NULL, if the content is part of the loaded snapshot
+	bool			replayed;
+
+	Record()
+		:
+		ownedContent(NULL),
+		replayed(false)
+	{
+	}
+
+	~Record()
+	{
+		free(ownedContent);
+	}
+
+	bool Matches(const struct stat& st) const
+	{
+		return fileSize == st.st_size
+			&& modifiedTime.tv_sec == st.st_mtim.tv_sec
+			&& modifiedTime.tv_nsec == st.st_mtim.tv_nsec;
+	}
+};
+
+
+struct PackageSnapshot::RecordHashDefinition {
+	typedef ino_t	KeyType;
+	typedef	Record	ValueType;
+
+	size_t HashKey(ino_t key) const
+	{
+		return (size_t)key ^ (size_t)(key >> 32);
+	}
+
+	size_t Hash(const Record* value) const
+	{
+		return HashKey(value->nodeID);
+	}
+
+	bool Compare(ino_t key, const Record* value) const
+	{
+		return value->nodeID == key;
+	}
+
+	Record*& GetLink(Record* value) const
+	{
+		return value->hashNext;
+	}
+};
+
+
+// #pragma mark - Reader
+
+
+struct PackageSnapshot::Reader {
+	Reader(const uint8* data, size_t size)
+		:
+		fData(data),
+		fSize(size),
+		fOffset(0)
+	{
+	}
+
+	bool IsAtEnd() const
+	{
+		return fOffset == fSize;
+	}
+
+	const uint8* Current() const
+	{
+		return fData + fOffset;
+	}
+
+	bool Skip(size_t size)
+	{
+		if (size > fSize - fOffset)
+			return false;
+
+		fOffset += size;
+		return true;
+	}
+
+	bool Read(void* buffer, size_t size)
+	{
+		if (size > fSize - fOffset)
+			return false;
+
+		memcpy(buffer, fData + fOffset, size);
+		fOffset += size;
+		return true;
+	}
+
+	bool ReadUInt8(uint8& _value)
+	{
+		return Read(&_value, sizeof(_value));
+	}
+
+	bool ReadUInt32(uint32& _value)
+	{
+		return Read(&_value, sizeof(_value));
+	}
+
+	bool ReadUInt64(uint64& _value)
+	{
+		return Read(&_value, sizeof(_value));
+	}
+
+	bool ReadString(const char*& _string)
+	{
+		uint32 length;
+		if (!ReadUInt32(length))
+			return false;
+
+		if (length == kNullString) {
+			_string = NULL;
+			return true;
+		}
+
+		// the string is stored null-terminated, and is used in place
+		if (length >= fSize - fOffset || fData[fOffset + length] != '\0')
+			return false;
+
+		_string = (const char*)fData + fOffset;
+		fOffset += length + 1;
+		return true;
+	}
+
+	bool ReadData(BPackageData& data)
+	{
+		uint8 isInline;
+		uint64 size;
+		if (!ReadUInt8(isInline) || !ReadUInt64(size))
+			return false;
+
+		if (isInline != 0) {
+			if (size > B_HPKG_MAX_INLINE_DATA_SIZE || size > fSize - fOffset)
+				return false;
+
+			data.SetData((uint8)size, fData + fOffset);
+			fOffset += size;
+			return true;
+		}
+
+		uint64 offset;
+		if (!ReadUInt64(offset))
+			return false;
+
+		data.SetData(size, offset);
+		return true;
+	}
+
+	bool ReadVersion(BPackageVersionData& version)
+	{
+		return ReadString(version.major) && ReadString(version.minor)
+			&& ReadString(version.micro) && ReadString(version.preRelease)
+			&& ReadUInt32(version.revision);
+	}
+
+	bool ReadPackageAttribute(BPackageInfoAttributeValue& value)
+	{
+		uint8 id;
+		if (!ReadUInt8(id))
+			return false;
+
+		value.attributeID = (BPackageInfoAttributeID)id;
+
+		switch (id) {
+			case B_PACKAGE_INFO_NAME:
+			case B_PACKAGE_INFO_INSTALL_PATH:
+				return ReadString(value.string);
+
+			case B_PACKAGE_INFO_VERSION:
+				return ReadVersion(value.version);
+
+			case B_PACKAGE_INFO_ARCHITECTURE:
+				return ReadUInt64(value.unsignedInt);
+
+			case B_PACKAGE_INFO_PROVIDES:
+			{
+				BPackageResolvableData& resolvable = value.resolvable;
+				uint8 haveVersion;
+				uint8 haveCompatibleVersion;
+				if (!ReadString(resolvable.name) || resolvable.name == NULL
+					|| !ReadUInt8(haveVersion)
+					|| !ReadUInt8(haveCompatibleVersion)) {
+					return false;
+				}
+
+				resolvable.haveVersion = haveVersion != 0;
+				resolvable.haveCompatibleVersion = haveCompatibleVersion != 0;
+				return (!resolvable.haveVersion
+						|| ReadVersion(resolvable.version))
+					&& (!resolvable.haveCompatibleVersion
+						|| ReadVersion(resolvable.compatibleVersion));
+			}
+
+			case B_PACKAGE_INFO_REQUIRES:
+			{
+				BPackageResolvableExpressionData& expression
+					= value.resolvableExpression;
+				uint8 haveOpAndVersion;
+				if (!ReadString(expression.name) || expression.name == NULL
+					|| !ReadUInt8(haveOpAndVersion)) {
+					return false;
+				}
+
+				expression.haveOpAndVersion = haveOpAndVersion != 0;
+				if (!expression.haveOpAndVersion)
+					return true;
+
+				uint32 op;
+				if (!ReadUInt32(op))
+					return false;
+
+				expression.op = (BPackageResolvableOperator)op;
+				return ReadVersion(expression.version);
+			}
+
+			default:
+				return false;
+		}
+	}
+
+private:
+	const uint8*	fData;
+	size_t			fSize;
+	size_t			fOffset;
+};
+
+
+// #pragma mark - ReplayEntry
+
+
+struct PackageSnapshot::ReplayEntry : BPackageEntry {
+	ReplayEntry(ReplayEntry* parent, const char* name)
+		:
+		BPackageEntry(parent, name),
+		parent(parent)
+	{
+	}
+
+	ReplayEntry*	parent;
+};
+
+
+// #pragma mark - Recorder
+
+
+PackageSnapshot::Recorder::Recorder(BPackageContentHandler* target)
+	:
+	fTarget(target),
+	fBuffer(NULL),
+	fSize(0),
+	fCapacity(0),
+	fCurrentEntry(NULL),
+	fFailed(false)
+{
+}
+
+
+PackageSnapshot::Recorder::~Recorder()
+{
+	free(fBuffer);
+}
+
+
+status_t
+PackageSnapshot::Recorder::HandleEntry(BPackageEntry* entry)
+{
+	if (entry->Parent() != fCurrentEntry)
+		fFailed = true;
+	fCurrentEntry = entry;
+
+	_WriteUInt8(SNAPSHOT_ENTRY);
+	_WriteString(entry->Name());
+	_WriteUInt32(entry->Mode());
+	_WriteUInt32(entry->ModifiedTime().tv_sec);
+	_WriteUInt32(entry->ModifiedTime().tv_nsec);
+	_WriteString(entry->SymlinkPath());
+	_WriteData(entry->Data());
+
+	return fTarget->HandleEntry(entry);
+}
+
+
+status_t
+PackageSnapshot::Recorder::HandleEntryAttribute(BPackageEntry* entry,
+	BPackageEntryAttribute* attribute)
+{
+	// the attribute is replayed for the current entry
+	if (entry != fCurrentEntry)
+		fFailed = true;
+
+	_WriteUInt8(SNAPSHOT_ENTRY_ATTRIBUTE);
+	_WriteString(attribute->Name());
+	_WriteUInt32(attribute->Type());
+	_WriteData(attribute->Data());
+
+	return fTarget->HandleEntryAttribute(entry, attribute);
+}
+
+
+status_t
+PackageSnapshot::Recorder::HandleEntryDone(BPackageEntry* entry)
+{
+	if (entry != fCurrentEntry)
+		fFailed = true;
+	fCurrentEntry = entry->Parent();
+
+	_WriteUInt8(SNAPSHOT_ENTRY_DONE);
+
+	return fTarget->HandleEntryDone(entry);
+}
+
+
+status_t
+PackageSnapshot::Recorder::HandlePackageAttribute(
+	const BPackageInfoAttributeValue& value)
+{
+	// Only the attributes packagefs evaluates are recorded
+	switch (value.attributeID) {
+		case B_PACKAGE_INFO_NAME:
+		case B_PACKAGE_INFO_INSTALL_PATH:
+			_WriteUInt8(SNAPSHOT_PACKAGE_ATTRIBUTE);
+			_WriteUInt8(value.attributeID);
+			_WriteString(value.string);
+			break;
+
+		case B_PACKAGE_INFO_VERSION:
+			_WriteUInt8(SNAPSHOT_PACKAGE_ATTRIBUTE);
+			_WriteUInt8(value.attributeID);
+			_WriteVersion(value.version);
+			break;
+
+		case B_PACKAGE_INFO_ARCHITECTURE:
+			_WriteUInt8(SNAPSHOT_PACKAGE_ATTRIBUTE);
+			_WriteUInt8(value.attributeID);
+			_WriteUInt64(value.unsignedInt);
+			break;
+
+		case B_PACKAGE_INFO_PROVIDES:
+		{
+			const BPackageResolvableData& resolvable = value.resolvable;
+			_WriteUInt8(SNAPSHOT_PACKAGE_ATTRIBUTE);
+			_WriteUInt8(value.attributeID);
+			_WriteString(resolvable.name);
+			_WriteUInt8(resolvable.haveVersion);
+			_WriteUInt8(resolvable.haveCompatibleVersion);
+			if (resolvable.haveVersion)
+				_WriteVersion(resolvable.version);
+			if (resolvable.haveCompatibleVersion)
+				_WriteVersion(resolvable.compatibleVersion);
+			break;
+		}
+
+		case B_PACKAGE_INFO_REQUIRES:
+		{
+			const BPackageResolvableExpressionData& expression
+				= value.resolvableExpression;
+			_WriteUInt8(SNAPSHOT_PACKAGE_ATTRIBUTE);
+			_WriteUInt8(value.attributeID);
+			_WriteString(expression.name);
+			_WriteUInt8(expression.haveOpAndVersion);
+			if (expression.haveOpAndVersion) {
+				_WriteUInt32(expression.op);
+				_WriteVersion(expression.version);
+			}
+			break;
+		}
+
+		default:
+			break;
+	}
+
+	return fTarget->HandlePackageAttribute(value);
+}
+
+
+void
+PackageSnapshot::Recorder::HandleErrorOccurred()
+{
+	fFailed = true;
+	fTarget->HandleErrorOccurred();
+}
+
+
+void
+PackageSnapshot::Recorder::_Write(const void* data, size_t size)
+{
+	if (fFailed)
+		return;
+
+	if (fSize + size > fCapacity) {
+		size_t capacity = fCapacity > 0 ? fCapacity * 2 : 4096;
+		while (capacity < fSize + size)
+			capacity *= 2;
+
+		uint8* buffer = NULL;
+		if (capacity <= kMaxSnapshotSize)
+			buffer = (uint8*)realloc(fBuffer, capacity);
+		if (buffer == NULL) {
+			// just don't record this package
+			fFailed = true;
+			return;
+		}
+
+		fBuffer = buffer;
+		fCapacity = capacity;
+	}
+
+	memcpy(fBuffer + fSize, data, size);
+	fSize += size;
+}
+
+
+void
+PackageSnapshot::Recorder::_WriteUInt8(uint8 value)
+{
+	_Write(&value, sizeof(value));
+}
+
+
+void
+PackageSnapshot::Recorder::_WriteUInt32(uint32 value)
+{
+	_Write(&value, sizeof(value));
+}
+
+
+void
+PackageSnapshot::Recorder::_WriteUInt64(uint64 value)
+{
+	_Write(&value, sizeof(value));
+}
+
+
+void
+PackageSnapshot::Recorder::_WriteString(const char* string)
+{
+	if (string == NULL) {
+		_WriteUInt32(kNullString);
+		return;
+	}
+
+	size_t length = strlen(string);
+	_WriteUInt32(length);
+	_Write(string, length + 1);
+}
+
+
+void
+PackageSnapshot::Recorder::_WriteData(const BPackageData& data)
+{
+	_WriteUInt8(data.IsEncodedInline());
+	_WriteUInt64(data.Size());
+
+	if (data.IsEncodedInline())
+		_Write(data.InlineData(), data.Size());
+	else
+		_WriteUInt64(data.Offset());
+}
+
+
+void
+PackageSnapshot::Recorder::_WriteVersion(const BPackageVersionData& version)
+{
+	_WriteString(version.major);
+	_WriteString(version.minor);
+	_WriteString(version.micro);
+	_WriteString(version.preRelease);
+	_WriteUInt32(version.revision);
+}
+
+
+uint8*
+PackageSnapshot::Recorder::_DetachBuffer(size_t& _size)
+{
+	if (fFailed || fCurrentEntry != NULL)
+		return NULL;
+
+	uint8* buffer = fBuffer;
+	_size = fSize;
+
+	fBuffer = NULL;
+	fSize = 0;
+	fCapacity = 0;
+	return buffer;
+}
+
+
+// #pragma mark - PackageSnapshot
+
+
+PackageSnapshot::PackageSnapshot()
+	:
+	fRecords(NULL),
+	fData(NULL),
+	fSize(0),
+	fLoadedRecords(0),
+	fReplayedRecords(0),
+	fAddedRecords(0)
+{
+}
+
+
+PackageSnapshot::~PackageSnapshot()
+{
+	if (fRecords != NULL) {
+		_Clear();
+		delete fRecords;
+	}
+
+	free(fData);
+}
+
+
+status_t
+PackageSnapshot::Init()
+{
+	fRecords = new(std::nothrow) RecordTable;
+	if (fRecords == NULL)
+		RETURN_ERROR(B_NO_MEMORY);
+
+	return fRecords->Init();
+}
+
+
+/*!	Loads the snapshot file. If it cannot be read, or does not match this
+	version of packagefs, the snapshot stays empty, and all packages will be
+	parsed as usual.
+*/
+status_t
+PackageSnapshot::Load(int directoryFD, const char* path)
+{
+	int fd = openat(directoryFD, path, O_RDONLY);
+	if (fd < 0)
+		return errno;
+	FileDescriptorCloser fdCloser(fd);
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+		RETURN_ERROR(errno);
+
+	if (st.st_size < (off_t)sizeof(packagefs_snapshot_header)
+		|| st.st_size > (off_t)kMaxSnapshotSize) {
+		RETURN_ERROR(B_BAD_DATA);
+	}
+
+	uint8* data = (uint8*)malloc(st.st_size);
+	if (data == NULL)
+		RETURN_ERROR(B_NO_MEMORY);
+	MemoryDeleter dataDeleter(data);
+
+	ssize_t bytesRead = read(fd, data, st.st_size);
+	if (bytesRead < 0)
+		RETURN_ERROR(errno);
+	if (bytesRead != st.st_size)
+		RETURN_ERROR(B_ERROR);
+
+	packagefs_snapshot_header header;
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != kSnapshotMagic || header.version != kSnapshotVersion
+		|| header.size != (uint64)st.st_size) {
+		INFORM("Ignoring outdated package snapshot\n");
+		return B_MISMATCHED_VALUES;
+	}
+
+	uint32 checksum = _Checksum(kChecksumSeed, data + sizeof(header),
+		st.st_size - sizeof(header));
+	if (checksum != header.checksum) {
+		ERROR("Package snapshot is corrupt\n");
+		return B_BAD_DATA;
+	}
+
+	// create the records -- their content is used in place
+	Reader reader(data + sizeof(header), st.st_size - sizeof(header));
+	for (uint32 i = 0; i < header.record_count; i++) {
+		packagefs_snapshot_record recordHeader;
+		if (!reader.Read(&recordHeader, sizeof(recordHeader))) {
+			_Clear();
+			RETURN_ERROR(B_BAD_DATA);
+		}
+
+		Record* record = new(std::nothrow) Record;
+		if (record == NULL) {
+			_Clear();
+			RETURN_ERROR(B_NO_MEMORY);
+		}
+
+		record->nodeID = recordHeader.node_id;
+		record->fileSize = recordHeader.file_size;
+		record->modifiedTime.tv_sec = recordHeader.modified_time;
+		record->modifiedTime.tv_nsec = recordHeader.modified_time_nsecs;
+		record->content = reader.Current();
+		record->contentSize = recordHeader.content_size;
+
+		if (!reader.Skip(record->contentSize)
+			|| fRecords->Lookup(record->nodeID) != NULL) {
+			delete record;
+			_Clear();
+			RETURN_ERROR(B_BAD_DATA);
+		}
+
+		fRecords->Insert(record);
+	}
+
+	if (!reader.IsAtEnd()) {
+		_Clear();
+		RETURN_ERROR(B_BAD_DATA);
+	}
+
+	fData = (uint8*)dataDeleter.Detach();
+	fSize = st.st_size;
+	fLoadedRecords = header.record_count;
+	return B_OK;
+}
+
+
+/*!	Writes the records of the given packages to the snapshot file. Records of
+	packages that are no longer around are dropped.
+*/
+status_t
+PackageSnapshot::Write(int directoryFD, const char* path,
+	const PackageFileNameHashTable& packages)
+{
+	int fd = openat(directoryFD, path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		// the packages directory might be read-only
+		return errno;
+	}
+	FileDescriptorCloser fdCloser(fd);
+
+	packagefs_snapshot_header header;
+	memset(&header, 0, sizeof(header));
+
+	status_t error = B_OK;
+	uint64 size = sizeof(header);
+	uint32 checksum = kChecksumSeed;
+	uint32 recordCount = 0;
+
+	if (write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header))
+		error = errno != 0 ? errno : B_IO_ERROR;
+
+	for (PackageFileNameHashTable::Iterator it = packages.GetIterator();
+			error == B_OK && it.HasNext();) {
+		Package* package = it.Next();
+		Record* record = fRecords->Lookup(package->NodeID());
+		if (record == NULL)
+			continue;
+
+		if (size + sizeof(packagefs_snapshot_record) + record->contentSize
+				> kMaxSnapshotSize) {
+			break;
+		}
+
+		packagefs_snapshot_record recordHeader;
+		memset(&recordHeader, 0, sizeof(recordHeader));
+		recordHeader.node_id = record->nodeID;
+		recordHeader.file_size = record->fileSize;
+		recordHeader.modified_time = record->modifiedTime.tv_sec;
+		recordHeader.modified_time_nsecs = record->modifiedTime.tv_nsec;
+		recordHeader.content_size = record->contentSize;
+
+		if (write(fd, &recordHeader, sizeof(recordHeader))
+				!= (ssize_t)sizeof(recordHeader)
+			|| write(fd, record->content, record->contentSize)
+				!= (ssize_t)record->contentSize) {
+			error = errno != 0 ? errno : B_IO_ERROR;
+			break;
+		}
+
+		checksum = _Checksum(checksum, &recordHeader, sizeof(recordHeader));
+		checksum = _Checksum(checksum, record->content, record->contentSize);
+		size += sizeof(recordHeader) + record->contentSize;
+		recordCount++;
+	}
+
+	if (error == B_OK) {
+		header.magic = kSnapshotMagic;
+		header.version = kSnapshotVersion;
+		header.record_count = recordCount;
+		header.checksum = checksum;
+		header.size = size;
+
+		if (lseek(fd, 0, SEEK_SET) != 0
+			|| write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header)
+			|| fsync(fd) != 0) {
+			error = errno != 0 ? errno : B_IO_ERROR;
+		}
+	}
+
+	if (error != B_OK) {
+		// don't leave a partial snapshot behind
+		fdCloser.Unset();
+		unlinkat(directoryFD, path, 0);
+		RETURN_ERROR(error);
+	}
+
+	return B_OK;
+}
+
+
+bool
+PackageSnapshot::NeedsUpdate() const
+{
+	return fAddedRecords > 0 || fReplayedRecords != fLoadedRecords;
+}
+
+
+/*!	Replays the recorded content of the package file with the given stat
+	data to \a handler.
+	Returns \c B_ENTRY_NOT_FOUND, if there is no valid record for the file;
+	the handler has not been called in this case.
+*/
+status_t
+PackageSnapshot::Replay(const struct stat& st, BPackageContentHandler* handler)
+{
+	Record* record = fRecords->Lookup(st.st_ino);
+	if (record == NULL)
+		return B_ENTRY_NOT_FOUND;
+
+	if (!record->Matches(st)) {
+		_RemoveRecord(record);
+		return B_ENTRY_NOT_FOUND;
+	}
+
+	status_t error = _Replay(record, handler);
+	if (error != B_OK) {
+		handler->HandleErrorOccurred();
+		_RemoveRecord(record);
+		RETURN_ERROR(error);
+	}
+
+	if (!record->replayed) {
+		record->replayed = true;
+		fReplayedRecords++;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Adds the content recorded by \a recorder as the record for the package
+	file with the given stat data. The recorder must have seen the complete
+	content of the package.
+*/
+status_t
+PackageSnapshot::AddRecord(const struct stat& st, Recorder& recorder)
+{
+	size_t contentSize;
+	uint8* content = recorder._DetachBuffer(contentSize);
+	if (content == NULL)
+		return B_BAD_DATA;
+
+	if (contentSize > kMaxSnapshotSize) {
+		free(content);
+		return B_BAD_DATA;
+	}
+
+	Record* record = new(std::nothrow) Record;
+	if (record == NULL) {
+		free(content);
+		RETURN_ERROR(B_NO_MEMORY);
+	}
+
+	record->nodeID = st.st_ino;
+	record->fileSize = st.st_size;
+	record->modifiedTime = st.st_mtim;
+	record->content = content;
+	record->contentSize = contentSize;
+	record->ownedContent = content;
+
+	if (Record* oldRecord = fRecords->Lookup(record->nodeID))
+		_RemoveRecord(oldRecord);
+
+	fRecords->Insert(record);
+	fAddedRecords++;
+	return B_OK;
+}
+
+
+status_t
+PackageSnapshot::_Replay(const Record* record, BPackageContentHandler* handler)
+{
+	Reader reader(record->content, record->contentSize);
+	ReplayEntry* currentEntry = NULL;
+	status_t error = B_OK;
+
+	while (error == B_OK && !reader.IsAtEnd()) {
+		uint8 op;
+		reader.ReadUInt8(op);
+
+		switch (op) {
+			case SNAPSHOT_ENTRY:
+			{
+				const char* name;
+				uint32 mode;
+				uint32 modifiedTime;
+				uint32 modifiedTimeNanos;
+				const char* symlinkPath;
+				if (!reader.ReadString(name) || name == NULL
+					|| !reader.ReadUInt32(mode)
+					|| !reader.ReadUInt32(modifiedTime)
+					|| !reader.ReadUInt32(modifiedTimeNanos)
+					|| !reader.ReadString(symlinkPath)) {
+					error = B_BAD_DATA;
+					break;
+				}
+
+				ReplayEntry* entry = new(std::nothrow) ReplayEntry(
+					currentEntry, name);
+				if (entry == NULL) {
+					error = B_NO_MEMORY;
+					break;
+				}
+
+				currentEntry = entry;
+
+				entry->SetType(mode);
+				entry->SetPermissions(mode);
+				entry->SetModifiedTime(modifiedTime);
+				entry->SetModifiedTimeNanos(modifiedTimeNanos);
+				entry->SetSymlinkPath(symlinkPath);
+				if (!reader.ReadData(entry->Data())) {
+					error = B_BAD_DATA;
+					break;
+				}
+
+				error = handler->HandleEntry(entry);
+				break;
+			}
+
+			case SNAPSHOT_ENTRY_ATTRIBUTE:
+			{
+				const char* name;
+				uint32 type;
+				if (currentEntry == NULL || !reader.ReadString(name)
+					|| name == NULL || !reader.ReadUInt32(type)) {
+					error = B_BAD_DATA;
+					break;
+				}
+
+				BPackageEntryAttribute attribute(name);
+				attribute.SetType(type);
+				if (!reader.ReadData(attribute.Data())) {
+					error = B_BAD_DATA;
+					break;
+				}
+
+				error = handler->HandleEntryAttribute(currentEntry,
+					&attribute);
+				break;
+			}
+
+			case SNAPSHOT_ENTRY_DONE:
+			{
+				if (currentEntry == NULL) {
+					error = B_BAD_DATA;
+					break;
+				}
+
+				ReplayEntry* entry = currentEntry;
+				currentEntry = entry->parent;
+
+				error = handler->HandleEntryDone(entry);
+				delete entry;
+				break;
+			}
+
+			case SNAPSHOT_PACKAGE_ATTRIBUTE:
+			{
+				BPackageInfoAttributeValue value;
+				if (!reader.ReadPackageAttribute(value)) {
+					error = B_BAD_DATA;
+					break;
+				}
+
+				error = handler->HandlePackageAttribute(value);
+				break;
+			}
+
+			default:
+				error = B_BAD_DATA;
+				break;
+		}
+	}
+
+	if (error == B_OK && currentEntry != NULL)
+		error = B_BAD_DATA;
+
+	while (currentEntry != NULL) {
+		ReplayEntry* entry = currentEntry;
+		currentEntry = entry->parent;
+		delete entry;
+	}
+
+	return error;
+}
+
+
+void
+PackageSnapshot::_RemoveRecord(Record* record)
+{
+	if (record->replayed)
+		fReplayedRecords--;
+
+	fRecords->Remove(record);
+	delete record;
+}
+
+
+void
+PackageSnapshot::_Clear()
+{
+	Record* record = fRecords->Clear(true);
+	while (record != NULL) {
+		Record* next = record->hashNext;
+		delete record;
+		record = next;
+	}
+
+	fLoadedRecords = 0;
+	fReplayedRecords = 0;
+	fAddedRecords = 0;
+}
+
+
+/*static*/ uint32
+PackageSnapshot::_Checksum(uint32 checksum, const void* data, size_t size)
+{
+	// FNV-1a
+	const uint8* bytes = (const uint8*)data;
+	for (size_t i = 0; i < size; i++)
+		checksum = (checksum ^ bytes[i]) * 16777619U;
+
+	return checksum;
+}
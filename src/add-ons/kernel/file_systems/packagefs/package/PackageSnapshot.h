@@ -0,0 +1,128 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef PACKAGE_SNAPSHOT_H
+#define PACKAGE_SNAPSHOT_H
+
+
+#include <sys/stat.h>
+
+#include <package/hpkg/PackageContentHandler.h>
+#include <package/hpkg/PackageInfoAttributeValue.h>
+
+#include <util/OpenHashTable.h>
+
+#include "Package.h"
+
+
+using BPackageKit::BHPKG::BPackageContentHandler;
+using BPackageKit::BHPKG::BPackageData;
+using BPackageKit::BHPKG::BPackageEntry;
+using BPackageKit::BHPKG::BPackageEntryAttribute;
+using BPackageKit::BHPKG::BPackageInfoAttributeValue;
+using BPackageKit::BHPKG::BPackageVersionData;
+
+
+/*!	A persistent copy of the content of the activated packages, as it was
+	delivered by the package reader when the packages were last loaded.
+
+	The content of a package is recorded while its TOC is parsed, and is
+	stored per package file, so that only the packages that changed need to
+	be parsed again. When a package is loaded, and the snapshot has a valid
+	record for it, the content is replayed to the loader from the record
+	instead, which saves reading and decompressing its TOC.
+	Since the content is replayed through the same handler, the package
+	settings are applied as usual.
+*/
+class PackageSnapshot {
+public:
+			class Recorder;
+
+public:
+								PackageSnapshot();
+								~PackageSnapshot();
+
+			status_t			Init();
+
+			status_t			Load(int directoryFD, const char* path);
+			status_t			Write(int directoryFD, const char* path,
+									const PackageFileNameHashTable& packages);
+			bool				NeedsUpdate() const;
+
+			status_t			Replay(const struct stat& st,
+									BPackageContentHandler* handler);
+			status_t			AddRecord(const struct stat& st,
+									Recorder& recorder);
+
+private:
+			struct Record;
+			struct RecordHashDefinition;
+			struct Reader;
+			struct ReplayEntry;
+
+			typedef BOpenHashTable<RecordHashDefinition> RecordTable;
+
+private:
+			status_t			_Replay(const Record* record,
+									BPackageContentHandler* handler);
+			void				_RemoveRecord(Record* record);
+			void				_Clear();
+
+	static	uint32				_Checksum(uint32 checksum, const void* data,
+									size_t size);
+
+private:
+			RecordTable*		fRecords;
+			uint8*				fData;
+			size_t				fSize;
+			uint32				fLoadedRecords;
+			uint32				fReplayedRecords;
+			uint32				fAddedRecords;
+};
+
+
+/*!	Passes the package content on to another handler, and records it for
+	the snapshot.
+*/
+class PackageSnapshot::Recorder : public BPackageContentHandler {
+public:
+								Recorder(BPackageContentHandler* target);
+	virtual						~Recorder();
+
+	virtual	status_t			HandleEntry(BPackageEntry* entry);
+	virtual	status_t			HandleEntryAttribute(BPackageEntry* entry,
+									BPackageEntryAttribute* attribute);
+	virtual	status_t			HandleEntryDone(BPackageEntry* entry);
+
+	virtual	status_t			HandlePackageAttribute(
+									const BPackageInfoAttributeValue& value);
+
+	virtual	void				HandleErrorOccurred();
+
+private:
+			friend class PackageSnapshot;
+
+private:
+			void				_Write(const void* data, size_t size);
+			void				_WriteUInt8(uint8 value);
+			void				_WriteUInt32(uint32 value);
+			void				_WriteUInt64(uint64 value);
+			void				_WriteString(const char* string);
+			void				_WriteData(const BPackageData& data);
+			void				_WriteVersion(
+									const BPackageVersionData& version);
+
+			uint8*				_DetachBuffer(size_t& _size);
+
+private:
+			BPackageContentHandler* fTarget;
+			uint8*				fBuffer;
+			size_t				fSize;
+			size_t				fCapacity;
+			const BPackageEntry* fCurrentEntry;
+			bool				fFailed;
+};
+
+
+#endif	// PACKAGE_SNAPSHOT_H
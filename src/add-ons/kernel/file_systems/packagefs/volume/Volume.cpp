@@ -35,6 +35,7 @@
 #include "PackageFSRoot.h"
 #include "PackageLinkDirectory.h"
 #include "PackageLinksDirectory.h"
+#include "PackageSnapshot.h"
 #include "Resolvable.h"
 #include "SizeIndex.h"
 #include "UnpackingLeafNode.h"
@@ -68,6 +69,8 @@ static const char* const kActivationFileName
 static const char* const kActivationFilePath
 	= PACKAGES_DIRECTORY_ADMIN_DIRECTORY "/"
 		PACKAGES_DIRECTORY_ACTIVATION_FILE;
+static const char* const kSnapshotFilePath
+	= PACKAGES_DIRECTORY_ADMIN_DIRECTORY "/packagefs_snapshot";
 
 
 // #pragma mark - ShineThroughDirectory
@@ -171,6 +174,7 @@ Volume::Volume(fs_volume* fsVolume)
 	fPackagesDirectories(),
 	fPackagesDirectoriesByNodeRef(),
 	fPackageSettings(),
+	fSnapshot(NULL),
 	fNextNodeID(kRootDirectoryID + 1)
 {
 	rw_lock_init(&fLock, "packagefs volume");
@@ -423,7 +427,9 @@ Volume::Mount(const char* parameterString)
 		RETURN_ERROR(error);
 
 	// add initial packages
+	_InitSnapshot();
 	error = _AddInitialPackages();
+	_FinishSnapshot(error == B_OK);
 	if (error != B_OK)
 		RETURN_ERROR(error);
 
@@ -944,6 +950,40 @@ Volume::_LoadAndAddInitialPackage(PackagesDirectory* packagesDirectory,
 }
 
 
+/*!	Loads the package snapshot, which allows adding the initial packages
+	without parsing their TOCs again. Any problem with it merely means the
+	packages are parsed as usual.
+*/
+void
+Volume::_InitSnapshot()
+{
+	fSnapshot = new(std::nothrow) PackageSnapshot;
+	if (fSnapshot == NULL || fSnapshot->Init() != B_OK) {
+		delete fSnapshot;
+		fSnapshot = NULL;
+		return;
+	}
+
+	fSnapshot->Load(fPackagesDirectory->DirectoryFD(), kSnapshotFilePath);
+}
+
+
+void
+Volume::_FinishSnapshot(bool write)
+{
+	if (fSnapshot == NULL)
+		return;
+
+	if (write && fSnapshot->NeedsUpdate()) {
+		fSnapshot->Write(fPackagesDirectory->DirectoryFD(), kSnapshotFilePath,
+			fPackages);
+	}
+
+	delete fSnapshot;
+	fSnapshot = NULL;
+}
+
+
 inline void
 Volume::_AddPackage(Package* package)
 {
@@ -1489,7 +1529,7 @@ Volume::_LoadPackage(PackagesDirectory* packagesDirectory, const char* name,
 	if (error != B_OK)
 		return error;
 
-	error = package->Load(fPackageSettings);
+	error = package->Load(fPackageSettings, fSnapshot);
 	if (error != B_OK)
 		return error;
 
@@ -29,6 +29,7 @@
 class Directory;
 class PackageFSRoot;
 class PackagesDirectory;
+class PackageSnapshot;
 class UnpackingNode;
 
 typedef IndexHashTable::Iterator IndexDirIterator;
@@ -120,6 +121,8 @@ private:
 			status_t			_LoadAndAddInitialPackage(
 									PackagesDirectory* packagesDirectory,
 									const char* name);
+			void				_InitSnapshot();
+			void				_FinishSnapshot(bool write);
 
 	inline	void				_AddPackage(Package* package);
 	inline	void				_RemovePackage(Package* package);
@@ -189,6 +192,8 @@ private:
 			PackagesDirectoryList fPackagesDirectories;
 			PackagesDirectoryHashTable fPackagesDirectoriesByNodeRef;
 			PackageSettings		fPackageSettings;
+			PackageSnapshot*	fSnapshot;
+									// only while adding the initial packages
 
 			struct {
 				dev_t			deviceID;
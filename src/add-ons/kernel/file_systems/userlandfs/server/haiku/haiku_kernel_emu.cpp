@@ -15,6 +15,7 @@
 #include <NodeMonitor.h>
 
 #include <fs/node_monitor.h>
+#include <smp.h>
 
 #include "Debug.h"
 
@@ -36,19 +37,28 @@
 #if __GNUC__ == 2
 
 #include <cpu.h>
-#include <smp.h>
 
 cpu_ent gCPU[1];
 
 
+#endif	// __GNUC__ == 2
+
+
+// #pragma mark - SMP
+
+
 int32
-smp_get_current_cpu(void)
+smp_get_num_cpus(void)
 {
-	return 0;
+	return 1;
 }
 
 
-#endif	// __GNUC__ == 2
+int32
+smp_get_current_cpu(void)
+{
+	return 0;
+}
 
 
 // #pragma mark - Notifications
@@ -0,0 +1,375 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "BBRCongestionControl.h"
+
+#include <string.h>
+
+#include <KernelExport.h>
+
+
+enum {
+	MODE_STARTUP,
+	MODE_DRAIN,
+	MODE_PROBE_BANDWIDTH,
+	MODE_PROBE_ROUND_TRIP
+};
+
+// gains are in 1/1000
+static const uint32 kGainUnit = 1000;
+static const uint32 kHighGain = 2885;
+	// 2 / ln(2), the smallest gain that doubles the delivery rate per round
+static const uint32 kDrainGain = 347;
+	// 1 / kHighGain
+static const uint32 kWindowGain = 2000;
+static const uint32 kCycleGains[] = {
+	1250, 750, 1000, 1000, 1000, 1000, 1000, 1000
+};
+
+static const uint32 kFullBandwidthGrowth = 1250;
+static const uint32 kFullBandwidthRounds = 3;
+	// the pipe is full when the bandwidth did not grow by 25% in 3 rounds
+
+static const uint32 kMinPipeSegments = 4;
+static const bigtime_t kMinRoundTripInterval = 10000000;
+static const bigtime_t kProbeRoundTripDuration = 200000;
+
+
+static const char*
+name_for_mode(uint32 mode)
+{
+	switch (mode) {
+		case MODE_STARTUP:
+			return "startup";
+		case MODE_DRAIN:
+			return "drain";
+		case MODE_PROBE_BANDWIDTH:
+			return "probe bandwidth";
+		case MODE_PROBE_ROUND_TRIP:
+			return "probe rtt";
+		default:
+			return "-";
+	}
+}
+
+
+//	#pragma mark -
+
+
+BBRCongestionControl::BBRCongestionControl(uint32& congestionWindow,
+	uint32& slowStartThreshold)
+	:
+	CongestionControl(congestionWindow, slowStartThreshold)
+{
+	Init(fMaxSegmentSize);
+}
+
+
+const char*
+BBRCongestionControl::Name() const
+{
+	return "bbr";
+}
+
+
+void
+BBRCongestionControl::Init(uint32 maxSegmentSize)
+{
+	CongestionControl::Init(maxSegmentSize);
+
+	fMode = MODE_STARTUP;
+	fPacingGain = kHighGain;
+	fWindowGain = kHighGain;
+
+	fDelivered = 0;
+	fRoundDelivered = 0;
+	fRoundStart = 0;
+	fRoundEnd = 0;
+	fRoundCount = 0;
+	fRoundStarted = false;
+	memset(fBandwidthSamples, 0, sizeof(fBandwidthSamples));
+
+	fMinRoundTrip = 0;
+	fMinRoundTripStamp = 0;
+	fMinRoundTripExpired = false;
+
+	fFullBandwidth = 0;
+	fFullBandwidthRounds = 0;
+	fFilledPipe = false;
+
+	fCycleIndex = 0;
+	fCycleStart = 0;
+
+	fProbeRoundTripDone = 0;
+	fProbeRoundTripRound = 0;
+	fPriorWindow = 0;
+	fInitialWindow = max_c(fCongestionWindow,
+		kMinPipeSegments * maxSegmentSize);
+}
+
+
+void
+BBRCongestionControl::Acknowledged(const tcp_ack_sample& sample)
+{
+	fDelivered += sample.bytes_acknowledged;
+
+	_UpdateRound(sample);
+	_UpdateMinRoundTrip(sample);
+	_CheckFullPipe();
+	_UpdateMode(sample);
+	_UpdateWindow(sample);
+}
+
+
+/*!	Losses are no congestion signal for BBR, but the data in flight is kept
+	to what is left in the network for the duration of the recovery.
+*/
+void
+BBRCongestionControl::EnterRecovery(uint32 flightSize)
+{
+	fPriorWindow = fCongestionWindow;
+	fCongestionWindow = max_c(flightSize,
+		kMinPipeSegments * fMaxSegmentSize);
+}
+
+
+void
+BBRCongestionControl::ExitRecovery(uint32 flightSize)
+{
+	fCongestionWindow = max_c(fCongestionWindow, fPriorWindow);
+}
+
+
+void
+BBRCongestionControl::RetransmitTimeout(uint32 flightSize)
+{
+	fPriorWindow = max_c(fCongestionWindow, fPriorWindow);
+	fCongestionWindow = fMaxSegmentSize;
+}
+
+
+uint64
+BBRCongestionControl::PacingRate() const
+{
+	uint64 bandwidth = _Bandwidth();
+	if (bandwidth == 0) {
+		// pace the initial window over the round trip time, if known
+		if (fMinRoundTrip == 0)
+			return 0;
+		bandwidth = (uint64)fCongestionWindow * 1000000 / fMinRoundTrip;
+	}
+
+	return bandwidth * fPacingGain / kGainUnit;
+}
+
+
+void
+BBRCongestionControl::Dump() const
+{
+	kprintf("    mode: %s, pacing gain %" B_PRIu32 ", window gain %" B_PRIu32
+		"%s\n", name_for_mode(fMode), fPacingGain, fWindowGain,
+		fFilledPipe ? ", pipe filled" : "");
+	kprintf("    bandwidth: %" B_PRIu64 " bytes/s, min rtt %" B_PRIdBIGTIME
+		", round %" B_PRIu32 "\n", _Bandwidth(), fMinRoundTrip, fRoundCount);
+	kprintf("    delivered: %" B_PRIu64 ", prior window %" B_PRIu32 "\n",
+		fDelivered, fPriorWindow);
+}
+
+
+/*!	A round trip ends when the data that was outstanding at its start has
+	been acknowledged. The data delivered during the round then makes a
+	sample of the delivery rate.
+*/
+void
+BBRCongestionControl::_UpdateRound(const tcp_ack_sample& sample)
+{
+	fRoundStarted = false;
+
+	if (fRoundStart != 0) {
+		if (sample.acknowledge < fRoundEnd)
+			return;
+
+		bigtime_t interval = sample.now - fRoundStart;
+		if (interval > 0) {
+			fRoundCount++;
+			fRoundStarted = true;
+
+			// the minimal window while probing the round trip time says
+			// nothing about the bandwidth, and must not age out the samples
+			// that do
+			if (fMode != MODE_PROBE_ROUND_TRIP) {
+				fBandwidthSamples[fRoundCount % kBandwidthFilterRounds]
+					= (fDelivered - fRoundDelivered) * 1000000 / interval;
+			}
+		}
+	}
+
+	fRoundStart = sample.now;
+	fRoundDelivered = fDelivered;
+	fRoundEnd = sample.send_max;
+}
+
+
+void
+BBRCongestionControl::_UpdateMinRoundTrip(const tcp_ack_sample& sample)
+{
+	fMinRoundTripExpired = fMinRoundTripStamp != 0
+		&& sample.now > fMinRoundTripStamp + kMinRoundTripInterval;
+
+	if (sample.round_trip_time > 0
+		&& (fMinRoundTrip == 0 || sample.round_trip_time <= fMinRoundTrip
+			|| fMinRoundTripExpired)) {
+		fMinRoundTrip = sample.round_trip_time;
+		fMinRoundTripStamp = sample.now;
+	}
+}
+
+
+void
+BBRCongestionControl::_CheckFullPipe()
+{
+	if (fFilledPipe || !fRoundStarted)
+		return;
+
+	uint64 bandwidth = _Bandwidth();
+	if (bandwidth * kGainUnit >= fFullBandwidth * kFullBandwidthGrowth) {
+		fFullBandwidth = bandwidth;
+		fFullBandwidthRounds = 0;
+		return;
+	}
+
+	if (++fFullBandwidthRounds >= kFullBandwidthRounds)
+		fFilledPipe = true;
+}
+
+
+void
+BBRCongestionControl::_UpdateMode(const tcp_ack_sample& sample)
+{
+	if (fMode == MODE_STARTUP && fFilledPipe) {
+		// drain the queue built up during startup
+		fMode = MODE_DRAIN;
+		fPacingGain = kDrainGain;
+		fWindowGain = kHighGain;
+	}
+	if (fMode == MODE_DRAIN && sample.flight_size <= _Inflight(kGainUnit))
+		_EnterProbeBandwidth(sample.now);
+
+	if (fMode == MODE_PROBE_BANDWIDTH) {
+		uint32 gain = kCycleGains[fCycleIndex];
+		bool fullLength = sample.now - fCycleStart > fMinRoundTrip;
+		bool advance = fullLength;
+		if (gain > kGainUnit) {
+			advance = fullLength && (sample.in_recovery
+				|| sample.flight_size >= _Inflight(gain));
+		} else if (gain < kGainUnit) {
+			advance = fullLength
+				|| sample.flight_size <= _Inflight(kGainUnit);
+		}
+
+		if (advance) {
+			fCycleIndex = (fCycleIndex + 1) % B_COUNT_OF(kCycleGains);
+			fCycleStart = sample.now;
+			fPacingGain = kCycleGains[fCycleIndex];
+		}
+	}
+
+	if (fMinRoundTripExpired && fMode != MODE_PROBE_ROUND_TRIP) {
+		// let the queue drain to see the actual round trip time again
+		fMode = MODE_PROBE_ROUND_TRIP;
+		fPacingGain = kGainUnit;
+		fWindowGain = kGainUnit;
+		fPriorWindow = max_c(fCongestionWindow, fPriorWindow);
+		fProbeRoundTripDone = 0;
+	}
+
+	if (fMode == MODE_PROBE_ROUND_TRIP) {
+		if (fProbeRoundTripDone == 0) {
+			if (sample.flight_size <= kMinPipeSegments * fMaxSegmentSize) {
+				fProbeRoundTripDone = sample.now + kProbeRoundTripDuration;
+				fProbeRoundTripRound = fRoundCount;
+			}
+		} else if (fRoundCount > fProbeRoundTripRound
+			&& sample.now >= fProbeRoundTripDone) {
+			fMinRoundTripStamp = sample.now;
+			fCongestionWindow = max_c(fCongestionWindow, fPriorWindow);
+			fPriorWindow = 0;
+
+			if (fFilledPipe)
+				_EnterProbeBandwidth(sample.now);
+			else {
+				fMode = MODE_STARTUP;
+				fPacingGain = kHighGain;
+				fWindowGain = kHighGain;
+			}
+		}
+	}
+}
+
+
+void
+BBRCongestionControl::_UpdateWindow(const tcp_ack_sample& sample)
+{
+	uint32 minWindow = kMinPipeSegments * fMaxSegmentSize;
+	if (fMode == MODE_PROBE_ROUND_TRIP) {
+		fCongestionWindow = min_c(fCongestionWindow, minWindow);
+		return;
+	}
+
+	uint32 target = _Inflight(fWindowGain);
+	uint32 window = fCongestionWindow;
+	if (fFilledPipe)
+		window = min_c(window + sample.bytes_acknowledged, target);
+	else if (window < target || fDelivered < fInitialWindow)
+		window += sample.bytes_acknowledged;
+
+	fCongestionWindow = max_c(window, minWindow);
+}
+
+
+void
+BBRCongestionControl::_EnterProbeBandwidth(bigtime_t now)
+{
+	fMode = MODE_PROBE_BANDWIDTH;
+	fWindowGain = kWindowGain;
+
+	// start at a random phase, but not the one that drains
+	fCycleIndex = (now / 1000) % (B_COUNT_OF(kCycleGains) - 1);
+	if (fCycleIndex > 0)
+		fCycleIndex++;
+	fCycleStart = now;
+	fPacingGain = kCycleGains[fCycleIndex];
+}
+
+
+/*!	Returns the bottleneck bandwidth estimate in bytes per second: the
+	highest delivery rate of the last rounds.
+*/
+uint64
+BBRCongestionControl::_Bandwidth() const
+{
+	uint64 bandwidth = 0;
+	for (uint32 i = 0; i < kBandwidthFilterRounds; i++)
+		bandwidth = max_c(bandwidth, fBandwidthSamples[i]);
+
+	return bandwidth;
+}
+
+
+/*!	Returns \a gain times the estimated bandwidth delay product.
+*/
+uint32
+BBRCongestionControl::_Inflight(uint32 gain) const
+{
+	uint64 bandwidth = _Bandwidth();
+	if (bandwidth == 0 || fMinRoundTrip == 0)
+		return fInitialWindow;
+
+	uint64 inflight = bandwidth * fMinRoundTrip / 1000000 * gain / kGainUnit;
+	inflight = max_c(inflight, kMinPipeSegments * fMaxSegmentSize);
+
+	return min_c(inflight, UINT32_MAX);
+}
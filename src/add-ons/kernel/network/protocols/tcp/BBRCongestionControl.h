@@ -0,0 +1,89 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef BBR_CONGESTION_CONTROL_H
+#define BBR_CONGESTION_CONTROL_H
+
+
+#include "CongestionControl.h"
+
+
+/*!	BBR congestion control (draft-cardwell-iccrg-bbr-congestion-control).
+
+	Instead of reacting to losses, BBR builds a model of the path from the
+	rate at which data is delivered, and the lowest round trip time seen.
+	It paces the transmissions at the bottleneck bandwidth, and limits the
+	data in flight to a small multiple of the bandwidth delay product. The
+	bandwidth is probed for periodically by pacing faster for a round trip,
+	and the round trip time by draining the queue for a moment.
+
+	The delivery rate is sampled once per round trip, from the data
+	cumulatively acknowledged during it.
+*/
+class BBRCongestionControl : public CongestionControl {
+public:
+								BBRCongestionControl(uint32& congestionWindow,
+									uint32& slowStartThreshold);
+
+	virtual	const char*			Name() const;
+
+	virtual	void				Init(uint32 maxSegmentSize);
+
+	virtual	void				Acknowledged(const tcp_ack_sample& sample);
+	virtual	void				EnterRecovery(uint32 flightSize);
+	virtual	void				ExitRecovery(uint32 flightSize);
+	virtual	void				RetransmitTimeout(uint32 flightSize);
+
+	virtual	uint64				PacingRate() const;
+
+	virtual	void				Dump() const;
+
+private:
+			enum {
+				kBandwidthFilterRounds = 10
+			};
+
+			void				_UpdateRound(const tcp_ack_sample& sample);
+			void				_UpdateMinRoundTrip(
+									const tcp_ack_sample& sample);
+			void				_CheckFullPipe();
+			void				_UpdateMode(const tcp_ack_sample& sample);
+			void				_UpdateWindow(const tcp_ack_sample& sample);
+			void				_EnterProbeBandwidth(bigtime_t now);
+			uint64				_Bandwidth() const;
+			uint32				_Inflight(uint32 gain) const;
+
+private:
+			uint32				fMode;
+			uint32				fPacingGain;
+			uint32				fWindowGain;
+
+			// delivery rate estimation
+			uint64				fDelivered;
+			uint64				fRoundDelivered;
+			bigtime_t			fRoundStart;
+			tcp_sequence		fRoundEnd;
+			uint32				fRoundCount;
+			bool				fRoundStarted;
+			uint64				fBandwidthSamples[kBandwidthFilterRounds];
+
+			bigtime_t			fMinRoundTrip;
+			bigtime_t			fMinRoundTripStamp;
+			bool				fMinRoundTripExpired;
+
+			uint64				fFullBandwidth;
+			uint32				fFullBandwidthRounds;
+			bool				fFilledPipe;
+
+			uint32				fCycleIndex;
+			bigtime_t			fCycleStart;
+
+			bigtime_t			fProbeRoundTripDone;
+			uint32				fProbeRoundTripRound;
+			uint32				fPriorWindow;
+			uint32				fInitialWindow;
+};
+
+
+#endif	// BBR_CONGESTION_CONTROL_H
@@ -9,6 +9,8 @@
 
 #include "BufferQueue.h"
 
+#include <string.h>
+
 #include <KernelExport.h>
 
 
@@ -427,6 +429,62 @@ BufferQueue::Available(tcp_sequence sequence) const
 }
 
 
+/*!	Fills \a sacks with up to \a maxCount blocks of the data that has been
+	received beyond the contiguous part of the queue, to be reported to the
+	peer as selective acknowledgments (RFC 2018). The block that contains
+	\a recent, the start of the most recently received segment, comes first,
+	the others follow from the highest sequence down.
+	Returns the number of blocks.
+*/
+int32
+BufferQueue::GetSackBlocks(tcp_sack* sacks, int32 maxCount,
+	tcp_sequence recent) const
+{
+	tcp_sequence next = NextSequence();
+	if (maxCount <= 0 || IsContiguous())
+		return 0;
+
+	// reserve the first block for the most recent data, if it's out of order
+	bool haveRecent = recent <= next || recent >= fLastSequence;
+	int32 count = haveRecent ? 0 : 1;
+
+	SegmentList::ConstReverseIterator iterator = fList.GetReverseIterator();
+	net_buffer* buffer = iterator.Next();
+	while (buffer != NULL && tcp_sequence(buffer->sequence) > next) {
+		// merge adjacent buffers into a single block
+		tcp_sequence left = buffer->sequence;
+		tcp_sequence right = left + buffer->size;
+		while ((buffer = iterator.Next()) != NULL
+			&& tcp_sequence(buffer->sequence) > next
+			&& tcp_sequence(buffer->sequence + buffer->size) == left) {
+			left = buffer->sequence;
+		}
+
+		int32 index;
+		if (!haveRecent && recent >= left && recent < right) {
+			index = 0;
+			haveRecent = true;
+		} else if (count < maxCount)
+			index = count++;
+		else if (haveRecent)
+			break;
+		else
+			continue;
+
+		sacks[index].left_edge = left.Number();
+		sacks[index].right_edge = right.Number();
+	}
+
+	if (!haveRecent) {
+		// the recent data was no longer part of the queue
+		count--;
+		memmove(sacks, sacks + 1, count * sizeof(tcp_sack));
+	}
+
+	return count;
+}
+
+
 void
 BufferQueue::SetPushPointer()
 {
@@ -49,6 +49,9 @@ public:
 
 			bool				IsContiguous() const
 									{ return fNumBytes == fContiguousBytes; }
+			int32				GetSackBlocks(tcp_sack* sacks,
+									int32 maxCount,
+									tcp_sequence recent) const;
 
 			tcp_sequence		FirstSequence() const { return fFirstSequence; }
 			tcp_sequence		LastSequence() const { return fLastSequence; }
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "CongestionControl.h"
+
+#include <new>
+#include <string.h>
+
+#include <KernelExport.h>
+#include <driver_settings.h>
+
+#include "BBRCongestionControl.h"
+#include "CubicCongestionControl.h"
+#include "NewRenoCongestionControl.h"
+
+
+struct congestion_control_algorithm {
+	const char*			name;
+	CongestionControl*	(*create)(uint32& congestionWindow,
+							uint32& slowStartThreshold);
+};
+
+
+template<typename Algorithm> static CongestionControl*
+create_algorithm(uint32& congestionWindow, uint32& slowStartThreshold)
+{
+	return new(std::nothrow) Algorithm(congestionWindow, slowStartThreshold);
+}
+
+
+static const congestion_control_algorithm kAlgorithms[] = {
+	{ "newreno",	&create_algorithm<NewRenoCongestionControl> },
+	{ "cubic",		&create_algorithm<CubicCongestionControl> },
+	{ "bbr",		&create_algorithm<BBRCongestionControl> },
+};
+
+static const congestion_control_algorithm* sDefaultAlgorithm
+	= &kAlgorithms[0];
+
+
+static const congestion_control_algorithm*
+find_algorithm(const char* name)
+{
+	for (size_t i = 0; i < B_COUNT_OF(kAlgorithms); i++) {
+		if (strcmp(kAlgorithms[i].name, name) == 0)
+			return &kAlgorithms[i];
+	}
+
+	return NULL;
+}
+
+
+//	#pragma mark -
+
+
+CongestionControl::CongestionControl(uint32& congestionWindow,
+	uint32& slowStartThreshold)
+	:
+	fCongestionWindow(congestionWindow),
+	fSlowStartThreshold(slowStartThreshold),
+	fMaxSegmentSize(TCP_DEFAULT_MAX_SEGMENT_SIZE)
+{
+}
+
+
+CongestionControl::~CongestionControl()
+{
+}
+
+
+/*!	Called when the connection is established, or when the algorithm is
+	changed on an established connection. The connection has already set up
+	its initial window.
+*/
+void
+CongestionControl::Init(uint32 maxSegmentSize)
+{
+	fMaxSegmentSize = maxSegmentSize;
+}
+
+
+/*!	Called when all data outstanding at the start of the loss recovery has
+	been acknowledged. The window is set to the slow start threshold, but
+	not further than a segment beyond the remaining data in flight, in order
+	to avoid a burst (RFC 6582).
+*/
+void
+CongestionControl::ExitRecovery(uint32 flightSize)
+{
+	fCongestionWindow = min_c(fSlowStartThreshold,
+		max_c(flightSize, fMaxSegmentSize) + fMaxSegmentSize);
+}
+
+
+/*!	Returns the rate in bytes per second at which the connection should send
+	its data, or 0 if it is only limited by its congestion window.
+*/
+uint64
+CongestionControl::PacingRate() const
+{
+	return 0;
+}
+
+
+void
+CongestionControl::Dump() const
+{
+}
+
+
+//	#pragma mark -
+
+
+/*!	Creates the congestion control algorithm \a name, or the system default
+	one, if \a name is \c NULL, for a connection with the given window and
+	threshold.
+*/
+status_t
+create_congestion_control(const char* name, uint32& congestionWindow,
+	uint32& slowStartThreshold, CongestionControl** _control)
+{
+	const congestion_control_algorithm* algorithm = sDefaultAlgorithm;
+	if (name != NULL) {
+		algorithm = find_algorithm(name);
+		if (algorithm == NULL)
+			return B_NAME_NOT_FOUND;
+	}
+
+	CongestionControl* control = algorithm->create(congestionWindow,
+		slowStartThreshold);
+	if (control == NULL)
+		return B_NO_MEMORY;
+
+	*_control = control;
+	return B_OK;
+}
+
+
+status_t
+set_default_congestion_control(const char* name)
+{
+	const congestion_control_algorithm* algorithm = find_algorithm(name);
+	if (algorithm == NULL)
+		return B_NAME_NOT_FOUND;
+
+	sDefaultAlgorithm = algorithm;
+	return B_OK;
+}
+
+
+const char*
+default_congestion_control()
+{
+	return sDefaultAlgorithm->name;
+}
+
+
+/*!	Selects the system wide default algorithm, as configured by the
+	"congestion_control" parameter of the "tcp" driver settings.
+*/
+void
+init_congestion_control()
+{
+	void* handle = load_driver_settings("tcp");
+	if (handle == NULL)
+		return;
+
+	const char* name = get_driver_parameter(handle, "congestion_control",
+		NULL, NULL);
+	if (name != NULL && set_default_congestion_control(name) != B_OK) {
+		dprintf("tcp: unknown congestion control \"%s\", using \"%s\"\n",
+			name, default_congestion_control());
+	}
+
+	unload_driver_settings(handle);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef CONGESTION_CONTROL_H
+#define CONGESTION_CONTROL_H
+
+
+#include "tcp.h"
+
+
+//! What an incoming ACK tells the congestion control about the connection.
+struct tcp_ack_sample {
+	bigtime_t		now;
+	uint32			bytes_acknowledged;
+	uint32			flight_size;
+		// the unacknowledged data after this ACK
+	bigtime_t		round_trip_time;
+		// 0, if the ACK did not yield a sample
+	bigtime_t		smoothed_round_trip_time;
+	tcp_sequence	acknowledge;
+	tcp_sequence	send_max;
+	bool			in_recovery;
+};
+
+
+/*!	The congestion control algorithm of a TCP connection.
+
+	The connection owns the congestion window and the slow start threshold,
+	and keeps applying them as before, including the window inflation of the
+	NewReno fast recovery. The algorithm only decides how they change: on
+	every ACK of new data, when the connection enters and leaves loss
+	recovery, and on a retransmit timeout. It may also ask for the
+	transmissions to be paced.
+
+	An algorithm is created by name via create_congestion_control(), which
+	binds it to the window and threshold of the connection.
+*/
+class CongestionControl {
+public:
+								CongestionControl(uint32& congestionWindow,
+									uint32& slowStartThreshold);
+	virtual						~CongestionControl();
+
+	virtual	const char*			Name() const = 0;
+
+	virtual	void				Init(uint32 maxSegmentSize);
+
+	virtual	void				Acknowledged(
+									const tcp_ack_sample& sample) = 0;
+	virtual	void				EnterRecovery(uint32 flightSize) = 0;
+	virtual	void				ExitRecovery(uint32 flightSize);
+	virtual	void				RetransmitTimeout(uint32 flightSize) = 0;
+
+	virtual	uint64				PacingRate() const;
+
+	virtual	void				Dump() const;
+
+protected:
+			uint32&				fCongestionWindow;
+			uint32&				fSlowStartThreshold;
+			uint32				fMaxSegmentSize;
+};
+
+
+status_t create_congestion_control(const char* name,
+	uint32& congestionWindow, uint32& slowStartThreshold,
+	CongestionControl** _control);
+status_t set_default_congestion_control(const char* name);
+const char* default_congestion_control();
+void init_congestion_control();
+
+
+#endif	// CONGESTION_CONTROL_H
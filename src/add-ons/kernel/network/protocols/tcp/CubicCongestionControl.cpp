@@ -0,0 +1,214 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "CubicCongestionControl.h"
+
+#include <KernelExport.h>
+
+
+// The constants of RFC 9438, as fractions: C = 0.4, beta = 0.7, and the
+// additive increase of the Reno friendly region alpha = 3 * (1 - beta)
+// / (1 + beta) = 9 / 17.
+static const uint32 kBetaNumerator = 7;
+static const uint32 kBetaDenominator = 10;
+static const uint32 kAlphaNumerator = 9;
+static const uint32 kAlphaDenominator = 17;
+
+static const int64 kMaxTimeOffset = 2000000;
+	// in msecs; keeps the cube within 64 bit
+
+
+/*!	Returns the integer cube root of \a value.
+*/
+static uint64
+cube_root(uint64 value)
+{
+	uint64 root = 0;
+
+	for (int32 shift = 63; shift >= 0; shift -= 3) {
+		root <<= 1;
+		uint64 step = 3 * root * (root + 1) + 1;
+		if ((value >> shift) >= step) {
+			value -= step << shift;
+			root++;
+		}
+	}
+
+	return root;
+}
+
+
+//	#pragma mark -
+
+
+CubicCongestionControl::CubicCongestionControl(uint32& congestionWindow,
+	uint32& slowStartThreshold)
+	:
+	NewRenoCongestionControl(congestionWindow, slowStartThreshold),
+	fMaxWindow(0),
+	fOriginWindow(0),
+	fRenoWindow(0),
+	fEpochStart(0),
+	fPlateauTime(0),
+	fWindowCredit(0),
+	fRenoCredit(0)
+{
+}
+
+
+const char*
+CubicCongestionControl::Name() const
+{
+	return "cubic";
+}
+
+
+void
+CubicCongestionControl::Init(uint32 maxSegmentSize)
+{
+	NewRenoCongestionControl::Init(maxSegmentSize);
+
+	fMaxWindow = 0;
+	fEpochStart = 0;
+}
+
+
+void
+CubicCongestionControl::Acknowledged(const tcp_ack_sample& sample)
+{
+	if (sample.in_recovery)
+		return;
+
+	if (fCongestionWindow < fSlowStartThreshold) {
+		_SlowStart(sample);
+		return;
+	}
+
+	if (fEpochStart == 0)
+		_StartEpoch(sample.now);
+
+	// the window the standard algorithm would have reached by now
+	fRenoCredit += (uint64)kAlphaNumerator * sample.bytes_acknowledged
+		* fMaxSegmentSize;
+	uint64 renoStep = (uint64)kAlphaDenominator * fCongestionWindow;
+	fRenoWindow += fRenoCredit / renoStep;
+	fRenoCredit %= renoStep;
+
+	bigtime_t time = sample.now - fEpochStart;
+	uint32 cubicWindow = _CubicWindow(time);
+	if (cubicWindow < fRenoWindow) {
+		// Reno friendly region
+		if (fRenoWindow > fCongestionWindow)
+			fCongestionWindow = fRenoWindow;
+		return;
+	}
+
+	// aim for where the cubic function will be in one round trip, but
+	// grow at most by half the window per round trip
+	uint32 target = _CubicWindow(time + sample.smoothed_round_trip_time);
+	target = min_c(target, fCongestionWindow + fCongestionWindow / 2);
+	if (target <= fCongestionWindow)
+		return;
+
+	fWindowCredit += (uint64)(target - fCongestionWindow)
+		* sample.bytes_acknowledged;
+	fCongestionWindow += fWindowCredit / fCongestionWindow;
+	fWindowCredit %= fCongestionWindow;
+}
+
+
+void
+CubicCongestionControl::EnterRecovery(uint32 flightSize)
+{
+	_Reduce(flightSize);
+	fCongestionWindow = fSlowStartThreshold;
+}
+
+
+void
+CubicCongestionControl::RetransmitTimeout(uint32 flightSize)
+{
+	_Reduce(flightSize);
+	fCongestionWindow = fMaxSegmentSize;
+}
+
+
+void
+CubicCongestionControl::Dump() const
+{
+	kprintf("    max window: %" B_PRIu32 ", reno window: %" B_PRIu32 "\n",
+		fMaxWindow, fRenoWindow);
+	kprintf("    epoch: %" B_PRIdBIGTIME ", plateau after %" B_PRIdBIGTIME
+		"\n", fEpochStart, fPlateauTime);
+}
+
+
+/*!	Starts a new period of growth after a congestion event: the cubic
+	function reaches its plateau at the window before the loss after
+	fPlateauTime.
+*/
+void
+CubicCongestionControl::_StartEpoch(bigtime_t now)
+{
+	fEpochStart = now;
+	fRenoWindow = fCongestionWindow;
+	fWindowCredit = 0;
+	fRenoCredit = 0;
+
+	if (fCongestionWindow < fMaxWindow) {
+		// K = cbrt((W_max - cwnd) / C), in msecs
+		uint64 milliSegments = (uint64)(fMaxWindow - fCongestionWindow)
+			* 1000 / fMaxSegmentSize;
+		fPlateauTime = cube_root(milliSegments * 2500000) * 1000;
+		fOriginWindow = fMaxWindow;
+	} else {
+		fPlateauTime = 0;
+		fOriginWindow = fCongestionWindow;
+	}
+}
+
+
+/*!	Returns W_cubic(t) = C * (t - K)^3 + W_max in bytes, where \a time is
+	relative to the start of the epoch.
+*/
+uint32
+CubicCongestionControl::_CubicWindow(bigtime_t time) const
+{
+	int64 offset = (time - fPlateauTime) / 1000;
+	if (offset > kMaxTimeOffset)
+		offset = kMaxTimeOffset;
+	else if (offset < -kMaxTimeOffset)
+		offset = -kMaxTimeOffset;
+
+	// C * t^3 with t in secs is t^3 / 10^6 * 2 / 5000 with t in msecs
+	int64 window = (int64)fOriginWindow
+		+ offset * offset * offset / 1000000 * 2 * fMaxSegmentSize / 5000;
+	if (window < (int64)fMaxSegmentSize)
+		return fMaxSegmentSize;
+	if (window > UINT32_MAX)
+		return UINT32_MAX;
+
+	return (uint32)window;
+}
+
+
+void
+CubicCongestionControl::_Reduce(uint32 flightSize)
+{
+	fEpochStart = 0;
+
+	// fast convergence: give way to new flows by not probing back up to the
+	// window of the last loss, if the loss came even earlier this time
+	if (fCongestionWindow < fMaxWindow) {
+		fMaxWindow = (uint64)fCongestionWindow
+			* (kBetaDenominator + kBetaNumerator) / (2 * kBetaDenominator);
+	} else
+		fMaxWindow = fCongestionWindow;
+
+	fSlowStartThreshold = max_c(
+		(uint64)flightSize * kBetaNumerator / kBetaDenominator,
+		2 * fMaxSegmentSize);
+}
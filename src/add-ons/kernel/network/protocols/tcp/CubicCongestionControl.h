@@ -0,0 +1,52 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef CUBIC_CONGESTION_CONTROL_H
+#define CUBIC_CONGESTION_CONTROL_H
+
+
+#include "NewRenoCongestionControl.h"
+
+
+/*!	CUBIC congestion control (RFC 9438).
+
+	After a loss, the window follows a cubic function of the time since the
+	loss, rather than of the round trip time, which lets it regain the
+	window it had before the loss quickly on paths with a large bandwidth
+	delay product. It never grows slower than the standard algorithm would.
+	Slow start is left to NewReno.
+*/
+class CubicCongestionControl : public NewRenoCongestionControl {
+public:
+								CubicCongestionControl(
+									uint32& congestionWindow,
+									uint32& slowStartThreshold);
+
+	virtual	const char*			Name() const;
+
+	virtual	void				Init(uint32 maxSegmentSize);
+
+	virtual	void				Acknowledged(const tcp_ack_sample& sample);
+	virtual	void				EnterRecovery(uint32 flightSize);
+	virtual	void				RetransmitTimeout(uint32 flightSize);
+
+	virtual	void				Dump() const;
+
+private:
+			void				_StartEpoch(bigtime_t now);
+			uint32				_CubicWindow(bigtime_t time) const;
+			void				_Reduce(uint32 flightSize);
+
+private:
+			uint32				fMaxWindow;
+			uint32				fOriginWindow;
+			uint32				fRenoWindow;
+			bigtime_t			fEpochStart;
+			bigtime_t			fPlateauTime;
+			uint64				fWindowCredit;
+			uint64				fRenoCredit;
+};
+
+
+#endif	// CUBIC_CONGESTION_CONTROL_H
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "NewRenoCongestionControl.h"
+
+
+NewRenoCongestionControl::NewRenoCongestionControl(uint32& congestionWindow,
+	uint32& slowStartThreshold)
+	:
+	CongestionControl(congestionWindow, slowStartThreshold)
+{
+}
+
+
+const char*
+NewRenoCongestionControl::Name() const
+{
+	return "newreno";
+}
+
+
+void
+NewRenoCongestionControl::Acknowledged(const tcp_ack_sample& sample)
+{
+	// The congestion window doesn't grow during loss recovery (RFC 6582).
+	// Unlike before, that includes the fast recovery without SACK, where
+	// partial acknowledgments only deflate the window.
+	if (sample.in_recovery)
+		return;
+
+	if (fCongestionWindow < fSlowStartThreshold) {
+		_SlowStart(sample);
+		return;
+	}
+
+	uint32 increment = fMaxSegmentSize * fMaxSegmentSize;
+
+	if (increment < fCongestionWindow)
+		increment = 1;
+	else
+		increment /= fCongestionWindow;
+
+	fCongestionWindow += increment;
+}
+
+
+void
+NewRenoCongestionControl::EnterRecovery(uint32 flightSize)
+{
+	fSlowStartThreshold = max_c(flightSize / 2, 2 * fMaxSegmentSize);
+	fCongestionWindow = fSlowStartThreshold;
+}
+
+
+void
+NewRenoCongestionControl::RetransmitTimeout(uint32 flightSize)
+{
+	fSlowStartThreshold = max_c(flightSize / 2, 2 * fMaxSegmentSize);
+	fCongestionWindow = fMaxSegmentSize;
+}
+
+
+void
+NewRenoCongestionControl::_SlowStart(const tcp_ack_sample& sample)
+{
+	fCongestionWindow += min_c(sample.bytes_acknowledged, fMaxSegmentSize);
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef NEW_RENO_CONGESTION_CONTROL_H
+#define NEW_RENO_CONGESTION_CONTROL_H
+
+
+#include "CongestionControl.h"
+
+
+/*!	The standard TCP congestion control: slow start and congestion avoidance
+	as described in RFC 5681, halving the window on a loss.
+*/
+class NewRenoCongestionControl : public CongestionControl {
+public:
+								NewRenoCongestionControl(
+									uint32& congestionWindow,
+									uint32& slowStartThreshold);
+
+	virtual	const char*			Name() const;
+
+	virtual	void				Acknowledged(const tcp_ack_sample& sample);
+	virtual	void				EnterRecovery(uint32 flightSize);
+	virtual	void				RetransmitTimeout(uint32 flightSize);
+
+protected:
+			void				_SlowStart(const tcp_ack_sample& sample);
+};
+
+
+#endif	// NEW_RENO_CONGESTION_CONTROL_H
@@ -0,0 +1,449 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "SackScoreboard.h"
+
+#include <stdlib.h>
+
+#include <KernelExport.h>
+
+
+//#define TRACE_SACK_SCOREBOARD
+#ifdef TRACE_SACK_SCOREBOARD
+#	define TRACE(x) dprintf x
+#else
+#	define TRACE(x)
+#endif
+
+
+// flags of the segment records
+enum {
+	SEGMENT_SACKED			= 0x01,
+	SEGMENT_LOST			= 0x02,
+	SEGMENT_RETRANSMITTED	= 0x04,
+	SEGMENT_REMOVED			= 0x08
+};
+
+static const uint32 kInitialCapacity = 32;
+static const uint32 kMaxCapacity = 4096;
+
+static const uint32 kDuplicateThreshold = 3;
+	// the number of SACKed segments that indicate a loss without reordering
+static const bigtime_t kTimestampResolution = 1000;
+	// the resolution of the echoed TCP timestamps
+
+
+SackScoreboard::SackScoreboard()
+	:
+	fSegments(NULL),
+	fCapacity(0),
+	fFirst(0),
+	fCount(0),
+	fSackedSegments(0),
+	fValid(true),
+	fRackTime(0),
+	fRackEnd(0),
+	fRackRoundTrip(0),
+	fMinRoundTrip(0),
+	fReordering(false)
+{
+}
+
+
+SackScoreboard::~SackScoreboard()
+{
+	free(fSegments);
+}
+
+
+/*!	Forgets all segments, and makes the scoreboard valid again. Must only be
+	called when there is no outstanding data.
+*/
+void
+SackScoreboard::Clear()
+{
+	fFirst = 0;
+	fCount = 0;
+	fSackedSegments = 0;
+	fValid = true;
+}
+
+
+/*!	Forgets all segments, and stops recording new ones until Clear() is
+	called. This is used when the outstanding data is no longer fully known,
+	like after a retransmission timeout.
+*/
+void
+SackScoreboard::Invalidate()
+{
+	Clear();
+	fValid = false;
+}
+
+
+/*!	Records the transmission of the segment from \a start to \a end.
+	A retransmission replaces the records of the data it contains; a record
+	it lies within is split in two.
+*/
+void
+SackScoreboard::SegmentSent(tcp_sequence start, tcp_sequence end,
+	bigtime_t time, bool retransmit)
+{
+	if (!fValid)
+		return;
+
+	if (retransmit) {
+		if (!_Split(start, end)) {
+			TRACE(("SackScoreboard@%p: out of segment records\n", this));
+			Invalidate();
+			return;
+		}
+
+		for (uint32 i = 0; i < fCount; i++) {
+			Segment& segment = _SegmentAt(i);
+			if ((segment.flags & SEGMENT_REMOVED) != 0
+				|| segment.end <= start || segment.start >= end)
+				continue;
+
+			if (segment.start >= start && segment.end <= end) {
+				if ((segment.flags & SEGMENT_SACKED) != 0)
+					fSackedSegments--;
+				segment.flags = SEGMENT_REMOVED;
+			} else if (segment.start >= start)
+				segment.start = end;
+			else
+				segment.end = start;
+		}
+	}
+
+	if (fCount == fCapacity && !_Grow()) {
+		TRACE(("SackScoreboard@%p: out of segment records\n", this));
+		Invalidate();
+		return;
+	}
+
+	Segment& segment = _SegmentAt(fCount++);
+	segment.start = start;
+	segment.end = end;
+	segment.time = time;
+	segment.flags = retransmit ? SEGMENT_RETRANSMITTED : 0;
+}
+
+
+/*!	Processes an incoming ACK: removes the segments covered by the cumulative
+	\a acknowledge, and marks the ones covered by the SACK blocks. Blocks
+	that do not lie within the outstanding data are ignored.
+	\a echoedTime is the time of the transmission the peer's timestamp
+	echoes, or -1 if the segment had no timestamp.
+	Returns \c true if any segment was newly delivered.
+*/
+bool
+SackScoreboard::Acknowledge(tcp_sequence acknowledge, const tcp_sack* sacks,
+	int32 sackCount, tcp_sequence sendMax, bigtime_t now,
+	bigtime_t echoedTime)
+{
+	bool delivered = false;
+
+	for (uint32 i = 0; i < fCount; i++) {
+		Segment& segment = _SegmentAt(i);
+		if ((segment.flags & SEGMENT_REMOVED) != 0)
+			continue;
+
+		if (segment.end <= acknowledge) {
+			if ((segment.flags & SEGMENT_SACKED) == 0) {
+				_Delivered(segment, now, echoedTime);
+				delivered = true;
+			} else
+				fSackedSegments--;
+
+			segment.flags = SEGMENT_REMOVED;
+			continue;
+		}
+
+		if (segment.start < acknowledge)
+			segment.start = acknowledge;
+		if ((segment.flags & SEGMENT_SACKED) != 0)
+			continue;
+
+		for (int32 j = 0; j < sackCount; j++) {
+			tcp_sequence left = sacks[j].left_edge;
+			tcp_sequence right = sacks[j].right_edge;
+			if (left >= right || left < acknowledge || right > sendMax)
+				continue;
+
+			if (segment.start >= left && segment.end <= right) {
+				segment.flags = (segment.flags | SEGMENT_SACKED)
+					& ~SEGMENT_LOST;
+				fSackedSegments++;
+				_Delivered(segment, now, echoedTime);
+				delivered = true;
+				break;
+			}
+		}
+	}
+
+	while (fCount > 0 && (_SegmentAt(0).flags & SEGMENT_REMOVED) != 0) {
+		fFirst = (fFirst + 1) % fCapacity;
+		fCount--;
+	}
+
+	return delivered;
+}
+
+
+/*!	Marks all segments as lost that were sent long enough before the most
+	recently delivered segment, that reordering can be ruled out (RFC 8985).
+	If there are segments that might still just be reordered, \a _timeout is
+	set to the time after which they should be checked again, otherwise it
+	is set to zero.
+	Returns \c true if any segment was newly marked lost.
+*/
+bool
+SackScoreboard::DetectLosses(bigtime_t now, bigtime_t smoothedRoundTripTime,
+	bool recovery, bigtime_t& _timeout)
+{
+	_timeout = 0;
+	if (fRackTime == 0)
+		return false;
+
+	// Without evidence of reordering, we don't wait once a loss is obvious
+	bigtime_t reorderWindow = min_c(fMinRoundTrip / 4, smoothedRoundTripTime);
+	if (!fReordering
+		&& (recovery || fSackedSegments >= kDuplicateThreshold))
+		reorderWindow = 0;
+
+	bool lost = false;
+
+	for (uint32 i = 0; i < fCount; i++) {
+		Segment& segment = _SegmentAt(i);
+
+		// the records are ordered by their transmit time
+		if (segment.time > fRackTime)
+			break;
+		if ((segment.flags
+				& (SEGMENT_REMOVED | SEGMENT_SACKED | SEGMENT_LOST)) != 0
+			|| (segment.time == fRackTime && segment.end >= fRackEnd))
+			continue;
+
+		bigtime_t remaining = segment.time + fRackRoundTrip + reorderWindow
+			- now;
+		if (remaining <= 0) {
+			TRACE(("SackScoreboard@%p: segment %" B_PRIu32 " - %" B_PRIu32
+				" lost\n", this, segment.start.Number(),
+				segment.end.Number()));
+			segment.flags |= SEGMENT_LOST;
+			lost = true;
+		} else if (remaining > _timeout)
+			_timeout = remaining;
+	}
+
+	return lost;
+}
+
+
+/*!	Returns the start of the lowest segment that was lost, and has not been
+	retransmitted since.
+*/
+bool
+SackScoreboard::NextLost(tcp_sequence& _start) const
+{
+	bool found = false;
+
+	for (uint32 i = 0; i < fCount; i++) {
+		const Segment& segment = _SegmentAt(i);
+		if ((segment.flags & (SEGMENT_REMOVED | SEGMENT_LOST)) != SEGMENT_LOST)
+			continue;
+
+		if (!found || segment.start < _start) {
+			_start = segment.start;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+
+/*!	Returns the number of bytes from \a start up to the next data the peer
+	already has, so that retransmissions stay within the holes.
+*/
+uint32
+SackScoreboard::HoleLength(tcp_sequence start) const
+{
+	uint32 length = UINT32_MAX;
+
+	for (uint32 i = 0; i < fCount; i++) {
+		const Segment& segment = _SegmentAt(i);
+		if ((segment.flags & (SEGMENT_REMOVED | SEGMENT_SACKED))
+				!= SEGMENT_SACKED
+			|| segment.end <= start)
+			continue;
+
+		if (segment.start <= start)
+			return 0;
+		if ((segment.start - start).Number() < length)
+			length = (segment.start - start).Number();
+	}
+
+	return length;
+}
+
+
+/*!	Returns the number of bytes that are considered to be in the network,
+	ie. that are neither acknowledged, nor lost (RFC 6675).
+*/
+uint32
+SackScoreboard::Pipe() const
+{
+	uint32 pipe = 0;
+
+	for (uint32 i = 0; i < fCount; i++) {
+		const Segment& segment = _SegmentAt(i);
+		if ((segment.flags
+				& (SEGMENT_REMOVED | SEGMENT_SACKED | SEGMENT_LOST)) == 0)
+			pipe += (segment.end - segment.start).Number();
+	}
+
+	return pipe;
+}
+
+
+void
+SackScoreboard::Dump() const
+{
+	kprintf("    scoreboard: %s, %" B_PRIu32 " segments, %" B_PRIu32
+		" sacked, pipe %" B_PRIu32 "\n", fValid ? "valid" : "invalid", fCount,
+		fSackedSegments, Pipe());
+	kprintf("    rack: end %" B_PRIu32 ", rtt %" B_PRIdBIGTIME ", min rtt %"
+		B_PRIdBIGTIME "%s\n", fRackEnd.Number(), fRackRoundTrip,
+		fMinRoundTrip, fReordering ? ", reordering" : "");
+
+	for (uint32 i = 0; i < fCount; i++) {
+		const Segment& segment = _SegmentAt(i);
+		if ((segment.flags & SEGMENT_REMOVED) != 0)
+			continue;
+
+		kprintf("      %" B_PRIu32 " - %" B_PRIu32 ", sent %" B_PRIdBIGTIME
+			"%s%s%s\n", segment.start.Number(), segment.end.Number(),
+			segment.time,
+			(segment.flags & SEGMENT_SACKED) != 0 ? ", sacked" : "",
+			(segment.flags & SEGMENT_LOST) != 0 ? ", lost" : "",
+			(segment.flags & SEGMENT_RETRANSMITTED) != 0
+				? ", retransmitted" : "");
+	}
+}
+
+
+/*!	Makes room for more records, dropping the removed ones on the way.
+*/
+bool
+SackScoreboard::_Grow()
+{
+	uint32 used = 0;
+	for (uint32 i = 0; i < fCount; i++) {
+		if ((_SegmentAt(i).flags & SEGMENT_REMOVED) == 0)
+			used++;
+	}
+
+	uint32 capacity = fCapacity;
+	if (capacity == 0)
+		capacity = kInitialCapacity;
+	else if (used * 2 > capacity)
+		capacity *= 2;
+	if (capacity > kMaxCapacity) {
+		if (used == fCapacity)
+			return false;
+		capacity = fCapacity;
+	}
+
+	Segment* segments = (Segment*)malloc(capacity * sizeof(Segment));
+	if (segments == NULL)
+		return false;
+
+	uint32 count = 0;
+	for (uint32 i = 0; i < fCount; i++) {
+		const Segment& segment = _SegmentAt(i);
+		if ((segment.flags & SEGMENT_REMOVED) == 0)
+			segments[count++] = segment;
+	}
+
+	free(fSegments);
+	fSegments = segments;
+	fCapacity = capacity;
+	fFirst = 0;
+	fCount = count;
+	return true;
+}
+
+
+/*!	Splits the record that contains the range from \a start to \a end, and
+	extends beyond it on both sides, into one record before, and one after
+	the range. The second one is inserted right behind the first, to keep
+	the records ordered by their transmit time.
+	Returns \c false if there was no room for another record.
+*/
+bool
+SackScoreboard::_Split(tcp_sequence start, tcp_sequence end)
+{
+	for (uint32 i = 0; i < fCount; i++) {
+		Segment& segment = _SegmentAt(i);
+		if ((segment.flags & SEGMENT_REMOVED) != 0
+			|| segment.start >= start || segment.end <= end)
+			continue;
+
+		if (fCount == fCapacity) {
+			// growing drops the removed records, so the index changes
+			if (!_Grow())
+				return false;
+			return _Split(start, end);
+		}
+
+		for (uint32 j = fCount; j > i + 1; j--)
+			_SegmentAt(j) = _SegmentAt(j - 1);
+		fCount++;
+
+		Segment& tail = _SegmentAt(i + 1);
+		tail = segment;
+		tail.start = end;
+		segment.end = start;
+
+		if ((segment.flags & SEGMENT_SACKED) != 0)
+			fSackedSegments++;
+		return true;
+	}
+
+	return true;
+}
+
+
+/*!	Updates the RACK state with the delivery of \a segment.
+*/
+void
+SackScoreboard::_Delivered(Segment& segment, bigtime_t now,
+	bigtime_t echoedTime)
+{
+	bigtime_t roundTrip = now - segment.time;
+
+	if ((segment.flags & SEGMENT_RETRANSMITTED) != 0) {
+		// the ACK might have been triggered by an earlier transmission
+		if ((echoedTime >= 0
+				&& echoedTime + kTimestampResolution < segment.time)
+			|| roundTrip < fMinRoundTrip)
+			return;
+	} else {
+		if (fMinRoundTrip == 0 || roundTrip < fMinRoundTrip)
+			fMinRoundTrip = roundTrip;
+		if (fRackTime != 0 && segment.end < fRackEnd)
+			fReordering = true;
+	}
+
+	if (segment.time > fRackTime
+		|| (segment.time == fRackTime && segment.end > fRackEnd)) {
+		fRackTime = segment.time;
+		fRackEnd = segment.end;
+		fRackRoundTrip = roundTrip;
+	}
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef SACK_SCOREBOARD_H
+#define SACK_SCOREBOARD_H
+
+
+#include "tcp.h"
+
+
+/*!	The sender side SACK scoreboard (RFC 6675) of a TCP connection.
+
+	It keeps a record of every segment sent from the send queue that has not
+	been cumulatively acknowledged yet, in the order they were transmitted.
+	The records are marked as the peer selectively acknowledges them, and
+	carry their transmit time, so that losses can be detected by time as
+	described by RACK (RFC 8985), instead of by counting duplicate ACKs.
+
+	If a segment cannot be recorded, the scoreboard becomes invalid until it
+	is cleared, ie. when all outstanding data has been acknowledged.
+*/
+class SackScoreboard {
+public:
+								SackScoreboard();
+								~SackScoreboard();
+
+			void				Clear();
+			void				Invalidate();
+			bool				IsValid() const { return fValid; }
+			bool				IsEmpty() const { return fCount == 0; }
+
+			void				SegmentSent(tcp_sequence start,
+									tcp_sequence end, bigtime_t time,
+									bool retransmit);
+			bool				Acknowledge(tcp_sequence acknowledge,
+									const tcp_sack* sacks, int32 sackCount,
+									tcp_sequence sendMax, bigtime_t now,
+									bigtime_t echoedTime);
+			bool				DetectLosses(bigtime_t now,
+									bigtime_t smoothedRoundTripTime,
+									bool recovery, bigtime_t& _timeout);
+
+			bool				NextLost(tcp_sequence& _start) const;
+			uint32				HoleLength(tcp_sequence start) const;
+			uint32				Pipe() const;
+			uint32				SackedSegments() const
+									{ return fSackedSegments; }
+			bigtime_t			RackRoundTripTime() const
+									{ return fRackRoundTrip; }
+
+			void				Dump() const;
+
+private:
+			struct Segment {
+				tcp_sequence	start;
+				tcp_sequence	end;
+				bigtime_t		time;
+				uint32			flags;
+			};
+
+			Segment&			_SegmentAt(uint32 index) const
+									{ return fSegments[(fFirst + index)
+										% fCapacity]; }
+			bool				_Grow();
+			bool				_Split(tcp_sequence start, tcp_sequence end);
+			void				_Delivered(Segment& segment, bigtime_t now,
+									bigtime_t echoedTime);
+
+private:
+			Segment*			fSegments;
+			uint32				fCapacity;
+			uint32				fFirst;
+			uint32				fCount;
+			uint32				fSackedSegments;
+			bool				fValid;
+
+			// RACK state
+			bigtime_t			fRackTime;
+			tcp_sequence		fRackEnd;
+			bigtime_t			fRackRoundTrip;
+			bigtime_t			fMinRoundTrip;
+			bool				fReordering;
+};
+
+
+#endif	// SACK_SCOREBOARD_H
@@ -41,6 +41,12 @@
 //	- RFC 793 - Transmission Control Protocol
 //	- RFC 813 - Window and Acknowledgement Strategy in TCP
 //	- RFC 1337 - TIME_WAIT Assassination Hazards in TCP
+//	- RFC 2018 - TCP Selective Acknowledgment Options
+//	- RFC 6675 - A Conservative Loss Recovery Algorithm Based on Selective
+//	  Acknowledgment (SACK) for TCP
+//	- RFC 8985 - The RACK-TLP Loss Detection Algorithm for TCP
+//	- RFC 9438 - CUBIC for Fast and Long-Distance Networks
+//	- draft-cardwell-iccrg-bbr-congestion-control - BBR Congestion Control
 //
 // Things this implementation currently doesn't implement:
 //	- TCP Slow Start, Congestion Avoidance, Fast Retransmit, and Fast Recovery,
@@ -48,7 +54,7 @@
 //	- NewReno Modification to TCP's Fast Recovery, RFC 2582
 //	- Explicit Congestion Notification (ECN), RFC 3168
 //	- SYN-Cache
-//	- SACK, Selective Acknowledgment - RFC 2018, RFC 2883, RFC 3517
+//	- Duplicate SACK (D-SACK), RFC 2883
 //	- Forward RTO-Recovery, RFC 4138
 //	- Time-Wait hash instead of keeping sockets alive
 //
@@ -319,12 +325,17 @@ enum {
 	FLAG_CLOSED					= 0x08,
 	FLAG_DELETE_ON_CLOSE		= 0x10,
 	FLAG_LOCAL					= 0x20,
-	FLAG_RECOVERY				= 0x40
+	FLAG_RECOVERY				= 0x40,
+	FLAG_OPTION_SACK_PERMITTED	= 0x80,
+	FLAG_SACK_RECOVERY			= 0x100,
+	FLAG_LOSS_PROBE				= 0x200
 };
 
 
 static const int kTimestampFactor = 1000;
 	// conversion factor between usec system time and msec tcp time
+static const bigtime_t kPacingBurst = 1000;
+	// how much a paced connection may catch up at once after a delay
 
 
 static inline bigtime_t
@@ -447,11 +458,16 @@ TCPEndpoint::TCPEndpoint(net_socket* socket)
 	fSendTime(0),
 	fRoundTripStartSequence(0),
 	fRetransmitTimeout(TCP_INITIAL_RTT),
+	fMinRoundTripTime(0),
 	fReceivedTimestamp(0),
 	fCongestionWindow(0),
 	fSlowStartThreshold(0),
+	fCongestionControl(NULL),
+	fPacingTime(0),
+	fRetransmittedSegments(0),
 	fState(CLOSED),
-	fFlags(FLAG_OPTION_WINDOW_SCALE | FLAG_OPTION_TIMESTAMP)
+	fFlags(FLAG_OPTION_WINDOW_SCALE | FLAG_OPTION_TIMESTAMP
+		| FLAG_OPTION_SACK_PERMITTED)
 {
 	// TODO: to be replaced with a real read/write locking strategy!
 	mutex_init(&fLock, "tcp lock");
@@ -466,6 +482,14 @@ TCPEndpoint::TCPEndpoint(net_socket* socket)
 		TCPEndpoint::_DelayedAcknowledgeTimer, this);
 	gStackModule->init_timer(&fTimeWaitTimer, TCPEndpoint::_TimeWaitTimer,
 		this);
+	gStackModule->init_timer(&fReorderTimer, TCPEndpoint::_ReorderTimer,
+		this);
+	gStackModule->init_timer(&fLossProbeTimer, TCPEndpoint::_LossProbeTimer,
+		this);
+	gStackModule->init_timer(&fPacingTimer, TCPEndpoint::_PacingTimer, this);
+
+	create_congestion_control(NULL, fCongestionWindow, fSlowStartThreshold,
+		&fCongestionControl);
 
 	T(APICall(this, "constructor"));
 }
@@ -493,6 +517,11 @@ TCPEndpoint::~TCPEndpoint()
 	gStackModule->wait_for_timer(&fPersistTimer);
 	gStackModule->wait_for_timer(&fDelayedAcknowledgeTimer);
 	gStackModule->wait_for_timer(&fTimeWaitTimer);
+	gStackModule->wait_for_timer(&fReorderTimer);
+	gStackModule->wait_for_timer(&fLossProbeTimer);
+	gStackModule->wait_for_timer(&fPacingTimer);
+
+	delete fCongestionControl;
 
 	gDatalinkModule->put_route(Domain(), fRoute);
 }
@@ -501,6 +530,9 @@ TCPEndpoint::~TCPEndpoint()
 status_t
 TCPEndpoint::InitCheck() const
 {
+	if (fCongestionControl == NULL)
+		return B_NO_MEMORY;
+
 	return B_OK;
 }
 
@@ -1051,6 +1083,28 @@ TCPEndpoint::SetReceiveBufferSize(size_t length)
 status_t
 TCPEndpoint::GetOption(int option, void* _value, int* _length)
 {
+	if (option == TCP_INFO) {
+		if (*_length <= 0)
+			return B_BAD_VALUE;
+
+		struct tcp_info info;
+		MutexLocker _(fLock);
+		_FillInfo(&info);
+
+		*_length = min_c(*_length, (int)sizeof(info));
+		memcpy(_value, &info, *_length);
+		return B_OK;
+	}
+	if (option == TCP_CONGESTION) {
+		if (*_length <= 0)
+			return B_BAD_VALUE;
+
+		MutexLocker _(fLock);
+		*_length = min_c(*_length, TCP_CA_NAME_MAX);
+		strlcpy((char*)_value, fCongestionControl->Name(), *_length);
+		return B_OK;
+	}
+
 	if (*_length != sizeof(int))
 		return B_BAD_VALUE;
 
@@ -1077,6 +1131,21 @@ TCPEndpoint::GetOption(int option, void* _value, int* _length)
 status_t
 TCPEndpoint::SetOption(int option, const void* _value, int length)
 {
+	if (option == TCP_CONGESTION) {
+		if (length <= 0)
+			return B_BAD_VALUE;
+
+		// the name does not need to be null terminated
+		char name[TCP_CA_NAME_MAX];
+		size_t nameLength = strnlen((const char*)_value,
+			min_c((size_t)length, sizeof(name) - 1));
+		memcpy(name, _value, nameLength);
+		name[nameLength] = '\0';
+
+		MutexLocker _(fLock);
+		return _SetCongestionControl(name);
+	}
+
 	if (option != TCP_NODELAY)
 		return B_BAD_VALUE;
 
@@ -1180,6 +1249,12 @@ TCPEndpoint::_CancelConnectionTimers()
 	T(TimerSet(this, "persist", -1));
 	gStackModule->cancel_timer(&fDelayedAcknowledgeTimer);
 	T(TimerSet(this, "delayed ack", -1));
+	gStackModule->cancel_timer(&fReorderTimer);
+	T(TimerSet(this, "reorder", -1));
+	gStackModule->cancel_timer(&fLossProbeTimer);
+	T(TimerSet(this, "loss probe", -1));
+	gStackModule->cancel_timer(&fPacingTimer);
+	T(TimerSet(this, "pacing", -1));
 }
 
 
@@ -1283,6 +1358,18 @@ TCPEndpoint::_HandleReset(status_t error)
 void
 TCPEndpoint::_DuplicateAcknowledge(tcp_segment_header &segment)
 {
+	bool usesScoreboard = _UsesScoreboard()
+		&& (segment.sack_count > 0 || (fFlags & FLAG_SACK_RECOVERY) != 0);
+	if (usesScoreboard) {
+		// losses are detected by RACK, only limited transmit is left to do
+		_UpdateScoreboard(segment);
+		if ((fFlags & FLAG_SACK_RECOVERY) != 0) {
+			fDuplicateAcknowledgeCount++;
+			_SackRecovery();
+			return;
+		}
+	}
+
 	if (fDuplicateAcknowledgeCount == 0)
 		fPreviousFlightSize = (fSendMax - fSendUnacknowledged).Number();
 
@@ -1296,13 +1383,16 @@ TCPEndpoint::_DuplicateAcknowledge(tcp_segment_header &segment)
 		}
 	}
 
+	if (usesScoreboard)
+		return;
+
 	if (fDuplicateAcknowledgeCount == 3) {
 		if ((segment.acknowledge - 1) > fRecover || (fCongestionWindow > fSendMaxSegmentSize &&
 			(fSendUnacknowledged - fPreviousHighestAcknowledge) <= 4 * fSendMaxSegmentSize)) {
 			fFlags |= FLAG_RECOVERY;
 			fRecover = fSendMax.Number() - 1;
-			fSlowStartThreshold = max_c(fPreviousFlightSize / 2, 2 * fSendMaxSegmentSize);
-			fCongestionWindow = fSlowStartThreshold + 3 * fSendMaxSegmentSize;
+			fCongestionControl->EnterRecovery(fPreviousFlightSize);
+			fCongestionWindow += 3 * fSendMaxSegmentSize;
 			fSendNext = segment.acknowledge;
 			_SendQueued();
 			TRACE("_DuplicateAcknowledge(): packet sent under fast restransmit on the receipt of 3rd dup ack");
@@ -1319,6 +1409,222 @@ TCPEndpoint::_DuplicateAcknowledge(tcp_segment_header &segment)
 }
 
 
+inline bool
+TCPEndpoint::_UsesScoreboard() const
+{
+	return (fFlags & FLAG_OPTION_SACK_PERMITTED) != 0 && fScoreboard.IsValid();
+}
+
+
+/*!	Updates the scoreboard with the cumulative and selective acknowledgments
+	of \a segment, and checks for lost segments.
+	Returns \c true if the segment acknowledged any data for the first time.
+*/
+bool
+TCPEndpoint::_UpdateScoreboard(tcp_segment_header& segment)
+{
+	bigtime_t now = system_time();
+	bigtime_t echoedTime = -1;
+	if ((segment.options & TCP_HAS_TIMESTAMPS) != 0) {
+		echoedTime = now - (bigtime_t)tcp_diff_timestamp(
+			segment.timestamp_reply) * kTimestampFactor;
+	}
+
+	bool delivered = fScoreboard.Acknowledge(segment.acknowledge,
+		segment.sacks, segment.sack_count, fSendMax, now, echoedTime);
+	_DetectLosses();
+
+	return delivered;
+}
+
+
+/*!	Runs the RACK loss detection on the scoreboard, and enters SACK based
+	loss recovery when segments were lost.
+*/
+void
+TCPEndpoint::_DetectLosses()
+{
+	bigtime_t timeout;
+	bool lost = fScoreboard.DetectLosses(system_time(),
+		(bigtime_t)fSmoothedRoundTripTime * kTimestampFactor,
+		(fFlags & FLAG_RECOVERY) != 0, timeout);
+
+	if (timeout > 0) {
+		// some segments might just be reordered, check them again later
+		gStackModule->set_timer(&fReorderTimer, timeout);
+		T(TimerSet(this, "reorder", timeout));
+	} else
+		gStackModule->cancel_timer(&fReorderTimer);
+
+	if (!lost || (fFlags & FLAG_RECOVERY) != 0)
+		return;
+
+	TRACE("_DetectLosses(): entering SACK recovery, pipe %" B_PRIu32,
+		fScoreboard.Pipe());
+
+	fFlags |= FLAG_RECOVERY | FLAG_SACK_RECOVERY;
+	fRecover = fSendMax.Number() - 1;
+	fCongestionControl->EnterRecovery(
+		(fSendMax - fSendUnacknowledged).Number());
+
+	gStackModule->cancel_timer(&fLossProbeTimer);
+}
+
+
+/*!	Sends as much as the congestion window allows during SACK based loss
+	recovery: the lost segments first, then new data (RFC 6675).
+*/
+void
+TCPEndpoint::_SackRecovery()
+{
+	if (!fScoreboard.IsValid()) {
+		// leave the rest of the recovery to NewReno
+		fFlags &= ~FLAG_SACK_RECOVERY;
+		return;
+	}
+
+	while (fScoreboard.Pipe() + fSendMaxSegmentSize <= fCongestionWindow) {
+		tcp_sequence next;
+		if (!fScoreboard.NextLost(next)) {
+			if (fSendQueue.Available(fSendMax) == 0)
+				break;
+			next = fSendMax;
+		}
+
+		fSendNext = next;
+		if (_SendQueued() != B_OK || fSendNext == next)
+			break;
+	}
+
+	fSendNext = fSendMax;
+}
+
+
+/*!	Arms the tail loss probe timer, so that the loss of the last segments
+	sent is revealed by the peer's SACK information, rather than by the
+	retransmit timeout (RFC 8985).
+*/
+void
+TCPEndpoint::_ScheduleLossProbe()
+{
+	if ((fFlags & (FLAG_RECOVERY | FLAG_LOSS_PROBE)) != 0
+		|| !_UsesScoreboard() || fSmoothedRoundTripTime == 0
+		|| fSendUnacknowledged == fSendMax)
+		return;
+
+	bigtime_t timeout = 2 * (bigtime_t)fSmoothedRoundTripTime
+		* kTimestampFactor;
+	if ((fSendMax - fSendUnacknowledged).Number() <= fSendMaxSegmentSize) {
+		// the peer might delay its acknowledgment
+		timeout += TCP_DELAYED_ACKNOWLEDGE_TIMEOUT;
+	}
+	if (timeout >= fRetransmitTimeout)
+		return;
+
+	gStackModule->set_timer(&fLossProbeTimer, timeout);
+	T(TimerSet(this, "loss probe", timeout));
+}
+
+
+/*!	Sends a single segment to elicit an acknowledgment from the peer: new
+	data if possible, or else the last segment sent again.
+*/
+void
+TCPEndpoint::_SendLossProbe()
+{
+	if (fState < ESTABLISHED || fSendUnacknowledged == fSendMax
+		|| (fFlags & (FLAG_RECOVERY | FLAG_LOSS_PROBE)) != 0)
+		return;
+
+	TRACE("_SendLossProbe()");
+
+	fFlags |= FLAG_LOSS_PROBE;
+	tcp_sequence sendMax = fSendMax;
+	uint32 flightSize = (fSendMax - fSendUnacknowledged).Number();
+
+	if (fSendQueue.Available(fSendMax) != 0
+		&& fSendWindow >= flightSize + fSendMaxSegmentSize) {
+		fSendNext = fSendMax;
+		fCongestionWindow += fSendMaxSegmentSize;
+		_SendQueued();
+		fCongestionWindow -= fSendMaxSegmentSize;
+	}
+
+	if (fSendMax == sendMax) {
+		fSendNext = fSendMax - min_c(flightSize, fSendMaxSegmentSize);
+		_SendQueued();
+		fSendNext = fSendMax;
+	}
+
+	gStackModule->set_timer(&fRetransmitTimer, fRetransmitTimeout);
+	T(TimerSet(this, "retransmit", fRetransmitTimeout));
+}
+
+
+/*!	Replaces the congestion control algorithm of the connection by the one
+	called \a name. On an established connection, the new algorithm starts
+	out with the current window.
+*/
+status_t
+TCPEndpoint::_SetCongestionControl(const char* name)
+{
+	if (strcmp(name, fCongestionControl->Name()) == 0)
+		return B_OK;
+
+	CongestionControl* control;
+	status_t status = create_congestion_control(name, fCongestionWindow,
+		fSlowStartThreshold, &control);
+	if (status != B_OK)
+		return status;
+
+	if (fState >= ESTABLISHED)
+		control->Init(fSendMaxSegmentSize);
+
+	delete fCongestionControl;
+	fCongestionControl = control;
+	fPacingTime = 0;
+
+	return B_OK;
+}
+
+
+void
+TCPEndpoint::_FillInfo(struct tcp_info* info) const
+{
+	memset(info, 0, sizeof(*info));
+
+	// the tcp_state values match the public TCPS_* constants
+	info->tcpi_state = fState;
+	if ((fFlags & FLAG_OPTION_TIMESTAMP) != 0)
+		info->tcpi_options |= TCPI_OPT_TIMESTAMPS;
+	if ((fFlags & FLAG_OPTION_SACK_PERMITTED) != 0)
+		info->tcpi_options |= TCPI_OPT_SACK;
+	if ((fFlags & FLAG_OPTION_WINDOW_SCALE) != 0) {
+		info->tcpi_options |= TCPI_OPT_WSCALE;
+		info->tcpi_snd_wscale = fSendWindowShift;
+		info->tcpi_rcv_wscale = fReceiveWindowShift;
+	}
+
+	info->tcpi_rto = fRetransmitTimeout;
+	info->tcpi_rtt = fSmoothedRoundTripTime * kTimestampFactor;
+	info->tcpi_rttvar = fRoundTripVariation * kTimestampFactor;
+	info->tcpi_min_rtt = fMinRoundTripTime;
+	info->tcpi_snd_mss = fSendMaxSegmentSize;
+	info->tcpi_rcv_mss = fReceiveMaxSegmentSize;
+
+	info->tcpi_snd_cwnd = fCongestionWindow;
+	info->tcpi_snd_ssthresh = fSlowStartThreshold;
+	info->tcpi_snd_wnd = fSendWindow;
+	info->tcpi_rcv_wnd = (fReceiveMaxAdvertised - fReceiveNext).Number();
+	info->tcpi_unacked = (fSendMax - fSendUnacknowledged).Number();
+	info->tcpi_total_retrans = fRetransmittedSegments;
+
+	info->tcpi_pacing_rate = fCongestionControl->PacingRate();
+	strlcpy(info->tcpi_congestion, fCongestionControl->Name(),
+		sizeof(info->tcpi_congestion));
+}
+
+
 void
 TCPEndpoint::_UpdateTimestamps(tcp_segment_header& segment,
 	size_t segmentLength)
@@ -1370,6 +1676,7 @@ TCPEndpoint::_AddData(tcp_segment_header& segment, net_buffer* buffer)
 		fFinishReceivedAt = segment.sequence + buffer->size;
 	}
 
+	fLastSegmentReceived = segment.sequence;
 	fReceiveQueue.Add(buffer, segment.sequence);
 	fReceiveNext = fReceiveQueue.NextSequence();
 
@@ -1402,6 +1709,7 @@ TCPEndpoint::_PrepareReceivePath(tcp_segment_header& segment)
 
 	fReceiveNext = segment.sequence;
 	fReceiveQueue.SetInitialSequence(segment.sequence);
+	fLastSegmentReceived = segment.sequence;
 
 	if ((fOptions & TCP_NOOPT) == 0) {
 		if (segment.max_segment_size > 0)
@@ -1420,6 +1728,11 @@ TCPEndpoint::_PrepareReceivePath(tcp_segment_header& segment)
 			fReceivedTimestamp = segment.timestamp_value;
 		} else
 			fFlags &= ~FLAG_OPTION_TIMESTAMP;
+
+		if ((segment.options & TCP_SACK_PERMITTED) != 0)
+			fFlags |= FLAG_OPTION_SACK_PERMITTED;
+		else
+			fFlags &= ~FLAG_OPTION_SACK_PERMITTED;
 	}
 
 	if (fSendMaxSegmentSize > 2190)
@@ -1431,6 +1744,7 @@ TCPEndpoint::_PrepareReceivePath(tcp_segment_header& segment)
 
 	fSendMaxSegments = fCongestionWindow / fSendMaxSegmentSize;
 	fSlowStartThreshold = (uint32)segment.advertised_window << fSendWindowShift;
+	fCongestionControl->Init(fSendMaxSegmentSize);
 }
 
 
@@ -1476,6 +1790,10 @@ TCPEndpoint::_Spawn(TCPEndpoint* parent, tcp_segment_header& segment,
 
 	fOptions = parent->fOptions;
 	fAcceptSemaphore = parent->fAcceptSemaphore;
+	if (_SetCongestionControl(parent->fCongestionControl->Name()) != B_OK) {
+		T(Error(this, "congestion control failed", __LINE__));
+		return DROP;
+	}
 
 	_PrepareReceivePath(segment);
 
@@ -1740,12 +2058,12 @@ TCPEndpoint::_Receive(tcp_segment_header& segment, net_buffer* buffer)
 		} else {
 			// this segment acknowledges in flight data
 
-			if (fDuplicateAcknowledgeCount >= 3) {
+			if (fDuplicateAcknowledgeCount >= 3
+				&& (fFlags & FLAG_SACK_RECOVERY) == 0) {
 				// deflate the window.
 				if (segment.acknowledge > fRecover) {
-					uint32 flightSize = (fSendMax - fSendUnacknowledged).Number();
-					fCongestionWindow = min_c(fSlowStartThreshold,
-						max_c(flightSize, fSendMaxSegmentSize) + fSendMaxSegmentSize);
+					fCongestionControl->ExitRecovery(
+						(fSendMax - fSendUnacknowledged).Number());
 					fFlags &= ~FLAG_RECOVERY;
 				}
 			}
@@ -1796,6 +2114,12 @@ TCPEndpoint::_Receive(tcp_segment_header& segment, net_buffer* buffer)
 	// the size as we still need it later.
 	uint32 bufferSize = buffer->size;
 
+	// out of order data, and data that fills a hole, is acknowledged right
+	// away, so that the sender learns about the holes in time
+	if (bufferSize > 0 && (fReceiveNext != segment.sequence
+			|| !fReceiveQueue.IsContiguous()))
+		action |= IMMEDIATE_ACKNOWLEDGE;
+
 	if ((bufferSize > 0 || (segment.flags & TCP_FLAG_FINISH) != 0)
 		&& _ShouldReceive())
 		notify = _AddData(segment, buffer);
@@ -2032,6 +2356,8 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 				segment.options |= TCP_HAS_WINDOW_SCALE;
 				segment.window_shift = fReceiveWindowShift;
 			}
+			if ((fFlags & FLAG_OPTION_SACK_PERMITTED) != 0)
+				segment.options |= TCP_SACK_PERMITTED;
 		}
 	}
 
@@ -2047,6 +2373,15 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 
 	segment.acknowledge = fReceiveNext.Number();
 
+	// report the data we received out of order
+	tcp_sack sacks[TCP_MAX_SACK_BLOCKS];
+	if ((fFlags & FLAG_OPTION_SACK_PERMITTED) != 0
+		&& (fOptions & TCP_NOOPT) == 0 && !fReceiveQueue.IsContiguous()) {
+		segment.sacks = sacks;
+		segment.sack_count = fReceiveQueue.GetSackBlocks(sacks,
+			TCP_MAX_SACK_BLOCKS, fLastSegmentReceived);
+	}
+
 	// Process urgent data
 	if (fSendUrgentOffset > fSendNext) {
 		segment.flags |= TCP_FLAG_URGENT;
@@ -2058,7 +2393,8 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 		segment.urgent_offset = 0;
 	}
 
-	if (fCongestionWindow > 0 && fCongestionWindow < sendWindow)
+	if (fCongestionWindow > 0 && fCongestionWindow < sendWindow
+		&& (fFlags & FLAG_SACK_RECOVERY) == 0)
 		sendWindow = fCongestionWindow;
 
 	// fSendUnacknowledged
@@ -2084,10 +2420,20 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 	} else
 		sendWindow -= consumedWindow;
 
+	if ((fFlags & FLAG_SACK_RECOVERY) != 0) {
+		// during SACK based loss recovery, the congestion window limits the
+		// data in the network, rather than all unacknowledged data
+		uint32 pipe = fScoreboard.Pipe();
+		sendWindow = pipe < fCongestionWindow
+			? min_c(sendWindow, fCongestionWindow - pipe) : 0;
+	}
+
+	bool persistProbe = false;
 	if (force && sendWindow == 0 && fSendNext <= fSendQueue.LastSequence()) {
 		// send one byte of data to ask for a window update
 		// (triggered by the persist timer)
 		sendWindow = 1;
+		persistProbe = true;
 	}
 
 	uint32 length = min_c(fSendQueue.Available(fSendNext), sendWindow);
@@ -2098,6 +2444,14 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 		// send at most 1 SMSS of data when under limited transmit, fast transmit/recovery
 		length = min_c(length, fSendMaxSegmentSize);
 	}
+	if (retransmit && (fFlags & FLAG_SACK_RECOVERY) != 0) {
+		// don't retransmit what the peer already has
+		length = min_c(length, fScoreboard.HoleLength(fSendNext));
+	}
+
+	uint64 pacingRate = fCongestionControl->PacingRate();
+	bool sentData = false;
+	bool sentSegment = false;
 
 	do {
 		uint32 segmentMaxSize = fSendMaxSegmentSize
@@ -2121,6 +2475,27 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 			break;
 		}
 
+		// Don't send new data faster than the congestion control asks for.
+		// If the segment is needed anyway, for example to acknowledge data,
+		// it is sent without the data.
+		if (pacingRate != 0 && segmentLength > 0 && !retransmit
+			&& !persistProbe) {
+			bigtime_t now = system_time();
+			if (fPacingTime > now) {
+				gStackModule->set_timer(&fPacingTimer, fPacingTime - now);
+				T(TimerSet(this, "pacing", fPacingTime - now));
+
+				segment.flags &= ~(TCP_FLAG_FINISH | TCP_FLAG_PUSH);
+				if (sentSegment || (!force && !_ShouldSendSegment(segment, 0,
+						segmentMaxSize, flightSize))) {
+					break;
+				}
+
+				segmentLength = 0;
+				length = 0;
+			}
+		}
+
 		net_buffer *buffer = gBufferModule->create(256);
 		if (buffer == NULL)
 			return B_NO_MEMORY;
@@ -2165,9 +2540,15 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 		// for local connections as the answer is directly handled
 
 		if (segment.flags & TCP_FLAG_SYNCHRONIZE) {
-			segment.options &= ~TCP_HAS_WINDOW_SCALE;
+			segment.options &= ~(TCP_HAS_WINDOW_SCALE | TCP_SACK_PERMITTED);
 			segment.max_segment_size = 0;
 			size++;
+		} else if ((fFlags & FLAG_OPTION_SACK_PERMITTED) != 0
+			&& (size > 0 || (segment.flags & TCP_FLAG_FINISH) != 0)) {
+			fScoreboard.SegmentSent(segment.sequence,
+				segment.sequence + size
+					+ ((segment.flags & TCP_FLAG_FINISH) != 0 ? 1 : 0),
+				system_time(), retransmit);
 		}
 
 		if (segment.flags & TCP_FLAG_FINISH)
@@ -2194,6 +2575,13 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 			return status;
 		}
 
+		if (pacingRate != 0 && segmentLength > 0 && !retransmit) {
+			fPacingTime = max_c(fPacingTime, system_time() - kPacingBurst)
+				+ (bigtime_t)(segmentLength * 1000000ULL / pacingRate);
+		}
+		if (retransmit)
+			fRetransmittedSegments++;
+
 		if (fSendTime == 0 && !retransmit
 			&& (segmentLength != 0 || (segment.flags & TCP_FLAG_SYNCHRONIZE) !=0)) {
 			fSendTime = tcp_now();
@@ -2211,6 +2599,10 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 		if (segment.flags & TCP_FLAG_ACKNOWLEDGE)
 			fLastAcknowledgeSent = segment.acknowledge;
 
+		if (segmentLength != 0 && !retransmit)
+			sentData = true;
+		sentSegment = true;
+
 		length -= segmentLength;
 		segment.flags &= ~(TCP_FLAG_SYNCHRONIZE | TCP_FLAG_RESET
 			| TCP_FLAG_FINISH);
@@ -2220,6 +2612,9 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 
 	} while (length > 0);
 
+	if (sentData)
+		_ScheduleLossProbe();
+
 	return B_OK;
 }
 
@@ -2296,28 +2691,66 @@ TCPEndpoint::_Acknowledged(tcp_segment_header& segment)
 			fRecover = segment.acknowledge - 1;
 		}
 
-		// the acknowledgment of the SYN/ACK MUST NOT increase the size of the congestion window
-		if (fSendUnacknowledged != fInitialSendSequence) {
-			if (fCongestionWindow < fSlowStartThreshold)
-				fCongestionWindow += min_c(bytesAcknowledged, fSendMaxSegmentSize);
-			else {
-				uint32 increment = fSendMaxSegmentSize * fSendMaxSegmentSize;
+		fFlags &= ~FLAG_LOSS_PROBE;
+		if ((fFlags & FLAG_SACK_RECOVERY) != 0
+			&& fSendUnacknowledged > fRecover) {
+			// the loss recovery is complete
+			fFlags &= ~(FLAG_RECOVERY | FLAG_SACK_RECOVERY);
+			fCongestionControl->ExitRecovery(flightSize);
+			fDuplicateAcknowledgeCount = 0;
+		}
 
-				if (increment < fCongestionWindow)
-					increment = 1;
-				else
-					increment /= fCongestionWindow;
+		bool delivered = false;
+		if (_UsesScoreboard())
+			delivered = _UpdateScoreboard(segment);
 
-				fCongestionWindow += increment;
-			}
+		// the scoreboard has the more precise round trip time sample
+		bigtime_t roundTripTime = 0;
+		if (delivered)
+			roundTripTime = fScoreboard.RackRoundTripTime();
+
+		if (fFlags & FLAG_OPTION_TIMESTAMP) {
+			uint32 timestampRoundTrip
+				= tcp_diff_timestamp(segment.timestamp_reply);
+			_UpdateRoundTripTime(timestampRoundTrip,
+				expectedSamples > 0 ? expectedSamples : 1);
+			if (roundTripTime == 0)
+				roundTripTime = (bigtime_t)timestampRoundTrip * kTimestampFactor;
+		} else if (fSendTime != 0 && fRoundTripStartSequence < segment.acknowledge) {
+			uint32 sendRoundTrip = tcp_diff_timestamp(fSendTime);
+			_UpdateRoundTripTime(sendRoundTrip, 1);
+			if (roundTripTime == 0)
+				roundTripTime = (bigtime_t)sendRoundTrip * kTimestampFactor;
+			fSendTime = 0;
+		}
+
+		if (roundTripTime > 0
+			&& (fMinRoundTripTime == 0 || roundTripTime < fMinRoundTripTime))
+			fMinRoundTripTime = roundTripTime;
+
+		// the acknowledgment of the SYN/ACK MUST NOT increase the size of the congestion window
+		if (fSendUnacknowledged != fInitialSendSequence) {
+			tcp_ack_sample sample;
+			sample.now = system_time();
+			sample.bytes_acknowledged = bytesAcknowledged;
+			sample.flight_size = flightSize;
+			sample.round_trip_time = roundTripTime;
+			sample.smoothed_round_trip_time
+				= (bigtime_t)fSmoothedRoundTripTime * kTimestampFactor;
+			sample.acknowledge = segment.acknowledge;
+			sample.send_max = fSendMax;
+			sample.in_recovery = (fFlags & FLAG_RECOVERY) != 0;
+			fCongestionControl->Acknowledged(sample);
 
 			fSendMaxSegments = UINT32_MAX;
 		}
 
-		if ((fFlags & FLAG_RECOVERY) != 0) {
+		if ((fFlags & FLAG_SACK_RECOVERY) != 0)
+			_SackRecovery();
+		else if ((fFlags & FLAG_RECOVERY) != 0) {
 			fSendNext = fSendUnacknowledged;
 			_SendQueued();
-			fCongestionWindow -= bytesAcknowledged;
+			fCongestionWindow -= min_c(bytesAcknowledged, fCongestionWindow);
 
 			if (bytesAcknowledged > fSendMaxSegmentSize)
 				fCongestionWindow += fSendMaxSegmentSize;
@@ -2329,23 +2762,19 @@ TCPEndpoint::_Acknowledged(tcp_segment_header& segment)
 		if (fSendNext < fSendUnacknowledged)
 			fSendNext = fSendUnacknowledged;
 
-		if (fFlags & FLAG_OPTION_TIMESTAMP) {
-			_UpdateRoundTripTime(tcp_diff_timestamp(segment.timestamp_reply),
-				expectedSamples > 0 ? expectedSamples : 1);
-		} else if (fSendTime != 0 && fRoundTripStartSequence < segment.acknowledge) {
-			_UpdateRoundTripTime(tcp_diff_timestamp(fSendTime), 1);
-			fSendTime = 0;
-		}
-
 		if (fSendUnacknowledged == fSendMax) {
 			TRACE("all acknowledged, cancelling retransmission timer.");
 			gStackModule->cancel_timer(&fRetransmitTimer);
 			T(TimerSet(this, "retransmit", -1));
+			gStackModule->cancel_timer(&fReorderTimer);
+			gStackModule->cancel_timer(&fLossProbeTimer);
+			fScoreboard.Clear();
 		} else {
 			TRACE("data acknowledged, resetting retransmission timer to: %"
 				B_PRIdBIGTIME, fRetransmitTimeout);
 			gStackModule->set_timer(&fRetransmitTimer, fRetransmitTimeout);
 			T(TimerSet(this, "retransmit", fRetransmitTimeout));
+			_ScheduleLossProbe();
 		}
 
 		if (is_writable(fState)) {
@@ -2372,6 +2801,14 @@ TCPEndpoint::_Retransmit()
 	} else {
 		_ResetSlowStart();
 		fDuplicateAcknowledgeCount = 0;
+
+		// the SACK information is not reliable anymore, we go back to the
+		// first unacknowledged segment
+		fFlags &= ~(FLAG_SACK_RECOVERY | FLAG_LOSS_PROBE);
+		fScoreboard.Invalidate();
+		gStackModule->cancel_timer(&fReorderTimer);
+		gStackModule->cancel_timer(&fLossProbeTimer);
+
 		// Do exponential back off of the retransmit timeout
 		fRetransmitTimeout *= 2;
 		if (fRetransmitTimeout > TCP_MAX_RETRANSMIT_TIMEOUT)
@@ -2419,9 +2856,8 @@ TCPEndpoint::_UpdateRoundTripTime(int32 roundTripTime, int32 expectedSamples)
 void
 TCPEndpoint::_ResetSlowStart()
 {
-	fSlowStartThreshold = max_c((fSendMax - fSendUnacknowledged).Number() / 2,
-		2 * fSendMaxSegmentSize);
-	fCongestionWindow = fSendMaxSegmentSize;
+	fCongestionControl->RetransmitTimeout(
+		(fSendMax - fSendUnacknowledged).Number());
 }
 
 
@@ -2478,6 +2914,57 @@ TCPEndpoint::_DelayedAcknowledgeTimer(net_timer* timer, void* _endpoint)
 }
 
 
+/*static*/ void
+TCPEndpoint::_ReorderTimer(net_timer* timer, void* _endpoint)
+{
+	TCPEndpoint* endpoint = (TCPEndpoint*)_endpoint;
+	T(TimerTriggered(endpoint, "reorder"));
+
+	MutexLocker locker(endpoint->fLock);
+	if (!locker.IsLocked() || gStackModule->is_timer_active(timer))
+		return;
+
+	// the timer might not have been canceled early enough
+	if (endpoint->State() == CLOSED || !endpoint->_UsesScoreboard())
+		return;
+
+	endpoint->_DetectLosses();
+	if ((endpoint->fFlags & FLAG_SACK_RECOVERY) != 0)
+		endpoint->_SackRecovery();
+}
+
+
+/*static*/ void
+TCPEndpoint::_LossProbeTimer(net_timer* timer, void* _endpoint)
+{
+	TCPEndpoint* endpoint = (TCPEndpoint*)_endpoint;
+	T(TimerTriggered(endpoint, "loss probe"));
+
+	MutexLocker locker(endpoint->fLock);
+	if (!locker.IsLocked() || gStackModule->is_timer_active(timer))
+		return;
+
+	endpoint->_SendLossProbe();
+}
+
+
+/*static*/ void
+TCPEndpoint::_PacingTimer(net_timer* timer, void* _endpoint)
+{
+	TCPEndpoint* endpoint = (TCPEndpoint*)_endpoint;
+	T(TimerTriggered(endpoint, "pacing"));
+
+	MutexLocker locker(endpoint->fLock);
+	if (!locker.IsLocked() || gStackModule->is_timer_active(timer))
+		return;
+
+	if (endpoint->State() == CLOSED)
+		return;
+
+	endpoint->_SendQueued();
+}
+
+
 /*static*/ void
 TCPEndpoint::_TimeWaitTimer(net_timer* timer, void* _endpoint)
 {
@@ -2543,6 +3030,8 @@ TCPEndpoint::Dump() const
 #if DEBUG_BUFFER_QUEUE
 	fSendQueue.Dump();
 #endif
+	if ((fFlags & FLAG_OPTION_SACK_PERMITTED) != 0)
+		fScoreboard.Dump();
 	kprintf("    last acknowledge sent: %" B_PRIu32 "\n",
 		fLastAcknowledgeSent.Number());
 	kprintf("    initial sequence: %" B_PRIu32 "\n",
@@ -2563,10 +3052,16 @@ TCPEndpoint::Dump() const
 		fInitialReceiveSequence.Number());
 	kprintf("    duplicate acknowledge count: %" B_PRIu32 "\n",
 		fDuplicateAcknowledgeCount);
+	kprintf("    recover: %" B_PRIu32 "\n", fRecover);
 	kprintf("  smoothed round trip time: %" B_PRId32 " (deviation %" B_PRId32 ")\n",
 		fSmoothedRoundTripTime, fRoundTripVariation);
 	kprintf("  retransmit timeout: %" B_PRId64 "\n", fRetransmitTimeout);
 	kprintf("  congestion window: %" B_PRIu32 "\n", fCongestionWindow);
 	kprintf("  slow start threshold: %" B_PRIu32 "\n", fSlowStartThreshold);
+	kprintf("  congestion control: %s, pacing rate %" B_PRIu64 "\n",
+		fCongestionControl->Name(), fCongestionControl->PacingRate());
+	fCongestionControl->Dump();
+	kprintf("  min round trip time: %" B_PRIdBIGTIME ", retransmitted %"
+		B_PRIu32 "\n", fMinRoundTripTime, fRetransmittedSegments);
 }
 
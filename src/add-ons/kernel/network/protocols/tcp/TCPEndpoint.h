@@ -12,7 +12,9 @@
 
 
 #include "BufferQueue.h"
+#include "CongestionControl.h"
 #include "EndpointManager.h"
+#include "SackScoreboard.h"
 #include "tcp.h"
 
 #include <ProtocolUtilities.h>
@@ -109,12 +111,23 @@ private:
 			void		_UpdateRoundTripTime(int32 roundTripTime, int32 expectedSamples);
 			void		_ResetSlowStart();
 			void		_DuplicateAcknowledge(tcp_segment_header& segment);
+			bool		_UsesScoreboard() const;
+			bool		_UpdateScoreboard(tcp_segment_header& segment);
+			void		_DetectLosses();
+			void		_SackRecovery();
+			void		_ScheduleLossProbe();
+			void		_SendLossProbe();
+			status_t	_SetCongestionControl(const char* name);
+			void		_FillInfo(struct tcp_info* info) const;
 
 	static	void		_TimeWaitTimer(net_timer* timer, void* _endpoint);
 	static	void		_RetransmitTimer(net_timer* timer, void* _endpoint);
 	static	void		_PersistTimer(net_timer* timer, void* _endpoint);
 	static	void		_DelayedAcknowledgeTimer(net_timer* timer,
 							void* _endpoint);
+	static	void		_ReorderTimer(net_timer* timer, void* _endpoint);
+	static	void		_LossProbeTimer(net_timer* timer, void* _endpoint);
+	static	void		_PacingTimer(net_timer* timer, void* _endpoint);
 
 	static	status_t	_WaitForCondition(ConditionVariable& condition,
 							MutexLocker& locker, bigtime_t timeout);
@@ -153,6 +166,7 @@ private:
 	uint32			fDuplicateAcknowledgeCount;
 	uint32			fPreviousFlightSize;
 	uint32			fRecover;
+	SackScoreboard	fScoreboard;
 
 	net_route		*fRoute;
 		// TODO: don't use a net_route, but a net_route_info!!!
@@ -166,6 +180,7 @@ private:
 	bool			fFinishReceived;
 	tcp_sequence	fFinishReceivedAt;
 	tcp_sequence	fInitialReceiveSequence;
+	tcp_sequence	fLastSegmentReceived;
 
 	// round trip time and retransmit timeout computation
 	int32			fSmoothedRoundTripTime;
@@ -173,11 +188,15 @@ private:
 	uint32			fSendTime;
 	tcp_sequence	fRoundTripStartSequence;
 	bigtime_t		fRetransmitTimeout;
+	bigtime_t		fMinRoundTripTime;
 
 	uint32			fReceivedTimestamp;
 
 	uint32			fCongestionWindow;
 	uint32			fSlowStartThreshold;
+	CongestionControl* fCongestionControl;
+	bigtime_t		fPacingTime;
+	uint32			fRetransmittedSegments;
 
 	tcp_state		fState;
 	uint32			fFlags;
@@ -187,6 +206,9 @@ private:
 	net_timer		fPersistTimer;
 	net_timer		fDelayedAcknowledgeTimer;
 	net_timer		fTimeWaitTimer;
+	net_timer		fReorderTimer;
+	net_timer		fLossProbeTimer;
+	net_timer		fPacingTimer;
 };
 
 #endif	// TCP_ENDPOINT_H
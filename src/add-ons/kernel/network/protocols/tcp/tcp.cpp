@@ -152,7 +152,11 @@ add_options(tcp_segment_header &segment, uint8 *buffer, size_t bufferSize)
 			bump_option(option, length);
 			option->kind = TCP_OPTION_SACK;
 			option->length = 2 + sackCount * sizeof(tcp_sack);
-			memcpy(option->sack, segment.sacks, sackCount * sizeof(tcp_sack));
+			for (int i = 0; i < sackCount; i++) {
+				option->sack[i].left_edge = htonl(segment.sacks[i].left_edge);
+				option->sack[i].right_edge
+					= htonl(segment.sacks[i].right_edge);
+			}
 			bump_option(option, length);
 		}
 	}
@@ -218,6 +222,26 @@ process_options(tcp_segment_header &segment, net_buffer *buffer, size_t size)
 				if (option->length == 2 && size >= 2)
 					segment.options |= TCP_SACK_PERMITTED;
 				break;
+			case TCP_OPTION_SACK:
+			{
+				// the blocks are copied, as the options buffer is only
+				// temporary
+				if (segment.sacks == NULL || option->length > size
+					|| option->length < 2 + sizeof(tcp_sack))
+					break;
+
+				int count = (option->length - 2) / sizeof(tcp_sack);
+				if (count > TCP_MAX_SACK_BLOCKS)
+					count = TCP_MAX_SACK_BLOCKS;
+				for (int i = 0; i < count; i++) {
+					segment.sacks[i].left_edge
+						= ntohl(option->sack[i].left_edge);
+					segment.sacks[i].right_edge
+						= ntohl(option->sack[i].right_edge);
+				}
+				segment.sack_count = count;
+				break;
+			}
 		}
 
 		if (length < 0) {
@@ -695,6 +719,9 @@ tcp_receive_data(net_buffer* buffer)
 	segment.acknowledge = header.Acknowledge();
 	segment.advertised_window = header.AdvertisedWindow();
 	segment.urgent_offset = header.UrgentOffset();
+
+	tcp_sack sacks[TCP_MAX_SACK_BLOCKS];
+	segment.sacks = sacks;
 	process_options(segment, buffer, headerLength - sizeof(tcp_header));
 
 	bufferHeader.Remove(headerLength);
@@ -749,6 +776,7 @@ static status_t
 tcp_init()
 {
 	rw_lock_init(&sEndpointManagersLock, "endpoint managers");
+	init_congestion_control();
 
 	status_t status = gStackModule->register_domain_protocols(AF_INET,
 		SOCK_STREAM, 0,
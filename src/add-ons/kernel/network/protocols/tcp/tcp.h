@@ -226,6 +226,7 @@ enum tcp_option_kind {
 };
 
 #define TCP_MAX_WINDOW_SHIFT	14
+#define TCP_MAX_SACK_BLOCKS		4
 
 enum {
 	TCP_HAS_WINDOW_SCALE	= 1 << 0,
@@ -239,6 +240,7 @@ struct tcp_segment_header {
 		flags(_flags),
 		window_shift(0),
 		max_segment_size(0),
+		sacks(NULL),
 		sack_count(0),
 		options(0)
 	{}
@@ -365,13 +365,14 @@ datalink_send_routed_data(struct net_route* route, net_buffer* buffer)
 		TRACE("  local route\n");
 
 		// We set the interface address here, so the buffer is delivered
-		// directly to the domain in interfaces.cpp:device_consumer_thread()
+		// directly to the domain in device_interfaces.cpp:
+		// device_consumer_receive()
 		address->AcquireReference();
 		set_interface_address(buffer->interface_address, address);
 
 		// this one goes back to the domain directly
-		return fifo_enqueue_buffer(
-			&interface->DeviceInterface()->receive_queue, buffer);
+		return device_interface_enqueue_buffer(interface->DeviceInterface(),
+			buffer);
 	}
 
 	if ((route->flags & RTF_GATEWAY) != 0) {
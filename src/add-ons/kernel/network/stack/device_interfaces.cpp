@@ -36,38 +36,119 @@
 #endif
 
 
+static const size_t kReceiveQueueSize = 16 * 1024 * 1024;
+	// shared by all consumers of a device interface
+static const uint32 kMaxConsumers = 8;
+
 static mutex sLock;
 static DeviceInterfaceList sInterfaces;
 static uint32 sDeviceIndex;
 
 
-/*!	A service thread for each device interface. It just reads as many packets
-	as availabe, deframes them, and puts them into the receive queue of the
-	device interface.
+/*!	Distributes the buffers in \a buffers over the consumers of the
+	interface, keeping the buffers of a flow in order. The consumers are
+	handed all of their buffers at once.
+	The consumers share the byte budget of the interface, so that a single
+	flow can still use all of it. Buffers that do not fit into it anymore
+	are left in the list, and ENOBUFS is returned.
 */
 static status_t
-device_reader_thread(void* _interface)
+steer_buffers(net_device_interface* interface, struct list* buffers)
 {
-	net_device_interface* interface = (net_device_interface*)_interface;
+	struct list queues[kMaxConsumers];
+	for (uint32 i = 0; i < interface->consumer_count; i++)
+		list_init(&queues[i]);
+
+	struct list rejected;
+	list_init(&rejected);
+
+	// Concurrent readers may each exceed the budget by up to one batch
+	size_t queued = (size_t)atomic_get(&interface->queued_bytes);
+	size_t added = 0;
+
+	while (net_buffer* buffer
+			= (net_buffer*)list_remove_head_item(buffers)) {
+		if (queued + added + buffer->size > kReceiveQueueSize) {
+			list_add_item(&rejected, buffer);
+			continue;
+		}
+		added += buffer->size;
+
+		uint32 index = 0;
+		if (interface->consumer_count > 1)
+			index = flow_hash(buffer) % interface->consumer_count;
+		list_add_item(&queues[index], buffer);
+	}
+
+	atomic_add(&interface->queued_bytes, (int32)added);
+
+	for (uint32 i = 0; i < interface->consumer_count; i++) {
+		if (!list_is_empty(&queues[i])) {
+			fifo_enqueue_buffers(&interface->consumers[i].queue,
+				&queues[i]);
+		}
+	}
+
+	if (list_is_empty(&rejected))
+		return B_OK;
+
+	list_move_to_list(&rejected, buffers);
+	return ENOBUFS;
+}
+
+
+/*!	A service thread for each receive queue of a device interface. It just
+	reads as many packets as available, deframes them, and puts them into the
+	receive queues of the consumers of the device interface.
+*/
+static status_t
+device_reader_thread(void* _reader)
+{
+	net_device_reader* reader = (net_device_reader*)_reader;
+	net_device_interface* interface = reader->interface;
 	net_device* device = interface->device;
 	status_t status = B_OK;
 
 	while ((device->flags & IFF_UP) != 0) {
-		net_buffer* buffer;
-		status = device->module->receive_data(device, &buffer);
+		struct list buffers;
+		list_init(&buffers);
+
+		if (device->module->receive_queue_data != NULL) {
+			status = device->module->receive_queue_data(device, reader->queue,
+				&buffers);
+		} else {
+			net_buffer* buffer;
+			status = device->module->receive_data(device, &buffer);
+			if (status == B_OK)
+				list_add_item(&buffers, buffer);
+		}
+
 		if (status == B_OK) {
-			// feed device monitors
-			if (atomic_get(&interface->monitor_count) > 0)
-				device_interface_monitor_receive(interface, buffer);
+			struct list deframed;
+			list_init(&deframed);
 
-			ASSERT(buffer->interface_address == NULL);
+			while (net_buffer* buffer
+					= (net_buffer*)list_remove_head_item(&buffers)) {
+				// feed device monitors
+				if (atomic_get(&interface->monitor_count) > 0)
+					device_interface_monitor_receive(interface, buffer);
 
-			if (interface->deframe_func(interface->device, buffer) != B_OK) {
-				gNetBufferModule.free(buffer);
-				continue;
+				ASSERT(buffer->interface_address == NULL);
+
+				if (interface->deframe_func(interface->device, buffer)
+						!= B_OK) {
+					gNetBufferModule.free(buffer);
+					continue;
+				}
+
+				list_add_item(&deframed, buffer);
 			}
 
-			fifo_enqueue_buffer(&interface->receive_queue, buffer);
+			if (steer_buffers(interface, &deframed) != B_OK) {
+				while (net_buffer* buffer
+						= (net_buffer*)list_remove_head_item(&deframed))
+					gNetBufferModule.free(buffer);
+			}
 		} else if (status == B_DEVICE_NOT_FOUND) {
 				device_removed(device);
 		} else {
@@ -81,56 +162,75 @@ device_reader_thread(void* _interface)
 }
 
 
-static status_t
-device_consumer_thread(void* _interface)
+static void
+device_consumer_receive(net_device_interface* interface, net_buffer* buffer)
 {
-	net_device_interface* interface = (net_device_interface*)_interface;
 	net_device* device = interface->device;
-	net_buffer* buffer;
-
-	while (true) {
-		ssize_t status = fifo_dequeue_buffer(&interface->receive_queue, 0,
-			B_INFINITE_TIMEOUT, &buffer);
-		if (status != B_OK) {
-			if (status == B_INTERRUPTED)
-				continue;
-			break;
-		}
 
-		if (buffer->interface_address != NULL) {
-			// If the interface is already specified, this buffer was
-			// delivered locally.
-			if (buffer->interface_address->domain->module->receive_data(buffer)
-					== B_OK)
+	if (buffer->interface_address != NULL) {
+		// If the interface is already specified, this buffer was
+		// delivered locally.
+		if (buffer->interface_address->domain->module->receive_data(buffer)
+				== B_OK)
+			buffer = NULL;
+	} else {
+		sockaddr_dl& linkAddress = *(sockaddr_dl*)buffer->source;
+		int32 genericType = buffer->type;
+		int32 specificType = B_NET_FRAME_TYPE(linkAddress.sdl_type,
+			ntohs(linkAddress.sdl_e_type));
+
+		buffer->index = interface->device->index;
+
+		// Find handler for this packet
+
+		ReadLocker locker(interface->handler_lock);
+
+		DeviceHandlerList::Iterator iterator
+			= interface->receive_funcs.GetIterator();
+		while (buffer != NULL && iterator.HasNext()) {
+			net_device_handler* handler = iterator.Next();
+
+			// If the handler returns B_OK, it consumed the buffer - first
+			// handler wins.
+			if ((handler->type == genericType
+					|| handler->type == specificType)
+				&& handler->func(handler->cookie, device, buffer) == B_OK)
 				buffer = NULL;
-		} else {
-			sockaddr_dl& linkAddress = *(sockaddr_dl*)buffer->source;
-			int32 genericType = buffer->type;
-			int32 specificType = B_NET_FRAME_TYPE(linkAddress.sdl_type,
-				ntohs(linkAddress.sdl_e_type));
+		}
+	}
 
-			buffer->index = interface->device->index;
+	if (buffer != NULL)
+		gNetBufferModule.free(buffer);
+}
 
-			// Find handler for this packet
 
-			RecursiveLocker locker(interface->receive_lock);
+/*!	The consumer threads of a device interface, usually one per CPU. Each
+	takes all buffers out of its queue at once, and passes them on to the
+	protocol layer.
+*/
+static status_t
+device_consumer_thread(void* _consumer)
+{
+	net_device_consumer* consumer = (net_device_consumer*)_consumer;
+	net_device_interface* interface = consumer->interface;
 
-			DeviceHandlerList::Iterator iterator
-				= interface->receive_funcs.GetIterator();
-			while (buffer != NULL && iterator.HasNext()) {
-				net_device_handler* handler = iterator.Next();
+	while (true) {
+		struct list buffers;
+		list_init(&buffers);
 
-				// If the handler returns B_OK, it consumed the buffer - first
-				// handler wins.
-				if ((handler->type == genericType
-						|| handler->type == specificType)
-					&& handler->func(handler->cookie, device, buffer) == B_OK)
-					buffer = NULL;
-			}
+		ssize_t status = fifo_dequeue_buffers(&consumer->queue,
+			B_INFINITE_TIMEOUT, &buffers);
+		if (status < B_OK) {
+			if (status == B_INTERRUPTED)
+				continue;
+			break;
 		}
 
-		if (buffer != NULL)
-			gNetBufferModule.free(buffer);
+		atomic_add(&interface->queued_bytes, -(int32)status);
+
+		while (net_buffer* buffer
+				= (net_buffer*)list_remove_head_item(&buffers))
+			device_consumer_receive(interface, buffer);
 	}
 
 	return B_OK;
@@ -164,6 +264,21 @@ find_device_interface(const char* name)
 }
 
 
+static void
+delete_consumers(net_device_interface* interface)
+{
+	for (uint32 i = 0; i < interface->consumer_count; i++)
+		uninit_fifo(&interface->consumers[i].queue);
+
+	for (uint32 i = 0; i < interface->consumer_count; i++) {
+		status_t status;
+		wait_for_thread(interface->consumers[i].thread, &status);
+	}
+
+	delete[] interface->consumers;
+}
+
+
 static net_device_interface*
 allocate_device_interface(net_device* device, net_device_module_info* module)
 {
@@ -173,12 +288,7 @@ allocate_device_interface(net_device* device, net_device_module_info* module)
 
 	recursive_lock_init(&interface->receive_lock, "device interface receive");
 	recursive_lock_init(&interface->monitor_lock, "device interface monitors");
-
-	char name[128];
-	snprintf(name, sizeof(name), "%s receive queue", device->name);
-
-	if (init_fifo(&interface->receive_queue, name, 16 * 1024 * 1024) < B_OK)
-		goto error1;
+	rw_lock_init(&interface->handler_lock, "device interface handlers");
 
 	interface->device = device;
 	interface->up_count = 0;
@@ -188,14 +298,47 @@ allocate_device_interface(net_device* device, net_device_module_info* module)
 	interface->deframe_func = NULL;
 	interface->deframe_ref_count = 0;
 
-	snprintf(name, sizeof(name), "%s consumer", device->name);
+	interface->readers = NULL;
+	interface->reader_count = 0;
+	interface->queued_bytes = 0;
+
+	// spread the protocol processing over the CPUs
+	system_info info;
+	uint32 consumerCount = 1;
+	if (get_system_info(&info) == B_OK)
+		consumerCount = min_c(info.cpu_count, kMaxConsumers);
+
+	interface->consumers
+		= new(std::nothrow) net_device_consumer[consumerCount];
+	if (interface->consumers == NULL)
+		goto error1;
 
-	interface->reader_thread   = -1;
-	interface->consumer_thread = spawn_kernel_thread(device_consumer_thread,
-		name, B_DISPLAY_PRIORITY, interface);
-	if (interface->consumer_thread < B_OK)
-		goto error2;
-	resume_thread(interface->consumer_thread);
+	for (interface->consumer_count = 0;
+			interface->consumer_count < consumerCount;
+			interface->consumer_count++) {
+		net_device_consumer& consumer
+			= interface->consumers[interface->consumer_count];
+		consumer.interface = interface;
+
+		char name[128];
+		snprintf(name, sizeof(name), "%s receive queue %" B_PRIu32,
+			device->name, interface->consumer_count);
+
+		// the queues are limited by the interface's queued_bytes instead
+		if (init_fifo(&consumer.queue, name, 0) < B_OK)
+			goto error2;
+
+		snprintf(name, sizeof(name), "%s consumer %" B_PRIu32, device->name,
+			interface->consumer_count);
+
+		consumer.thread = spawn_kernel_thread(device_consumer_thread, name,
+			B_DISPLAY_PRIORITY, &consumer);
+		if (consumer.thread < B_OK) {
+			uninit_fifo(&consumer.queue);
+			goto error2;
+		}
+		resume_thread(consumer.thread);
+	}
 
 	// TODO: proper interface index allocation
 	device->index = ++sDeviceIndex;
@@ -205,8 +348,9 @@ allocate_device_interface(net_device* device, net_device_module_info* module)
 	return interface;
 
 error2:
-	uninit_fifo(&interface->receive_queue);
+	delete_consumers(interface);
 error1:
+	rw_lock_destroy(&interface->handler_lock);
 	recursive_lock_destroy(&interface->receive_lock);
 	recursive_lock_destroy(&interface->monitor_lock);
 	delete interface;
@@ -244,12 +388,22 @@ dump_device_interface(int argc, char** argv)
 		= (net_device_interface*)parse_expression(argv[1]);
 
 	kprintf("device:            %p\n", interface->device);
-	kprintf("reader_thread:     %" B_PRId32 "\n", interface->reader_thread);
+	kprintf("readers:\n");
+	for (uint32 i = 0; i < interface->reader_count; i++) {
+		kprintf("  queue %" B_PRIu32 ": thread %" B_PRId32 "\n", i,
+			interface->readers[i].thread);
+	}
 	kprintf("up_count:          %" B_PRIu32 "\n", interface->up_count);
 	kprintf("ref_count:         %" B_PRId32 "\n", interface->ref_count);
 	kprintf("deframe_func:      %p\n", interface->deframe_func);
 	kprintf("deframe_ref_count: %" B_PRId32 "\n", interface->ref_count);
-	kprintf("consumer_thread:   %" B_PRId32 "\n", interface->consumer_thread);
+	kprintf("queued_bytes:      %" B_PRId32 "\n", interface->queued_bytes);
+	kprintf("consumers:\n");
+	for (uint32 i = 0; i < interface->consumer_count; i++) {
+		net_device_consumer& consumer = interface->consumers[i];
+		kprintf("  thread %" B_PRId32 ", queue %p, %" B_PRIuSIZE " bytes\n",
+			consumer.thread, &consumer.queue, consumer.queue.current_bytes);
+	}
 
 	kprintf("monitor_count:     %" B_PRId32 "\n", interface->monitor_count);
 	kprintf("monitor_lock:      %p\n", &interface->monitor_lock);
@@ -260,7 +414,7 @@ dump_device_interface(int argc, char** argv)
 		kprintf("  %p\n", monitorIterator.Next());
 
 	kprintf("receive_lock:      %p\n", &interface->receive_lock);
-	kprintf("receive_queue:     %p\n", &interface->receive_queue);
+	kprintf("handler_lock:      %p\n", &interface->handler_lock);
 	kprintf("receive_funcs:\n");
 	DeviceHandlerList::Iterator handlerIterator
 		= interface->receive_funcs.GetIterator();
@@ -384,9 +538,7 @@ put_device_interface(struct net_device_interface* interface)
 	sInterfaces.Remove(interface);
 	locker.Unlock();
 
-	uninit_fifo(&interface->receive_queue);
-	status_t status;
-	wait_for_thread(interface->consumer_thread, &status);
+	delete_consumers(interface);
 
 	net_device* device = interface->device;
 	const char* moduleName = device->module->info.name;
@@ -394,6 +546,7 @@ put_device_interface(struct net_device_interface* interface)
 	device->module->uninit_device(device);
 	put_module(moduleName);
 
+	rw_lock_destroy(&interface->handler_lock);
 	recursive_lock_destroy(&interface->monitor_lock);
 	recursive_lock_destroy(&interface->receive_lock);
 	delete interface;
@@ -499,6 +652,23 @@ device_interface_monitor_receive(net_device_interface* interface,
 }
 
 
+/*!	Waits for the reader threads to quit, and deletes them. The device must
+	no longer be up.
+*/
+static void
+delete_readers(net_device_interface* interface)
+{
+	for (uint32 i = 0; i < interface->reader_count; i++) {
+		status_t status;
+		wait_for_thread(interface->readers[i].thread, &status);
+	}
+
+	delete[] interface->readers;
+	interface->readers = NULL;
+	interface->reader_count = 0;
+}
+
+
 status_t
 up_device_interface(net_device_interface* interface)
 {
@@ -515,21 +685,57 @@ up_device_interface(net_device_interface* interface)
 	if (status != B_OK)
 		return status;
 
-	if (device->module->receive_data != NULL) {
-		// give the thread a nice name
-		char name[B_OS_NAME_LENGTH];
-		snprintf(name, sizeof(name), "%s reader", device->name);
+	uint32 readerCount = 0;
+	if (device->module->receive_queue_data != NULL
+		&& device->module->receive_queue_count != NULL)
+		readerCount = device->module->receive_queue_count(device);
+	else if (device->module->receive_data != NULL)
+		readerCount = 1;
+
+	if (readerCount > 0) {
+		interface->readers = new(std::nothrow) net_device_reader[readerCount];
+		if (interface->readers == NULL) {
+			device->module->down(device);
+			return B_NO_MEMORY;
+		}
+
+		for (uint32 i = 0; i < readerCount; i++) {
+			net_device_reader& reader = interface->readers[i];
+			reader.interface = interface;
+			reader.queue = i;
+
+			// give the thread a nice name
+			char name[B_OS_NAME_LENGTH];
+			if (readerCount == 1)
+				snprintf(name, sizeof(name), "%s reader", device->name);
+			else {
+				snprintf(name, sizeof(name), "%s reader %" B_PRIu32,
+					device->name, i);
+			}
 
-		interface->reader_thread = spawn_kernel_thread(device_reader_thread,
-			name, B_REAL_TIME_DISPLAY_PRIORITY - 10, interface);
-		if (interface->reader_thread < B_OK)
-			return interface->reader_thread;
+			reader.thread = spawn_kernel_thread(device_reader_thread, name,
+				B_REAL_TIME_DISPLAY_PRIORITY - 10, &reader);
+			if (reader.thread < B_OK) {
+				status = reader.thread;
+
+				// the readers spawned so far quit right away, as the device
+				// is not up
+				for (uint32 j = 0; j < interface->reader_count; j++)
+					resume_thread(interface->readers[j].thread);
+				delete_readers(interface);
+
+				device->module->down(device);
+				return status;
+			}
+
+			interface->reader_count++;
+		}
 	}
 
 	device->flags |= IFF_UP;
 
-	if (device->module->receive_data != NULL)
-		resume_thread(interface->reader_thread);
+	for (uint32 i = 0; i < interface->reader_count; i++)
+		resume_thread(interface->readers[i].thread);
 
 	interface->up_count = 1;
 	return B_OK;
@@ -559,13 +765,9 @@ down_device_interface(net_device_interface* interface)
 
 	notify_device_monitors(interface, B_DEVICE_GOING_DOWN);
 
-	if (device->module->receive_data != NULL) {
-		thread_id readerThread = interface->reader_thread;
-
-		// make sure the reader thread is gone before shutting down the interface
-		status_t status;
-		wait_for_thread(readerThread, &status);
-	}
+	// make sure the reader threads are gone before shutting down the
+	// interface
+	delete_readers(interface);
 }
 
 
@@ -648,6 +850,7 @@ register_device_handler(struct net_device* device, int32 type,
 		return B_DEVICE_NOT_FOUND;
 
 	RecursiveLocker _(interface->receive_lock);
+	WriteLocker handlerLocker(interface->handler_lock);
 
 	// see if such a handler already for this device
 
@@ -684,6 +887,7 @@ unregister_device_handler(struct net_device* device, int32 type)
 		return B_DEVICE_NOT_FOUND;
 
 	RecursiveLocker _(interface->receive_lock);
+	WriteLocker handlerLocker(interface->handler_lock);
 
 	// search for the handler
 
@@ -806,6 +1010,21 @@ device_removed(net_device* device)
 }
 
 
+/*!	Queues a buffer that was received on the interface, or that is to be
+	delivered locally, to the consumer responsible for its flow.
+*/
+status_t
+device_interface_enqueue_buffer(net_device_interface* interface,
+	net_buffer* buffer)
+{
+	struct list buffers;
+	list_init(&buffers);
+	list_add_item(&buffers, buffer);
+
+	return steer_buffers(interface, &buffers);
+}
+
+
 status_t
 device_enqueue_buffer(net_device* device, net_buffer* buffer)
 {
@@ -813,7 +1032,25 @@ device_enqueue_buffer(net_device* device, net_buffer* buffer)
 	if (interface == NULL)
 		return B_DEVICE_NOT_FOUND;
 
-	status_t status = fifo_enqueue_buffer(&interface->receive_queue, buffer);
+	status_t status = device_interface_enqueue_buffer(interface, buffer);
+
+	put_device_interface(interface);
+	return status;
+}
+
+
+/*!	Queues all buffers of the \a buffers list to the consumers of the
+	\a device at once. The buffers that could not be queued are left in
+	the list, and must be freed by the caller.
+*/
+status_t
+device_enqueue_buffers(net_device* device, struct list* buffers)
+{
+	net_device_interface* interface = get_device_interface(device->index);
+	if (interface == NULL)
+		return B_DEVICE_NOT_FOUND;
+
+	status_t status = steer_buffers(interface, buffers);
 
 	put_device_interface(interface);
 	return status;
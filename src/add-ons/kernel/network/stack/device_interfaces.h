@@ -26,9 +26,25 @@ typedef DoublyLinkedList<net_device_handler> DeviceHandlerList;
 typedef DoublyLinkedList<net_device_monitor,
 	DoublyLinkedListCLink<net_device_monitor> > DeviceMonitorList;
 
+struct net_device_interface;
+
+struct net_device_reader {
+	net_device_interface* interface;
+	uint32				queue;
+	thread_id			thread;
+};
+
+struct net_device_consumer {
+	net_device_interface* interface;
+	thread_id			thread;
+	net_fifo			queue;
+};
+
 struct net_device_interface : DoublyLinkedListLinkImpl<net_device_interface> {
 	struct net_device*	device;
-	thread_id			reader_thread;
+	net_device_reader*	readers;
+	uint32				reader_count;
+		// one reader for each receive queue of the device
 	uint32				up_count;
 		// a device can be brought up by more than one interface
 	int32				ref_count;
@@ -43,9 +59,14 @@ struct net_device_interface : DoublyLinkedListLinkImpl<net_device_interface> {
 
 	DeviceHandlerList	receive_funcs;
 	recursive_lock		receive_lock;
-
-	thread_id			consumer_thread;
-	net_fifo			receive_queue;
+	rw_lock				handler_lock;
+		// protects receive_funcs, the consumers only read lock it
+
+	net_device_consumer* consumers;
+	uint32				consumer_count;
+		// the received buffers are spread over the consumers by flow
+	int32				queued_bytes;
+		// the bytes in the queues of all consumers
 };
 
 typedef DoublyLinkedList<net_device_interface> DeviceInterfaceList;
@@ -63,6 +84,8 @@ struct net_device_interface* get_device_interface(const char* name,
 	bool create = true);
 void device_interface_monitor_receive(net_device_interface* interface,
 	net_buffer* buffer);
+status_t device_interface_enqueue_buffer(net_device_interface* interface,
+	net_buffer* buffer);
 status_t up_device_interface(net_device_interface* interface);
 void down_device_interface(net_device_interface* interface);
 
@@ -82,6 +105,7 @@ status_t unregister_device_monitor(struct net_device* device,
 status_t device_link_changed(net_device* device);
 status_t device_removed(net_device* device);
 status_t device_enqueue_buffer(net_device* device, net_buffer* buffer);
+status_t device_enqueue_buffers(net_device* device, struct list* buffers);
 
 status_t init_device_interfaces();
 status_t uninit_device_interfaces();
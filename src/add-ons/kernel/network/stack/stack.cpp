@@ -982,7 +982,9 @@ net_stack_module_info gNetStackModule = {
 	add_ancillary_data,
 	remove_ancillary_data,
 	move_ancillary_data,
-	next_ancillary_data
+	next_ancillary_data,
+
+	device_enqueue_buffers
 };
 
 module_info* modules[] = {
@@ -17,6 +17,11 @@
 #include <syscall_restart.h>
 #include <util/AutoLock.h>
 
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <string.h>
+
 #include "stack_private.h"
 
 
@@ -234,6 +239,106 @@ notify_socket(net_socket* socket, uint8 event, int32 value)
 }
 
 
+//	#pragma mark - Flow hashing
+
+
+// The default key of receive side scaling, so that the software hash matches
+// what hardware would compute for the same flow.
+static const uint8 kFlowHashKey[] = {
+	0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,
+	0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,
+	0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4,
+	0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,
+	0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa
+};
+
+
+/*!	Computes the Toeplitz hash over \a length bytes of \a data, as used by
+	receive side scaling.
+*/
+uint32
+toeplitz_hash(const uint8* data, size_t length)
+{
+	uint32 key = ((uint32)kFlowHashKey[0] << 24)
+		| ((uint32)kFlowHashKey[1] << 16) | ((uint32)kFlowHashKey[2] << 8)
+		| kFlowHashKey[3];
+	uint32 hash = 0;
+
+	for (size_t i = 0; i < length; i++) {
+		for (int32 bit = 7; bit >= 0; bit--) {
+			if ((data[i] & (1 << bit)) != 0)
+				hash ^= key;
+
+			key <<= 1;
+			if ((kFlowHashKey[i + 4] & (1 << bit)) != 0)
+				key |= 1;
+		}
+	}
+
+	return hash;
+}
+
+
+/*!	Returns a hash of the addresses, and for TCP and UDP also of the ports,
+	of the IP packet in \a buffer, or zero if it is no IP packet.
+	Fragments are only hashed by their addresses, so that they all end up
+	with the same consumer.
+*/
+uint32
+flow_hash(net_buffer* buffer)
+{
+	int family;
+	if (buffer->interface_address != NULL)
+		family = buffer->interface_address->domain->family;
+	else if (buffer->type == B_NET_FRAME_TYPE_IPV4)
+		family = AF_INET;
+	else if (buffer->type == B_NET_FRAME_TYPE_IPV6)
+		family = AF_INET6;
+	else
+		return 0;
+
+	uint8 tuple[2 * sizeof(in6_addr) + 2 * sizeof(uint16)];
+	size_t addressLength;
+	size_t headerLength;
+	uint8 protocol;
+
+	if (family == AF_INET) {
+		ip header;
+		if (gNetBufferModule.read(buffer, 0, &header, sizeof(header)) != B_OK)
+			return 0;
+
+		memcpy(tuple, &header.ip_src, sizeof(in_addr));
+		memcpy(tuple + sizeof(in_addr), &header.ip_dst, sizeof(in_addr));
+		addressLength = 2 * sizeof(in_addr);
+		headerLength = header.ip_hl << 2;
+		protocol = header.ip_p;
+
+		if ((ntohs(header.ip_off) & (IP_MF | IP_OFFMASK)) != 0)
+			protocol = IPPROTO_NONE;
+	} else if (family == AF_INET6) {
+		ip6_hdr header;
+		if (gNetBufferModule.read(buffer, 0, &header, sizeof(header)) != B_OK)
+			return 0;
+
+		memcpy(tuple, &header.ip6_src, sizeof(in6_addr));
+		memcpy(tuple + sizeof(in6_addr), &header.ip6_dst, sizeof(in6_addr));
+		addressLength = 2 * sizeof(in6_addr);
+		headerLength = sizeof(header);
+		protocol = header.ip6_nxt;
+			// extension headers are not followed
+	} else
+		return 0;
+
+	size_t length = addressLength;
+	if ((protocol == IPPROTO_TCP || protocol == IPPROTO_UDP)
+		&& gNetBufferModule.read(buffer, headerLength, tuple + addressLength,
+			2 * sizeof(uint16)) == B_OK)
+		length += 2 * sizeof(uint16);
+
+	return toeplitz_hash(tuple, length);
+}
+
+
 //	#pragma mark - FIFOs
 
 
@@ -361,6 +466,42 @@ fifo_enqueue_buffer(net_fifo* fifo, net_buffer* buffer)
 }
 
 
+/*!	Appends all buffers of the \a buffers list to the FIFO, and wakes up a
+	waiting reader only once for all of them. Buffers that don't fit into the
+	FIFO anymore are left in the list, and ENOBUFS is returned.
+*/
+status_t
+fifo_enqueue_buffers(net_fifo* fifo, struct list* buffers)
+{
+	MutexLocker locker(fifo->lock);
+
+	status_t status = B_OK;
+	bool added = false;
+
+	while (true) {
+		net_buffer* buffer = (net_buffer*)list_get_first_item(buffers);
+		if (buffer == NULL)
+			break;
+
+		if (fifo->max_bytes > 0
+			&& fifo->current_bytes + buffer->size > fifo->max_bytes) {
+			status = ENOBUFS;
+			break;
+		}
+
+		list_remove_item(buffers, buffer);
+		list_add_item(&fifo->buffers, buffer);
+		fifo->current_bytes += buffer->size;
+		added = true;
+	}
+
+	if (added)
+		fifo_notify_one_reader(fifo->waiting, fifo->notify);
+
+	return status;
+}
+
+
 /*!	Gets the first buffer from the FIFO. If there is no buffer, it
 	will wait depending on the \a flags and \a timeout.
 	The following flags are supported (the rest is ignored):
@@ -425,6 +566,38 @@ fifo_dequeue_buffer(net_fifo* fifo, uint32 flags, bigtime_t timeout,
 }
 
 
+/*!	Moves all buffers of the FIFO to the empty \a buffers list at once. If
+	there is no buffer, it will wait for one up to \a timeout.
+	Returns the number of bytes dequeued, or an error code.
+*/
+ssize_t
+fifo_dequeue_buffers(net_fifo* fifo, bigtime_t timeout, struct list* buffers)
+{
+	MutexLocker locker(fifo->lock);
+
+	while (list_is_empty(&fifo->buffers)) {
+		if (timeout == 0)
+			return B_WOULD_BLOCK;
+
+		fifo->waiting++;
+		locker.Unlock();
+
+		status_t status = acquire_sem_etc(fifo->notify, 1,
+			B_CAN_INTERRUPT | B_RELATIVE_TIMEOUT, timeout);
+		if (status < B_OK)
+			return status;
+
+		locker.Lock();
+	}
+
+	ssize_t bytes = fifo->current_bytes;
+	list_move_to_list(&fifo->buffers, buffers);
+	fifo->current_bytes = 0;
+
+	return bytes;
+}
+
+
 status_t
 clear_fifo(net_fifo* fifo)
 {
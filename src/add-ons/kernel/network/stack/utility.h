@@ -51,12 +51,19 @@ uint16		checksum(uint8* buffer, size_t length);
 // notifications
 status_t	notify_socket(net_socket* socket, uint8 event, int32 value);
 
+// flow hashing
+uint32		toeplitz_hash(const uint8* data, size_t length);
+uint32		flow_hash(net_buffer* buffer);
+
 // fifos
 status_t	init_fifo(net_fifo* fifo, const char *name, size_t maxBytes);
 void		uninit_fifo(net_fifo* fifo);
 status_t	fifo_enqueue_buffer(net_fifo* fifo, struct net_buffer* buffer);
+status_t	fifo_enqueue_buffers(net_fifo* fifo, struct list* buffers);
 ssize_t		fifo_dequeue_buffer(net_fifo* fifo, uint32 flags, bigtime_t timeout,
 				struct net_buffer** _buffer);
+ssize_t		fifo_dequeue_buffers(net_fifo* fifo, bigtime_t timeout,
+				struct list* buffers);
 status_t	clear_fifo(net_fifo* fifo);
 status_t	fifo_socket_enqueue_buffer(net_fifo* fifo, net_socket* socket,
 				uint8 event, net_buffer* buffer);
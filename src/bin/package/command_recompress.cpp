@@ -45,6 +45,7 @@ command_recompress(int argc, const char* const* argv)
 	bool quiet = false;
 	bool verbose = false;
 	int32 compressionLevel = BPackageKit::BHPKG::B_HPKG_COMPRESSION_LEVEL_BEST;
+	bool useZstd = false;
 
 	while (true) {
 		static struct option sLongOptions[] = {
@@ -55,7 +56,7 @@ command_recompress(int argc, const char* const* argv)
 		};
 
 		opterr = 0; // don't print errors
-		int c = getopt_long(argc, (char**)argv, "+0123456789:hqv",
+		int c = getopt_long(argc, (char**)argv, "+0123456789:hqvz",
 			sLongOptions, NULL);
 		if (c == -1)
 			break;
@@ -86,6 +87,10 @@ command_recompress(int argc, const char* const* argv)
 				verbose = true;
 				break;
 
+			case 'z':
+				useZstd = true;
+				break;
+
 			default:
 				print_usage_and_exit(true);
 				break;
@@ -122,6 +127,9 @@ command_recompress(int argc, const char* const* argv)
 	if (compressionLevel == 0) {
 		writerParameters.SetCompression(
 			BPackageKit::BHPKG::B_HPKG_COMPRESSION_NONE);
+	} else if (useZstd) {
+		writerParameters.SetCompression(
+			BPackageKit::BHPKG::B_HPKG_COMPRESSION_ZSTD);
 	}
 
 	PackageWriterListener listener(verbose, quiet);
@@ -62,7 +62,9 @@ BMediaEventLooper::BMediaEventLooper(uint32 apiVersion) :
 	fSchedulingLatency(0),
 	fBufferDuration(0),
 	fOfflineTime(0),
-	fApiVersion(apiVersion)
+	fApiVersion(apiVersion),
+	fDeadlineRuntime(0),
+	fDeadlinePeriod(0)
 {
 	CALLED();
 	fEventQueue.SetCleanupHook(BMediaEventLooper::_CleanUpEntry, this);
@@ -187,6 +189,10 @@ BMediaEventLooper::SetRunMode(run_mode mode)
 	}
 
 	BMediaNode::SetRunMode(mode);
+
+	// offline nodes don't need any guarantees
+	if (fDeadlineRuntime != 0)
+		_UpdateDeadline();
 }
 
 
@@ -375,6 +381,32 @@ BMediaEventLooper::SetPriority(int32 priority)
 }
 
 
+status_t
+BMediaEventLooper::SetDeadline(bigtime_t runtime, bigtime_t period)
+{
+	CALLED();
+
+	if (runtime < 0 || (runtime > 0 && (runtime > period
+			|| (bigtime_t)(uint32)period != period))) {
+		return B_BAD_VALUE;
+	}
+
+	uint32 oldRuntime = fDeadlineRuntime;
+	uint32 oldPeriod = fDeadlinePeriod;
+	fDeadlineRuntime = runtime;
+	fDeadlinePeriod = runtime > 0 ? period : 0;
+
+	status_t status = _UpdateDeadline();
+	if (status != B_OK) {
+		// the control thread keeps its previous parameters
+		fDeadlineRuntime = oldRuntime;
+		fDeadlinePeriod = oldPeriod;
+	}
+
+	return status;
+}
+
+
 void
 BMediaEventLooper::SetRunState(run_state state)
 {
@@ -436,6 +468,13 @@ BMediaEventLooper::Run()
 	char threadName[32];
 	sprintf(threadName, "%.20s control", Name());
 	fControlThread = spawn_thread(_ControlThreadStart, threadName, fCurrentPriority, this);
+
+	// fall back to the priority, if the deadline cannot be guaranteed
+	if (fDeadlineRuntime != 0 && _UpdateDeadline() != B_OK) {
+		ERROR("BMediaEventLooper: cannot schedule \"%s\" by deadline\n",
+			threadName);
+	}
+
 	resume_thread(fControlThread);
 
 	// get latency information
@@ -534,6 +573,21 @@ BMediaEventLooper::_DispatchCleanUp(const media_timed_event *event)
 		CleanUpEvent(event);
 }
 
+
+status_t
+BMediaEventLooper::_UpdateDeadline()
+{
+	if (fControlThread <= 0)
+		return B_OK;
+
+	bigtime_t runtime = RunMode() == B_OFFLINE ? 0 : fDeadlineRuntime;
+	status_t status = set_thread_deadline(fControlThread, runtime,
+		fDeadlinePeriod, fDeadlinePeriod);
+
+	fSchedulingLatency = estimate_max_scheduling_latency(fControlThread);
+	return status;
+}
+
 /*
 // unimplemented
 BMediaEventLooper::BMediaEventLooper(const BMediaEventLooper &)
@@ -20,6 +20,7 @@
 
 #include <AutoDeleter.h>
 #include <ZlibCompressionAlgorithm.h>
+#include <ZstdCompressionAlgorithm.h>
 
 #include <package/hpkg/DataReader.h>
 #include <package/hpkg/ErrorOutput.h>
@@ -326,6 +327,35 @@ WriterImplBase::InitHeapReader(size_t headerSize)
 				throw std::bad_alloc();
 			}
 			break;
+		case B_HPKG_COMPRESSION_ZSTD:
+		{
+			// zstd has a wider range of levels than zlib; map our "best" to
+			// zstd's best and pass the intermediate levels through
+			int32 compressionLevel = fParameters.CompressionLevel();
+			if (compressionLevel >= B_HPKG_COMPRESSION_LEVEL_BEST)
+				compressionLevel = B_ZSTD_COMPRESSION_BEST;
+
+			compressionAlgorithm = CompressionAlgorithmOwner::Create(
+				new(std::nothrow) BZstdCompressionAlgorithm,
+				new(std::nothrow) BZstdCompressionParameters(
+					compressionLevel));
+			compressionAlgorithmReference.SetTo(compressionAlgorithm, true);
+
+			decompressionAlgorithm = DecompressionAlgorithmOwner::Create(
+				new(std::nothrow) BZstdCompressionAlgorithm,
+				new(std::nothrow) BZstdDecompressionParameters);
+			decompressionAlgorithmReference.SetTo(decompressionAlgorithm, true);
+
+			if (compressionAlgorithm == NULL
+				|| compressionAlgorithm->algorithm == NULL
+				|| compressionAlgorithm->parameters == NULL
+				|| decompressionAlgorithm == NULL
+				|| decompressionAlgorithm->algorithm == NULL
+				|| decompressionAlgorithm->parameters == NULL) {
+				throw std::bad_alloc();
+			}
+			break;
+		}
 		default:
 			fErrorOutput->PrintError("Error: Invalid heap compression\n");
 			return B_BAD_VALUE;
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "arch_numa.h"
+
+#include <string.h>
+
+#include <KernelExport.h>
+
+#include <boot/stage2.h>
+#include <arch/x86/arch_acpi.h>
+
+
+//#define TRACE_NUMA
+#ifdef TRACE_NUMA
+#	define TRACE(x) dprintf x
+#else
+#	define TRACE(x) ;
+#endif
+
+
+static int32
+numa_node_for_domain(uint32 domain, uint32* domains)
+{
+	for (uint32 i = 0; i < gKernelArgs.num_numa_nodes; i++) {
+		if (domains[i] == domain)
+			return i;
+	}
+
+	if (gKernelArgs.num_numa_nodes == MAX_NUMA_NODES)
+		return -1;
+
+	domains[gKernelArgs.num_numa_nodes] = domain;
+	return gKernelArgs.num_numa_nodes++;
+}
+
+
+static void
+set_cpu_numa_node(uint32 apicID, int32 node)
+{
+	for (uint32 i = 0; i < gKernelArgs.num_cpus; i++) {
+		if (gKernelArgs.arch_args.cpu_apic_id[i] == apicID)
+			gKernelArgs.cpu_numa_node[i] = node;
+	}
+}
+
+
+/*!	Reads the NUMA topology from the ACPI \a srat, if there is one, into the
+	kernel args. The sparse proximity domains are mapped to node numbers in
+	the order they appear. The CPUs must have been detected already.
+*/
+void
+arch_numa_init(acpi_srat* srat)
+{
+	gKernelArgs.num_numa_nodes = 0;
+	gKernelArgs.num_numa_memory_ranges = 0;
+	memset(gKernelArgs.cpu_numa_node, 0, sizeof(gKernelArgs.cpu_numa_node));
+
+	if (srat == NULL) {
+		TRACE(("numa: no SRAT, assuming uniform memory access\n"));
+		return;
+	}
+
+	uint32 domains[MAX_NUMA_NODES];
+
+	acpi_apic *entry = (acpi_apic *)((uint8 *)srat + sizeof(acpi_srat));
+	acpi_apic *end = (acpi_apic *)((uint8 *)srat + srat->header.length);
+	while (entry < end && entry->length > 0) {
+		int32 node = 0;
+
+		switch (entry->type) {
+			case ACPI_SRAT_PROCESSOR_AFFINITY:
+			{
+				acpi_srat_processor_affinity *affinity
+					= (acpi_srat_processor_affinity *)entry;
+				if ((affinity->flags & ACPI_SRAT_ENTRY_ENABLED) == 0)
+					break;
+
+				uint32 domain = affinity->proximity_domain_low
+					| (affinity->proximity_domain_high[0] << 8)
+					| (affinity->proximity_domain_high[1] << 16)
+					| ((uint32)affinity->proximity_domain_high[2] << 24);
+				node = numa_node_for_domain(domain, domains);
+				if (node >= 0)
+					set_cpu_numa_node(affinity->apic_id, node);
+				break;
+			}
+
+			case ACPI_SRAT_X2_APIC_AFFINITY:
+			{
+				acpi_srat_x2_apic_affinity *affinity
+					= (acpi_srat_x2_apic_affinity *)entry;
+				if ((affinity->flags & ACPI_SRAT_ENTRY_ENABLED) == 0)
+					break;
+
+				node = numa_node_for_domain(affinity->proximity_domain,
+					domains);
+				if (node >= 0)
+					set_cpu_numa_node(affinity->x2apic_id, node);
+				break;
+			}
+
+			case ACPI_SRAT_MEMORY_AFFINITY:
+			{
+				acpi_srat_memory_affinity *affinity
+					= (acpi_srat_memory_affinity *)entry;
+				if ((affinity->flags & ACPI_SRAT_ENTRY_ENABLED) == 0
+					|| affinity->range_length == 0) {
+					break;
+				}
+
+				node = numa_node_for_domain(affinity->proximity_domain,
+					domains);
+				if (node < 0)
+					break;
+
+				uint32 index = gKernelArgs.num_numa_memory_ranges;
+				if (index == MAX_NUMA_MEMORY_RANGE) {
+					TRACE(("numa: too many NUMA memory ranges\n"));
+					node = -1;
+					break;
+				}
+
+				gKernelArgs.numa_memory_range[index].start
+					= affinity->base_address;
+				gKernelArgs.numa_memory_range[index].size
+					= affinity->range_length;
+				gKernelArgs.numa_memory_range_node[index] = node;
+				gKernelArgs.num_numa_memory_ranges++;
+				break;
+			}
+
+			default:
+				break;
+		}
+
+		if (node < 0) {
+			// we can't represent the topology correctly, so ignore it
+			dprintf("numa: unsupported NUMA topology, ignoring SRAT\n");
+			break;
+		}
+
+		entry = (acpi_apic *)((uint8 *)entry + entry->length);
+	}
+
+	if (entry < end || gKernelArgs.num_numa_nodes < 2) {
+		gKernelArgs.num_numa_nodes = 0;
+		gKernelArgs.num_numa_memory_ranges = 0;
+		memset(gKernelArgs.cpu_numa_node, 0,
+			sizeof(gKernelArgs.cpu_numa_node));
+		return;
+	}
+
+	dprintf("numa: %" B_PRIu32 " NUMA nodes with %" B_PRIu32
+		" memory ranges detected\n", gKernelArgs.num_numa_nodes,
+		gKernelArgs.num_numa_memory_ranges);
+}
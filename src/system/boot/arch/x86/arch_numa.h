@@ -0,0 +1,15 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef BOOT_ARCH_X86_NUMA_H
+#define BOOT_ARCH_X86_NUMA_H
+
+
+struct acpi_srat;
+
+
+void arch_numa_init(acpi_srat* srat);
+
+
+#endif	// BOOT_ARCH_X86_NUMA_H
@@ -25,6 +25,7 @@
 #include <arch/x86/arch_system_info.h>
 #include <arch/x86/descriptors.h>
 
+#include "arch_numa.h"
 #include "mmu.h"
 #include "acpi.h"
 
@@ -315,7 +316,11 @@ smp_do_acpi_config(void)
 		apic = (acpi_apic *)((uint8 *)apic + apic->length);
 	}
 
-	return gKernelArgs.num_cpus > 0 ? B_OK : B_ERROR;
+	if (gKernelArgs.num_cpus == 0)
+		return B_ERROR;
+
+	arch_numa_init((acpi_srat*)acpi_find_table(ACPI_SRAT_SIGNATURE));
+	return B_OK;
 }
 
 
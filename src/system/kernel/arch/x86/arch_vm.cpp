@@ -650,7 +650,8 @@ arch_vm_init_post_area(kernel_args *args)
 	TRACE(("arch_vm_init_post_area: entry\n"));
 
 	// account for DMA area and mark the pages unusable
-	vm_mark_page_range_inuse(0x0, 0xa0000 / B_PAGE_SIZE);
+	if (vm_mark_page_range_inuse(0x0, 0xa0000 / B_PAGE_SIZE) != B_OK)
+		panic("arch_vm_init_post_area: DMA region pages are already in use\n");
 
 	// map 0 - 0xa0000 directly
 	id = map_physical_memory("dma_region", 0x0, 0xa0000,
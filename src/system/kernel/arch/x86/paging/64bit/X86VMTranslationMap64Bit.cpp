@@ -71,7 +71,19 @@ X86VMTranslationMap64Bit::~X86VMTranslationMap64Bit()
 					if ((virtualPageDir[k] & X86_64_PDE_PRESENT) == 0)
 						continue;
 
-					address = virtualPageDir[k] & X86_64_PDE_ADDRESS_MASK;
+					if ((virtualPageDir[k] & X86_64_PDE_LARGE_PAGE) != 0) {
+						// The pages of a large page belong to the area's
+						// cache, only the page table it replaces is ours.
+						LargePageTable* table = fLargePageTables.Lookup(
+							(addr_t)i * k64BitPDPTRange
+								+ j * k64BitPageDirectoryRange
+								+ k * k64BitPageTableRange);
+						if (table == NULL)
+							continue;
+						address = table->page_table;
+					} else
+						address = virtualPageDir[k] & X86_64_PDE_ADDRESS_MASK;
+
 					page = vm_lookup_page(address / B_PAGE_SIZE);
 					if (page == NULL) {
 						panic("page table %u %u %u on invalid page %#"
@@ -107,6 +119,13 @@ X86VMTranslationMap64Bit::~X86VMTranslationMap64Bit()
 		fPageMapper->Delete();
 	}
 
+	LargePageTable* table = fLargePageTables.Clear(true);
+	while (table != NULL) {
+		LargePageTable* next = table->hash_link;
+		free_etc(table, LargePageTableAllocator::kAllocationFlags);
+		table = next;
+	}
+
 	fPagingStructures->RemoveReference();
 }
 
@@ -118,6 +137,10 @@ X86VMTranslationMap64Bit::Init(bool kernel)
 
 	X86VMTranslationMap::Init(kernel);
 
+	status_t error = fLargePageTables.Init();
+	if (error != B_OK)
+		return error;
+
 	fPagingStructures = new(std::nothrow) X86PagingStructures64Bit;
 	if (fPagingStructures == NULL)
 		return B_NO_MEMORY;
@@ -133,7 +156,7 @@ X86VMTranslationMap64Bit::Init(bool kernel)
 			method->KernelPhysicalPML4());
 	} else {
 		// Allocate a physical page mapper.
-		status_t error = method->PhysicalPageMapper()
+		error = method->PhysicalPageMapper()
 			->CreateTranslationMapPhysicalPageMapper(&fPageMapper);
 		if (error != B_OK)
 			return error;
@@ -199,9 +222,8 @@ X86VMTranslationMap64Bit::Map(addr_t virtualAddress, phys_addr_t physicalAddress
 
 	// Look up the page table for the virtual address, allocating new tables
 	// if required. Shouldn't fail.
-	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
-		fPagingStructures->VirtualPML4(), virtualAddress, fIsKernelMap,
-		true, reservation, fPageMapper, fMapCount);
+	uint64* entry = _PageTableEntryForAddress(virtualAddress, true, reservation,
+		false);
 	ASSERT(entry != NULL);
 
 	// The entry should not already exist.
@@ -235,9 +257,7 @@ X86VMTranslationMap64Bit::Unmap(addr_t start, addr_t end)
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
-		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
-			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
-			NULL, fPageMapper, fMapCount);
+		uint64* pageTable = _PageTableForAddress(start, false, NULL, true);
 		if (pageTable == NULL) {
 			// Move on to the next page table.
 			start = ROUNDUP(start + 1, k64BitPageTableRange);
@@ -285,9 +305,7 @@ X86VMTranslationMap64Bit::DebugMarkRangePresent(addr_t start, addr_t end,
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
-		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
-			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
-			NULL, fPageMapper, fMapCount);
+		uint64* pageTable = _PageTableForAddress(start, false, NULL, false);
 		if (pageTable == NULL) {
 			// Move on to the next page table.
 			start = ROUNDUP(start + 1, k64BitPageTableRange);
@@ -335,9 +353,7 @@ X86VMTranslationMap64Bit::UnmapPage(VMArea* area, addr_t address,
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	// Look up the page table for the virtual address.
-	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
-		fPagingStructures->VirtualPML4(), address, fIsKernelMap,
-		false, NULL, fPageMapper, fMapCount);
+	uint64* entry = _PageTableEntryForAddress(address, false, NULL, true);
 	if (entry == NULL)
 		return B_ENTRY_NOT_FOUND;
 
@@ -402,9 +418,7 @@ X86VMTranslationMap64Bit::UnmapPages(VMArea* area, addr_t base, size_t size,
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
-		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
-			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
-			NULL, fPageMapper, fMapCount);
+		uint64* pageTable = _PageTableForAddress(start, false, NULL, true);
 		if (pageTable == NULL) {
 			// Move on to the next page table.
 			start = ROUNDUP(start + 1, k64BitPageTableRange);
@@ -535,9 +549,8 @@ X86VMTranslationMap64Bit::UnmapArea(VMArea* area, bool deletingAddressSpace,
 			addr_t address = area->Base()
 				+ ((page->cache_offset * B_PAGE_SIZE) - area->cache_offset);
 
-			uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
-				fPagingStructures->VirtualPML4(), address, fIsKernelMap,
-				false, NULL, fPageMapper, fMapCount);
+			uint64* entry = _PageTableEntryForAddress(address, false, NULL,
+				true);
 			if (entry == NULL) {
 				panic("page %p has mapping for area %p (%#" B_PRIxADDR "), but "
 					"has no page table", page, area, address);
@@ -683,15 +696,15 @@ X86VMTranslationMap64Bit::Protect(addr_t start, addr_t end, uint32 attributes,
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
-		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
-			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
-			NULL, fPageMapper, fMapCount);
+		uint64* pageTable = _PageTableForAddress(start, false, NULL, false);
 		if (pageTable == NULL) {
 			// Move on to the next page table.
 			start = ROUNDUP(start + 1, k64BitPageTableRange);
 			continue;
 		}
 
+		addr_t tableAddress = ROUNDDOWN(start, k64BitPageTableRange);
+
 		for (uint32 index = start / B_PAGE_SIZE % k64BitTableEntryCount;
 				index < k64BitTableEntryCount && start < end;
 				index++, start += B_PAGE_SIZE) {
@@ -726,6 +739,21 @@ X86VMTranslationMap64Bit::Protect(addr_t start, addr_t end, uint32 attributes,
 				InvalidatePage(start);
 			}
 		}
+
+		// If the page table was backing a large page, try to map it as one
+		// again. That only works when the whole range got the new protection.
+		// The range is briefly unmapped for that, which kernel code that
+		// accesses it with interrupts disabled could not cope with, so the
+		// kernel keeps the small pages.
+		if (!fIsKernelMap && fLargePageTables.CountElements() != 0) {
+			RecursiveLocker locker(fLock);
+			if (fLargePageTables.Lookup(tableAddress) != NULL) {
+				_CollapseLargePage(tableAddress,
+					X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+						fPagingStructures->VirtualPML4(), tableAddress,
+						fIsKernelMap, false, NULL, fPageMapper, fMapCount));
+			}
+		}
 	} while (start != 0 && start < end);
 
 	return B_OK;
@@ -740,9 +768,7 @@ X86VMTranslationMap64Bit::ClearFlags(addr_t address, uint32 flags)
 
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
-	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
-		fPagingStructures->VirtualPML4(), address, fIsKernelMap,
-		false, NULL, fPageMapper, fMapCount);
+	uint64* entry = _PageTableEntryForAddress(address, false, NULL, false);
 	if (entry == NULL)
 		return B_OK;
 
@@ -771,9 +797,7 @@ X86VMTranslationMap64Bit::ClearAccessedAndModified(VMArea* area, addr_t address,
 	RecursiveLocker locker(fLock);
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
-	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
-		fPagingStructures->VirtualPML4(), address, fIsKernelMap,
-		false, NULL, fPageMapper, fMapCount);
+	uint64* entry = _PageTableEntryForAddress(address, false, NULL, false);
 	if (entry == NULL)
 		return false;
 
@@ -843,3 +867,221 @@ X86VMTranslationMap64Bit::PagingStructures() const
 {
 	return fPagingStructures;
 }
+
+
+size_t
+X86VMTranslationMap64Bit::LargePageSize() const
+{
+	return k64BitPageTableRange;
+}
+
+
+void
+X86VMTranslationMap64Bit::CollapseLargePages(addr_t start, addr_t end)
+{
+	RecursiveLocker locker(fLock);
+	ThreadCPUPinner pinner(thread_get_current_thread());
+
+	for (addr_t address = ROUNDUP(start, k64BitPageTableRange);
+			address >= start && address <= end
+				&& end - address >= k64BitPageTableRange - 1;
+			address += k64BitPageTableRange) {
+		uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+			fPagingStructures->VirtualPML4(), address, fIsKernelMap, false,
+			NULL, fPageMapper, fMapCount);
+		if (pde != NULL)
+			_CollapseLargePage(address, pde);
+	}
+}
+
+
+size_t
+X86VMTranslationMap64Bit::CountLargePages(addr_t start, addr_t end)
+{
+	ThreadCPUPinner pinner(thread_get_current_thread());
+
+	size_t count = 0;
+	for (addr_t address = ROUNDDOWN(start, k64BitPageTableRange);
+			address <= end; address += k64BitPageTableRange) {
+		uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+			fPagingStructures->VirtualPML4(), address, fIsKernelMap, false,
+			NULL, fPageMapper, fMapCount);
+		if (pde != NULL && (*pde & X86_64_PDE_PRESENT) != 0
+			&& (*pde & X86_64_PDE_LARGE_PAGE) != 0) {
+			count++;
+		}
+
+		if (address + k64BitPageTableRange < address)
+			break;
+	}
+
+	return count;
+}
+
+
+/*!	Returns the page table for \a virtualAddress, like
+	X86PagingMethod64Bit::PageTableForAddress() does, but splits a large page
+	covering the address first. If \a forgetLargePage is \c true, the page table
+	is no longer remembered as backing a large page, as the caller is going to
+	unmap pages from it.
+*/
+uint64*
+X86VMTranslationMap64Bit::_PageTableForAddress(addr_t virtualAddress,
+	bool allocateTables, vm_page_reservation* reservation,
+	bool forgetLargePage)
+{
+	if (fLargePageTables.CountElements() != 0) {
+		uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+			fPagingStructures->VirtualPML4(), virtualAddress, fIsKernelMap,
+			false, NULL, fPageMapper, fMapCount);
+		if (pde != NULL && (*pde & X86_64_PDE_PRESENT) != 0
+			&& ((*pde & X86_64_PDE_LARGE_PAGE) != 0 || forgetLargePage)) {
+			_SplitLargePage(virtualAddress, pde, forgetLargePage);
+		}
+	}
+
+	return X86PagingMethod64Bit::PageTableForAddress(
+		fPagingStructures->VirtualPML4(), virtualAddress, fIsKernelMap,
+		allocateTables, reservation, fPageMapper, fMapCount);
+}
+
+
+uint64*
+X86VMTranslationMap64Bit::_PageTableEntryForAddress(addr_t virtualAddress,
+	bool allocateTables, vm_page_reservation* reservation,
+	bool forgetLargePage)
+{
+	uint64* pageTable = _PageTableForAddress(virtualAddress, allocateTables,
+		reservation, forgetLargePage);
+	if (pageTable == NULL)
+		return NULL;
+
+	return &pageTable[VADDR_TO_PTE(virtualAddress)];
+}
+
+
+/*!	Points the page directory entry \a pde back to the page table the large
+	page covering \a virtualAddress was collapsed from. The page table still
+	contains all mappings, so this doesn't need to allocate anything.
+*/
+void
+X86VMTranslationMap64Bit::_SplitLargePage(addr_t virtualAddress, uint64* pde,
+	bool forget)
+{
+	RecursiveLocker locker(fLock);
+
+	virtualAddress = ROUNDDOWN(virtualAddress, k64BitPageTableRange);
+	LargePageTable* table = fLargePageTables.Lookup(virtualAddress);
+	if (table == NULL) {
+		// not one of ours, e.g. the physical map area
+		return;
+	}
+
+	uint64 oldEntry = *pde;
+	if ((oldEntry & X86_64_PDE_LARGE_PAGE) != 0) {
+		uint64* pageTable = (uint64*)fPageMapper->GetPageTableAt(
+			table->page_table);
+
+		// The accessed and dirty flags of the large page apply to all of its
+		// pages.
+		while (true) {
+			uint64 flags = oldEntry & (X86_64_PDE_ACCESSED | X86_64_PDE_DIRTY);
+			if (flags != 0) {
+				for (uint32 i = 0; i < k64BitTableEntryCount; i++)
+					X86PagingMethod64Bit::SetTableEntryFlags(&pageTable[i],
+						flags);
+			}
+
+			uint64 entry = X86PagingMethod64Bit::TestAndSetTableEntry(pde,
+				(table->page_table & X86_64_PDE_ADDRESS_MASK)
+					| X86_64_PDE_PRESENT | X86_64_PDE_WRITABLE
+					| X86_64_PDE_USER,
+				oldEntry);
+			if (entry == oldEntry)
+				break;
+			oldEntry = entry;
+		}
+
+		InvalidatePage(virtualAddress);
+	}
+
+	if (forget) {
+		fLargePageTables.RemoveUnchecked(table);
+		free_etc(table, LargePageTableAllocator::kAllocationFlags);
+	}
+}
+
+
+/*!	Replaces the page table \a pde points to by a large page, if the table
+	maps a physically contiguous, suitably aligned range with identical
+	protection and memory type. The page table is kept, so that the large page
+	can be split again at any time.
+	The map must be locked.
+*/
+bool
+X86VMTranslationMap64Bit::_CollapseLargePage(addr_t virtualAddress,
+	uint64* pde)
+{
+	uint64 oldEntry = *pde;
+	if ((oldEntry & X86_64_PDE_PRESENT) == 0
+		|| (oldEntry & X86_64_PDE_LARGE_PAGE) != 0) {
+		return false;
+	}
+
+	phys_addr_t pageTable = oldEntry & X86_64_PDE_ADDRESS_MASK;
+	uint64* virtualPageTable = (uint64*)fPageMapper->GetPageTableAt(pageTable);
+
+	// The PAT bit of a page table entry has a different position in a large
+	// page directory entry, so we don't collapse mappings using it.
+	const uint64 kStateFlags = X86_64_PTE_ACCESSED | X86_64_PTE_DIRTY;
+	uint64 firstEntry = virtualPageTable[0];
+	phys_addr_t physicalAddress = firstEntry & X86_64_PTE_ADDRESS_MASK;
+	uint64 flags = firstEntry & ~(X86_64_PTE_ADDRESS_MASK | kStateFlags);
+	if ((firstEntry & X86_64_PTE_PRESENT) == 0
+		|| (flags & X86_64_PTE_PAT) != 0
+		|| physicalAddress % k64BitPageTableRange != 0) {
+		return false;
+	}
+
+	for (uint32 i = 0; i < k64BitTableEntryCount; i++) {
+		uint64 entry = virtualPageTable[i];
+		if ((entry & ~kStateFlags)
+				!= ((physicalAddress + i * B_PAGE_SIZE) | flags)) {
+			return false;
+		}
+	}
+
+	LargePageTable* table = fLargePageTables.Lookup(virtualAddress);
+	if (table == NULL) {
+		table = (LargePageTable*)malloc_etc(sizeof(LargePageTable),
+			LargePageTableAllocator::kAllocationFlags);
+		if (table == NULL)
+			return false;
+
+		table->address = virtualAddress;
+		if (fLargePageTables.Insert(table) != B_OK) {
+			free_etc(table, LargePageTableAllocator::kAllocationFlags);
+			return false;
+		}
+	}
+	table->page_table = pageTable;
+
+	// A CPU must never have both the small and the large translations of the
+	// range in its TLB (Intel SDM 4.10.2.3, AMD erratum 383). So the page
+	// table is unhooked first, and the TLBs of all CPUs using the map are
+	// flushed. Accesses in the meantime fault, and wait for the map lock.
+	// Afterwards, no CPU can set the accessed or dirty flags of the page
+	// table entries anymore, and they can safely be moved to the large page.
+	X86PagingMethod64Bit::ClearTableEntry(pde);
+	for (uint32 i = 0; i < k64BitTableEntryCount; i++)
+		InvalidatePage(virtualAddress + i * B_PAGE_SIZE);
+	Flush();
+
+	uint64 state = 0;
+	for (uint32 i = 0; i < k64BitTableEntryCount; i++)
+		state |= virtualPageTable[i] & kStateFlags;
+
+	X86PagingMethod64Bit::SetTableEntry(pde,
+		physicalAddress | flags | state | X86_64_PDE_LARGE_PAGE);
+	return true;
+}
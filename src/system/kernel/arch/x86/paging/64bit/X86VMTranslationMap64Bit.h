@@ -7,7 +7,11 @@
 #define KERNEL_ARCH_X86_PAGING_64BIT_X86_VM_TRANSLATION_MAP_64BIT_H
 
 
+#include <heap.h>
+#include <util/OpenHashTable.h>
+
 #include "paging/X86VMTranslationMap.h"
+#include "paging/64bit/paging.h"
 
 
 struct X86PagingStructures64Bit;
@@ -57,12 +61,69 @@ struct X86VMTranslationMap64Bit final : X86VMTranslationMap {
 									bool unmapIfUnaccessed,
 									bool& _modified);
 
+	virtual	size_t				LargePageSize() const;
+	virtual	void				CollapseLargePages(addr_t start, addr_t end);
+	virtual	size_t				CountLargePages(addr_t start, addr_t end);
+
 	virtual	X86PagingStructures* PagingStructures() const;
 	inline	X86PagingStructures64Bit* PagingStructures64Bit() const
 									{ return fPagingStructures; }
 
+private:
+	// The page table a large page has been collapsed from is kept, so that
+	// the large page can be split again without allocating memory.
+			struct LargePageTable {
+				addr_t			address;
+				phys_addr_t		page_table;
+				LargePageTable*	hash_link;
+			};
+
+			struct LargePageTableHashDefinition {
+				typedef addr_t			KeyType;
+				typedef LargePageTable	ValueType;
+
+				size_t HashKey(addr_t key) const
+					{ return key / k64BitPageTableRange; }
+				size_t Hash(LargePageTable* value) const
+					{ return HashKey(value->address); }
+				bool Compare(addr_t key, LargePageTable* value) const
+					{ return value->address == key; }
+				LargePageTable*& GetLink(LargePageTable* value) const
+					{ return value->hash_link; }
+			};
+
+			struct LargePageTableAllocator {
+				void* Allocate(size_t size) const
+					{ return malloc_etc(size, kAllocationFlags); }
+				void Free(void* memory) const
+					{ free_etc(memory, kAllocationFlags); }
+
+				static const uint32 kAllocationFlags
+					= HEAP_DONT_WAIT_FOR_MEMORY | HEAP_DONT_LOCK_KERNEL_SPACE;
+			};
+
+			typedef BOpenHashTable<LargePageTableHashDefinition, true, false,
+				LargePageTableAllocator> LargePageTableHash;
+
+private:
+			uint64*				_PageTableForAddress(addr_t virtualAddress,
+									bool allocateTables,
+									vm_page_reservation* reservation,
+									bool forgetLargePage);
+			uint64*				_PageTableEntryForAddress(
+									addr_t virtualAddress,
+									bool allocateTables,
+									vm_page_reservation* reservation,
+									bool forgetLargePage);
+
+			void				_SplitLargePage(addr_t virtualAddress,
+									uint64* pde, bool forget);
+			bool				_CollapseLargePage(addr_t virtualAddress,
+									uint64* pde);
+
 private:
 			X86PagingStructures64Bit* fPagingStructures;
+			LargePageTableHash	fLargePageTables;
 };
 
 
@@ -7,6 +7,7 @@
 #include <block_cache.h>
 
 #include <unistd.h>
+#include <malloc.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -15,9 +16,11 @@
 #include <fs_cache.h>
 
 #include <condition_variable.h>
+#include <cpu.h>
 #include <lock.h>
 #include <low_resource_manager.h>
 #include <slab/Slab.h>
+#include <smp.h>
 #include <tracing.h>
 #include <util/kernel_cpp.h>
 #include <util/DoublyLinkedList.h>
@@ -80,14 +83,21 @@ struct cached_block {
 	void*			compare;
 #endif
 	int32			ref_count;
+		// Only changed atomically, as the lookup fast path may acquire
+		// additional references without holding the cache lock.
 	int32			last_accessed;
+	int32			shard;
+		// The unused list shard this block is homed in
+	bool			unused;
+		// Protected by the lock of the block's unused list shard; it is not
+		// part of the bitfield below, since it is changed without holding
+		// the cache lock.
 	bool			busy_reading : 1;
 	bool			busy_writing : 1;
 	bool			is_writing : 1;
 		// Block has been checked out for writing without transactions, and
 		// cannot be written back if set
 	bool			is_dirty : 1;
-	bool			unused : 1;
 	bool			discard : 1;
 	bool			busy_reading_waiters : 1;
 	bool			busy_writing_waiters : 1;
@@ -169,9 +179,31 @@ struct TransactionHash {
 typedef BOpenHashTable<TransactionHash> TransactionTable;
 
 
+/*!	A per-CPU part of the list of unused blocks. Every block is homed in the
+	shard of the CPU that created it, and all its transitions from and to the
+	unused state happen with that shard's lock held. That allows the lookup
+	fast path to pick up unused blocks without taking the cache lock.
+	Each shard's list is sorted by last access.
+	The shard also counts the lookups without the cache lock that are in
+	progress on its CPU, see block_cache::BeginLookup().
+*/
+struct unused_block_shard {
+	mutex			lock;
+	block_list		blocks;
+	uint32			count;
+	int32			lookups;
+} CACHE_LINE_ALIGN;
+
+
 struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 	BlockTable*		hash;
 	mutex			lock;
+	int32			hash_changing;
+		// Set while the hash table is being changed, which also requires
+		// the cache lock; lookups without the cache lock back off then.
+	ConditionVariable hash_change_condition;
+		// Notified when the last lookup of a shard is done while the hash
+		// table is about to be changed
 	int				fd;
 	off_t			max_blocks;
 	size_t			block_size;
@@ -180,8 +212,8 @@ struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 	TransactionTable* transaction_hash;
 
 	object_cache*	buffer_cache;
-	block_list		unused_blocks;
-	uint32			unused_block_count;
+	unused_block_shard* unused_shards;
+	int32			unused_shard_count;
 
 	ConditionVariable busy_reading_condition;
 	uint32			busy_reading_count;
@@ -209,13 +241,25 @@ struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 	cached_block*	NewBlock(off_t blockNumber);
 	void			FreeBlockParentData(cached_block* block);
 
+	bool			AddUnused(cached_block* block);
+	bool			RemoveUnused(cached_block* block,
+						bool acquireReference = false);
+	uint32			UnusedBlockCount() const;
+
 	void			RemoveUnusedBlocks(int32 count, int32 minSecondsOld = 0);
 	void			RemoveBlock(cached_block* block);
 	void			DiscardBlock(cached_block* block);
 
+	int32			BeginLookup();
+	void			EndLookup(int32 slot);
+	void			BeginHashChange();
+	void			EndHashChange();
+
 private:
 	static void		_LowMemoryHandler(void* data, uint32 resources,
 						int32 level);
+	cached_block*	_FindUnusedBlock(unused_block_shard& shard,
+						int32 minSecondsOld, bool skipBusy);
 	cached_block*	_GetUnusedBlock();
 };
 
@@ -324,6 +368,23 @@ public:
 
 typedef AutoLocker<block_cache, TransactionLocking> TransactionLocker;
 
+
+class HashChangeLocking {
+public:
+	inline bool Lock(block_cache* cache)
+	{
+		cache->BeginHashChange();
+		return true;
+	}
+
+	inline void Unlock(block_cache* cache)
+	{
+		cache->EndHashChange();
+	}
+};
+
+typedef AutoLocker<block_cache, HashChangeLocking> HashChangeLocker;
+
 } // namespace
 
 
@@ -1309,10 +1370,7 @@ BlockWriter::_BlockDone(cached_block* block,
 	}
 	if (block->transaction == NULL && block->ref_count == 0 && !block->unused) {
 		// the block is no longer used
-		ASSERT(block->original_data == NULL && block->parent_data == NULL);
-		block->unused = true;
-		fCache->unused_blocks.Add(block);
-		fCache->unused_block_count++;
+		fCache->AddUnused(block);
 	}
 
 	TB2(BlockData(fCache, block, "after write"));
@@ -1357,6 +1415,7 @@ block_cache::block_cache(int _fd, off_t numBlocks, size_t blockSize,
 		bool readOnly)
 	:
 	hash(NULL),
+	hash_changing(0),
 	fd(_fd),
 	max_blocks(numBlocks),
 	block_size(blockSize),
@@ -1364,7 +1423,8 @@ block_cache::block_cache(int _fd, off_t numBlocks, size_t blockSize,
 	last_transaction(NULL),
 	transaction_hash(NULL),
 	buffer_cache(NULL),
-	unused_block_count(0),
+	unused_shards(NULL),
+	unused_shard_count(0),
 	busy_reading_count(0),
 	busy_reading_waiters(false),
 	busy_writing_count(0),
@@ -1385,6 +1445,12 @@ block_cache::~block_cache()
 
 	delete_object_cache(buffer_cache);
 
+	if (unused_shards != NULL) {
+		for (int32 i = 0; i < unused_shard_count; i++)
+			mutex_destroy(&unused_shards[i].lock);
+		free(unused_shards);
+	}
+
 	mutex_destroy(&lock);
 }
 
@@ -1395,8 +1461,23 @@ block_cache::Init()
 	busy_reading_condition.Init(this, "cache block busy_reading");
 	busy_writing_condition.Init(this, "cache block busy writing");
 	condition_variable.Init(this, "cache transaction sync");
+	hash_change_condition.Init(this, "cache hash change");
 	mutex_init(&lock, "block cache");
 
+	int32 shardCount = smp_get_num_cpus();
+	unused_shards = (unused_block_shard*)memalign(CACHE_LINE_SIZE,
+		sizeof(unused_block_shard) * shardCount);
+	if (unused_shards == NULL)
+		return B_NO_MEMORY;
+
+	for (int32 i = 0; i < shardCount; i++) {
+		new(&unused_shards[i]) unused_block_shard;
+		mutex_init(&unused_shards[i].lock, "block cache unused");
+		unused_shards[i].count = 0;
+		unused_shards[i].lookups = 0;
+	}
+	unused_shard_count = shardCount;
+
 	buffer_cache = create_object_cache_etc("block cache buffers", block_size,
 		8, 0, 0, 0, CACHE_LARGE_SLAB, NULL, NULL, NULL, NULL);
 	if (buffer_cache == NULL)
@@ -1478,7 +1559,7 @@ block_cache::NewBlock(off_t blockNumber)
 		} else {
 			TB(Error(this, blockNumber, "allocation failed"));
 			dprintf("block allocation failed, unused list is %sempty.\n",
-				unused_blocks.IsEmpty() ? "" : "not ");
+				UnusedBlockCount() == 0 ? "" : "not ");
 
 			// allocation failed, try to reuse an unused block
 			block = _GetUnusedBlock();
@@ -1493,6 +1574,7 @@ block_cache::NewBlock(off_t blockNumber)
 	block->block_number = blockNumber;
 	block->ref_count = 0;
 	block->last_accessed = 0;
+	block->shard = smp_get_current_cpu() % unused_shard_count;
 	block->transaction_next = NULL;
 	block->transaction = block->previous_transaction = NULL;
 	block->original_data = NULL;
@@ -1523,39 +1605,98 @@ block_cache::FreeBlockParentData(cached_block* block)
 }
 
 
+/*!	Puts the \a block into the unused list of its shard, if it is neither
+	referenced nor already in there.
+	The cache must be locked.
+*/
+bool
+block_cache::AddUnused(cached_block* block)
+{
+	unused_block_shard& shard = unused_shards[block->shard];
+	MutexLocker shardLocker(shard.lock);
+
+	if (block->unused || atomic_get(&block->ref_count) != 0)
+		return false;
+
+	ASSERT(block->original_data == NULL && block->parent_data == NULL);
+	block->unused = true;
+	shard.blocks.Add(block);
+	shard.count++;
+	return true;
+}
+
+
+/*!	Removes the \a block from the unused list of its shard. If
+	\a acquireReference is \c true, a reference to the block is acquired
+	atomically with its removal.
+	Returns \c false if the block was not in the unused list (anymore).
+	This may be called without having the cache locked, as long as the hash
+	lock is held, and the block could be looked up.
+*/
+bool
+block_cache::RemoveUnused(cached_block* block, bool acquireReference)
+{
+	unused_block_shard& shard = unused_shards[block->shard];
+	MutexLocker shardLocker(shard.lock);
+
+	if (!block->unused)
+		return false;
+
+	if (acquireReference)
+		atomic_add(&block->ref_count, 1);
+
+	block->unused = false;
+	shard.blocks.Remove(block);
+	shard.count--;
+	return true;
+}
+
+
+uint32
+block_cache::UnusedBlockCount() const
+{
+	uint32 count = 0;
+	for (int32 i = 0; i < unused_shard_count; i++)
+		count += unused_shards[i].count;
+
+	return count;
+}
+
+
 void
 block_cache::RemoveUnusedBlocks(int32 count, int32 minSecondsOld)
 {
 	TRACE(("block_cache: remove up to %" B_PRId32 " unused blocks\n", count));
 
-	for (block_list::Iterator iterator = unused_blocks.GetIterator();
-			cached_block* block = iterator.Next();) {
-		if (minSecondsOld >= block->LastAccess()) {
-			// The list is sorted by last access
-			break;
-		}
-		if (block->busy_reading || block->busy_writing)
-			continue;
+	// Take the blocks from all shards alike
+	int32 perShardCount = (count + unused_shard_count - 1) / unused_shard_count;
 
-		TB(Flush(this, block));
-		TRACE(("  remove block %" B_PRIdOFF ", last accessed %" B_PRId32 "\n",
-			block->block_number, block->last_accessed));
+	for (int32 i = 0; i < unused_shard_count && count > 0; i++) {
+		unused_block_shard& shard = unused_shards[i];
 
-		// this can only happen if no transactions are used
-		if (block->is_dirty && !block->discard) {
-			if (block->busy_writing)
-				continue;
+		for (int32 shardCount = min_c(perShardCount, count); shardCount > 0;) {
+			cached_block* block = _FindUnusedBlock(shard, minSecondsOld, true);
+			if (block == NULL)
+				break;
 
-			BlockWriter::WriteBlock(this, block);
-		}
+			TB(Flush(this, block));
+			TRACE(("  remove block %" B_PRIdOFF ", last accessed %" B_PRId32
+				"\n", block->block_number, block->last_accessed));
 
-		// remove block from lists
-		iterator.Remove();
-		unused_block_count--;
-		RemoveBlock(block);
+			// this can only happen if no transactions are used
+			if (block->is_dirty && !block->discard)
+				BlockWriter::WriteBlock(this, block);
 
-		if (--count <= 0)
-			break;
+			// The block might have been picked up by the lookup fast path
+			// in the mean time
+			if (!RemoveUnused(block))
+				continue;
+
+			RemoveBlock(block);
+
+			shardCount--;
+			count--;
+		}
 	}
 }
 
@@ -1563,7 +1704,10 @@ block_cache::RemoveUnusedBlocks(int32 count, int32 minSecondsOld)
 void
 block_cache::RemoveBlock(cached_block* block)
 {
+	HashChangeLocker hashLocker(this);
 	hash->Remove(block);
+	hashLocker.Unlock();
+
 	FreeBlock(block);
 }
 
@@ -1598,21 +1742,22 @@ block_cache::_LowMemoryHandler(void* data, uint32 resources, int32 level)
 	// (if there is enough memory left, we don't free any)
 
 	block_cache* cache = (block_cache*)data;
+	uint32 unusedCount = cache->UnusedBlockCount();
 	int32 free = 0;
 	int32 secondsOld = 0;
 	switch (level) {
 		case B_NO_LOW_RESOURCE:
 			return;
 		case B_LOW_RESOURCE_NOTE:
-			free = cache->unused_block_count / 8;
+			free = unusedCount / 8;
 			secondsOld = 120;
 			break;
 		case B_LOW_RESOURCE_WARNING:
-			free = cache->unused_block_count / 4;
+			free = unusedCount / 4;
 			secondsOld = 10;
 			break;
 		case B_LOW_RESOURCE_CRITICAL:
-			free = cache->unused_block_count / 2;
+			free = unusedCount / 2;
 			secondsOld = 0;
 			break;
 	}
@@ -1626,14 +1771,37 @@ block_cache::_LowMemoryHandler(void* data, uint32 resources, int32 level)
 		return;
 	}
 
-#ifdef TRACE_BLOCK_CACHE
-	uint32 oldUnused = cache->unused_block_count;
-#endif
-
 	cache->RemoveUnusedBlocks(free, secondsOld);
 
 	TRACE(("block_cache::_LowMemoryHandler(): %p: unused: %" B_PRIu32 " -> %" B_PRIu32 "\n",
-		cache, oldUnused, cache->unused_block_count));
+		cache, unusedCount, cache->UnusedBlockCount()));
+}
+
+
+/*!	Returns the least recently used block in the unused list of \a shard
+	that is at least \a minSecondsOld seconds old. The block is not removed
+	from the list.
+	The cache must be locked.
+*/
+cached_block*
+block_cache::_FindUnusedBlock(unused_block_shard& shard, int32 minSecondsOld,
+	bool skipBusy)
+{
+	MutexLocker shardLocker(shard.lock);
+
+	for (block_list::Iterator iterator = shard.blocks.GetIterator();
+			cached_block* block = iterator.Next();) {
+		if (minSecondsOld >= block->LastAccess()) {
+			// The list is sorted by last access
+			break;
+		}
+		if (skipBusy && (block->busy_reading || block->busy_writing))
+			continue;
+
+		return block;
+	}
+
+	return NULL;
 }
 
 
@@ -1642,33 +1810,113 @@ block_cache::_GetUnusedBlock()
 {
 	TRACE(("block_cache: get unused block\n"));
 
-	for (block_list::Iterator iterator = unused_blocks.GetIterator();
-			cached_block* block = iterator.Next();) {
-		TB(Flush(this, block, true));
-		// this can only happen if no transactions are used
-		if (block->is_dirty && !block->busy_writing && !block->discard)
-			BlockWriter::WriteBlock(this, block);
+	// start with the shard of the current CPU
+	int32 firstShard = smp_get_current_cpu() % unused_shard_count;
 
-		// remove block from lists
-		iterator.Remove();
-		unused_block_count--;
-		hash->Remove(block);
+	for (int32 i = 0; i < unused_shard_count; i++) {
+		unused_block_shard& shard
+			= unused_shards[(firstShard + i) % unused_shard_count];
 
-		ASSERT(block->original_data == NULL && block->parent_data == NULL);
-		block->unused = false;
+		while (true) {
+			cached_block* block = _FindUnusedBlock(shard, -1, true);
+			if (block == NULL)
+				break;
 
-		// TODO: see if compare data is handled correctly here!
+			TB(Flush(this, block, true));
+			// this can only happen if no transactions are used
+			if (block->is_dirty && !block->busy_writing && !block->discard)
+				BlockWriter::WriteBlock(this, block);
+
+			// remove block from lists
+			if (!RemoveUnused(block))
+				continue;
+
+			HashChangeLocker hashLocker(this);
+			hash->Remove(block);
+			hashLocker.Unlock();
+
+			ASSERT(block->original_data == NULL && block->parent_data == NULL);
+
+			// TODO: see if compare data is handled correctly here!
 #if BLOCK_CACHE_DEBUG_CHANGED
-		if (block->compare != NULL)
-			Free(block->compare);
+			if (block->compare != NULL)
+				Free(block->compare);
 #endif
-		return block;
+			return block;
+		}
 	}
 
 	return NULL;
 }
 
 
+/*!	Starts a lookup in the hash table without holding the cache lock. The
+	lookup only touches the shard of the current CPU, so that lookups on
+	different CPUs don't contend with each other.
+	Returns the slot that must be passed to EndLookup(), or -1 if the hash
+	table is being changed; the caller has to lock the cache then.
+	While the lookup is in progress, blocks cannot be removed from the hash
+	table, and therefore cannot be freed. The caller must not lock the cache
+	before calling EndLookup().
+*/
+int32
+block_cache::BeginLookup()
+{
+	int32 slot = smp_get_current_cpu() % unused_shard_count;
+	atomic_add(&unused_shards[slot].lookups, 1);
+
+	if (atomic_get(&hash_changing) != 0) {
+		EndLookup(slot);
+		return -1;
+	}
+
+	return slot;
+}
+
+
+void
+block_cache::EndLookup(int32 slot)
+{
+	if (atomic_add(&unused_shards[slot].lookups, -1) == 1
+		&& atomic_get(&hash_changing) != 0) {
+		hash_change_condition.NotifyAll();
+	}
+}
+
+
+/*!	Prevents new lookups without the cache lock, and waits for the ones in
+	progress to finish. A lookup may have to wait for the lock of an unused
+	list shard, or be preempted, so this waits rather than spins.
+	The cache must be locked.
+*/
+void
+block_cache::BeginHashChange()
+{
+	ASSERT_LOCKED_MUTEX(&lock);
+
+	// This must be ordered before reading the lookup counts, so that either
+	// we see a lookup, or it sees us
+	atomic_get_and_set(&hash_changing, 1);
+
+	for (int32 i = 0; i < unused_shard_count; i++) {
+		while (atomic_get(&unused_shards[i].lookups) != 0) {
+			ConditionVariableEntry entry;
+			hash_change_condition.Add(&entry);
+
+			if (atomic_get(&unused_shards[i].lookups) != 0)
+				entry.Wait();
+		}
+	}
+}
+
+
+void
+block_cache::EndHashChange()
+{
+	atomic_set(&hash_changing, 0);
+}
+
+
 //	#pragma mark - private block functions
 
 
@@ -1808,7 +2056,7 @@ put_cached_block(block_cache* cache, cached_block* block)
 		return;
 	}
 
-	if (--block->ref_count == 0
+	if (atomic_add(&block->ref_count, -1) == 1
 		&& block->transaction == NULL && block->previous_transaction == NULL) {
 		// This block is not used anymore, and not part of any transaction
 		block->is_writing = false;
@@ -1818,11 +2066,7 @@ put_cached_block(block_cache* cache, cached_block* block)
 		} else {
 			// put this block in the list of unused blocks
 			ASSERT(!block->unused);
-			block->unused = true;
-
-			ASSERT(block->original_data == NULL && block->parent_data == NULL);
-			cache->unused_blocks.Add(block);
-			cache->unused_block_count++;
+			cache->AddUnused(block);
 		}
 	}
 }
@@ -1853,8 +2097,9 @@ put_cached_block(block_cache* cache, off_t blockNumber)
 		to satisfy your request.
 	\param readBlock if \c false, the block will not be read in case it was
 		not already in the cache. The block you retrieve may contain random
-		data. If \c true, the cache will be temporarily unlocked while the
-		block is read in.
+		data, and is still marked busy reading; the caller has to initialize
+		it, and call mark_block_unbusy_reading() then. If \c true, the cache
+		will be temporarily unlocked while the block is read in.
 */
 static cached_block*
 get_cached_block(block_cache* cache, off_t blockNumber, bool* _allocated,
@@ -1873,12 +2118,17 @@ retry:
 	*_allocated = false;
 
 	if (block == NULL) {
-		// put block into cache
+		// put block into cache; it stays busy until its contents are valid
 		block = cache->NewBlock(blockNumber);
 		if (block == NULL)
 			return NULL;
 
+		mark_block_busy_reading(cache, block);
+
+		HashChangeLocker hashLocker(cache);
 		cache->hash->Insert(block);
+		hashLocker.Unlock();
+
 		*_allocated = true;
 	} else if (block->busy_reading) {
 		// The block is currently busy_reading - wait and try again later
@@ -1888,16 +2138,14 @@ retry:
 
 	if (block->unused) {
 		//TRACE(("remove block %" B_PRIdOFF " from unused\n", blockNumber));
-		block->unused = false;
-		cache->unused_blocks.Remove(block);
-		cache->unused_block_count--;
+		cache->RemoveUnused(block);
+			// if this fails, the lookup fast path got it in the mean time
 	}
 
 	if (*_allocated && readBlock) {
 		// read block into cache
 		int32 blockSize = cache->block_size;
 
-		mark_block_busy_reading(cache, block);
 		mutex_unlock(&cache->lock);
 
 		ssize_t bytesRead = read_pos(cache->fd, blockNumber * blockSize,
@@ -1905,6 +2153,7 @@ retry:
 
 		mutex_lock(&cache->lock);
 		if (bytesRead < blockSize) {
+			mark_block_unbusy_reading(cache, block);
 			cache->RemoveBlock(block);
 			TB(Error(cache, blockNumber, "read failed", bytesRead));
 
@@ -1917,13 +2166,127 @@ retry:
 		mark_block_unbusy_reading(cache, block);
 	}
 
-	block->ref_count++;
+	atomic_add(&block->ref_count, 1);
 	block->last_accessed = system_time() / 1000000L;
 
 	return block;
 }
 
 
+/*!	Tries to acquire a reference to the block \a blockNumber without
+	locking the cache. This only succeeds if the block is in the cache,
+	and is either referenced already, or in the unused list; anything else
+	(including blocks that are still being read in or initialized) has to go
+	through get_cached_block().
+	Referenced blocks are picked up without any lock; unused ones need the
+	lock of their unused list shard.
+	Since that includes blocks of ongoing transactions, this must only be
+	used for read-only access.
+*/
+static cached_block*
+get_cached_block_fast(block_cache* cache, off_t blockNumber)
+{
+#if BLOCK_CACHE_DEBUG_CHANGED
+	return NULL;
+#else
+	if (blockNumber < 0 || blockNumber >= cache->max_blocks)
+		return NULL;
+
+	int32 slot = cache->BeginLookup();
+	if (slot < 0)
+		return NULL;
+
+	cached_block* block = cache->hash->Lookup(blockNumber);
+	if (block == NULL || block->busy_reading) {
+		cache->EndLookup(slot);
+		return NULL;
+	}
+
+	// While the block is referenced, it can neither be removed from the cache
+	// nor be put into the unused list, so we can just add another one
+	bool acquired = false;
+	int32 count = atomic_get(&block->ref_count);
+	while (count > 0) {
+		int32 previous = atomic_test_and_set(&block->ref_count, count + 1,
+			count);
+		if (previous == count) {
+			acquired = true;
+			break;
+		}
+		count = previous;
+	}
+
+	if (!acquired && !cache->RemoveUnused(block, true)) {
+		cache->EndLookup(slot);
+		return NULL;
+	}
+
+	cache->EndLookup(slot);
+
+	// Our reference keeps the block alive now. It might have become busy in
+	// the mean time, though, for example when it is being cleared, or was
+	// just created by someone else.
+	if (block->busy_reading) {
+		count = atomic_get(&block->ref_count);
+		while (count > 1) {
+			int32 previous = atomic_test_and_set(&block->ref_count, count - 1,
+				count);
+			if (previous == count)
+				return NULL;
+			count = previous;
+		}
+
+		MutexLocker locker(&cache->lock);
+		put_cached_block(cache, block);
+		return NULL;
+	}
+
+	block->last_accessed = system_time() / 1000000L;
+	return block;
+#endif
+}
+
+
+/*!	Releases a reference to \a block without locking the cache, as long as
+	this is not the last one. The last reference must be released with the
+	cache locked via put_cached_block(), as the block might have to be
+	moved to the unused list, or be discarded.
+*/
+static bool
+put_cached_block_fast(block_cache* cache, off_t blockNumber)
+{
+#if BLOCK_CACHE_DEBUG_CHANGED
+	return false;
+#else
+	if (blockNumber < 0 || blockNumber >= cache->max_blocks)
+		return false;
+
+	int32 slot = cache->BeginLookup();
+	if (slot < 0)
+		return false;
+
+	cached_block* block = cache->hash->Lookup(blockNumber);
+	bool released = false;
+	if (block != NULL) {
+		int32 count = atomic_get(&block->ref_count);
+		while (count > 1) {
+			int32 previous = atomic_test_and_set(&block->ref_count, count - 1,
+				count);
+			if (previous == count) {
+				TB(Put(cache, block));
+				released = true;
+				break;
+			}
+			count = previous;
+		}
+	}
+
+	cache->EndLookup(slot);
+	return released;
+#endif
+}
+
+
 /*!	Returns the writable block data for the requested blockNumber.
 	If \a cleared is true, the block is not read from disk; an empty block
 	is returned.
@@ -1949,6 +2312,16 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 	if (block == NULL)
 		return NULL;
 
+	if (allocated && cleared) {
+		// the new block stays busy until it has been cleared
+		mutex_unlock(&cache->lock);
+
+		memset(block->current_data, 0, cache->block_size);
+
+		mutex_lock(&cache->lock);
+		mark_block_unbusy_reading(cache, block);
+	}
+
 	if (block->busy_writing)
 		wait_for_busy_writing_block(cache, block);
 
@@ -1956,7 +2329,7 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 
 	// if there is no transaction support, we just return the current block
 	if (transactionID == -1) {
-		if (cleared) {
+		if (cleared && !allocated) {
 			mark_block_busy_reading(cache, block);
 			mutex_unlock(&cache->lock);
 
@@ -2059,7 +2432,7 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 		&& block->parent_data == NULL && wasUnchanged)
 		transaction->sub_num_blocks++;
 
-	if (cleared) {
+	if (cleared && !allocated) {
 		mark_block_busy_reading(cache, block);
 		mutex_unlock(&cache->lock);
 
@@ -2271,7 +2644,11 @@ dump_cache(int argc, char** argv)
 		" discarded, %" B_PRIu32 " referenced, %" B_PRIu32 " busy, %" B_PRIu32
 		" in unused.\n",
 		count, dirty, discarded, referenced, cache->busy_reading_count,
-		cache->unused_block_count);
+		cache->UnusedBlockCount());
+	for (int32 i = 0; i < cache->unused_shard_count; i++) {
+		kprintf("   unused shard %" B_PRId32 ": %" B_PRIu32 " blocks\n", i,
+			cache->unused_shards[i].count);
+	}
 	return 0;
 }
 
@@ -3068,9 +3445,7 @@ cache_abort_sub_transaction(void* _cache, int32 id)
 
 				if (block->ref_count == 0) {
 					// Move the block into the unused list if possible
-					block->unused = true;
-					cache->unused_blocks.Add(block);
-					cache->unused_block_count++;
+					cache->AddUnused(block);
 				}
 			}
 		} else {
@@ -3339,7 +3714,10 @@ block_cache_delete(void* _cache, bool allowWrites)
 
 	// free all blocks
 
+	cache->BeginHashChange();
 	cached_block* block = cache->hash->Clear(true);
+	cache->EndHashChange();
+
 	while (block != NULL) {
 		cached_block* next = block->next;
 		cache->FreeBlock(block);
@@ -3480,9 +3858,7 @@ block_cache_discard(void* _cache, off_t blockNumber, size_t numBlocks)
 
 		ASSERT(block->previous_transaction == NULL);
 
-		if (block->unused) {
-			cache->unused_blocks.Remove(block);
-			cache->unused_block_count--;
+		if (block->unused && cache->RemoveUnused(block)) {
 			cache->RemoveBlock(block);
 		} else {
 			if (block->transaction != NULL && block->parent_data != NULL
@@ -3566,6 +3942,13 @@ const void*
 block_cache_get_etc(void* _cache, off_t blockNumber, off_t base, off_t length)
 {
 	block_cache* cache = (block_cache*)_cache;
+
+	cached_block* fastBlock = get_cached_block_fast(cache, blockNumber);
+	if (fastBlock != NULL) {
+		TB(Get(cache, fastBlock));
+		return fastBlock->current_data;
+	}
+
 	MutexLocker locker(&cache->lock);
 	bool allocated;
 
@@ -3626,6 +4009,9 @@ void
 block_cache_put(void* _cache, off_t blockNumber)
 {
 	block_cache* cache = (block_cache*)_cache;
+	if (put_cached_block_fast(cache, blockNumber))
+		return;
+
 	MutexLocker locker(&cache->lock);
 
 	put_cached_block(cache, blockNumber);
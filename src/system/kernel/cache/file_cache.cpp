@@ -41,6 +41,16 @@
 
 #define BYPASS_IO_SIZE		65536
 #define LAST_ACCESSES		3
+#define READ_AHEAD_STREAMS	4
+
+struct read_ahead_stream {
+	off_t			next_offset;
+		// where the next read of this stream is expected
+	off_t			prefetched_end;
+		// end of the range that has already been prefetched
+	bigtime_t		last_used;
+	uint32			window;
+};
 
 struct file_cache_ref {
 	VMCache			*cache;
@@ -51,6 +61,8 @@ struct file_cache_ref {
 		//	write vs. read)
 	int32			last_access_index;
 	uint16			disabled_count;
+	read_ahead_stream read_ahead[READ_AHEAD_STREAMS];
+		// protected by the cache lock
 
 	inline void SetLastAccess(int32 index, off_t access, bool isWrite)
 	{
@@ -108,6 +120,9 @@ static void add_to_iovec(generic_io_vec* vecs, uint32 &index, uint32 max,
 static struct cache_module_info* sCacheModule;
 
 
+static const uint32 kMinReadAhead = 64 * 1024;
+static const uint32 kMaxReadAhead = 2 * 1024 * 1024;
+
 static const uint32 kZeroVecCount = 32;
 static const size_t kZeroVecSize = kZeroVecCount * B_PAGE_SIZE;
 static phys_addr_t sZeroPage;	// physical address
@@ -282,6 +297,111 @@ push_access(file_cache_ref* ref, off_t offset, generic_size_t bytes,
 }
 
 
+/*!	Returns the maximum read-ahead window the current memory situation
+	allows for.
+*/
+static uint32
+max_read_ahead()
+{
+	switch (low_resource_state(B_KERNEL_RESOURCE_PAGES)) {
+		case B_NO_LOW_RESOURCE:
+			return kMaxReadAhead;
+		case B_LOW_RESOURCE_NOTE:
+			return kMaxReadAhead / 4;
+		case B_LOW_RESOURCE_WARNING:
+			return kMinReadAhead;
+		default:
+			return 0;
+	}
+}
+
+
+/*!	Matches a read of \a bytes at \a offset against the sequential streams
+	of the file. A read that continues a stream doubles its read-ahead window
+	(up to what max_read_ahead() allows) once half of the previously
+	prefetched data has been consumed; a read that doesn't belong to any
+	stream starts a new one in the least recently used slot.
+	Returns \c true if the range in \a _offset and \a _size should be
+	prefetched.
+	The caller must have the cache locked.
+*/
+static bool
+update_read_ahead(file_cache_ref* ref, off_t offset, size_t bytes,
+	off_t& _offset, size_t& _size)
+{
+	off_t end = offset + bytes;
+	read_ahead_stream* stream = NULL;
+	read_ahead_stream* oldest = &ref->read_ahead[0];
+
+	for (int32 i = 0; i < READ_AHEAD_STREAMS; i++) {
+		read_ahead_stream& candidate = ref->read_ahead[i];
+		if (candidate.last_used != 0
+			&& offset >= candidate.next_offset - B_PAGE_SIZE
+			&& offset <= candidate.next_offset + B_PAGE_SIZE) {
+			stream = &candidate;
+			break;
+		}
+		if (candidate.last_used < oldest->last_used)
+			oldest = &candidate;
+	}
+
+	if (stream == NULL) {
+		oldest->next_offset = end;
+		oldest->prefetched_end = end;
+		oldest->last_used = system_time();
+		oldest->window = 0;
+		return false;
+	}
+
+	stream->next_offset = end;
+	stream->last_used = system_time();
+
+	uint32 maxWindow = max_read_ahead();
+	if (maxWindow == 0) {
+		// we're short on memory, stop reading ahead completely
+		stream->window = 0;
+		stream->prefetched_end = end;
+		return false;
+	}
+
+	// wait until the reader has used up half of the current window
+	if (stream->prefetched_end - end > (off_t)stream->window / 2)
+		return false;
+
+	if (stream->window == 0)
+		stream->window = min_c(kMinReadAhead, maxWindow);
+	else
+		stream->window = min_c(stream->window * 2, maxWindow);
+
+	_offset = max_c(stream->prefetched_end, end);
+	_size = stream->window;
+	stream->prefetched_end = _offset + stream->window;
+	return true;
+}
+
+
+/*!	Asynchronously prefetches the next window of the stream the read belongs
+	to, if any.
+*/
+static void
+read_ahead(file_cache_ref* ref, off_t offset, size_t bytes)
+{
+	off_t prefetchOffset;
+	size_t prefetchSize;
+
+	{
+		AutoLocker<VMCache> _(ref->cache);
+
+		if (ref->disabled_count > 0 || !update_read_ahead(ref, offset, bytes,
+				prefetchOffset, prefetchSize)) {
+			return;
+		}
+	}
+
+	cache_prefetch_vnode(ref->vnode, prefetchOffset, prefetchSize);
+}
+
+
 static void
 reserve_pages(file_cache_ref* ref, vm_page_reservation* reservation,
 	size_t reservePages, bool isWrite)
@@ -962,9 +1082,12 @@ cache_prefetch_vnode(struct vnode* vnode, off_t offset, size_t size)
 	size_t reservePages = size / B_PAGE_SIZE;
 
 	// Don't do anything if we don't have the resources left, or the cache
-	// already contains more than 2/3 of its pages
+	// already contains more than 2/3 of its pages. The latter is only a
+	// useful measure if the whole file is requested; for read-ahead windows
+	// of a larger file, the pages are checked individually below.
 	if (offset >= fileSize || vm_page_num_unused_pages() < 2 * reservePages
-		|| 3 * cache->page_count > 2 * fileSize / B_PAGE_SIZE) {
+		|| (offset == 0 && (off_t)size >= fileSize
+			&& 3 * cache->page_count > 2 * fileSize / B_PAGE_SIZE)) {
 		cache->ReleaseRef();
 		return;
 	}
@@ -1131,6 +1254,7 @@ file_cache_create(dev_t mountID, ino_t vnodeID, off_t size)
 		return NULL;
 
 	memset(ref->last_access, 0, sizeof(ref->last_access));
+	memset(ref->read_ahead, 0, sizeof(ref->read_ahead));
 	ref->last_access_index = 0;
 	ref->disabled_count = 0;
 
@@ -1299,7 +1423,12 @@ file_cache_read(void* _cacheRef, void* cookie, off_t offset, void* buffer,
 		return error;
 	}
 
-	return cache_io(ref, cookie, offset, (addr_t)buffer, _size, false);
+	status_t status = cache_io(ref, cookie, offset, (addr_t)buffer, _size,
+		false);
+	if (status == B_OK && *_size > 0)
+		read_ahead(ref, offset, *_size);
+
+	return status;
 }
 
 
@@ -2196,6 +2196,22 @@ devfs_compute_geometry_size(device_geometry* geometry, uint64 blockCount,
 }
 
 
+/*!	Returns whether \a _vnode is a devfs device whose driver implements the
+	io() hook, that is, whether devfs_io() won't fall back to synchronous I/O.
+*/
+bool
+devfs_device_has_io(struct vnode* _vnode)
+{
+	fs_vnode* fsNode = vfs_fsnode_for_vnode(_vnode);
+	if (fsNode->ops != &kVnodeOps)
+		return false;
+
+	devfs_vnode* vnode = (devfs_vnode*)fsNode->private_node;
+	return S_ISCHR(vnode->stream.type)
+		&& vnode->stream.u.dev.device->HasIO();
+}
+
+
 //	#pragma mark - support API for legacy drivers
 
 
@@ -0,0 +1,660 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Persistent event queues.
+
+	Unlike select(), poll(), and wait_for_objects(), which have to select
+	every object anew on each call, an event queue keeps its objects selected
+	until they are explicitly removed. The objects notify the queue via the
+	usual select_info/notify_select_events() mechanism; the queue's
+	select_sync just puts the notified infos on a ready list instead of
+	releasing a semaphore. Waiting therefore only costs as much as there are
+	objects with pending events.
+*/
+
+
+#include <event_queue.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+
+#include <new>
+
+#include <AutoDeleter.h>
+
+#include <condition_variable.h>
+#include <fs/fd.h>
+#include <kernel.h>
+#include <lock.h>
+#include <smp.h>
+#include <syscall_restart.h>
+#include <team.h>
+#include <util/AutoLock.h>
+#include <util/DoublyLinkedList.h>
+#include <util/OpenHashTable.h>
+#include <wait_for_objects.h>
+
+
+//#define TRACE_EVENT_QUEUE
+#ifdef TRACE_EVENT_QUEUE
+#	define TRACE(x...) dprintf("event_queue: " x)
+#else
+#	define TRACE(x...) ;
+#endif
+
+
+static const int32 kAlwaysReportedEvents
+	= B_EVENT_INVALID | B_EVENT_ERROR | B_EVENT_DISCONNECTED;
+static const int32 kEventFlags = B_EVENT_LEVEL_TRIGGERED | B_EVENT_ONE_SHOT;
+
+
+namespace {
+
+struct select_entry : select_info, DoublyLinkedListLinkImpl<select_entry> {
+	int32			object;
+	uint16			type;
+	int32			requested_events;
+		// the B_EVENT_* flags as passed to _kern_event_queue_select()
+	void*			user_data;
+	select_entry*	hash_link;
+
+	// protected by the queue's ready lock
+	bool			queued;
+	bool			detached;
+		// the object is gone, and no longer has the entry selected
+};
+
+typedef DoublyLinkedList<select_entry> SelectEntryList;
+
+
+struct SelectEntryKey {
+	int32	object;
+	uint16	type;
+};
+
+
+struct SelectEntryHashDefinition {
+	typedef SelectEntryKey	KeyType;
+	typedef select_entry	ValueType;
+
+	size_t HashKey(const SelectEntryKey& key) const
+	{
+		return (size_t)key.object ^ ((size_t)key.type << 24);
+	}
+
+	size_t Hash(select_entry* value) const
+	{
+		SelectEntryKey key = { value->object, value->type };
+		return HashKey(key);
+	}
+
+	bool Compare(const SelectEntryKey& key, select_entry* value) const
+	{
+		return value->object == key.object && value->type == key.type;
+	}
+
+	select_entry*& GetLink(select_entry* value) const
+	{
+		return value->hash_link;
+	}
+};
+
+typedef BOpenHashTable<SelectEntryHashDefinition> SelectEntryTable;
+
+
+class EventQueue : public select_sync {
+public:
+								EventQueue(team_id team);
+								~EventQueue();
+
+			status_t			Init();
+
+			team_id				Team() const	{ return fTeam; }
+
+			status_t			Select(int32 object, uint16 type,
+									int32 events, void* userData);
+			ssize_t				Wait(event_wait_info* infos, int numInfos,
+									uint32 flags, bigtime_t timeout);
+			void				Close();
+
+			void				Notify(select_entry* entry, uint16 events);
+
+private:
+			status_t			_SelectEntry(select_entry* entry);
+			void				_DeselectEntry(select_entry* entry);
+			void				_RemoveEntry(select_entry* entry,
+									bool deselect);
+			void				_RemoveProcessedEntry(select_entry* entry,
+									bool deselect);
+
+private:
+			mutex				fLock;
+				// protects fEntries, and serializes modifications of the
+				// selections
+			spinlock			fReadyLock;
+			SelectEntryTable	fEntries;
+			SelectEntryList		fReadyList;
+			ConditionVariable	fReadyCondition;
+			team_id				fTeam;
+			bool				fClosed;
+};
+
+}	// namespace
+
+
+static void event_queue_notify(select_sync* sync, select_info* info,
+	uint16 events);
+static void event_queue_free(select_sync* sync);
+
+static const select_sync_ops kEventQueueSyncOps = {
+	&event_queue_notify,
+	&event_queue_free
+};
+
+
+// #pragma mark - EventQueue
+
+
+EventQueue::EventQueue(team_id team)
+	:
+	fTeam(team),
+	fClosed(false)
+{
+	ref_count = 1;
+	sem = -1;
+	count = 0;
+	set = NULL;
+	ops = &kEventQueueSyncOps;
+
+	mutex_init(&fLock, "event queue");
+	B_INITIALIZE_SPINLOCK(&fReadyLock);
+	fReadyCondition.Init(this, "event queue");
+}
+
+
+EventQueue::~EventQueue()
+{
+	// All entries have been removed in Close() already.
+	mutex_destroy(&fLock);
+}
+
+
+status_t
+EventQueue::Init()
+{
+	return fEntries.Init();
+}
+
+
+/*!	Adds, changes, or (if \a events is negative) removes the selection of the
+	given object.
+*/
+status_t
+EventQueue::Select(int32 object, uint16 type, int32 events, void* userData)
+{
+	MutexLocker locker(fLock);
+
+	if (fClosed)
+		return B_FILE_ERROR;
+
+	SelectEntryKey key = { object, type };
+	select_entry* entry = fEntries.Lookup(key);
+
+	if (events < 0) {
+		if (entry == NULL)
+			return B_ENTRY_NOT_FOUND;
+
+		_RemoveEntry(entry, true);
+		return B_OK;
+	}
+
+	if (entry != NULL) {
+		// Changing an existing selection: deselect it, and forget about
+		// any pending events.
+		_DeselectEntry(entry);
+
+		InterruptsSpinLocker readyLocker(fReadyLock);
+		if (entry->queued) {
+			fReadyList.Remove(entry);
+			entry->queued = false;
+		}
+	} else {
+		entry = new(std::nothrow) select_entry;
+		if (entry == NULL)
+			return B_NO_MEMORY;
+
+		entry->object = object;
+		entry->type = type;
+		entry->queued = false;
+		fEntries.Insert(entry);
+	}
+
+	entry->requested_events = events;
+	entry->user_data = userData;
+
+	status_t status = _SelectEntry(entry);
+	if (status != B_OK)
+		_RemoveEntry(entry, false);
+
+	return status;
+}
+
+
+ssize_t
+EventQueue::Wait(event_wait_info* infos, int numInfos, uint32 flags,
+	bigtime_t timeout)
+{
+	MutexLocker locker(fLock);
+
+	while (true) {
+		InterruptsSpinLocker readyLocker(fReadyLock);
+
+		if (fReadyList.IsEmpty()) {
+			if (fClosed)
+				return B_FILE_ERROR;
+
+			ConditionVariableEntry waitEntry;
+			fReadyCondition.Add(&waitEntry);
+
+			readyLocker.Unlock();
+			locker.Unlock();
+
+			status_t status = waitEntry.Wait(flags | B_CAN_INTERRUPT, timeout);
+			if (status != B_OK)
+				return status;
+
+			locker.Lock();
+			continue;
+		}
+
+		// The entries are handled one at a time. They stay marked as queued
+		// until they have been processed and re-armed, so that Notify()
+		// won't put them on the ready list again in the meantime.
+		SelectEntryList processedList;
+		int count = 0;
+
+		while (count < numInfos) {
+			select_entry* entry = fReadyList.RemoveHead();
+			if (entry == NULL)
+				break;
+
+			readyLocker.Unlock();
+
+			bool levelTriggered
+				= (entry->requested_events & B_EVENT_LEVEL_TRIGGERED) != 0;
+			if (levelTriggered
+				&& (atomic_get(&entry->events) & B_EVENT_INVALID) == 0) {
+				// Select the object anew to learn about its current state --
+				// if the events are still present, it will notify us right
+				// away.
+				_DeselectEntry(entry);
+				if (_SelectEntry(entry) != B_OK) {
+					_RemoveProcessedEntry(entry, false);
+					readyLocker.Lock();
+					continue;
+				}
+			}
+
+			int32 events = atomic_get_and_set(&entry->events, 0)
+				& ((entry->requested_events & ~kEventFlags)
+					| kAlwaysReportedEvents);
+			if (events != 0) {
+				infos[count].object = entry->object;
+				infos[count].type = entry->type;
+				infos[count].events = events;
+				infos[count].user_data = entry->user_data;
+				count++;
+
+				if ((events & B_EVENT_INVALID) != 0) {
+					// the object is gone, and has already dropped the entry
+					_RemoveProcessedEntry(entry, false);
+					readyLocker.Lock();
+					continue;
+				}
+				if ((entry->requested_events & B_EVENT_ONE_SHOT) != 0) {
+					_RemoveProcessedEntry(entry, true);
+					readyLocker.Lock();
+					continue;
+				}
+			}
+
+			readyLocker.Lock();
+
+			if (levelTriggered && events != 0) {
+				// report it again as long as the events are present; the
+				// next Wait() will poll the object again
+				processedList.Add(entry);
+			} else if ((atomic_get(&entry->events) & entry->selected_events)
+					!= 0) {
+				// notified while we were processing the entry
+				processedList.Add(entry);
+			} else
+				entry->queued = false;
+		}
+
+		fReadyList.MoveFrom(&processedList);
+		readyLocker.Unlock();
+
+		if (count > 0)
+			return count;
+	}
+}
+
+
+/*!	Called when the queue's file descriptor is closed. Removes all
+	selections, and wakes up waiting threads.
+*/
+void
+EventQueue::Close()
+{
+	MutexLocker locker(fLock);
+
+	fClosed = true;
+
+	select_entry* entry = fEntries.Clear(true);
+	while (entry != NULL) {
+		select_entry* next = entry->hash_link;
+
+		_DeselectEntry(entry);
+
+		InterruptsSpinLocker readyLocker(fReadyLock);
+		if (entry->queued)
+			fReadyList.Remove(entry);
+		readyLocker.Unlock();
+
+		delete entry;
+		entry = next;
+	}
+
+	InterruptsSpinLocker readyLocker(fReadyLock);
+	fReadyCondition.NotifyAll(B_FILE_ERROR);
+}
+
+
+/*!	Called via notify_select_events(), possibly with interrupts disabled.
+*/
+void
+EventQueue::Notify(select_entry* entry, uint16 events)
+{
+	InterruptsSpinLocker locker(fReadyLock);
+
+	if ((events & B_EVENT_INVALID) != 0)
+		entry->detached = true;
+
+	if (entry->queued || (events & entry->selected_events) == 0)
+		return;
+
+	entry->queued = true;
+	fReadyList.Add(entry);
+	fReadyCondition.NotifyAll();
+}
+
+
+status_t
+EventQueue::_SelectEntry(select_entry* entry)
+{
+	entry->next = NULL;
+	entry->sync = this;
+	entry->events = 0;
+	entry->selected_events = (entry->requested_events & 0xffff)
+		| kAlwaysReportedEvents;
+
+	InterruptsSpinLocker readyLocker(fReadyLock);
+	entry->detached = false;
+	readyLocker.Unlock();
+
+	TRACE("select object %" B_PRId32 ", type %u, events %#" B_PRIx32 "\n",
+		entry->object, entry->type, entry->requested_events);
+
+	return select_object(entry->type, entry->object, entry, false);
+}
+
+
+void
+EventQueue::_DeselectEntry(select_entry* entry)
+{
+	InterruptsSpinLocker readyLocker(fReadyLock);
+	bool detached = entry->detached;
+	readyLocker.Unlock();
+
+	if (!detached)
+		deselect_object(entry->type, entry->object, entry, false);
+}
+
+
+/*!	Removes an entry that Wait() has taken off the ready list, and that is
+	therefore still marked as queued.
+*/
+void
+EventQueue::_RemoveProcessedEntry(select_entry* entry, bool deselect)
+{
+	InterruptsSpinLocker readyLocker(fReadyLock);
+	entry->queued = false;
+	readyLocker.Unlock();
+
+	_RemoveEntry(entry, deselect);
+}
+
+
+void
+EventQueue::_RemoveEntry(select_entry* entry, bool deselect)
+{
+	if (deselect)
+		_DeselectEntry(entry);
+
+	InterruptsSpinLocker readyLocker(fReadyLock);
+	if (entry->queued)
+		fReadyList.Remove(entry);
+	readyLocker.Unlock();
+
+	fEntries.Remove(entry);
+	delete entry;
+}
+
+
+// #pragma mark - select_sync hooks
+
+
+static void
+event_queue_notify(select_sync* sync, select_info* info, uint16 events)
+{
+	static_cast<EventQueue*>(sync)->Notify(static_cast<select_entry*>(info),
+		events);
+}
+
+
+static void
+event_queue_free(select_sync* sync)
+{
+	delete static_cast<EventQueue*>(sync);
+}
+
+
+// #pragma mark - file descriptor
+
+
+static status_t
+event_queue_close(file_descriptor* descriptor)
+{
+	((EventQueue*)descriptor->cookie)->Close();
+	return B_OK;
+}
+
+
+static void
+event_queue_free_fd(file_descriptor* descriptor)
+{
+	put_select_sync((EventQueue*)descriptor->cookie);
+}
+
+
+static struct fd_ops sEventQueueFDOps = {
+	NULL,	// fd_read
+	NULL,	// fd_write
+	NULL,	// fd_seek
+	NULL,	// fd_ioctl
+	NULL,	// fd_set_flags
+	NULL,	// fd_select
+	NULL,	// fd_deselect
+	NULL,	// fd_read_dir
+	NULL,	// fd_rewind_dir
+	NULL,	// fd_read_stat
+	NULL,	// fd_write_stat
+	&event_queue_close,
+	&event_queue_free_fd
+};
+
+
+static status_t
+get_event_queue(int fd, file_descriptor*& _descriptor, EventQueue*& _queue)
+{
+	file_descriptor* descriptor = get_fd(get_current_io_context(false), fd);
+	if (descriptor == NULL)
+		return B_FILE_ERROR;
+
+	if (descriptor->type != FDTYPE_EVENT_QUEUE) {
+		put_fd(descriptor);
+		return B_BAD_VALUE;
+	}
+
+	// The selected file descriptors refer to the team that created the
+	// queue, so no other team can use it.
+	EventQueue* queue = (EventQueue*)descriptor->cookie;
+	if (queue->Team() != team_get_current_team_id()) {
+		put_fd(descriptor);
+		return B_NOT_ALLOWED;
+	}
+
+	_descriptor = descriptor;
+	_queue = queue;
+	return B_OK;
+}
+
+
+// #pragma mark - syscalls
+
+
+int
+_user_event_queue_create(int openFlags)
+{
+	if ((openFlags & ~O_CLOEXEC) != 0)
+		return B_BAD_VALUE;
+
+	EventQueue* queue = new(std::nothrow) EventQueue(
+		team_get_current_team_id());
+	if (queue == NULL)
+		return B_NO_MEMORY;
+
+	status_t status = queue->Init();
+	if (status != B_OK) {
+		put_select_sync(queue);
+		return status;
+	}
+
+	file_descriptor* descriptor = alloc_fd();
+	if (descriptor == NULL) {
+		put_select_sync(queue);
+		return B_NO_MEMORY;
+	}
+
+	descriptor->type = FDTYPE_EVENT_QUEUE;
+	descriptor->ops = &sEventQueueFDOps;
+	descriptor->cookie = queue;
+	descriptor->open_mode = O_RDWR;
+
+	io_context* context = get_current_io_context(false);
+	int fd = new_fd(context, descriptor);
+	if (fd < 0) {
+		free(descriptor);
+		put_select_sync(queue);
+		return fd;
+	}
+
+	if ((openFlags & O_CLOEXEC) != 0)
+		fd_set_close_on_exec(context, fd, true);
+
+	return fd;
+}
+
+
+ssize_t
+_user_event_queue_select(int fd, event_wait_info* userInfos, int numInfos)
+{
+	if (numInfos <= 0 || numInfos > EVENT_QUEUE_MAX_INFOS)
+		return B_BAD_VALUE;
+	if (userInfos == NULL || !IS_USER_ADDRESS(userInfos))
+		return B_BAD_ADDRESS;
+
+	file_descriptor* descriptor;
+	EventQueue* queue;
+	status_t status = get_event_queue(fd, descriptor, queue);
+	if (status != B_OK)
+		return status;
+
+	// An error is only returned if not even the first info could be
+	// processed.
+	int processed = 0;
+	for (; processed < numInfos; processed++) {
+		event_wait_info info;
+		if (user_memcpy(&info, userInfos + processed, sizeof(info)) != B_OK) {
+			status = B_BAD_ADDRESS;
+			break;
+		}
+
+		status = queue->Select(info.object, info.type, info.events,
+			info.user_data);
+		if (status != B_OK)
+			break;
+	}
+
+	put_fd(descriptor);
+
+	return processed > 0 ? processed : status;
+}
+
+
+ssize_t
+_user_event_queue_wait(int fd, event_wait_info* userInfos, int numInfos,
+	uint32 flags, bigtime_t timeout)
+{
+	syscall_restart_handle_timeout_pre(flags, timeout);
+
+	if (numInfos <= 0)
+		return B_BAD_VALUE;
+	if (userInfos == NULL || !IS_USER_ADDRESS(userInfos))
+		return B_BAD_ADDRESS;
+
+	numInfos = min_c(numInfos, EVENT_QUEUE_MAX_INFOS);
+
+	file_descriptor* descriptor;
+	EventQueue* queue;
+	status_t status = get_event_queue(fd, descriptor, queue);
+	if (status != B_OK)
+		return status;
+
+	event_wait_info* infos
+		= (event_wait_info*)malloc(sizeof(event_wait_info) * numInfos);
+	if (infos == NULL) {
+		put_fd(descriptor);
+		return B_NO_MEMORY;
+	}
+	MemoryDeleter infosDeleter(infos);
+
+	ssize_t result = queue->Wait(infos, numInfos,
+		flags & (B_RELATIVE_TIMEOUT | B_ABSOLUTE_TIMEOUT), timeout);
+
+	put_fd(descriptor);
+
+	if (result < 0)
+		return syscall_restart_handle_timeout_post(result, timeout);
+
+	if (user_memcpy(userInfos, infos, sizeof(event_wait_info) * result)
+			!= B_OK) {
+		return B_BAD_ADDRESS;
+	}
+
+	return result;
+}
@@ -50,7 +50,11 @@ EntryCacheGeneration::Init()
 
 EntryCache::EntryCache()
 	:
-	fCurrentGeneration(0)
+	fCurrentGeneration(0),
+	fMissingCount(0),
+	fHits(0),
+	fMissingHits(0),
+	fMisses(0)
 {
 	rw_lock_init(&fLock, "entry cache");
 
@@ -98,6 +102,8 @@ EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID, bool missing)
 
 	EntryCacheEntry* entry = fEntries.Lookup(key);
 	if (entry != NULL) {
+		if (entry->missing != missing)
+			fMissingCount += missing ? 1 : -1;
 		entry->node_id = nodeID;
 		entry->missing = missing;
 		if (entry->generation != fCurrentGeneration) {
@@ -121,6 +127,8 @@ EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID, bool missing)
 	strcpy(entry->name, name);
 
 	fEntries.Insert(entry);
+	if (missing)
+		fMissingCount++;
 
 	_AddEntryToCurrentGeneration(entry);
 
@@ -140,6 +148,8 @@ EntryCache::Remove(ino_t dirID, const char* name)
 		return B_ENTRY_NOT_FOUND;
 
 	fEntries.Remove(entry);
+	if (entry->missing)
+		fMissingCount--;
 
 	if (entry->index >= 0) {
 		// remove the entry from its generation and delete it
@@ -165,8 +175,12 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
 	ReadLocker readLocker(fLock);
 
 	EntryCacheEntry* entry = fEntries.Lookup(key);
-	if (entry == NULL)
+	if (entry == NULL) {
+		atomic_add64(&fMisses, 1);
 		return false;
+	}
+
+	atomic_add64(entry->missing ? &fMissingHits : &fHits, 1);
 
 	int32 oldGeneration = atomic_get_and_set(&entry->generation,
 			fCurrentGeneration);
@@ -183,7 +197,7 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
 	entry->index = kEntryNotInArray;
 
 	// add to the current generation
-	int32 index = atomic_add(&fGenerations[oldGeneration].next_index, 1);
+	int32 index = atomic_add(&fGenerations[fCurrentGeneration].next_index, 1);
 	if (index < kEntriesPerGeneration) {
 		fGenerations[fCurrentGeneration].entries[index] = entry;
 		entry->index = index;
@@ -211,6 +225,50 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
 }
 
 
+/*!	Frees the entries of missing nodes, to give memory back when it is
+	getting low. Unless \a all is \c true, the entries of the current
+	generation are kept. Returns the number of entries removed.
+*/
+int32
+EntryCache::RemoveMissingEntries(bool all)
+{
+	WriteLocker writeLocker(fLock);
+
+	int32 removed = 0;
+	for (int32 i = 0; i < kGenerationCount && fMissingCount > 0; i++) {
+		if (i == fCurrentGeneration && !all)
+			continue;
+
+		EntryCacheGeneration& generation = fGenerations[i];
+		int32 count = min_c(generation.next_index, kEntriesPerGeneration);
+		for (int32 k = 0; k < count; k++) {
+			EntryCacheEntry* entry = generation.entries[k];
+			if (entry == NULL || !entry->missing)
+				continue;
+
+			generation.entries[k] = NULL;
+			_FreeEntry(entry);
+			removed++;
+		}
+	}
+
+	return removed;
+}
+
+
+void
+EntryCache::GetStatistics(entry_cache_stats& stats)
+{
+	ReadLocker readLocker(fLock);
+
+	stats.hits = atomic_get64(&fHits);
+	stats.missing_hits = atomic_get64(&fMissingHits);
+	stats.misses = atomic_get64(&fMisses);
+	stats.entries = fEntries.CountElements();
+	stats.missing_entries = fMissingCount;
+}
+
+
 const char*
 EntryCache::DebugReverseLookup(ino_t nodeID, ino_t& _dirID)
 {
@@ -247,8 +305,7 @@ EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 			continue;
 
 		fGenerations[newGeneration].entries[i] = NULL;
-		fEntries.Remove(otherEntry);
-		free(otherEntry);
+		_FreeEntry(otherEntry);
 	}
 
 	// set the new generation and add the entry
@@ -258,3 +315,17 @@ EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 	entry->generation = newGeneration;
 	entry->index = 0;
 }
+
+
+/*!	Removes \a entry, which must not be in a generation array anymore, from
+	the table and frees it.
+*/
+void
+EntryCache::_FreeEntry(EntryCacheEntry* entry)
+{
+	fEntries.Remove(entry);
+	if (entry->missing)
+		fMissingCount--;
+
+	free(entry);
+}
@@ -80,6 +80,15 @@ struct EntryCacheHashDefinition {
 };
 
 
+struct entry_cache_stats {
+	uint64		hits;
+	uint64		missing_hits;
+	uint64		misses;
+	uint32		entries;
+	uint32		missing_entries;
+};
+
+
 class EntryCache {
 public:
 								EntryCache();
@@ -95,6 +104,10 @@ public:
 			bool				Lookup(ino_t dirID, const char* name,
 									ino_t& nodeID, bool& missing);
 
+			int32				RemoveMissingEntries(bool all);
+
+			void				GetStatistics(entry_cache_stats& stats);
+
 			const char*			DebugReverseLookup(ino_t nodeID, ino_t& _dirID);
 
 private:
@@ -106,12 +119,17 @@ private:
 private:
 			void				_AddEntryToCurrentGeneration(
 									EntryCacheEntry* entry);
+			void				_FreeEntry(EntryCacheEntry* entry);
 
 private:
 			rw_lock				fLock;
 			EntryTable			fEntries;
 			EntryCacheGeneration fGenerations[kGenerationCount];
 			int32				fCurrentGeneration;
+			int32				fMissingCount;
+			int64				fHits;
+			int64				fMissingHits;
+			int64				fMisses;
 };
 
 
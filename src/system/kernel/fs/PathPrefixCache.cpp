@@ -0,0 +1,191 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "PathPrefixCache.h"
+
+#include <new>
+
+
+PathPrefixCache::PathPrefixCache()
+	:
+	fEntryCount(0),
+	fGeneration(0),
+	fHits(0),
+	fMisses(0),
+	fInvalidations(0)
+{
+	rw_lock_init(&fLock, "path prefix cache");
+
+	new(&fEntries) EntryTable;
+}
+
+
+PathPrefixCache::~PathPrefixCache()
+{
+	Clear();
+
+	rw_lock_destroy(&fLock);
+}
+
+
+status_t
+PathPrefixCache::Init()
+{
+	return fEntries.Init();
+}
+
+
+bool
+PathPrefixCache::Lookup(const PathPrefixCacheKey& key, dev_t& _device,
+	ino_t& _node)
+{
+	ReadLocker readLocker(fLock);
+
+	PathPrefixCacheEntry* entry = fEntries.Lookup(key);
+	if (entry == NULL || entry->generation != atomic_get(&fGeneration)) {
+		atomic_add64(&fMisses, 1);
+		return false;
+	}
+
+	if (atomic_get(&entry->referenced) == 0)
+		atomic_set(&entry->referenced, 1);
+
+	_device = entry->device;
+	_node = entry->node;
+
+	atomic_add64(&fHits, 1);
+	return true;
+}
+
+
+/*!	Creates an entry for the given key, to be added once the walk has resolved
+	the prefix. The entry remembers the current generation, so that it won't be
+	added anymore, if anything is invalidated during the walk.
+*/
+PathPrefixCacheEntry*
+PathPrefixCache::CreateEntry(const PathPrefixCacheKey& key)
+{
+	PathPrefixCacheEntry* entry = (PathPrefixCacheEntry*)malloc(
+		sizeof(PathPrefixCacheEntry) + key.length);
+	if (entry == NULL)
+		return NULL;
+
+	new(entry) PathPrefixCacheEntry;
+	entry->hash = key.hash;
+	entry->start_device = key.start_device;
+	entry->start_node = key.start_node;
+	entry->user_id = key.user_id;
+	entry->group_id = key.group_id;
+	entry->generation = atomic_get(&fGeneration);
+	entry->referenced = 0;
+	entry->length = key.length;
+	memcpy(entry->path, key.path, key.length);
+	entry->path[key.length] = '\0';
+
+	return entry;
+}
+
+
+/*!	Adds an entry created by CreateEntry() that resolves to the given node.
+	The cache takes over ownership of the entry.
+*/
+void
+PathPrefixCache::Add(PathPrefixCacheEntry* entry, dev_t device, ino_t node)
+{
+	entry->device = device;
+	entry->node = node;
+
+	WriteLocker writeLocker(fLock);
+
+	if (entry->generation != fGeneration) {
+		writeLocker.Unlock();
+		DeleteEntry(entry);
+		return;
+	}
+
+	PathPrefixCacheKey key(entry->start_device, entry->start_node,
+		entry->user_id, entry->group_id, entry->path, entry->length);
+	PathPrefixCacheEntry* existing = fEntries.Lookup(key);
+	if (existing != NULL)
+		_RemoveEntry(existing);
+	else if (fEntryCount >= kMaxEntries)
+		_Evict();
+
+	fEntries.Insert(entry);
+	fEntryList.Add(entry);
+	fEntryCount++;
+}
+
+
+void
+PathPrefixCache::DeleteEntry(PathPrefixCacheEntry* entry)
+{
+	entry->~PathPrefixCacheEntry();
+	free(entry);
+}
+
+
+/*!	Invalidates all entries. They are removed lazily, when new entries need
+	room.
+*/
+void
+PathPrefixCache::Invalidate()
+{
+	atomic_add(&fGeneration, 1);
+	atomic_add64(&fInvalidations, 1);
+}
+
+
+void
+PathPrefixCache::Clear()
+{
+	WriteLocker writeLocker(fLock);
+
+	while (PathPrefixCacheEntry* entry = fEntryList.Head())
+		_RemoveEntry(entry);
+}
+
+
+void
+PathPrefixCache::GetStatistics(path_prefix_cache_stats& stats)
+{
+	stats.hits = atomic_get64(&fHits);
+	stats.misses = atomic_get64(&fMisses);
+	stats.invalidations = atomic_get64(&fInvalidations);
+	stats.entries = fEntryCount;
+}
+
+
+void
+PathPrefixCache::_RemoveEntry(PathPrefixCacheEntry* entry)
+{
+	fEntries.Remove(entry);
+	fEntryList.Remove(entry);
+	fEntryCount--;
+
+	DeleteEntry(entry);
+}
+
+
+/*!	Removes one entry to make room for a new one. Entries that have been used
+	since they were last looked at get a second chance, invalidated ones don't.
+	The caller must hold the write lock.
+*/
+void
+PathPrefixCache::_Evict()
+{
+	while (PathPrefixCacheEntry* entry = fEntryList.Head()) {
+		if (entry->generation == fGeneration && entry->referenced != 0) {
+			entry->referenced = 0;
+			fEntryList.Remove(entry);
+			fEntryList.Add(entry);
+			continue;
+		}
+
+		_RemoveEntry(entry);
+		return;
+	}
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef PATH_PREFIX_CACHE_H
+#define PATH_PREFIX_CACHE_H
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/AutoLock.h>
+#include <util/DoublyLinkedList.h>
+#include <util/OpenHashTable.h>
+#include <util/StringHash.h>
+
+
+struct PathPrefixCacheKey {
+	PathPrefixCacheKey(dev_t startDevice, ino_t startNode, uid_t userID,
+		gid_t groupID, const char* path, size_t length)
+		:
+		start_device(startDevice),
+		start_node(startNode),
+		user_id(userID),
+		group_id(groupID),
+		path(path),
+		length(length)
+	{
+		hash = (uint32)start_node ^ (uint32)(start_node >> 32)
+			^ (uint32)start_device ^ hash_hash_string_part(path, length)
+			^ length;
+	}
+
+	dev_t		start_device;
+	ino_t		start_node;
+	uid_t		user_id;
+	gid_t		group_id;
+	const char*	path;
+	size_t		length;
+	uint32		hash;
+};
+
+
+struct PathPrefixCacheEntry
+	: DoublyLinkedListLinkImpl<PathPrefixCacheEntry> {
+			PathPrefixCacheEntry* hash_link;
+			uint32				hash;
+			dev_t				start_device;
+			ino_t				start_node;
+			uid_t				user_id;
+			gid_t				group_id;
+			dev_t				device;
+			ino_t				node;
+			int32				generation;
+			int32				referenced;
+			size_t				length;
+			char				path[1];
+};
+
+
+struct PathPrefixCacheHashDefinition {
+	typedef PathPrefixCacheKey		KeyType;
+	typedef PathPrefixCacheEntry	ValueType;
+
+	uint32 HashKey(const PathPrefixCacheKey& key) const
+	{
+		return key.hash;
+	}
+
+	size_t Hash(const PathPrefixCacheEntry* value) const
+	{
+		return value->hash;
+	}
+
+	bool Compare(const PathPrefixCacheKey& key,
+		const PathPrefixCacheEntry* value) const
+	{
+		return value->hash == key.hash
+			&& value->start_node == key.start_node
+			&& value->start_device == key.start_device
+			&& value->user_id == key.user_id
+			&& value->group_id == key.group_id
+			&& value->length == key.length
+			&& memcmp(value->path, key.path, key.length) == 0;
+	}
+
+	PathPrefixCacheEntry*& GetLink(PathPrefixCacheEntry* value) const
+	{
+		return value->hash_link;
+	}
+};
+
+
+struct path_prefix_cache_stats {
+	uint64		hits;
+	uint64		misses;
+	uint64		invalidations;
+	uint32		entries;
+};
+
+
+/*!	Maps directory prefixes of paths, relative to a start directory, to the
+	directory they resolve to, so that the path walker doesn't need to look up
+	each of their components again.
+
+	An entry is only valid for the credentials the walk was done with, since
+	those decide whether the directories on the way may be searched. Any change
+	that could alter the result of a walk invalidates all entries at once.
+*/
+class PathPrefixCache {
+public:
+								PathPrefixCache();
+								~PathPrefixCache();
+
+			status_t			Init();
+
+			bool				Lookup(const PathPrefixCacheKey& key,
+									dev_t& _device, ino_t& _node);
+
+			PathPrefixCacheEntry* CreateEntry(const PathPrefixCacheKey& key);
+			void				Add(PathPrefixCacheEntry* entry, dev_t device,
+									ino_t node);
+			void				DeleteEntry(PathPrefixCacheEntry* entry);
+
+			void				Invalidate();
+			void				Clear();
+
+			void				GetStatistics(path_prefix_cache_stats& stats);
+
+private:
+	static	const uint32		kMaxEntries = 8192;
+
+			typedef BOpenHashTable<PathPrefixCacheHashDefinition> EntryTable;
+			typedef DoublyLinkedList<PathPrefixCacheEntry> EntryList;
+
+private:
+			void				_RemoveEntry(PathPrefixCacheEntry* entry);
+			void				_Evict();
+
+private:
+			rw_lock				fLock;
+			EntryTable			fEntries;
+			EntryList			fEntryList;
+				// in insertion order, scanned in a clock-like fashion
+			uint32				fEntryCount;
+			int32				fGeneration;
+			int64				fHits;
+			int64				fMisses;
+			int64				fInvalidations;
+};
+
+
+#endif	// PATH_PREFIX_CACHE_H
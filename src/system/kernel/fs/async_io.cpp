@@ -0,0 +1,786 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Submission/completion queue style asynchronous file I/O.
+
+	An async I/O context is a file descriptor that requests can be submitted
+	to in batches, and whose completions can be reaped in batches as well.
+	The context is readable (in terms of select()/poll()/wait_for_objects())
+	while there are completions to be reaped.
+
+	Requests on devices without a cache whose driver implements the io() hook
+	are passed as IORequests directly to the device, and don't occupy a
+	thread while in flight. All other requests have to go through the file
+	system's (and file cache's) usual read/write hooks; they are executed by
+	a small pool of kernel threads that belong to the team that created the
+	context, so that they can access its buffers.
+*/
+
+
+#include <fs/async_io.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+
+#include <new>
+
+#include <condition_variable.h>
+#include <fs/fd.h>
+#include <fs/select_sync_pool.h>
+#include <kernel.h>
+#include <lock.h>
+#include <Referenceable.h>
+#include <syscall_restart.h>
+#include <team.h>
+#include <thread.h>
+#include <util/AutoLock.h>
+#include <util/DoublyLinkedList.h>
+#include <vfs.h>
+#include <wait_for_objects.h>
+
+#include "IORequest.h"
+
+
+//#define TRACE_ASYNC_IO
+#ifdef TRACE_ASYNC_IO
+#	define TRACE(x...) dprintf("async_io: " x)
+#else
+#	define TRACE(x...) ;
+#endif
+
+
+static const int32 kMaxWorkerThreads = 4;
+static const bigtime_t kWorkerIdleTimeout = 1000000;
+static const size_t kMaxRequestsPerCopy = 32;
+
+
+namespace {
+
+class AsyncIOContext;
+
+
+class AsyncIOOperation : public AsyncIOCallback,
+	public DoublyLinkedListLinkImpl<AsyncIOOperation> {
+public:
+								AsyncIOOperation(AsyncIOContext* context,
+									file_descriptor* descriptor,
+									const async_io_request& request);
+	virtual						~AsyncIOOperation();
+
+			bool				IsWrite() const
+									{ return fRequest.operation
+										== ASYNC_IO_WRITE; }
+
+			void				Execute();
+			void				GetCompletion(
+									async_io_completion& completion) const;
+
+	virtual	void				IOFinished(status_t status,
+									bool partialTransfer,
+									generic_size_t bytesTransferred);
+
+private:
+	friend class AsyncIOContext;
+
+			AsyncIOContext*		fContext;
+			file_descriptor*	fDescriptor;
+			async_io_request	fRequest;
+			status_t			fStatus;
+			generic_size_t		fTransferred;
+			bool				fSubmitting;
+			bool				fFinished;
+				// both protected by the context's lock
+};
+
+typedef DoublyLinkedList<AsyncIOOperation> OperationList;
+
+
+class AsyncIOContext : public BReferenceable {
+public:
+								AsyncIOContext(team_id team,
+									uint32 maxRequests);
+	virtual						~AsyncIOContext();
+
+			team_id				Team() const	{ return fTeam; }
+
+			status_t			Submit(const async_io_request& request);
+			ssize_t				Reap(async_io_completion* userCompletions,
+									size_t count, size_t minCount,
+									uint32 flags, bigtime_t timeout);
+			void				Close();
+
+			void				OperationFinished(
+									AsyncIOOperation* operation);
+
+			status_t			Select(uint8 event, selectsync* sync);
+			status_t			Deselect(uint8 event, selectsync* sync);
+
+private:
+			void				_AddCompletedOperation(
+									AsyncIOOperation* operation);
+			void				_QueueOperation(AsyncIOOperation* operation);
+	static	status_t			_WorkerThread(void* data);
+			void				_Worker();
+
+private:
+			mutex				fLock;
+			team_id				fTeam;
+			uint32				fMaxRequests;
+			uint32				fRequestCount;
+				// submitted, but not yet reaped
+			OperationList		fQueuedOperations;
+			OperationList		fCompletedOperations;
+			ConditionVariable	fWorkCondition;
+			ConditionVariable	fCompletionCondition;
+			select_sync_pool*	fSelectPool;
+			int32				fWorkerCount;
+			int32				fIdleWorkerCount;
+			bool				fClosed;
+};
+
+}	// namespace
+
+
+// #pragma mark - AsyncIOOperation
+
+
+AsyncIOOperation::AsyncIOOperation(AsyncIOContext* context,
+	file_descriptor* descriptor, const async_io_request& request)
+	:
+	fContext(context),
+	fDescriptor(descriptor),
+	fRequest(request),
+	fStatus(B_OK),
+	fTransferred(0),
+	fSubmitting(false),
+	fFinished(false)
+{
+}
+
+
+AsyncIOOperation::~AsyncIOOperation()
+{
+	put_fd(fDescriptor);
+}
+
+
+/*!	Executes the operation synchronously through the descriptor's read or
+	write hook. Must be called by a thread of the team the buffer belongs to.
+*/
+void
+AsyncIOOperation::Execute()
+{
+	size_t length = fRequest.length;
+	status_t status;
+	if (IsWrite()) {
+		status = fDescriptor->ops->fd_write(fDescriptor, fRequest.offset,
+			fRequest.buffer, &length);
+	} else {
+		status = fDescriptor->ops->fd_read(fDescriptor, fRequest.offset,
+			fRequest.buffer, &length);
+	}
+
+	IOFinished(status, status != B_OK || length < fRequest.length,
+		status == B_OK ? length : 0);
+}
+
+
+void
+AsyncIOOperation::GetCompletion(async_io_completion& completion) const
+{
+	completion.cookie = fRequest.cookie;
+	completion.status = fStatus;
+	completion.transferred = fTransferred;
+}
+
+
+void
+AsyncIOOperation::IOFinished(status_t status, bool partialTransfer,
+	generic_size_t bytesTransferred)
+{
+	TRACE("operation %p finished: %s, %" B_PRIuGENADDR " bytes\n", this,
+		strerror(status), bytesTransferred);
+
+	fStatus = status;
+	fTransferred = bytesTransferred;
+
+	// Note, this might delete the context, but not ourselves
+	fContext->OperationFinished(this);
+}
+
+
+// #pragma mark - AsyncIOContext
+
+
+AsyncIOContext::AsyncIOContext(team_id team, uint32 maxRequests)
+	:
+	fTeam(team),
+	fMaxRequests(maxRequests),
+	fRequestCount(0),
+	fSelectPool(NULL),
+	fWorkerCount(0),
+	fIdleWorkerCount(0),
+	fClosed(false)
+{
+	mutex_init(&fLock, "async io context");
+	fWorkCondition.Init(this, "async io work");
+	fCompletionCondition.Init(this, "async io completion");
+}
+
+
+AsyncIOContext::~AsyncIOContext()
+{
+	while (AsyncIOOperation* operation = fCompletedOperations.RemoveHead())
+		delete operation;
+
+	mutex_destroy(&fLock);
+}
+
+
+status_t
+AsyncIOContext::Submit(const async_io_request& request)
+{
+	if (request.operation != ASYNC_IO_READ
+		&& request.operation != ASYNC_IO_WRITE) {
+		return B_BAD_VALUE;
+	}
+	if (request.offset < 0 || request.length > SSIZE_MAX)
+		return B_BAD_VALUE;
+	if (!IS_USER_ADDRESS(request.buffer)
+		|| !IS_USER_ADDRESS((addr_t)request.buffer + request.length)) {
+		return B_BAD_ADDRESS;
+	}
+
+	bool isWrite = request.operation == ASYNC_IO_WRITE;
+
+	file_descriptor* descriptor = get_fd(get_current_io_context(false),
+		request.fd);
+	if (descriptor == NULL)
+		return B_FILE_ERROR;
+
+	if ((descriptor->open_mode & O_DISCONNECTED) != 0
+		|| (isWrite ? (descriptor->open_mode & O_RWMASK) == O_RDONLY
+			: (descriptor->open_mode & O_RWMASK) == O_WRONLY)) {
+		put_fd(descriptor);
+		return B_FILE_ERROR;
+	}
+
+	if (isWrite ? descriptor->ops->fd_write == NULL
+			: descriptor->ops->fd_read == NULL) {
+		put_fd(descriptor);
+		return B_BAD_VALUE;
+	}
+
+	AsyncIOOperation* operation = new(std::nothrow) AsyncIOOperation(this,
+		descriptor, request);
+	if (operation == NULL) {
+		put_fd(descriptor);
+		return B_NO_MEMORY;
+	}
+
+	MutexLocker locker(fLock);
+
+	if (fClosed) {
+		locker.Unlock();
+		delete operation;
+		return B_FILE_ERROR;
+	}
+	if (fRequestCount >= fMaxRequests) {
+		locker.Unlock();
+		delete operation;
+		return B_WOULD_BLOCK;
+	}
+
+	fRequestCount++;
+
+	// the operation keeps us alive until it is finished
+	AcquireReference();
+
+	struct vnode* vnode = fd_vnode(descriptor);
+	if (vnode == NULL || !vfs_can_do_direct_io(vnode)) {
+		_QueueOperation(operation);
+		return B_OK;
+	}
+
+	// Until the request has been passed on, the operation is only marked
+	// finished, so that it can't be reaped and deleted under us.
+	operation->fSubmitting = true;
+	locker.Unlock();
+
+	// Pass the request on to the device
+	generic_io_vec vec;
+	vec.base = (generic_addr_t)request.buffer;
+	vec.length = request.length;
+
+	IORequest* ioRequest = IORequest::Create(false);
+	status_t status = ioRequest != NULL ? B_OK : B_NO_MEMORY;
+	if (status == B_OK) {
+		status = ioRequest->Init(request.offset, &vec, 1, request.length,
+			isWrite, B_DELETE_IO_REQUEST);
+		if (status != B_OK) {
+			delete ioRequest;
+			ioRequest = NULL;
+		}
+	}
+	if (status == B_OK) {
+		ioRequest->SetFinishedCallback(&AsyncIOCallback::IORequestCallback,
+			operation);
+		status = vfs_vnode_io(vnode, descriptor->cookie, ioRequest);
+	}
+
+	locker.Lock();
+
+	if (status != B_OK && !operation->fFinished) {
+		// The request failed without having been notified -- do that now,
+		// so that neither it nor the operation is leaked.
+		if (ioRequest != NULL) {
+			locker.Unlock();
+			ioRequest->SetStatusAndNotify(status);
+			locker.Lock();
+		}
+		if (!operation->fFinished) {
+			operation->fStatus = status;
+			operation->fTransferred = 0;
+			operation->fFinished = true;
+		}
+	}
+
+	operation->fSubmitting = false;
+	if (!operation->fFinished)
+		return B_OK;
+
+	_AddCompletedOperation(operation);
+	locker.Unlock();
+
+	ReleaseReference();
+	return B_OK;
+}
+
+
+ssize_t
+AsyncIOContext::Reap(async_io_completion* userCompletions, size_t count,
+	size_t minCount, uint32 flags, bigtime_t timeout)
+{
+	if (minCount > count)
+		minCount = count;
+
+	flags = B_CAN_INTERRUPT
+		| (flags & (B_RELATIVE_TIMEOUT | B_ABSOLUTE_TIMEOUT));
+
+	MutexLocker locker(fLock);
+
+	size_t reaped = 0;
+	while (reaped < count) {
+		AsyncIOOperation* operation = fCompletedOperations.RemoveHead();
+		if (operation == NULL) {
+			if (reaped >= minCount)
+				break;
+			if (fClosed)
+				return reaped > 0 ? (ssize_t)reaped : B_FILE_ERROR;
+
+			ConditionVariableEntry entry;
+			fCompletionCondition.Add(&entry);
+			locker.Unlock();
+
+			status_t status = entry.Wait(flags, timeout);
+
+			locker.Lock();
+
+			if (status != B_OK) {
+				if (reaped > 0)
+					break;
+				return status;
+			}
+			continue;
+		}
+
+		locker.Unlock();
+
+		async_io_completion completion;
+		operation->GetCompletion(completion);
+
+		if (user_memcpy(userCompletions + reaped, &completion,
+				sizeof(async_io_completion)) != B_OK) {
+			// leave the completion for the next attempt
+			locker.Lock();
+			fCompletedOperations.Add(operation, false);
+			return reaped > 0 ? (ssize_t)reaped : B_BAD_ADDRESS;
+		}
+
+		delete operation;
+		reaped++;
+
+		locker.Lock();
+		fRequestCount--;
+	}
+
+	return reaped;
+}
+
+
+/*!	Called when the context's file descriptor is closed. Operations that
+	haven't been started yet are canceled, running ones will still complete,
+	but can no longer be reaped.
+*/
+void
+AsyncIOContext::Close()
+{
+	MutexLocker locker(fLock);
+
+	fClosed = true;
+
+	while (AsyncIOOperation* operation = fQueuedOperations.RemoveHead()) {
+		operation->fStatus = B_CANCELED;
+		fCompletedOperations.Add(operation);
+		ReleaseReference();
+			// can't be the last one, as the descriptor still has one
+	}
+
+	fWorkCondition.NotifyAll();
+	fCompletionCondition.NotifyAll(B_FILE_ERROR);
+}
+
+
+void
+AsyncIOContext::OperationFinished(AsyncIOOperation* operation)
+{
+	MutexLocker locker(fLock);
+
+	operation->fFinished = true;
+	if (operation->fSubmitting) {
+		// Submit() will take care of it
+		return;
+	}
+
+	_AddCompletedOperation(operation);
+
+	locker.Unlock();
+
+	ReleaseReference();
+}
+
+
+status_t
+AsyncIOContext::Select(uint8 event, selectsync* sync)
+{
+	MutexLocker locker(fLock);
+
+	if (event != B_SELECT_READ) {
+		// we're never writable, and don't report errors
+		return B_OK;
+	}
+
+	status_t error = add_select_sync_pool_entry(&fSelectPool, sync, event);
+	if (error != B_OK)
+		return error;
+
+	if (!fCompletedOperations.IsEmpty() || fClosed)
+		notify_select_event(sync, event);
+
+	return B_OK;
+}
+
+
+status_t
+AsyncIOContext::Deselect(uint8 event, selectsync* sync)
+{
+	MutexLocker locker(fLock);
+
+	if (event != B_SELECT_READ)
+		return B_OK;
+
+	return remove_select_sync_pool_entry(&fSelectPool, sync, event);
+}
+
+
+/*!	Makes a finished operation available to Reap(). The caller must hold the
+	lock.
+*/
+void
+AsyncIOContext::_AddCompletedOperation(AsyncIOOperation* operation)
+{
+	fCompletedOperations.Add(operation);
+
+	fCompletionCondition.NotifyAll();
+	if (fSelectPool != NULL)
+		notify_select_event_pool(fSelectPool, B_SELECT_READ);
+}
+
+
+/*!	Queues an operation for one of the worker threads, and starts a new one
+	if all of the existing ones are busy.
+	The caller must hold the lock; the operation is executed right away by
+	the calling thread if no worker could be started at all.
+*/
+void
+AsyncIOContext::_QueueOperation(AsyncIOOperation* operation)
+{
+	fQueuedOperations.Add(operation);
+
+	if (fIdleWorkerCount > 0) {
+		fWorkCondition.NotifyOne();
+		return;
+	}
+
+	if (fWorkerCount >= kMaxWorkerThreads)
+		return;
+
+	AcquireReference();
+
+	thread_id thread = spawn_kernel_thread_etc(&_WorkerThread,
+		"async io worker", B_NORMAL_PRIORITY, this, fTeam);
+	if (thread < 0) {
+		ReleaseReference();
+
+		if (fWorkerCount == 0) {
+			fQueuedOperations.Remove(operation);
+			mutex_unlock(&fLock);
+			operation->Execute();
+			mutex_lock(&fLock);
+		}
+		return;
+	}
+
+	fWorkerCount++;
+	resume_thread(thread);
+}
+
+
+/*static*/ status_t
+AsyncIOContext::_WorkerThread(void* data)
+{
+	AsyncIOContext* context = (AsyncIOContext*)data;
+	context->_Worker();
+	context->ReleaseReference();
+	return B_OK;
+}
+
+
+void
+AsyncIOContext::_Worker()
+{
+	MutexLocker locker(fLock);
+
+	while (!fClosed) {
+		AsyncIOOperation* operation = fQueuedOperations.RemoveHead();
+		if (operation == NULL) {
+			ConditionVariableEntry entry;
+			fWorkCondition.Add(&entry);
+			fIdleWorkerCount++;
+			locker.Unlock();
+
+			status_t status = entry.Wait(
+				B_KILL_CAN_INTERRUPT | B_RELATIVE_TIMEOUT, kWorkerIdleTimeout);
+
+			locker.Lock();
+			fIdleWorkerCount--;
+
+			// leave when the team is going away, or when we've been idle
+			// for a while
+			if (status == B_INTERRUPTED
+				|| (status != B_OK && fQueuedOperations.IsEmpty())) {
+				break;
+			}
+			continue;
+		}
+
+		locker.Unlock();
+		operation->Execute();
+		locker.Lock();
+	}
+
+	fWorkerCount--;
+}
+
+
+// #pragma mark - file descriptor
+
+
+static status_t
+async_io_select(struct file_descriptor* descriptor, uint8 event,
+	struct selectsync* sync)
+{
+	return ((AsyncIOContext*)descriptor->cookie)->Select(event, sync);
+}
+
+
+static status_t
+async_io_deselect(struct file_descriptor* descriptor, uint8 event,
+	struct selectsync* sync)
+{
+	return ((AsyncIOContext*)descriptor->cookie)->Deselect(event, sync);
+}
+
+
+static status_t
+async_io_close(struct file_descriptor* descriptor)
+{
+	((AsyncIOContext*)descriptor->cookie)->Close();
+	return B_OK;
+}
+
+
+static void
+async_io_free(struct file_descriptor* descriptor)
+{
+	((AsyncIOContext*)descriptor->cookie)->ReleaseReference();
+}
+
+
+static struct fd_ops sAsyncIOContextOps = {
+	NULL,	// fd_read
+	NULL,	// fd_write
+	NULL,	// fd_seek
+	NULL,	// fd_ioctl
+	NULL,	// fd_set_flags
+	&async_io_select,
+	&async_io_deselect,
+	NULL,	// fd_read_dir
+	NULL,	// fd_rewind_dir
+	NULL,	// fd_read_stat
+	NULL,	// fd_write_stat
+	&async_io_close,
+	&async_io_free
+};
+
+
+static status_t
+get_async_io_context(int fd, file_descriptor*& _descriptor,
+	AsyncIOContext*& _context)
+{
+	file_descriptor* descriptor = get_fd(get_current_io_context(false), fd);
+	if (descriptor == NULL)
+		return B_FILE_ERROR;
+
+	if (descriptor->type != FDTYPE_ASYNC_IO) {
+		put_fd(descriptor);
+		return B_BAD_VALUE;
+	}
+
+	// The worker threads and the buffer addresses belong to the team that
+	// created the context, so it can't be used by any other team.
+	AsyncIOContext* context = (AsyncIOContext*)descriptor->cookie;
+	if (context->Team() != team_get_current_team_id()) {
+		put_fd(descriptor);
+		return B_NOT_ALLOWED;
+	}
+
+	_descriptor = descriptor;
+	_context = context;
+	return B_OK;
+}
+
+
+// #pragma mark - syscalls
+
+
+int
+_user_create_async_io_context(uint32 maxRequests, uint32 flags)
+{
+	if (maxRequests == 0)
+		maxRequests = ASYNC_IO_DEFAULT_REQUESTS;
+	if (maxRequests > ASYNC_IO_MAX_REQUESTS || (flags & ~O_CLOEXEC) != 0)
+		return B_BAD_VALUE;
+
+	AsyncIOContext* context = new(std::nothrow) AsyncIOContext(
+		team_get_current_team_id(), maxRequests);
+	if (context == NULL)
+		return B_NO_MEMORY;
+
+	file_descriptor* descriptor = alloc_fd();
+	if (descriptor == NULL) {
+		context->ReleaseReference();
+		return B_NO_MEMORY;
+	}
+
+	descriptor->type = FDTYPE_ASYNC_IO;
+	descriptor->ops = &sAsyncIOContextOps;
+	descriptor->cookie = context;
+	descriptor->open_mode = O_RDWR;
+
+	io_context* ioContext = get_current_io_context(false);
+	int fd = new_fd(ioContext, descriptor);
+	if (fd < 0) {
+		free(descriptor);
+		context->ReleaseReference();
+		return fd;
+	}
+
+	if ((flags & O_CLOEXEC) != 0)
+		fd_set_close_on_exec(ioContext, fd, true);
+
+	return fd;
+}
+
+
+ssize_t
+_user_submit_async_io(int fd, const async_io_request* userRequests,
+	size_t count)
+{
+	if (userRequests == NULL || !IS_USER_ADDRESS(userRequests))
+		return B_BAD_ADDRESS;
+	if (count > ASYNC_IO_MAX_REQUESTS)
+		return B_BAD_VALUE;
+
+	file_descriptor* descriptor;
+	AsyncIOContext* context;
+	status_t status = get_async_io_context(fd, descriptor, context);
+	if (status != B_OK)
+		return status;
+
+	// Submit in chunks, so that we don't need to allocate a buffer. An error
+	// is only returned if not even the first request could be submitted.
+	async_io_request requests[kMaxRequestsPerCopy];
+	size_t submitted = 0;
+
+	while (submitted < count && status == B_OK) {
+		size_t chunk = min_c(count - submitted, kMaxRequestsPerCopy);
+		if (user_memcpy(requests, userRequests + submitted,
+				chunk * sizeof(async_io_request)) != B_OK) {
+			status = B_BAD_ADDRESS;
+			break;
+		}
+
+		for (size_t i = 0; i < chunk; i++) {
+			status = context->Submit(requests[i]);
+			if (status != B_OK)
+				break;
+
+			submitted++;
+		}
+	}
+
+	put_fd(descriptor);
+
+	return submitted > 0 ? (ssize_t)submitted : status;
+}
+
+
+ssize_t
+_user_reap_async_io(int fd, async_io_completion* userCompletions,
+	size_t count, size_t minCount, uint32 flags, bigtime_t timeout)
+{
+	syscall_restart_handle_timeout_pre(flags, timeout);
+
+	if (userCompletions == NULL || !IS_USER_ADDRESS(userCompletions))
+		return B_BAD_ADDRESS;
+
+	file_descriptor* descriptor;
+	AsyncIOContext* context;
+	status_t status = get_async_io_context(fd, descriptor, context);
+	if (status != B_OK)
+		return status;
+
+	ssize_t result = context->Reap(userCompletions, count, minCount, flags,
+		timeout);
+
+	put_fd(descriptor);
+
+	return result < 0
+		? syscall_restart_handle_timeout_post(result, timeout) : result;
+}
@@ -40,8 +40,6 @@ static const size_t kMaxReadDirBufferSize = 64 * 1024;
 static struct file_descriptor* get_fd_locked(struct io_context* context,
 	int fd);
 static struct file_descriptor* remove_fd(struct io_context* context, int fd);
-static void deselect_select_infos(file_descriptor* descriptor,
-	select_info* infos, bool putSyncObjects);
 
 
 struct FDGetterLocking {
@@ -518,7 +516,7 @@ fd_ioctl(bool kernelFD, int fd, uint32 op, void* buffer, size_t length)
 }
 
 
-static void
+void
 deselect_select_infos(file_descriptor* descriptor, select_info* infos,
 	bool putSyncObjects)
 {
@@ -539,8 +537,11 @@ deselect_select_infos(file_descriptor* descriptor, select_info* infos,
 			}
 		}
 
+		// the info must not be touched after notifying -- event queues
+		// might free it right away
+		select_info* next = info->next;
 		notify_select_events(info, B_EVENT_INVALID);
-		info = info->next;
+		info = next;
 
 		if (putSyncObjects)
 			put_select_sync(sync);
@@ -1109,6 +1109,8 @@ node_monitor_init(void)
 status_t
 notify_unmount(dev_t device)
 {
+	vfs_path_cache_node_changed(device, -1);
+
 	return sNodeMonitorService.NotifyUnmount(device);
 }
 
@@ -1116,6 +1118,8 @@ notify_unmount(dev_t device)
 status_t
 notify_mount(dev_t device, dev_t parentDevice, ino_t parentDirectory)
 {
+	vfs_path_cache_node_changed(device, -1);
+
 	return sNodeMonitorService.NotifyMount(device, parentDevice,
 		parentDirectory);
 }
@@ -1172,6 +1176,8 @@ status_t
 notify_entry_removed(dev_t device, ino_t directory, const char *name,
 	ino_t node)
 {
+	vfs_path_cache_node_changed(device, node);
+
 	return sNodeMonitorService.NotifyEntryCreatedOrRemoved(B_ENTRY_REMOVED,
 		device, directory, name, node);
 }
@@ -1193,6 +1199,8 @@ notify_entry_moved(dev_t device, ino_t fromDirectory,
 	const char *fromName, ino_t toDirectory, const char *toName,
 	ino_t node)
 {
+	vfs_path_cache_node_changed(device, node);
+
 	return sNodeMonitorService.NotifyEntryMoved(device, fromDirectory,
 		fromName, toDirectory, toName, node);
 }
@@ -1213,6 +1221,10 @@ status_t
 notify_stat_changed(dev_t device, ino_t directory, ino_t node,
 	uint32 statFields)
 {
+	// the permissions decide whether directories may be searched
+	if ((statFields & (B_STAT_MODE | B_STAT_UID | B_STAT_GID)) != 0)
+		vfs_path_cache_node_changed(device, node);
+
 	return sNodeMonitorService.NotifyStatChanged(device, directory, node,
 		statFields);
 }
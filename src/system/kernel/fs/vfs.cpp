@@ -26,6 +26,7 @@
 #include <fs_info.h>
 #include <fs_interface.h>
 #include <fs_volume.h>
+#include <NodeMonitor.h>
 #include <OS.h>
 #include <StorageDefs.h>
 
@@ -39,6 +40,7 @@
 #include <disk_device_manager/KDiskSystem.h>
 #include <fd.h>
 #include <file_cache.h>
+#include <fs/devfs.h>
 #include <fs/node_monitor.h>
 #include <KPath.h>
 #include <lock.h>
@@ -56,6 +58,7 @@
 #include "EntryCache.h"
 #include "fifo.h"
 #include "IORequest.h"
+#include "PathPrefixCache.h"
 #include "unused_vnodes.h"
 #include "vfs_tracing.h"
 #include "Vnode.h"
@@ -330,6 +333,8 @@ static struct vnode* sRoot;
 static MountTable* sMountsTable;
 static dev_t sNextMountID = 1;
 
+static PathPrefixCache* sPathPrefixCache;
+
 #define MAX_TEMP_IO_VECS 8
 
 // How long to wait for busy vnodes (10s)
@@ -1482,6 +1487,24 @@ vnode_low_resource_handler(void* /*data*/, uint32 resources, int32 level)
 	TRACE(("vnode_low_resource_handler(level = %" B_PRId32 ")\n", level));
 
 	free_unused_vnodes(level);
+
+	if ((resources & B_KERNEL_RESOURCE_MEMORY) == 0
+		|| level == B_NO_LOW_RESOURCE) {
+		return;
+	}
+
+	// Entries for missing nodes are the first to go. Only when memory is
+	// really getting scarce, the path prefixes are dropped, too.
+	bool all = level != B_LOW_RESOURCE_NOTE;
+
+	MutexLocker mountLocker(sMountMutex);
+	MountTable::Iterator iterator(sMountsTable);
+	while (struct fs_mount* mount = iterator.Next())
+		mount->entry_cache.RemoveMissingEntries(all);
+	mountLocker.Unlock();
+
+	if (all && sPathPrefixCache != NULL)
+		sPathPrefixCache->Clear();
 }
 
 
@@ -2113,6 +2136,93 @@ lookup_dir_entry(struct vnode* dir, const char* name, struct vnode** _vnode)
 }
 
 
+/*!	Returns whether the path prefix cache can be used for path walks of the
+	current thread. If so, the credentials the cache entries must match are
+	returned.
+*/
+static bool
+can_use_path_prefix_cache(struct io_context* ioContext, uid_t& _userID,
+	gid_t& _groupID)
+{
+	// Walks from within a chroot() are rare, and absolute symlinks would
+	// resolve differently there.
+	if (sPathPrefixCache == NULL || ioContext->root != sRoot)
+		return false;
+
+	_userID = geteuid();
+	_groupID = getegid();
+
+	// Supplementary groups are not part of the key; they don't matter for
+	// root, though.
+	return _userID == 0
+		|| thread_get_current_thread()->team->supplementary_group_count == 0;
+}
+
+
+/*!	Returns the position of the last component in \a path, if the path has
+	a directory prefix that can be looked up in the path prefix cache, or
+	\c NULL otherwise. The length of the prefix is returned in
+	\a _prefixLength.
+*/
+static char*
+get_path_prefix(char* path, size_t& _prefixLength)
+{
+	char* lastSlash = strrchr(path, '/');
+	if (lastSlash == NULL || lastSlash[1] == '\0')
+		return NULL;
+
+	char* leaf = lastSlash + 1;
+	while (lastSlash > path && lastSlash[-1] == '/')
+		lastSlash--;
+	if (lastSlash == path)
+		return NULL;
+
+	_prefixLength = lastSlash - path;
+	return leaf;
+}
+
+
+void
+vfs_path_cache_node_changed(dev_t device, ino_t node)
+{
+	if (sPathPrefixCache == NULL)
+		return;
+
+	if (node >= 0) {
+		// Only directories and symlinks can be part of a path prefix.
+		ReadLocker vnodeLocker(sVnodeLock);
+		struct vnode* vnode = lookup_vnode(device, node);
+		if (vnode != NULL && vnode->Type() != 0 && !S_ISDIR(vnode->Type())
+			&& !S_ISLNK(vnode->Type())) {
+			return;
+		}
+	}
+
+	sPathPrefixCache->Invalidate();
+}
+
+
+/*!	Returns whether changing the entry \a name in \a directory may affect
+	the path prefix cache, ie. if it refers to a directory or a symlink.
+	Entries that don't exist cannot be part of any cached prefix.
+*/
+static bool
+is_path_cache_entry(struct vnode* directory, const char* name)
+{
+	if (sPathPrefixCache == NULL)
+		return false;
+
+	struct vnode* vnode;
+	if (lookup_dir_entry(directory, name, &vnode) != B_OK)
+		return false;
+
+	bool result = vnode->Type() == 0 || S_ISDIR(vnode->Type())
+		|| S_ISLNK(vnode->Type());
+	put_vnode(vnode);
+	return result;
+}
+
+
 /*!	Returns the vnode for the relative path starting at the specified \a vnode.
 	\a path must not be NULL.
 	If it returns successfully, \a path contains the name of the last path
@@ -2141,10 +2251,46 @@ vnode_path_to_vnode(struct vnode* vnode, char* path, bool traverseLeafLink,
 		return B_ENTRY_NOT_FOUND;
 	}
 
+	// Try to skip everything up to the last path component via the path
+	// prefix cache. If the prefix is not known yet, it will be added once the
+	// walk reaches the last component.
+	char* leaf = NULL;
+	PathPrefixCacheEntry* prefixEntry = NULL;
+	uid_t userID;
+	gid_t groupID;
+	size_t prefixLength;
+	if (can_use_path_prefix_cache(ioContext, userID, groupID)
+		&& (leaf = get_path_prefix(path, prefixLength)) != NULL) {
+		PathPrefixCacheKey key(vnode->device, vnode->id, userID, groupID,
+			path, prefixLength);
+		dev_t device;
+		ino_t node;
+		struct vnode* directory;
+		if (sPathPrefixCache->Lookup(key, device, node)
+			&& get_vnode(device, node, &directory, true, false) == B_OK) {
+			if (Vnode* coveringNode = get_covering_vnode(directory)) {
+				put_vnode(directory);
+				directory = coveringNode;
+			}
+
+			put_vnode(vnode);
+			vnode = directory;
+			lastParentID = vnode->id;
+			path = leaf;
+			leaf = NULL;
+		} else
+			prefixEntry = sPathPrefixCache->CreateEntry(key);
+	}
+
 	while (true) {
 		struct vnode* nextVnode;
 		char* nextPath;
 
+		if (path == leaf && prefixEntry != NULL) {
+			sPathPrefixCache->Add(prefixEntry, vnode->device, vnode->id);
+			prefixEntry = NULL;
+		}
+
 		TRACE(("vnode_path_to_vnode: top of loop. p = %p, p = '%s'\n", path,
 			path));
 
@@ -2198,6 +2344,8 @@ vnode_path_to_vnode(struct vnode* vnode, char* path, bool traverseLeafLink,
 
 		if (status != B_OK) {
 			put_vnode(vnode);
+			if (prefixEntry != NULL)
+				sPathPrefixCache->DeleteEntry(prefixEntry);
 			return status;
 		}
 
@@ -2238,6 +2386,8 @@ vnode_path_to_vnode(struct vnode* vnode, char* path, bool traverseLeafLink,
 		resolve_link_error:
 				put_vnode(vnode);
 				put_vnode(nextVnode);
+				if (prefixEntry != NULL)
+					sPathPrefixCache->DeleteEntry(prefixEntry);
 
 				return status;
 			}
@@ -2279,6 +2429,8 @@ vnode_path_to_vnode(struct vnode* vnode, char* path, bool traverseLeafLink,
 
 			if (status != B_OK) {
 				put_vnode(vnode);
+				if (prefixEntry != NULL)
+					sPathPrefixCache->DeleteEntry(prefixEntry);
 				return status;
 			}
 		} else
@@ -2297,6 +2449,9 @@ vnode_path_to_vnode(struct vnode* vnode, char* path, bool traverseLeafLink,
 		}
 	}
 
+	if (prefixEntry != NULL)
+		sPathPrefixCache->DeleteEntry(prefixEntry);
+
 	*_vnode = vnode;
 	if (_parentID)
 		*_parentID = lastParentID;
@@ -3636,6 +3791,17 @@ free_io_context(io_context* context)
 
 	mutex_lock(&context->io_mutex);
 
+	// Event queues may still have descriptors selected; get rid of those
+	// selections first, so that no queue needs to deselect anything itself
+	// while we are holding the lock.
+	for (i = 0; i < context->table_size; i++) {
+		select_info* selectInfos = context->select_infos[i];
+		if (selectInfos != NULL && context->fds[i] != NULL) {
+			context->select_infos[i] = NULL;
+			deselect_select_infos(context->fds[i], selectInfos, true);
+		}
+	}
+
 	for (i = 0; i < context->table_size; i++) {
 		if (struct file_descriptor* descriptor = context->fds[i]) {
 			close_fd(descriptor);
@@ -4658,6 +4824,20 @@ vfs_can_page(struct vnode* vnode, void* cookie)
 }
 
 
+/*!	Returns whether an I/O request for the given vnode may be passed directly
+	to its file system's io() hook via vfs_vnode_io() without blocking the
+	caller. That is only the case for devices that have no cache, as the hook
+	would bypass it otherwise, and whose driver can do asynchronous I/O;
+	others are served synchronously by vfs_vnode_io().
+*/
+extern "C" bool
+vfs_can_do_direct_io(struct vnode* vnode)
+{
+	return S_ISCHR(vnode->Type()) && vnode->cache == NULL
+		&& devfs_device_has_io(vnode);
+}
+
+
 extern "C" status_t
 vfs_read_pages(struct vnode* vnode, void* cookie, off_t pos,
 	const generic_io_vec* vecs, size_t count, uint32 flags,
@@ -4882,18 +5062,25 @@ vfs_exec_io_context(io_context* context)
 		mutex_lock(&context->io_mutex);
 
 		struct file_descriptor* descriptor = context->fds[i];
+		select_info* selectInfos = NULL;
 		bool remove = false;
 
 		if (descriptor != NULL && fd_close_on_exec(context, i)) {
 			context->fds[i] = NULL;
 			context->num_used_fds--;
 
+			selectInfos = context->select_infos[i];
+			context->select_infos[i] = NULL;
+
 			remove = true;
 		}
 
 		mutex_unlock(&context->io_mutex);
 
 		if (remove) {
+			if (selectInfos != NULL)
+				deselect_select_infos(descriptor, selectInfos, true);
+
 			close_fd(descriptor);
 			put_fd(descriptor);
 		}
@@ -5183,6 +5370,8 @@ vfs_bind_mount_directory(dev_t mountID, ino_t nodeID, dev_t coveredMountID,
 	inc_vnode_ref_count(vnode);
 	inc_vnode_ref_count(coveredVnode);
 
+	vfs_path_cache_node_changed(coveredMountID, -1);
+
 	return B_OK;
 }
 
@@ -5271,6 +5460,12 @@ vfs_init(kernel_args* args)
 
 	node_monitor_init();
 
+	sPathPrefixCache = new(std::nothrow) PathPrefixCache;
+	if (sPathPrefixCache != NULL && sPathPrefixCache->Init() != B_OK) {
+		delete sPathPrefixCache;
+		sPathPrefixCache = NULL;
+	}
+
 	sRoot = NULL;
 
 	recursive_lock_init(&sMountOpLock, "vfs_mount_op_lock");
@@ -6046,6 +6241,10 @@ dir_remove(int fd, char* path, bool kernel)
 	else
 		status = B_READ_ONLY_DEVICE;
 
+	// not all file systems send node monitoring notifications
+	if (status == B_OK)
+		vfs_path_cache_node_changed(directory->device, -1);
+
 	put_vnode(directory);
 	return status;
 }
@@ -6415,11 +6614,18 @@ common_unlink(int fd, char* path, bool kernel)
 	if (status < 0)
 		return status;
 
+	// symlinks may be part of a cached path prefix
+	bool pathChanged = is_path_cache_entry(vnode, filename);
+
 	if (HAS_FS_CALL(vnode, unlink))
 		status = FS_CALL(vnode, unlink, filename);
 	else
 		status = B_READ_ONLY_DEVICE;
 
+	// not all file systems send node monitoring notifications
+	if (status == B_OK && pathChanged)
+		vfs_path_cache_node_changed(vnode->device, -1);
+
 	put_vnode(vnode);
 
 	return status;
@@ -6482,10 +6688,21 @@ common_rename(int fd, char* path, int newFD, char* newPath, bool kernel)
 		goto err2;
 	}
 
-	if (HAS_FS_CALL(fromVnode, rename))
-		status = FS_CALL(fromVnode, rename, fromName, toVnode, toName);
-	else
-		status = B_READ_ONLY_DEVICE;
+	{
+		// Only moving a directory or a symlink, or replacing one, can change
+		// how a cached path prefix resolves.
+		bool pathChanged = is_path_cache_entry(fromVnode, fromName)
+			|| is_path_cache_entry(toVnode, toName);
+
+		if (HAS_FS_CALL(fromVnode, rename))
+			status = FS_CALL(fromVnode, rename, fromName, toVnode, toName);
+		else
+			status = B_READ_ONLY_DEVICE;
+
+		// not all file systems send node monitoring notifications
+		if (status == B_OK && pathChanged)
+			vfs_path_cache_node_changed(fromVnode->device, -1);
+	}
 
 err2:
 	put_vnode(toVnode);
@@ -6525,7 +6742,14 @@ common_write_stat(struct file_descriptor* descriptor, const struct stat* stat,
 	if (!HAS_FS_CALL(vnode, write_stat))
 		return B_READ_ONLY_DEVICE;
 
-	return FS_CALL(vnode, write_stat, stat, statMask);
+	status_t status = FS_CALL(vnode, write_stat, stat, statMask);
+	if (status == B_OK
+		&& (statMask & (B_STAT_MODE | B_STAT_UID | B_STAT_GID)) != 0) {
+		// the permissions of a cached path prefix might have changed
+		vfs_path_cache_node_changed(vnode->device, vnode->id);
+	}
+
+	return status;
 }
 
 
@@ -6567,6 +6791,12 @@ common_path_write_stat(int fd, char* path, bool traverseLeafLink,
 	else
 		status = B_READ_ONLY_DEVICE;
 
+	if (status == B_OK
+		&& (statMask & (B_STAT_MODE | B_STAT_UID | B_STAT_GID)) != 0) {
+		// the permissions of a cached path prefix might have changed
+		vfs_path_cache_node_changed(vnode->device, vnode->id);
+	}
+
 	put_vnode(vnode);
 
 	return status;
@@ -8814,6 +9044,49 @@ _user_sync(void)
 }
 
 
+status_t
+_user_get_vfs_cache_statistics(vfs_cache_statistics* userStatistics,
+	size_t size)
+{
+	if (size != sizeof(vfs_cache_statistics))
+		return B_BAD_VALUE;
+	if (!IS_USER_ADDRESS(userStatistics))
+		return B_BAD_ADDRESS;
+
+	vfs_cache_statistics statistics;
+	memset(&statistics, 0, sizeof(statistics));
+
+	MutexLocker mountLocker(sMountMutex);
+	MountTable::Iterator iterator(sMountsTable);
+	while (struct fs_mount* mount = iterator.Next()) {
+		entry_cache_stats stats;
+		mount->entry_cache.GetStatistics(stats);
+
+		statistics.entry_cache_hits += stats.hits;
+		statistics.entry_cache_missing_hits += stats.missing_hits;
+		statistics.entry_cache_misses += stats.misses;
+		statistics.entry_cache_entries += stats.entries;
+		statistics.entry_cache_missing_entries += stats.missing_entries;
+	}
+	mountLocker.Unlock();
+
+	if (sPathPrefixCache != NULL) {
+		path_prefix_cache_stats stats;
+		sPathPrefixCache->GetStatistics(stats);
+
+		statistics.path_cache_hits = stats.hits;
+		statistics.path_cache_misses = stats.misses;
+		statistics.path_cache_invalidations = stats.invalidations;
+		statistics.path_cache_entries = stats.entries;
+	}
+
+	if (user_memcpy(userStatistics, &statistics, sizeof(statistics)) != B_OK)
+		return B_BAD_ADDRESS;
+
+	return B_OK;
+}
+
+
 status_t
 _user_get_next_fd_info(team_id team, uint32* userCookie, fd_info* userInfo,
 	size_t infoSize)
@@ -15,6 +15,7 @@
 
 
 #include <OS.h>
+#include <unistd.h>
 
 #include <AutoDeleter.h>
 #include <cpu.h>
@@ -26,6 +27,7 @@
 #include <load_tracking.h>
 #include <scheduler_defs.h>
 #include <smp.h>
+#include <team.h>
 #include <timer.h>
 #include <util/Random.h>
 
@@ -74,6 +76,13 @@ static scheduler_mode_operations* sSchedulerModes[] = {
 static int32* sCPUToCore;
 static int32* sCPUToPackage;
 
+// Admission control of the deadline class. The lock protects the deadline
+// utilization of all cores and the number of deadline threads.
+static const bigtime_t kMinimalDeadlineRuntime = 100;
+static const bigtime_t kMaximalDeadlinePeriod = 10000000;
+static spinlock sDeadlineLock = B_SPINLOCK_INITIALIZER;
+static int32 sDeadlineThreadCount;
+
 
 static void enqueue(Thread* thread, bool newOne);
 
@@ -98,6 +107,7 @@ enqueue(Thread* thread, bool newOne)
 	SCHEDULER_ENTER_FUNCTION();
 
 	ThreadData* threadData = thread->scheduler_data;
+	threadData->UpdateDeadlineBudget(false);
 
 	int32 threadPriority = threadData->GetEffectivePriority();
 	T(EnqueueThread(thread, threadPriority));
@@ -108,6 +118,9 @@ enqueue(Thread* thread, bool newOne)
 		ASSERT(thread->previous_cpu != NULL);
 		ASSERT(threadData->Core() != NULL);
 		targetCPU = &gCPUEntries[thread->previous_cpu->cpu_num];
+	} else if (threadData->IsDeadlineActive()
+		&& threadData->DeadlineCore()->CPUCount() > 0) {
+		targetCore = threadData->DeadlineCore();
 	} else if (gSingleCore)
 		targetCore = &gCoreEntries[0];
 	else if (threadData->Core() != NULL
@@ -127,8 +140,15 @@ enqueue(Thread* thread, bool newOne)
 		thread);
 
 	int32 heapPriority = CPUPriorityHeap::GetKey(targetCPU);
-	if (threadPriority > heapPriority
-		|| (threadPriority == heapPriority && rescheduleNeeded)) {
+	bool preempt = threadPriority > heapPriority
+		|| (threadPriority == heapPriority && rescheduleNeeded);
+	if (threadPriority == kDeadlinePriority
+		&& heapPriority == kDeadlinePriority) {
+		// all deadline threads share a priority, the earlier deadline wins
+		preempt = threadData->Deadline() < targetCPU->RunningDeadline();
+	}
+
+	if (preempt) {
 
 		if (targetCPU->ID() == smp_get_current_cpu())
 			gCPU[targetCPU->ID()].invoke_scheduler = true;
@@ -217,6 +237,139 @@ scheduler_set_thread_priority(Thread *thread, int32 priority)
 }
 
 
+static inline int32
+deadline_load(bigtime_t runtime, bigtime_t period)
+{
+	return runtime * kMaxLoad / period;
+}
+
+
+/*!	Returns the utilization claimed by \a threadData to its deadline core.
+	The caller must hold sDeadlineLock.
+*/
+static void
+release_deadline_load(ThreadData* threadData)
+{
+	CoreEntry* core = threadData->DeadlineCore();
+	if (core == NULL)
+		return;
+
+	core->ChangeDeadlineLoad(-deadline_load(threadData->DeadlineRuntime(),
+		threadData->DeadlinePeriod()));
+	sDeadlineThreadCount--;
+}
+
+
+/*!	Puts the given thread into the deadline class, so that it gets \a runtime
+	of CPU time within \a deadline after the start of each \a period, or
+	removes it from there, if \a runtime is 0.
+	The thread is assigned to the core with the least deadline utilization. If
+	no core can accommodate it anymore, \c B_BUSY is returned.
+*/
+status_t
+scheduler_set_thread_deadline(Thread* thread, bigtime_t runtime,
+	bigtime_t deadline, bigtime_t period)
+{
+	ASSERT(are_interrupts_enabled());
+
+	if (runtime < 0 || (runtime > 0 && (runtime < kMinimalDeadlineRuntime
+			|| runtime > deadline || deadline > period
+			|| period > kMaximalDeadlinePeriod))) {
+		return B_BAD_VALUE;
+	}
+
+	InterruptsSpinLocker _(thread->scheduler_lock);
+	SchedulerModeLocker modeLocker;
+
+	SCHEDULER_ENTER_FUNCTION();
+
+	ThreadData* threadData = thread->scheduler_data;
+
+	// admission control
+	SpinLocker deadlineLocker(sDeadlineLock);
+
+	CoreEntry* oldCore = threadData->DeadlineCore();
+	int32 oldLoad = 0;
+	if (oldCore != NULL) {
+		oldLoad = deadline_load(threadData->DeadlineRuntime(),
+			threadData->DeadlinePeriod());
+	}
+
+	CoreEntry* core = NULL;
+	if (runtime > 0) {
+		if (oldCore == NULL && sDeadlineThreadCount >= kMaxDeadlineThreads)
+			return B_BUSY;
+
+		int32 load = deadline_load(runtime, period);
+		int32 coreLoad = 0;
+		for (int32 i = 0; i < gCoreCount; i++) {
+			CoreEntry* candidate = &gCoreEntries[i];
+			if (candidate->CPUCount() == 0)
+				continue;
+
+			int32 candidateLoad = candidate->DeadlineLoad();
+			if (candidate == oldCore)
+				candidateLoad -= oldLoad;
+			if (candidateLoad + load > kMaxDeadlineLoad)
+				continue;
+
+			if (core == NULL || candidateLoad < coreLoad) {
+				core = candidate;
+				coreLoad = candidateLoad;
+			}
+		}
+
+		if (core == NULL)
+			return B_BUSY;
+
+		release_deadline_load(threadData);
+		core->ChangeDeadlineLoad(load);
+		sDeadlineThreadCount++;
+	} else
+		release_deadline_load(threadData);
+
+	deadlineLocker.Unlock();
+
+	TRACE("setting thread %ld deadline parameters to %lld/%lld/%lld (core "
+		"%ld)\n", thread->id, runtime, deadline, period,
+		core != NULL ? core->ID() : -1);
+
+	if (thread->state != B_THREAD_READY) {
+		threadData->SetDeadline(runtime, deadline, period, core);
+
+		if (thread->state == B_THREAD_RUNNING) {
+			ASSERT(threadData->Core() != NULL);
+
+			ASSERT(thread->cpu != NULL);
+			CPUEntry* cpu = &gCPUEntries[thread->cpu->cpu_num];
+
+			CoreCPUHeapLocker _(threadData->Core());
+			cpu->UpdatePriority(threadData->GetEffectivePriority());
+			cpu->SetRunningDeadline(threadData->IsDeadlineActive()
+				? threadData->Deadline() : B_INFINITE_TIMEOUT);
+		}
+
+		return B_OK;
+	}
+
+	// The thread is in one of the run queues. We need to remove it and
+	// re-insert it into the one of its new class.
+
+	T(RemoveThread(thread));
+
+	// notify listeners
+	NotifySchedulerListeners(&SchedulerListener::ThreadRemovedFromRunQueue,
+		thread);
+
+	bool dequeued = threadData->Dequeue();
+	threadData->SetDeadline(runtime, deadline, period, core);
+	if (dequeued)
+		enqueue(thread, true);
+
+	return B_OK;
+}
+
+
 void
 scheduler_reschedule_ici()
 {
@@ -387,13 +540,23 @@ reschedule(int32 nextState)
 		} else
 			nextThreadData = oldThreadData;
 	} else {
-		nextThreadData
-			= cpu->ChooseNextThread(enqueueOldThread ? oldThreadData : NULL,
-				putOldThreadAtBack);
+		// deadline threads are moved back to their deadline core
+		bool migrateOldThread = enqueueOldThread
+			&& oldThreadData->IsDeadlineActive()
+			&& oldThreadData->DeadlineCore() != core
+			&& oldThreadData->DeadlineCore()->CPUCount() > 0;
+		if (migrateOldThread)
+			putOldThreadAtBack = true;
+
+		nextThreadData = cpu->ChooseNextThread(
+			enqueueOldThread && !migrateOldThread ? oldThreadData : NULL,
+			putOldThreadAtBack);
 
 		// update CPU heap
 		CoreCPUHeapLocker cpuLocker(core);
 		cpu->UpdatePriority(nextThreadData->GetEffectivePriority());
+		cpu->SetRunningDeadline(nextThreadData->IsDeadlineActive()
+			? nextThreadData->Deadline() : B_INFINITE_TIMEOUT);
 	}
 
 	Thread* nextThread = nextThreadData->GetThread();
@@ -497,7 +660,13 @@ scheduler_on_thread_init(Thread* thread)
 void
 scheduler_on_thread_destroy(Thread* thread)
 {
-	delete thread->scheduler_data;
+	ThreadData* threadData = thread->scheduler_data;
+	if (threadData != NULL && threadData->IsDeadlineThread()) {
+		InterruptsSpinLocker _(sDeadlineLock);
+		release_deadline_load(threadData);
+	}
+
+	delete threadData;
 }
 
 
@@ -722,6 +891,7 @@ scheduler_init()
 	scheduler_set_operation_mode(SCHEDULER_MODE_LOW_LATENCY);
 
 	init_debug_commands();
+	Profiling::init_migration_counters();
 
 #if SCHEDULER_TRACING
 	add_debugger_command_etc("scheduler", &cmd_scheduler,
@@ -832,3 +1002,31 @@ _user_get_scheduler_mode()
 	return gCurrentModeID;
 }
 
+
+status_t
+_user_set_thread_deadline(thread_id id, bigtime_t runtime, bigtime_t deadline,
+	bigtime_t period)
+{
+	// get the thread
+	Thread* thread;
+	if (id < 0) {
+		thread = thread_get_current_thread();
+		thread->AcquireReference();
+	} else {
+		thread = Thread::Get(id);
+		if (thread == NULL)
+			return B_BAD_THREAD_ID;
+	}
+	BReference<Thread> threadReference(thread, true);
+
+	// only root may change the threads of other teams, no one those of the
+	// kernel
+	if (thread_is_idle_thread(thread) || thread->team == team_get_kernel_team()
+		|| (thread->team != thread_get_current_thread()->team
+			&& geteuid() != 0)) {
+		return B_NOT_ALLOWED;
+	}
+
+	return scheduler_set_thread_deadline(thread, runtime, deadline, period);
+}
+
@@ -42,6 +42,19 @@ const int kVeryHighLoad = (kMaxLoad + kHighLoad) / 2;
 
 const int kLoadDifference = kMaxLoad * 20 / 100;
 
+// Threads in the deadline class are scheduled earliest deadline first, ahead
+// of all priority based threads. Admission control keeps the utilization they
+// may claim on each core below kMaxDeadlineLoad.
+const int kMaxDeadlineLoad = kMaxLoad * 90 / 100;
+const int32 kMaxDeadlineThreads = 64;
+const int32 kDeadlinePriority = THREAD_MAX_SET_PRIORITY + 1;
+
+// An idle CPU that found no core to steal from does not look again before
+// kStealRetryInterval has passed. Only the first kMaxStealCandidates threads
+// of the victim's run queue are considered.
+const bigtime_t kStealRetryInterval = 1000;
+const int32 kMaxStealCandidates = 4;
+
 extern bool gSingleCore;
 extern bool gTrackCoreLoad;
 extern bool gTrackCPULoad;
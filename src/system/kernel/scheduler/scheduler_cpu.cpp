@@ -6,6 +6,7 @@
 
 #include "scheduler_cpu.h"
 
+#include <listeners.h>
 #include <util/AutoLock.h>
 
 #include <algorithm>
@@ -80,9 +81,11 @@ ThreadRunQueue::Dump() const
 CPUEntry::CPUEntry()
 	:
 	fLoad(0),
+	fRunningDeadline(B_INFINITE_TIMEOUT),
 	fMeasureActiveTime(0),
 	fMeasureTime(0),
-	fUpdateLoadEvent(false)
+	fUpdateLoadEvent(false),
+	fNextStealAttempt(0)
 {
 	B_INITIALIZE_RW_SPINLOCK(&fSchedulerModeLock);
 	B_INITIALIZE_SPINLOCK(&fQueueLock);
@@ -160,6 +163,14 @@ CoreEntry::PeekThread() const
 }
 
 
+inline ThreadData*
+CoreEntry::PeekDeadlineThread() const
+{
+	SCHEDULER_ENTER_FUNCTION();
+	return fDeadlineQueue.PeekRoot();
+}
+
+
 inline ThreadData*
 CPUEntry::PeekThread() const
 {
@@ -219,6 +230,9 @@ CPUEntry::ChooseNextThread(ThreadData* oldThread, bool putAtBack)
 {
 	SCHEDULER_ENTER_FUNCTION();
 
+	if (!gSingleCore && (oldThread == NULL || oldThread->IsIdle()))
+		_StealThread();
+
 	int32 oldPriority = -1;
 	if (oldThread != NULL)
 		oldPriority = oldThread->GetEffectivePriority();
@@ -232,6 +246,20 @@ CPUEntry::ChooseNextThread(ThreadData* oldThread, bool putAtBack)
 
 	CoreRunQueueLocker coreLocker(fCore);
 
+	// Deadline threads precede all others, the earliest deadline first.
+	ThreadData* deadlineThread = fCore->PeekDeadlineThread();
+	if (deadlineThread != NULL) {
+		if (oldThread != NULL && oldThread->IsDeadlineActive()
+			&& (oldThread->Deadline() < deadlineThread->Deadline()
+				|| (!putAtBack
+					&& oldThread->Deadline() == deadlineThread->Deadline()))) {
+			return oldThread;
+		}
+
+		fCore->RemoveDeadline(deadlineThread);
+		return deadlineThread;
+	}
+
 	ThreadData* sharedThread = fCore->PeekThread();
 	ASSERT(sharedThread != NULL || pinnedThread != NULL || oldThread != NULL);
 
@@ -345,6 +373,126 @@ CPUEntry::_RequestPerformanceLevel(ThreadData* threadData)
 }
 
 
+/*!	Called when this CPU is about to go idle. Takes a thread that is waiting
+	in the run queue of a busy core and moves it over to this CPU's core.
+
+	Cores in the same package are tried first, and the one with the most
+	waiting threads is chosen. Of its threads, one whose cache affinity has
+	expired is preferred. Threads are only taken from another package in low
+	latency mode and only if their cache affinity has expired anyway, as they
+	would lose their last level cache contents.
+*/
+bool
+CPUEntry::_StealThread()
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	// Only steal if there is nothing but the idle thread to run here.
+	CPURunQueueLocker cpuLocker(this);
+	ThreadData* pinnedThread = fRunQueue.PeekMaximum();
+	if (pinnedThread != NULL && !pinnedThread->IsIdle())
+		return false;
+	cpuLocker.Unlock();
+
+	if (fCore->QueuedThreadCount() > 0 || fCore->DeadlineThreadCount() > 0)
+		return false;
+
+	// Looking at all cores is not for free, so don't do it every time this
+	// CPU passes through the scheduler without anything to do.
+	bigtime_t now = system_time();
+	if (now < fNextStealAttempt)
+		return false;
+
+	CoreEntry* victim = _ChooseStealVictim();
+	if (victim == NULL) {
+		fNextStealAttempt = now + kStealRetryInterval;
+		return false;
+	}
+
+	Profiling::count_migration(fCPUNumber,
+		&Profiling::MigrationCounters::fStealAttempts);
+
+	bool crossPackage = victim->Package() != fCore->Package();
+
+	CoreRunQueueLocker victimLocker(victim);
+	ThreadData* thread = victim->PeekStealableThread(crossPackage);
+	if (thread == NULL) {
+		fNextStealAttempt = now + kStealRetryInterval;
+		return false;
+	}
+
+	// The thread must not be touched by anyone else until it is enqueued
+	// again. We already hold the scheduler lock of the thread that ran on
+	// this CPU, so we must not wait for another one.
+	Thread* stolenThread = thread->GetThread();
+	if (!try_acquire_spinlock(&stolenThread->scheduler_lock))
+		return false;
+
+	victim->Remove(thread);
+	victimLocker.Unlock();
+
+	CoreEntry* targetCore = fCore;
+	CPUEntry* targetCPU = this;
+	thread->ChooseCoreAndCPU(targetCore, targetCPU);
+	thread->Enqueue();
+
+	NotifySchedulerListeners(&SchedulerListener::ThreadEnqueuedInRunQueue,
+		stolenThread);
+
+	release_spinlock(&stolenThread->scheduler_lock);
+
+	Profiling::count_migration(fCPUNumber,
+		&Profiling::MigrationCounters::fSteals);
+	if (crossPackage) {
+		Profiling::count_migration(fCPUNumber,
+			&Profiling::MigrationCounters::fCrossPackageSteals);
+	}
+
+	TRACE("cpu %ld stole thread %ld from core %ld\n", fCPUNumber,
+		stolenThread->id, victim->ID());
+	return true;
+}
+
+
+CoreEntry*
+CPUEntry::_ChooseStealVictim() const
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	// A core is only worth stealing from, if it has threads waiting and all
+	// of its CPUs are busy -- otherwise it will run the threads itself soon.
+	// The counters are read without locking, they only serve as a hint.
+	PackageEntry* package = fCore->Package();
+	bool allowOtherPackages = gCurrentModeID == SCHEDULER_MODE_LOW_LATENCY;
+
+	CoreEntry* victim = NULL;
+	for (int pass = 0; pass < 2 && victim == NULL; pass++) {
+		if (pass == 1 && !allowOtherPackages)
+			break;
+
+		for (int32 i = 0; i < gCoreCount; i++) {
+			CoreEntry* core = &gCoreEntries[i];
+			if (core == fCore || (core->Package() == package) != (pass == 0))
+				continue;
+
+			if (core->CPUCount() == 0 || core->IdleCPUCount() > 0
+				|| core->QueuedThreadCount() == 0) {
+				continue;
+			}
+
+			if (victim == NULL
+				|| core->QueuedThreadCount() > victim->QueuedThreadCount()
+				|| (core->QueuedThreadCount() == victim->QueuedThreadCount()
+					&& core->GetLoad() > victim->GetLoad())) {
+				victim = core;
+			}
+		}
+	}
+
+	return victim;
+}
+
+
 /* static */ int32
 CPUEntry::_RescheduleEvent(timer* /* unused */)
 {
@@ -358,7 +506,16 @@ CPUEntry::_RescheduleEvent(timer* /* unused */)
 CPUEntry::_UpdateLoadEvent(timer* /* unused */)
 {
 	CoreEntry::GetCore(smp_get_current_cpu())->ChangeLoad(0);
-	CPUEntry::GetCPU(smp_get_current_cpu())->fUpdateLoadEvent = false;
+
+	CPUEntry* cpu = CPUEntry::GetCPU(smp_get_current_cpu());
+	cpu->fUpdateLoadEvent = false;
+
+	// while idle, check periodically whether there is work to steal
+	if (!gSingleCore && cpu->_ChooseStealVictim() != NULL) {
+		cpu->fNextStealAttempt = 0;
+		get_cpu_struct()->invoke_scheduler = true;
+	}
+
 	return B_HANDLED_INTERRUPT;
 }
 
@@ -402,6 +559,9 @@ CoreEntry::CoreEntry()
 	fCPUCount(0),
 	fIdleCPUCount(0),
 	fThreadCount(0),
+	fDeadlineThreadCount(0),
+	fDeadlineQueue(kMaxDeadlineThreads),
+	fDeadlineLoad(0),
 	fActiveTime(0),
 	fLoad(0),
 	fCurrentLoad(0),
@@ -459,6 +619,59 @@ CoreEntry::Remove(ThreadData* thread)
 }
 
 
+/*!	Returns a thread waiting in the run queue that another core could take
+	over, preferring threads whose cache affinity has expired, as they don't
+	lose anything by moving. Threads that are still cache hot are only
+	returned if \a crossPackage is \c false.
+	Only the first kMaxStealCandidates threads are looked at. The run queue
+	must be locked.
+*/
+ThreadData*
+CoreEntry::PeekStealableThread(bool crossPackage) const
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	ThreadData* hotThread = NULL;
+
+	ThreadRunQueue::ConstIterator iterator = fRunQueue.GetConstIterator();
+	for (int32 i = 0; i < kMaxStealCandidates && iterator.HasNext(); i++) {
+		ThreadData* thread = iterator.Next();
+		if (thread->HasCacheExpired())
+			return thread;
+
+		if (hotThread == NULL)
+			hotThread = thread;
+	}
+
+	return crossPackage ? NULL : hotThread;
+}
+
+
+void
+CoreEntry::PushDeadline(ThreadData* thread)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	fDeadlineQueue.Insert(thread, thread->Deadline());
+	atomic_add(&fDeadlineThreadCount, 1);
+}
+
+
+void
+CoreEntry::RemoveDeadline(ThreadData* thread)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	ASSERT(thread->IsEnqueued());
+	thread->SetDequeued();
+
+	fDeadlineQueue.ModifyKey(thread, -1);
+	ASSERT(fDeadlineQueue.PeekRoot() == thread);
+	fDeadlineQueue.RemoveRoot();
+	atomic_add(&fDeadlineThreadCount, -1);
+}
+
+
 void
 CoreEntry::AddCPU(CPUEntry* cpu)
 {
@@ -514,7 +727,17 @@ CoreEntry::RemoveCPU(CPUEntry* cpu, ThreadProcessing& threadPostProcessing)
 			threadPostProcessing(threadData);
 		}
 
+		while (fDeadlineQueue.PeekRoot() != NULL) {
+			ThreadData* threadData = fDeadlineQueue.PeekRoot();
+
+			RemoveDeadline(threadData);
+
+			ASSERT(threadData->Core() == NULL);
+			threadPostProcessing(threadData);
+		}
+
 		fThreadCount = 0;
+		fDeadlineThreadCount = 0;
 	}
 
 	fCPUHeap.ModifyKey(cpu, -1);
@@ -72,6 +72,11 @@ public:
 						ThreadData*		PeekIdleThread() const;
 
 						void			UpdatePriority(int32 priority);
+	inline				bigtime_t		RunningDeadline() const
+											{ return fRunningDeadline; }
+	inline				void			SetRunningDeadline(
+											bigtime_t deadline)
+											{ fRunningDeadline = deadline; }
 
 	inline				int32			GetLoad() const	{ return fLoad; }
 						void			ComputeLoad();
@@ -91,6 +96,9 @@ private:
 						void			_RequestPerformanceLevel(
 											ThreadData* threadData);
 
+						bool			_StealThread();
+						CoreEntry*		_ChooseStealVictim() const;
+
 	static				int32			_RescheduleEvent(timer* /* unused */);
 	static				int32			_UpdateLoadEvent(timer* /* unused */);
 
@@ -104,11 +112,16 @@ private:
 
 						int32			fLoad;
 
+						bigtime_t		fRunningDeadline;
+							// of the running thread, if it is deadline active
+
 						bigtime_t		fMeasureActiveTime;
 						bigtime_t		fMeasureTime;
 
 						bool			fUpdateLoadEvent;
 
+						bigtime_t		fNextStealAttempt;
+
 						friend class DebugDumper;
 } CACHE_LINE_ALIGN;
 
@@ -120,6 +133,10 @@ public:
 						void			Dump();
 };
 
+// Threads of the deadline class ready to run on a core, ordered by their
+// absolute deadlines.
+typedef Heap<ThreadData, bigtime_t> DeadlineQueue;
+
 class CoreEntry : public MinMaxHeapLinkImpl<CoreEntry, int32>,
 	public DoublyLinkedListLinkImpl<CoreEntry> {
 public:
@@ -138,6 +155,10 @@ public:
 	inline				CPUPriorityHeap*	CPUHeap();
 
 	inline				int32			ThreadCount() const;
+	inline				int32			QueuedThreadCount() const
+											{ return fThreadCount; }
+	inline				int32			IdleCPUCount() const
+											{ return fIdleCPUCount; }
 
 	inline				void			LockRunQueue();
 	inline				void			UnlockRunQueue();
@@ -148,6 +169,19 @@ public:
 											int32 priority);
 						void			Remove(ThreadData* thread);
 	inline				ThreadData*		PeekThread() const;
+						ThreadData*		PeekStealableThread(
+											bool crossPackage) const;
+
+						void			PushDeadline(ThreadData* thread);
+						void			RemoveDeadline(ThreadData* thread);
+	inline				ThreadData*		PeekDeadlineThread() const;
+	inline				int32			DeadlineThreadCount() const
+											{ return fDeadlineThreadCount; }
+
+	inline				int32			DeadlineLoad() const
+											{ return fDeadlineLoad; }
+	inline				void			ChangeDeadlineLoad(int32 delta)
+											{ fDeadlineLoad += delta; }
 
 	inline				bigtime_t		GetActiveTime() const;
 	inline				void			IncreaseActiveTime(
@@ -190,6 +224,10 @@ private:
 						ThreadRunQueue	fRunQueue;
 						spinlock		fQueueLock;
 
+						int32			fDeadlineThreadCount;
+						DeadlineQueue	fDeadlineQueue;
+						int32			fDeadlineLoad;
+
 						bigtime_t		fActiveTime;
 	mutable				seqlock			fActiveTimeLock;
 
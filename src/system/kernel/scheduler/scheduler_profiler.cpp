@@ -5,12 +5,61 @@
 
 #include "scheduler_profiler.h"
 
+#include <string.h>
+
 #include <debug.h>
 #include <util/AutoLock.h>
 
 #include <algorithm>
 
 
+Scheduler::Profiling::MigrationCounters
+	Scheduler::Profiling::gMigrationCounters[SMP_MAX_CPUS];
+
+
+static int
+dump_migration_counters(int argc, char** argv)
+{
+	using Scheduler::Profiling::MigrationCounters;
+	using Scheduler::Profiling::gMigrationCounters;
+
+	int32 cpuCount = smp_get_num_cpus();
+
+	if (argc == 2 && !strcmp(argv[1], "reset")) {
+		memset(gMigrationCounters, 0, sizeof(MigrationCounters) * cpuCount);
+		return 0;
+	}
+	if (argc != 1) {
+		print_debugger_command_usage(argv[0]);
+		return 0;
+	}
+
+	kprintf("cpu   steal attempts        steals  cross package    migrations\n");
+	for (int32 i = 0; i < cpuCount; i++) {
+		const MigrationCounters& counters = gMigrationCounters[i];
+		kprintf("%3" B_PRId32 " %16" B_PRId64 " %13" B_PRId64 " %14" B_PRId64
+			" %13" B_PRId64 "\n", i, counters.fStealAttempts, counters.fSteals,
+			counters.fCrossPackageSteals, counters.fMigrations);
+	}
+
+	return 0;
+}
+
+
+void
+Scheduler::Profiling::init_migration_counters()
+{
+	add_debugger_command_etc("scheduler_migrations", &dump_migration_counters,
+		"Show thread migration statistics",
+		"[ \"reset\" ]\n"
+		"Shows for each CPU how often it tried to steal a thread from another\n"
+		"core while idle, how often that succeeded (and how often the thread\n"
+		"was taken from another package), and how many threads have been\n"
+		"moved to its core.\n"
+		"  reset  - Clears all counters.\n", 0);
+}
+
+
 #ifdef SCHEDULER_PROFILING
 
 
@@ -6,6 +6,7 @@
 #define KERNEL_SCHEDULER_PROFILER_H
 
 
+#include <cpu.h>
 #include <smp.h>
 
 
@@ -132,5 +133,37 @@ Function::Exit()
 #endif	// !SCHEDULER_PROFILING
 
 
+namespace Scheduler {
+
+namespace Profiling {
+
+
+// Thread migration statistics. Unlike the function profiler these are always
+// collected, since they cost no more than an atomic add on a rare path.
+struct MigrationCounters {
+			int64			fStealAttempts;
+			int64			fSteals;
+			int64			fCrossPackageSteals;
+			int64			fMigrations;
+} CACHE_LINE_ALIGN;
+
+extern MigrationCounters gMigrationCounters[SMP_MAX_CPUS];
+
+
+inline void
+count_migration(int32 cpu, int64 MigrationCounters::*counter)
+{
+	atomic_add64(&(gMigrationCounters[cpu].*counter), 1);
+}
+
+
+void init_migration_counters();
+
+
+}	// namespace Profiling
+
+}	// namespace Scheduler
+
+
 #endif	// KERNEL_SCHEDULER_PROFILER_H
 
@@ -21,7 +21,7 @@ ThreadData::_InitBase()
 	fPriorityPenalty = 0;
 	fAdditionalPenalty = 0;
 	fEffectivePriority = GetPriority();
-	fBaseQuantum = sQuantumLengths[GetEffectivePriority()];
+	fBaseQuantum = sQuantumLengths[fEffectivePriority];
 
 	fTimeUsed = 0;
 	fStolenTime = 0;
@@ -35,6 +35,16 @@ ThreadData::_InitBase()
 
 	fEnqueued = false;
 	fReady = false;
+
+	fDeadlineRuntime = 0;
+	fDeadlineRelative = 0;
+	fDeadlinePeriod = 0;
+	fDeadlinePeriodStart = 0;
+	fDeadline = 0;
+	fDeadlineBudget = 0;
+	fDeadlineBudgetUpdate = 0;
+	fDeadlineCore = NULL;
+	fDeadlineQueueCore = NULL;
 }
 
 
@@ -142,6 +152,42 @@ ThreadData::Dump() const
 		fCore != NULL ? fCore->ID() : -1);
 	if (fCore != NULL && HasCacheExpired())
 		kprintf("\tcache affinity has expired\n");
+
+	if (IsDeadlineThread()) {
+		kprintf("\tdeadline_runtime:\t%" B_PRId64 " us\n", fDeadlineRuntime);
+		kprintf("\tdeadline_relative:\t%" B_PRId64 " us\n",
+			fDeadlineRelative);
+		kprintf("\tdeadline_period:\t%" B_PRId64 " us\n", fDeadlinePeriod);
+		kprintf("\tdeadline:\t\t%" B_PRId64 "\n", fDeadline);
+		kprintf("\tdeadline_budget:\t%" B_PRId64 " us\n", fDeadlineBudget);
+		kprintf("\tdeadline_core:\t\t%" B_PRId32 "\n",
+			fDeadlineCore != NULL ? fDeadlineCore->ID() : -1);
+	}
+}
+
+
+/*!	Puts the thread into the deadline class, or removes it from there, if
+	\a runtime is 0. The thread must not be enqueued, and its utilization
+	must have been accounted for on \a core by the caller.
+*/
+void
+ThreadData::SetDeadline(bigtime_t runtime, bigtime_t deadline,
+	bigtime_t period, CoreEntry* core)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	ASSERT(!fEnqueued);
+
+	fDeadlineRuntime = runtime;
+	fDeadlineRelative = deadline;
+	fDeadlinePeriod = period;
+	fDeadlineCore = runtime > 0 ? core : NULL;
+
+	// the first period starts now
+	fDeadlinePeriodStart = system_time();
+	fDeadlineBudgetUpdate = fDeadlinePeriodStart;
+	fDeadline = fDeadlinePeriodStart + deadline;
+	fDeadlineBudget = runtime;
 }
 
 
@@ -165,6 +211,11 @@ ThreadData::ChooseCoreAndCPU(CoreEntry*& targetCore, CPUEntry*& targetCPU)
 	ASSERT(targetCPU != NULL);
 
 	if (fCore != targetCore) {
+		if (fCore != NULL) {
+			Profiling::count_migration(targetCPU->ID(),
+				&Profiling::MigrationCounters::fMigrations);
+		}
+
 		fLoadMeasurementEpoch = targetCore->LoadMeasurementEpoch() - 1;
 		if (fReady) {
 			if (fCore != NULL)
@@ -290,7 +341,7 @@ ThreadData::_ComputeEffectivePriority() const
 		ASSERT(fEffectivePriority >= B_LOWEST_ACTIVE_PRIORITY);
 	}
 
-	fBaseQuantum = sQuantumLengths[GetEffectivePriority()];
+	fBaseQuantum = sQuantumLengths[fEffectivePriority];
 }
 
 
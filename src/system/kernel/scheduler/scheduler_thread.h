@@ -19,7 +19,7 @@ namespace Scheduler {
 
 
 struct ThreadData : public DoublyLinkedListLinkImpl<ThreadData>,
-	RunQueueLinkImpl<ThreadData> {
+	RunQueueLinkImpl<ThreadData>, HeapLinkImpl<ThreadData, bigtime_t> {
 private:
 	inline	void		_InitBase();
 
@@ -48,6 +48,17 @@ public:
 
 	inline	int32		GetEffectivePriority() const;
 
+	inline	bool		IsDeadlineThread() const
+							{ return fDeadlineRuntime > 0; }
+	inline	bool		IsDeadlineActive() const;
+	inline	bigtime_t	Deadline() const	{ return fDeadline; }
+	inline	bigtime_t	DeadlineRuntime() const	{ return fDeadlineRuntime; }
+	inline	bigtime_t	DeadlinePeriod() const	{ return fDeadlinePeriod; }
+	inline	CoreEntry*	DeadlineCore() const	{ return fDeadlineCore; }
+			void		SetDeadline(bigtime_t runtime, bigtime_t deadline,
+							bigtime_t period, CoreEntry* core);
+	inline	void		UpdateDeadlineBudget(bool running);
+
 	inline	void		StartCPUTime();
 	inline	void		StopCPUTime();
 
@@ -93,6 +104,8 @@ private:
 	inline	void		_IncreasePenalty();
 	inline	int32		_GetPenalty() const;
 
+	inline	void		_PushDeadline();
+
 			void		_ComputeNeededLoad();
 
 			void		_ComputeEffectivePriority() const;
@@ -129,6 +142,17 @@ private:
 			uint32		fLoadMeasurementEpoch;
 
 			CoreEntry*	fCore;
+
+			bigtime_t	fDeadlineRuntime;
+			bigtime_t	fDeadlineRelative;
+			bigtime_t	fDeadlinePeriod;
+			bigtime_t	fDeadlinePeriodStart;
+			bigtime_t	fDeadline;
+			bigtime_t	fDeadlineBudget;
+			bigtime_t	fDeadlineBudgetUpdate;
+			CoreEntry*	fDeadlineCore;
+			CoreEntry*	fDeadlineQueueCore;
+				// the core whose deadline queue the thread is in
 };
 
 class ThreadProcessing {
@@ -186,10 +210,25 @@ ThreadData::Rebalance() const
 }
 
 
+/*!	Returns whether the thread is scheduled by its deadline. That's the case
+	for deadline threads that have budget left in the current period. Pinned
+	threads stay in the run queue of their CPU, and are scheduled by priority.
+*/
+inline bool
+ThreadData::IsDeadlineActive() const
+{
+	return fDeadlineRuntime > 0 && fDeadlineBudget > 0
+		&& fThread->pinned_to_cpu == 0;
+}
+
+
 inline int32
 ThreadData::GetEffectivePriority() const
 {
 	SCHEDULER_ENTER_FUNCTION();
+
+	if (IsDeadlineActive())
+		return kDeadlinePriority;
 	return fEffectivePriority;
 }
 
@@ -213,6 +252,34 @@ ThreadData::_IncreasePenalty()
 }
 
 
+/*!	Charges the CPU time used since the last update to the budget of the
+	thread, if it has been \a running, and replenishes the budget once a new
+	period has started.
+*/
+inline void
+ThreadData::UpdateDeadlineBudget(bool running)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	if (!IsDeadlineThread())
+		return;
+
+	bigtime_t now = system_time();
+	if (running) {
+		fDeadlineBudget -= now - fDeadlineBudgetUpdate;
+		fDeadlineBudget = std::max(fDeadlineBudget, bigtime_t(0));
+		fDeadlineBudgetUpdate = now;
+	}
+
+	if (now >= fDeadlinePeriodStart + fDeadlinePeriod) {
+		bigtime_t periods = (now - fDeadlinePeriodStart) / fDeadlinePeriod;
+		fDeadlinePeriodStart += periods * fDeadlinePeriod;
+		fDeadline = fDeadlinePeriodStart + fDeadlineRelative;
+		fDeadlineBudget = fDeadlineRuntime;
+	}
+}
+
+
 inline void
 ThreadData::StartCPUTime()
 {
@@ -291,6 +358,16 @@ ThreadData::GetQuantumLeft()
 	quantum += stolenTime;
 	quantum = std::max(quantum, gCurrentMode->minimal_quantum);
 
+	if (IsDeadlineActive())
+		quantum = std::min(quantum, fDeadlineBudget);
+	else if (IsDeadlineThread()) {
+		// get back to the deadline queue as soon as the next period starts
+		bigtime_t periodLeft
+			= fDeadlinePeriodStart + fDeadlinePeriod - system_time();
+		quantum = std::min(quantum,
+			std::max(periodLeft, gCurrentMode->minimal_quantum));
+	}
+
 	return quantum;
 }
 
@@ -300,6 +377,7 @@ ThreadData::StartQuantum()
 {
 	SCHEDULER_ENTER_FUNCTION();
 	fQuantumStart = system_time();
+	fDeadlineBudgetUpdate = fQuantumStart;
 }
 
 
@@ -308,6 +386,11 @@ ThreadData::HasQuantumEnded(bool wasPreempted, bool hasYielded)
 {
 	SCHEDULER_ENTER_FUNCTION();
 
+	// deadline threads don't use up quanta as long as they stay within budget
+	UpdateDeadlineBudget(true);
+	if (IsDeadlineActive())
+		return hasYielded;
+
 	bigtime_t timeUsed = system_time() - fQuantumStart;
 	ASSERT(timeUsed >= 0);
 	fTimeUsed += timeUsed;
@@ -351,7 +434,8 @@ ThreadData::GoesAway()
 
 	ASSERT(fReady);
 
-	if (!HasQuantumEnded(false, false)) {
+	// deadline threads aren't penalized as long as they stay within budget
+	if (!HasQuantumEnded(false, false) && !IsDeadlineActive()) {
 		fAdditionalPenalty++;
 		_ComputeEffectivePriority();
 	}
@@ -386,7 +470,9 @@ ThreadData::PutBack()
 
 	int32 priority = GetEffectivePriority();
 
-	if (fThread->pinned_to_cpu > 0) {
+	if (IsDeadlineActive())
+		_PushDeadline();
+	else if (fThread->pinned_to_cpu > 0) {
 		ASSERT(fThread->cpu != NULL);
 		CPUEntry* cpu = CPUEntry::GetCPU(fThread->cpu->cpu_num);
 
@@ -429,7 +515,9 @@ ThreadData::Enqueue()
 
 	int32 priority = GetEffectivePriority();
 
-	if (fThread->pinned_to_cpu > 0) {
+	if (IsDeadlineActive())
+		_PushDeadline();
+	else if (fThread->pinned_to_cpu > 0) {
 		ASSERT(fThread->previous_cpu != NULL);
 		CPUEntry* cpu = CPUEntry::GetCPU(fThread->previous_cpu->cpu_num);
 
@@ -465,16 +553,45 @@ ThreadData::Dequeue()
 		return true;
 	}
 
+	if (IsDeadlineActive()) {
+		CoreRunQueueLocker _(fDeadlineQueueCore);
+		if (!fEnqueued)
+			return false;
+		fDeadlineQueueCore->RemoveDeadline(this);
+		ASSERT(!fEnqueued);
+		return true;
+	}
+
 	CoreRunQueueLocker _(fCore);
 	if (!fEnqueued)
 		return false;
-
 	fCore->Remove(this);
 	ASSERT(!fEnqueued);
 	return true;
 }
 
 
+/*!	Puts the thread into the deadline queue of its deadline core, or into the
+	one of its current core, if the deadline core has no enabled CPUs left.
+*/
+inline void
+ThreadData::_PushDeadline()
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	CoreEntry* core = fDeadlineCore;
+	if (core->CPUCount() == 0)
+		core = fCore;
+
+	CoreRunQueueLocker _(core);
+	ASSERT(!fEnqueued);
+	fEnqueued = true;
+
+	fDeadlineQueueCore = core;
+	core->PushDeadline(this);
+}
+
+
 inline void
 ThreadData::UpdateActivity(bigtime_t active)
 {
@@ -11,6 +11,7 @@
 
 #include <algorithm>
 
+#include <cpu.h>
 #include <int.h>
 #include <slab/Slab.h>
 #include <smp.h>
@@ -45,6 +46,13 @@ struct depot_cpu_store {
 };
 
 
+// Each time the depot lock has been found contended kContentionsPerResize
+// times, the capacity of newly allocated magazines is doubled, up to
+// kMaxMagazineCapacityFactor times the initial capacity.
+static const size_t kContentionsPerResize = 64;
+static const size_t kMaxMagazineCapacityFactor = 4;
+
+
 RANGE_MARKER_FUNCTION_BEGIN(SlabObjectDepot)
 
 
@@ -131,21 +139,57 @@ empty_magazine(object_depot* depot, DepotMagazine* magazine, uint32 flags)
 }
 
 
+/*!	Acquires the depot lock. Interrupts must be disabled.
+	Unlike acquire_spinlock() this doesn't process ICIs while spinning, so
+	that the per-CPU store callbacks of object_depot_make_empty() never run
+	while this CPU is in the middle of a magazine exchange.
+*/
+static inline void
+lock_depot(object_depot* depot)
+{
+	if (try_acquire_spinlock(&depot->inner_lock))
+		return;
+
+	while (!try_acquire_spinlock(&depot->inner_lock))
+		cpu_pause();
+
+	// The lock is contended -- use larger magazines, so that the CPUs need
+	// to exchange them less often.
+	if (++depot->contention_count % kContentionsPerResize == 0
+		&& depot->magazine_capacity < depot->max_magazine_capacity) {
+		depot->magazine_capacity = std::min(depot->magazine_capacity * 2,
+			depot->max_magazine_capacity);
+	}
+}
+
+
+static inline void
+unlock_depot(object_depot* depot)
+{
+	release_spinlock(&depot->inner_lock);
+}
+
+
 static bool
 exchange_with_full(object_depot* depot, DepotMagazine*& magazine)
 {
 	ASSERT(magazine->IsEmpty());
 
-	SpinLocker _(depot->inner_lock);
+	lock_depot(depot);
 
-	if (depot->full == NULL)
+	if (depot->full == NULL) {
+		depot->obtain_miss_count++;
+		unlock_depot(depot);
 		return false;
+	}
 
 	depot->full_count--;
 	depot->empty_count++;
 
 	_push(depot->empty, magazine);
 	magazine = _pop(depot->full);
+
+	unlock_depot(depot);
 	return true;
 }
 
@@ -156,10 +200,13 @@ exchange_with_empty(object_depot* depot, DepotMagazine*& magazine,
 {
 	ASSERT(magazine == NULL || magazine->IsFull());
 
-	SpinLocker _(depot->inner_lock);
+	lock_depot(depot);
 
-	if (depot->empty == NULL)
+	if (depot->empty == NULL) {
+		depot->store_miss_count++;
+		unlock_depot(depot);
 		return false;
+	}
 
 	depot->empty_count--;
 
@@ -173,6 +220,8 @@ exchange_with_empty(object_depot* depot, DepotMagazine*& magazine,
 	}
 
 	magazine = _pop(depot->empty);
+
+	unlock_depot(depot);
 	return true;
 }
 
@@ -180,10 +229,12 @@ exchange_with_empty(object_depot* depot, DepotMagazine*& magazine,
 static void
 push_empty_magazine(object_depot* depot, DepotMagazine* magazine)
 {
-	SpinLocker _(depot->inner_lock);
+	lock_depot(depot);
 
 	_push(depot->empty, magazine);
 	depot->empty_count++;
+
+	unlock_depot(depot);
 }
 
 
@@ -194,6 +245,34 @@ object_depot_cpu(object_depot* depot)
 }
 
 
+struct depot_make_empty_cookie {
+	object_depot*	depot;
+	DepotMagazine*	magazines[SMP_MAX_CPUS];
+};
+
+
+static void
+detach_cpu_store(void* _cookie, int cpu)
+{
+	depot_make_empty_cookie* cookie = (depot_make_empty_cookie*)_cookie;
+	depot_cpu_store& store = cookie->depot->stores[cpu];
+
+	DepotMagazine* magazines = NULL;
+
+	if (store.loaded != NULL) {
+		_push(magazines, store.loaded);
+		store.loaded = NULL;
+	}
+
+	if (store.previous != NULL) {
+		_push(magazines, store.previous);
+		store.previous = NULL;
+	}
+
+	cookie->magazines[cpu] = magazines;
+}
+
+
 // #pragma mark - public API
 
 
@@ -207,17 +286,18 @@ object_depot_init(object_depot* depot, size_t capacity, size_t maxCount,
 	depot->full_count = depot->empty_count = 0;
 	depot->max_count = maxCount;
 	depot->magazine_capacity = capacity;
+	depot->max_magazine_capacity = capacity * kMaxMagazineCapacityFactor;
+	depot->contention_count = 0;
+	depot->obtain_miss_count = 0;
+	depot->store_miss_count = 0;
 
-	rw_lock_init(&depot->outer_lock, "object depot");
 	B_INITIALIZE_SPINLOCK(&depot->inner_lock);
 
 	int cpuCount = smp_get_num_cpus();
 	depot->stores = (depot_cpu_store*)slab_internal_alloc(
 		sizeof(depot_cpu_store) * cpuCount, flags);
-	if (depot->stores == NULL) {
-		rw_lock_destroy(&depot->outer_lock);
+	if (depot->stores == NULL)
 		return B_NO_MEMORY;
-	}
 
 	for (int i = 0; i < cpuCount; i++) {
 		depot->stores[i].loaded = NULL;
@@ -237,15 +317,16 @@ object_depot_destroy(object_depot* depot, uint32 flags)
 	object_depot_make_empty(depot, flags);
 
 	slab_internal_free(depot->stores, flags);
-
-	rw_lock_destroy(&depot->outer_lock);
 }
 
 
+/*!	Returns an object from the depot, or \c NULL, if it has none left.
+	The store of the current CPU is only ever accessed by the CPU itself with
+	interrupts disabled, so that the fast path doesn't touch any shared state.
+*/
 void*
 object_depot_obtain(object_depot* depot)
 {
-	ReadLocker readLocker(depot->outer_lock);
 	InterruptsLocker interruptsLocker;
 
 	depot_cpu_store* store = object_depot_cpu(depot);
@@ -277,7 +358,6 @@ object_depot_obtain(object_depot* depot)
 void
 object_depot_store(object_depot* depot, void* object, uint32 flags)
 {
-	ReadLocker readLocker(depot->outer_lock);
 	InterruptsLocker interruptsLocker;
 
 	depot_cpu_store* store = object_depot_cpu(depot);
@@ -299,11 +379,9 @@ object_depot_store(object_depot* depot, void* object, uint32 flags)
 			if (freeMagazine != NULL) {
 				// Free the magazine that didn't have space in the list
 				interruptsLocker.Unlock();
-				readLocker.Unlock();
 
 				empty_magazine(depot, freeMagazine, flags);
 
-				readLocker.Lock();
 				interruptsLocker.Lock();
 
 				store = object_depot_cpu(depot);
@@ -311,7 +389,6 @@ object_depot_store(object_depot* depot, void* object, uint32 flags)
 		} else {
 			// allocate a new empty magazine
 			interruptsLocker.Unlock();
-			readLocker.Unlock();
 
 			DepotMagazine* magazine = alloc_magazine(depot, flags);
 			if (magazine == NULL) {
@@ -319,7 +396,6 @@ object_depot_store(object_depot* depot, void* object, uint32 flags)
 				return;
 			}
 
-			readLocker.Lock();
 			interruptsLocker.Lock();
 
 			push_empty_magazine(depot, magazine);
@@ -332,41 +408,33 @@ object_depot_store(object_depot* depot, void* object, uint32 flags)
 void
 object_depot_make_empty(object_depot* depot, uint32 flags)
 {
-	WriteLocker writeLocker(depot->outer_lock);
+	// collect the store magazines -- every CPU detaches its own store
 
-	// collect the store magazines
-
-	DepotMagazine* storeMagazines = NULL;
-
-	int cpuCount = smp_get_num_cpus();
-	for (int i = 0; i < cpuCount; i++) {
-		depot_cpu_store& store = depot->stores[i];
-
-		if (store.loaded) {
-			_push(storeMagazines, store.loaded);
-			store.loaded = NULL;
-		}
-
-		if (store.previous) {
-			_push(storeMagazines, store.previous);
-			store.previous = NULL;
-		}
-	}
+	depot_make_empty_cookie cookie;
+	cookie.depot = depot;
+	call_all_cpus_sync(&detach_cpu_store, &cookie);
 
 	// detach the depot's full and empty magazines
 
+	InterruptsSpinLocker locker(depot->inner_lock);
+
 	DepotMagazine* fullMagazines = depot->full;
 	depot->full = NULL;
+	depot->full_count = 0;
 
 	DepotMagazine* emptyMagazines = depot->empty;
 	depot->empty = NULL;
+	depot->empty_count = 0;
 
-	writeLocker.Unlock();
+	locker.Unlock();
 
 	// free all magazines
 
-	while (storeMagazines != NULL)
-		empty_magazine(depot, _pop(storeMagazines), flags);
+	int cpuCount = smp_get_num_cpus();
+	for (int i = 0; i < cpuCount; i++) {
+		while (cookie.magazines[i] != NULL)
+			empty_magazine(depot, _pop(cookie.magazines[i]), flags);
+	}
 
 	while (fullMagazines != NULL)
 		empty_magazine(depot, _pop(fullMagazines), flags);
@@ -378,25 +446,45 @@ object_depot_make_empty(object_depot* depot, uint32 flags)
 
 #if PARANOID_KERNEL_FREE
 
+struct depot_contains_object_cookie {
+	object_depot*	depot;
+	void*			object;
+	bool			found;
+};
+
+
+static void
+cpu_store_contains_object(void* _cookie, int cpu)
+{
+	depot_contains_object_cookie* cookie
+		= (depot_contains_object_cookie*)_cookie;
+	depot_cpu_store& store = cookie->depot->stores[cpu];
+
+	if (store.loaded != NULL && !store.loaded->IsEmpty()) {
+		if (store.loaded->ContainsObject(cookie->object))
+			cookie->found = true;
+	}
+
+	if (store.previous != NULL && !store.previous->IsEmpty()) {
+		if (store.previous->ContainsObject(cookie->object))
+			cookie->found = true;
+	}
+}
+
+
 bool
 object_depot_contains_object(object_depot* depot, void* object)
 {
-	WriteLocker writeLocker(depot->outer_lock);
+	depot_contains_object_cookie cookie;
+	cookie.depot = depot;
+	cookie.object = object;
+	cookie.found = false;
+	call_all_cpus_sync(&cpu_store_contains_object, &cookie);
 
-	int cpuCount = smp_get_num_cpus();
-	for (int i = 0; i < cpuCount; i++) {
-		depot_cpu_store& store = depot->stores[i];
+	if (cookie.found)
+		return true;
 
-		if (store.loaded != NULL && !store.loaded->IsEmpty()) {
-			if (store.loaded->ContainsObject(object))
-				return true;
-		}
-
-		if (store.previous != NULL && !store.previous->IsEmpty()) {
-			if (store.previous->ContainsObject(object))
-				return true;
-		}
-	}
+	InterruptsSpinLocker locker(depot->inner_lock);
 
 	for (DepotMagazine* magazine = depot->full; magazine != NULL;
 			magazine = magazine->next) {
@@ -419,7 +507,11 @@ dump_object_depot(object_depot* depot)
 	kprintf("  full:     %p, count %lu\n", depot->full, depot->full_count);
 	kprintf("  empty:    %p, count %lu\n", depot->empty, depot->empty_count);
 	kprintf("  max full: %lu\n", depot->max_count);
-	kprintf("  capacity: %lu\n", depot->magazine_capacity);
+	kprintf("  capacity: %lu (max %lu)\n", depot->magazine_capacity,
+		depot->max_magazine_capacity);
+	kprintf("  contention:    %lu\n", depot->contention_count);
+	kprintf("  obtain misses: %lu\n", depot->obtain_miss_count);
+	kprintf("  store misses:  %lu\n", depot->store_miss_count);
 	kprintf("  stores:\n");
 
 	int cpuCount = smp_get_num_cpus();
@@ -4356,6 +4356,9 @@ _user_get_extended_team_info(team_id teamID, uint32 flags, void* buffer,
 			gid_t	real_gid;
 			uid_t	effective_uid;
 			gid_t	effective_gid;
+			int32	page_faults;
+			int32	page_ins;
+			int32	fault_around_pages;
 			char	name[B_OS_NAME_LENGTH];
 		};
 
@@ -4387,6 +4390,14 @@ _user_get_extended_team_info(team_id teamID, uint32 flags, void* buffer,
 			teamClone->effective_uid = team->effective_uid;
 			teamClone->effective_gid = team->effective_gid;
 
+			VMAddressSpace* addressSpace = team->address_space;
+			teamClone->page_faults
+				= addressSpace != NULL ? addressSpace->FaultCount() : 0;
+			teamClone->page_ins
+				= addressSpace != NULL ? addressSpace->PageInCount() : 0;
+			teamClone->fault_around_pages
+				= addressSpace != NULL ? addressSpace->FaultAroundCount() : 0;
+
 			// also fetch a reference to the I/O context
 			ioContext = team->io_context;
 			vfs_get_io_context(ioContext);
@@ -4402,7 +4413,11 @@ _user_get_extended_team_info(team_id teamID, uint32 flags, void* buffer,
 			|| info.AddInt32("uid", teamClone->real_uid) != B_OK
 			|| info.AddInt32("gid", teamClone->real_gid) != B_OK
 			|| info.AddInt32("euid", teamClone->effective_uid) != B_OK
-			|| info.AddInt32("egid", teamClone->effective_gid) != B_OK) {
+			|| info.AddInt32("egid", teamClone->effective_gid) != B_OK
+			|| info.AddInt32("page faults", teamClone->page_faults) != B_OK
+			|| info.AddInt32("page ins", teamClone->page_ins) != B_OK
+			|| info.AddInt32("fault around pages",
+				teamClone->fault_around_pages) != B_OK) {
 			return B_NO_MEMORY;
 		}
 
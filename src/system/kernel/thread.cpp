@@ -2186,9 +2186,12 @@ thread_exit(void)
 	select_info* info = selectInfos;
 	while (info != NULL) {
 		select_sync* sync = info->sync;
+		select_info* next = info->next;
 
+		// the info must not be touched after notifying -- event queues
+		// might free it right away
 		notify_select_events(info, B_EVENT_INVALID);
-		info = info->next;
+		info = next;
 		put_select_sync(sync);
 	}
 
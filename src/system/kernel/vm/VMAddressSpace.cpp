@@ -92,6 +92,8 @@ VMAddressSpace::VMAddressSpace(team_id id, addr_t base, size_t size,
 	fID(id),
 	fRefCount(1),
 	fFaultCount(0),
+	fPageInCount(0),
+	fFaultAroundCount(0),
 	fChangeCount(0),
 	fTranslationMap(NULL),
 	fRandomizingEnabled(true),
@@ -176,6 +178,8 @@ VMAddressSpace::Dump() const
 	kprintf("id: %" B_PRId32 "\n", fID);
 	kprintf("ref_count: %" B_PRId32 "\n", fRefCount);
 	kprintf("fault_count: %" B_PRId32 "\n", fFaultCount);
+	kprintf("page_in_count: %" B_PRId32 "\n", fPageInCount);
+	kprintf("fault_around_count: %" B_PRId32 "\n", fFaultAroundCount);
 	kprintf("translation_map: %p\n", fTranslationMap);
 	kprintf("base: %#" B_PRIxADDR "\n", fBase);
 	kprintf("end: %#" B_PRIxADDR "\n", fEndAddress);
@@ -30,6 +30,7 @@
 
 #include <arch_config.h>
 #include <boot_device.h>
+#include <condition_variable.h>
 #include <disk_device_manager/KDiskDevice.h>
 #include <disk_device_manager/KDiskDeviceManager.h>
 #include <disk_device_manager/KDiskSystem.h>
@@ -56,6 +57,7 @@
 #include <vm/VMAddressSpace.h>
 
 #include "IORequest.h"
+#include "page_compression.h"
 
 
 #if	ENABLE_SWAP_SUPPORT
@@ -83,8 +85,30 @@
 #define SWAP_BLOCK_MASK  (SWAP_BLOCK_PAGES - 1)
 
 
+// share of the physical memory offered as compressed swap
+#define COMPRESSED_SWAP_MEMORY_SHARE	4
+	// 1/4 of the memory in pages, their compressed data may use 1/8
+#define COMPRESSED_SWAP_POOL_SHARE		8
+
+// interval in which the compressed swap writer checks the pool (in us)
+#define COMPRESSED_SWAP_WRITER_INTERVAL	1000000
+
+
 static const char* const kDefaultSwapPath = "/var/swap";
 
+// Size classes of the compressed swap pool. Pages that don't compress to the
+// largest one are written through to a swap file.
+static const size_t kCompressedSizeClasses[] = {
+	64, 128, 256, 384, 512, 768, 1024, 1536, 2048, 3072
+};
+static const uint32 kCompressedSizeClassCount
+	= B_COUNT_OF(kCompressedSizeClasses);
+static const size_t kMaxCompressedSize
+	= kCompressedSizeClasses[kCompressedSizeClassCount - 1];
+
+static const uint32 kCompressedSwapAllocationFlags
+	= CACHE_DONT_WAIT_FOR_MEMORY | CACHE_DONT_LOCK_KERNEL_SPACE;
+
 struct swap_file : DoublyLinkedListLinkImpl<swap_file> {
 	int				fd;
 	struct vnode*	vnode;
@@ -142,6 +166,24 @@ struct SwapHashTableDefinition {
 typedef BOpenHashTable<SwapHashTableDefinition> SwapHashTable;
 typedef DoublyLinkedList<swap_file> SwapFileList;
 
+// A page in the compressed swap tier. Its data is either held compressed in
+// memory, or has been written to a slot of a swap file.
+struct compressed_page : DoublyLinkedListLinkImpl<compressed_page> {
+	void*			data;
+	swap_addr_t		backing_slot;
+	uint16			size;
+	uint8			size_class;
+	uint8			flags;
+};
+
+enum {
+	COMPRESSED_PAGE_WRITING_BACK	= 0x01,
+	COMPRESSED_PAGE_LOADING			= 0x02,
+	COMPRESSED_PAGE_FREED			= 0x04
+};
+
+typedef DoublyLinkedList<compressed_page> CompressedPageList;
+
 static SwapHashTable sSwapHashTable;
 static rw_lock sSwapHashLock;
 
@@ -155,6 +197,29 @@ static mutex sAvailSwapSpaceLock;
 
 static object_cache* sSwapBlockCache;
 
+// The compressed swap tier is a swap file without a vnode in sSwapFileList,
+// so that its slots are allocated like any other. It does not add to the
+// available swap space, though: every page stored in it may have to go to a
+// swap file eventually, and the space for that has been reserved already.
+static swap_file* sCompressedSwap = NULL;
+static compressed_page** sCompressedPages;
+static CompressedPageList sCompressedPageList;
+	// pages with data in memory, least recently stored first
+static mutex sCompressedSwapLock;
+static object_cache* sCompressedPageCache;
+static object_cache* sCompressedDataCaches[kCompressedSizeClassCount];
+static size_t sCompressedPoolSize = 0;
+static size_t sCompressedPoolLimit = 0;
+static compressed_swap_info sCompressedSwapInfo;
+
+static mutex sCompressionLock;
+static uint8* sCompressionBuffer;
+static uint8* sCompressionOutput;
+static void* sCompressionWorkArea;
+
+static ConditionVariable sCompressedSwapWriterCondition;
+static uint8* sWriteBackBuffer;
+
 
 #if SWAP_TRACING
 namespace SwapTracing {
@@ -238,8 +303,14 @@ dump_swap_info(int argc, char** argv)
 	for (SwapFileList::Iterator it = sSwapFileList.GetIterator();
 		swap_file* file = it.Next();) {
 		swap_addr_t total = file->last_slot - file->first_slot;
-		kprintf("  vnode: %p, pages: total: %" B_PRIu32 ", free: %" B_PRIu32
-			"\n", file->vnode, total, file->bmp->free_slots);
+		if (file == sCompressedSwap) {
+			kprintf("  compressed, pages: total: %" B_PRIu32 ", free: %"
+				B_PRIu32 "\n", total, file->bmp->free_slots);
+			continue;
+		}
+
+		kprintf("  vnode: %p, pages: total: %" B_PRIu32 ", free: %"
+			B_PRIu32 "\n", file->vnode, total, file->bmp->free_slots);
 
 		totalSwapPages += total;
 		freeSwapPages += file->bmp->free_slots;
@@ -254,10 +325,83 @@ dump_swap_info(int argc, char** argv)
 	kprintf("used:      %9" B_PRIu32 "\n", totalSwapPages - freeSwapPages);
 	kprintf("free:      %9" B_PRIu32 "\n", freeSwapPages);
 
+	if (sCompressedSwap != NULL) {
+		const compressed_swap_info& info = sCompressedSwapInfo;
+		kprintf("\n");
+		kprintf("compressed swap:\n");
+		kprintf("stored pages:       %9" B_PRIu64 "\n", info.stored_pages);
+		kprintf("pool size:          %9" B_PRIuSIZE " / %" B_PRIuSIZE "\n",
+			sCompressedPoolSize, sCompressedPoolLimit);
+		if (sCompressedPoolSize > 0) {
+			kprintf("ratio:              %9" B_PRIu64 "%%\n",
+				info.stored_pages * B_PAGE_SIZE * 100 / sCompressedPoolSize);
+		}
+		kprintf("written back pages: %9" B_PRIu64 "\n",
+			info.written_back_pages);
+		kprintf("stores:             %9" B_PRIu64 "\n", info.stores);
+		kprintf("rejected:           %9" B_PRIu64 "\n", info.rejected);
+		kprintf("write backs:        %9" B_PRIu64 "\n", info.write_backs);
+		kprintf("hits:               %9" B_PRIu64 "\n", info.hits);
+		kprintf("misses:             %9" B_PRIu64 "\n", info.misses);
+	}
+
 	return 0;
 }
 
 
+static inline bool
+compressed_swap_contains(swap_addr_t slotIndex)
+{
+	return sCompressedSwap != NULL && slotIndex >= sCompressedSwap->first_slot
+		&& slotIndex < sCompressedSwap->last_slot;
+}
+
+
+static inline bool
+compressed_swap_has_room()
+{
+	return sCompressedPoolSize + kMaxCompressedSize <= sCompressedPoolLimit;
+}
+
+
+static void compressed_swap_free(swap_addr_t slotIndex);
+
+
+/*!	Allocates \a count slots from the swap files, leaving out the compressed
+	swap tier. The swap file list lock must be held.
+*/
+static swap_addr_t
+swap_file_slot_alloc(uint32 count)
+{
+	for (uint32 j = 0; j < sSwapFileCount; j++) {
+		if (sSwapFileAlloc == NULL)
+			sSwapFileAlloc = sSwapFileList.First();
+
+		if (sSwapFileAlloc != sCompressedSwap) {
+			swap_addr_t addr = radix_bitmap_alloc(sSwapFileAlloc->bmp, count);
+			if (addr != SWAP_SLOT_NONE) {
+				addr += sSwapFileAlloc->first_slot;
+
+				// if this swap file has used more than 90% percent of its
+				// space switch to another
+				if (sSwapFileAlloc->bmp->free_slots
+					< (sSwapFileAlloc->last_slot - sSwapFileAlloc->first_slot)
+						/ 10) {
+					sSwapFileAlloc = sSwapFileList.GetNext(sSwapFileAlloc);
+				}
+
+				return addr;
+			}
+		}
+
+		// this swap_file is full, find another
+		sSwapFileAlloc = sSwapFileList.GetNext(sSwapFileAlloc);
+	}
+
+	return SWAP_SLOT_NONE;
+}
+
+
 static swap_addr_t
 swap_slot_alloc(uint32 count)
 {
@@ -276,34 +420,30 @@ swap_slot_alloc(uint32 count)
 		return SWAP_SLOT_NONE;
 	}
 
-	swap_addr_t j, addr = SWAP_SLOT_NONE;
-	for (j = 0; j < sSwapFileCount; j++) {
-		if (sSwapFileAlloc == NULL)
-			sSwapFileAlloc = sSwapFileList.First();
-
-		addr = radix_bitmap_alloc(sSwapFileAlloc->bmp, count);
-		if (addr != SWAP_SLOT_NONE) {
-			addr += sSwapFileAlloc->first_slot;
-			break;
-		}
+	// Prefer the compressed swap tier as long as its pool has room left, and
+	// use it as a last resort otherwise.
+	bool compressedSwapHasRoom = compressed_swap_has_room();
+	swap_addr_t addr = SWAP_SLOT_NONE;
+	if (sCompressedSwap != NULL && compressedSwapHasRoom)
+		addr = radix_bitmap_alloc(sCompressedSwap->bmp, count);
+	if (addr != SWAP_SLOT_NONE)
+		addr += sCompressedSwap->first_slot;
+	else
+		addr = swap_file_slot_alloc(count);
 
-		// this swap_file is full, find another
-		sSwapFileAlloc = sSwapFileList.GetNext(sSwapFileAlloc);
+	if (addr == SWAP_SLOT_NONE && sCompressedSwap != NULL
+		&& !compressedSwapHasRoom) {
+		addr = radix_bitmap_alloc(sCompressedSwap->bmp, count);
+		if (addr != SWAP_SLOT_NONE)
+			addr += sCompressedSwap->first_slot;
 	}
 
-	if (j == sSwapFileCount) {
+	if (addr == SWAP_SLOT_NONE) {
 		mutex_unlock(&sSwapFileListLock);
 		panic("swap_slot_alloc: swap space exhausted!\n");
 		return SWAP_SLOT_NONE;
 	}
 
-	// if this swap file has used more than 90% percent of its space
-	// switch to another
-	if (sSwapFileAlloc->bmp->free_slots
-		< (sSwapFileAlloc->last_slot - sSwapFileAlloc->first_slot) / 10) {
-		sSwapFileAlloc = sSwapFileList.GetNext(sSwapFileAlloc);
-	}
-
 	mutex_unlock(&sSwapFileListLock);
 
 	return addr;
@@ -333,6 +473,11 @@ swap_slot_dealloc(swap_addr_t slotIndex, uint32 count)
 	if (slotIndex == SWAP_SLOT_NONE)
 		return;
 
+	if (compressed_swap_contains(slotIndex)) {
+		for (uint32 i = 0; i < count; i++)
+			compressed_swap_free(slotIndex + i);
+	}
+
 	mutex_lock(&sSwapFileListLock);
 	swap_file* swapFile = find_swap_file(slotIndex);
 	slotIndex -= swapFile->first_slot;
@@ -366,6 +511,468 @@ swap_space_unreserve(off_t amount)
 }
 
 
+/*!	Assigns the slots of \a swap and adds it to the swap file list. If
+	\a addSwapSpace is \c true, its pages are made available for reservation.
+*/
+static void
+swap_file_register(swap_file* swap, uint32 pageCount, bool addSwapSpace)
+{
+	// set slot index and add this file to swap file list
+	mutex_lock(&sSwapFileListLock);
+	if (sSwapFileList.IsEmpty()) {
+		swap->first_slot = 0;
+		swap->last_slot = pageCount;
+	} else {
+		// leave one page gap between two swap files
+		swap->first_slot = sSwapFileList.Last()->last_slot + 1;
+		swap->last_slot = swap->first_slot + pageCount;
+	}
+	sSwapFileList.Add(swap);
+	sSwapFileCount++;
+	mutex_unlock(&sSwapFileListLock);
+
+	if (addSwapSpace)
+		swap_space_unreserve((off_t)pageCount * B_PAGE_SIZE);
+}
+
+
+// #pragma mark - compressed swap
+
+
+static void
+compressed_page_free(compressed_page* page)
+{
+	if (page->backing_slot != SWAP_SLOT_NONE)
+		swap_slot_dealloc(page->backing_slot, 1);
+
+	if (page->data != NULL) {
+		object_cache_free(sCompressedDataCaches[page->size_class], page->data,
+			kCompressedSwapAllocationFlags);
+	}
+
+	object_cache_free(sCompressedPageCache, page,
+		kCompressedSwapAllocationFlags);
+}
+
+
+/*!	Removes the page stored in slot \a slotIndex, and returns it, if the caller
+	is supposed to free it. The compressed swap lock must be held.
+*/
+static compressed_page*
+compressed_swap_remove(swap_addr_t slotIndex)
+{
+	compressed_page*& entry
+		= sCompressedPages[slotIndex - sCompressedSwap->first_slot];
+	compressed_page* page = entry;
+	if (page == NULL)
+		return NULL;
+
+	entry = NULL;
+
+	if (page->data != NULL) {
+		sCompressedPoolSize -= kCompressedSizeClasses[page->size_class];
+		sCompressedSwapInfo.stored_pages--;
+
+		// while being written back, the page is not in the list
+		if ((page->flags & COMPRESSED_PAGE_WRITING_BACK) == 0)
+			sCompressedPageList.Remove(page);
+	} else
+		sCompressedSwapInfo.written_back_pages--;
+
+	if ((page->flags
+			& (COMPRESSED_PAGE_WRITING_BACK | COMPRESSED_PAGE_LOADING)) != 0) {
+		// whoever is still using the page will free it when done
+		page->flags |= COMPRESSED_PAGE_FREED;
+		return NULL;
+	}
+
+	return page;
+}
+
+
+static void
+compressed_swap_free(swap_addr_t slotIndex)
+{
+	MutexLocker locker(sCompressedSwapLock);
+	compressed_page* page = compressed_swap_remove(slotIndex);
+	locker.Unlock();
+
+	if (page != NULL)
+		compressed_page_free(page);
+}
+
+
+/*!	Writes the page at \a base to a newly allocated swap file slot.
+	\a flags may contain \c B_PHYSICAL_IO_REQUEST.
+*/
+static status_t
+compressed_swap_write_to_file(generic_addr_t base, uint32 flags,
+	swap_addr_t& _slotIndex)
+{
+	mutex_lock(&sSwapFileListLock);
+	swap_addr_t slotIndex = swap_file_slot_alloc(1);
+	mutex_unlock(&sSwapFileListLock);
+
+	if (slotIndex == SWAP_SLOT_NONE)
+		return B_DEVICE_FULL;
+
+	swap_file* swapFile = find_swap_file(slotIndex);
+	off_t pos = (off_t)(slotIndex - swapFile->first_slot) * B_PAGE_SIZE;
+
+	generic_io_vec vector;
+	vector.base = base;
+	vector.length = B_PAGE_SIZE;
+	generic_size_t length = B_PAGE_SIZE;
+
+	status_t status = vfs_write_pages(swapFile->vnode, swapFile->cookie, pos,
+		&vector, 1, flags, &length);
+	if (status != B_OK) {
+		swap_slot_dealloc(slotIndex, 1);
+		return status;
+	}
+
+	_slotIndex = slotIndex;
+	return B_OK;
+}
+
+
+/*!	Stores the page at \a base in the compressed swap slot \a slotIndex,
+	replacing what it contained before. If the page doesn't compress well, or
+	the pool is exhausted, it is written through to a swap file.
+*/
+static status_t
+compressed_swap_store(swap_addr_t slotIndex, generic_addr_t base,
+	uint32 flags)
+{
+	compressed_page* page = (compressed_page*)object_cache_alloc(
+		sCompressedPageCache, kCompressedSwapAllocationFlags);
+	if (page == NULL)
+		return B_NO_MEMORY;
+
+	page->data = NULL;
+	page->backing_slot = SWAP_SLOT_NONE;
+	page->size = 0;
+	page->size_class = 0;
+	page->flags = 0;
+
+	MutexLocker compressionLocker(sCompressionLock);
+
+	status_t status = B_OK;
+	if ((flags & B_PHYSICAL_IO_REQUEST) != 0) {
+		status = vm_memcpy_from_physical(sCompressionBuffer, base, B_PAGE_SIZE,
+			false);
+	} else
+		memcpy(sCompressionBuffer, (void*)(addr_t)base, B_PAGE_SIZE);
+
+	if (status != B_OK) {
+		compressionLocker.Unlock();
+		compressed_page_free(page);
+		return status;
+	}
+
+	size_t size = 0;
+	if (compressed_swap_has_room()) {
+		size = compress_page(sCompressionBuffer, sCompressionOutput,
+			kMaxCompressedSize, sCompressionWorkArea);
+	}
+
+	if (size > 0) {
+		uint32 sizeClass = 0;
+		while (kCompressedSizeClasses[sizeClass] < size)
+			sizeClass++;
+
+		page->data = object_cache_alloc(sCompressedDataCaches[sizeClass],
+			kCompressedSwapAllocationFlags);
+		if (page->data != NULL) {
+			memcpy(page->data, sCompressionOutput, size);
+			page->size = size;
+			page->size_class = sizeClass;
+		}
+	}
+
+	compressionLocker.Unlock();
+
+	if (page->data == NULL) {
+		// write the original page through, so that the compression buffers
+		// are not blocked while the I/O is in progress
+		status = compressed_swap_write_to_file(base, flags,
+			page->backing_slot);
+	}
+
+	if (status != B_OK) {
+		compressed_page_free(page);
+		return status;
+	}
+
+	MutexLocker locker(sCompressedSwapLock);
+
+	compressed_page* oldPage = compressed_swap_remove(slotIndex);
+	sCompressedPages[slotIndex - sCompressedSwap->first_slot] = page;
+
+	if (page->data != NULL) {
+		sCompressedPageList.Add(page);
+		sCompressedPoolSize += kCompressedSizeClasses[page->size_class];
+		sCompressedSwapInfo.stored_pages++;
+		sCompressedSwapInfo.stores++;
+	} else {
+		sCompressedSwapInfo.written_back_pages++;
+		sCompressedSwapInfo.rejected++;
+	}
+
+	bool wakeUpWriter = sCompressedPoolSize > sCompressedPoolLimit / 4 * 3;
+
+	locker.Unlock();
+
+	if (oldPage != NULL)
+		compressed_page_free(oldPage);
+
+	if (wakeUpWriter)
+		sCompressedSwapWriterCondition.NotifyAll();
+
+	return B_OK;
+}
+
+
+/*!	Reads the page stored in the compressed swap slot \a slotIndex to
+	\a base.
+*/
+static status_t
+compressed_swap_load(swap_addr_t slotIndex, generic_addr_t base, uint32 flags)
+{
+	MutexLocker locker(sCompressedSwapLock);
+
+	compressed_page* page
+		= sCompressedPages[slotIndex - sCompressedSwap->first_slot];
+	if (page == NULL) {
+		panic("compressed_swap_load(): slot %" B_PRIu32 " is empty\n",
+			slotIndex);
+		return B_ENTRY_NOT_FOUND;
+	}
+
+	if (page->data != NULL) {
+		sCompressedSwapInfo.hits++;
+
+		// The data stays valid as long as the page is marked loading, so we
+		// can decompress it without holding the lock.
+		page->flags |= COMPRESSED_PAGE_LOADING;
+		locker.Unlock();
+
+		status_t status;
+		if ((flags & B_PHYSICAL_IO_REQUEST) != 0) {
+			ASSERT(base % B_PAGE_SIZE == 0);
+
+			addr_t virtualAddress;
+			void* handle;
+			status = vm_get_physical_page(base, &virtualAddress, &handle);
+			if (status == B_OK) {
+				status = decompress_page(page->data, page->size,
+					(void*)virtualAddress);
+				vm_put_physical_page(virtualAddress, handle);
+			}
+		} else {
+			status = decompress_page(page->data, page->size,
+				(void*)(addr_t)base);
+		}
+
+		locker.Lock();
+
+		page->flags &= ~COMPRESSED_PAGE_LOADING;
+
+		if ((page->flags
+				& (COMPRESSED_PAGE_FREED | COMPRESSED_PAGE_WRITING_BACK))
+					== COMPRESSED_PAGE_FREED) {
+			// the slot has been freed in the meantime
+			locker.Unlock();
+			compressed_page_free(page);
+		}
+
+		return status;
+	}
+
+	sCompressedSwapInfo.misses++;
+	swap_addr_t backingSlot = page->backing_slot;
+	locker.Unlock();
+
+	swap_file* swapFile = find_swap_file(backingSlot);
+	off_t pos = (off_t)(backingSlot - swapFile->first_slot) * B_PAGE_SIZE;
+
+	generic_io_vec vector;
+	vector.base = base;
+	vector.length = B_PAGE_SIZE;
+	generic_size_t length = B_PAGE_SIZE;
+
+	return vfs_read_pages(swapFile->vnode, swapFile->cookie, pos, &vector, 1,
+		flags, &length);
+}
+
+
+/*!	Moves the least recently stored page from the pool to a swap file, if the
+	pool is filled beyond its low water mark.
+	Returns whether another page should be written back.
+*/
+static bool
+compressed_swap_write_back_page()
+{
+	MutexLocker locker(sCompressedSwapLock);
+
+	// nothing to do without a real swap file
+	if (sCompressedPoolSize <= sCompressedPoolLimit / 2 || sSwapFileCount < 2)
+		return false;
+
+	compressed_page* page = sCompressedPageList.RemoveHead();
+	if (page == NULL)
+		return false;
+
+	// The data stays valid as long as the page is marked writing back, so we
+	// can decompress and write it without holding the lock.
+	page->flags |= COMPRESSED_PAGE_WRITING_BACK;
+	locker.Unlock();
+
+	status_t status = decompress_page(page->data, page->size,
+		sWriteBackBuffer);
+
+	swap_addr_t backingSlot = SWAP_SLOT_NONE;
+	if (status == B_OK) {
+		status = compressed_swap_write_to_file((addr_t)sWriteBackBuffer, 0,
+			backingSlot);
+	}
+
+	locker.Lock();
+
+	page->flags &= ~COMPRESSED_PAGE_WRITING_BACK;
+
+	if ((page->flags & COMPRESSED_PAGE_FREED) != 0) {
+		// the slot has been freed in the meantime
+		page->backing_slot = backingSlot;
+		if ((page->flags & COMPRESSED_PAGE_LOADING) != 0) {
+			// the loader will free the page when it's done
+			return true;
+		}
+
+		locker.Unlock();
+		compressed_page_free(page);
+		return true;
+	}
+
+	if (status != B_OK || (page->flags & COMPRESSED_PAGE_LOADING) != 0) {
+		// try again later -- the data can't go away while it is being read
+		if (status == B_OK)
+			swap_slot_dealloc(backingSlot, 1);
+		sCompressedPageList.Add(page, false);
+		return false;
+	}
+
+	void* data = page->data;
+	uint8 sizeClass = page->size_class;
+	page->data = NULL;
+	page->backing_slot = backingSlot;
+
+	sCompressedPoolSize -= kCompressedSizeClasses[sizeClass];
+	sCompressedSwapInfo.stored_pages--;
+	sCompressedSwapInfo.written_back_pages++;
+	sCompressedSwapInfo.write_backs++;
+
+	locker.Unlock();
+
+	object_cache_free(sCompressedDataCaches[sizeClass], data,
+		kCompressedSwapAllocationFlags);
+	return true;
+}
+
+
+static status_t
+compressed_swap_writer(void*)
+{
+	while (true) {
+		sCompressedSwapWriterCondition.Wait(B_RELATIVE_TIMEOUT,
+			COMPRESSED_SWAP_WRITER_INTERVAL);
+
+		while (compressed_swap_write_back_page())
+			;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Sets up the compressed swap tier. It only caches pages in front of the
+	swap files, whose space has been reserved for them, so it must not be
+	set up before a swap file has been added.
+*/
+static status_t
+compressed_swap_init()
+{
+	void* settings = load_driver_settings("virtual_memory");
+	if (settings != NULL) {
+		bool enabled = get_driver_boolean_parameter(settings,
+			"compressed_swap", true, true);
+		unload_driver_settings(settings);
+
+		if (!enabled)
+			return B_OK;
+	}
+
+	uint32 pageCount = vm_page_num_pages() / COMPRESSED_SWAP_MEMORY_SHARE;
+	if (pageCount == 0)
+		return B_OK;
+
+	sCompressedPageCache = create_object_cache("compressed swap pages",
+		sizeof(compressed_page), sizeof(void*), NULL, NULL, NULL);
+	if (sCompressedPageCache == NULL)
+		return B_NO_MEMORY;
+
+	for (uint32 i = 0; i < kCompressedSizeClassCount; i++) {
+		char name[32];
+		snprintf(name, sizeof(name), "compressed swap %" B_PRIuSIZE,
+			kCompressedSizeClasses[i]);
+		sCompressedDataCaches[i] = create_object_cache(name,
+			kCompressedSizeClasses[i], sizeof(void*), NULL, NULL, NULL);
+		if (sCompressedDataCaches[i] == NULL)
+			return B_NO_MEMORY;
+	}
+
+	sCompressedPages = (compressed_page**)calloc(pageCount,
+		sizeof(compressed_page*));
+	sCompressionBuffer = (uint8*)malloc(B_PAGE_SIZE);
+	sCompressionOutput = (uint8*)malloc(kMaxCompressedSize);
+	sCompressionWorkArea = malloc(PAGE_COMPRESSION_WORK_AREA_SIZE);
+	sWriteBackBuffer = (uint8*)malloc(B_PAGE_SIZE);
+
+	swap_file* swap = (swap_file*)malloc(sizeof(swap_file));
+	if (sCompressedPages == NULL || sCompressionBuffer == NULL
+		|| sCompressionOutput == NULL || sCompressionWorkArea == NULL
+		|| sWriteBackBuffer == NULL || swap == NULL) {
+		return B_NO_MEMORY;
+	}
+
+	swap->fd = -1;
+	swap->vnode = NULL;
+	swap->cookie = NULL;
+	swap->bmp = radix_bitmap_create(pageCount);
+	if (swap->bmp == NULL)
+		return B_NO_MEMORY;
+
+	sCompressedPoolLimit = (size_t)vm_page_num_pages() * B_PAGE_SIZE
+		/ COMPRESSED_SWAP_POOL_SHARE;
+
+	sCompressedSwapWriterCondition.Init(&sCompressedSwap,
+		"compressed swap writer");
+	thread_id thread = spawn_kernel_thread(&compressed_swap_writer,
+		"compressed swap writer", B_LOW_PRIORITY, NULL);
+	if (thread < 0)
+		return thread;
+
+	swap_file_register(swap, pageCount, false);
+	sCompressedSwap = swap;
+
+	resume_thread(thread);
+	return B_OK;
+}
+
+
+// #pragma mark -
+
+
 static void
 swap_hash_resizer(void*, int)
 {
@@ -489,58 +1096,20 @@ status_t
 VMAnonymousCache::Resize(off_t newSize, int priority)
 {
 	// If the cache size shrinks, drop all swap pages beyond the new size.
-	if (fAllocatedSwapSize > 0) {
-		off_t oldPageCount = (virtual_end + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
-		swap_block* swapBlock = NULL;
-
-		for (off_t pageIndex = (newSize + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
-			pageIndex < oldPageCount && fAllocatedSwapSize > 0; pageIndex++) {
+	if (fAllocatedSwapSize > 0)
+		_FreeSwapPageRange(newSize, virtual_end);
 
-			WriteLocker locker(sSwapHashLock);
+	return VMCache::Resize(newSize, priority);
+}
 
-			// Get the swap slot index for the page.
-			swap_addr_t blockIndex = pageIndex & SWAP_BLOCK_MASK;
-			if (swapBlock == NULL || blockIndex == 0) {
-				swap_hash_key key = { this, pageIndex };
-				swapBlock = sSwapHashTable.Lookup(key);
 
-				if (swapBlock == NULL) {
-					pageIndex = ROUNDUP(pageIndex + 1, SWAP_BLOCK_PAGES);
-					continue;
-				}
-			}
-
-			swap_addr_t slotIndex = swapBlock->swap_slots[blockIndex];
-			vm_page* page;
-			if (slotIndex != SWAP_SLOT_NONE
-				&& ((page = LookupPage((off_t)pageIndex * B_PAGE_SIZE)) == NULL
-					|| !page->busy)) {
-					// TODO: We skip (i.e. leak) swap space of busy pages, since
-					// there could be I/O going on (paging in/out). Waiting is
-					// not an option as 1. unlocking the cache means that new
-					// swap pages could be added in a range we've already
-					// cleared (since the cache still has the old size) and 2.
-					// we'd risk a deadlock in case we come from the file cache
-					// and the FS holds the node's write-lock. We should mark
-					// the page invalid and let the one responsible clean up.
-					// There's just no such mechanism yet.
-				swap_slot_dealloc(slotIndex, 1);
-				fAllocatedSwapSize -= B_PAGE_SIZE;
-
-				swapBlock->swap_slots[blockIndex] = SWAP_SLOT_NONE;
-				if (--swapBlock->used == 0) {
-					// All swap pages have been freed -- we can discard the swap
-					// block.
-					sSwapHashTable.RemoveUnchecked(swapBlock);
-					object_cache_free(sSwapBlockCache, swapBlock,
-						CACHE_DONT_WAIT_FOR_MEMORY
-							| CACHE_DONT_LOCK_KERNEL_SPACE);
-				}
-			}
-		}
-	}
+status_t
+VMAnonymousCache::Discard(off_t offset, off_t size)
+{
+	if (fAllocatedSwapSize > 0)
+		_FreeSwapPageRange(offset, offset + size);
 
-	return VMCache::Resize(newSize, priority);
+	return VMCache::Discard(offset, size);
 }
 
 
@@ -606,6 +1175,16 @@ VMAnonymousCache::Read(off_t offset, const generic_io_vec* vecs, size_t count,
 		T(ReadPage(this, pageIndex, startSlotIndex));
 			// TODO: Assumes that only one page is read.
 
+		if (compressed_swap_contains(startSlotIndex)) {
+			for (uint32 k = i; k < j; k++) {
+				status_t status = compressed_swap_load(startSlotIndex + k - i,
+					vecs[k].base, flags);
+				if (status != B_OK)
+					return status;
+			}
+			continue;
+		}
+
 		swap_file* swapFile = find_swap_file(startSlotIndex);
 
 		off_t pos = (off_t)(startSlotIndex - swapFile->first_slot)
@@ -671,17 +1250,26 @@ VMAnonymousCache::Write(off_t offset, const generic_io_vec* vecs, size_t count,
 			T(WritePage(this, pageIndex, slotIndex));
 				// TODO: Assumes that only one page is written.
 
-			swap_file* swapFile = find_swap_file(slotIndex);
+			status_t status = B_OK;
+			if (compressed_swap_contains(slotIndex)) {
+				for (page_num_t k = 0; k < n && status == B_OK; k++) {
+					status = compressed_swap_store(slotIndex + k,
+						vectorBase + k * B_PAGE_SIZE, flags);
+				}
+			} else {
+				swap_file* swapFile = find_swap_file(slotIndex);
 
-			off_t pos = (off_t)(slotIndex - swapFile->first_slot) * B_PAGE_SIZE;
+				off_t pos = (off_t)(slotIndex - swapFile->first_slot)
+					* B_PAGE_SIZE;
 
-			generic_size_t length = (phys_addr_t)n * B_PAGE_SIZE;
-			generic_io_vec vector[1];
-			vector->base = vectorBase;
-			vector->length = length;
+				generic_size_t length = (phys_addr_t)n * B_PAGE_SIZE;
+				generic_io_vec vector[1];
+				vector->base = vectorBase;
+				vector->length = length;
 
-			status_t status = vfs_write_pages(swapFile->vnode, swapFile->cookie,
-				pos, vector, 1, flags, &length);
+				status = vfs_write_pages(swapFile->vnode, swapFile->cookie,
+					pos, vector, 1, flags, &length);
+			}
 			if (status != B_OK) {
 				locker.Lock();
 				fAllocatedSwapSize -= (off_t)pagesLeft * B_PAGE_SIZE;
@@ -758,6 +1346,14 @@ VMAnonymousCache::WriteAsync(off_t offset, const generic_io_vec* vecs,
 
 	T(WritePage(this, pageIndex, slotIndex));
 
+	// pages going to the compressed swap tier are stored right away
+	if (compressed_swap_contains(slotIndex)) {
+		status_t status = compressed_swap_store(slotIndex, vecs[0].base, flags);
+		callback->IOFinished(status, status != B_OK,
+			status == B_OK ? numBytes : 0);
+		return status;
+	}
+
 	// write the page asynchrounously
 	swap_file* swapFile = find_swap_file(slotIndex);
 	off_t pos = (off_t)(slotIndex - swapFile->first_slot) * B_PAGE_SIZE;
@@ -965,6 +1561,63 @@ VMAnonymousCache::_SwapBlockGetAddress(off_t pageIndex)
 }
 
 
+/*!	Frees the swap space of all pages from \a fromOffset (rounded up) to
+	\a toOffset.
+*/
+void
+VMAnonymousCache::_FreeSwapPageRange(off_t fromOffset, off_t toOffset)
+{
+	off_t toPageCount = (toOffset + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
+	swap_block* swapBlock = NULL;
+
+	for (off_t pageIndex = (fromOffset + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
+		pageIndex < toPageCount && fAllocatedSwapSize > 0; pageIndex++) {
+
+		WriteLocker locker(sSwapHashLock);
+
+		// Get the swap slot index for the page.
+		swap_addr_t blockIndex = pageIndex & SWAP_BLOCK_MASK;
+		if (swapBlock == NULL || blockIndex == 0) {
+			swap_hash_key key = { this, pageIndex };
+			swapBlock = sSwapHashTable.Lookup(key);
+
+			if (swapBlock == NULL) {
+				pageIndex = ROUNDUP(pageIndex + 1, SWAP_BLOCK_PAGES);
+				continue;
+			}
+		}
+
+		swap_addr_t slotIndex = swapBlock->swap_slots[blockIndex];
+		vm_page* page;
+		if (slotIndex != SWAP_SLOT_NONE
+			&& ((page = LookupPage((off_t)pageIndex * B_PAGE_SIZE)) == NULL
+				|| !page->busy)) {
+				// TODO: We skip (i.e. leak) swap space of busy pages, since
+				// there could be I/O going on (paging in/out). Waiting is
+				// not an option as 1. unlocking the cache means that new
+				// swap pages could be added in a range we've already
+				// cleared (since the cache still has the old size) and 2.
+				// we'd risk a deadlock in case we come from the file cache
+				// and the FS holds the node's write-lock. We should mark
+				// the page invalid and let the one responsible clean up.
+				// There's just no such mechanism yet.
+			swap_slot_dealloc(slotIndex, 1);
+			fAllocatedSwapSize -= B_PAGE_SIZE;
+
+			swapBlock->swap_slots[blockIndex] = SWAP_SLOT_NONE;
+			if (--swapBlock->used == 0) {
+				// All swap pages have been freed -- we can discard the swap
+				// block.
+				sSwapHashTable.RemoveUnchecked(swapBlock);
+				object_cache_free(sSwapBlockCache, swapBlock,
+					CACHE_DONT_WAIT_FOR_MEMORY
+						| CACHE_DONT_LOCK_KERNEL_SPACE);
+			}
+		}
+	}
+}
+
+
 status_t
 VMAnonymousCache::_Commit(off_t size, int priority)
 {
@@ -1329,24 +1982,8 @@ swap_file_add(const char* path)
 		return B_NO_MEMORY;
 	}
 
-	// set slot index and add this file to swap file list
-	mutex_lock(&sSwapFileListLock);
 	// TODO: Also check whether the swap file is already registered!
-	if (sSwapFileList.IsEmpty()) {
-		swap->first_slot = 0;
-		swap->last_slot = pageCount;
-	} else {
-		// leave one page gap between two swap files
-		swap->first_slot = sSwapFileList.Last()->last_slot + 1;
-		swap->last_slot = swap->first_slot + pageCount;
-	}
-	sSwapFileList.Add(swap);
-	sSwapFileCount++;
-	mutex_unlock(&sSwapFileListLock);
-
-	mutex_lock(&sAvailSwapSpaceLock);
-	sAvailSwapSpace += (off_t)pageCount * B_PAGE_SIZE;
-	mutex_unlock(&sAvailSwapSpaceLock);
+	swap_file_register(swap, pageCount, true);
 
 	return B_OK;
 }
@@ -1433,6 +2070,9 @@ swap_init(void)
 	mutex_init(&sAvailSwapSpaceLock, "avail swap space");
 	sAvailSwapSpace = 0;
 
+	mutex_init(&sCompressedSwapLock, "compressed swap");
+	mutex_init(&sCompressionLock, "swap compression");
+
 	add_debugger_command_etc("swap", &dump_swap_info,
 		"Print infos about the swap usage",
 		"\n"
@@ -1614,6 +2254,15 @@ swap_init_post_modules()
 	if (error != B_OK) {
 		dprintf("%s: Failed to add swap file %s: %s\n", __func__, swapPath,
 			strerror(error));
+		return;
+	}
+
+	// Without a swap file there is no swap space that could be reserved for
+	// the pages in the compressed swap tier, so it is only set up now.
+	error = compressed_swap_init();
+	if (error != B_OK) {
+		dprintf("%s: Failed to create compressed swap: %s\n", __func__,
+			strerror(error));
 	}
 }
 
@@ -1657,7 +2306,8 @@ swap_total_swap_pages()
 	uint32 totalSwapSlots = 0;
 	for (SwapFileList::Iterator it = sSwapFileList.GetIterator();
 		swap_file* swapFile = it.Next();) {
-		totalSwapSlots += swapFile->last_slot - swapFile->first_slot;
+		if (swapFile != sCompressedSwap)
+			totalSwapSlots += swapFile->last_slot - swapFile->first_slot;
 	}
 
 	mutex_unlock(&sSwapFileListLock);
@@ -1669,6 +2319,34 @@ swap_total_swap_pages()
 #endif	// ENABLE_SWAP_SUPPORT
 
 
+void
+swap_get_compressed_info(compressed_swap_info* info)
+{
+#if ENABLE_SWAP_SUPPORT
+	MutexLocker locker(sCompressedSwapLock);
+	*info = sCompressedSwapInfo;
+	info->compressed_size = sCompressedPoolSize;
+#else
+	memset(info, 0, sizeof(compressed_swap_info));
+#endif
+}
+
+
+status_t
+_user_get_compressed_swap_info(compressed_swap_info* userInfo, size_t size)
+{
+	if (size != sizeof(compressed_swap_info))
+		return B_BAD_VALUE;
+	if (!IS_USER_ADDRESS(userInfo))
+		return B_BAD_ADDRESS;
+
+	compressed_swap_info info;
+	swap_get_compressed_info(&info);
+
+	return user_memcpy(userInfo, &info, sizeof(info));
+}
+
+
 void
 swap_get_info(system_info* info)
 {
@@ -40,6 +40,7 @@ public:
 									uint32 allocationFlags);
 
 	virtual	status_t			Resize(off_t newSize, int priority);
+	virtual	status_t			Discard(off_t offset, off_t size);
 
 	virtual	status_t			Commit(off_t size, int priority);
 	virtual	bool				HasPage(off_t offset);
@@ -76,6 +77,8 @@ private:
 			void				_SwapBlockBuild(off_t pageIndex,
 									swap_addr_t slotIndex, uint32 count);
 			void        		_SwapBlockFree(off_t pageIndex, uint32 count);
+			void				_FreeSwapPageRange(off_t fromOffset,
+									off_t toOffset);
 			swap_addr_t			_SwapBlockGetAddress(off_t pageIndex);
 			status_t			_Commit(off_t size, int priority);
 
@@ -100,6 +103,7 @@ private:
 
 
 extern "C" void swap_get_info(system_info* info);
+extern "C" void swap_get_compressed_info(compressed_swap_info* info);
 
 
 #endif	/* _KERNEL_VM_STORE_ANONYMOUS_H */
@@ -1142,6 +1142,39 @@ VMCache::Resize(off_t newSize, int priority)
 }
 
 
+/*!	Frees the pages in the given range of the cache, their contents are lost.
+	Busy and wired pages are left alone.
+	You have to call this function with the VMCache lock held.
+*/
+status_t
+VMCache::Discard(off_t offset, off_t size)
+{
+	AssertLocked();
+
+	page_num_t startPage = offset >> PAGE_SHIFT;
+	page_num_t endPage = (offset + size + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
+
+	for (VMCachePagesTree::Iterator it
+				= pages.GetIterator(startPage, true, true);
+			vm_page* page = it.Next();) {
+		if (page->cache_offset >= endPage)
+			break;
+
+		if (page->busy || page->WiredCount() > 0)
+			continue;
+
+		DEBUG_PAGE_ACCESS_START(page);
+		vm_remove_all_page_mappings(page);
+		RemovePage(page);
+		vm_page_free(this, page);
+			// Note: When iterating through a IteratableSplayTree
+			// removing the current node is safe.
+	}
+
+	return B_OK;
+}
+
+
 /*!	You have to call this function with the VMCache lock held. */
 status_t
 VMCache::FlushAndRemoveAllPages()
@@ -39,6 +39,39 @@ VMTranslationMap::DebugMarkRangePresent(addr_t start, addr_t end,
 }
 
 
+/*!	Returns the size of the large pages the map can use, or \c 0, if it
+	doesn't support them.
+	The default implementation returns \c 0.
+*/
+size_t
+VMTranslationMap::LargePageSize() const
+{
+	return 0;
+}
+
+
+/*!	Replaces the mappings of all suitably aligned, physically contiguous
+	and uniformly protected large page sized ranges within the given range by
+	large page mappings. The mappings remain observable and changeable page by
+	page; the map transparently splits a large page again when needed.
+	The default implementation does nothing.
+*/
+void
+VMTranslationMap::CollapseLargePages(addr_t start, addr_t end)
+{
+}
+
+
+/*!	Returns the number of large pages mapped within the given range.
+	The default implementation returns \c 0.
+*/
+size_t
+VMTranslationMap::CountLargePages(addr_t start, addr_t end)
+{
+	return 0;
+}
+
+
 /*!	Unmaps a range of pages of an area.
 
 	The default implementation just iterates over all virtual pages of the
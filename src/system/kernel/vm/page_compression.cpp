@@ -0,0 +1,228 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	A simple and fast LZ77 style compressor for single pages, as used by the
+	compressed swap tier.
+
+	The compressed data is a sequence of blocks. Each block starts with a token
+	byte. Its upper four bits are the number of literal bytes following the
+	token, its lower four bits the length of the match following the literals
+	minus kMinMatchLength. A value of 15 means that the length continues in the
+	following bytes, each of which adds its value, up to and including the
+	first byte that is not 255. The literals come after the literal length, the
+	match is given by a 16 bit little endian offset back from the current
+	position, followed by the rest of the match length, if any.
+	The last block only consists of the token and the literals.
+*/
+
+
+#include "page_compression.h"
+
+#include <string.h>
+
+#include <debug.h>
+
+
+static const size_t kMinMatchLength = 4;
+
+
+static inline uint32
+read_sequence(const uint8* data)
+{
+	uint32 sequence;
+	memcpy(&sequence, data, sizeof(sequence));
+	return sequence;
+}
+
+
+static inline uint32
+hash_sequence(uint32 sequence)
+{
+	return (sequence * 2654435761U) >> (32 - PAGE_COMPRESSION_HASH_BITS);
+}
+
+
+static inline bool
+write_length(uint8*& out, const uint8* outEnd, size_t length)
+{
+	while (length >= 255) {
+		if (out == outEnd)
+			return false;
+		*out++ = 255;
+		length -= 255;
+	}
+
+	if (out == outEnd)
+		return false;
+	*out++ = length;
+	return true;
+}
+
+
+static inline bool
+read_length(const uint8*& in, const uint8* inEnd, size_t& length)
+{
+	uint8 value;
+	do {
+		if (in == inEnd)
+			return false;
+		value = *in++;
+		length += value;
+	} while (value == 255);
+
+	return true;
+}
+
+
+/*!	Writes a block with the given literals and match. A \a matchLength of 0
+	writes the final block.
+*/
+static bool
+write_block(uint8*& out, const uint8* outEnd, const uint8* literals,
+	size_t literalLength, size_t offset, size_t matchLength)
+{
+	if (out == outEnd)
+		return false;
+
+	size_t matchCode = matchLength > 0 ? matchLength - kMinMatchLength : 0;
+	*out++ = (min_c(literalLength, 15) << 4) | min_c(matchCode, 15);
+
+	if (literalLength >= 15 && !write_length(out, outEnd, literalLength - 15))
+		return false;
+
+	if ((size_t)(outEnd - out) < literalLength)
+		return false;
+	memcpy(out, literals, literalLength);
+	out += literalLength;
+
+	if (matchLength == 0)
+		return true;
+
+	if (outEnd - out < 2)
+		return false;
+	*out++ = offset & 0xff;
+	*out++ = offset >> 8;
+
+	if (matchCode >= 15 && !write_length(out, outEnd, matchCode - 15))
+		return false;
+
+	return true;
+}
+
+
+// #pragma mark -
+
+
+/*!	Compresses the page \a page into \a buffer.
+	\a workArea must point to PAGE_COMPRESSION_WORK_AREA_SIZE bytes of scratch
+	memory.
+	Returns the size of the compressed data, or \c 0, if it would not fit into
+	\a bufferSize bytes.
+*/
+size_t
+compress_page(const void* _page, void* buffer, size_t bufferSize,
+	void* workArea)
+{
+	// positions and offsets are stored in 16 bits
+	STATIC_ASSERT(B_PAGE_SIZE < 65536);
+
+	const uint8* page = (const uint8*)_page;
+	uint8* out = (uint8*)buffer;
+	const uint8* outEnd = out + bufferSize;
+
+	// The table maps sequence hashes to the position after the one they were
+	// last seen at, so that 0 can mean "not seen".
+	uint16* table = (uint16*)workArea;
+	memset(table, 0, PAGE_COMPRESSION_WORK_AREA_SIZE);
+
+	size_t anchor = 0;
+	size_t position = 0;
+	while (position + kMinMatchLength <= B_PAGE_SIZE) {
+		uint32 sequence = read_sequence(page + position);
+		uint32 hash = hash_sequence(sequence);
+		size_t candidate = table[hash];
+		table[hash] = position + 1;
+
+		if (candidate == 0 || read_sequence(page + candidate - 1) != sequence) {
+			position++;
+			continue;
+		}
+		candidate--;
+
+		size_t matchLength = kMinMatchLength;
+		while (position + matchLength < B_PAGE_SIZE
+			&& page[candidate + matchLength] == page[position + matchLength]) {
+			matchLength++;
+		}
+
+		if (!write_block(out, outEnd, page + anchor, position - anchor,
+				position - candidate, matchLength)) {
+			return 0;
+		}
+
+		position += matchLength;
+		anchor = position;
+	}
+
+	if (!write_block(out, outEnd, page + anchor, B_PAGE_SIZE - anchor, 0, 0))
+		return 0;
+
+	return out - (uint8*)buffer;
+}
+
+
+/*!	Decompresses \a size bytes of data produced by compress_page() into
+	\a page.
+*/
+status_t
+decompress_page(const void* data, size_t size, void* _page)
+{
+	const uint8* in = (const uint8*)data;
+	const uint8* inEnd = in + size;
+	uint8* page = (uint8*)_page;
+	size_t position = 0;
+
+	while (in < inEnd) {
+		uint8 token = *in++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !read_length(in, inEnd, literalLength))
+			return B_BAD_DATA;
+
+		if ((size_t)(inEnd - in) < literalLength
+			|| B_PAGE_SIZE - position < literalLength) {
+			return B_BAD_DATA;
+		}
+
+		memcpy(page + position, in, literalLength);
+		in += literalLength;
+		position += literalLength;
+
+		if (in == inEnd)
+			break;
+
+		if (inEnd - in < 2)
+			return B_BAD_DATA;
+		size_t offset = in[0] | ((size_t)in[1] << 8);
+		in += 2;
+
+		size_t matchLength = token & 0xf;
+		if (matchLength == 15 && !read_length(in, inEnd, matchLength))
+			return B_BAD_DATA;
+		matchLength += kMinMatchLength;
+
+		if (offset == 0 || offset > position
+			|| B_PAGE_SIZE - position < matchLength) {
+			return B_BAD_DATA;
+		}
+
+		// the match may overlap the bytes it produces
+		for (size_t i = 0; i < matchLength; i++, position++)
+			page[position] = page[position - offset];
+	}
+
+	return position == B_PAGE_SIZE ? B_OK : B_BAD_DATA;
+}
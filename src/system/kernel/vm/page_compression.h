@@ -0,0 +1,22 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _KERNEL_VM_PAGE_COMPRESSION_H
+#define _KERNEL_VM_PAGE_COMPRESSION_H
+
+
+#include <OS.h>
+
+
+#define PAGE_COMPRESSION_HASH_BITS		12
+#define PAGE_COMPRESSION_WORK_AREA_SIZE	\
+	((1 << PAGE_COMPRESSION_HASH_BITS) * sizeof(uint16))
+
+
+size_t		compress_page(const void* page, void* buffer, size_t bufferSize,
+				void* workArea);
+status_t	decompress_page(const void* data, size_t size, void* page);
+
+
+#endif	// _KERNEL_VM_PAGE_COMPRESSION_H
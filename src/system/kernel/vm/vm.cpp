@@ -33,6 +33,7 @@
 #include <condition_variable.h>
 #include <console.h>
 #include <debug.h>
+#include <driver_settings.h>
 #include <file_cache.h>
 #include <fs/fd.h>
 #include <heap.h>
@@ -56,6 +57,7 @@
 #include "VMAddressSpaceLocking.h"
 #include "VMAnonymousCache.h"
 #include "VMAnonymousNoSwapCache.h"
+#include "VMPageQueue.h"
 #include "IORequest.h"
 
 
@@ -73,6 +75,10 @@
 #endif
 
 
+// maximum number of pages mapped around a page fault
+#define MAX_FAULT_AROUND_PAGES	32
+
+
 namespace {
 
 class AreaCacheLocking {
@@ -250,6 +256,9 @@ static off_t sAvailableMemory;
 static off_t sNeededMemory;
 static mutex sAvailableMemoryLock = MUTEX_INITIALIZER("available memory lock");
 static uint32 sPageFaults;
+static uint32 sFaultAroundPages = 16;
+	// size of the naturally aligned window of resident file pages mapped on a
+	// read fault, a power of two; 1 disables fault-around
 
 static VMPhysicalPageMapper* sPhysicalPageMapper;
 
@@ -1299,6 +1308,7 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 	// For full lock or contiguous areas we're also going to map the pages and
 	// thus need to reserve pages for the mapping backend upfront.
 	addr_t reservedMapPages = 0;
+	size_t largePageSize = 0;
 	if (wiring == B_FULL_LOCK || wiring == B_CONTIGUOUS) {
 		AddressSpaceWriteLocker locker;
 		status_t status = locker.SetTo(team);
@@ -1307,6 +1317,31 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 
 		VMTranslationMap* map = locker.AddressSpace()->TranslationMap();
 		reservedMapPages = map->MaxPagesNeededToMap(0, size - 1);
+		largePageSize = map->LargePageSize();
+	}
+
+	// Wired areas that are large enough are placed at a large page boundary,
+	// so that the translation map can map them using large pages.
+	bool useLargePages = false;
+	virtual_address_restrictions largePageAddressRestrictions;
+	if (largePageSize != 0 && size >= largePageSize && !isStack
+		&& guardSize == 0) {
+		switch (virtualAddressRestrictions->address_specification) {
+			case B_ANY_ADDRESS:
+			case B_ANY_KERNEL_ADDRESS:
+			case B_RANDOMIZED_ANY_ADDRESS:
+				largePageAddressRestrictions = *virtualAddressRestrictions;
+				if (largePageAddressRestrictions.alignment < largePageSize)
+					largePageAddressRestrictions.alignment = largePageSize;
+				virtualAddressRestrictions = &largePageAddressRestrictions;
+				useLargePages = true;
+				break;
+
+			case B_EXACT_ADDRESS:
+				useLargePages = (addr_t)virtualAddressRestrictions->address
+					% largePageSize == 0;
+				break;
+		}
 	}
 
 	int priority;
@@ -1338,12 +1373,34 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 	VMAddressSpace* addressSpace;
 	status_t status;
 
+	// For full lock areas try to allocate physically contiguous runs for the
+	// large page sized parts of the area, so that they can be mapped as large
+	// pages.
+	VMPageQueue::PageList largePageRuns;
+	page_num_t largePageRunPages = 0;
+	if (wiring == B_FULL_LOCK && useLargePages
+		&& (flags & CREATE_AREA_DONT_WAIT) == 0) {
+		physical_address_restrictions runRestrictions = {};
+		runRestrictions.alignment = largePageSize;
+
+		for (addr_t i = size / largePageSize; i > 0; i--) {
+			vm_page* run = vm_page_allocate_page_run(
+				PAGE_STATE_WIRED | pageAllocFlags, largePageSize / B_PAGE_SIZE,
+				&runRestrictions, priority);
+			if (run == NULL)
+				break;
+
+			largePageRuns.Add(run);
+			largePageRunPages += largePageSize / B_PAGE_SIZE;
+		}
+	}
+
 	// For full lock areas reserve the pages before locking the address
 	// space. E.g. block caches can't release their memory while we hold the
 	// address space lock.
 	page_num_t reservedPages = reservedMapPages;
 	if (wiring == B_FULL_LOCK)
-		reservedPages += size / B_PAGE_SIZE;
+		reservedPages += size / B_PAGE_SIZE - largePageRunPages;
 
 	vm_page_reservation reservation;
 	if (reservedPages > 0) {
@@ -1361,8 +1418,18 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 	if (wiring == B_CONTIGUOUS) {
 		// we try to allocate the page run here upfront as this may easily
 		// fail for obvious reasons
-		page = vm_page_allocate_page_run(PAGE_STATE_WIRED | pageAllocFlags,
-			size / B_PAGE_SIZE, physicalAddressRestrictions, priority);
+		if (useLargePages && physicalAddressRestrictions->alignment == 0) {
+			// prefer a run that can be mapped using large pages
+			physical_address_restrictions runRestrictions
+				= *physicalAddressRestrictions;
+			runRestrictions.alignment = largePageSize;
+			page = vm_page_allocate_page_run(PAGE_STATE_WIRED | pageAllocFlags,
+				size / B_PAGE_SIZE, &runRestrictions, priority);
+		}
+		if (page == NULL) {
+			page = vm_page_allocate_page_run(PAGE_STATE_WIRED | pageAllocFlags,
+				size / B_PAGE_SIZE, physicalAddressRestrictions, priority);
+		}
 		if (page == NULL) {
 			status = B_NO_MEMORY;
 			goto err0;
@@ -1419,8 +1486,11 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 
 		case B_FULL_LOCK:
 		{
-			// Allocate and map all pages for this area
+			// Allocate and map all pages for this area, taking them from the
+			// large page runs first
 
+			page_num_t runPageNumber = 0;
+			page_num_t runPagesLeft = 0;
 			off_t offset = 0;
 			for (addr_t address = area->Base();
 					address < area->Base() + (area->Size() - 1);
@@ -1435,8 +1505,21 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 #	endif
 					continue;
 #endif
-				vm_page* page = vm_page_allocate_page(&reservation,
-					PAGE_STATE_WIRED | pageAllocFlags);
+				if (runPagesLeft == 0 && !largePageRuns.IsEmpty()) {
+					runPageNumber
+						= largePageRuns.RemoveHead()->physical_page_number;
+					runPagesLeft = largePageSize / B_PAGE_SIZE;
+				}
+
+				vm_page* page;
+				if (runPagesLeft > 0) {
+					page = vm_lookup_page(runPageNumber++);
+					runPagesLeft--;
+				} else {
+					page = vm_page_allocate_page(&reservation,
+						PAGE_STATE_WIRED | pageAllocFlags);
+				}
+
 				cache->InsertPage(page, offset);
 				map_page(area, page, address, protection, &reservation);
 
@@ -1527,6 +1610,14 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 			break;
 	}
 
+	if (useLargePages) {
+		VMTranslationMap* map = addressSpace->TranslationMap();
+		map->Lock();
+		map->CollapseLargePages(area->Base(),
+			area->Base() + (area->Size() - 1));
+		map->Unlock();
+	}
+
 	cache->Unlock();
 
 	if (reservedPages > 0)
@@ -1552,6 +1643,12 @@ err1:
 	}
 
 err0:
+	while (vm_page* run = largePageRuns.RemoveHead()) {
+		page_num_t pageNumber = run->physical_page_number;
+		for (size_t i = largePageSize / B_PAGE_SIZE; i-- > 0; pageNumber++)
+			vm_page_set_state(vm_lookup_page(pageNumber), PAGE_STATE_FREE);
+	}
+
 	if (reservedPages > 0)
 		vm_page_unreserve_pages(&reservation);
 	if (reservedMemory > 0)
@@ -1602,6 +1699,29 @@ vm_map_physical_memory(team_id team, const char* name, void** _address,
 	virtual_address_restrictions addressRestrictions = {};
 	addressRestrictions.address = *_address;
 	addressRestrictions.address_specification = addressSpec & ~B_MTR_MASK;
+
+	// If the physical range is suitably aligned, place the area at a large
+	// page boundary as well, so that it can be mapped using large pages.
+	size_t largePageSize
+		= locker.AddressSpace()->TranslationMap()->LargePageSize();
+	bool useLargePages = false;
+	if (!alreadyWired && largePageSize != 0 && size >= largePageSize
+		&& physicalAddress % largePageSize == 0) {
+		switch (addressRestrictions.address_specification) {
+			case B_ANY_ADDRESS:
+			case B_ANY_KERNEL_ADDRESS:
+			case B_RANDOMIZED_ANY_ADDRESS:
+				addressRestrictions.alignment = largePageSize;
+				useLargePages = true;
+				break;
+
+			case B_EXACT_ADDRESS:
+				useLargePages = (addr_t)addressRestrictions.address
+					% largePageSize == 0;
+				break;
+		}
+	}
+
 	status = map_backing_store(locker.AddressSpace(), cache, 0, name, size,
 		B_FULL_LOCK, protection, REGION_NO_PRIVATE_MAP, 0, &addressRestrictions,
 		true, &area, _address);
@@ -1653,6 +1773,9 @@ vm_map_physical_memory(team_id team, const char* name, void** _address,
 				protection, area->MemoryType(), &reservation);
 		}
 
+		if (useLargePages)
+			map->CollapseLargePages(area->Base(), area->Base() + (size - 1));
+
 		map->Unlock();
 
 		vm_page_unreserve_pages(&reservation);
@@ -4161,6 +4284,25 @@ vm_init_post_thread(kernel_args* args)
 status_t
 vm_init_post_modules(kernel_args* args)
 {
+	void* settings = load_driver_settings("virtual_memory");
+	if (settings != NULL) {
+		const char* value = get_driver_parameter(settings,
+			"fault_around_pages", NULL, NULL);
+		if (value != NULL) {
+			uint32 pageCount = strtoul(value, NULL, 0);
+			pageCount = std::min(std::max(pageCount, (uint32)1),
+				(uint32)MAX_FAULT_AROUND_PAGES);
+
+			// round down to a power of two
+			while ((pageCount & (pageCount - 1)) != 0)
+				pageCount &= pageCount - 1;
+
+			sFaultAroundPages = pageCount;
+		}
+
+		unload_driver_settings(settings);
+	}
+
 	return arch_vm_init_post_modules(args);
 }
 
@@ -4465,6 +4607,11 @@ fault_get_page(PageFaultContext& context)
 
 			cache->Lock();
 
+			if (status == B_OK) {
+				context.addressSpaceLocker.AddressSpace()
+					->IncrementPageInCount();
+			}
+
 			if (status < B_OK) {
 				// on error remove and free the page
 				dprintf("reading page from cache %p returned: %s!\n",
@@ -4543,6 +4690,150 @@ fault_get_page(PageFaultContext& context)
 }
 
 
+/*!	Maps the resident pages around \a address in \a area that live in the
+	same file cache as the page that has just been mapped for a read fault at
+	\a address. Sequential accesses to a freshly mapped file, like executing a
+	shared library, thus don't fault on every single page.
+	Pages that are shadowed by a page in an upper cache are left alone, all
+	others are mapped read-only. The pages are mapped in a single translation
+	map transaction.
+	Must be called with the address space and the cache chain locked as
+	vm_soft_fault() leaves them after mapping the page.
+	Returns the number of pages that have been mapped.
+*/
+static int32
+fault_around(PageFaultContext& context, VMArea* area, addr_t address)
+{
+	struct fault_around_page {
+		vm_page*			page;
+		addr_t				address;
+		uint32				protection;
+		bool				wasMapped;
+		vm_page_mapping*	mapping;
+	};
+
+	VMCache* cache = context.page->Cache();
+
+	addr_t windowSize = (addr_t)sFaultAroundPages * B_PAGE_SIZE;
+	addr_t windowStart = ROUNDDOWN(address, windowSize);
+	addr_t start = std::max(windowStart, area->Base());
+	addr_t end = std::min(windowStart + (windowSize - 1),
+		area->Base() + (area->Size() - 1));
+
+	// collect the resident pages
+	fault_around_page pages[MAX_FAULT_AROUND_PAGES];
+	int32 count = 0;
+
+	for (addr_t pageAddress = start; pageAddress < end;
+			pageAddress += B_PAGE_SIZE) {
+		if (pageAddress == address)
+			continue;
+
+		off_t cacheOffset = pageAddress - area->Base() + area->cache_offset;
+
+		bool shadowed = false;
+		for (VMCache* upperCache = context.topCache; upperCache != cache;
+				upperCache = upperCache->source) {
+			if (upperCache->LookupPage(cacheOffset) != NULL
+				|| upperCache->HasPage(cacheOffset)) {
+				shadowed = true;
+				break;
+			}
+		}
+		if (shadowed)
+			continue;
+
+		vm_page* page = cache->LookupPage(cacheOffset);
+		if (page == NULL || page->busy)
+			continue;
+
+		uint32 protection = get_area_page_protection(area, pageAddress)
+			& ~(B_WRITE_AREA | B_KERNEL_WRITE_AREA);
+		if ((protection & (B_READ_AREA | B_KERNEL_READ_AREA)) == 0)
+			continue;
+
+		fault_around_page& entry = pages[count++];
+		entry.page = page;
+		entry.address = pageAddress;
+		entry.protection = protection;
+		entry.mapping = NULL;
+	}
+
+	// allocate the mapping objects
+	bool isKernelSpace = area->address_space == VMAddressSpace::Kernel();
+	for (int32 i = 0; i < count; i++) {
+		pages[i].mapping = (vm_page_mapping*)object_cache_alloc(
+			gPageMappingsObjectCache,
+			CACHE_DONT_WAIT_FOR_MEMORY
+				| (isKernelSpace ? CACHE_DONT_LOCK_KERNEL_SPACE : 0));
+		if (pages[i].mapping == NULL) {
+			count = i;
+			break;
+		}
+	}
+
+	// map all pages that aren't mapped yet
+	VMTranslationMap* map = context.map;
+	int32 mappedCount = 0;
+
+	map->Lock();
+
+	for (int32 i = 0; i < count; i++) {
+		fault_around_page& entry = pages[i];
+
+		phys_addr_t physicalAddress;
+		uint32 flags;
+		if (map->Query(entry.address, &physicalAddress, &flags) == B_OK
+			&& (flags & PAGE_PRESENT) != 0) {
+			continue;
+		}
+
+		vm_page* page = entry.page;
+		DEBUG_PAGE_ACCESS_START(page);
+
+		map->Map(entry.address, page->physical_page_number * B_PAGE_SIZE,
+			entry.protection, area->MemoryType(), &context.reservation);
+
+		entry.wasMapped = page->IsMapped();
+		if (!entry.wasMapped)
+			atomic_add(&gMappedPagesCount, 1);
+
+		vm_page_mapping* mapping = entry.mapping;
+		mapping->page = page;
+		mapping->area = area;
+		page->mappings.Add(mapping);
+		area->mappings.Add(mapping);
+
+		entry.mapping = NULL;
+		mappedCount++;
+	}
+
+	map->Unlock();
+
+	for (int32 i = 0; i < count; i++) {
+		fault_around_page& entry = pages[i];
+		if (entry.mapping != NULL) {
+			// the page was mapped already
+			object_cache_free(gPageMappingsObjectCache, entry.mapping,
+				CACHE_DONT_WAIT_FOR_MEMORY
+					| (isKernelSpace ? CACHE_DONT_LOCK_KERNEL_SPACE : 0));
+			continue;
+		}
+
+		// see map_page()
+		vm_page* page = entry.page;
+		if (!entry.wasMapped && (page->State() == PAGE_STATE_CACHED
+				|| page->State() == PAGE_STATE_INACTIVE)) {
+			vm_page_set_state(page, PAGE_STATE_ACTIVE);
+		}
+
+		DEBUG_PAGE_ACCESS_END(page);
+	}
+
+	return mappedCount;
+}
+
+
 /*!	Makes sure the address in the given address space is mapped.
 
 	\param addressSpace The address space.
@@ -4569,11 +4860,14 @@ vm_soft_fault(VMAddressSpace* addressSpace, addr_t originalAddress,
 
 	addressSpace->IncrementFaultCount();
 
-	// We may need up to 2 pages plus pages needed for mapping them -- reserving
-	// the pages upfront makes sure we don't have any cache locked, so that the
-	// page daemon/thief can do their job without problems.
-	size_t reservePages = 2 + context.map->MaxPagesNeededToMap(originalAddress,
-		originalAddress);
+	// We may need up to 2 pages plus pages needed for mapping them and the
+	// pages around them -- reserving the pages upfront makes sure we don't have
+	// any cache locked, so that the page daemon/thief can do their job without
+	// problems.
+	addr_t faultAroundSize = (addr_t)sFaultAroundPages * B_PAGE_SIZE;
+	addr_t faultAroundStart = ROUNDDOWN(originalAddress, faultAroundSize);
+	size_t reservePages = 2 + context.map->MaxPagesNeededToMap(faultAroundStart,
+		faultAroundStart + (faultAroundSize - 1));
 	context.addressSpaceLocker.Unlock();
 	vm_page_reserve_pages(&context.reservation, reservePages,
 		addressSpace == VMAddressSpace::Kernel()
@@ -4776,6 +5070,15 @@ vm_soft_fault(VMAddressSpace* addressSpace, addr_t originalAddress,
 			*wirePage = context.page;
 		}
 
+		// map the resident neighbors of file pages as well
+		if (mapPage && !isWrite && wirePage == NULL && sFaultAroundPages > 1
+			&& !context.pageAllocated && area->wiring == B_NO_LOCK
+			&& context.page->Cache()->type == CACHE_TYPE_VNODE) {
+			int32 mappedCount = fault_around(context, area, address);
+			if (mappedCount > 0)
+				addressSpace->AddFaultAroundCount(mappedCount);
+		}
+
 		DEBUG_PAGE_ACCESS_END(context.page);
 
 		break;
@@ -5005,6 +5308,16 @@ fill_area_info(struct VMArea* area, area_info* info, size_t size)
 	info->out_count = 0;
 		// TODO: retrieve real values here!
 
+	VMTranslationMap* map = area->address_space->TranslationMap();
+	if (map->LargePageSize() != 0) {
+		map->Lock();
+		if (map->CountLargePages(area->Base(),
+				area->Base() + (area->Size() - 1)) > 0) {
+			info->protection |= B_LARGE_PAGE_AREA;
+		}
+		map->Unlock();
+	}
+
 	VMCache* cache = vm_area_get_locked_cache(area);
 
 	// Note, this is a simplification; the cache could be larger than this area
@@ -6673,11 +6986,88 @@ _user_sync_memory(void* _address, size_t size, uint32 flags)
 }
 
 
+/*!	Frees the pages in the given range of the current team's address space,
+	as far as they belong to private anonymous memory. Their contents are lost,
+	they will read as zeros when accessed again.
+	Returns \c B_NOT_ALLOWED if any part of the range could not be discarded,
+	so that the caller doesn't count it as given back.
+*/
+static status_t
+discard_address_range(addr_t address, size_t size)
+{
+	status_t result = B_OK;
+
+	while (size > 0) {
+		// read lock the address space
+		AddressSpaceReadLocker locker;
+		status_t error = locker.SetTo(team_get_current_team_id());
+		if (error != B_OK)
+			return error;
+
+		// get the first area
+		VMArea* area = locker.AddressSpace()->LookupArea(address);
+		if (area == NULL)
+			return B_NO_MEMORY;
+
+		addr_t offset = address - area->Base();
+		size_t rangeSize = min_c(area->Size() - offset, size);
+		offset += area->cache_offset;
+
+		// lock the cache
+		AreaCacheLocker cacheLocker(area);
+		if (!cacheLocker)
+			return B_BAD_VALUE;
+		VMCache* cache = area->cache;
+
+		// Only memory that nobody else can see may be discarded. This rules
+		// out shared areas and caches that are the source of another one.
+		// Discarded pages must read back as zeros, so the cache must not have
+		// a source either.
+		if (cache->type == CACHE_TYPE_RAM && area->wiring == B_NO_LOCK
+			&& cache->areas == area && area->cache_next == NULL
+			&& cache->consumers.IsEmpty() && cache->source == NULL) {
+			cache->Discard(offset, rangeSize);
+		} else
+			result = B_NOT_ALLOWED;
+
+		address += rangeSize;
+		size -= rangeSize;
+	}
+
+	return result;
+}
+
+
 status_t
-_user_memory_advice(void* address, size_t size, uint32 advice)
+_user_memory_advice(void* _address, size_t size, uint32 advice)
 {
-	// TODO: Implement!
-	return B_OK;
+	addr_t address = (addr_t)_address;
+	size = PAGE_ALIGN(size);
+
+	// check params
+	if ((address % B_PAGE_SIZE) != 0)
+		return B_BAD_VALUE;
+	if ((addr_t)address + size < (addr_t)address || !IS_USER_ADDRESS(address)
+		|| !IS_USER_ADDRESS((addr_t)address + size)) {
+		// weird error code required by POSIX
+		return ENOMEM;
+	}
+
+	switch (advice) {
+		case POSIX_MADV_NORMAL:
+		case POSIX_MADV_SEQUENTIAL:
+		case POSIX_MADV_RANDOM:
+		case POSIX_MADV_WILLNEED:
+		case POSIX_MADV_DONTNEED:
+			// TODO: Implement!
+			return B_OK;
+
+		case MADV_FREE:
+			return discard_address_range(address, size);
+
+		default:
+			return B_BAD_VALUE;
+	}
 }
 
 
@@ -59,6 +59,8 @@
 #endif
 
 //#define TRACK_PAGE_USAGE_STATS	1
+//#define TRACK_PAGE_LOCK_STATS	1
+	// count how often and how long sFreePageQueuesLock is waited for
 
 #define PAGE_ASSERT(page, condition)	\
 	ASSERT_PRINT((condition), "page: %p", (page))
@@ -104,8 +106,6 @@ int32 gMappedPagesCount;
 
 static VMPageQueue sPageQueues[PAGE_STATE_COUNT];
 
-static VMPageQueue& sFreePageQueue = sPageQueues[PAGE_STATE_FREE];
-static VMPageQueue& sClearPageQueue = sPageQueues[PAGE_STATE_CLEAR];
 static VMPageQueue& sModifiedPageQueue = sPageQueues[PAGE_STATE_MODIFIED];
 static VMPageQueue& sInactivePageQueue = sPageQueues[PAGE_STATE_INACTIVE];
 static VMPageQueue& sActivePageQueue = sPageQueues[PAGE_STATE_ACTIVE];
@@ -133,6 +133,59 @@ static mutex sPageDeficitLock = MUTEX_INITIALIZER("page deficit");
 static rw_lock sFreePageQueuesLock
 	= RW_LOCK_INITIALIZER("free/clear page queues");
 
+// Free and clear pages are kept in separate queues for every NUMA node, as
+// described by the boot loader. Without that information, there is only a
+// single node.
+struct page_node {
+	VMPageQueue	free_queue;
+	VMPageQueue	clear_queue;
+};
+
+struct page_node_range {
+	page_num_t	start;
+	page_num_t	end;
+	uint32		node;
+};
+
+static page_node sPageNodes[MAX_NUMA_NODES];
+static uint32 sPageNodeCount = 1;
+static page_node_range sPageNodeRanges[MAX_NUMA_MEMORY_RANGE];
+static uint32 sPageNodeRangeCount;
+static uint8 sCPUPageNodes[SMP_MAX_CPUS];
+
+// Every CPU caches a few free and clear pages of its node, so that most page
+// allocations and frees don't need to touch sFreePageQueuesLock. The cached
+// pages keep their free or clear state, but are marked busy, so that they
+// can't be picked up by vm_page_allocate_page_run().
+static const int32 kPageCacheSize = 32;
+static const int32 kPageCacheRefill = kPageCacheSize / 2;
+
+struct page_cpu_cache {
+	spinlock	lock;
+	int32		free_count;
+	int32		clear_count;
+	vm_page*	free_pages[kPageCacheSize];
+	vm_page*	clear_pages[kPageCacheSize];
+
+	// statistics
+	int64		hits;
+	int64		misses;
+	int64		local_allocations;
+	int64		remote_allocations;
+#ifdef TRACK_PAGE_LOCK_STATS
+	int64		read_locks;
+	int64		write_locks;
+	int64		contended_locks;
+	int64		lock_wait_time;
+#endif
+} CACHE_LINE_ALIGN;
+
+static page_cpu_cache sPageCPUCaches[SMP_MAX_CPUS];
+static bool sPageCPUCachesEnabled;
+static bool sPageCPUCachesBlocked;
+	// set while the free page queues are write-locked, and no pages may be
+	// freed into the CPU page caches
+
 #ifdef TRACK_PAGE_USAGE_STATS
 static page_num_t sPageUsageArrays[512];
 static page_num_t* sPageUsage = sPageUsageArrays;
@@ -772,8 +825,6 @@ find_page(int argc, char **argv)
 		const char*	name;
 		VMPageQueue*	queue;
 	} pageQueueInfos[] = {
-		{ "free",		&sFreePageQueue },
-		{ "clear",		&sClearPageQueue },
 		{ "modified",	&sModifiedPageQueue },
 		{ "active",		&sActivePageQueue },
 		{ "inactive",	&sInactivePageQueue },
@@ -803,6 +854,40 @@ find_page(int argc, char **argv)
 		}
 	}
 
+	for (uint32 node = 0; node < sPageNodeCount; node++) {
+		VMPageQueue* queues[] = {
+			&sPageNodes[node].free_queue, &sPageNodes[node].clear_queue };
+		for (i = 0; i < 2; i++) {
+			VMPageQueue::Iterator it = queues[i]->GetIterator();
+			while (vm_page* p = it.Next()) {
+				if (p == page) {
+					kprintf("found page %p in queue %p (%s, node %" B_PRIu32
+						")\n", page, queues[i], i == 0 ? "free" : "clear",
+						node);
+					return 0;
+				}
+			}
+		}
+	}
+
+	for (int32 cpu = 0; cpu < smp_get_num_cpus(); cpu++) {
+		page_cpu_cache& cache = sPageCPUCaches[cpu];
+		for (int32 j = 0; j < cache.free_count; j++) {
+			if (cache.free_pages[j] == page) {
+				kprintf("found page %p in page cache of CPU %" B_PRId32 "\n",
+					page, cpu);
+				return 0;
+			}
+		}
+		for (int32 j = 0; j < cache.clear_count; j++) {
+			if (cache.clear_pages[j] == page) {
+				kprintf("found page %p in page cache of CPU %" B_PRId32 "\n",
+					page, cpu);
+				return 0;
+			}
+		}
+	}
+
 	kprintf("page %p isn't in any queue\n", page);
 
 	return 0;
@@ -972,16 +1057,26 @@ dump_page_queue(int argc, char **argv)
 
 	if (argc < 2) {
 		kprintf("usage: page_queue <address/name> [list]\n");
+		kprintf("The free and clear queues of node <n> are named "
+			"free<n> and clear<n>.\n");
 		return 0;
 	}
 
 	if (strlen(argv[1]) >= 2 && argv[1][0] == '0' && argv[1][1] == 'x')
 		queue = (VMPageQueue*)strtoul(argv[1], NULL, 16);
-	else if (!strcmp(argv[1], "free"))
-		queue = &sFreePageQueue;
-	else if (!strcmp(argv[1], "clear"))
-		queue = &sClearPageQueue;
-	else if (!strcmp(argv[1], "modified"))
+	else if (!strncmp(argv[1], "free", 4) || !strncmp(argv[1], "clear", 5)) {
+		// the queues of the other nodes are selected by appending the node
+		bool clear = argv[1][0] == 'c';
+		const char* nodeString = argv[1] + (clear ? 5 : 4);
+		uint32 node = *nodeString != '\0' ? strtoul(nodeString, NULL, 0) : 0;
+		if (node >= sPageNodeCount) {
+			kprintf("page_queue: there is no node %" B_PRIu32 ".\n", node);
+			return 0;
+		}
+
+		queue = clear ? &sPageNodes[node].clear_queue
+			: &sPageNodes[node].free_queue;
+	} else if (!strcmp(argv[1], "modified"))
 		queue = &sModifiedPageQueue;
 	else if (!strcmp(argv[1], "active"))
 		queue = &sActivePageQueue;
@@ -1113,10 +1208,15 @@ dump_page_stats(int argc, char **argv)
 			waiter->missing, waiter->dontTouch);
 	}
 
-	kprintf("\nfree queue: %p, count = %" B_PRIuPHYSADDR "\n", &sFreePageQueue,
-		sFreePageQueue.Count());
-	kprintf("clear queue: %p, count = %" B_PRIuPHYSADDR "\n", &sClearPageQueue,
-		sClearPageQueue.Count());
+	kprintf("\n");
+	for (uint32 i = 0; i < sPageNodeCount; i++) {
+		kprintf("node %" B_PRIu32 " free queue: %p, count = %" B_PRIuPHYSADDR
+			"\n", i, &sPageNodes[i].free_queue,
+			sPageNodes[i].free_queue.Count());
+		kprintf("node %" B_PRIu32 " clear queue: %p, count = %" B_PRIuPHYSADDR
+			"\n", i, &sPageNodes[i].clear_queue,
+			sPageNodes[i].clear_queue.Count());
+	}
 	kprintf("modified queue: %p, count = %" B_PRIuPHYSADDR " (%" B_PRId32
 		" temporary, %" B_PRIuPHYSADDR " swappable, " "inactive: %"
 		B_PRIuPHYSADDR ")\n", &sModifiedPageQueue, sModifiedPageQueue.Count(),
@@ -1127,6 +1227,43 @@ dump_page_stats(int argc, char **argv)
 		&sInactivePageQueue, sInactivePageQueue.Count());
 	kprintf("cached queue: %p, count = %" B_PRIuPHYSADDR "\n",
 		&sCachedPageQueue, sCachedPageQueue.Count());
+
+	int64 cachedPages = 0;
+	int64 hits = 0;
+	int64 misses = 0;
+	int64 localAllocations = 0;
+	int64 remoteAllocations = 0;
+	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
+		page_cpu_cache& cache = sPageCPUCaches[i];
+		cachedPages += cache.free_count + cache.clear_count;
+		hits += cache.hits;
+		misses += cache.misses;
+		localAllocations += cache.local_allocations;
+		remoteAllocations += cache.remote_allocations;
+	}
+
+	kprintf("\nCPU page caches: %" B_PRId64 " pages, %" B_PRId64 " hits, %"
+		B_PRId64 " misses\n", cachedPages, hits, misses);
+	kprintf("queue allocations: %" B_PRId64 " local node, %" B_PRId64
+		" remote node\n", localAllocations, remoteAllocations);
+
+#ifdef TRACK_PAGE_LOCK_STATS
+	int64 readLocks = 0;
+	int64 writeLocks = 0;
+	int64 contendedLocks = 0;
+	bigtime_t lockWaitTime = 0;
+	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
+		page_cpu_cache& cache = sPageCPUCaches[i];
+		readLocks += cache.read_locks;
+		writeLocks += cache.write_locks;
+		contendedLocks += cache.contended_locks;
+		lockWaitTime += cache.lock_wait_time;
+	}
+
+	kprintf("free queues lock: %" B_PRId64 " read, %" B_PRId64 " write, %"
+		B_PRId64 " contended, %" B_PRId64 " us waited\n", readLocks,
+		writeLocks, contendedLocks, lockWaitTime);
+#endif
 	return 0;
 }
 
@@ -1461,6 +1598,239 @@ unreserve_pages(uint32 count)
 }
 
 
+static inline page_node&
+page_node_for_page(vm_page* page)
+{
+	if (sPageNodeCount > 1) {
+		page_num_t pageNumber = page->physical_page_number;
+		for (uint32 i = 0; i < sPageNodeRangeCount; i++) {
+			if (pageNumber >= sPageNodeRanges[i].start
+				&& pageNumber < sPageNodeRanges[i].end) {
+				return sPageNodes[sPageNodeRanges[i].node];
+			}
+		}
+	}
+
+	return sPageNodes[0];
+}
+
+
+/*!	Returns the free or clear queue a page in the respective state belongs to.
+*/
+static inline VMPageQueue&
+free_page_queue_for_page(vm_page* page)
+{
+	page_node& node = page_node_for_page(page);
+	return page->State() == PAGE_STATE_CLEAR ? node.clear_queue
+		: node.free_queue;
+}
+
+
+static inline int32
+current_page_cpu()
+{
+	// Before threads are up, we can't ask for the current CPU, but we are
+	// also still running on the boot CPU only.
+	return sPageCPUCachesEnabled ? smp_get_current_cpu() : 0;
+}
+
+
+static void
+read_lock_free_page_queues()
+{
+#ifdef TRACK_PAGE_LOCK_STATS
+	page_cpu_cache& cache = sPageCPUCaches[current_page_cpu()];
+	atomic_add64(&cache.read_locks, 1);
+
+	bigtime_t startTime = system_time();
+	rw_lock_read_lock(&sFreePageQueuesLock);
+	bigtime_t waitTime = system_time() - startTime;
+
+	if (waitTime > 0) {
+		atomic_add64(&cache.contended_locks, 1);
+		atomic_add64(&cache.lock_wait_time, waitTime);
+	}
+#else
+	rw_lock_read_lock(&sFreePageQueuesLock);
+#endif
+}
+
+
+static void
+write_lock_free_page_queues()
+{
+#ifdef TRACK_PAGE_LOCK_STATS
+	page_cpu_cache& cache = sPageCPUCaches[current_page_cpu()];
+	atomic_add64(&cache.write_locks, 1);
+
+	bigtime_t startTime = system_time();
+	rw_lock_write_lock(&sFreePageQueuesLock);
+	bigtime_t waitTime = system_time() - startTime;
+
+	if (waitTime > 0) {
+		atomic_add64(&cache.contended_locks, 1);
+		atomic_add64(&cache.lock_wait_time, waitTime);
+	}
+#else
+	rw_lock_write_lock(&sFreePageQueuesLock);
+#endif
+}
+
+
+/*!	Takes a page from the current CPU's page cache, preferring a clear page if
+	\a clear is \c true, and a free one otherwise. The page remains busy.
+*/
+static vm_page*
+allocate_cached_page(bool clear)
+{
+	if (!sPageCPUCachesEnabled)
+		return NULL;
+
+	InterruptsLocker interruptsLocker;
+	page_cpu_cache& cache = sPageCPUCaches[smp_get_current_cpu()];
+	SpinLocker locker(cache.lock);
+
+	vm_page* page = NULL;
+	if (clear && cache.clear_count > 0)
+		page = cache.clear_pages[--cache.clear_count];
+	else if (cache.free_count > 0)
+		page = cache.free_pages[--cache.free_count];
+	else if (cache.clear_count > 0)
+		page = cache.clear_pages[--cache.clear_count];
+
+	if (page == NULL) {
+		cache.misses++;
+		return NULL;
+	}
+
+	cache.hits++;
+	return page;
+}
+
+
+/*!	Puts a page that is to be freed into the current CPU's page cache, if it
+	belongs to the CPU's node and there is room for it.
+	The page's new state will be \c PAGE_STATE_CLEAR, if \a clear is \c true,
+	\c PAGE_STATE_FREE otherwise.
+*/
+static bool
+free_page_to_cache(vm_page* page, bool clear)
+{
+	if (!sPageCPUCachesEnabled)
+		return false;
+
+	InterruptsLocker interruptsLocker;
+	int32 cpu = smp_get_current_cpu();
+	if (&page_node_for_page(page) != &sPageNodes[sCPUPageNodes[cpu]])
+		return false;
+
+	page_cpu_cache& cache = sPageCPUCaches[cpu];
+	SpinLocker locker(cache.lock);
+
+	int32& count = clear ? cache.clear_count : cache.free_count;
+	if (count == kPageCacheSize || sPageCPUCachesBlocked)
+		return false;
+
+	page->SetState(clear ? PAGE_STATE_CLEAR : PAGE_STATE_FREE);
+	page->busy = true;
+	DEBUG_PAGE_ACCESS_END(page);
+
+	(clear ? cache.clear_pages : cache.free_pages)[count++] = page;
+	return true;
+}
+
+
+/*!	Refills the current CPU's page cache from the free or clear queue of its
+	node. The free page queues must be read-locked.
+*/
+static void
+refill_page_cache(bool clear)
+{
+	if (!sPageCPUCachesEnabled)
+		return;
+
+	InterruptsLocker interruptsLocker;
+	int32 cpu = smp_get_current_cpu();
+	page_cpu_cache& cache = sPageCPUCaches[cpu];
+	SpinLocker locker(cache.lock);
+
+	page_node& node = sPageNodes[sCPUPageNodes[cpu]];
+	VMPageQueue& queue = clear ? node.clear_queue : node.free_queue;
+	int32& count = clear ? cache.clear_count : cache.free_count;
+	vm_page** pages = clear ? cache.clear_pages : cache.free_pages;
+
+	while (count < kPageCacheRefill) {
+		vm_page* page = queue.RemoveHeadUnlocked();
+		if (page == NULL)
+			break;
+
+		page->busy = true;
+		pages[count++] = page;
+	}
+}
+
+
+/*!	Returns all pages in the CPU page caches to the free and clear queues.
+	The free page queues must be write-locked. Unless sPageCPUCachesBlocked
+	is set, the CPUs can still free pages into their caches, so that the
+	caches might not stay empty.
+*/
+static void
+drain_page_caches()
+{
+	if (!sPageCPUCachesEnabled)
+		return;
+
+	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
+		page_cpu_cache& cache = sPageCPUCaches[i];
+		InterruptsSpinLocker locker(cache.lock);
+
+		while (cache.free_count > 0) {
+			vm_page* page = cache.free_pages[--cache.free_count];
+			page->busy = false;
+			page_node_for_page(page).free_queue.PrependUnlocked(page);
+		}
+
+		while (cache.clear_count > 0) {
+			vm_page* page = cache.clear_pages[--cache.clear_count];
+			page->busy = false;
+			page_node_for_page(page).clear_queue.PrependUnlocked(page);
+		}
+	}
+}
+
+
+/*!	Removes a page from the free or clear queues, preferring the node of the
+	current CPU, and the clear queue if \a clear is \c true. The free page
+	queues must be read-locked.
+*/
+static vm_page*
+remove_free_page(bool clear)
+{
+	int32 cpu = current_page_cpu();
+	uint32 localNode = sCPUPageNodes[cpu];
+
+	for (uint32 i = 0; i < sPageNodeCount; i++) {
+		page_node& node = sPageNodes[(localNode + i) % sPageNodeCount];
+
+		vm_page* page = (clear ? node.clear_queue : node.free_queue)
+			.RemoveHeadUnlocked();
+		if (page == NULL) {
+			page = (clear ? node.free_queue : node.clear_queue)
+				.RemoveHeadUnlocked();
+		}
+
+		if (page != NULL) {
+			atomic_add64(i == 0 ? &sPageCPUCaches[cpu].local_allocations
+				: &sPageCPUCaches[cpu].remote_allocations, 1);
+			return page;
+		}
+	}
+
+	return NULL;
+}
+
+
 static void
 free_page(vm_page* page, bool clear)
 {
@@ -1511,17 +1881,17 @@ free_page(vm_page* page, bool clear)
 	page->allocation_tracking_info.Clear();
 #endif
 
-	ReadLocker locker(sFreePageQueuesLock);
+	if (free_page_to_cache(page, clear))
+		return;
+
+	read_lock_free_page_queues();
+	ReadLocker locker(sFreePageQueuesLock, true);
 
 	DEBUG_PAGE_ACCESS_END(page);
 
-	if (clear) {
-		page->SetState(PAGE_STATE_CLEAR);
-		sClearPageQueue.PrependUnlocked(page);
-	} else {
-		page->SetState(PAGE_STATE_FREE);
-		sFreePageQueue.PrependUnlocked(page);
-	}
+	page->SetState(clear ? PAGE_STATE_CLEAR : PAGE_STATE_FREE);
+	page->busy = false;
+	free_page_queue_for_page(page).PrependUnlocked(page);
 
 	locker.Unlock();
 }
@@ -1660,6 +2030,10 @@ clear_page(struct vm_page *page)
 }
 
 
+/*!	Takes the free pages of the given range out of the free and clear queues.
+	Returns \c B_BUSY if any of the pages is in use already, but still marks
+	all others.
+*/
 static status_t
 mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 {
@@ -1685,7 +2059,15 @@ mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 		length = sNumPages - startPage;
 	}
 
-	WriteLocker locker(sFreePageQueuesLock);
+	write_lock_free_page_queues();
+	WriteLocker locker(sFreePageQueuesLock, true);
+
+	// Once the caches are drained, no free page can be busy anymore; the
+	// CPUs must not put any pages back into them until we're done.
+	sPageCPUCachesBlocked = true;
+	drain_page_caches();
+
+	status_t status = B_OK;
 
 	for (page_num_t i = 0; i < length; i++) {
 		vm_page *page = &sPages[startPage + i];
@@ -1696,10 +2078,10 @@ mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 // TODO: This violates the page reservation policy, since we remove pages from
 // the free/clear queues without having reserved them before. This should happen
 // in the early boot process only, though.
+				PAGE_ASSERT(page, !page->busy);
+
 				DEBUG_PAGE_ACCESS_START(page);
-				VMPageQueue& queue = page->State() == PAGE_STATE_FREE
-					? sFreePageQueue : sClearPageQueue;
-				queue.Remove(page);
+				free_page_queue_for_page(page).Remove(page);
 				page->SetState(wired ? PAGE_STATE_WIRED : PAGE_STATE_UNUSED);
 				page->busy = false;
 				atomic_add(&sUnreservedFreePages, -1);
@@ -1717,11 +2099,13 @@ mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 				// uh
 				dprintf("mark_page_range_in_use: page %#" B_PRIxPHYSADDR
 					" in non-free state %d!\n", startPage + i, page->State());
+				status = B_BUSY;
 				break;
 		}
 	}
 
-	return B_OK;
+	sPageCPUCachesBlocked = false;
+	return status;
 }
 
 
@@ -1741,7 +2125,11 @@ page_scrubber(void *unused)
 	for (;;) {
 		snooze(100000); // 100ms
 
-		if (sFreePageQueue.Count() == 0
+		page_num_t freeCount = 0;
+		for (uint32 i = 0; i < sPageNodeCount; i++)
+			freeCount += sPageNodes[i].free_queue.Count();
+
+		if (freeCount == 0
 				|| atomic_get(&sUnreservedFreePages)
 					< (int32)sFreePagesTarget) {
 			continue;
@@ -1757,21 +2145,25 @@ page_scrubber(void *unused)
 		if (reserved == 0)
 			continue;
 
-		// get some pages from the free queue
-		ReadLocker locker(sFreePageQueuesLock);
+		// get some pages from the free queues
+		read_lock_free_page_queues();
+		ReadLocker locker(sFreePageQueuesLock, true);
 
 		vm_page *page[SCRUB_SIZE];
 		int32 scrubCount = 0;
-		for (int32 i = 0; i < reserved; i++) {
-			page[i] = sFreePageQueue.RemoveHeadUnlocked();
-			if (page[i] == NULL)
-				break;
-
-			DEBUG_PAGE_ACCESS_START(page[i]);
-
-			page[i]->SetState(PAGE_STATE_ACTIVE);
-			page[i]->busy = true;
-			scrubCount++;
+		for (uint32 node = 0; node < sPageNodeCount; node++) {
+			VMPageQueue& queue = sPageNodes[node].free_queue;
+			while (scrubCount < reserved) {
+				vm_page* freePage = queue.RemoveHeadUnlocked();
+				if (freePage == NULL)
+					break;
+
+				DEBUG_PAGE_ACCESS_START(freePage);
+
+				freePage->SetState(PAGE_STATE_ACTIVE);
+				freePage->busy = true;
+				page[scrubCount++] = freePage;
+			}
 		}
 
 		locker.Unlock();
@@ -1794,7 +2186,7 @@ page_scrubber(void *unused)
 			page[i]->SetState(PAGE_STATE_CLEAR);
 			page[i]->busy = false;
 			DEBUG_PAGE_ACCESS_END(page[i]);
-			sClearPageQueue.PrependUnlocked(page[i]);
+			page_node_for_page(page[i]).clear_queue.PrependUnlocked(page[i]);
 		}
 
 		locker.Unlock();
@@ -2570,10 +2962,11 @@ free_cached_pages(uint32 pagesToFree, bool dontWait)
 			break;
 
 		if (free_cached_page(page, dontWait)) {
-			ReadLocker locker(sFreePageQueuesLock);
+			read_lock_free_page_queues();
+			ReadLocker locker(sFreePageQueuesLock, true);
 			page->SetState(PAGE_STATE_FREE);
 			DEBUG_PAGE_ACCESS_END(page);
-			sFreePageQueue.PrependUnlocked(page);
+			page_node_for_page(page).free_queue.PrependUnlocked(page);
 			locker.Unlock();
 
 			TA(StolenPage());
@@ -3261,8 +3654,37 @@ vm_page_init(kernel_args *args)
 	sInactivePageQueue.Init("inactive pages queue");
 	sActivePageQueue.Init("active pages queue");
 	sCachedPageQueue.Init("cached pages queue");
-	sFreePageQueue.Init("free pages queue");
-	sClearPageQueue.Init("clear pages queue");
+
+	// init the NUMA nodes' free/clear page queues
+	if (args->num_numa_nodes > 1 && args->num_numa_nodes <= MAX_NUMA_NODES) {
+		sPageNodeCount = args->num_numa_nodes;
+
+		for (uint32 i = 0; i < args->num_numa_memory_ranges; i++) {
+			if (args->numa_memory_range_node[i] >= sPageNodeCount)
+				continue;
+
+			page_node_range& range = sPageNodeRanges[sPageNodeRangeCount++];
+			range.start = args->numa_memory_range[i].start / B_PAGE_SIZE;
+			range.end = (args->numa_memory_range[i].start
+				+ args->numa_memory_range[i].size) / B_PAGE_SIZE;
+			range.node = args->numa_memory_range_node[i];
+		}
+
+		for (uint32 i = 0; i < args->num_cpus; i++) {
+			if (args->cpu_numa_node[i] < sPageNodeCount)
+				sCPUPageNodes[i] = args->cpu_numa_node[i];
+		}
+
+		dprintf("vm_page_init: %" B_PRIu32 " NUMA nodes\n", sPageNodeCount);
+	}
+
+	for (uint32 i = 0; i < sPageNodeCount; i++) {
+		sPageNodes[i].free_queue.Init("free pages queue");
+		sPageNodes[i].clear_queue.Init("clear pages queue");
+	}
+
+	for (int32 i = 0; i < SMP_MAX_CPUS; i++)
+		B_INITIALIZE_SPINLOCK(&sPageCPUCaches[i].lock);
 
 	new (&sPageReservationWaiters) PageReservationWaiterList;
 
@@ -3277,7 +3699,7 @@ vm_page_init(kernel_args *args)
 	// initialize the free page table
 	for (uint32 i = 0; i < sNumPages; i++) {
 		sPages[i].Init(sPhysicalPageOffset + i);
-		sFreePageQueue.Append(&sPages[i]);
+		page_node_for_page(&sPages[i]).free_queue.Append(&sPages[i]);
 
 #if VM_PAGE_ALLOCATION_TRACKING_AVAILABLE
 		sPages[i].allocation_tracking_info.Clear();
@@ -3401,7 +3823,10 @@ status_t
 vm_page_init_post_thread(kernel_args *args)
 {
 	new (&sFreePageCondition) ConditionVariable;
-	sFreePageCondition.Publish(&sFreePageQueue, "free page");
+	sFreePageCondition.Publish(&sPageNodes, "free page");
+
+	// from now on, we can use the CPU page caches
+	sPageCPUCachesEnabled = true;
 
 	// create a kernel thread to clear out pages
 
@@ -3513,44 +3938,39 @@ vm_page_allocate_page(vm_page_reservation* reservation, uint32 flags)
 	ASSERT(reservation->count > 0);
 	reservation->count--;
 
-	VMPageQueue* queue;
-	VMPageQueue* otherQueue;
-
-	if ((flags & VM_PAGE_ALLOC_CLEAR) != 0) {
-		queue = &sClearPageQueue;
-		otherQueue = &sFreePageQueue;
-	} else {
-		queue = &sFreePageQueue;
-		otherQueue = &sClearPageQueue;
-	}
+	bool clear = (flags & VM_PAGE_ALLOC_CLEAR) != 0;
 
-	ReadLocker locker(sFreePageQueuesLock);
+	ReadLocker locker;
 
-	vm_page* page = queue->RemoveHeadUnlocked();
+	vm_page* page = allocate_cached_page(clear);
 	if (page == NULL) {
-		// if the primary queue was empty, grab the page from the
-		// secondary queue
-		page = otherQueue->RemoveHeadUnlocked();
+		read_lock_free_page_queues();
+		locker.SetTo(sFreePageQueuesLock, true);
 
+		page = remove_free_page(clear);
 		if (page == NULL) {
 			// Unlikely, but possible: the page we have reserved has moved
-			// between the queues after we checked the first queue. Grab the
-			// write locker to make sure this doesn't happen again.
+			// between the queues after we checked them, or it sits in the
+			// page cache of another CPU. Grab the write locker to make sure
+			// this doesn't happen again.
 			locker.Unlock();
-			WriteLocker writeLocker(sFreePageQueuesLock);
+			write_lock_free_page_queues();
+			WriteLocker writeLocker(sFreePageQueuesLock, true);
 
-			page = queue->RemoveHead();
-			if (page == NULL)
-				otherQueue->RemoveHead();
+			drain_page_caches();
 
+			page = remove_free_page(clear);
 			if (page == NULL) {
 				panic("Had reserved page, but there is none!");
 				return NULL;
 			}
 
 			// downgrade to read lock
+			writeLocker.Unlock();
 			locker.Lock();
 		}
+
+		refill_page_cache(clear);
 	}
 
 	if (page->CacheRef() != NULL)
@@ -3594,14 +4014,14 @@ allocate_page_run_cleanup(VMPageQueue::PageList& freePages,
 		page->busy = false;
 		page->SetState(PAGE_STATE_FREE);
 		DEBUG_PAGE_ACCESS_END(page);
-		sFreePageQueue.PrependUnlocked(page);
+		page_node_for_page(page).free_queue.PrependUnlocked(page);
 	}
 
 	while (vm_page* page = clearPages.RemoveHead()) {
 		page->busy = false;
 		page->SetState(PAGE_STATE_CLEAR);
 		DEBUG_PAGE_ACCESS_END(page);
-		sClearPageQueue.PrependUnlocked(page);
+		page_node_for_page(page).clear_queue.PrependUnlocked(page);
 	}
 }
 
@@ -3647,13 +4067,22 @@ allocate_page_run(page_num_t start, page_num_t length, uint32 flags,
 		vm_page& page = sPages[start + i];
 		switch (page.State()) {
 			case PAGE_STATE_CLEAR:
+				if (page.busy) {
+					// has just been put into a CPU page cache
+					noPage = true;
+					break;
+				}
 				DEBUG_PAGE_ACCESS_START(&page);
-				sClearPageQueue.Remove(&page);
+				page_node_for_page(&page).clear_queue.Remove(&page);
 				clearPages.Add(&page);
 				break;
 			case PAGE_STATE_FREE:
+				if (page.busy) {
+					noPage = true;
+					break;
+				}
 				DEBUG_PAGE_ACCESS_START(&page);
-				sFreePageQueue.Remove(&page);
+				page_node_for_page(&page).free_queue.Remove(&page);
 				freePages.Add(&page);
 				break;
 			case PAGE_STATE_CACHED:
@@ -3833,7 +4262,11 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 	vm_page_reservation reservation;
 	vm_page_reserve_pages(&reservation, length, priority);
 
-	WriteLocker freeClearQueueLocker(sFreePageQueuesLock);
+	write_lock_free_page_queues();
+	WriteLocker freeClearQueueLocker(sFreePageQueuesLock, true);
+
+	// The pages in the CPU page caches are not available for page runs.
+	drain_page_caches();
 
 	// First we try to get a run with free pages only. If that fails, we also
 	// consider cached pages. If there are only few free pages and many cached
@@ -3883,9 +4316,12 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 		page_num_t i;
 		for (i = 0; i < length; i++) {
 			uint32 pageState = sPages[start + i].State();
-			if (pageState != PAGE_STATE_FREE
-				&& pageState != PAGE_STATE_CLEAR
-				&& (pageState != PAGE_STATE_CACHED || useCached == 0)) {
+			if (((pageState == PAGE_STATE_FREE
+						|| pageState == PAGE_STATE_CLEAR)
+					&& sPages[start + i].busy)
+				|| (pageState != PAGE_STATE_FREE
+					&& pageState != PAGE_STATE_CLEAR
+					&& (pageState != PAGE_STATE_CACHED || useCached == 0))) {
 				foundRun = false;
 				break;
 			}
@@ -4094,8 +4530,14 @@ vm_page_get_stats(system_info *info)
 	//	active + inactive + unused + wired + modified + cached + free + clear
 	// So taking out the cached (including modified non-temporary), free and
 	// clear ones leaves us with all used pages.
-	uint32 subtractPages = info->cached_pages + sFreePageQueue.Count()
-		+ sClearPageQueue.Count();
+	uint32 subtractPages = info->cached_pages;
+	for (uint32 i = 0; i < sPageNodeCount; i++) {
+		subtractPages += sPageNodes[i].free_queue.Count()
+			+ sPageNodes[i].clear_queue.Count();
+	}
+	for (int32 i = 0; i < smp_get_num_cpus(); i++)
+		subtractPages += sPageCPUCaches[i].free_count
+			+ sPageCPUCaches[i].clear_count;
 	info->used_pages = subtractPages > info->max_pages
 		? 0 : info->max_pages - subtractPages;
 
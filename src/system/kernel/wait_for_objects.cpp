@@ -398,6 +398,7 @@ create_select_sync(int numFDs, select_sync*& _sync)
 
 	sync->count = numFDs;
 	sync->ref_count = 1;
+	sync->ops = NULL;
 
 	for (int i = 0; i < numFDs; i++) {
 		sync->set[i].next = NULL;
@@ -418,6 +419,11 @@ put_select_sync(select_sync* sync)
 	FUNCTION(("put_select_sync(%p): -> %ld\n", sync, sync->ref_count - 1));
 
 	if (atomic_add(&sync->ref_count, -1) == 1) {
+		if (sync->ops != NULL) {
+			sync->ops->free(sync);
+			return;
+		}
+
 		delete_sem(sync->sem);
 		delete[] sync->set;
 		delete sync;
@@ -696,9 +702,16 @@ notify_select_events(select_info* info, uint16 events)
 	FUNCTION(("notify_select_events(%p (%p), 0x%x)\n", info, info->sync,
 		events));
 
-	if (info == NULL
-		|| info->sync == NULL
-		|| info->sync->sem < B_OK)
+	if (info == NULL || info->sync == NULL)
+		return B_BAD_VALUE;
+
+	if (info->sync->ops != NULL) {
+		atomic_or(&info->events, events);
+		info->sync->ops->notify(info->sync, info, events);
+		return B_OK;
+	}
+
+	if (info->sync->sem < B_OK)
 		return B_BAD_VALUE;
 
 	atomic_or(&info->events, events);
@@ -717,12 +730,36 @@ notify_select_events_list(select_info* list, uint16 events)
 {
 	struct select_info* info = list;
 	while (info != NULL) {
+		select_info* next = info->next;
 		notify_select_events(info, events);
-		info = info->next;
+		info = next;
 	}
 }
 
 
+/*!	Selects the events specified in \a info on the object of the given
+	type (one of the \c B_OBJECT_TYPE_* constants).
+*/
+status_t
+select_object(uint32 type, int32 object, select_info* info, bool kernel)
+{
+	if (type >= kSelectOpsCount)
+		return B_BAD_VALUE;
+
+	return kSelectOps[type].select(object, info, kernel);
+}
+
+
+status_t
+deselect_object(uint32 type, int32 object, select_info* info, bool kernel)
+{
+	if (type >= kSelectOpsCount)
+		return B_BAD_VALUE;
+
+	return kSelectOps[type].deselect(object, info, kernel);
+}
+
+
 //	#pragma mark - public kernel API
 
 
@@ -78,6 +78,14 @@ __get_scheduler_mode(void)
 }
 
 
+status_t
+set_thread_deadline(thread_id thread, bigtime_t runtime, bigtime_t deadline,
+	bigtime_t period)
+{
+	return _kern_set_thread_deadline(thread, runtime, deadline, period);
+}
+
+
 B_DEFINE_WEAK_ALIAS(__set_scheduler_mode, set_scheduler_mode);
 B_DEFINE_WEAK_ALIAS(__get_scheduler_mode, get_scheduler_mode);
 
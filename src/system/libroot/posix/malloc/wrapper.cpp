@@ -27,6 +27,7 @@
 #include <image.h>
 
 #include <errno.h>
+#include <malloc.h>
 #include <string.h>
 
 #include <errno_private.h>
@@ -285,6 +286,13 @@ __heap_after_fork_parent(void)
 }
 
 
+extern "C" void
+__heap_thread_exit(void)
+{
+	// nothing to do
+}
+
+
 //	#pragma mark - public functions
 
 
@@ -528,6 +536,40 @@ malloc_usable_size(void *ptr)
 }
 
 
+extern "C" int
+malloc_trim(size_t pad)
+{
+	// Hoard never gives memory back
+	return 0;
+}
+
+
+extern "C" int
+malloc_get_statistics(struct malloc_statistics *statistics)
+{
+	if (statistics == NULL)
+		return B_BAD_VALUE;
+
+	processHeap *heap = getAllocator();
+
+	size_t allocated = 0;
+	size_t used = 0;
+	for (int i = 0; i < hoardHeap::SIZE_CLASSES; i++) {
+		int classUsed, classAllocated;
+		heap->getStats(i, classUsed, classAllocated);
+
+		allocated += classAllocated;
+		used += classUsed;
+	}
+
+	memset(statistics, 0, sizeof(*statistics));
+	statistics->heap_size = allocated;
+	statistics->allocated_size = used;
+	statistics->free_size = allocated - used;
+	return 0;
+}
+
+
 //	#pragma mark - BeOS specific extensions
 
 
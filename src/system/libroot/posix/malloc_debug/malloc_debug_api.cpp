@@ -220,6 +220,12 @@ __heap_after_fork_parent(void)
 }
 
 
+extern "C" void
+__heap_thread_exit(void)
+{
+}
+
+
 // #pragma mark - Public API
 
 
@@ -290,3 +296,18 @@ posix_memalign(void **pointer, size_t alignment, size_t size)
 
 	return 0;
 }
+
+
+extern "C" int
+malloc_trim(size_t pad)
+{
+	return 0;
+}
+
+
+extern "C" int
+malloc_get_statistics(struct malloc_statistics* statistics)
+{
+	// the debug heaps don't keep statistics in this form
+	return B_NOT_SUPPORTED;
+}
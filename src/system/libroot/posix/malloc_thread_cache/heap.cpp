@@ -0,0 +1,871 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	The central part of the thread caching allocator.
+
+	All memory comes from a single address range that is reserved at startup
+	and backed by areas that are grown on demand. It is managed in heap pages
+	of kPageSize bytes. A page map, indexed by page number, points from each
+	page in use to the span it belongs to. Free runs of pages are kept in lists
+	by their size; only their first and last page are entered in the page map,
+	which is enough to coalesce neighbouring runs when a span is freed.
+
+	Small objects are grouped into size classes. Each class keeps a list of
+	spans that still have objects left, and hands out objects in batches to the
+	thread caches. A span that becomes completely unused is returned to the
+	page heap. Once enough free pages have accumulated, they are given back to
+	the system via madvise(MADV_FREE), which keeps the address range, but lets
+	the VM reclaim the memory.
+*/
+
+
+#include "heap.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <libroot_private.h>
+#include <locks.h>
+#include <syscalls.h>
+
+
+namespace BPrivate {
+namespace ThreadCacheHeap {
+
+
+#if B_HAIKU_64_BIT
+static const addr_t kHeapReservationBase = 0x1000000000;
+static const size_t kHeapReservationSize = 0x1000000000;
+#else
+static const addr_t kHeapReservationBase = 0x18000000;
+static const size_t kHeapReservationSize = 0x48000000;
+#endif
+static const size_t kMinHeapReservationSize = 64 * 1024 * 1024;
+
+static const size_t kHeapIncrement = 1024 * 1024;
+	// the steps in which the heap areas grow (must be a multiple of kPageSize)
+
+static const size_t kPageMapLeafShift = 16;
+static const size_t kPageMapLeafPages = 1 << kPageMapLeafShift;
+static const size_t kPageMapLeafRange = kPageMapLeafPages * kPageSize;
+static const size_t kPageMapLeafCount
+	= (kHeapReservationSize + kPageMapLeafRange - 1) / kPageMapLeafRange;
+
+static const size_t kFreeListCount = 128;
+	// runs of up to that many pages have their own free list
+
+static const size_t kMaxUnreleasedPages = 4 * 1024 * 1024 / kPageSize;
+	// free pages kept before they are given back to the system
+
+static const size_t kMetadataChunkSize = 64 * 1024;
+
+static const size_t kMaxSpanPages = 8;
+static const size_t kThreadCacheBatchSize = 16 * 1024;
+static const uint32 kMinBatchCount = 2;
+static const uint32 kMaxBatchCount = 32;
+
+
+size_class gSizeClasses[kSizeClassCount];
+
+static uint8 sSizeClassTable[kMaxSmallSize / kMinAlignment + 1];
+
+static mutex sPageHeapLock = MUTEX_INITIALIZER("heap pages");
+static addr_t sHeapBase;
+static addr_t sHeapEnd;
+	// end of the reserved range
+static addr_t sHeapTop;
+	// end of the pages that have been handed out so far
+static addr_t sAreaEnd;
+	// end of the memory covered by areas
+static area_id sHeapArea;
+	// the last area, the one that is grown
+static addr_t sHeapAreaBase;
+static uint32 sHeapProtection;
+
+static heap_span** sPageMap[kPageMapLeafCount];
+
+static span_list sFreeSpans[kFreeListCount];
+static span_list sLargeFreeSpans;
+static span_list sUnusedSpans;
+	// span structures that are not in use
+static size_t sFreePages;
+static size_t sUnreleasedPages;
+static size_t sReleaseThreshold = kMaxUnreleasedPages;
+static size_t sSmallPages;
+static size_t sLargePages;
+static size_t sLargeCount;
+
+static mutex sMetadataLock = MUTEX_INITIALIZER("heap metadata");
+static addr_t sMetadataNext;
+static addr_t sMetadataEnd;
+
+
+static inline void
+list_add(span_list& list, heap_span* span)
+{
+	span->next = NULL;
+	span->previous = list.last;
+	if (list.last != NULL)
+		list.last->next = span;
+	else
+		list.first = span;
+	list.last = span;
+}
+
+
+static inline void
+list_remove(span_list& list, heap_span* span)
+{
+	if (span->previous != NULL)
+		span->previous->next = span->next;
+	else
+		list.first = span->next;
+	if (span->next != NULL)
+		span->next->previous = span->previous;
+	else
+		list.last = span->previous;
+
+	span->next = NULL;
+	span->previous = NULL;
+}
+
+
+static inline heap_span*
+page_map_lookup(addr_t address)
+{
+	size_t page = (address - sHeapBase) >> kPageShift;
+	heap_span** leaf = sPageMap[page >> kPageMapLeafShift];
+	if (leaf == NULL)
+		return NULL;
+
+	return leaf[page & (kPageMapLeafPages - 1)];
+}
+
+
+static inline void
+page_map_set(addr_t address, heap_span* span)
+{
+	size_t page = (address - sHeapBase) >> kPageShift;
+	sPageMap[page >> kPageMapLeafShift][page & (kPageMapLeafPages - 1)]
+		= span;
+}
+
+
+/*!	Enters \a span for all of its pages into the page map. */
+static void
+page_map_set_span(heap_span* span)
+{
+	for (addr_t address = span->base; address < span->End();
+			address += kPageSize) {
+		page_map_set(address, span);
+	}
+}
+
+
+// #pragma mark - metadata
+
+
+/*!	Allocates memory for the heap's own structures. It is never freed again,
+	the structures are recycled by their users.
+*/
+void*
+heap_allocate_metadata(size_t size)
+{
+	size = (size + kMinAlignment - 1) & ~(kMinAlignment - 1);
+
+	MutexLocker locker(sMetadataLock);
+
+	if (size > sMetadataEnd - sMetadataNext) {
+		size_t chunkSize = kMetadataChunkSize;
+		if (size > kMetadataChunkSize)
+			chunkSize = (size + B_PAGE_SIZE - 1) & ~(B_PAGE_SIZE - 1);
+
+		void* address;
+		area_id area = create_area("heap metadata", &address,
+			B_RANDOMIZED_ANY_ADDRESS, chunkSize, B_NO_LOCK,
+			B_READ_AREA | B_WRITE_AREA);
+		if (area < 0)
+			return NULL;
+
+		if (chunkSize > kMetadataChunkSize) {
+			// don't waste the rest of the current chunk
+			return address;
+		}
+
+		sMetadataNext = (addr_t)address;
+		sMetadataEnd = sMetadataNext + chunkSize;
+	}
+
+	void* address = (void*)sMetadataNext;
+	sMetadataNext += size;
+	return address;
+}
+
+
+static heap_span*
+allocate_span_structure()
+{
+	heap_span* span = sUnusedSpans.first;
+	if (span != NULL)
+		list_remove(sUnusedSpans, span);
+	else {
+		span = (heap_span*)heap_allocate_metadata(sizeof(heap_span));
+		if (span == NULL)
+			return NULL;
+	}
+
+	memset(span, 0, sizeof(heap_span));
+	return span;
+}
+
+
+static inline void
+free_span_structure(heap_span* span)
+{
+	list_add(sUnusedSpans, span);
+}
+
+
+// #pragma mark - page heap
+
+
+/*!	Makes sure that at least \a size bytes are available above the heap top.
+	The page heap lock must be held.
+*/
+static bool
+grow_heap(size_t size)
+{
+	if (size > sHeapEnd - sHeapTop)
+		return false;
+
+	addr_t newEnd = (sHeapTop + size + kHeapIncrement - 1)
+		& ~(kHeapIncrement - 1);
+	if (newEnd > sHeapEnd)
+		newEnd = sHeapEnd;
+
+	// make sure the page map can cover the new range
+	for (size_t i = (sAreaEnd - sHeapBase) / kPageMapLeafRange;
+			i <= (newEnd - 1 - sHeapBase) / kPageMapLeafRange; i++) {
+		if (sPageMap[i] != NULL)
+			continue;
+
+		sPageMap[i] = (heap_span**)heap_allocate_metadata(
+			kPageMapLeafPages * sizeof(heap_span*));
+		if (sPageMap[i] == NULL)
+			return false;
+	}
+
+	if (resize_area(sHeapArea, newEnd - sHeapAreaBase) == B_OK) {
+		sAreaEnd = newEnd;
+		return true;
+	}
+
+	// The area cannot be resized, maybe because it has been split. Try to put
+	// a new area right after it instead.
+	void* address = (void*)sAreaEnd;
+	area_id area = create_area("heap", &address, B_EXACT_ADDRESS,
+		newEnd - sAreaEnd, B_NO_LOCK, sHeapProtection);
+	if (area < 0)
+		return false;
+
+	sHeapArea = area;
+	sHeapAreaBase = sAreaEnd;
+	sAreaEnd = newEnd;
+	return true;
+}
+
+
+static inline span_list&
+free_list_for(size_t pageCount)
+{
+	if (pageCount > kFreeListCount)
+		return sLargeFreeSpans;
+
+	return sFreeSpans[pageCount - 1];
+}
+
+
+static void
+insert_free_span(heap_span* span)
+{
+	span->state = SPAN_FREE;
+	page_map_set(span->base, span);
+	page_map_set(span->End() - kPageSize, span);
+
+	list_add(free_list_for(span->page_count), span);
+	sFreePages += span->page_count;
+	sUnreleasedPages += span->unreleased_pages;
+}
+
+
+static void
+remove_free_span(heap_span* span)
+{
+	list_remove(free_list_for(span->page_count), span);
+	sFreePages -= span->page_count;
+	sUnreleasedPages -= span->unreleased_pages;
+}
+
+
+/*!	Splits off the pages of \a span beyond the first \a pageCount, and returns
+	them as a new span with the same state.
+	Since it is not known which of the pages of a free span have been released,
+	the unreleased ones are assumed to be in the new span first.
+*/
+static heap_span*
+split_span(heap_span* span, size_t pageCount)
+{
+	heap_span* rest = allocate_span_structure();
+	if (rest == NULL)
+		return NULL;
+
+	rest->base = span->base + pageCount * kPageSize;
+	rest->page_count = span->page_count - pageCount;
+	rest->state = span->state;
+	rest->unreleased_pages = min_c(span->unreleased_pages, rest->page_count);
+
+	span->page_count = pageCount;
+	span->unreleased_pages -= rest->unreleased_pages;
+	return rest;
+}
+
+
+static bool
+release_span(heap_span* span)
+{
+	if (madvise((void*)span->base, span->page_count * kPageSize, MADV_FREE)
+			!= 0) {
+		return false;
+	}
+
+	sUnreleasedPages -= span->unreleased_pages;
+	span->unreleased_pages = 0;
+	return true;
+}
+
+
+/*!	Gives the memory of all free runs back to the system.
+	The kernel refuses to discard memory that is shared with another team,
+	as the heap is after a fork() until either side is gone. In that case
+	the pages stay accounted as unreleased, and the next attempt is put off
+	until twice as many of them have piled up.
+	The page heap lock must be held.
+*/
+static size_t
+release_free_spans()
+{
+	size_t released = 0;
+
+	for (size_t i = 0; i <= kFreeListCount; i++) {
+		span_list& list = i < kFreeListCount ? sFreeSpans[i] : sLargeFreeSpans;
+		for (heap_span* span = list.first; span != NULL; span = span->next) {
+			if (span->unreleased_pages == 0)
+				continue;
+
+			size_t unreleased = span->unreleased_pages;
+			if (!release_span(span)) {
+				sReleaseThreshold = 2 * sUnreleasedPages;
+				return released;
+			}
+			released += unreleased * kPageSize;
+		}
+	}
+
+	sReleaseThreshold = kMaxUnreleasedPages;
+	return released;
+}
+
+
+/*!	Returns a span of \a pageCount pages. Neither its state nor the page map
+	are set up yet.
+	The page heap lock must be held.
+*/
+static heap_span*
+allocate_pages(size_t pageCount)
+{
+	heap_span* span = NULL;
+
+	// look for the smallest free run that fits
+	for (size_t i = pageCount; i <= kFreeListCount; i++) {
+		span = sFreeSpans[i - 1].first;
+		if (span != NULL)
+			break;
+	}
+
+	if (span == NULL) {
+		for (heap_span* candidate = sLargeFreeSpans.first; candidate != NULL;
+				candidate = candidate->next) {
+			if (candidate->page_count >= pageCount
+				&& (span == NULL || candidate->page_count < span->page_count)) {
+				span = candidate;
+			}
+		}
+	}
+
+	if (span != NULL) {
+		remove_free_span(span);
+
+		if (span->page_count > pageCount) {
+			heap_span* rest = split_span(span, pageCount);
+			if (rest != NULL)
+				insert_free_span(rest);
+		}
+
+		return span;
+	}
+
+	// take new pages from the top of the heap
+	size_t size = pageCount * kPageSize;
+	if (size > sAreaEnd - sHeapTop && !grow_heap(size))
+		return NULL;
+
+	span = allocate_span_structure();
+	if (span == NULL)
+		return NULL;
+
+	span->base = sHeapTop;
+	span->page_count = pageCount;
+	sHeapTop += size;
+
+	return span;
+}
+
+
+/*!	Returns the pages of \a span to the page heap, and coalesces it with its
+	free neighbours. The merged span keeps track of how many of its pages have
+	not been released yet, so that released neighbours are not counted again.
+	The page heap lock must be held.
+*/
+static void
+free_pages(heap_span* span)
+{
+	span->unreleased_pages = span->page_count;
+
+	if (span->base > sHeapBase) {
+		heap_span* previous = page_map_lookup(span->base - kPageSize);
+		if (previous != NULL && previous->state == SPAN_FREE) {
+			remove_free_span(previous);
+			span->base = previous->base;
+			span->page_count += previous->page_count;
+			span->unreleased_pages += previous->unreleased_pages;
+			free_span_structure(previous);
+		}
+	}
+
+	if (span->End() < sHeapTop) {
+		heap_span* next = page_map_lookup(span->End());
+		if (next != NULL && next->state == SPAN_FREE) {
+			remove_free_span(next);
+			span->page_count += next->page_count;
+			span->unreleased_pages += next->unreleased_pages;
+			free_span_structure(next);
+		}
+	}
+
+	insert_free_span(span);
+
+	if (sUnreleasedPages > sReleaseThreshold)
+		release_free_spans();
+}
+
+
+void*
+heap_allocate_large(size_t size, size_t alignment)
+{
+	if (size == 0)
+		size = 1;
+	if (size > sHeapEnd - sHeapBase || alignment > sHeapEnd - sHeapBase)
+		return NULL;
+
+	size_t pageCount = (size + kPageSize - 1) >> kPageShift;
+	size_t extraPages = 0;
+	if (alignment > kPageSize)
+		extraPages = alignment / kPageSize - 1;
+
+	MutexLocker locker(sPageHeapLock);
+
+	heap_span* span = allocate_pages(pageCount + extraPages);
+	if (span == NULL)
+		return NULL;
+
+	span->state = SPAN_LARGE;
+	page_map_set_span(span);
+
+	if (extraPages > 0) {
+		// cut off the pages in front of and after the aligned range
+		size_t frontPages = (((span->base + alignment - 1) & ~(alignment - 1))
+			- span->base) / kPageSize;
+		if (frontPages > 0) {
+			heap_span* aligned = split_span(span, frontPages);
+			if (aligned == NULL) {
+				free_pages(span);
+				return NULL;
+			}
+
+			page_map_set_span(aligned);
+			free_pages(span);
+			span = aligned;
+		}
+
+		if (span->page_count > pageCount) {
+			heap_span* back = split_span(span, pageCount);
+			if (back != NULL)
+				free_pages(back);
+		}
+	}
+
+	sLargePages += span->page_count;
+	sLargeCount++;
+
+	return (void*)span->base;
+}
+
+
+void
+heap_free_large(heap_span* span)
+{
+	MutexLocker locker(sPageHeapLock);
+
+	sLargePages -= span->page_count;
+	sLargeCount--;
+
+	free_pages(span);
+}
+
+
+size_t
+heap_release_free_pages()
+{
+	MutexLocker locker(sPageHeapLock);
+	return release_free_spans();
+}
+
+
+heap_span*
+heap_span_for(const void* _address)
+{
+	addr_t address = (addr_t)_address;
+	if (address < sHeapBase || address >= sHeapTop)
+		return NULL;
+
+	return page_map_lookup(address);
+}
+
+
+// #pragma mark - size classes
+
+
+uint32
+heap_size_class_for(size_t size)
+{
+	return sSizeClassTable[(size + kMinAlignment - 1) / kMinAlignment];
+}
+
+
+static heap_span*
+allocate_small_span(uint32 sizeClass)
+{
+	MutexLocker locker(sPageHeapLock);
+
+	heap_span* span = allocate_pages(gSizeClasses[sizeClass].span_pages);
+	if (span == NULL)
+		return NULL;
+
+	span->state = SPAN_SMALL;
+	span->size_class = sizeClass;
+	span->free_objects = NULL;
+	span->unused = span->base;
+	span->used_count = 0;
+	page_map_set_span(span);
+
+	sSmallPages += span->page_count;
+	return span;
+}
+
+
+static void
+free_small_span(heap_span* span)
+{
+	MutexLocker locker(sPageHeapLock);
+
+	sSmallPages -= span->page_count;
+	free_pages(span);
+}
+
+
+static inline bool
+span_is_full(heap_span* span, size_t objectSize)
+{
+	return span->free_objects == NULL
+		&& span->End() - span->unused < objectSize;
+}
+
+
+/*!	Moves up to \a count objects of the given size class into a list that is
+	returned in \a _objects. Returns the number of objects in that list.
+*/
+uint32
+heap_allocate_objects(uint32 sizeClass, free_object*& _objects, uint32 count)
+{
+	size_class& sizeClassInfo = gSizeClasses[sizeClass];
+	size_t objectSize = sizeClassInfo.size;
+
+	MutexLocker locker(sizeClassInfo.lock);
+
+	free_object* objects = NULL;
+	uint32 allocated = 0;
+
+	while (allocated < count) {
+		heap_span* span = sizeClassInfo.partial_spans.first;
+		if (span == NULL) {
+			span = allocate_small_span(sizeClass);
+			if (span == NULL)
+				break;
+
+			list_add(sizeClassInfo.partial_spans, span);
+			sizeClassInfo.span_count++;
+		}
+
+		while (allocated < count) {
+			free_object* object = span->free_objects;
+			if (object != NULL)
+				span->free_objects = object->next;
+			else if (span->End() - span->unused >= objectSize) {
+				object = (free_object*)span->unused;
+				span->unused += objectSize;
+			} else
+				break;
+
+			object->next = objects;
+			objects = object;
+			span->used_count++;
+			allocated++;
+		}
+
+		if (span_is_full(span, objectSize))
+			list_remove(sizeClassInfo.partial_spans, span);
+	}
+
+	sizeClassInfo.object_count += allocated;
+
+	_objects = objects;
+	return allocated;
+}
+
+
+/*!	Returns the list of objects \a objects to the given size class. */
+void
+heap_free_objects(uint32 sizeClass, free_object* objects)
+{
+	size_class& sizeClassInfo = gSizeClasses[sizeClass];
+	size_t objectSize = sizeClassInfo.size;
+
+	MutexLocker locker(sizeClassInfo.lock);
+
+	while (objects != NULL) {
+		free_object* object = objects;
+		objects = object->next;
+
+		heap_span* span = page_map_lookup((addr_t)object);
+		if (span_is_full(span, objectSize))
+			list_add(sizeClassInfo.partial_spans, span);
+
+		object->next = span->free_objects;
+		span->free_objects = object;
+		span->used_count--;
+		sizeClassInfo.object_count--;
+
+		// Give unused spans back to the page heap, but keep the last one to
+		// avoid bouncing a span back and forth.
+		if (span->used_count == 0
+			&& sizeClassInfo.partial_spans.first
+				!= sizeClassInfo.partial_spans.last) {
+			list_remove(sizeClassInfo.partial_spans, span);
+			sizeClassInfo.span_count--;
+			free_small_span(span);
+		}
+	}
+}
+
+
+static void
+init_size_class(uint32& index, size_t size)
+{
+	size_class& sizeClass = gSizeClasses[index];
+
+	mutex_init_etc(&sizeClass.lock, "heap size class", MUTEX_FLAG_ADAPTIVE);
+	sizeClass.size = size;
+
+	// use the smallest span that wastes at most 1/8 of its memory
+	size_t pages = 1;
+	while (pages < kMaxSpanPages
+		&& (pages * kPageSize) % size > pages * kPageSize / 8) {
+		pages++;
+	}
+	sizeClass.span_pages = pages;
+
+	uint32 batchCount = kThreadCacheBatchSize / size;
+	if (batchCount < kMinBatchCount)
+		batchCount = kMinBatchCount;
+	else if (batchCount > kMaxBatchCount)
+		batchCount = kMaxBatchCount;
+	sizeClass.batch_count = batchCount;
+
+	index++;
+}
+
+
+static void
+init_size_classes()
+{
+	uint32 index = 0;
+
+	// 16 byte steps up to 128 bytes, four classes per power of two after that
+	for (size_t size = kMinAlignment; size <= 128; size += kMinAlignment)
+		init_size_class(index, size);
+
+	for (size_t base = 128; base < kMaxSmallSize; base *= 2) {
+		for (size_t step = 1; step <= 4; step++)
+			init_size_class(index, base + base / 4 * step);
+	}
+
+	if (index != kSizeClassCount)
+		debugger("malloc: size class count mismatch");
+
+	// map sizes in kMinAlignment steps to the smallest class they fit in
+	uint32 sizeClass = 0;
+	for (size_t i = 0; i <= kMaxSmallSize / kMinAlignment; i++) {
+		while (gSizeClasses[sizeClass].size < i * kMinAlignment)
+			sizeClass++;
+		sSizeClassTable[i] = sizeClass;
+	}
+}
+
+
+// #pragma mark - init
+
+
+status_t
+heap_init()
+{
+	init_size_classes();
+
+	sHeapProtection = B_READ_AREA | B_WRITE_AREA;
+	if (__gABIVersion < B_HAIKU_ABI_GCC_2_HAIKU)
+		sHeapProtection |= B_EXECUTE_AREA;
+
+	// Reserve the address range for the heap. If we don't get all of it, try
+	// smaller ranges.
+	size_t reservationSize = kHeapReservationSize;
+	status_t status;
+	while (true) {
+		sHeapBase = kHeapReservationBase;
+		status = _kern_reserve_address_range(&sHeapBase,
+			B_RANDOMIZED_BASE_ADDRESS, reservationSize);
+		if (status == B_OK || reservationSize <= kMinHeapReservationSize)
+			break;
+
+		reservationSize /= 2;
+	}
+	if (status != B_OK)
+		return status;
+
+	// The reservation is only page aligned, but the spans must be aligned to
+	// kPageSize, and grow_heap() steps by kHeapIncrement. Skip the unaligned
+	// parts at both ends.
+	sHeapEnd = (sHeapBase + reservationSize) & ~(kHeapIncrement - 1);
+	sHeapBase = (sHeapBase + kHeapIncrement - 1) & ~(kHeapIncrement - 1);
+
+	void* address = (void*)sHeapBase;
+	sHeapArea = create_area("heap", &address, B_EXACT_ADDRESS,
+		kHeapIncrement, B_NO_LOCK, sHeapProtection);
+	if (sHeapArea < 0)
+		return sHeapArea;
+
+	sHeapAreaBase = sHeapBase;
+	sHeapTop = sHeapBase;
+	sAreaEnd = sHeapBase + kHeapIncrement;
+
+	sPageMap[0] = (heap_span**)heap_allocate_metadata(
+		kPageMapLeafPages * sizeof(heap_span*));
+	if (sPageMap[0] == NULL)
+		return B_NO_MEMORY;
+
+	mutex_init_etc(&sPageHeapLock, "heap pages", MUTEX_FLAG_ADAPTIVE);
+	return B_OK;
+}
+
+
+void
+heap_init_after_fork()
+{
+	// the areas have been copied, and got new IDs
+	sHeapArea = area_for((void*)sHeapAreaBase);
+	if (sHeapArea < 0) {
+		debug_printf("malloc: heap_init_after_fork(): thread %" B_PRId32
+			", heap area not found! Base address: %p\n", find_thread(NULL),
+			(void*)sHeapAreaBase);
+		exit(1);
+	}
+}
+
+
+void
+heap_lock_all()
+{
+	for (uint32 i = 0; i < kSizeClassCount; i++)
+		mutex_lock(&gSizeClasses[i].lock);
+	mutex_lock(&sPageHeapLock);
+	mutex_lock(&sMetadataLock);
+}
+
+
+void
+heap_unlock_all()
+{
+	mutex_unlock(&sMetadataLock);
+	mutex_unlock(&sPageHeapLock);
+	for (uint32 i = kSizeClassCount; i-- > 0;)
+		mutex_unlock(&gSizeClasses[i].lock);
+}
+
+
+void
+heap_reinit_locks()
+{
+	for (uint32 i = 0; i < kSizeClassCount; i++)
+		mutex_init_etc(&gSizeClasses[i].lock, "heap size class",
+			MUTEX_FLAG_ADAPTIVE);
+	mutex_init_etc(&sPageHeapLock, "heap pages", MUTEX_FLAG_ADAPTIVE);
+	mutex_init(&sMetadataLock, "heap metadata");
+}
+
+
+void
+heap_get_statistics(heap_statistics& statistics)
+{
+	memset(&statistics, 0, sizeof(statistics));
+
+	for (uint32 i = 0; i < kSizeClassCount; i++) {
+		MutexLocker locker(gSizeClasses[i].lock);
+		statistics.small_object_size
+			+= gSizeClasses[i].object_count * gSizeClasses[i].size;
+	}
+
+	MutexLocker locker(sPageHeapLock);
+
+	statistics.heap_size = sHeapTop - sHeapBase;
+	statistics.small_size = sSmallPages * kPageSize;
+	statistics.free_size = sFreePages * kPageSize;
+	statistics.released_size = (sFreePages - sUnreleasedPages) * kPageSize;
+	statistics.large_size = sLargePages * kPageSize;
+	statistics.large_count = sLargeCount;
+}
+
+
+}	// namespace ThreadCacheHeap
+}	// namespace BPrivate
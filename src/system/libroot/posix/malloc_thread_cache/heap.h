@@ -0,0 +1,122 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _MALLOC_THREAD_CACHE_HEAP_H
+#define _MALLOC_THREAD_CACHE_HEAP_H
+
+
+#include <OS.h>
+
+#include <locks.h>
+
+
+namespace BPrivate {
+namespace ThreadCacheHeap {
+
+
+// The heap is carved out of a single reserved address range in units of heap
+// pages. Runs of pages are handed out as spans, which either hold objects of a
+// single size class, or a single large allocation.
+static const size_t kPageShift = 14;
+static const size_t kPageSize = 1 << kPageShift;
+
+static const size_t kMinAlignment = 16;
+static const size_t kMaxSmallSize = 16 * 1024;
+static const uint32 kSizeClassCount = 36;
+
+
+struct free_object {
+	free_object*	next;
+};
+
+
+enum {
+	SPAN_FREE,
+	SPAN_SMALL,
+	SPAN_LARGE
+};
+
+
+// Note: All heap structures must be plain data, since the heap is in use long
+// before libroot's static constructors have been run.
+struct heap_span {
+	heap_span*		next;
+	heap_span*		previous;
+	addr_t			base;
+	size_t			page_count;
+	free_object*	free_objects;
+	addr_t			unused;
+		// objects from here to the end of the span have never been handed out
+	size_t			unreleased_pages;
+		// free spans only: the number of its pages that have not been
+		// returned to the system
+	uint32			used_count;
+	uint8			state;
+	uint8			size_class;
+
+	addr_t End() const
+		{ return base + page_count * kPageSize; }
+};
+
+
+struct span_list {
+	heap_span*		first;
+	heap_span*		last;
+};
+
+
+struct size_class {
+	mutex			lock;
+	size_t			size;
+	size_t			span_pages;
+	uint32			batch_count;
+		// objects moved between a thread cache and the class at once
+	span_list		partial_spans;
+		// spans that still have free or unused objects
+	size_t			span_count;
+	size_t			object_count;
+		// objects handed out to the thread caches
+};
+
+
+struct heap_statistics {
+	size_t			heap_size;
+	size_t			small_size;
+	size_t			small_object_size;
+	size_t			free_size;
+	size_t			released_size;
+	size_t			large_size;
+	size_t			large_count;
+};
+
+
+extern size_class gSizeClasses[kSizeClassCount];
+
+
+status_t	heap_init();
+void		heap_init_after_fork();
+void		heap_lock_all();
+void		heap_unlock_all();
+void		heap_reinit_locks();
+
+uint32		heap_size_class_for(size_t size);
+heap_span*	heap_span_for(const void* address);
+
+void*		heap_allocate_large(size_t size, size_t alignment);
+void		heap_free_large(heap_span* span);
+size_t		heap_release_free_pages();
+
+uint32		heap_allocate_objects(uint32 sizeClass, free_object*& _objects,
+				uint32 count);
+void		heap_free_objects(uint32 sizeClass, free_object* objects);
+
+void*		heap_allocate_metadata(size_t size);
+void		heap_get_statistics(heap_statistics& statistics);
+
+
+}	// namespace ThreadCacheHeap
+}	// namespace BPrivate
+
+
+#endif	// _MALLOC_THREAD_CACHE_HEAP_H
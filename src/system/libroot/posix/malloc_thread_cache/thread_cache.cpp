@@ -0,0 +1,308 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Per-thread caches of free small objects.
+
+	Each thread keeps a list of free objects per size class, so that most
+	allocations and frees don't need to take any lock. The lists are refilled
+	from and flushed back to the size classes in batches.
+*/
+
+
+#include "thread_cache.h"
+
+#include <string.h>
+
+#include <locks.h>
+#include <tls.h>
+
+
+namespace BPrivate {
+namespace ThreadCacheHeap {
+
+
+struct thread_cache_list {
+	free_object*	objects;
+	uint32			count;
+	uint32			max_count;
+};
+
+
+struct thread_cache {
+	thread_cache*		next;
+	thread_cache*		previous;
+	thread_id			thread;
+	thread_cache_list	lists[kSizeClassCount];
+};
+
+
+// Marks the cache of a thread that has already run its exit work. Such a
+// thread passes its objects straight to the size classes, as nobody would
+// flush its cache anymore.
+static thread_cache* const kExitedThreadCache = (thread_cache*)1;
+
+static mutex sThreadCacheLock = MUTEX_INITIALIZER("heap thread caches");
+static thread_cache* sThreadCaches;
+static size_t sThreadCacheCount;
+static thread_cache* sUnusedThreadCaches;
+
+
+static void
+flush_list(thread_cache_list& list, uint32 sizeClass, uint32 count)
+{
+	if (count == 0)
+		return;
+
+	free_object* objects = list.objects;
+	free_object* last = objects;
+	for (uint32 i = 1; i < count; i++)
+		last = last->next;
+
+	list.objects = last->next;
+	list.count -= count;
+	last->next = NULL;
+
+	heap_free_objects(sizeClass, objects);
+}
+
+
+static void
+flush_cache(thread_cache* cache)
+{
+	for (uint32 i = 0; i < kSizeClassCount; i++)
+		flush_list(cache->lists[i], i, cache->lists[i].count);
+}
+
+
+/*!	Unlinks \a cache from the list of caches, and puts it on the unused list.
+	The thread cache lock must be held.
+*/
+static void
+remove_cache(thread_cache* cache)
+{
+	if (cache->previous != NULL)
+		cache->previous->next = cache->next;
+	else
+		sThreadCaches = cache->next;
+	if (cache->next != NULL)
+		cache->next->previous = cache->previous;
+
+	cache->previous = NULL;
+	cache->next = sUnusedThreadCaches;
+	sUnusedThreadCaches = cache;
+	sThreadCacheCount--;
+}
+
+
+/*!	Gives back the caches of threads that are gone without having run their
+	exit work, because they have been killed. Since that costs a syscall per
+	cache, they are only looked for when there are more caches than threads.
+	The thread cache lock must be held.
+*/
+static void
+reclaim_dead_caches()
+{
+	team_info teamInfo;
+	if (get_team_info(B_CURRENT_TEAM, &teamInfo) != B_OK
+		|| sThreadCacheCount <= (size_t)teamInfo.thread_count) {
+		return;
+	}
+
+	thread_cache* cache = sThreadCaches;
+	while (cache != NULL) {
+		thread_cache* next = cache->next;
+
+		thread_info threadInfo;
+		if (get_thread_info(cache->thread, &threadInfo) != B_OK
+			|| threadInfo.team != teamInfo.team) {
+			// nobody can touch the cache of a dead thread anymore
+			flush_cache(cache);
+			remove_cache(cache);
+		}
+		cache = next;
+	}
+}
+
+
+static thread_cache*
+create_cache()
+{
+	MutexLocker locker(sThreadCacheLock);
+
+	if (sUnusedThreadCaches == NULL)
+		reclaim_dead_caches();
+
+	thread_cache* cache = sUnusedThreadCaches;
+	if (cache != NULL)
+		sUnusedThreadCaches = cache->next;
+	else {
+		cache = (thread_cache*)heap_allocate_metadata(sizeof(thread_cache));
+		if (cache == NULL)
+			return NULL;
+	}
+
+	memset(cache, 0, sizeof(thread_cache));
+	cache->thread = find_thread(NULL);
+	for (uint32 i = 0; i < kSizeClassCount; i++)
+		cache->lists[i].max_count = 2 * gSizeClasses[i].batch_count;
+
+	cache->next = sThreadCaches;
+	if (sThreadCaches != NULL)
+		sThreadCaches->previous = cache;
+	sThreadCaches = cache;
+	sThreadCacheCount++;
+
+	locker.Unlock();
+
+	tls_set(TLS_MALLOC_SLOT, cache);
+	return cache;
+}
+
+
+static inline thread_cache*
+get_cache()
+{
+	thread_cache* cache = (thread_cache*)tls_get(TLS_MALLOC_SLOT);
+	if (cache == NULL)
+		return create_cache();
+
+	return cache;
+}
+
+
+// #pragma mark -
+
+
+void*
+thread_cache_allocate(uint32 sizeClass)
+{
+	thread_cache* cache = get_cache();
+	if (cache == NULL || cache == kExitedThreadCache) {
+		free_object* object;
+		if (heap_allocate_objects(sizeClass, object, 1) == 0)
+			return NULL;
+		return object;
+	}
+
+	thread_cache_list& list = cache->lists[sizeClass];
+	if (list.objects == NULL) {
+		list.count = heap_allocate_objects(sizeClass, list.objects,
+			gSizeClasses[sizeClass].batch_count);
+		if (list.count == 0)
+			return NULL;
+	}
+
+	free_object* object = list.objects;
+	list.objects = object->next;
+	list.count--;
+	return object;
+}
+
+
+void
+thread_cache_free(uint32 sizeClass, void* address)
+{
+	free_object* object = (free_object*)address;
+
+	thread_cache* cache = get_cache();
+	if (cache == NULL || cache == kExitedThreadCache) {
+		object->next = NULL;
+		heap_free_objects(sizeClass, object);
+		return;
+	}
+
+	thread_cache_list& list = cache->lists[sizeClass];
+	object->next = list.objects;
+	list.objects = object;
+
+	if (++list.count > list.max_count)
+		flush_list(list, sizeClass, gSizeClasses[sizeClass].batch_count);
+}
+
+
+/*!	Called when the current thread exits. Flushes its cache back to the size
+	classes.
+*/
+void
+thread_cache_exit()
+{
+	thread_cache* cache = (thread_cache*)tls_get(TLS_MALLOC_SLOT);
+	tls_set(TLS_MALLOC_SLOT, kExitedThreadCache);
+
+	if (cache == NULL || cache == kExitedThreadCache)
+		return;
+
+	flush_cache(cache);
+
+	MutexLocker locker(sThreadCacheLock);
+	remove_cache(cache);
+}
+
+
+void
+thread_cache_lock_all()
+{
+	mutex_lock(&sThreadCacheLock);
+}
+
+
+void
+thread_cache_unlock_all()
+{
+	mutex_unlock(&sThreadCacheLock);
+}
+
+
+/*!	Called in the child after fork(). Only the current thread survives, the
+	objects in the caches of all other threads are given back to the size
+	classes.
+*/
+void
+thread_cache_init_after_fork()
+{
+	mutex_init(&sThreadCacheLock, "heap thread caches");
+
+	thread_cache* current = (thread_cache*)tls_get(TLS_MALLOC_SLOT);
+	if (current != NULL && current != kExitedThreadCache)
+		current->thread = find_thread(NULL);
+
+	thread_cache* cache = sThreadCaches;
+	while (cache != NULL) {
+		thread_cache* next = cache->next;
+		if (cache != current) {
+			flush_cache(cache);
+			remove_cache(cache);
+		}
+		cache = next;
+	}
+}
+
+
+void
+thread_cache_get_statistics(size_t& _size, size_t& _count)
+{
+	MutexLocker locker(sThreadCacheLock);
+
+	reclaim_dead_caches();
+
+	size_t size = 0;
+	size_t count = 0;
+	for (thread_cache* cache = sThreadCaches; cache != NULL;
+			cache = cache->next) {
+		// The counts may be changed concurrently by the cache's thread, but
+		// the result is only a snapshot anyway.
+		for (uint32 i = 0; i < kSizeClassCount; i++)
+			size += cache->lists[i].count * gSizeClasses[i].size;
+		count++;
+	}
+
+	_size = size;
+	_count = count;
+}
+
+
+}	// namespace ThreadCacheHeap
+}	// namespace BPrivate
@@ -0,0 +1,31 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _MALLOC_THREAD_CACHE_THREAD_CACHE_H
+#define _MALLOC_THREAD_CACHE_THREAD_CACHE_H
+
+
+#include "heap.h"
+
+
+namespace BPrivate {
+namespace ThreadCacheHeap {
+
+
+void*		thread_cache_allocate(uint32 sizeClass);
+void		thread_cache_free(uint32 sizeClass, void* address);
+void		thread_cache_exit();
+
+void		thread_cache_lock_all();
+void		thread_cache_unlock_all();
+void		thread_cache_init_after_fork();
+
+void		thread_cache_get_statistics(size_t& _size, size_t& _count);
+
+
+}	// namespace ThreadCacheHeap
+}	// namespace BPrivate
+
+
+#endif	// _MALLOC_THREAD_CACHE_THREAD_CACHE_H
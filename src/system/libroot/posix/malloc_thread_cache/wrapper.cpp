@@ -0,0 +1,387 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	The public malloc API on top of the thread caching allocator. */
+
+
+#include <malloc.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+#include <errno_private.h>
+#include <libroot_private.h>
+#include <user_thread.h>
+
+#include "heap.h"
+#include "thread_cache.h"
+
+
+using namespace BPrivate::ThreadCacheHeap;
+
+
+static inline bool
+is_valid_alignment(size_t alignment)
+{
+	// the alignment must be a power of two
+	return alignment != 0 && (alignment & (alignment - 1)) == 0;
+}
+
+
+static void*
+allocate(size_t size)
+{
+	if (size <= kMaxSmallSize)
+		return thread_cache_allocate(heap_size_class_for(size));
+
+	return heap_allocate_large(size, kPageSize);
+}
+
+
+static void*
+allocate_aligned(size_t alignment, size_t size)
+{
+	if (alignment <= kMinAlignment)
+		return allocate(size);
+
+	if (alignment <= kPageSize && size <= kMaxSmallSize) {
+		// Spans are page aligned, so the objects of a class are aligned to
+		// any power of two that divides the class' size.
+		if (size < alignment)
+			size = alignment;
+
+		for (uint32 sizeClass = heap_size_class_for(size);
+				sizeClass < kSizeClassCount; sizeClass++) {
+			if (gSizeClasses[sizeClass].size % alignment == 0)
+				return thread_cache_allocate(sizeClass);
+		}
+	}
+
+	return heap_allocate_large(size,
+		alignment > kPageSize ? alignment : kPageSize);
+}
+
+
+/*!	Returns the span an allocation belongs to, and panics if \a address does
+	not point to one.
+*/
+static heap_span*
+span_for_allocation(void* address, const char* function)
+{
+	heap_span* span = heap_span_for(address);
+	if (span == NULL || span->state == SPAN_FREE
+		|| (span->state == SPAN_LARGE && (addr_t)address != span->base)) {
+		debug_printf("malloc: %s(): invalid pointer %p\n", function, address);
+		debugger("malloc: invalid pointer");
+		return NULL;
+	}
+
+	return span;
+}
+
+
+static size_t
+allocation_size(heap_span* span, void* address)
+{
+	if (span->state == SPAN_SMALL)
+		return gSizeClasses[span->size_class].size;
+
+	return span->End() - (addr_t)address;
+}
+
+
+static void
+deallocate(heap_span* span, void* address)
+{
+	if (span->state == SPAN_SMALL)
+		thread_cache_free(span->size_class, address);
+	else
+		heap_free_large(span);
+}
+
+
+// #pragma mark - private functions
+
+
+extern "C" status_t
+__init_heap(void)
+{
+	return heap_init();
+}
+
+
+extern "C" void
+__heap_terminate_after()
+{
+	// nothing to do
+}
+
+
+extern "C" void
+__heap_thread_exit(void)
+{
+	defer_signals();
+	thread_cache_exit();
+	undefer_signals();
+}
+
+
+extern "C" void
+__heap_before_fork(void)
+{
+	thread_cache_lock_all();
+	heap_lock_all();
+}
+
+
+extern "C" void
+__heap_after_fork_child(void)
+{
+	heap_reinit_locks();
+	heap_init_after_fork();
+	thread_cache_init_after_fork();
+}
+
+
+extern "C" void
+__heap_after_fork_parent(void)
+{
+	heap_unlock_all();
+	thread_cache_unlock_all();
+}
+
+
+// #pragma mark - public functions
+
+
+extern "C" void*
+malloc(size_t size)
+{
+	defer_signals();
+	void* address = allocate(size);
+	undefer_signals();
+
+	if (address == NULL)
+		__set_errno(B_NO_MEMORY);
+
+	return address;
+}
+
+
+extern "C" void*
+calloc(size_t numElements, size_t size)
+{
+	if (size != 0 && numElements > (size_t)-1 / size) {
+		__set_errno(B_NO_MEMORY);
+		return NULL;
+	}
+	size *= numElements;
+
+	void* address = malloc(size);
+	if (address != NULL)
+		memset(address, 0, size);
+
+	return address;
+}
+
+
+extern "C" void
+free(void* address)
+{
+	if (address == NULL)
+		return;
+
+	defer_signals();
+
+	heap_span* span = span_for_allocation(address, "free");
+	if (span != NULL)
+		deallocate(span, address);
+
+	undefer_signals();
+}
+
+
+extern "C" void*
+memalign(size_t alignment, size_t size)
+{
+	if (!is_valid_alignment(alignment)) {
+		__set_errno(B_BAD_VALUE);
+		return NULL;
+	}
+
+	defer_signals();
+	void* address = allocate_aligned(alignment, size);
+	undefer_signals();
+
+	if (address == NULL)
+		__set_errno(B_NO_MEMORY);
+
+	return address;
+}
+
+
+extern "C" int
+posix_memalign(void** _pointer, size_t alignment, size_t size)
+{
+	if (!is_valid_alignment(alignment) || alignment < sizeof(void*))
+		return B_BAD_VALUE;
+
+	defer_signals();
+	void* address = allocate_aligned(alignment, size);
+	undefer_signals();
+
+	if (address == NULL)
+		return B_NO_MEMORY;
+
+	*_pointer = address;
+	return 0;
+}
+
+
+extern "C" void*
+valloc(size_t size)
+{
+	return memalign(B_PAGE_SIZE, size);
+}
+
+
+extern "C" void*
+realloc(void* address, size_t newSize)
+{
+	if (address == NULL)
+		return malloc(newSize);
+
+	if (newSize == 0) {
+		free(address);
+		return NULL;
+	}
+
+	defer_signals();
+
+	heap_span* span = span_for_allocation(address, "realloc");
+	if (span == NULL) {
+		undefer_signals();
+		return NULL;
+	}
+
+	size_t oldSize = allocation_size(span, address);
+
+	// keep the allocation, if it fits and not too much of it is wasted
+	if (newSize <= oldSize && (newSize > oldSize / 2
+			|| (span->state == SPAN_SMALL && oldSize <= 2 * kMinAlignment))) {
+		undefer_signals();
+		return address;
+	}
+
+	void* newAddress = allocate(newSize);
+	if (newAddress == NULL) {
+		undefer_signals();
+		__set_errno(B_NO_MEMORY);
+		return NULL;
+	}
+
+	memcpy(newAddress, address, newSize < oldSize ? newSize : oldSize);
+	deallocate(span, address);
+
+	undefer_signals();
+	return newAddress;
+}
+
+
+extern "C" size_t
+malloc_usable_size(void* address)
+{
+	if (address == NULL)
+		return 0;
+
+	defer_signals();
+
+	heap_span* span = span_for_allocation(address, "malloc_usable_size");
+	size_t size = span != NULL ? allocation_size(span, address) : 0;
+
+	undefer_signals();
+	return size;
+}
+
+
+extern "C" int
+malloc_trim(size_t pad)
+{
+	defer_signals();
+	size_t released = heap_release_free_pages();
+	undefer_signals();
+
+	return released > 0 ? 1 : 0;
+}
+
+
+extern "C" int
+malloc_get_statistics(struct malloc_statistics* statistics)
+{
+	if (statistics == NULL)
+		return B_BAD_VALUE;
+
+	heap_statistics heapStatistics;
+	size_t cachedSize;
+	size_t threadCacheCount;
+
+	defer_signals();
+	heap_get_statistics(heapStatistics);
+	thread_cache_get_statistics(cachedSize, threadCacheCount);
+	undefer_signals();
+
+	// the statistics are not gathered atomically, avoid nonsense results
+	if (cachedSize > heapStatistics.small_object_size)
+		cachedSize = heapStatistics.small_object_size;
+
+	statistics->heap_size = heapStatistics.heap_size;
+	statistics->allocated_size = heapStatistics.small_object_size
+		- cachedSize + heapStatistics.large_size;
+	statistics->cached_size = cachedSize;
+	statistics->free_size = heapStatistics.free_size;
+	statistics->released_size = heapStatistics.released_size;
+	statistics->large_allocation_count = heapStatistics.large_count;
+	statistics->thread_cache_count = threadCacheCount;
+
+	return 0;
+}
+
+
+//	#pragma mark - BeOS specific extensions
+
+
+struct mstats {
+	size_t bytes_total;
+	size_t chunks_used;
+	size_t bytes_used;
+	size_t chunks_free;
+	size_t bytes_free;
+};
+
+
+extern "C" struct mstats mstats(void);
+
+extern "C" struct mstats
+mstats(void)
+{
+	// Note, the stats structure is not thread-safe, but it doesn't
+	// matter that much either
+	static struct mstats stats;
+
+	malloc_statistics statistics;
+	malloc_get_statistics(&statistics);
+
+	stats.bytes_total = statistics.heap_size;
+	stats.chunks_used = 0;
+	stats.bytes_used = statistics.allocated_size;
+	stats.chunks_free = 0;
+	stats.bytes_free = statistics.heap_size - statistics.allocated_size;
+
+	return stats;
+}
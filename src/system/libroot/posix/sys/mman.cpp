@@ -170,6 +170,13 @@ posix_madvise(void* address, size_t length, int advice)
 }
 
 
+int
+madvise(void* address, size_t length, int advice)
+{
+	RETURN_AND_SET_ERRNO(_kern_memory_advice(address, length, advice));
+}
+
+
 int
 shm_open(const char* name, int openMode, mode_t permissions)
 {
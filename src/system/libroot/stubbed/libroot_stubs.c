@@ -849,6 +849,7 @@ void __heap_after_fork_child() {}
 void __heap_after_fork_parent() {}
 void __heap_before_fork() {}
 void __heap_terminate_after() {}
+void __heap_thread_exit() {}
 void __hypot() {}
 void __hypotf() {}
 void __hypotl() {}
@@ -1405,6 +1406,7 @@ void _kern_fsync() {}
 void _kern_generic_syscall() {}
 void _kern_get_area_info() {}
 void _kern_get_clock() {}
+void _kern_get_compressed_swap_info() {}
 void _kern_get_cpu_info() {}
 void _kern_get_cpu_topology_info() {}
 void _kern_get_cpuid() {}
@@ -1438,6 +1440,7 @@ void _kern_get_team_usage_info() {}
 void _kern_get_thread_info() {}
 void _kern_get_timer() {}
 void _kern_get_timezone() {}
+void _kern_get_vfs_cache_statistics() {}
 void _kern_getcwd() {}
 void _kern_getgid() {}
 void _kern_getgroups() {}
@@ -2300,7 +2303,10 @@ void lroundf() {}
 void lroundl() {}
 void lsearch() {}
 void lseek() {}
+void madvise() {}
 void malloc() {}
+void malloc_get_statistics() {}
+void malloc_trim() {}
 void malloc_usable_size() {}
 void matherr() {}
 void mblen() {}
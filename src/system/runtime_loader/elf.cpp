@@ -30,6 +30,7 @@
 #include "elf_versioning.h"
 #include "errors.h"
 #include "images.h"
+#include "relocation_cache.h"
 
 
 // TODO: implement better locking strategy
@@ -199,6 +200,7 @@ static status_t
 relocate_image(image_t *rootImage, image_t *image)
 {
 	SymbolLookupCache cache(image);
+	relocation_cache_prefill(image, &cache);
 
 	status_t status = arch_relocate_image(rootImage, image, &cache);
 	if (status < B_OK) {
@@ -206,6 +208,8 @@ relocate_image(image_t *rootImage, image_t *image)
 		return status;
 	}
 
+	relocation_cache_record(image, &cache);
+
 	_kern_image_relocated(image->id);
 	image_event(image, IMAGE_EVENT_RELOCATED);
 	return B_OK;
@@ -438,7 +442,9 @@ load_program(char const *path, void **_entry)
 	// This results in the desired symbol resolution for dlopen()ed libraries.
 	set_image_flags_recursively(gProgramImage, RTLD_GLOBAL);
 
+	relocation_cache_init(gProgramImage);
 	status = relocate_dependencies(gProgramImage);
+	relocation_cache_finish(status == B_OK);
 	if (status < B_OK)
 		goto err;
 
@@ -250,6 +250,7 @@ parse_dynamic_segment(image_t* image)
 	int sonameOffset = -1;
 
 	image->symhash = 0;
+	image->gnu_hash = 0;
 	image->syms = 0;
 	image->strtab = 0;
 
@@ -266,6 +267,10 @@ parse_dynamic_segment(image_t* image)
 				image->symhash
 					= (uint32*)(d[i].d_un.d_ptr + image->regions[0].delta);
 				break;
+			case DT_GNU_HASH:
+				image->gnu_hash
+					= (uint32*)(d[i].d_un.d_ptr + image->regions[0].delta);
+				break;
 			case DT_STRTAB:
 				image->strtab
 					= (char*)(d[i].d_un.d_ptr + image->regions[0].delta);
@@ -381,10 +386,20 @@ parse_dynamic_segment(image_t* image)
 		}
 	}
 
-	// lets make sure we found all the required sections
+	// Lets make sure we found all the required sections. The SysV hash table
+	// is still required, even if there is a GNU one: debuggers and the
+	// symbol iteration functions use it to get at the symbol count.
 	if (!image->symhash || !image->syms || !image->strtab)
 		return false;
 
+	// ignore a GNU hash table we can't use, the SysV one will do just fine
+	if (image->gnu_hash != NULL && (GNU_HASH_BUCKET_COUNT(image) == 0
+			|| GNU_HASH_BLOOM_SIZE(image) == 0
+			|| (GNU_HASH_BLOOM_SIZE(image) & (GNU_HASH_BLOOM_SIZE(image) - 1))
+				!= 0)) {
+		image->gnu_hash = NULL;
+	}
+
 	if (sonameOffset >= 0)
 		strlcpy(image->name, STRING(image, sonameOffset), sizeof(image->name));
 
@@ -63,6 +63,102 @@ elf_hash(const char* _name)
 }
 
 
+uint32
+elf_gnu_hash(const char* _name)
+{
+	const uint8* name = (const uint8*)_name;
+
+	uint32 hash = 5381;
+	while (*name)
+		hash = hash * 33 + *name++;
+
+	return hash;
+}
+
+
+/*!	Iterates through the indices of the symbols in the hash chain of \a image
+	the looked up name maps to.
+
+	If the image has a GNU hash table, that one is used: its bloom filter
+	rejects most lookups of names the image doesn't define right away, and
+	since the chains store the hash values, only symbols whose hash matches
+	are returned. Otherwise the SysV hash table is walked.
+*/
+class SymbolHashChainIterator {
+public:
+	SymbolHashChainIterator(image_t* image, const SymbolLookupInfo& lookupInfo)
+		:
+		fImage(image),
+		fHash(lookupInfo.gnuHash),
+		fNext(STN_UNDEF)
+	{
+		if (image->gnu_hash == NULL) {
+			fNext = HASHBUCKETS(image)[lookupInfo.hash % HASHTABSIZE(image)];
+			return;
+		}
+
+		const uint32 kBloomBits = sizeof(addr_t) * 8;
+		addr_t bloomWord = GNU_HASH_BLOOM(image)[(fHash / kBloomBits)
+			& (GNU_HASH_BLOOM_SIZE(image) - 1)];
+		addr_t bloomMask = ((addr_t)1 << (fHash % kBloomBits))
+			| ((addr_t)1 << ((fHash >> GNU_HASH_BLOOM_SHIFT(image))
+				% kBloomBits));
+		if ((bloomWord & bloomMask) != bloomMask)
+			return;
+
+		uint32 index
+			= GNU_HASH_BUCKETS(image)[fHash % GNU_HASH_BUCKET_COUNT(image)];
+		if (index == STN_UNDEF || index < GNU_HASH_SYMBOL_OFFSET(image))
+			return;
+
+		fNext = index;
+		_SkipMismatches();
+	}
+
+	bool HasNext() const
+	{
+		return fNext != STN_UNDEF;
+	}
+
+	uint32 Next()
+	{
+		uint32 index = fNext;
+
+		if (fImage->gnu_hash == NULL) {
+			fNext = HASHCHAINS(fImage)[index];
+		} else {
+			fNext = _NextGnuIndex(index);
+			_SkipMismatches();
+		}
+
+		return index;
+	}
+
+private:
+	uint32 _NextGnuIndex(uint32 index) const
+	{
+		// the lowest bit of the stored hash marks the end of the chain
+		return (GNU_HASH_CHAINS(fImage)[index] & 1) != 0
+			? STN_UNDEF : index + 1;
+	}
+
+	void _SkipMismatches()
+	{
+		const uint32* chains = GNU_HASH_CHAINS(fImage);
+		while (fNext != STN_UNDEF && ((chains[fNext] ^ fHash) >> 1) != 0)
+			fNext = _NextGnuIndex(fNext);
+	}
+
+private:
+	image_t*	fImage;
+	uint32		fHash;
+	uint32		fNext;
+};
+
+
+// #pragma mark -
+
+
 void
 patch_defined_symbol(image_t* image, const char* name, void** symbol,
 	int32* type)
@@ -113,10 +209,9 @@ find_symbol(image_t* image, const SymbolLookupInfo& lookupInfo, bool allowLocal)
 	elf_sym* versionedSymbol = NULL;
 	uint32 versionedSymbolCount = 0;
 
-	uint32 bucket = lookupInfo.hash % HASHTABSIZE(image);
-
-	for (uint32 i = HASHBUCKETS(image)[bucket]; i != STN_UNDEF;
-			i = HASHCHAINS(image)[i]) {
+	SymbolHashChainIterator iterator(image, lookupInfo);
+	while (iterator.HasNext()) {
+		uint32 i = iterator.Next();
 		elf_sym* symbol = &image->syms[i];
 
 		if (symbol->st_shndx != SHN_UNDEF
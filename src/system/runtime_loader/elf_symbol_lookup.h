@@ -17,12 +17,14 @@
 
 
 uint32 elf_hash(const char* name);
+uint32 elf_gnu_hash(const char* name);
 
 
 struct SymbolLookupInfo {
 	const char*				name;
 	int32					type;
 	uint32					hash;
+	uint32					gnuHash;
 	uint32					flags;
 	const elf_version_info*	version;
 	elf_sym*				requestingSymbol;
@@ -34,6 +36,7 @@ struct SymbolLookupInfo {
 		name(name),
 		type(type),
 		hash(hash),
+		gnuHash(elf_gnu_hash(name)),
 		flags(flags),
 		version(version),
 		requestingSymbol(requestingSymbol)
@@ -47,6 +50,7 @@ struct SymbolLookupInfo {
 		name(name),
 		type(type),
 		hash(elf_hash(name)),
+		gnuHash(elf_gnu_hash(name)),
 		flags(flags),
 		version(version),
 		requestingSymbol(requestingSymbol)
@@ -87,6 +91,11 @@ struct SymbolLookupCache {
 		free(fDSOs);
 	}
 
+	size_t TableSize() const
+	{
+		return fTableSize;
+	}
+
 	bool IsSymbolValueCached(size_t index) const
 	{
 		return index < fTableSize
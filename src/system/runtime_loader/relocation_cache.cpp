@@ -0,0 +1,382 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Persistent cache of the symbol resolutions done when relocating a program
+	and its dependencies.
+
+	The cache is enabled by setting LD_RELOCATION_CACHE to a directory. The
+	cache file of a program is named after the device and node of its
+	executable. It contains the identity of every image that was loaded along
+	with the program, in load order, and for each image the resolved location
+	of every symbol it references. Locations are stored as image index and
+	offset to the load delta of that image, so that they stay valid with
+	randomized load addresses.
+
+	If the set of loaded images still matches, the cached locations are
+	entered into the SymbolLookupCache of each image before it is relocated,
+	and resolve_symbol() won't have to look up any of them. Otherwise the
+	resolutions are recorded during the relocation, and the cache file is
+	written anew.
+*/
+
+
+#include "relocation_cache.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <syscalls.h>
+#include <vm_defs.h>
+
+#include "elf_symbol_lookup.h"
+#include "images.h"
+
+
+static const uint32 kCacheMagic = 'RLCc';
+static const uint32 kCacheVersion = 1;
+
+
+struct cache_header {
+	uint32	magic;
+	uint32	version;
+	uint32	image_count;
+	uint32	entry_count;
+};
+
+struct cache_image {
+	dev_t	device;
+	uint32	symbol_count;
+	ino_t	node;
+	int64	modification_time;
+	off_t	size;
+	uint32	first_entry;
+	uint32	entry_count;
+};
+
+struct cache_entry {
+	uint32	symbol;
+	uint32	image;
+	addr_t	offset;
+};
+
+enum {
+	CACHE_DISABLED,
+	CACHE_VALID,
+	CACHE_RECORDING
+};
+
+
+static uint32 sState = CACHE_DISABLED;
+static char sPath[B_PATH_NAME_LENGTH];
+
+static image_t** sImages;
+static cache_image* sImageInfos;
+static uint32 sImageCount;
+
+static area_id sArea = -1;
+static const cache_entry* sCachedEntries;
+
+static cache_entry* sEntries;
+static uint32 sEntryCount;
+static uint32 sEntryCapacity;
+
+
+static int32
+image_index(image_t* image)
+{
+	for (uint32 i = 0; i < sImageCount; i++) {
+		if (sImages[i] == image)
+			return i;
+	}
+
+	return -1;
+}
+
+
+static bool
+get_image_identity(image_t* image, cache_image& info)
+{
+	struct stat st;
+	if (_kern_read_stat(-1, image->path, true, &st, sizeof(st)) != B_OK)
+		return false;
+
+	memset(&info, 0, sizeof(info));
+	info.device = st.st_dev;
+	info.node = st.st_ino;
+	info.modification_time = (int64)st.st_mtim.tv_sec * 1000000000LL
+		+ st.st_mtim.tv_nsec;
+	info.size = st.st_size;
+	info.symbol_count = image->symhash != NULL ? image->symhash[1] : 0;
+	return true;
+}
+
+
+static bool
+map_cache_file()
+{
+	int fd = _kern_open(-1, sPath, O_RDONLY, 0);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	status_t status = _kern_read_stat(fd, NULL, false, &st, sizeof(st));
+	if (status != B_OK || st.st_size < (off_t)sizeof(cache_header)) {
+		_kern_close(fd);
+		return false;
+	}
+
+	void* address;
+	sArea = _kern_map_file("relocation cache", &address, B_ANY_ADDRESS,
+		st.st_size, B_READ_AREA, REGION_NO_PRIVATE_MAP, false, fd, 0);
+	_kern_close(fd);
+	if (sArea < 0)
+		return false;
+
+	const cache_header* header = (const cache_header*)address;
+	const cache_image* images = (const cache_image*)(header + 1);
+	sCachedEntries = (const cache_entry*)(images + sImageCount);
+
+	if (header->magic != kCacheMagic || header->version != kCacheVersion
+		|| header->image_count != sImageCount
+		|| (off_t)(sizeof(cache_header) + sImageCount * sizeof(cache_image)
+			+ (off_t)header->entry_count * sizeof(cache_entry))
+				> st.st_size) {
+		return false;
+	}
+
+	for (uint32 i = 0; i < sImageCount; i++) {
+		const cache_image& image = images[i];
+		const cache_image& info = sImageInfos[i];
+
+		if (image.device != info.device || image.node != info.node
+			|| image.modification_time != info.modification_time
+			|| image.size != info.size
+			|| image.symbol_count != info.symbol_count
+			|| image.first_entry > header->entry_count
+			|| image.entry_count > header->entry_count - image.first_entry) {
+			return false;
+		}
+
+		sImageInfos[i].first_entry = image.first_entry;
+		sImageInfos[i].entry_count = image.entry_count;
+	}
+
+	return true;
+}
+
+
+static void
+write_cache_file()
+{
+	char tempPath[B_PATH_NAME_LENGTH];
+	if (snprintf(tempPath, sizeof(tempPath), "%s.%" B_PRId32, sPath,
+			_kern_find_thread(NULL)) >= (int)sizeof(tempPath)) {
+		return;
+	}
+
+	int fd = _kern_open(-1, tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return;
+
+	cache_header header;
+	header.magic = kCacheMagic;
+	header.version = kCacheVersion;
+	header.image_count = sImageCount;
+	header.entry_count = sEntryCount;
+
+	size_t imagesSize = sImageCount * sizeof(cache_image);
+	size_t entriesSize = sEntryCount * sizeof(cache_entry);
+
+	bool success = _kern_write(fd, 0, &header, sizeof(header))
+			== (ssize_t)sizeof(header)
+		&& _kern_write(fd, -1, sImageInfos, imagesSize)
+			== (ssize_t)imagesSize
+		&& _kern_write(fd, -1, sEntries, entriesSize) == (ssize_t)entriesSize;
+
+	_kern_close(fd);
+
+	if (!success || _kern_rename(-1, tempPath, -1, sPath) != B_OK)
+		_kern_unlink(-1, tempPath);
+}
+
+
+// #pragma mark -
+
+
+/*!	Prepares the relocation cache for relocating \a programImage and all
+	currently loaded images. Must be called after all of them have been loaded,
+	but before any of them have been relocated.
+*/
+void
+relocation_cache_init(image_t* programImage)
+{
+	const char* directory = getenv("LD_RELOCATION_CACHE");
+	if (directory == NULL || directory[0] == '\0')
+		return;
+
+	sImageCount = count_loaded_images();
+	sImages = (image_t**)malloc(sImageCount * sizeof(image_t*));
+	sImageInfos = (cache_image*)malloc(sImageCount * sizeof(cache_image));
+	if (sImages == NULL || sImageInfos == NULL) {
+		relocation_cache_finish(false);
+		return;
+	}
+
+	int32 programIndex = -1;
+	uint32 count = 0;
+	for (image_t* image = get_loaded_images().head; image != NULL;
+			image = image->next) {
+		// Symbol patchers might resolve differently on every run
+		if (count == sImageCount || image->defined_symbol_patchers != NULL
+			|| image->undefined_symbol_patchers != NULL
+			|| !get_image_identity(image, sImageInfos[count])) {
+			relocation_cache_finish(false);
+			return;
+		}
+
+		if (image == programImage)
+			programIndex = count;
+		sImages[count++] = image;
+	}
+
+	if (programIndex < 0 || count != sImageCount
+		|| snprintf(sPath, sizeof(sPath), "%s/%" B_PRIdDEV "-%" B_PRIdINO,
+			directory, sImageInfos[programIndex].device,
+			sImageInfos[programIndex].node) >= (int)sizeof(sPath)) {
+		relocation_cache_finish(false);
+		return;
+	}
+
+	if (map_cache_file()) {
+		sState = CACHE_VALID;
+		return;
+	}
+
+	// the cache is missing or stale -- record a new one
+	if (sArea >= 0) {
+		_kern_delete_area(sArea);
+		sArea = -1;
+	}
+	sCachedEntries = NULL;
+
+	for (uint32 i = 0; i < sImageCount; i++) {
+		sImageInfos[i].first_entry = 0;
+		sImageInfos[i].entry_count = 0;
+	}
+
+	sState = CACHE_RECORDING;
+}
+
+
+/*!	Enters the cached symbol locations of \a image into \a cache.
+*/
+void
+relocation_cache_prefill(image_t* image, SymbolLookupCache* cache)
+{
+	if (sState != CACHE_VALID)
+		return;
+
+	int32 index = image_index(image);
+	if (index < 0)
+		return;
+
+	const cache_image& info = sImageInfos[index];
+	const cache_entry* entries = sCachedEntries + info.first_entry;
+
+	for (uint32 i = 0; i < info.entry_count; i++) {
+		const cache_entry& entry = entries[i];
+		if (entry.symbol >= info.symbol_count || entry.image >= sImageCount)
+			continue;
+
+		image_t* symbolImage = sImages[entry.image];
+		cache->SetSymbolValueAt(entry.symbol,
+			symbolImage->regions[0].delta + entry.offset, symbolImage);
+	}
+}
+
+
+/*!	Records the symbol locations \a cache has resolved for \a image after it
+	has been relocated.
+*/
+void
+relocation_cache_record(image_t* image, SymbolLookupCache* cache)
+{
+	if (sState != CACHE_RECORDING)
+		return;
+
+	int32 index = image_index(image);
+	if (index < 0)
+		return;
+
+	sImageInfos[index].first_entry = sEntryCount;
+
+	for (size_t i = 0; i < cache->TableSize(); i++) {
+		if (!cache->IsSymbolValueCached(i))
+			continue;
+
+		image_t* symbolImage;
+		addr_t location = cache->SymbolValueAt(i, &symbolImage);
+
+		// TLS symbols are not relative to the load address
+		if (symbolImage == NULL || image->syms[i].Type() == STT_TLS)
+			continue;
+
+		int32 symbolImageIndex = image_index(symbolImage);
+		if (symbolImageIndex < 0)
+			continue;
+
+		if (sEntryCount == sEntryCapacity) {
+			uint32 capacity = max_c(sEntryCapacity * 2, 1024);
+			cache_entry* entries = (cache_entry*)realloc(sEntries,
+				capacity * sizeof(cache_entry));
+			if (entries == NULL) {
+				sState = CACHE_DISABLED;
+				return;
+			}
+
+			sEntries = entries;
+			sEntryCapacity = capacity;
+		}
+
+		cache_entry& entry = sEntries[sEntryCount++];
+		entry.symbol = i;
+		entry.image = symbolImageIndex;
+		entry.offset = location - symbolImage->regions[0].delta;
+	}
+
+	sImageInfos[index].entry_count = sEntryCount
+		- sImageInfos[index].first_entry;
+}
+
+
+/*!	Writes the cache file, if it had to be recreated and \a success is
+	\c true, and frees all resources of the relocation cache.
+*/
+void
+relocation_cache_finish(bool success)
+{
+	if (sState == CACHE_RECORDING && success)
+		write_cache_file();
+
+	if (sArea >= 0)
+		_kern_delete_area(sArea);
+
+	free(sImages);
+	free(sImageInfos);
+	free(sEntries);
+
+	sState = CACHE_DISABLED;
+	sImages = NULL;
+	sImageInfos = NULL;
+	sImageCount = 0;
+	sArea = -1;
+	sCachedEntries = NULL;
+	sEntries = NULL;
+	sEntryCount = 0;
+	sEntryCapacity = 0;
+}
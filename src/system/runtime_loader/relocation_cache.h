@@ -0,0 +1,17 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef RELOCATION_CACHE_H
+#define RELOCATION_CACHE_H
+
+#include "runtime_loader_private.h"
+
+
+void	relocation_cache_init(image_t* programImage);
+void	relocation_cache_prefill(image_t* image, SymbolLookupCache* cache);
+void	relocation_cache_record(image_t* image, SymbolLookupCache* cache);
+void	relocation_cache_finish(bool success);
+
+
+#endif	// RELOCATION_CACHE_H
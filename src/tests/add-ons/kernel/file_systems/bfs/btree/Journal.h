@@ -43,6 +43,13 @@ class Transaction {
 		{
 		}
 
+		Transaction()
+			:
+			fVolume(NULL),
+			fID(-1)
+		{
+		}
+
 		~Transaction()
 		{
 		}
@@ -67,9 +74,16 @@ class Transaction {
 
 		status_t Start(Volume* volume, off_t refBlock)
 		{
+			fVolume = volume;
+			fID = volume->GenerateTransactionID();
 			return B_OK;
 		}
 
+		void Abort()
+		{
+			NotifyListeners(false);
+		}
+
 
 		status_t Done()
 		{
@@ -398,6 +398,65 @@ checkTreeIntegrity(BPlusTree* tree)
 }
 
 
+/*!	Checks the estimates of the tree for single keys: they are within a
+	single leaf, and must therefore be exact, unless the key has so many
+	duplicates that only the first of them are counted.
+*/
+void
+checkEstimates(BPlusTree* tree)
+{
+	if (!gExcessive)
+		printf("* Check estimates...\n");
+
+	int32 step = max_c(1, gNum / 100);
+	for (int32 i = 0; i < gNum; i += step) {
+		uint8* data = (uint8*)gKeys[i].data;
+		uint16 length = gKeys[i].length;
+
+		off_t expected = 0;
+		for (int32 j = 0; j < gNum; j++) {
+			if (gKeys[j].length == length
+				&& !memcmp(gKeys[j].data, data, length))
+				expected += gKeys[j].in;
+		}
+
+		off_t count;
+		status_t status = tree->EstimateRange(data, length, true, data,
+			length, true, count);
+		if (status != B_OK) {
+			printf("BPlusTree::EstimateRange() returned: %s\n",
+				strerror(status));
+			bailOutWithKey(data, length);
+		}
+		if ((count == 0) != (expected == 0) || count > expected
+			|| (expected <= NUM_DUPLICATE_VALUES && count != expected)) {
+			printf("BPlusTree::EstimateRange() found %Ld instead of %Ld "
+				"entries for key ", count, expected);
+			bailOutWithKey(data, length);
+		}
+
+		// a range that excludes its only key is empty
+		status = tree->EstimateRange(data, length, false, data, length, true,
+			count);
+		if (status != B_OK || count != 0) {
+			printf("BPlusTree::EstimateRange() found %Ld entries in an "
+				"empty range: %s\n", count, strerror(status));
+			bailOutWithKey(data, length);
+		}
+	}
+
+	off_t count;
+	status_t status = tree->EstimateRange(NULL, 0, true, NULL, 0, true,
+		count);
+	if (status != B_OK || (count == 0) != (gTreeCount == 0)) {
+		printf("BPlusTree::EstimateRange() estimated %Ld entries for the "
+			"whole tree with %ld entries: %s\n", count, gTreeCount,
+			strerror(status));
+		bailOut();
+	}
+}
+
+
 void
 checkTree(BPlusTree* tree)
 {
@@ -406,6 +465,7 @@ checkTree(BPlusTree* tree)
 
 	checkTreeContents(tree);
 	checkTreeIntegrity(tree);
+	checkEstimates(tree);
 
 	bool errorsFound = false;
 	tree->Validate(false, errorsFound);
@@ -612,6 +672,67 @@ removeRandomSet(Transaction& transaction, BPlusTree* tree, int32 num)
 }
 
 
+/*!	Builds the tree from all keys at once using a TreeBuilder. Keys that
+	don't fit into the memory budget are inserted one by one, like the index
+	rebuild of checkfs does it.
+*/
+void
+bulkLoadTest(Transaction& transaction, BPlusTree* tree, size_t memoryBudget)
+{
+	printf("*** Bulk loading all keys into the tree (%lu bytes budget)...\n",
+		memoryBudget);
+
+	// the builder only works on empty trees
+	status_t status = tree->MakeEmpty();
+	if (status != B_OK) {
+		printf("BPlusTree::MakeEmpty() returned: %s\n", strerror(status));
+		bailOut();
+	}
+
+	TreeBuilder builder(tree, &memoryBudget);
+	status = builder.InitCheck();
+	if (status != B_OK) {
+		printf("TreeBuilder::InitCheck() returned: %s\n", strerror(status));
+		bailOut();
+	}
+
+	int32 i = 0;
+	for (; i < gNum; i++) {
+		status = builder.Add((uint8*)gKeys[i].data, gKeys[i].length,
+			gKeys[i].value);
+		if (status == B_NO_MEMORY)
+			break;
+		if (status != B_OK) {
+			printf("TreeBuilder::Add() returned: %s\n", strerror(status));
+			bailOutWithKey(gKeys[i].data, gKeys[i].length);
+		}
+
+		gKeys[i].in++;
+		gTreeCount++;
+	}
+
+	status = builder.Finish();
+	if (status != B_OK) {
+		printf("TreeBuilder::Finish() returned: %s\n", strerror(status));
+		bailOut();
+	}
+
+	for (; i < gNum; i++) {
+		status = tree->Insert(transaction, (uint8*)gKeys[i].data,
+			gKeys[i].length, gKeys[i].value);
+		if (status != B_OK) {
+			printf("BPlusTree::Insert() returned: %s\n", strerror(status));
+			bailOutWithKey(gKeys[i].data, gKeys[i].length);
+		}
+
+		gKeys[i].in++;
+		gTreeCount++;
+	}
+
+	checkTree(tree);
+}
+
+
 //	#pragma mark -
 
 
@@ -766,6 +887,13 @@ main(int argc, char** argv)
 		}
 
 		removeAllKeys(transaction, &tree);
+
+		bulkLoadTest(transaction, &tree, TreeBuilder::kMaxMemory);
+		removeAllKeys(transaction, &tree);
+
+		// only part of the keys fit, the rest is inserted into the tree
+		bulkLoadTest(transaction, &tree, 65536 + gNum / 2 * sizeof(void*));
+		removeAllKeys(transaction, &tree);
 	}
 
 	transaction.Done();
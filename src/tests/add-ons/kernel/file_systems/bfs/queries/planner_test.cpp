@@ -0,0 +1,208 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+//!	Tests the results of queries that the BFS query planner handles specially
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <Directory.h>
+#include <File.h>
+#include <fs_index.h>
+#include <fs_info.h>
+#include <fs_query.h>
+
+
+static const char* kValueAttribute = "BFSPlannerTest:value";
+static const char* kGroupAttribute = "BFSPlannerTest:group";
+static const char* kDirectory = "_planner_test";
+static const int32 kFileCount = 400;
+static const int32 kGroupCount = 40;
+
+static dev_t sDevice;
+static int32 sFailures;
+
+
+static bool
+create_index(const char* name)
+{
+	if (fs_create_index(sDevice, name, B_INT32_TYPE, 0) != 0
+		&& errno != B_FILE_EXISTS) {
+		fprintf(stderr, "Could not create index \"%s\": %s\n", name,
+			strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+
+static bool
+create_files()
+{
+	if (create_directory(kDirectory, 0755) != B_OK)
+		return false;
+
+	for (int32 i = 0; i < kFileCount; i++) {
+		char name[B_PATH_NAME_LENGTH];
+		snprintf(name, sizeof(name), "%s/file%" B_PRId32, kDirectory, i);
+
+		BFile file(name, B_CREATE_FILE | B_WRITE_ONLY);
+		if (file.InitCheck() != B_OK) {
+			fprintf(stderr, "Could not create \"%s\": %s\n", name,
+				strerror(file.InitCheck()));
+			return false;
+		}
+
+		int32 group = i % kGroupCount;
+		if (file.WriteAttr(kValueAttribute, B_INT32_TYPE, 0, &i, sizeof(i))
+				!= sizeof(i)
+			|| file.WriteAttr(kGroupAttribute, B_INT32_TYPE, 0, &group,
+				sizeof(group)) != sizeof(group)) {
+			fprintf(stderr, "Could not write attributes of \"%s\"\n", name);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+static void
+remove_files()
+{
+	for (int32 i = 0; i < kFileCount; i++) {
+		char name[B_PATH_NAME_LENGTH];
+		snprintf(name, sizeof(name), "%s/file%" B_PRId32, kDirectory, i);
+		remove(name);
+	}
+	remove(kDirectory);
+
+	fs_remove_index(sDevice, kValueAttribute);
+	fs_remove_index(sDevice, kGroupAttribute);
+}
+
+
+/*!	Runs the query, and checks that it returns every file for which
+	\a matches returns true exactly once, and no other file.
+*/
+static void
+test_query(const char* name, const char* predicate, bool (*matches)(int32))
+{
+	int32 found[kFileCount];
+	memset(found, 0, sizeof(found));
+
+	DIR* query = fs_open_query(sDevice, predicate, 0);
+	if (query == NULL) {
+		printf("%s: could not open query: %s\n", name, strerror(errno));
+		sFailures++;
+		return;
+	}
+
+	bool failed = false;
+	while (struct dirent* dirent = fs_read_query(query)) {
+		int32 index;
+		if (sscanf(dirent->d_name, "file%" B_SCNd32, &index) != 1
+			|| index < 0 || index >= kFileCount) {
+			printf("%s: unexpected entry \"%s\"\n", name, dirent->d_name);
+			failed = true;
+			continue;
+		}
+
+		found[index]++;
+	}
+	fs_close_query(query);
+
+	for (int32 i = 0; i < kFileCount; i++) {
+		int32 expected = matches(i) ? 1 : 0;
+		if (found[i] != expected) {
+			printf("%s: file%" B_PRId32 " found %" B_PRId32 " times, "
+				"expected %" B_PRId32 "\n", name, i, found[i], expected);
+			failed = true;
+		}
+	}
+
+	printf("%s: %s\n", name, failed ? "FAILED" : "ok");
+	if (failed)
+		sFailures++;
+}
+
+
+static bool
+overlapping_or(int32 i)
+{
+	return i < 30 || (i >= 20 && i < 50);
+}
+
+
+static bool
+empty_or_branch(int32 i)
+{
+	return i < 5;
+}
+
+
+static bool
+empty_and(int32 i)
+{
+	return false;
+}
+
+
+static bool
+filtered_and(int32 i)
+{
+	return (i < 40 || i >= 380) && i % kGroupCount < 30;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	sDevice = dev_for_path(".");
+
+	fs_info info;
+	if (fs_stat_dev(sDevice, &info) != 0
+		|| strcmp(info.fsh_name, "bfs") != 0) {
+		fprintf(stderr, "The current directory must be on a BFS volume.\n");
+		return 1;
+	}
+
+	if (!create_index(kValueAttribute) || !create_index(kGroupAttribute)
+		|| !create_files()) {
+		remove_files();
+		return 1;
+	}
+
+	// Entries matching both branches of an OR are only returned once
+	test_query("OR de-duplication",
+		"(BFSPlannerTest:value<30)||((BFSPlannerTest:value>=20)"
+			"&&(BFSPlannerTest:value<50))", &overlapping_or);
+
+	// Terms that are estimated to match nothing are skipped, without losing
+	// any entries of the others
+	test_query("empty OR branch",
+		"(BFSPlannerTest:value==1000)||(BFSPlannerTest:value<5)",
+		&empty_or_branch);
+	test_query("empty AND",
+		"(BFSPlannerTest:value>=0)&&(BFSPlannerTest:value==1000)",
+		&empty_and);
+
+	// The OR is iterated, and its first branch is large enough to be
+	// filtered by the IDs of its AND partner
+	test_query("AND filter",
+		"((BFSPlannerTest:value<40)||(BFSPlannerTest:value>=380))"
+			"&&(BFSPlannerTest:group<30)", &filtered_and);
+
+	remove_files();
+
+	if (sFailures > 0) {
+		printf("%" B_PRId32 " test(s) failed.\n", sFailures);
+		return 1;
+	}
+	return 0;
+}
@@ -26,20 +26,27 @@ const off_t kDefaultFileSize = 4096;
 static void
 usage(int status)
 {
-	printf("usage: %s [--files <num-of-files>] [--size <file-size>]\n",
-		kProgramName);
+	printf("usage: %s [--files <num-of-files>] [--size <file-size>]\n"
+		"\t[--append <chunk-size>] [--read]\n", kProgramName);
 	printf("options:\n");
-	printf("  -f  --files  Number of files to be created. Defaults to as "
+	printf("  -f  --files   Number of files to be created. Defaults to as "
 		"many as fit.\n");
-	printf("  -s  --size   Size of each file. Defaults to %lldKB.\n",
+	printf("  -s  --size    Size of each file. Defaults to %lldKB.\n",
 		kDefaultFileSize / 1024);
+	printf("  -a  --append  Write the files in chunks of the given size, "
+		"alternating\n"
+		"                between each file and its temporary companion.\n");
+	printf("  -r  --read    Read back the remaining files, and report the "
+		"throughput\n"
+		"                (unless the file cache is flushed, it will "
+		"contribute).\n");
 
 	exit(status);
 }
 
 
-static bool
-create_file(int32_t i, const char* suffix, const char* buffer, size_t size)
+static int
+open_file(int32_t i, const char* suffix)
 {
 	char name[64];
 	snprintf(name, sizeof(name), "fragments/%06d%s", i, suffix);
@@ -48,25 +55,99 @@ create_file(int32_t i, const char* suffix, const char* buffer, size_t size)
 	if (fd < 0) {
 		fprintf(stderr, "%s: Could not create file %d: %s\n", kProgramName,
 			i, strerror(errno));
-		return false;
 	}
 
+	return fd;
+}
+
+
+static bool
+write_chunk(int fd, int32_t i, const char* buffer, size_t size)
+{
 	if (write(fd, buffer, size) < (ssize_t)size) {
 		fprintf(stderr, "%s: Could not write file %d: %s\n", kProgramName,
 			i, strerror(errno));
 		return false;
 	}
 
-	close(fd);
 	return true;
 }
 
 
+/*!	Creates the file with the given index, and its temporary companion that
+	will be removed later on. If \a chunkSize is smaller than \a size, both
+	files grow in turns, which is how files end up fragmented when their
+	space is allocated as they are written.
+*/
+static bool
+create_files(int32_t i, const char* buffer, size_t size, size_t chunkSize)
+{
+	int fd = open_file(i, "");
+	if (fd < 0)
+		return false;
+
+	int removeFD = open_file(i, ".remove");
+	if (removeFD < 0) {
+		close(fd);
+		return false;
+	}
+
+	bool success = true;
+	for (size_t offset = 0; success && offset < size; offset += chunkSize) {
+		size_t length = size - offset < chunkSize ? size - offset : chunkSize;
+
+		success = write_chunk(fd, i, buffer + offset, length)
+			&& write_chunk(removeFD, i, buffer + offset, length);
+	}
+
+	close(fd);
+	close(removeFD);
+	return success;
+}
+
+
+static void
+read_files(int32_t count, char* buffer, size_t size)
+{
+	printf("Reading %d files...\n", count);
+
+	off_t bytesRead = 0;
+	bigtime_t startTime = system_time();
+
+	for (int32_t i = 0; i < count; i++) {
+		char name[64];
+		snprintf(name, sizeof(name), "fragments/%06d", i);
+
+		int fd = open(name, O_RDONLY);
+		if (fd < 0) {
+			fprintf(stderr, "%s: Could not open file %d: %s\n",
+				kProgramName, i, strerror(errno));
+			continue;
+		}
+
+		ssize_t bytes;
+		while ((bytes = read(fd, buffer, size)) > 0)
+			bytesRead += bytes;
+
+		close(fd);
+	}
+
+	bigtime_t time = system_time() - startTime;
+	if (time == 0)
+		time = 1;
+
+	printf("Read %lld KB in %g seconds (%g MB/s).\n", bytesRead / 1024,
+		time / 1000000.0, bytesRead / (time / 1000000.0) / (1024 * 1024));
+}
+
+
 int
 main(int argc, char** argv)
 {
 	int32_t numFiles = kDefaultFiles;
 	off_t fileSize = kDefaultFileSize;
+	off_t chunkSize = 0;
+	bool readFiles = false;
 
 	int optionIndex = 0;
 	int opt;
@@ -74,11 +155,13 @@ main(int argc, char** argv)
 		{"help", no_argument, 0, 'h'},
 		{"size", required_argument, 0, 's'},
 		{"files", required_argument, 0, 'f'},
+		{"append", required_argument, 0, 'a'},
+		{"read", no_argument, 0, 'r'},
 		{0, 0, 0, 0}
 	};
 
 	do {
-		opt = getopt_long(argc, argv, "hs:f:", longOptions, &optionIndex);
+		opt = getopt_long(argc, argv, "hs:f:a:r", longOptions, &optionIndex);
 		switch (opt) {
 			case -1:
 				// end of arguments, do nothing
@@ -92,6 +175,14 @@ main(int argc, char** argv)
 				fileSize = strtoul(optarg, NULL, 0);
 				break;
 
+			case 'a':
+				chunkSize = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'r':
+				readFiles = true;
+				break;
+
 			case 'h':
 			default:
 				usage(0);
@@ -99,6 +190,9 @@ main(int argc, char** argv)
 		}
 	} while (opt != -1);
 
+	if (chunkSize <= 0 || chunkSize > fileSize)
+		chunkSize = fileSize;
+
 	// fill buffer
 
 	char* buffer = (char*)malloc(fileSize);
@@ -124,8 +218,7 @@ main(int argc, char** argv)
 	bigtime_t lastTime = 0;
 
 	for (int32_t i = 0; i < numFiles || numFiles < 0; i++) {
-		if (!create_file(i, "", buffer, fileSize)
-			|| !create_file(i, ".remove", buffer, fileSize))
+		if (!create_files(i, buffer, fileSize, chunkSize))
 			break;
 
 		filesCreated++;
@@ -136,8 +229,6 @@ main(int argc, char** argv)
 		}
 	}
 
-	free(buffer);
-
 	// delete fragmentation files
 
 	printf("Deleting %d temporary files...\n", filesCreated);
@@ -160,5 +251,9 @@ main(int argc, char** argv)
 	printf("          \33[1A\n");
 		// delete progress count
 
+	if (readFiles)
+		read_files(filesCreated, buffer, fileSize);
+
+	free(buffer);
 	return 0;
 }
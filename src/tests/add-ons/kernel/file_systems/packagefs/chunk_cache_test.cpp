@@ -0,0 +1,245 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "ChunkCache.cpp"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+
+#define TEST_ASSERT(statement) \
+	if (!(statement)) { \
+		error(__LINE__, "Assertion failed: " #statement); \
+	}
+
+
+static const size_t kChunkSize = ChunkCache::kChunkSize;
+
+static low_resource_func sLowResourceHandler;
+static void* sLowResourceData;
+static int32 sLowResourceState = B_NO_LOW_RESOURCE;
+
+static ChunkCache* sCache;
+static size_t sMaxChunks;
+
+
+// The low resource manager of the kernelland emulation does nothing; these
+// replace it, so that the tests can control the memory situation.
+
+extern "C" int32
+low_resource_state(uint32 resources)
+{
+	return sLowResourceState;
+}
+
+
+extern "C" status_t
+register_low_resource_handler(low_resource_func function, void* data,
+	uint32 resources, int32 priority)
+{
+	sLowResourceHandler = function;
+	sLowResourceData = data;
+	return B_OK;
+}
+
+
+static void
+error(int32 line, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+
+	fprintf(stderr, "ERROR IN TEST LINE %" B_PRId32 ": ", line);
+	vfprintf(stderr, format, args);
+	fprintf(stderr, "\n");
+
+	va_end(args);
+
+	exit(1);
+}
+
+
+static void
+add_chunk(ChunkCacheOwner* owner, off_t index, bool prefetched = false)
+{
+	CachedChunk* chunk = sCache->Allocate(owner, index * kChunkSize,
+		kChunkSize, prefetched);
+	if (chunk == NULL)
+		error(__LINE__, "Could not allocate chunk %" B_PRIdOFF, index);
+
+	sCache->Put(sCache->Publish(chunk));
+}
+
+
+static bool
+use_chunk(ChunkCacheOwner* owner, off_t index)
+{
+	CachedChunk* chunk = sCache->Get(owner, index * kChunkSize);
+	if (chunk == NULL)
+		return false;
+
+	sCache->Put(chunk);
+	return true;
+}
+
+
+static void
+set_low_resource_state(int32 level)
+{
+	sLowResourceState = level;
+	if (level != B_NO_LOW_RESOURCE)
+		sLowResourceHandler(sLowResourceData, B_KERNEL_RESOURCE_PAGES, level);
+}
+
+
+//	#pragma mark - tests
+
+
+static void
+test_scan_resistance()
+{
+	ChunkCacheOwner owner;
+	sCache->RegisterOwner(&owner);
+
+	// chunks that are used twice are protected
+	static const off_t kHotChunks = 8;
+	for (off_t i = 0; i < kHotChunks; i++) {
+		add_chunk(&owner, i);
+		bool used = use_chunk(&owner, i);
+		TEST_ASSERT(used);
+	}
+
+	// a scan through many more chunks than fit must not push them out
+	for (off_t i = kHotChunks; i < kHotChunks + 4 * (off_t)sMaxChunks; i++)
+		add_chunk(&owner, i);
+
+	TEST_ASSERT(owner.chunkCount == sMaxChunks);
+	for (off_t i = 0; i < kHotChunks; i++) {
+		bool contained = sCache->Contains(&owner, i * kChunkSize);
+		TEST_ASSERT(contained);
+	}
+
+	// the scan did not become protected, and the oldest of it is gone
+	bool contained = sCache->Contains(&owner, kHotChunks * kChunkSize);
+	TEST_ASSERT(!contained);
+
+	sCache->UnregisterOwner(&owner);
+	puts("scan resistance: ok");
+}
+
+
+static void
+test_protected_limit()
+{
+	ChunkCacheOwner owner;
+	sCache->RegisterOwner(&owner);
+
+	for (off_t i = 0; i < (off_t)sMaxChunks; i++) {
+		add_chunk(&owner, i);
+		use_chunk(&owner, i);
+	}
+
+	// even if all chunks were used twice, new chunks must find room on
+	// probation
+	off_t freshCount = sMaxChunks / 4;
+	for (off_t i = sMaxChunks; i < (off_t)sMaxChunks + freshCount; i++)
+		add_chunk(&owner, i);
+
+	for (off_t i = sMaxChunks; i < (off_t)sMaxChunks + freshCount; i++) {
+		bool contained = sCache->Contains(&owner, i * kChunkSize);
+		TEST_ASSERT(contained);
+	}
+
+	sCache->UnregisterOwner(&owner);
+	puts("protected limit: ok");
+}
+
+
+static void
+test_prefetch()
+{
+	ChunkCacheOwner owner;
+	sCache->RegisterOwner(&owner);
+
+	add_chunk(&owner, 0, true);
+
+	// the first hit of a prefetched chunk is its first use
+	CachedChunk* chunk = sCache->Get(&owner, 0);
+	TEST_ASSERT(chunk != NULL);
+	TEST_ASSERT(!chunk->isProtected);
+	sCache->Put(chunk);
+
+	chunk = sCache->Get(&owner, 0);
+	TEST_ASSERT(chunk != NULL);
+	TEST_ASSERT(chunk->isProtected);
+	sCache->Put(chunk);
+
+	TEST_ASSERT(owner.hits == 2);
+
+	sCache->UnregisterOwner(&owner);
+	puts("prefetch: ok");
+}
+
+
+static void
+test_budget()
+{
+	ChunkCacheOwner owner;
+	sCache->RegisterOwner(&owner);
+
+	for (off_t i = 0; i < (off_t)sMaxChunks; i++)
+		add_chunk(&owner, i);
+	TEST_ASSERT(owner.chunkCount == sMaxChunks);
+
+	// a critical memory shortage empties the cache
+	set_low_resource_state(B_LOW_RESOURCE_CRITICAL);
+	TEST_ASSERT(owner.chunkCount == 0);
+
+	CachedChunk* chunk = sCache->Allocate(&owner, 0, kChunkSize);
+	TEST_ASSERT(chunk == NULL);
+
+	// when the shortage eases, the budget grows back when allocating
+	sLowResourceState = B_LOW_RESOURCE_NOTE;
+	for (off_t i = 0; i < (off_t)sMaxChunks; i++)
+		add_chunk(&owner, i);
+	TEST_ASSERT(owner.chunkCount == sMaxChunks / 2);
+
+	sLowResourceState = B_NO_LOW_RESOURCE;
+	for (off_t i = 0; i < (off_t)sMaxChunks; i++)
+		add_chunk(&owner, i);
+	TEST_ASSERT(owner.chunkCount == sMaxChunks);
+
+	// a warning shrinks the cache to its new budget right away
+	set_low_resource_state(B_LOW_RESOURCE_WARNING);
+	TEST_ASSERT(owner.chunkCount == sMaxChunks / 8);
+	sLowResourceState = B_NO_LOW_RESOURCE;
+
+	sCache->UnregisterOwner(&owner);
+	puts("budget: ok");
+}
+
+
+int
+main(int argc, char** argv)
+{
+	if (ChunkCache::CreateDefault() != B_OK) {
+		fprintf(stderr, "Could not create the chunk cache\n");
+		return 1;
+	}
+
+	sCache = ChunkCache::Default();
+	sMaxChunks = std::min(kMaxBudget,
+		(size_t)vm_page_num_pages() * B_PAGE_SIZE / kPhysicalMemoryFraction)
+		/ kChunkSize;
+
+	test_scan_resistance();
+	test_protected_limit();
+	test_prefetch();
+	test_budget();
+
+	ChunkCache::DeleteDefault();
+	return 0;
+}
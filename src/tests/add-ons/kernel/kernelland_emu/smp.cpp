@@ -7,6 +7,8 @@
 //!	This is only needed for the debug build.
 
 
+#include <OS.h>
+
 #include <cpu.h>
 #include <smp.h>
 
@@ -25,6 +27,20 @@ acquire_spinlock(spinlock* lock)
 }
 
 
+extern "C" int32
+smp_get_num_cpus()
+{
+	static int32 sCPUCount = 0;
+	if (sCPUCount == 0) {
+		system_info info;
+		get_system_info(&info);
+		sCPUCount = max_c(1, min_c((int32)info.cpu_count,
+			(int32)(sizeof(gCPU) / sizeof(gCPU[0]))));
+	}
+	return sCPUCount;
+}
+
+
 extern "C" int32
 smp_get_current_cpu()
 {
@@ -74,6 +74,37 @@ dump(const char* text = "")
 }
 
 
+void
+test_sack_blocks()
+{
+	BufferQueue queue(32768);
+	queue.SetInitialSequence(1000);
+	queue.Add(create_filled_buffer(100), 1000);
+	queue.Add(create_filled_buffer(100), 1200);
+	queue.Add(create_filled_buffer(100), 1300);
+	queue.Add(create_filled_buffer(100), 1500);
+	queue.Add(create_filled_buffer(100), 1700);
+
+	// the most recent block first, then the others from the top
+	tcp_sack sacks[4];
+	int32 count = queue.GetSackBlocks(sacks, 4, 1500);
+	ASSERT(count == 3);
+	ASSERT(sacks[0].left_edge == 1500 && sacks[0].right_edge == 1600);
+	ASSERT(sacks[1].left_edge == 1700 && sacks[1].right_edge == 1800);
+	ASSERT(sacks[2].left_edge == 1200 && sacks[2].right_edge == 1400);
+
+	count = queue.GetSackBlocks(sacks, 2, 1300);
+	ASSERT(count == 2);
+	ASSERT(sacks[0].left_edge == 1200 && sacks[1].left_edge == 1700);
+
+	queue.Add(create_filled_buffer(200), 1100);
+	count = queue.GetSackBlocks(sacks, 4, 1100);
+	ASSERT(count == 2);
+	ASSERT(sacks[0].left_edge == 1700 && sacks[1].left_edge == 1500);
+	printf("sack blocks: ok\n");
+}
+
+
 int
 main()
 {
@@ -140,6 +171,8 @@ main()
 	add(500, 1000);
 	dump("added data covered by next");
 
+	test_sack_blocks();
+
 	put_module(NET_BUFFER_MODULE_NAME);
 	return 0;
 }
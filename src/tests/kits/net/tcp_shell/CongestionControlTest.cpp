@@ -0,0 +1,215 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "CongestionControl.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+static const uint32 kSegmentSize = 1000;
+
+
+/*!	Simulates a connection with the given bottleneck \a bandwidth (bytes per
+	msec), and round trip time without queueing, that keeps its congestion
+	window filled for \a rounds round trips.
+*/
+struct Path {
+	Path(const char* name, uint32 bandwidth, bigtime_t roundTrip)
+		:
+		congestionWindow(10 * kSegmentSize),
+		slowStartThreshold(UINT32_MAX),
+		control(NULL),
+		bandwidth(bandwidth),
+		roundTrip(roundTrip),
+		now(1000000),
+		acknowledged(1),
+		minWindow(UINT32_MAX)
+	{
+		status_t status = create_congestion_control(name, congestionWindow,
+			slowStartThreshold, &control);
+		ASSERT(status == B_OK);
+		control->Init(kSegmentSize);
+	}
+
+	~Path()
+	{
+		delete control;
+	}
+
+	void Run(uint32 rounds)
+	{
+		for (uint32 round = 0; round < rounds; round++) {
+			uint32 window = congestionWindow;
+			tcp_sequence sendMax = acknowledged + window;
+
+			// a window larger than the bandwidth delay product is queued
+			bigtime_t duration = max_c(roundTrip,
+				(bigtime_t)window * 1000 / bandwidth);
+			uint32 count = window / kSegmentSize;
+
+			for (uint32 i = 0; i < count; i++) {
+				acknowledged += kSegmentSize;
+
+				tcp_ack_sample sample;
+				sample.now = now + duration * (i + 1) / count;
+				sample.bytes_acknowledged = kSegmentSize;
+				sample.flight_size = (sendMax - acknowledged).Number();
+				sample.round_trip_time = duration;
+				sample.smoothed_round_trip_time = duration;
+				sample.acknowledge = acknowledged;
+				sample.send_max = sendMax;
+				sample.in_recovery = false;
+				control->Acknowledged(sample);
+			}
+
+			now += duration;
+			minWindow = min_c(minWindow, congestionWindow);
+		}
+	}
+
+	uint32				congestionWindow;
+	uint32				slowStartThreshold;
+	CongestionControl*	control;
+	uint32				bandwidth;
+	bigtime_t			roundTrip;
+	bigtime_t			now;
+	tcp_sequence		acknowledged;
+	uint32				minWindow;
+};
+
+
+static void
+test_new_reno()
+{
+	Path path("newreno", 100000, 100000);
+	ASSERT(strcmp(path.control->Name(), "newreno") == 0);
+	ASSERT(path.control->PacingRate() == 0);
+
+	// slow start doubles the window per round trip
+	path.Run(2);
+	ASSERT(path.congestionWindow == 40 * kSegmentSize);
+
+	path.control->EnterRecovery(40 * kSegmentSize);
+	ASSERT(path.slowStartThreshold == 20 * kSegmentSize);
+	ASSERT(path.congestionWindow == 20 * kSegmentSize);
+
+	// congestion avoidance adds a segment per round trip
+	path.Run(10);
+	ASSERT(path.congestionWindow >= 29 * kSegmentSize
+		&& path.congestionWindow <= 31 * kSegmentSize);
+
+	path.control->RetransmitTimeout(30 * kSegmentSize);
+	ASSERT(path.slowStartThreshold == 15 * kSegmentSize);
+	ASSERT(path.congestionWindow == kSegmentSize);
+	puts("newreno: ok");
+}
+
+
+static void
+test_cubic()
+{
+	Path path("cubic", 100000, 100000);
+	path.Run(4);
+	ASSERT(path.congestionWindow == 160 * kSegmentSize);
+
+	path.control->EnterRecovery(100 * kSegmentSize);
+	ASSERT(path.slowStartThreshold == 70 * kSegmentSize);
+	ASSERT(path.congestionWindow == 70 * kSegmentSize);
+
+	// the window of the loss is reached again after K = cbrt((160 - 70)
+	// / 0.4) = 6.1 secs, where it stays for a while
+	path.Run(45);
+	ASSERT(path.congestionWindow > 150 * kSegmentSize
+		&& path.congestionWindow < 160 * kSegmentSize);
+	path.Run(10);
+	ASSERT(path.congestionWindow > 155 * kSegmentSize
+		&& path.congestionWindow < 165 * kSegmentSize);
+
+	// then it probes for more bandwidth; NewReno would not even have
+	// reached the window of the loss again by now
+	path.Run(65);
+	ASSERT(path.congestionWindow > 200 * kSegmentSize);
+
+	// fast convergence: losing again below the last maximum lowers it
+	uint32 window = path.congestionWindow;
+	path.control->EnterRecovery(window);
+	ASSERT(path.congestionWindow == window * 7 / 10);
+	path.control->EnterRecovery(path.congestionWindow);
+	path.Run(60);
+	ASSERT(path.congestionWindow < window);
+	puts("cubic: ok");
+}
+
+
+static void
+test_bbr()
+{
+	// 10 MB/s and 20 msecs make a bandwidth delay product of 200 KB
+	Path path("bbr", 10000, 20000);
+	uint32 delayProduct = 200 * kSegmentSize;
+	path.Run(40);
+
+	ASSERT(path.congestionWindow > delayProduct * 18 / 10
+		&& path.congestionWindow < delayProduct * 22 / 10);
+	uint64 pacingRate = path.control->PacingRate();
+	ASSERT(pacingRate > 7000000 && pacingRate < 13000000);
+
+	// losses don't reduce the window for long
+	uint32 window = path.congestionWindow;
+	path.control->EnterRecovery(window / 2);
+	ASSERT(path.congestionWindow == window / 2);
+	path.control->ExitRecovery(window / 2);
+	ASSERT(path.congestionWindow == window);
+
+	// the round trip time is probed for with a minimal window every
+	// 10 secs
+	path.minWindow = UINT32_MAX;
+	path.Run(300);
+	ASSERT(path.minWindow == 4 * kSegmentSize);
+	ASSERT(path.congestionWindow > delayProduct * 18 / 10
+		&& path.congestionWindow < delayProduct * 22 / 10);
+	puts("bbr: ok");
+}
+
+
+static void
+test_default()
+{
+	uint32 congestionWindow = 0;
+	uint32 slowStartThreshold = 0;
+	CongestionControl* control;
+	ASSERT(strcmp(default_congestion_control(), "newreno") == 0);
+	status_t status = create_congestion_control("unknown", congestionWindow,
+		slowStartThreshold, &control);
+	ASSERT(status == B_NAME_NOT_FOUND);
+	status = set_default_congestion_control("unknown");
+	ASSERT(status == B_NAME_NOT_FOUND);
+
+	status = set_default_congestion_control("bbr");
+	ASSERT(status == B_OK);
+	status = create_congestion_control(NULL, congestionWindow,
+		slowStartThreshold, &control);
+	ASSERT(status == B_OK);
+	ASSERT(strcmp(control->Name(), "bbr") == 0);
+	delete control;
+
+	status = set_default_congestion_control("newreno");
+	ASSERT(status == B_OK);
+	ASSERT(strcmp(default_congestion_control(), "newreno") == 0);
+	puts("default: ok");
+}
+
+
+int
+main()
+{
+	test_new_reno();
+	test_cubic();
+	test_bbr();
+	test_default();
+	return 0;
+}
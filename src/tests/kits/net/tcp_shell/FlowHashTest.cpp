@@ -0,0 +1,204 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "utility.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <net_buffer.h>
+#include <net_socket.h>
+
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+
+
+extern "C" status_t _add_builtin_module(module_info *info);
+
+extern struct net_buffer_module_info gNetBufferModule;
+	// from net_buffer.cpp
+
+struct net_socket_module_info gNetSocketModule;
+struct net_buffer_module_info* gBufferModule;
+
+
+struct hash_vector {
+	int			family;
+	uint8		source[16];
+	uint8		destination[16];
+	uint16		source_port;
+	uint16		destination_port;
+	uint32		address_hash;
+	uint32		port_hash;
+};
+
+// The verification vectors of receive side scaling for its default key
+static const hash_vector kVectors[] = {
+	{ AF_INET, { 66, 9, 149, 187 }, { 161, 142, 100, 80 }, 2794, 1766,
+		0x323e8fc2, 0x51ccc178 },
+	{ AF_INET, { 199, 92, 111, 2 }, { 65, 69, 140, 83 }, 14230, 4739,
+		0xd718262a, 0xc626b0ea },
+	{ AF_INET, { 24, 19, 198, 95 }, { 12, 22, 207, 184 }, 12898, 38024,
+		0xd2d0a5de, 0x5c2b394a },
+	{ AF_INET, { 38, 27, 205, 30 }, { 209, 142, 163, 6 }, 48228, 2217,
+		0x82989176, 0xafc7327f },
+	{ AF_INET, { 153, 39, 163, 191 }, { 202, 188, 127, 2 }, 44251, 1303,
+		0x5d1809c5, 0x10e828a2 },
+	{ AF_INET6,
+		{ 0x3f, 0xfe, 0x25, 0x01, 0x02, 0x00, 0x1f, 0xff,
+			0, 0, 0, 0, 0, 0, 0, 0x07 },
+		{ 0x3f, 0xfe, 0x25, 0x01, 0x02, 0x00, 0x00, 0x03,
+			0, 0, 0, 0, 0, 0, 0, 0x01 },
+		2794, 1766, 0x2cc18cd5, 0x40207d3d },
+	{ AF_INET6,
+		{ 0x3f, 0xfe, 0x05, 0x01, 0x00, 0x08, 0x00, 0x00,
+			0x02, 0x60, 0x97, 0xff, 0xfe, 0x40, 0xef, 0xab },
+		{ 0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01 },
+		14230, 4739, 0x0f0c461c, 0xdde51bbf },
+	{ AF_INET6,
+		{ 0x3f, 0xfe, 0x19, 0x00, 0x45, 0x45, 0x00, 0x03,
+			0x02, 0x00, 0xf8, 0xff, 0xfe, 0x21, 0x67, 0xcf },
+		{ 0xfe, 0x80, 0, 0, 0, 0, 0, 0,
+			0x02, 0x00, 0xf8, 0xff, 0xfe, 0x21, 0x67, 0xcf },
+		44251, 38024, 0x4b61e985, 0x02d1feef },
+};
+static const size_t kVectorCount = sizeof(kVectors) / sizeof(kVectors[0]);
+
+
+static size_t
+address_length(const hash_vector& vector)
+{
+	return vector.family == AF_INET ? sizeof(in_addr) : sizeof(in6_addr);
+}
+
+
+static net_buffer*
+create_packet(const hash_vector& vector, uint8 protocol, bool fragment)
+{
+	net_buffer* buffer = gBufferModule->create(256);
+	if (buffer == NULL) {
+		printf("creating a buffer failed!\n");
+		exit(1);
+	}
+
+	size_t length = address_length(vector);
+	status_t status;
+
+	if (vector.family == AF_INET) {
+		ip header;
+		memset(&header, 0, sizeof(header));
+		header.ip_v = IPVERSION;
+		header.ip_hl = sizeof(header) >> 2;
+		header.ip_p = protocol;
+		header.ip_off = htons(fragment ? IP_MF : 0);
+		memcpy(&header.ip_src, vector.source, length);
+		memcpy(&header.ip_dst, vector.destination, length);
+
+		status = gBufferModule->append(buffer, &header, sizeof(header));
+		buffer->type = B_NET_FRAME_TYPE_IPV4;
+	} else {
+		ip6_hdr header;
+		memset(&header, 0, sizeof(header));
+		header.ip6_vfc = IPV6_VERSION;
+		header.ip6_nxt = protocol;
+		memcpy(&header.ip6_src, vector.source, length);
+		memcpy(&header.ip6_dst, vector.destination, length);
+
+		status = gBufferModule->append(buffer, &header, sizeof(header));
+		buffer->type = B_NET_FRAME_TYPE_IPV6;
+	}
+
+	uint16 ports[2] = { htons(vector.source_port),
+		htons(vector.destination_port) };
+	if (status == B_OK)
+		status = gBufferModule->append(buffer, ports, sizeof(ports));
+	if (status != B_OK) {
+		printf("creating the packet failed: %s\n", strerror(status));
+		exit(1);
+	}
+
+	return buffer;
+}
+
+
+static uint32
+packet_hash(const hash_vector& vector, uint8 protocol, bool fragment)
+{
+	net_buffer* buffer = create_packet(vector, protocol, fragment);
+	uint32 hash = flow_hash(buffer);
+	gBufferModule->free(buffer);
+	return hash;
+}
+
+
+static void
+test_toeplitz_hash()
+{
+	for (size_t i = 0; i < kVectorCount; i++) {
+		const hash_vector& vector = kVectors[i];
+		size_t length = address_length(vector);
+
+		uint8 tuple[2 * sizeof(in6_addr) + 2 * sizeof(uint16)];
+		memcpy(tuple, vector.source, length);
+		memcpy(tuple + length, vector.destination, length);
+		uint32 hash = toeplitz_hash(tuple, 2 * length);
+		ASSERT(hash == vector.address_hash);
+
+		uint16 ports[2] = { htons(vector.source_port),
+			htons(vector.destination_port) };
+		memcpy(tuple + 2 * length, ports, sizeof(ports));
+		hash = toeplitz_hash(tuple, 2 * length + sizeof(ports));
+		ASSERT(hash == vector.port_hash);
+	}
+	puts("toeplitz hash: ok");
+}
+
+
+static void
+test_flow_hash()
+{
+	for (size_t i = 0; i < kVectorCount; i++) {
+		const hash_vector& vector = kVectors[i];
+
+		uint32 hash = packet_hash(vector, IPPROTO_TCP, false);
+		ASSERT(hash == vector.port_hash);
+		hash = packet_hash(vector, IPPROTO_UDP, false);
+		ASSERT(hash == vector.port_hash);
+
+		// other protocols only hash the addresses
+		hash = packet_hash(vector, IPPROTO_ICMP, false);
+		ASSERT(hash == vector.address_hash);
+
+		// so do IPv4 fragments, as only the first one has the ports
+		if (vector.family == AF_INET) {
+			hash = packet_hash(vector, IPPROTO_TCP, true);
+			ASSERT(hash == vector.address_hash);
+		}
+	}
+
+	// non-IP frames all end up with the first consumer
+	net_buffer* buffer = create_packet(kVectors[0], IPPROTO_TCP, false);
+	buffer->type = 0;
+	uint32 hash = flow_hash(buffer);
+	ASSERT(hash == 0);
+	gBufferModule->free(buffer);
+
+	puts("flow hash: ok");
+}
+
+
+int
+main()
+{
+	_add_builtin_module((module_info*)&gNetBufferModule);
+	get_module(NET_BUFFER_MODULE_NAME, (module_info**)&gBufferModule);
+
+	test_toeplitz_hash();
+	test_flow_hash();
+	return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "SackScoreboard.h"
+
+#include <stdio.h>
+
+
+static const uint32 kSegmentSize = 1000;
+
+
+static void
+send_segments(SackScoreboard& scoreboard, uint32 first, uint32 count,
+	bigtime_t time)
+{
+	for (uint32 i = 0; i < count; i++) {
+		tcp_sequence start = first + i * kSegmentSize;
+		scoreboard.SegmentSent(start, start + kSegmentSize, time + i, false);
+	}
+}
+
+
+static void
+test_lost_segment()
+{
+	// ten segments, of which the second one is lost
+	SackScoreboard scoreboard;
+	send_segments(scoreboard, 1000, 10, 1000);
+
+	tcp_sack sack = { 3000, 6000 };
+	bool updated = scoreboard.Acknowledge(2000, &sack, 1, 11000, 50000, -1);
+	ASSERT(updated);
+	ASSERT(scoreboard.SackedSegments() == 3);
+
+	// three segments are SACKed, so we don't need to wait for reordering
+	bigtime_t timeout;
+	bool detected = scoreboard.DetectLosses(50000, 40000, false, timeout);
+	ASSERT(detected);
+	ASSERT(timeout == 0);
+
+	tcp_sequence lost;
+	bool found = scoreboard.NextLost(lost);
+	ASSERT(found && lost == 2000);
+	ASSERT(scoreboard.HoleLength(lost) == kSegmentSize);
+	ASSERT(scoreboard.Pipe() == 5 * kSegmentSize);
+
+	scoreboard.SegmentSent(2000, 3000, 50001, true);
+	found = scoreboard.NextLost(lost);
+	ASSERT(!found);
+	ASSERT(scoreboard.Pipe() == 6 * kSegmentSize);
+
+	// the retransmission fills the hole
+	updated = scoreboard.Acknowledge(6000, NULL, 0, 11000, 90000, -1);
+	ASSERT(updated);
+	ASSERT(scoreboard.SackedSegments() == 0);
+	ASSERT(scoreboard.Pipe() == 5 * kSegmentSize);
+
+	scoreboard.Acknowledge(11000, NULL, 0, 11000, 91000, -1);
+	ASSERT(scoreboard.IsEmpty());
+	puts("lost segment: ok");
+}
+
+
+static void
+test_reordering()
+{
+	SackScoreboard scoreboard;
+	send_segments(scoreboard, 1000, 4, 1000);
+
+	// only one segment beyond the hole arrived, it might just be reordered
+	tcp_sack sack = { 3000, 4000 };
+	scoreboard.Acknowledge(2000, &sack, 1, 5000, 41002, -1);
+
+	bigtime_t timeout;
+	bool detected = scoreboard.DetectLosses(41002, 40000, false, timeout);
+	ASSERT(!detected);
+	ASSERT(timeout == 9999);
+
+	// after the reordering window, it's considered lost
+	detected = scoreboard.DetectLosses(51001, 40000, false, timeout);
+	ASSERT(detected);
+
+	tcp_sequence lost;
+	bool found = scoreboard.NextLost(lost);
+	ASSERT(found && lost == 2000);
+
+	// but it was only late
+	sack.left_edge = 2000;
+	bool updated = scoreboard.Acknowledge(2000, &sack, 1, 5000, 51500, -1);
+	ASSERT(updated);
+	found = scoreboard.NextLost(lost);
+	ASSERT(!found);
+	ASSERT(scoreboard.Pipe() == kSegmentSize);
+	puts("reordering: ok");
+}
+
+
+static void
+test_split()
+{
+	// a large segment, followed by enough to fill the initial records
+	SackScoreboard scoreboard;
+	scoreboard.SegmentSent(1000, 4000, 1000, false);
+	send_segments(scoreboard, 4000, 31, 1001);
+	ASSERT(scoreboard.Pipe() == 34 * kSegmentSize);
+
+	// retransmitting its middle keeps both of its other parts outstanding
+	scoreboard.SegmentSent(2000, 3000, 2000, true);
+	ASSERT(scoreboard.IsValid());
+	ASSERT(scoreboard.Pipe() == 34 * kSegmentSize);
+
+	tcp_sack sack = { 3000, 4000 };
+	bool updated = scoreboard.Acknowledge(1000, &sack, 1, 35000, 3000, -1);
+	ASSERT(updated);
+	ASSERT(scoreboard.SackedSegments() == 1);
+	ASSERT(scoreboard.HoleLength(1000) == 2 * kSegmentSize);
+	ASSERT(scoreboard.Pipe() == 33 * kSegmentSize);
+
+	// the first part is still outstanding after the retransmission is acked
+	updated = scoreboard.Acknowledge(1000, &sack, 1, 35000, 3001, -1);
+	ASSERT(!updated);
+	sack.left_edge = 2000;
+	updated = scoreboard.Acknowledge(1000, &sack, 1, 35000, 3002, -1);
+	ASSERT(updated);
+	ASSERT(scoreboard.Pipe() == 32 * kSegmentSize);
+
+	updated = scoreboard.Acknowledge(4000, NULL, 0, 35000, 3003, -1);
+	ASSERT(updated);
+	ASSERT(scoreboard.SackedSegments() == 0);
+	ASSERT(scoreboard.Pipe() == 31 * kSegmentSize);
+	puts("split: ok");
+}
+
+
+static void
+test_invalid()
+{
+	SackScoreboard scoreboard;
+
+	// more segments than fit into the initial records
+	send_segments(scoreboard, 1000, 100, 1000);
+	ASSERT(scoreboard.IsValid());
+	ASSERT(scoreboard.Pipe() == 100 * kSegmentSize);
+
+	// invalid SACK blocks are ignored
+	tcp_sack sacks[2] = { { 500, 3000 }, { 90000, 200000 } };
+	bool updated = scoreboard.Acknowledge(1000, sacks, 2, 101000, 2000, -1);
+	ASSERT(!updated);
+
+	scoreboard.Invalidate();
+	send_segments(scoreboard, 101000, 1, 3000);
+	ASSERT(!scoreboard.IsValid() && scoreboard.IsEmpty());
+
+	scoreboard.Clear();
+	ASSERT(scoreboard.IsValid());
+	puts("invalid: ok");
+}
+
+
+int
+main()
+{
+	test_lost_segment();
+	test_reordering();
+	test_split();
+	test_invalid();
+	return 0;
+}
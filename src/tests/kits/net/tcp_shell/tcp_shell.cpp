@@ -919,7 +919,7 @@ domain_receive_data(net_buffer *buffer)
 
 	bool drop = false;
 	if (sDropList.find(packetNumber) != sDropList.end()
-		|| (sRandomDrop > 0.0 && (1.0 * rand() / RAND_MAX) > sRandomDrop))
+		|| (sRandomDrop > 0.0 && (1.0 * rand() / RAND_MAX) < sRandomDrop))
 		drop = true;
 
 	if (!drop && (sRoundTripTime > 0 || sRandomRoundTrip || sIncreasingRoundTrip)) {
@@ -1006,6 +1006,27 @@ domain_receive_data(net_buffer *buffer)
 						printf(" <ts %lu:%lu>", option->timestamp.value, option->timestamp.reply);
 						length = 10;
 						break;
+					case TCP_OPTION_SACK_PERMITTED:
+						printf(" <sackOK>");
+						length = 2;
+						break;
+					case TCP_OPTION_SACK:
+					{
+						length = option->length;
+						if (length < 2) {
+							size = 0;
+							break;
+						}
+
+						printf(" <sack");
+						uint32 count = (length - 2) / sizeof(tcp_sack);
+						for (uint32 i = 0; i < count; i++) {
+							printf(" %lu:%lu", ntohl(option->sack[i].left_edge),
+								ntohl(option->sack[i].right_edge));
+						}
+						putchar('>');
+						break;
+					}
 
 					default:
 						length = option->length;
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+#include <async_io_defs.h>
+#include <syscalls.h>
+
+
+static const int32 kChunkCount = 64;
+static const size_t kChunkSize = 4096;
+
+
+int
+main(int argc, char** argv)
+{
+	const char* path = argc > 1 ? argv[1] : "/tmp/async_io_test.data";
+
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Could not create \"%s\": %s\n", path,
+			strerror(errno));
+		return 1;
+	}
+
+	int context = _kern_create_async_io_context(0, O_CLOEXEC);
+	if (context < 0) {
+		fprintf(stderr, "Could not create context: %s\n", strerror(context));
+		return 1;
+	}
+
+	uint8* buffer = (uint8*)malloc(kChunkCount * kChunkSize);
+	async_io_request requests[kChunkCount];
+	async_io_completion completions[kChunkCount];
+
+	// write all chunks in one batch
+
+	for (int32 i = 0; i < kChunkCount; i++) {
+		memset(buffer + i * kChunkSize, i, kChunkSize);
+
+		requests[i].fd = fd;
+		requests[i].operation = ASYNC_IO_WRITE;
+		requests[i].offset = i * kChunkSize;
+		requests[i].buffer = buffer + i * kChunkSize;
+		requests[i].length = kChunkSize;
+		requests[i].cookie = (void*)(addr_t)i;
+	}
+
+	ssize_t submitted = _kern_submit_async_io(context, requests, kChunkCount);
+	if (submitted != kChunkCount) {
+		fprintf(stderr, "Submitting writes failed: %s\n",
+			strerror(submitted));
+		return 1;
+	}
+
+	ssize_t reaped = _kern_reap_async_io(context, completions, kChunkCount,
+		kChunkCount, 0, 0);
+	if (reaped != kChunkCount) {
+		fprintf(stderr, "Reaping writes failed: %s\n", strerror(reaped));
+		return 1;
+	}
+
+	for (int32 i = 0; i < kChunkCount; i++) {
+		if (completions[i].status != B_OK
+			|| completions[i].transferred != kChunkSize) {
+			fprintf(stderr, "Write %ld failed: %s\n",
+				(long)(addr_t)completions[i].cookie,
+				strerror(completions[i].status));
+			return 1;
+		}
+	}
+
+	// read them back in reverse order, and wait for them via wait_for_objects
+
+	memset(buffer, 0xff, kChunkCount * kChunkSize);
+
+	for (int32 i = 0; i < kChunkCount; i++) {
+		requests[i].operation = ASYNC_IO_READ;
+		requests[i].offset = (kChunkCount - 1 - i) * kChunkSize;
+	}
+
+	submitted = _kern_submit_async_io(context, requests, kChunkCount);
+	if (submitted != kChunkCount) {
+		fprintf(stderr, "Submitting reads failed: %s\n", strerror(submitted));
+		return 1;
+	}
+
+	int32 completed = 0;
+	while (completed < kChunkCount) {
+		object_wait_info info;
+		info.object = context;
+		info.type = B_OBJECT_TYPE_FD;
+		info.events = B_EVENT_READ;
+
+		ssize_t result = wait_for_objects(&info, 1);
+		if (result < 0 || (info.events & B_EVENT_READ) == 0) {
+			fprintf(stderr, "Waiting failed: %s\n", strerror(result));
+			return 1;
+		}
+
+		reaped = _kern_reap_async_io(context, completions, kChunkCount, 0,
+			B_RELATIVE_TIMEOUT, 0);
+		if (reaped < 0) {
+			fprintf(stderr, "Reaping reads failed: %s\n", strerror(reaped));
+			return 1;
+		}
+
+		for (ssize_t i = 0; i < reaped; i++) {
+			int32 index = (addr_t)completions[i].cookie;
+			uint8 expected = kChunkCount - 1 - index;
+			const uint8* data = buffer + index * kChunkSize;
+
+			if (completions[i].status != B_OK
+				|| completions[i].transferred != kChunkSize
+				|| data[0] != expected || data[kChunkSize - 1] != expected) {
+				fprintf(stderr, "Read %ld returned wrong data!\n",
+					(long)index);
+				return 1;
+			}
+		}
+
+		completed += reaped;
+	}
+
+	close(context);
+	close(fd);
+	unlink(path);
+	free(buffer);
+
+	printf("All tests passed.\n");
+	return 0;
+}
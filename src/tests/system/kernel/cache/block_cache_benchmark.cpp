@@ -0,0 +1,153 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures how many block lookups per second the block cache manages as
+	more threads are added. Every thread repeatedly gets and puts blocks from
+	a shared working set that is fully cached, so that the numbers reflect
+	the lookup path only.
+*/
+
+
+#define write_pos	block_cache_write_pos
+#define read_pos	block_cache_read_pos
+
+#include "block_cache.cpp"
+
+#undef write_pos
+#undef read_pos
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+static const size_t kBlockSize = 2048;
+static const off_t kDefaultBlockCount = 4096;
+static const int32 kDefaultMaxThreads = 8;
+static const bigtime_t kDefaultDuration = 2000000;
+
+static void* sCache;
+static off_t sBlockCount = kDefaultBlockCount;
+static bigtime_t sDuration = kDefaultDuration;
+static volatile bool sStop;
+
+
+ssize_t
+block_cache_write_pos(int fd, off_t offset, const void* buffer, size_t size)
+{
+	return size;
+}
+
+
+ssize_t
+block_cache_read_pos(int fd, off_t offset, void* buffer, size_t size)
+{
+	memset(buffer, 0, size);
+	*(off_t*)buffer = offset / kBlockSize;
+	return size;
+}
+
+
+static status_t
+lookup_thread(void* _count)
+{
+	int64* count = (int64*)_count;
+	uint32 seed = find_thread(NULL);
+	int64 lookups = 0;
+
+	while (!sStop) {
+		for (int32 i = 0; i < 256; i++) {
+			seed = seed * 1103515245 + 12345;
+			off_t blockNumber = (seed >> 8) % sBlockCount;
+
+			const void* block = block_cache_get(sCache, blockNumber);
+			if (block == NULL || *(const off_t*)block != blockNumber) {
+				fprintf(stderr, "block %" B_PRIdOFF " has wrong contents!\n",
+					blockNumber);
+				exit(1);
+			}
+			block_cache_put(sCache, blockNumber);
+		}
+		lookups += 256;
+	}
+
+	*count = lookups;
+	return B_OK;
+}
+
+
+static double
+run_benchmark(int32 threadCount)
+{
+	thread_id threads[threadCount];
+	int64 counts[threadCount];
+
+	sStop = false;
+
+	for (int32 i = 0; i < threadCount; i++) {
+		counts[i] = 0;
+		threads[i] = spawn_thread(&lookup_thread, "lookup", B_NORMAL_PRIORITY,
+			&counts[i]);
+	}
+
+	bigtime_t start = system_time();
+	for (int32 i = 0; i < threadCount; i++)
+		resume_thread(threads[i]);
+
+	snooze(sDuration);
+	sStop = true;
+
+	int64 total = 0;
+	for (int32 i = 0; i < threadCount; i++) {
+		status_t status;
+		wait_for_thread(threads[i], &status);
+		total += counts[i];
+	}
+
+	return total * 1000000.0 / (system_time() - start);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 maxThreads = kDefaultMaxThreads;
+	if (argc > 1)
+		maxThreads = max_c(1, atol(argv[1]));
+	if (argc > 2)
+		sBlockCount = max_c(1, atoll(argv[2]));
+	if (argc > 3)
+		sDuration = max_c(1, atoll(argv[3])) * 1000000LL;
+
+	block_cache_init();
+
+	sCache = block_cache_create(-1, sBlockCount, kBlockSize, true);
+	if (sCache == NULL) {
+		fprintf(stderr, "Could not create block cache!\n");
+		return 1;
+	}
+
+	// read in the whole working set once
+	for (off_t i = 0; i < sBlockCount; i++) {
+		block_cache_get(sCache, i);
+		block_cache_put(sCache, i);
+	}
+
+	printf("%" B_PRIdOFF " blocks, %d CPU shards\n", sBlockCount,
+		(int)smp_get_num_cpus());
+
+	double single = 0;
+	for (int32 threads = 1; threads <= maxThreads; threads *= 2) {
+		double lookups = run_benchmark(threads);
+		if (threads == 1)
+			single = lookups;
+
+		printf("%3" B_PRId32 " threads: %12.0f lookups/s (%.2fx)\n", threads,
+			lookups, lookups / single);
+	}
+
+	block_cache_delete(sCache, false);
+	return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include <OS.h>
+#include <scheduler.h>
+
+
+static const bigtime_t kRuntime = 2000;
+static const bigtime_t kPeriod = 10000;
+static const int32 kPeriodCount = 100;
+static const bigtime_t kMaxGap = 2 * (kPeriod - kRuntime) + kRuntime;
+	// the runtime may come at the start of one period, and at the end of
+	// the next one; the rest is slack for interrupts and timer resolution
+
+
+static bool
+expect(const char* what, status_t status, status_t expected)
+{
+	if (status == expected)
+		return true;
+
+	fprintf(stderr, "%s: got \"%s\", expected \"%s\"\n", what,
+		strerror(status), strerror(expected));
+	return false;
+}
+
+
+int
+main()
+{
+	thread_id self = find_thread(NULL);
+
+	// invalid parameters
+
+	if (!expect("runtime > deadline",
+			set_thread_deadline(self, kPeriod, kRuntime, kPeriod), B_BAD_VALUE)
+		|| !expect("deadline > period",
+			set_thread_deadline(self, kRuntime, kPeriod * 2, kPeriod),
+			B_BAD_VALUE)
+		|| !expect("negative runtime",
+			set_thread_deadline(self, -1, kPeriod, kPeriod), B_BAD_VALUE)) {
+		return 1;
+	}
+
+	// no core can give away all of its time
+
+	if (!expect("full utilization",
+			set_thread_deadline(self, kPeriod, kPeriod, kPeriod), B_BUSY)) {
+		return 1;
+	}
+
+	if (!expect("admission",
+			set_thread_deadline(self, kRuntime, kPeriod, kPeriod), B_OK)) {
+		return 1;
+	}
+
+	// spin for a while, and see how long we had to wait for the CPU at most
+
+	bigtime_t start = system_time();
+	bigtime_t end = start + kPeriodCount * kPeriod;
+	bigtime_t lastTime = start;
+	bigtime_t maxGap = 0;
+	while (lastTime < end) {
+		bigtime_t now = system_time();
+		if (now - lastTime > maxGap)
+			maxGap = now - lastTime;
+		lastTime = now;
+	}
+
+	printf("longest time without CPU: %" B_PRId64 " us\n", maxGap);
+
+	if (maxGap > kMaxGap) {
+		fprintf(stderr, "waited %" B_PRId64 " us for the CPU, expected at "
+			"most %" B_PRId64 " us\n", maxGap, kMaxGap);
+		set_thread_deadline(self, 0, 0, 0);
+		return 1;
+	}
+
+	if (!expect("leaving the deadline class",
+			set_thread_deadline(self, 0, 0, 0), B_OK)) {
+		return 1;
+	}
+
+	printf("All tests passed.\n");
+	return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+#include <event_queue_defs.h>
+#include <syscalls.h>
+
+
+static bool
+select_fd(int queue, int fd, int32 events, void* userData)
+{
+	event_wait_info info;
+	info.object = fd;
+	info.type = B_OBJECT_TYPE_FD;
+	info.events = events;
+	info.user_data = userData;
+
+	status_t status = _kern_event_queue_select(queue, &info, 1);
+	if (status != 1) {
+		fprintf(stderr, "Selecting %d failed: %s\n", fd, strerror(status));
+		return false;
+	}
+	return true;
+}
+
+
+static ssize_t
+wait_for_queue(int queue, event_wait_info* infos, int count)
+{
+	return _kern_event_queue_wait(queue, infos, count, B_RELATIVE_TIMEOUT,
+		0);
+}
+
+
+static bool
+expect_nothing(int queue, const char* what)
+{
+	event_wait_info info;
+	ssize_t result = wait_for_queue(queue, &info, 1);
+	if (result != B_TIMED_OUT && result != B_WOULD_BLOCK) {
+		fprintf(stderr, "%s: unexpected result %ld\n", what, (long)result);
+		return false;
+	}
+	return true;
+}
+
+
+static bool
+expect_event(int queue, void* userData, int32 events, const char* what)
+{
+	event_wait_info info;
+	ssize_t result = wait_for_queue(queue, &info, 1);
+	if (result != 1 || info.user_data != userData
+		|| (info.events & events) != events) {
+		fprintf(stderr, "%s: unexpected result %ld, events %#" B_PRIx32 "\n",
+			what, (long)result, result == 1 ? info.events : 0);
+		return false;
+	}
+	return true;
+}
+
+
+int
+main()
+{
+	int queue = _kern_event_queue_create(O_CLOEXEC);
+	if (queue < 0) {
+		fprintf(stderr, "Could not create queue: %s\n", strerror(queue));
+		return 1;
+	}
+
+	int edgePipe[2];
+	int levelPipe[2];
+	if (pipe(edgePipe) != 0 || pipe(levelPipe) != 0) {
+		fprintf(stderr, "Could not create pipes: %s\n", strerror(errno));
+		return 1;
+	}
+
+	void* edgeData = (void*)(addr_t)1;
+	void* levelData = (void*)(addr_t)2;
+
+	if (!select_fd(queue, edgePipe[0], B_EVENT_READ, edgeData)
+		|| !select_fd(queue, levelPipe[0],
+			B_EVENT_READ | B_EVENT_LEVEL_TRIGGERED, levelData)
+		|| !expect_nothing(queue, "empty pipes")) {
+		return 1;
+	}
+
+	// edge triggered: reported once per write
+
+	write(edgePipe[1], "x", 1);
+	if (!expect_event(queue, edgeData, B_EVENT_READ, "edge write")
+		|| !expect_nothing(queue, "edge unread data")) {
+		return 1;
+	}
+
+	// level triggered: reported as long as there is data to read
+
+	write(levelPipe[1], "x", 1);
+	if (!expect_event(queue, levelData, B_EVENT_READ, "level write")
+		|| !expect_event(queue, levelData, B_EVENT_READ,
+			"level unread data")) {
+		return 1;
+	}
+
+	char buffer[4];
+	read(levelPipe[0], buffer, 1);
+	if (!expect_nothing(queue, "level drained"))
+		return 1;
+
+	write(levelPipe[1], "x", 1);
+	if (!expect_event(queue, levelData, B_EVENT_READ, "level write again"))
+		return 1;
+	read(levelPipe[0], buffer, 1);
+	if (!expect_nothing(queue, "level drained again"))
+		return 1;
+
+	// one shot: reported once, then removed
+
+	if (!select_fd(queue, levelPipe[0], B_EVENT_READ | B_EVENT_ONE_SHOT,
+			levelData)) {
+		return 1;
+	}
+	write(levelPipe[1], "x", 1);
+	if (!expect_event(queue, levelData, B_EVENT_READ, "one shot write")) {
+		return 1;
+	}
+	write(levelPipe[1], "x", 1);
+	if (!expect_nothing(queue, "one shot removed"))
+		return 1;
+
+	// closing the object reports it as invalid, and removes it
+
+	close(edgePipe[0]);
+	if (!expect_event(queue, edgeData, B_EVENT_INVALID, "closed fd")
+		|| !expect_nothing(queue, "closed fd removed")) {
+		return 1;
+	}
+
+	close(queue);
+	close(edgePipe[1]);
+	close(levelPipe[0]);
+	close(levelPipe[1]);
+
+	printf("All tests passed.\n");
+	return 0;
+}
@@ -0,0 +1,344 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+//!	Stresses the thread caching allocator from several threads
+
+
+#include <OS.h>
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static const int32 kThreadCount = 8;
+static const int32 kAllocationCount = 4096;
+static const size_t kMaxSmallSize = 16 * 1024;
+static const int32 kHandOverCount = 64;
+
+
+static inline uint8
+pattern_for(const void* address, size_t offset)
+{
+	addr_t value = (addr_t)address + offset;
+	return (value >> 24) ^ (value >> 16) ^ (value >> 8) ^ value;
+}
+
+
+static void
+write_pattern(void* address, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		((uint8*)address)[i] = pattern_for(address, i);
+}
+
+
+static void
+verify_pattern(void* address, size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		if (((uint8*)address)[i] != pattern_for(address, i)) {
+			printf("allocation %p of %lu bytes was overwritten at offset "
+				"%lu\n", address, size, i);
+			exit(1);
+		}
+	}
+}
+
+
+static void*
+allocate(size_t size, size_t alignment)
+{
+	void* address;
+	if (alignment != 0) {
+		if (posix_memalign(&address, alignment, size) != 0)
+			address = NULL;
+	} else
+		address = malloc(size);
+
+	if (address == NULL) {
+		printf("allocation of %lu bytes failed\n", size);
+		exit(1);
+	}
+	if (alignment != 0 && (addr_t)address % alignment != 0) {
+		printf("allocation %p of %lu bytes is not aligned to %lu\n", address,
+			size, alignment);
+		exit(1);
+	}
+
+	write_pattern(address, size);
+	return address;
+}
+
+
+//	#pragma mark - concurrent allocations
+
+
+/*!	Allocates and frees small objects in a random order, so that the thread
+	cache keeps being refilled from, and flushed to the size classes.
+*/
+static status_t
+allocating_thread(void* /*data*/)
+{
+	void* allocations[256];
+	size_t sizes[256];
+	memset(allocations, 0, sizeof(allocations));
+
+	unsigned int seed = find_thread(NULL);
+
+	for (int32 i = 0; i < kAllocationCount; i++) {
+		int32 index = rand_r(&seed) % 256;
+		if (allocations[index] != NULL) {
+			verify_pattern(allocations[index], sizes[index]);
+			free(allocations[index]);
+		}
+
+		sizes[index] = 1 + rand_r(&seed) % kMaxSmallSize;
+		allocations[index] = allocate(sizes[index], 0);
+	}
+
+	for (int32 i = 0; i < 256; i++) {
+		if (allocations[i] != NULL) {
+			verify_pattern(allocations[i], sizes[i]);
+			free(allocations[i]);
+		}
+	}
+
+	return B_OK;
+}
+
+
+static void
+test_concurrent_allocations()
+{
+	thread_id threads[kThreadCount];
+	for (int32 i = 0; i < kThreadCount; i++) {
+		threads[i] = spawn_thread(allocating_thread, "allocating",
+			B_NORMAL_PRIORITY, NULL);
+		resume_thread(threads[i]);
+	}
+
+	for (int32 i = 0; i < kThreadCount; i++) {
+		status_t result;
+		wait_for_thread(threads[i], &result);
+	}
+
+	printf("concurrent allocations: ok\n");
+}
+
+
+//	#pragma mark - cross thread frees
+
+
+struct hand_over {
+	sem_id		full;
+	sem_id		empty;
+	void*		allocations[kHandOverCount];
+	size_t		sizes[kHandOverCount];
+};
+
+
+/*!	Frees everything the main thread allocates, so that the objects end up in
+	a different thread cache than the one they came from.
+*/
+static status_t
+freeing_thread(void* data)
+{
+	hand_over& handOver = *(hand_over*)data;
+
+	for (int32 round = 0; round < kAllocationCount / kHandOverCount;
+			round++) {
+		if (acquire_sem(handOver.full) != B_OK)
+			return B_ERROR;
+
+		for (int32 i = 0; i < kHandOverCount; i++) {
+			verify_pattern(handOver.allocations[i], handOver.sizes[i]);
+			free(handOver.allocations[i]);
+		}
+
+		release_sem(handOver.empty);
+	}
+
+	return B_OK;
+}
+
+
+static void
+test_cross_thread_frees()
+{
+	hand_over handOver;
+	handOver.full = create_sem(0, "full");
+	handOver.empty = create_sem(1, "empty");
+
+	thread_id thread = spawn_thread(freeing_thread, "freeing",
+		B_NORMAL_PRIORITY, &handOver);
+	resume_thread(thread);
+
+	for (int32 round = 0; round < kAllocationCount / kHandOverCount;
+			round++) {
+		acquire_sem(handOver.empty);
+
+		for (int32 i = 0; i < kHandOverCount; i++) {
+			// include some allocations that take whole pages
+			handOver.sizes[i] = 1 + rand() % (i % 16 == 0
+				? 8 * kMaxSmallSize : kMaxSmallSize);
+			handOver.allocations[i] = allocate(handOver.sizes[i], 0);
+		}
+
+		release_sem(handOver.full);
+	}
+
+	status_t result;
+	wait_for_thread(thread, &result);
+	if (result != B_OK) {
+		printf("freeing thread failed\n");
+		exit(1);
+	}
+
+	delete_sem(handOver.full);
+	delete_sem(handOver.empty);
+
+	printf("cross thread frees: ok\n");
+}
+
+
+//	#pragma mark - killed threads
+
+
+static status_t
+killed_thread(void* data)
+{
+	free(malloc(16));
+	release_sem((sem_id)(addr_t)data);
+
+	snooze(B_INFINITE_TIMEOUT);
+	return B_OK;
+}
+
+
+static void
+test_killed_threads()
+{
+	malloc_statistics before;
+	malloc_get_statistics(&before);
+
+	sem_id ready = create_sem(0, "ready");
+	thread_id threads[kThreadCount];
+	for (int32 i = 0; i < kThreadCount; i++) {
+		threads[i] = spawn_thread(killed_thread, "killed", B_NORMAL_PRIORITY,
+			(void*)(addr_t)ready);
+		resume_thread(threads[i]);
+	}
+
+	// wait until all of them have their cache, then kill them, so that they
+	// don't get to give them up themselves
+	acquire_sem_etc(ready, kThreadCount, 0, 0);
+	for (int32 i = 0; i < kThreadCount; i++) {
+		kill_thread(threads[i]);
+
+		status_t result;
+		wait_for_thread(threads[i], &result);
+	}
+	delete_sem(ready);
+
+	malloc_statistics after;
+	malloc_get_statistics(&after);
+	if (after.thread_cache_count > before.thread_cache_count) {
+		printf("%lu thread caches left after killing threads, expected %lu\n",
+			after.thread_cache_count, before.thread_cache_count);
+		exit(1);
+	}
+
+	printf("killed threads: ok\n");
+}
+
+
+//	#pragma mark - large allocations
+
+
+static void
+test_large_allocations()
+{
+	static const int32 kCount = 64;
+	void* allocations[kCount];
+	size_t sizes[kCount];
+
+	for (int32 i = 0; i < kCount; i++) {
+		sizes[i] = kMaxSmallSize + rand() % (32 * kMaxSmallSize);
+		size_t alignment = i % 2 == 0 ? 0 : (size_t)1 << (4 + i % 17);
+		allocations[i] = allocate(sizes[i], alignment);
+	}
+
+	// free every other allocation first, so that the rest is coalesced with
+	// free neighbours when it is freed
+	for (int32 i = 0; i < kCount; i += 2) {
+		verify_pattern(allocations[i], sizes[i]);
+		free(allocations[i]);
+	}
+
+	malloc_trim(0);
+
+	malloc_statistics before;
+	if (malloc_get_statistics(&before) != 0) {
+		printf("could not get the malloc statistics\n");
+		exit(1);
+	}
+
+	for (int32 i = 1; i < kCount; i += 2) {
+		verify_pattern(allocations[i], sizes[i]);
+		free(allocations[i]);
+	}
+
+	malloc_statistics after;
+	malloc_get_statistics(&after);
+
+	// Merging with released neighbours must not count their pages again
+	if (after.released_size < before.released_size
+		|| after.released_size > after.free_size) {
+		printf("released size went from %lu to %lu, with %lu bytes free\n",
+			before.released_size, after.released_size, after.free_size);
+		exit(1);
+	}
+
+	malloc_trim(0);
+	malloc_get_statistics(&after);
+	if (after.released_size != after.free_size) {
+		printf("after trimming, %lu of %lu free bytes are released\n",
+			after.released_size, after.free_size);
+		exit(1);
+	}
+
+	printf("large allocations: ok\n");
+}
+
+
+int
+main(int argc, char** argv)
+{
+	// make sure the main thread has its cache already
+	free(malloc(1));
+
+	malloc_statistics statistics;
+	malloc_get_statistics(&statistics);
+	size_t threadCacheCount = statistics.thread_cache_count;
+
+	test_concurrent_allocations();
+	test_cross_thread_frees();
+	test_killed_threads();
+	test_large_allocations();
+
+	// the caches of the exited threads must have been given up
+	malloc_get_statistics(&statistics);
+	if (statistics.thread_cache_count > threadCacheCount) {
+		printf("%lu thread caches left, expected %lu\n",
+			statistics.thread_cache_count, threadCacheCount);
+		return 1;
+	}
+
+	printf("tests succeeded\n");
+	return 0;
+}
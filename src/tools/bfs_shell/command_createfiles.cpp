@@ -0,0 +1,199 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+//!	Benchmarks creating files from several writers at the same time
+
+
+#include "command_createfiles.h"
+
+#include <stdlib.h>
+
+#include "fssh_defs.h"
+#include "fssh_errors.h"
+#include "fssh_fcntl.h"
+#include "fssh_kernel_export.h"
+#include "fssh_os.h"
+#include "fssh_stat.h"
+#include "fssh_stdio.h"
+#include "fssh_string.h"
+#include "syscalls.h"
+
+
+namespace FSShell {
+
+
+static void
+usage(const char* name)
+{
+	fssh_dprintf("Usage: %s [-w <writers>] [-f <files>] [-s <size>] "
+		"[<directory>]\n"
+		"Creates <files> files of <size> bytes for each of the writers, "
+		"every writer\n"
+		"in its own sub directory of <directory> (defaults to /myfs).\n"
+		"  -w  Number of writers, defaults to 4\n"
+		"  -f  Number of files per writer, defaults to 1000\n"
+		"  -s  Size of the files, defaults to 4096 bytes\n", name);
+}
+
+
+static fssh_status_t
+create_file(const char* path, const void* buffer, fssh_size_t size,
+	fssh_ino_t& _node)
+{
+	int fd = _kern_open(-1, path, FSSH_O_CREAT | FSSH_O_WRONLY | FSSH_O_TRUNC,
+		0644);
+	if (fd < 0)
+		return fd;
+
+	fssh_status_t status = FSSH_B_OK;
+	if (size > 0) {
+		fssh_ssize_t written = _kern_write(fd, 0, buffer, size);
+		if (written < 0)
+			status = written;
+		else if ((fssh_size_t)written != size)
+			status = FSSH_B_IO_ERROR;
+	}
+
+	struct fssh_stat stat;
+	if (status == FSSH_B_OK)
+		status = _kern_read_stat(fd, NULL, false, &stat, sizeof(stat));
+	if (status == FSSH_B_OK)
+		_node = stat.fssh_st_ino;
+
+	_kern_close(fd);
+	return status;
+}
+
+
+/*!	The FS shell cannot run real threads, so the writers take turns file by
+	file instead. Their allocations still interleave like the ones of
+	concurrent writers do.
+*/
+fssh_status_t
+command_createfiles(int argc, const char* const* argv)
+{
+	int32_t writerCount = 4;
+	int32_t fileCount = 1000;
+	int32_t fileSize = 4096;
+	const char* base = "/myfs";
+
+	for (int i = 1; i < argc; i++) {
+		if (!fssh_strcmp(argv[i], "--help")) {
+			usage(argv[0]);
+			return FSSH_B_OK;
+		}
+
+		if (argv[i][0] == '-' && i + 1 < argc) {
+			int32_t value = strtol(argv[i + 1], NULL, 0);
+			switch (argv[i][1]) {
+				case 'w':
+					writerCount = value;
+					break;
+				case 'f':
+					fileCount = value;
+					break;
+				case 's':
+					fileSize = value;
+					break;
+				default:
+					usage(argv[0]);
+					return FSSH_B_BAD_VALUE;
+			}
+			i++;
+		} else if (argv[i][0] != '-')
+			base = argv[i];
+		else {
+			usage(argv[0]);
+			return FSSH_B_BAD_VALUE;
+		}
+	}
+
+	if (writerCount < 1 || fileCount < 1 || fileSize < 0) {
+		usage(argv[0]);
+		return FSSH_B_BAD_VALUE;
+	}
+
+	fssh_ino_t* directories = (fssh_ino_t*)malloc(
+		writerCount * sizeof(fssh_ino_t));
+	void* buffer = malloc(fileSize > 0 ? fileSize : 1);
+	if (directories == NULL || buffer == NULL) {
+		free(directories);
+		free(buffer);
+		return FSSH_B_NO_MEMORY;
+	}
+
+	fssh_memset(buffer, 0x55, fileSize);
+
+	char path[FSSH_B_PATH_NAME_LENGTH];
+	fssh_status_t status = FSSH_B_OK;
+
+	for (int32_t i = 0; i < writerCount; i++) {
+		fssh_snprintf(path, sizeof(path), "%s/writer-%" FSSH_B_PRId32, base,
+			i);
+		status = _kern_create_dir(-1, path, 0755);
+
+		struct fssh_stat stat;
+		if (status == FSSH_B_OK) {
+			status = _kern_read_stat(-1, path, false, &stat,
+				sizeof(stat));
+		}
+		if (status != FSSH_B_OK) {
+			fssh_dprintf("%s: could not create \"%s\": %s\n", argv[0], path,
+				fssh_strerror(status));
+			break;
+		}
+
+		directories[i] = stat.fssh_st_ino;
+	}
+
+	fssh_bigtime_t start = fssh_system_time();
+	uint64_t distance = 0;
+
+	for (int32_t file = 0; status == FSSH_B_OK && file < fileCount; file++) {
+		for (int32_t i = 0; i < writerCount; i++) {
+			fssh_snprintf(path, sizeof(path), "%s/writer-%" FSSH_B_PRId32
+				"/file-%" FSSH_B_PRId32, base, i, file);
+
+			fssh_ino_t node;
+			status = create_file(path, buffer, fileSize, node);
+			if (status != FSSH_B_OK) {
+				fssh_dprintf("%s: could not create \"%s\": %s\n", argv[0],
+					path, fssh_strerror(status));
+				break;
+			}
+
+			// BFS inode numbers are block numbers
+			distance += node > directories[i]
+				? node - directories[i] : directories[i] - node;
+		}
+	}
+
+	if (status == FSSH_B_OK)
+		status = _kern_sync();
+
+	if (status == FSSH_B_OK) {
+		fssh_bigtime_t time = fssh_system_time() - start;
+		if (time == 0)
+			time = 1;
+
+		int64_t files = (int64_t)writerCount * fileCount;
+		fssh_dprintf("%" FSSH_B_PRId64 " files by %" FSSH_B_PRId32
+			" writers in %" FSSH_B_PRId64 " ms\n", files, writerCount,
+			time / 1000);
+		fssh_dprintf("  %" FSSH_B_PRId64 " files/s, %" FSSH_B_PRId64
+			" KB/s\n", files * 1000000 / time,
+			files * fileSize * 1000000 / time / 1024);
+		fssh_dprintf("  average distance from directory: %" FSSH_B_PRIu64
+			" blocks\n", distance / files);
+	}
+
+	free(directories);
+	free(buffer);
+	return status;
+}
+
+
+}	// namespace FSShell